@@ -51,6 +51,10 @@
 
 #define kAudioFileNoCacheMask		0x20
 
+#if !TARGET_OS_WIN32
+CAWriteBehindEngine* AudioFileObject::sWriteBehindEngine = NULL;
+#endif
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 AudioFileObject::~AudioFileObject()
@@ -1731,6 +1735,14 @@ OSStatus AudioFileObject::OpenFile(SInt8 inPermissions, int inFD)
 {
 	OSStatus err = noErr;
 
+#if !TARGET_OS_WIN32
+	// only new (or truncated) files are written behind, since reading existing audio back through
+	// a write-behind file would wait for the disk
+	struct stat stbuf;
+	if (sWriteBehindEngine && (inPermissions & kAudioFileWritePermission) && fstat(inFD, &stbuf) == 0 && stbuf.st_size == 0)
+		SetDataSource(new WriteBehind_DataSource(new CAWriteBehindFile(*sWriteBehindEngine, inFD, true), true));
+	else
+#endif
 	SetDataSource(new Cached_DataSource(new UnixFile_DataSource(inFD, inPermissions, true)));
 	
 	mFileD = inFD;
@@ -185,6 +185,9 @@ private:
 	Boolean							mNeedsSizeUpdate;
 	Boolean							mFirstSetFormat;
 	Boolean							mAlignDataWithFillerChunks;
+#if !TARGET_OS_WIN32
+	static CAWriteBehindEngine		*sWriteBehindEngine;	// if set, new files are written through it
+#endif
 	
 public:    
   
@@ -211,6 +214,12 @@ public:
 	
 	virtual ~AudioFileObject();
 
+#if !TARGET_OS_WIN32
+	// Files created or initialized after this is set are written through a CAWriteBehindFile on the
+	// engine, so writing audio never waits for the disk. Set it to NULL to write directly again.
+	static void SetWriteBehindEngine(CAWriteBehindEngine* inEngine) { sWriteBehindEngine = inEngine; }
+#endif
+
 	
 /* Public API Function Implementation */
 	// The DoSomething() versions of these functions are wrappers that perform a standard prologue.
@@ -657,6 +657,73 @@ OSStatus Seekable_DataSource::WriteBytes(
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
+#if !TARGET_OS_WIN32
+
+WriteBehind_DataSource::WriteBehind_DataSource(CAWriteBehindFile* inFile, Boolean inCloseOnDelete)
+	: DataSource(inCloseOnDelete), mFile(inFile), mOffset(0)
+{
+}
+
+WriteBehind_DataSource::~WriteBehind_DataSource()
+{
+	if (mCloseOnDelete) delete mFile;
+}
+
+OSStatus WriteBehind_DataSource::SetSize(SInt64 inSize)
+{
+	if (!mFile->SetSize(inSize)) return kAudioFilePermissionsError;
+	return noErr;
+}
+
+OSStatus WriteBehind_DataSource::ReadBytes(	
+							UInt16 positionMode, 
+							SInt64 positionOffset, 
+							UInt32 requestCount, 
+							void *buffer, 
+							UInt32* actualCount)
+{
+	if (actualCount) *actualCount = 0;
+	if (!buffer) return kAudio_ParamError;
+
+	SInt64 size = mFile->GetSize();
+	SInt64 offset = CalcOffset(positionMode & kPositionModeMask, positionOffset, mOffset, size);
+	
+	// request is outside bounds of file
+	if (offset < 0) 
+		return kAudioFilePositionError;
+	if (offset >= size) 
+		return kAudioFileEndOfFileError;
+	
+	UInt32 theActualCount = 0;
+	if (!mFile->ReadAt(offset, buffer, requestCount, theActualCount)) return kAudioFilePositionError;
+	if (actualCount) *actualCount = theActualCount;
+	mOffset = offset + theActualCount;
+	return noErr;
+}
+
+OSStatus WriteBehind_DataSource::WriteBytes(
+							UInt16 positionMode, 
+							SInt64 positionOffset, 
+							UInt32 requestCount, 
+							const void *buffer, 
+							UInt32* actualCount)
+{
+	if (!buffer) return kAudio_ParamError;
+	if (!mFile->IsValid()) return kAudioFilePermissionsError;
+
+	SInt64 offset = CalcOffset(positionMode & kPositionModeMask, positionOffset, mOffset, mFile->GetSize());
+	if (offset < 0) return kAudioFilePositionError;
+	
+	mFile->WriteAt(offset, buffer, requestCount);
+	if (actualCount) *actualCount = requestCount;
+	mOffset = offset + requestCount;
+	return noErr;
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
 OSStatus Buffer_DataSource::ReadBytes(
 								UInt16 positionMode, 
 								SInt64 positionOffset, 
@@ -57,6 +57,9 @@
 #include <stdio.h>
 #include <stdexcept>
 #include "CAAutoDisposer.h"
+#if !TARGET_OS_WIN32
+	#include "CAWriteBehindFile.h"
+#endif
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
@@ -328,6 +331,50 @@ public:
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
+#if !TARGET_OS_WIN32
+
+/*
+	Writes through a CAWriteBehindFile, so the thread writing the audio file never waits for the disk.
+	Data the file had to drop for lack of free blocks is not an error here; it reads back as zeros
+	and is counted in the file's metrics.
+*/
+class WriteBehind_DataSource : public DataSource
+{
+	CAWriteBehindFile* mFile;
+	SInt64 mOffset;
+	
+public:
+	WriteBehind_DataSource(CAWriteBehindFile* inFile, Boolean inCloseOnDelete);
+	virtual ~WriteBehind_DataSource();
+	
+	virtual OSStatus GetSize(SInt64& outSize) { outSize = mFile->GetSize(); return noErr; }
+	virtual OSStatus GetPos(SInt64& outPos) const { outPos = mOffset; return noErr; }; 
+	
+	virtual OSStatus SetSize(SInt64 inSize);
+	
+	virtual OSStatus ReadBytes(	UInt16 positionMode, 
+								SInt64 positionOffset, 
+								UInt32 requestCount, 
+								void *buffer, 
+								UInt32* actualCount);
+						
+	virtual OSStatus WriteBytes(UInt16 positionMode, 
+								SInt64 positionOffset, 
+								UInt32 requestCount, 
+								const void *buffer, 
+								UInt32* actualCount);
+
+	virtual Boolean CanSeek() const { return true; }
+	virtual Boolean CanGetSize() const { return true; }
+	virtual Boolean CanSetSize() const { return true; }
+	virtual Boolean CanRead() const { return true; }
+	virtual Boolean CanWrite() const { return true; }
+};
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
 class Buffer_DataSource : public DataSource
 {
 	UInt32 mDataByteSize;
@@ -1144,8 +1144,11 @@ OSStatus			AUBase::SetRenderNotification(	AURenderCallback		 		inProc,
 		return kAudio_ParamError;
 
 	mRenderCallbacksTouched = true;
-	mRenderCallbacks.deferred_add(RenderCallback(inProc, inRefCon));
-			// this will do nothing if it's already in the list
+	mRenderCallbacks.update();
+			// so that a queued removal of this same callback can't undo the add
+	mRenderCallbacks.add(RenderCallback(inProc, inRefCon));
+			// this will do nothing if it's already in the list; render threads see the
+			// change from their next render on, without waiting or freeing anything
 	return noErr;
 }
 
@@ -1155,6 +1158,8 @@ OSStatus			AUBase::RemoveRenderNotification(	AURenderCallback			inProc,
 														void *						inRefCon)
 {
 	mRenderCallbacks.deferred_remove(RenderCallback(inProc, inRefCon));
+			// the next render applies it without allocating or waiting, so this may be
+			// called from a render notification
 	return noErr;	// error?
 }
 
@@ -1395,12 +1400,16 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 			#endif
 		}
 		
+		// pre- and post-render notifications go to the same callbacks, whatever other
+		// threads add or remove meanwhile
+		if (mRenderCallbacksTouched)
+			mRenderCallbacks.try_update();
+		RenderCallbackList::Reader renderCallbacks(mRenderCallbacks);
 		AudioUnitRenderActionFlags flags;
 		if (mRenderCallbacksTouched) {
-			mRenderCallbacks.update();
 			flags = ioActionFlags | kAudioUnitRenderAction_PreRender;
-			for (rcit = mRenderCallbacks.begin(); rcit != mRenderCallbacks.end(); ++rcit) {
-				RenderCallback &rc = *rcit;
+			for (rcit = renderCallbacks.begin(); rcit != renderCallbacks.end(); ++rcit) {
+				const RenderCallback &rc = *rcit;
 				AUTRACE(kCATrace_AUBaseRenderCallbackStart, mComponentInstance, (intptr_t)this, (intptr_t)rc.mRenderNotify, 1, 0);
 				(*(AURenderCallback)rc.mRenderNotify)(rc.mRenderNotifyRefCon, 
 								&flags,
@@ -1418,8 +1427,8 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 		}
 		
 		if (mRenderCallbacksTouched) {
-			for (rcit = mRenderCallbacks.begin(); rcit != mRenderCallbacks.end(); ++rcit) {
-				RenderCallback &rc = *rcit;
+			for (rcit = renderCallbacks.begin(); rcit != renderCallbacks.end(); ++rcit) {
+				const RenderCallback &rc = *rcit;
 				AUTRACE(kCATrace_AUBaseRenderCallbackStart, mComponentInstance, (intptr_t)this, (intptr_t)rc.mRenderNotify, 2, 0);
 				(*(AURenderCallback)rc.mRenderNotify)(rc.mRenderNotifyRefCon, 
 								&flags,
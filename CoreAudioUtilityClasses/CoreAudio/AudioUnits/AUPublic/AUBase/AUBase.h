@@ -64,7 +64,7 @@
 #include "AUOutputElement.h"
 #include "AUBuffer.h"
 #include "CAMath.h"
-#include "CAThreadSafeList.h"
+#include "CARCUList.h"
 #include "CAVectorUnit.h"
 #if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
 	#include <AudioUnit/AudioUnit.h>
@@ -894,7 +894,7 @@ private:
 					this->mRenderNotifyRefCon == other.mRenderNotifyRefCon;
 		}
 	};
-	typedef TThreadSafeList<RenderCallback>	RenderCallbackList;
+	typedef TRCUList<RenderCallback>			RenderCallbackList;
 	
 #if !CA_BASIC_AU_FEATURES
 	enum { kNumScopes = 4 };
@@ -76,6 +76,8 @@ public:
 	bool				IsCallback() const { return mInputType == kFromCallback; }
 	/*! @method HasConnection */
 	bool				HasConnection() const { return mInputType == kFromConnection; }
+	/*! @method GetConnection */
+	const AudioUnitConnection &	GetConnection() const { return mConnection; }
 
 	/*! @method PullInput */
 	OSStatus			PullInput(	AudioUnitRenderActionFlags &  	ioActionFlags,
@@ -89,6 +89,10 @@ OSStatus			AUMIDIBase::DelegateGetPropertyInfo(AudioUnitPropertyID				inID,
 {
 	OSStatus result = noErr;
 	
+#if CA_AUTO_MIDI_MAP
+	mMapManager->CommitHotMapping (mAUBaseInstance);
+#endif
+
 	switch (inID) {
 #if !TARGET_OS_IPHONE
 	case kMusicDeviceProperty_MIDIXMLNames:
@@ -156,6 +160,10 @@ OSStatus			AUMIDIBase::DelegateGetProperty(	AudioUnitPropertyID 			inID,
 {
 	OSStatus result;
 	
+#if CA_AUTO_MIDI_MAP
+	mMapManager->CommitHotMapping (mAUBaseInstance);
+#endif
+
 	switch (inID) {
 #if !TARGET_OS_IPHONE
 	case kMusicDeviceProperty_MIDIXMLNames:
@@ -208,6 +216,10 @@ OSStatus			AUMIDIBase::DelegateSetProperty(	AudioUnitPropertyID 			inID,
 {
 	OSStatus result;
 	
+#if CA_AUTO_MIDI_MAP
+	mMapManager->CommitHotMapping (mAUBaseInstance);
+#endif
+
 	switch (inID) {
 #if CA_AUTO_MIDI_MAP
 		case kAudioUnitProperty_AddParameterMIDIMapping:{
@@ -236,7 +248,7 @@ OSStatus			AUMIDIBase::DelegateSetProperty(	AudioUnitPropertyID 			inID,
 			ca_require(inScope == kAudioUnitScope_Global, InvalidScope);
 			ca_require(inElement == 0, InvalidElement);
 			AUParameterMIDIMapping & map = *((AUParameterMIDIMapping*)inData);
-			mMapManager->SetHotMapping (map);			
+			mMapManager->SetHotMapping (map, mAUBaseInstance);			
 			result = noErr;
 			break;
 		}
@@ -47,7 +47,6 @@
 #include "AUPannerBase.h"
 #include "CABundleLocker.h"
 #include <AudioToolbox/AudioToolbox.h>
-#include <Accelerate/Accelerate.h>
 
 static bool sLocalized = false;
 
@@ -130,6 +129,7 @@ void		AUPannerBase::AllocBypassMatrix()
 	UInt32 inChannels = GetNumberOfInputChannels();
 	UInt32 outChannels = GetNumberOfOutputChannels();
 	mBypassMatrix.alloc(inChannels * outChannels, true);
+	mBypassMixer.SetDimensions(inChannels, outChannels);
 }
 
 static AudioChannelLayoutTag DefaultTagForNumberOfChannels(UInt32 inNumberChannels)
@@ -217,6 +217,11 @@ OSStatus			AUPannerBase::UpdateBypassMatrix()
 		}
 	}
 
+	// compile the matrix into the schedule BypassRender uses; this skips the zero entries,
+	// which are most of a typical bypass matrix
+	mBypassMixer.SetDimensions(inChannels, outChannels);
+	mBypassMixer.SetGains(mBypassMatrix());
+
     return noErr;
 }
 
@@ -482,24 +487,16 @@ OSStatus 	AUPannerBase::BypassRender(AudioUnitRenderActionFlags &		ioActionFlags
 	bool isSilent = xflags & kAudioUnitRenderAction_OutputIsSilence;
 
 	AudioBufferList& outputBufferList = GetOutput(0)->GetBufferList();
-	AUBufferList::ZeroBuffer(outputBufferList);
 	
-	if (!isSilent) 
+	if (isSilent || mBypassMixer.GetNumberInputs() != GetNumberOfInputChannels()
+				 || mBypassMixer.GetNumberOutputs() != GetNumberOfOutputChannels())
 	{
-		UInt32 inChannels = GetNumberOfInputChannels();
-		UInt32 outChannels = GetNumberOfOutputChannels();
-		Float32* bypass = mBypassMatrix();
-		for (UInt32 outChan = 0; outChan < outChannels; ++outChan)
-		{
-			float* outData = GetOutput(0)->GetChannelData(outChan);	
-			
-			for (UInt32 inChan = 0; inChan < inChannels; ++inChan)
-			{
-				float* inData = GetInput(0)->GetChannelData(inChan);
-				float *amp = bypass + (inChan * outChannels + outChan);
-				vDSP_vsma(inData, 1, amp, outData, 1, outData, 1, inNumberFrames);
-			}
-		}
+		AUBufferList::ZeroBuffer(outputBufferList);
+	}
+	else
+	{
+		// each output is cleared, copied, or mixed from only the inputs that feed it
+		mBypassMixer.Render(GetInput(0)->GetBufferList(), outputBufferList, inNumberFrames);
 	}
     return noErr;
 }
@@ -51,6 +51,7 @@
 #include <math.h>
 #include "CAAutoDisposer.h"
 #include "CAAudioChannelLayout.h"
+#include "CAMixingMatrix.h"
 
 
 /*! @class AUPannerBase */
@@ -260,6 +261,8 @@ private:
 	bool mBypassEffect;
 	/*! @var mBypassMatrix */
 	CAAutoFree<Float32> mBypassMatrix;
+	/*! @var mBypassMixer */
+	CAMixingMatrix mBypassMixer;
 	/*! @var mInputLayout */
 	CAAudioChannelLayout mInputLayout;
 	/*! @var mOutputLayout */
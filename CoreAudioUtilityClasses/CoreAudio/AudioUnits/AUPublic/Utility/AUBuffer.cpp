@@ -79,8 +79,7 @@ void				AUBufferList::Allocate(const CAStreamBasicDescription &format, UInt32 nF
 		mPtrs = (AudioBufferList *)CA_realloc(mPtrs, SafeMultiplyAddUInt32(nStreams, sizeof(AudioBuffer), offsetof(AudioBufferList, mBuffers)));
 		mAllocatedStreams = nStreams;
 	}
-	UInt32 bytesPerStream = SafeMultiplyAddUInt32(nFrames, format.mBytesPerFrame, 0xF) & ~0xF;
-	UInt32 nBytes = SafeMultiplyAddUInt32(nStreams, bytesPerStream, 0);
+	UInt32 nBytes = AllocationSize(format, nFrames);
 	if (nBytes > mAllocatedBytes) {
 		if (mExternalMemory) {
 			mExternalMemory = false;
@@ -93,6 +92,13 @@ void				AUBufferList::Allocate(const CAStreamBasicDescription &format, UInt32 nF
 	mPtrState = kPtrsInvalid;
 }
 
+UInt32				AUBufferList::AllocationSize(const CAStreamBasicDescription &format, UInt32 nFrames)
+{
+	UInt32 nStreams = format.IsInterleaved() ? 1 : format.mChannelsPerFrame;
+	UInt32 bytesPerStream = SafeMultiplyAddUInt32(nFrames, format.mBytesPerFrame, 0xF) & ~0xF;
+	return SafeMultiplyAddUInt32(nStreams, bytesPerStream, 0);
+}
+
 void				AUBufferList::Deallocate()
 {
 	mAllocatedStreams = 0;
@@ -183,13 +189,16 @@ void		AUBufferList::UseExternalBuffer(const CAStreamBasicDescription &format, co
 		// don't accept the buffer if we already have one and it's big enough
 		// if we don't already have one, we don't need one
 		Byte *oldMemory = mMemory;
+		bool oldMemoryIsExternal = mExternalMemory;
 		mMemory = buf.buffer;
 		mAllocatedBytes = alignedSize;
 		// from Allocate(): nBytes = nStreams * nFrames * format.mBytesPerFrame;	
 		// thus: nFrames = nBytes / (nStreams * format.mBytesPerFrame)
 		mAllocatedFrames = mAllocatedBytes / (format.NumberChannelStreams() * format.mBytesPerFrame);
 		mExternalMemory = true;
-		free(oldMemory);
+		// a previous external buffer belongs to whoever supplied it (e.g. an AUBufferPlanner arena)
+		if (!oldMemoryIsExternal)
+			free(oldMemory);
 	}
 }
 
@@ -137,6 +137,9 @@ public:
 	
 	/*! @method Allocate */
 	void				Allocate(const CAStreamBasicDescription &format, UInt32 nFrames);
+	/*! @method AllocationSize */
+	static UInt32		AllocationSize(const CAStreamBasicDescription &format, UInt32 nFrames);
+							// the bytes Allocate needs: one 16-byte aligned stream per buffer
 	/*! @method Deallocate */
 	void				Deallocate();
 	
@@ -0,0 +1,272 @@
+/*
+     File: AUBufferPlanner.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+#include "AUBufferPlanner.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <new>
+
+namespace {
+	struct InputOrder {
+		template <class T>
+		bool operator()(const T &a, const T &b) const { return a.mInput < b.mInput; }
+	};
+
+	struct Placement {
+		UInt32		mRoot;
+		UInt64		mSize;
+		bool operator<(const Placement &other) const { return mSize > other.mSize; }
+	};
+
+	struct Range {
+		UInt64		mStart;
+		UInt64		mEnd;
+		bool operator<(const Range &other) const { return mStart < other.mStart; }
+	};
+}
+
+AUBufferPlanner::AUBufferPlanner() :
+	mArena(NULL),
+	mPreviousArena(NULL),
+	mArenaBytes(0),
+	mUnpooledBytes(0)
+{
+}
+
+AUBufferPlanner::~AUBufferPlanner()
+{
+	free(mArena);
+	free(mPreviousArena);
+}
+
+void		AUBufferPlanner::Reset()
+{
+	mNodes.clear();
+	mBuffers.clear();
+}
+
+UInt32		AUBufferPlanner::AddNode(bool inProcessesInPlace)
+{
+	mNodes.push_back(Node());
+	Node &node = mNodes.back();
+	node.mProcessesInPlace = inProcessesInPlace;
+	node.mEnter = node.mExit = node.mState = 0;
+	return static_cast<UInt32>(mNodes.size() - 1);
+}
+
+UInt32		AUBufferPlanner::AddOutput(UInt32 inNode, UInt32 inBytes)
+{
+	Buffer buffer = { inNode, inBytes, 0, 0, 0, 0 };
+	mBuffers.push_back(buffer);
+	UInt32 index = static_cast<UInt32>(mBuffers.size() - 1);
+	mNodes[inNode].mOutputs.push_back(index);
+	return index;
+}
+
+UInt32		AUBufferPlanner::AddCallbackInput(UInt32 inNode, UInt32 inInput, UInt32 inBytes)
+{
+	Buffer buffer = { inNode, inBytes, 0, 0, 0, 0 };
+	mBuffers.push_back(buffer);
+	UInt32 index = static_cast<UInt32>(mBuffers.size() - 1);
+	Input input = { inInput, kNoBuffer, 0, index };
+	mNodes[inNode].mInputs.push_back(input);
+	return index;
+}
+
+void		AUBufferPlanner::Connect(UInt32 inSourceNode, UInt32 inSourceOutput, UInt32 inDestinationNode, UInt32 inDestinationInput)
+{
+	Input input = { inDestinationInput, inSourceNode, inSourceOutput, kNoBuffer };
+	mNodes[inDestinationNode].mInputs.push_back(input);
+}
+
+// Depth first, as the units pull each other; a node already rendered this cycle, or being
+// rendered (a cycle, which a graph shouldn't have), is not rendered again.
+void		AUBufferPlanner::Visit(UInt32 inNode, UInt32 &ioStep)
+{
+	mNodes[inNode].mState = 1;
+	mNodes[inNode].mEnter = ioStep++;
+	for (size_t i = 0; i < mNodes[inNode].mInputs.size(); ++i) {
+		UInt32 source = mNodes[inNode].mInputs[i].mSourceNode;
+		if (source != kNoBuffer && mNodes[source].mState == 0)
+			Visit(source, ioStep);
+	}
+	mNodes[inNode].mExit = ioStep++;
+	mNodes[inNode].mState = 2;
+}
+
+UInt32		AUBufferPlanner::FindShare(UInt32 inBuffer)
+{
+	while (mBuffers[inBuffer].mShare != inBuffer) {
+		mBuffers[inBuffer].mShare = mBuffers[mBuffers[inBuffer].mShare].mShare;
+		inBuffer = mBuffers[inBuffer].mShare;
+	}
+	return inBuffer;
+}
+
+void		AUBufferPlanner::Plan()
+{
+	const UInt32 nNodes = static_cast<UInt32>(mNodes.size());
+	const UInt32 nBuffers = static_cast<UInt32>(mBuffers.size());
+
+	// Render order. Resolve each connection to its source's output buffer, and start from
+	// the nodes nothing reads from.
+	std::vector<bool> isRead(nNodes, false);
+	for (UInt32 n = 0; n < nNodes; ++n) {
+		Node &node = mNodes[n];
+		node.mState = 0;
+		std::stable_sort(node.mInputs.begin(), node.mInputs.end(), InputOrder());
+		for (size_t i = 0; i < node.mInputs.size(); ++i) {
+			Input &input = node.mInputs[i];
+			if (input.mSourceNode == kNoBuffer)
+				continue;
+			const std::vector<UInt32> &outputs = mNodes[input.mSourceNode].mOutputs;
+			input.mBuffer = input.mSourceOutput < outputs.size() ? outputs[input.mSourceOutput] : kNoBuffer;
+			isRead[input.mSourceNode] = true;
+		}
+	}
+	UInt32 step = 0;
+	for (UInt32 n = 0; n < nNodes; ++n)
+		if (!isRead[n])
+			Visit(n, step);
+	for (UInt32 n = 0; n < nNodes; ++n)		// only reachable through a cycle
+		if (mNodes[n].mState == 0)
+			Visit(n, step);
+	const UInt32 endOfCycle = step;
+
+	// Lifetimes. Outputs start out live until the end of the cycle, which is shortened to
+	// their last reader if they have any.
+	for (UInt32 b = 0; b < nBuffers; ++b) {
+		Buffer &buffer = mBuffers[b];
+		buffer.mShare = b;
+		buffer.mFirst = mNodes[buffer.mNode].mExit;
+		buffer.mLast = endOfCycle;
+	}
+	std::vector<bool> isReadBuffer(nBuffers, false);
+	for (UInt32 n = 0; n < nNodes; ++n) {
+		const Node &node = mNodes[n];
+		for (size_t i = 0; i < node.mInputs.size(); ++i) {
+			const Input &input = node.mInputs[i];
+			if (input.mBuffer == kNoBuffer)
+				continue;
+			Buffer &buffer = mBuffers[input.mBuffer];
+			if (input.mSourceNode == kNoBuffer) {
+				buffer.mFirst = node.mEnter;
+				buffer.mLast = node.mExit;
+			} else {
+				buffer.mLast = isReadBuffer[input.mBuffer] ? std::max(buffer.mLast, node.mExit) : node.mExit;
+				isReadBuffer[input.mBuffer] = true;
+			}
+		}
+	}
+
+	// In place: output 0 is rendered into input 0's buffer, so that buffer is read for as
+	// long as the output is, and the output's own memory, unused, may as well be the same.
+	std::vector<UInt32> groupBytes(nBuffers);
+	for (UInt32 b = 0; b < nBuffers; ++b)
+		groupBytes[b] = mBuffers[b].mBytes;
+	for (UInt32 n = 0; n < nNodes; ++n) {
+		const Node &node = mNodes[n];
+		if (!node.mProcessesInPlace || node.mOutputs.empty() || node.mInputs.empty() || node.mInputs[0].mInput != 0
+		|| node.mInputs[0].mBuffer == kNoBuffer)
+			continue;
+		UInt32 in = FindShare(node.mInputs[0].mBuffer), out = FindShare(node.mOutputs[0]);
+		if (in == out)
+			continue;
+		mBuffers[out].mShare = in;
+		mBuffers[in].mFirst = std::min(mBuffers[in].mFirst, mBuffers[out].mFirst);
+		mBuffers[in].mLast = std::max(mBuffers[in].mLast, mBuffers[out].mLast);
+		groupBytes[in] = std::max(groupBytes[in], groupBytes[out]);
+	}
+
+	// Place the groups sharing memory, largest first.
+	std::vector<Placement> order;
+	UInt64 unpooled = 0;
+	for (UInt32 b = 0; b < nBuffers; ++b) {
+		unpooled += mBuffers[b].mBytes;
+		if (FindShare(b) == b && groupBytes[b] != 0) {
+			Placement p = { b, (UInt64(groupBytes[b]) + kAlignment - 1) & ~UInt64(kAlignment - 1) };
+			order.push_back(p);
+		}
+	}
+	std::stable_sort(order.begin(), order.end());
+
+	std::vector<Range> placed(order.size()), overlapping;
+	overlapping.reserve(order.size());
+	UInt64 arenaBytes = 0;
+	for (size_t i = 0; i < order.size(); ++i) {
+		Buffer &buffer = mBuffers[order[i].mRoot];
+		overlapping.clear();
+		for (size_t j = 0; j < i; ++j) {
+			const Buffer &other = mBuffers[order[j].mRoot];
+			if (other.mFirst <= buffer.mLast && buffer.mFirst <= other.mLast)
+				overlapping.push_back(placed[j]);
+		}
+		std::sort(overlapping.begin(), overlapping.end());
+		UInt64 offset = 0;
+		for (size_t j = 0; j < overlapping.size(); ++j) {
+			if (offset + order[i].mSize <= overlapping[j].mStart)
+				break;
+			offset = std::max(offset, overlapping[j].mEnd);
+		}
+		placed[i].mStart = offset;
+		placed[i].mEnd = offset + order[i].mSize;
+		arenaBytes = std::max(arenaBytes, placed[i].mEnd);
+		buffer.mOffset = static_cast<UInt32>(offset);
+	}
+	if (arenaBytes > 0xFFFFFFFF || unpooled > 0xFFFFFFFF)
+		throw std::bad_alloc();
+	for (UInt32 b = 0; b < nBuffers; ++b)
+		mBuffers[b].mOffset = mBuffers[FindShare(b)].mOffset;
+
+	void *arena = NULL;
+	if (posix_memalign(&arena, kAlignment, std::max<size_t>(size_t(arenaBytes), kAlignment)) != 0)
+		throw std::bad_alloc();
+	free(mPreviousArena);
+	mPreviousArena = mArena;
+	mArena = static_cast<Byte *>(arena);
+	mArenaBytes = static_cast<UInt32>(arenaBytes);
+	mUnpooledBytes = static_cast<UInt32>(unpooled);
+}
@@ -0,0 +1,187 @@
+/*
+     File: AUBufferPlanner.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+#ifndef __AUBufferPlanner_h__
+#define __AUBufferPlanner_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+#include <vector>
+
+// AUBufferPlanner lays out the I/O buffers of a render graph in one aligned arena, instead
+// of every element allocating its own (see AUBufferList::Allocate). Buffers that are never
+// live at the same time share memory.
+//
+// The graph is described as nodes (units), each with output buffers and buffers for inputs
+// fed by render callbacks, and connections from a node's output to another node's input.
+// Render order is the order the units pull each other in: depth first from the nodes whose
+// outputs aren't connected to anything, inputs in element order, each node rendering once per
+// cycle however many nodes it feeds. A node is assumed to pull all of its inputs before it
+// writes its outputs, so an output is live from the moment its node finishes rendering
+// until the last node reading it finishes; outputs nothing reads stay live until the end of
+// the cycle, for the host. A callback input's buffer is live while its node renders.
+//
+// A node that processes in place (as AUEffectBase can) renders its output 0 into the buffer of
+// its input 0; they get the same memory, which stays live as long as either is used.
+//
+// Offsets are assigned greedily, largest buffer first, each at the lowest offset where it
+// doesn't overlap a buffer whose lifetime intersects its own. Node, buffer and connection
+// storage is reserved as the graph is described; Plan allocates the new arena and keeps
+// the previous one until the next Plan, so units can be moved over while it's still valid.
+// None of this may be done while the graph renders.
+//
+// See PlanGraphBuffers in AUGraphBuffers.h for laying out the elements of AUBase instances.
+
+	/*! @class AUBufferPlanner */
+class AUBufferPlanner {
+public:
+	enum {
+		kAlignment = 64,			// cache line; every buffer starts on one
+		kNoBuffer = 0xFFFFFFFF
+	};
+
+	/*! @ctor AUBufferPlanner */
+	AUBufferPlanner();
+	/*! @dtor ~AUBufferPlanner */
+	~AUBufferPlanner();
+
+	/*! @method Reset */
+	void				Reset();
+							// forgets the graph; the arena lives on until the next Plan
+
+	/*! @method AddNode */
+	UInt32				AddNode(bool inProcessesInPlace = false);
+							// returns the node's index; nodes are rendered in the order above,
+							// not the order they're added
+	/*! @method AddOutput */
+	UInt32				AddOutput(UInt32 inNode, UInt32 inBytes);
+							// the node's next output element; returns the buffer's index.
+							// 0 bytes for an output that has no buffer of its own
+	/*! @method AddCallbackInput */
+	UInt32				AddCallbackInput(UInt32 inNode, UInt32 inInput, UInt32 inBytes);
+							// returns the buffer's index
+	/*! @method Connect */
+	void				Connect(UInt32 inSourceNode, UInt32 inSourceOutput, UInt32 inDestinationNode, UInt32 inDestinationInput);
+
+	/*! @method Plan */
+	void				Plan();
+							// throws std::bad_alloc
+
+	/*! @method GetNumberBuffers */
+	UInt32				GetNumberBuffers() const { return static_cast<UInt32>(mBuffers.size()); }
+	/*! @method GetBufferBytes */
+	UInt32				GetBufferBytes(UInt32 inBuffer) const { return mBuffers[inBuffer].mBytes; }
+	/*! @method GetBufferMemory */
+	Byte *				GetBufferMemory(UInt32 inBuffer) const {
+							return mBuffers[inBuffer].mBytes != 0 ? mArena + mBuffers[inBuffer].mOffset : NULL;
+						}
+	/*! @method GetBufferLifetime */
+	void				GetBufferLifetime(UInt32 inBuffer, UInt32 &outFirst, UInt32 &outLast) const {
+							outFirst = mBuffers[inBuffer].mFirst;
+							outLast = mBuffers[inBuffer].mLast;
+						}
+							// in render steps; 2 per node
+
+	/*! @method GetArenaBytes */
+	UInt32				GetArenaBytes() const { return mArenaBytes; }
+	/*! @method GetUnpooledBytes */
+	UInt32				GetUnpooledBytes() const { return mUnpooledBytes; }
+							// what the buffers take allocated separately
+
+private:
+	struct Buffer {
+		UInt32		mNode;
+		UInt32		mBytes;
+		UInt32		mFirst;			// render steps
+		UInt32		mLast;
+		UInt32		mShare;			// the buffer whose memory this one uses, or itself
+		UInt32		mOffset;
+	};
+
+	struct Input {
+		UInt32		mInput;			// element
+		UInt32		mSourceNode;	// kNoBuffer for a callback
+		UInt32		mSourceOutput;
+		UInt32		mBuffer;		// the callback's buffer, or the source's output
+	};
+
+	struct Node {
+		bool					mProcessesInPlace;
+		UInt32					mEnter;			// render steps
+		UInt32					mExit;
+		UInt32					mState;			// while ordering
+		std::vector<UInt32>		mOutputs;		// buffers, by element
+		std::vector<Input>		mInputs;		// by element once ordered
+	};
+
+	/*! @ctor AUBufferPlanner */
+	AUBufferPlanner(const AUBufferPlanner &);	// prohibit copy constructor
+	AUBufferPlanner &	operator=(const AUBufferPlanner &);
+
+	/*! @method Visit */
+	void				Visit(UInt32 inNode, UInt32 &ioStep);
+	/*! @method FindShare */
+	UInt32				FindShare(UInt32 inBuffer);
+
+	/*! @var mNodes */
+	std::vector<Node>			mNodes;
+	/*! @var mBuffers */
+	std::vector<Buffer>			mBuffers;
+	/*! @var mArena */
+	Byte *						mArena;
+	/*! @var mPreviousArena */
+	Byte *						mPreviousArena;
+	/*! @var mArenaBytes */
+	UInt32						mArenaBytes;
+	/*! @var mUnpooledBytes */
+	UInt32						mUnpooledBytes;
+};
+
+#endif // __AUBufferPlanner_h__
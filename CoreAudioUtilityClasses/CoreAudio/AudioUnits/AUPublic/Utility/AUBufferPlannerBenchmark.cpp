@@ -0,0 +1,517 @@
+/*
+     File: AUBufferPlannerBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+// Benchmark and check for AUBufferPlanner.
+//
+// Simulates rendering a graph the way AUBase units pull each other, with every buffer either
+// allocated separately (as each element's AUBufferList does) or laid out by the planner,
+// and checks that both give the same output: a buffer still being read can't have been
+// overwritten. Random graphs with fan-in, fan-out, callback inputs and in-place nodes are
+// checked first, then a 50-node chain is timed both ways, in alternating batches so that a
+// busy machine slows both alike, and fails if the arena is more than 10% slower. The memory
+// used and the misses of a simulated 2MB, 16-way LRU L2 cache over the chain's accesses are
+// reported, along with hardware cache miss counts where perf events are available.
+//
+// The planner has no dependencies beyond CoreAudioTypes.h, so this builds on other
+// platforms too given that header, e.g.:
+//	c++ -O3 -o AUBufferPlannerBenchmark AUBufferPlannerBenchmark.cpp AUBufferPlanner.cpp
+
+#include "AUBufferPlanner.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__linux__)
+	#include <linux/perf_event.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
+
+static double Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+// ____________________________________________________________________________
+// A simulated graph of units, each with one or more outputs of Float32 samples.
+
+struct SimInput {
+	int			mSourceNode;		// -1 for a callback
+	int			mSourceOutput;
+	int			mBuffer;			// the callback's buffer
+};
+
+struct SimNode {
+	bool						mProcessesInPlace;
+	std::vector<int>			mOutputs;		// buffers
+	std::vector<SimInput>		mInputs;
+	bool						mRendered;
+};
+
+struct SimGraph {
+	std::vector<SimNode>		mNodes;
+	std::vector<UInt32>			mSamples;		// per buffer
+	std::vector<Float32 *>		mMemory;		// per buffer
+	std::vector<bool>			mIsRead;		// per node
+	std::vector<Float32 *>		mRendered;		// where each output ended up, per buffer
+	UInt32						mCycle;
+
+	int		AddBuffer(UInt32 samples) { mSamples.push_back(samples); return int(mSamples.size() - 1); }
+
+	void	Describe(AUBufferPlanner &planner) const
+	{
+		planner.Reset();
+		for (size_t n = 0; n < mNodes.size(); ++n)
+			planner.AddNode(mNodes[n].mProcessesInPlace);
+		for (size_t n = 0; n < mNodes.size(); ++n) {
+			const SimNode &node = mNodes[n];
+			for (size_t o = 0; o < node.mOutputs.size(); ++o)
+				planner.AddOutput(UInt32(n), mSamples[node.mOutputs[o]] * sizeof(Float32));
+			for (size_t i = 0; i < node.mInputs.size(); ++i) {
+				if (node.mInputs[i].mSourceNode < 0)
+					planner.AddCallbackInput(UInt32(n), UInt32(i), mSamples[node.mInputs[i].mBuffer] * sizeof(Float32));
+				else
+					planner.Connect(node.mInputs[i].mSourceNode, node.mInputs[i].mSourceOutput, UInt32(n), UInt32(i));
+			}
+		}
+	}
+
+	// the planner numbers buffers in the order Describe adds them: node by node, outputs
+	// then callbacks
+	void	UsePlan(const AUBufferPlanner &planner)
+	{
+		mMemory.assign(mSamples.size(), NULL);
+		UInt32 b = 0;
+		for (size_t n = 0; n < mNodes.size(); ++n) {
+			const SimNode &node = mNodes[n];
+			for (size_t o = 0; o < node.mOutputs.size(); ++o)
+				mMemory[node.mOutputs[o]] = reinterpret_cast<Float32 *>(planner.GetBufferMemory(b++));
+			for (size_t i = 0; i < node.mInputs.size(); ++i)
+				if (node.mInputs[i].mSourceNode < 0)
+					mMemory[node.mInputs[i].mBuffer] = reinterpret_cast<Float32 *>(planner.GetBufferMemory(b++));
+		}
+	}
+
+	void	Render(int n)
+	{
+		SimNode &node = mNodes[n];
+		node.mRendered = true;
+		std::vector<const Float32 *> in(node.mInputs.size());
+		std::vector<UInt32> inSamples(node.mInputs.size());
+		for (size_t i = 0; i < node.mInputs.size(); ++i) {
+			const SimInput &input = node.mInputs[i];
+			if (input.mSourceNode < 0) {
+				Float32 *p = mMemory[input.mBuffer];
+				for (UInt32 k = 0; k < mSamples[input.mBuffer]; ++k)
+					p[k] = Float32((k * 7 + n * 13 + mCycle) % 101) * 0.01f;
+				in[i] = p;
+				inSamples[i] = mSamples[input.mBuffer];
+			} else {
+				if (!mNodes[input.mSourceNode].mRendered)
+					Render(input.mSourceNode);
+				int buffer = mNodes[input.mSourceNode].mOutputs[input.mSourceOutput];
+				in[i] = mRendered[buffer];
+				inSamples[i] = mSamples[buffer];
+			}
+		}
+		// the node writes its outputs after pulling everything
+		for (size_t o = 0; o < node.mOutputs.size(); ++o) {
+			int buffer = node.mOutputs[o];
+			const UInt32 samples = mSamples[buffer];
+			Float32 *out = mMemory[buffer];
+			if (o == 0 && node.mProcessesInPlace && !in.empty())
+				out = const_cast<Float32 *>(in[0]);		// the same format, so the same size
+			const Float32 bias = 0.001f * (n + 1) * (o + 1);
+			if (in.size() == 1 && inSamples[0] == samples) {
+				const Float32 *p = in[0];
+				for (UInt32 k = 0; k < samples; ++k)
+					out[k] = bias + 0.5f * p[k];
+			} else {
+				for (UInt32 k = 0; k < samples; ++k) {
+					Float32 sum = bias;
+					for (size_t i = 0; i < in.size(); ++i)
+						sum += 0.5f * in[i][k % inSamples[i]];
+					out[k] = sum;
+				}
+			}
+			mRendered[buffer] = out;
+		}
+	}
+
+	double	RenderCycle()
+	{
+		mRendered.assign(mSamples.size(), NULL);
+		for (size_t n = 0; n < mNodes.size(); ++n)
+			mNodes[n].mRendered = false;
+		for (size_t n = 0; n < mNodes.size(); ++n)
+			if (!mIsRead[n])
+				Render(int(n));
+		// the host reads what nothing else does
+		double sum = 0;
+		for (size_t n = 0; n < mNodes.size(); ++n)
+			if (!mIsRead[n])
+				for (size_t o = 0; o < mNodes[n].mOutputs.size(); ++o) {
+					int buffer = mNodes[n].mOutputs[o];
+					for (UInt32 k = 0; k < mSamples[buffer]; ++k)
+						sum += mRendered[buffer][k] * (1 + (k & 7));
+				}
+		++mCycle;
+		return sum;
+	}
+
+	void	Finish()
+	{
+		mIsRead.assign(mNodes.size(), false);
+		for (size_t n = 0; n < mNodes.size(); ++n)
+			for (size_t i = 0; i < mNodes[n].mInputs.size(); ++i)
+				if (mNodes[n].mInputs[i].mSourceNode >= 0)
+					mIsRead[mNodes[n].mInputs[i].mSourceNode] = true;
+		mCycle = 0;
+	}
+};
+
+// Separate allocations, as every AUBufferList makes its own.
+struct PrivateBuffers {
+	std::vector<Float32 *>	mMemory;
+	UInt64					mBytes;
+
+	void	Allocate(SimGraph &graph)
+	{
+		mBytes = 0;
+		for (size_t b = 0; b < graph.mSamples.size(); ++b) {
+			mMemory.push_back(static_cast<Float32 *>(malloc(graph.mSamples[b] * sizeof(Float32))));
+			mBytes += graph.mSamples[b] * sizeof(Float32);
+		}
+		graph.mMemory = mMemory;
+	}
+	~PrivateBuffers() { for (size_t b = 0; b < mMemory.size(); ++b) free(mMemory[b]); }
+};
+
+static SimGraph RandomGraph(int nodes)
+{
+	SimGraph graph;
+	for (int n = 0; n < nodes; ++n) {
+		SimNode node;
+		node.mProcessesInPlace = rand() % 3 == 0;
+		node.mRendered = false;
+		const int outputs = rand() % 4 == 0 ? 2 : 1;
+		const int inputs = n == 0 ? 1 : rand() % 3;
+		for (int i = 0; i < inputs; ++i) {
+			SimInput input;
+			if (n == 0 || rand() % 4 == 0) {
+				input.mSourceNode = -1;
+				input.mSourceOutput = 0;
+				input.mBuffer = graph.AddBuffer(64 * (1 + rand() % 4));
+			} else {
+				input.mSourceNode = rand() % n;
+				input.mSourceOutput = rand() % int(graph.mNodes[input.mSourceNode].mOutputs.size());
+				input.mBuffer = -1;
+			}
+			node.mInputs.push_back(input);
+		}
+		// an in-place node's output 0 has its input 0's format
+		for (int o = 0; o < outputs; ++o) {
+			UInt32 samples = 64 * (1 + rand() % 4);
+			if (o == 0 && node.mProcessesInPlace && inputs > 0)
+				samples = graph.mSamples[node.mInputs[0].mSourceNode < 0 ? node.mInputs[0].mBuffer
+							: graph.mNodes[node.mInputs[0].mSourceNode].mOutputs[node.mInputs[0].mSourceOutput]];
+			node.mOutputs.push_back(graph.AddBuffer(samples));
+		}
+		graph.mNodes.push_back(node);
+	}
+	graph.Finish();
+	return graph;
+}
+
+// One unit after another, as in a chain of effects; every other one in place if asked.
+static SimGraph ChainGraph(int nodes, UInt32 samples, bool inPlace)
+{
+	SimGraph graph;
+	for (int n = 0; n < nodes; ++n) {
+		SimNode node;
+		node.mProcessesInPlace = inPlace && (n & 1);
+		node.mRendered = false;
+		node.mOutputs.push_back(graph.AddBuffer(samples));
+		SimInput input;
+		input.mSourceNode = n - 1;
+		input.mSourceOutput = 0;
+		input.mBuffer = n == 0 ? graph.AddBuffer(samples) : -1;
+		node.mInputs.push_back(input);
+		graph.mNodes.push_back(node);
+	}
+	graph.Finish();
+	return graph;
+}
+
+// ____________________________________________________________________________
+// Cache simulation: set associative, LRU, 64-byte lines, over each node's reads and writes.
+
+struct CacheSim {
+	enum { kLineBytes = 64 };
+	UInt32						mSets, mWays;
+	std::vector<uintptr_t>		mTags;		// per set, most recently used first
+	UInt64						mAccesses, mMisses;
+
+	CacheSim(UInt32 bytes, UInt32 ways) : mSets(bytes / kLineBytes / ways), mWays(ways), mTags(mSets * ways, 0), mAccesses(0), mMisses(0) { }
+
+	void	Touch(const void *p, UInt32 bytes)
+	{
+		uintptr_t line = reinterpret_cast<uintptr_t>(p) / kLineBytes, last = (reinterpret_cast<uintptr_t>(p) + bytes - 1) / kLineBytes;
+		for ( ; line <= last; ++line) {
+			uintptr_t *set = &mTags[(line % mSets) * mWays];
+			uintptr_t tag = line + 1;
+			UInt32 w = 0;
+			while (w < mWays && set[w] != tag)
+				++w;
+			++mAccesses;
+			if (w == mWays) {
+				++mMisses;
+				w = mWays - 1;
+			}
+			memmove(set + 1, set, w * sizeof(uintptr_t));
+			set[0] = tag;
+		}
+	}
+};
+
+// The accesses of one cycle of a chain: each node reads its input and writes its output.
+static void SimulateChain(const SimGraph &graph, CacheSim &cache)
+{
+	const Float32 *previous = graph.mMemory[graph.mNodes[0].mInputs[0].mBuffer];
+	UInt32 bytes = graph.mSamples[0] * sizeof(Float32);
+	cache.Touch(previous, bytes);		// the callback
+	for (size_t n = 0; n < graph.mNodes.size(); ++n) {
+		const SimNode &node = graph.mNodes[n];
+		const Float32 *out = node.mProcessesInPlace ? previous : graph.mMemory[node.mOutputs[0]];
+		cache.Touch(previous, bytes);
+		cache.Touch(out, bytes);
+		previous = out;
+	}
+	cache.Touch(previous, bytes);		// the host
+}
+
+// ____________________________________________________________________________
+// Hardware counters, where there are any
+
+struct Counter {
+	int		mFD;
+	Counter(UInt32 type, UInt64 config) : mFD(-1)
+	{
+#if defined(__linux__)
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.exclude_kernel = 1;
+		mFD = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+		(void)type; (void)config;
+#endif
+	}
+	~Counter() {
+#if defined(__linux__)
+		if (mFD >= 0) close(mFD);
+#endif
+	}
+	long long	Read() const {
+		long long value = -1;
+#if defined(__linux__)
+		if (mFD < 0 || read(mFD, &value, sizeof(value)) != sizeof(value))
+			value = -1;
+#endif
+		return value;
+	}
+};
+
+// Misses counted over the timed cycles of one layout.
+struct Misses {
+	long long	mL1, mLL;
+	bool		mValid;
+	Misses() : mL1(0), mLL(0), mValid(true) { }
+};
+
+// Times one batch of cycles from whatever memory the graph points at, adding to the misses.
+static double TimeCycles(SimGraph &graph, int inCycles, double &outCheck, Misses &ioMisses)
+{
+#if defined(__linux__)
+	Counter l1(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	Counter ll(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	long long l1Start = l1.Read(), llStart = ll.Read();
+#endif
+	graph.mCycle = 0;
+	double check = 0, t0 = Now();
+	for (int c = 0; c < inCycles; ++c)
+		check += graph.RenderCycle();
+	double t = (Now() - t0) / inCycles;
+#if defined(__linux__)
+	long long l1End = l1.Read(), llEnd = ll.Read();
+	if (l1Start >= 0 && l1End >= 0 && llStart >= 0 && llEnd >= 0) {
+		ioMisses.mL1 += l1End - l1Start;
+		ioMisses.mLL += llEnd - llStart;
+	} else
+		ioMisses.mValid = false;
+#else
+	ioMisses.mValid = false;
+#endif
+	outCheck = check;
+	return t;
+}
+
+static void PrintChain(const char *label, double inSeconds, const Misses &inMisses, int inCycles)
+{
+	printf("  %-28s %8.1f us/cycle", label, inSeconds * 1e6);
+	if (inMisses.mValid)
+		printf("  L1D read misses/cycle %9.0f  LLC read misses/cycle %8.0f", double(inMisses.mL1) / inCycles, double(inMisses.mLL) / inCycles);
+	else
+		printf("  (no hardware cache counters here)");
+	printf("\n");
+}
+
+// Alternates batches from separate buffers and from the arena, so that both see the same
+// machine, and keeps the best batch of each. The outputs of every batch must agree.
+static bool RunChain(SimGraph &graph, const std::vector<Float32 *> &inSeparate, const AUBufferPlanner &inPlanner,
+	double &outSeparate, double &outPlanned)
+{
+	const int rounds = 15, cycles = 100;
+	Misses separateMisses, plannedMisses;
+	bool same = true;
+	outSeparate = outPlanned = 1e30;
+	for (int r = 0; r <= rounds; ++r) {
+		double separateCheck, plannedCheck;
+		Misses *separateCount = &separateMisses, *plannedCount = &plannedMisses, warmUp;
+		if (r == 0)
+			separateCount = plannedCount = &warmUp;
+		graph.mMemory = inSeparate;
+		double t = TimeCycles(graph, cycles, separateCheck, *separateCount);
+		if (r > 0)
+			outSeparate = std::min(outSeparate, t);
+		graph.UsePlan(inPlanner);
+		t = TimeCycles(graph, cycles, plannedCheck, *plannedCount);
+		if (r > 0)
+			outPlanned = std::min(outPlanned, t);
+		same &= separateCheck == plannedCheck;
+	}
+	PrintChain("separate buffers", outSeparate, separateMisses, rounds * cycles);
+	PrintChain("planned arena", outPlanned, plannedMisses, rounds * cycles);
+	return same;
+}
+
+int main()
+{
+	srand(1);
+	bool ok = true;
+
+	// Random graphs: the planned layout must render exactly what separate buffers do.
+	int mismatches = 0;
+	UInt64 pooled = 0, unpooled = 0;
+	for (int g = 0; g < 500; ++g) {
+		SimGraph graph = RandomGraph(2 + rand() % 40);
+		double expected = 0, got = 0;
+		{
+			PrivateBuffers buffers;
+			buffers.Allocate(graph);
+			for (int c = 0; c < 3; ++c)
+				expected += graph.RenderCycle();
+		}
+		AUBufferPlanner planner;
+		graph.Describe(planner);
+		planner.Plan();
+		graph.UsePlan(planner);
+		graph.mCycle = 0;
+		for (int c = 0; c < 3; ++c)
+			got += graph.RenderCycle();
+		if (got != expected)
+			++mismatches;
+		pooled += planner.GetArenaBytes();
+		unpooled += planner.GetUnpooledBytes();
+	}
+	printf("500 random graphs rendered from the planned arena: %s (%d differ); arenas %.0f%% of separate buffers\n\n",
+		mismatches == 0 ? "ok" : "FAILED", mismatches, 100. * pooled / unpooled);
+	ok &= mismatches == 0;
+
+	// The chain: 50 units, 16 channels of 1024 frames each.
+	const int nodes = 50;
+	const UInt32 samples = 16 * 1024;
+	for (int inPlace = 0; inPlace < 2; ++inPlace) {
+		printf("%d-unit chain, %u Float32 samples per buffer, %s:\n", nodes, unsigned(samples), inPlace ? "every other unit in place" : "none in place");
+		SimGraph graph = ChainGraph(nodes, samples, inPlace != 0);
+		PrivateBuffers buffers;
+		buffers.Allocate(graph);
+		AUBufferPlanner planner;
+		graph.Describe(planner);
+		planner.Plan();
+
+		double separateTime, plannedTime;
+		const bool same = RunChain(graph, buffers.mMemory, planner, separateTime, plannedTime);
+
+		CacheSim separateCache(2 << 20, 16), plannedCache(2 << 20, 16);
+		graph.mMemory = buffers.mMemory;
+		for (int c = 0; c < 3; ++c)
+			SimulateChain(graph, separateCache);
+		graph.UsePlan(planner);
+		for (int c = 0; c < 3; ++c)
+			SimulateChain(graph, plannedCache);
+
+		printf("  memory: %llu KB separately, %u KB in the arena (%.1f%% saved)\n",
+			(unsigned long long)(buffers.mBytes >> 10), unsigned(planner.GetArenaBytes() >> 10),
+			100. * (1. - double(planner.GetArenaBytes()) / buffers.mBytes));
+		printf("  simulated 2MB L2, 3 cycles: %llu misses separately, %llu in the arena, of %llu accesses\n",
+			(unsigned long long)separateCache.mMisses, (unsigned long long)plannedCache.mMisses, (unsigned long long)plannedCache.mAccesses);
+		printf("  output: %s\n", same ? "identical" : "DIFFERS");
+		// the arena must not cost time, whichever units are in place
+		const bool fast = plannedTime <= 1.1 * separateTime;
+		printf("  arena time: %.0f%% of separate buffers%s\n\n", 100. * plannedTime / separateTime, fast ? "" : ", SLOWER, FAILED");
+		ok &= same && fast;
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+/*
+     File: AUGraphBuffers.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+#include "AUGraphBuffers.h"
+#include <vector>
+
+//_____________________________________________________________________________
+//
+// As AUEffectBase renders in place: only when it says so, into an output that would otherwise
+// use its own buffer.
+static bool	ProcessesInPlace(AUBase *inUnit)
+{
+	UInt32 inPlace = 0;
+	if (inUnit->DispatchGetProperty(kAudioUnitProperty_InPlaceProcessing, kAudioUnitScope_Global, 0, &inPlace) != noErr)
+		return false;
+	return inPlace != 0 && inUnit->Outputs().GetNumberOfElements() > 0 && inUnit->GetOutput(0)->WillAllocateBuffer();
+}
+
+//_____________________________________________________________________________
+//
+void PlanGraphBuffers(AUBase * const *inUnits, const bool *inProcessesInPlace, UInt32 inNumberUnits, AUBufferPlanner &ioPlanner)
+{
+	// the element each buffer belongs to, by buffer index
+	std::vector<AUIOElement *> elements;
+
+	ioPlanner.Reset();
+	for (UInt32 u = 0; u < inNumberUnits; ++u) {
+		AUBase *unit = inUnits[u];
+		ioPlanner.AddNode(inProcessesInPlace != NULL ? inProcessesInPlace[u] : ProcessesInPlace(unit));
+		UInt32 maxFrames = unit->GetMaxFramesPerSlice();
+
+		for (UInt32 e = 0; e < unit->Outputs().GetNumberOfElements(); ++e) {
+			AUIOElement *output = unit->GetOutput(e);
+			bool ownsBuffer = output->WillAllocateBuffer() && output->NeedsBufferSpace();
+			ioPlanner.AddOutput(u, ownsBuffer ? AUBufferList::AllocationSize(output->GetStreamFormat(), maxFrames) : 0);
+			elements.push_back(output);
+		}
+		for (UInt32 e = 0; e < unit->Inputs().GetNumberOfElements(); ++e) {
+			AUInputElement *input = unit->GetInput(e);
+			if (input->IsCallback() && input->WillAllocateBuffer()) {
+				ioPlanner.AddCallbackInput(u, e, AUBufferList::AllocationSize(input->GetStreamFormat(), maxFrames));
+				elements.push_back(input);
+			}
+		}
+	}
+
+	for (UInt32 u = 0; u < inNumberUnits; ++u) {
+		AUBase *unit = inUnits[u];
+		for (UInt32 e = 0; e < unit->Inputs().GetNumberOfElements(); ++e) {
+			AUInputElement *input = unit->GetInput(e);
+			if (!input->HasConnection())
+				continue;
+			const AudioUnitConnection &connection = input->GetConnection();
+			for (UInt32 source = 0; source < inNumberUnits; ++source)
+				if (inUnits[source]->GetComponentInstance() == connection.sourceAudioUnit) {
+					ioPlanner.Connect(source, connection.sourceOutputNumber, u, e);
+					break;
+				}
+		}
+	}
+
+	ioPlanner.Plan();
+
+	for (UInt32 b = 0; b < ioPlanner.GetNumberBuffers(); ++b) {
+		AudioUnitExternalBuffer buffer;
+		buffer.buffer = ioPlanner.GetBufferMemory(b);
+		buffer.size = ioPlanner.GetBufferBytes(b);
+		if (buffer.buffer != NULL)
+			elements[b]->UseExternalBuffer(buffer);
+	}
+}
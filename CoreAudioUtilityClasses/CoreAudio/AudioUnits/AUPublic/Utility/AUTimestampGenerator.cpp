@@ -66,6 +66,23 @@ void	AUTimestampGenerator::AddOutputTime(const AudioTimeStamp &inTimeStamp, Floa
 	mCurrentOutputTime = inTimeStamp;
 	if (mBypassed)
 		return;
+	if (mUseClockModel) {
+		if (mCurrentOutputTime.mFlags & kAudioTimeStampHostTimeValid) {
+			mClockModel.Update(mCurrentOutputTime.mSampleTime, mCurrentOutputTime.mHostTime, outputSampleRate);
+			mCurrentOutputTime.mHostTime = mClockModel.SampleTimeToHostTime(mCurrentOutputTime.mSampleTime);
+		} else if (mClockModel.IsLocked()) {
+			mCurrentOutputTime.mHostTime = mClockModel.SampleTimeToHostTime(mCurrentOutputTime.mSampleTime);
+			mCurrentOutputTime.mFlags |= kAudioTimeStampHostTimeValid;
+		}
+		if (!(mCurrentOutputTime.mFlags & kAudioTimeStampRateScalarValid) && mClockModel.IsLocked()) {
+			mCurrentOutputTime.mRateScalar = mClockModel.GetRateScalar();
+			mCurrentOutputTime.mFlags |= kAudioTimeStampRateScalarValid;
+		}
+#if DEBUG
+		if (mVerbosity > 1)
+			printf("%-20.20s: modeled host time: %.6f, rate scalar %.6f\n", mDebugName, DebugHostTime(mCurrentOutputTime), mCurrentOutputTime.mRateScalar);
+#endif
+	}
 	if (mHostTimeDiscontinuityCorrection && !(mCurrentOutputTime.mFlags & kAudioTimeStampHostTimeValid) && (mLastOutputTime.mFlags & kAudioTimeStampHostTimeValid)) {
 		// no host time here but we had one last time, interpolate one
 		double rateScalar = (mCurrentOutputTime.mFlags & kAudioTimeStampRateScalarValid) ? mCurrentOutputTime.mRateScalar : 1.0;
@@ -49,6 +49,7 @@
 
 #include <math.h>
 #include "CAHostTimeBase.h"
+#include "CAClockModel.h"
 #include <stdio.h>
 
 #define TSGFMT "0x%10qx"
@@ -64,7 +65,9 @@ public:
 	AUTimestampGenerator(bool hostTimeDiscontinuityCorrection = false) :
 		mStartInputAtZero(true),
 		mBypassed(false),
-		mHostTimeDiscontinuityCorrection(hostTimeDiscontinuityCorrection)
+		mHostTimeDiscontinuityCorrection(hostTimeDiscontinuityCorrection),
+		mClockModel(CAHostTimeBase::GetFrequency()),
+		mUseClockModel(false)
 	{
 #if DEBUG
 		mVerbosity = 0;
@@ -83,6 +86,24 @@ public:
 	// bypassing is intended for a narrow special case. the upstream sample time will always be the same as the downstream time.
 	void	SetBypassed(bool b) { mBypassed = b; }
 	bool	GetBypassed() const { return mBypassed; }
+
+	// With a nonzero bandwidth (Hz), the downstream host times are passed through a clock
+	// model, so that the timestamps generated carry host times and rate scalars filtered of
+	// callback jitter, and downstream timestamps without a host time get one from the model.
+	// A wider loop passes more of the jitter than a free running device warrants, so the
+	// bandwidth is clamped to kMaxClockModelBandwidth Hz.
+	enum { kMaxClockModelBandwidth = 1 };
+	void	SetClockModelBandwidth(Float64 inBandwidth)
+	{
+		mUseClockModel = inBandwidth > 0.;
+		if (mUseClockModel)
+			mClockModel.SetBandwidth(inBandwidth < kMaxClockModelBandwidth ? inBandwidth : Float64(kMaxClockModelBandwidth));
+		mClockModel.Reset();
+	}
+	Float64	GetClockModelBandwidth() const { return mUseClockModel ? mClockModel.GetBandwidth() : 0.; }
+	
+	// for conversions and jitter and drift statistics
+	const CAClockModel &	GetClockModel() const { return mClockModel; }
 		
 	// Call this to reset the timeline.
 	void	Reset()
@@ -94,6 +115,7 @@ public:
 		mLastOutputTime.mFlags = 0;
 		mRateScalarAdj = 1.;
 		mFirstTime = true;
+		mClockModel.Reset();
 #if DEBUG
 		if (mVerbosity)
 			printf("%-20.20s: Reset\n", mDebugName);
@@ -141,6 +163,9 @@ private:
 	double				mRateScalarAdj;
 	
 	bool				mHostTimeDiscontinuityCorrection; // If true, propagate timestamp discontinuities using host time.
+	
+	CAClockModel		mClockModel;
+	bool				mUseClockModel;
 
 	
 #if DEBUG
@@ -0,0 +1,134 @@
+/*
+     File: CAAUMIDIDispatchTable.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+#include "CAAUMIDIDispatchTable.h"
+#include <string.h>
+
+template <class F> void	CAAUMIDIDispatchTable::ForEachCell(const CAAUMIDIMap &inMap, F &inFunction)
+{
+	if (!inMap.IsValid() || inMap.mStatus < 0x80 || inMap.mStatus >= 0xF0)
+		return;		// no channel message can reach it
+
+	UInt8 status = inMap.mStatus & 0xF0;
+	UInt8 firstChannel = inMap.IsAnyChannel() ? 0 : (inMap.mStatus & 0xF);
+	UInt8 lastChannel = inMap.IsAnyChannel() ? 15 : firstChannel;
+
+	UInt8 firstData1 = inMap.mData1 & 0x7F, lastData1 = firstData1;
+	if (inMap.IsKeyEvent() && (inMap.IsAnyNote() || inMap.IsBipolar())) {
+		firstData1 = 0;
+		lastData1 = 127;
+	} else if (status >= 0xD0)
+		firstData1 = lastData1 = 0;
+
+	for (UInt32 channel = firstChannel; channel <= lastChannel; ++channel)
+		for (UInt32 data1 = firstData1; data1 <= lastData1; ++data1)
+			inFunction(CellIndex(status, UInt8(channel), UInt8(data1)));
+}
+
+namespace {
+	struct CountCell {
+		UInt32 *mCounts;
+		void operator()(UInt32 inCell) { ++mCounts[inCell + 1]; }
+	};
+
+	struct FillCell {
+		UInt32 *mNext;
+		std::vector<CAAUMIDIMap> *mTargets;
+		const CAAUMIDIMap *mMap;
+		void operator()(UInt32 inCell) { (*mTargets)[mNext[inCell]++] = *mMap; }
+	};
+}
+
+CAAUMIDIDispatchTable::CAAUMIDIDispatchTable(const CAAUMIDIMap *inMaps, UInt32 inNumMaps)
+{
+	// Count each cell's entries, then lay the cells out back to back and fill them in a
+	// second pass, so every cell is one contiguous run.
+	memset(mCellStart, 0, sizeof(mCellStart));
+	CountCell count = { mCellStart };
+	for (UInt32 i = 0; i < inNumMaps; ++i)
+		ForEachCell(inMaps[i], count);
+	for (UInt32 cell = 0; cell < kNumberCells; ++cell)
+		mCellStart[cell + 1] += mCellStart[cell];
+
+	mTargets.resize(mCellStart[kNumberCells]);
+	std::vector<UInt32> next(mCellStart, mCellStart + kNumberCells);
+	FillCell fill = { &next[0], &mTargets, NULL };
+	for (UInt32 i = 0; i < inNumMaps; ++i) {
+		fill.mMap = &inMaps[i];
+		ForEachCell(inMaps[i], fill);
+	}
+}
+
+CAAUMIDIDispatchPublisher::~CAAUMIDIDispatchPublisher()
+{
+	// there can be no readers left by now
+	delete mTable;
+	for (size_t i = 0; i < mRetired.size(); ++i)
+		delete mRetired[i];
+}
+
+void	CAAUMIDIDispatchPublisher::Publish(CAAUMIDIDispatchTable *inTable)
+{
+	CAAUMIDIDispatchTable *oldTable = mTable;
+	// Publish calls don't overlap, so this always succeeds; it is here for the barrier, which
+	// makes the new table's contents visible before the pointer to it.
+	CAAtomicCompareAndSwapPtrBarrier(oldTable, inTable, (volatile void **)&mTable);
+	if (oldTable)
+		mRetired.push_back(oldTable);
+	FreeRetired();
+}
+
+void	CAAUMIDIDispatchPublisher::FreeRetired()
+{
+	// A reader still holding a retired table incremented mReaders before it loaded mTable,
+	// and so before the swap above; if the count is zero after the swap, every reader from
+	// now on will load the current table.
+	if (mRetired.empty() || mReaders != 0)
+		return;
+	for (size_t i = 0; i < mRetired.size(); ++i)
+		delete mRetired[i];
+	mRetired.clear();
+}
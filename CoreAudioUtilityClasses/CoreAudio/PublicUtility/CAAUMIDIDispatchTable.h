@@ -0,0 +1,140 @@
+/*
+     File: CAAUMIDIDispatchTable.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+#ifndef __CAAUMIDIDispatchTable_h__
+#define __CAAUMIDIDispatchTable_h__
+
+#include "CAAUMIDIMap.h"
+#include "CAAtomic.h"
+#include <vector>
+
+// CAAUMIDIDispatchTable answers "which parameter maps could this MIDI event drive?" in
+// constant time, for CAAUMIDIMapManager's render-thread lookup.
+//
+// The table has one cell per channel message kind (0x8n-0xEn), channel and data byte 1,
+// and each cell holds a contiguous run of copies of the maps that may match an event with
+// that status, channel and data byte 1. Maps with the any-channel flag are entered in all
+// sixteen channels; note maps with the any-note flag, and bipolar note maps (which switch on
+// the note number itself), in all 128 note cells. Channel pressure and pitch bend carry
+// their value in data byte 1, so those maps are filed under data byte 1 == 0 and looked up
+// that way. A candidate still has to pass CAAUMIDIMap::MIDI_Matches, which checks the data
+// byte 2 conditions and produces the value.
+//
+// A table is immutable once built. Building allocates, so tables are built off the render
+// thread and handed to it through a CAAUMIDIDispatchPublisher.
+class CAAUMIDIDispatchTable {
+public:
+							CAAUMIDIDispatchTable(const CAAUMIDIMap *inMaps, UInt32 inNumMaps);
+								// candidates keep the order of inMaps within each cell
+
+	UInt32					GetCandidates(UInt8 inStatus, UInt8 inChannel, UInt8 inData1, const CAAUMIDIMap *&outMaps) const
+							{
+								// inStatus is the status byte without the channel, as AUMIDIBase passes it.
+								// Note on with velocity zero must already have been turned into note off.
+								if (inStatus < 0x80 || inStatus >= 0xF0)
+									return 0;
+								UInt32 cell = CellIndex(inStatus, inChannel, inData1);
+								UInt32 count = mCellStart[cell + 1] - mCellStart[cell];
+								if (count)
+									outMaps = &mTargets[mCellStart[cell]];
+								return count;
+							}
+
+	UInt32					GetNumberOfTargets() const { return static_cast<UInt32>(mTargets.size()); }
+								// total entries over all cells, counting a map once per cell it is in
+
+private:
+	enum {
+		kNumberCommands	= 7,		// 0x80 - 0xE0
+		kNumberCells	= kNumberCommands * 16 * 128
+	};
+
+	static UInt32			CellIndex(UInt8 inStatus, UInt8 inChannel, UInt8 inData1)
+							{
+								if (inStatus >= 0xD0)
+									inData1 = 0;
+								return (UInt32((inStatus >> 4) - 8) << 11) | (UInt32(inChannel & 0xF) << 7) | (inData1 & 0x7F);
+							}
+
+	template <class F> static void ForEachCell(const CAAUMIDIMap &inMap, F &inFunction);
+
+	UInt32						mCellStart[kNumberCells + 1];
+	std::vector<CAAUMIDIMap>	mTargets;
+};
+
+// CAAUMIDIDispatchPublisher hands the current table to readers without locks.
+//
+// Publish swaps in a new table and takes ownership of it. Readers bracket their use of the
+// table with BeginRead and EndRead; any number of threads may read at once, and BeginRead
+// and EndRead are two atomic operations, so they are safe on the render thread. A table
+// that has been replaced is kept until a later Publish (or the destructor) sees no readers
+// in progress, so a reader never sees it freed. Publish calls must not overlap.
+class CAAUMIDIDispatchPublisher {
+public:
+							CAAUMIDIDispatchPublisher() : mTable(NULL), mReaders(0) { }
+							~CAAUMIDIDispatchPublisher();
+
+	void					Publish(CAAUMIDIDispatchTable *inTable);
+
+	const CAAUMIDIDispatchTable *	BeginRead()
+							{
+								CAAtomicIncrement32Barrier(&mReaders);
+								return mTable;
+							}
+	void					EndRead() { CAAtomicDecrement32Barrier(&mReaders); }
+
+private:
+							CAAUMIDIDispatchPublisher(const CAAUMIDIDispatchPublisher &);
+	CAAUMIDIDispatchPublisher &	operator=(const CAAUMIDIDispatchPublisher &);
+
+	void					FreeRetired();
+
+	CAAUMIDIDispatchTable * volatile		mTable;
+	volatile SInt32							mReaders;
+	std::vector<CAAUMIDIDispatchTable *>	mRetired;
+};
+
+#endif // __CAAUMIDIDispatchTable_h__
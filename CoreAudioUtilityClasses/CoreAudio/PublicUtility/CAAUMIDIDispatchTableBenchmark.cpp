@@ -0,0 +1,225 @@
+/*
+     File: CAAUMIDIDispatchTableBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+// Benchmark and check for CAAUMIDIDispatchTable.
+//
+// Floods a set of parameter maps with MIDI traffic and measures the cost per event of
+// finding and evaluating the matching maps, first the way CAAUMIDIMapManager used to (a
+// binary search of its sorted map list followed by a scan of every map with the same
+// message kind), then through a dispatch table, including the BeginRead/EndRead pair the
+// manager wraps around each lookup. The two must find the same maps with the same values.
+// Setting the parameter and notifying listeners cost the same either way and are left out.
+//
+// Build with, e.g.:
+//	c++ -O3 -o CAAUMIDIDispatchTableBenchmark CAAUMIDIDispatchTableBenchmark.cpp
+//		CAAUMIDIDispatchTable.cpp CAAUMIDIMap.cpp -framework AudioToolbox -framework CoreFoundation
+
+#include "CAAUMIDIDispatchTable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+struct MIDIEvent {
+	UInt8		mStatus;	// without the channel
+	UInt8		mChannel;
+	UInt8		mData1;
+	UInt8		mData2;
+};
+
+// What a lookup produces: a running total over the matches, order independent, so the
+// two lookups can be compared.
+struct MatchTotal {
+	UInt32		mCount;
+	double		mSum;
+	void		Add(const CAAUMIDIMap &inMap, Float32 inValue)
+				{
+					++mCount;
+					mSum += (inMap.mParameterID + 1) * double(inMap.ParamValueFromMIDILinear(inValue));
+				}
+};
+
+static double Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+// The lookup CAAUMIDIMapManager::FindParameterMapEventMatch used to do.
+static void SortedLookup(const std::vector<CAAUMIDIMap> &inMaps, const MIDIEvent &inEvent, MatchTotal &ioTotal)
+{
+	UInt8 status = inEvent.mStatus;
+	if (status == 0x90 && !inEvent.mData2)
+		status = 0x80;
+	CAAUMIDIMap tempMap;
+	tempMap.mStatus = status | inEvent.mChannel;
+	tempMap.mData1 = inEvent.mData1;
+
+	CompareMIDIMap compareObj;
+	std::vector<CAAUMIDIMap>::const_iterator iter = std::lower_bound(inMaps.begin(), inMaps.end(), tempMap, compareObj);
+	for (; iter < inMaps.end(); ++iter) {
+		if (compareObj.Finish(*iter, tempMap))
+			break;
+		Float32 value;
+		if (iter->MIDI_Matches(inEvent.mChannel, inEvent.mData1, inEvent.mData2, value))
+			ioTotal.Add(*iter, value);
+	}
+}
+
+// The lookup it does now.
+static void TableLookup(CAAUMIDIDispatchPublisher &inDispatch, const MIDIEvent &inEvent, MatchTotal &ioTotal)
+{
+	UInt8 status = inEvent.mStatus;
+	if (status == 0x90 && !inEvent.mData2)
+		status = 0x80;
+	const CAAUMIDIDispatchTable *table = inDispatch.BeginRead();
+	const CAAUMIDIMap *candidates;
+	UInt32 numCandidates = table->GetCandidates(status, inEvent.mChannel, inEvent.mData1, candidates);
+	for (UInt32 i = 0; i < numCandidates; ++i) {
+		Float32 value;
+		if (candidates[i].MIDI_Matches(inEvent.mChannel, inEvent.mData1, inEvent.mData2, value))
+			ioTotal.Add(candidates[i], value);
+	}
+	inDispatch.EndRead();
+}
+
+// A control surface style layout: mostly controllers, on a few channels or any channel,
+// with some note, pitch bend and pressure maps and the odd bipolar or any-note map.
+static void MakeMaps(std::vector<CAAUMIDIMap> &outMaps, UInt32 inNumMaps)
+{
+	outMaps.clear();
+	for (UInt32 i = 0; i < inNumMaps; ++i) {
+		CAAUMIDIMap map(kAudioUnitScope_Global, 0, i);
+		UInt8 channel = rand() % 4;
+		bool anyChannel = rand() % 8 == 0;
+		int kind = rand() % 100;
+		if (kind < 70) {
+			map.SetControlChange(rand() % 128, channel, anyChannel);
+			if (rand() % 16 == 0)
+				map.SetBipolar(true, rand() % 2);
+		} else if (kind < 90) {
+			map.SetNoteOn(rand() % 128, channel, anyChannel);
+			if (rand() % 8 == 0)
+				map.SetAnyNote(true);
+		} else if (kind < 95)
+			map.SetPitchBend(channel, anyChannel);
+		else
+			map.SetChannelPressure(channel, anyChannel);
+		map.SetParamRange(0.f, 1.f);
+		map.mTransType = CAAUMIDIMap::GetTransformer(0);
+		outMaps.push_back(map);
+	}
+	std::sort(outMaps.begin(), outMaps.end(), CompareMIDIMap());
+}
+
+static void MakeEvents(std::vector<MIDIEvent> &outEvents, UInt8 inStatus, UInt32 inNumEvents)
+{
+	outEvents.resize(inNumEvents);
+	for (UInt32 i = 0; i < inNumEvents; ++i) {
+		MIDIEvent &event = outEvents[i];
+		event.mStatus = inStatus;
+		event.mChannel = rand() % 4;
+		event.mData1 = rand() % 128;
+		event.mData2 = rand() % 128;
+	}
+}
+
+static bool Benchmark(UInt32 inNumMaps, UInt8 inStatus, const char *inTrafficName)
+{
+	std::vector<CAAUMIDIMap> maps;
+	MakeMaps(maps, inNumMaps);
+	CAAUMIDIDispatchPublisher dispatch;
+	dispatch.Publish(new CAAUMIDIDispatchTable(&maps[0], maps.size()));
+
+	std::vector<MIDIEvent> events;
+	MakeEvents(events, inStatus, 1 << 16);
+
+	// Agreement, event by event.
+	bool agree = true;
+	for (size_t i = 0; i < events.size(); ++i) {
+		MatchTotal sorted = { 0, 0 }, table = { 0, 0 };
+		SortedLookup(maps, events[i], sorted);
+		TableLookup(dispatch, events[i], table);
+		if (sorted.mCount != table.mCount || sorted.mSum != table.mSum)
+			agree = false;
+	}
+
+	const int passes = 32;
+	MatchTotal sink = { 0, 0 };
+	double t0 = Now();
+	for (int p = 0; p < passes; ++p)
+		for (size_t i = 0; i < events.size(); ++i)
+			SortedLookup(maps, events[i], sink);
+	double sorted = (Now() - t0) / (passes * events.size());
+
+	t0 = Now();
+	for (int p = 0; p < passes; ++p)
+		for (size_t i = 0; i < events.size(); ++i)
+			TableLookup(dispatch, events[i], sink);
+	double table = (Now() - t0) / (passes * events.size());
+
+	printf("%5u maps, %-14s %8.1f ns/event sorted  %6.1f ns/event table  %6.1fx  %s\n",
+		(unsigned)inNumMaps, inTrafficName, sorted * 1e9, table * 1e9, sorted / table,
+		agree ? "ok" : "MISMATCH");
+	if (sink.mCount == 0xFFFFFFFF)
+		printf("%g\n", sink.mSum);	// keep the work from being optimized away
+	return agree;
+}
+
+int main()
+{
+	srand(1);
+	bool ok = true;
+	const UInt32 sizes[] = { 16, 128, 1024, 4096 };
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		ok &= Benchmark(sizes[i], 0xB0, "control change");
+		ok &= Benchmark(sizes[i], 0x90, "note on/off");
+		ok &= Benchmark(sizes[i], 0xE0, "pitch bend");
+	}
+	return ok ? 0 : 1;
+}
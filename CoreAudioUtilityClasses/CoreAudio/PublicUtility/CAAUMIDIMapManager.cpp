@@ -50,6 +50,7 @@
 CAAUMIDIMapManager::CAAUMIDIMapManager()
 {	
 	hotMapping = false;	
+	mHotMapPending = 0;
 }
 
 static void FillInMap (CAAUMIDIMap &map, AUBase &That)
@@ -68,23 +69,46 @@ static void FillInMap (CAAUMIDIMap &map, AUBase &That)
 	map.mTransType = CAAUMIDIMap::GetTransformer(info.flags);
 }
 
+// orders maps by the parameter they control
+struct CompareMIDIMapParameter {
+	bool operator() (const AUParameterMIDIMapping &a, const AUParameterMIDIMapping &b) const {
+		if (a.mParameterID != b.mParameterID) return a.mParameterID < b.mParameterID;
+		if (a.mScope != b.mScope) return a.mScope < b.mScope;
+		return a.mElement < b.mElement;
+	}
+};
+
+static bool SameMIDIMapParameter (const AUParameterMIDIMapping &a, const AUParameterMIDIMapping &b)
+{
+	return a.mParameterID == b.mParameterID && a.mScope == b.mScope && a.mElement == b.mElement;
+}
+
 OSStatus	CAAUMIDIMapManager::SortedInsertToParamaterMaps	(AUParameterMIDIMapping *maps, UInt32 inNumMaps, AUBase &That)
 {	
-	for (unsigned int i = 0; i < inNumMaps; ++i) 
+		// a new map replaces any for the same parameter, the last one given winning, so
+		// sort the new ones by parameter and drop the old ones they replace in one pass
+		// rather than looking each up in the list
+	ParameterMaps added;
+	added.reserve(inNumMaps);
+	for (unsigned int i = inNumMaps; i-- > 0; ) 
 	{
 		CAAUMIDIMap map(maps[i]);
-
 		FillInMap (map, That);
-		
-		int idx = FindParameterIndex (maps[i]);
-		if (idx > -1)
-			mParameterMaps.erase(mParameterMaps.begin() + idx);
-
-			// least disruptive place to put this is at the end
-		mParameterMaps.push_back(map);
+		added.push_back(map);
+	}
+	std::stable_sort(added.begin(), added.end(), CompareMIDIMapParameter());
+	added.erase(std::unique(added.begin(), added.end(), SameMIDIMapParameter), added.end());
+	
+	ParameterMaps::iterator kept = mParameterMaps.begin();
+	for (ParameterMaps::iterator i = mParameterMaps.begin(); i < mParameterMaps.end(); ++i) {
+		if (!std::binary_search(added.begin(), added.end(), *i, CompareMIDIMapParameter()))
+			*kept++ = *i;
 	}
+	mParameterMaps.erase(kept, mParameterMaps.end());
+	mParameterMaps.insert(mParameterMaps.end(), added.begin(), added.end());
 	
 	std::sort(mParameterMaps.begin(), mParameterMaps.end(), CompareMIDIMap());	
+	UpdateDispatchTable();
 	
 	return noErr;
 }
@@ -109,6 +133,8 @@ void CAAUMIDIMapManager::SortedRemoveFromParameterMaps(AUParameterMIDIMapping *m
 			outMapDidChange = true;
 		}
 	}
+	if (outMapDidChange)
+		UpdateDispatchTable();
 }
 
 void	CAAUMIDIMapManager::ReplaceAllMaps (AUParameterMIDIMapping* inMappings, UInt32 inNumMaps, AUBase &That)
@@ -123,6 +149,7 @@ void	CAAUMIDIMapManager::ReplaceAllMaps (AUParameterMIDIMapping* inMappings, UIn
 	}
 
 	std::sort(mParameterMaps.begin(),mParameterMaps.end(), CompareMIDIMap());	
+	UpdateDispatchTable();
 }
 
 bool CAAUMIDIMapManager::HandleHotMapping(UInt8 	inStatus,
@@ -138,11 +165,35 @@ bool CAAUMIDIMapManager::HandleHotMapping(UInt8 	inStatus,
 
 	mHotMap.mStatus = inStatus | inChannel;  
 	mHotMap.mData1 = inData1; 
-		
-	SortedInsertToParamaterMaps (&mHotMap, 1, That);
+	mPendingHotMap.mStatus = mHotMap.mStatus;
+	mPendingHotMap.mData1 = inData1;
+	
+	// This runs on the MIDI thread, which must not allocate, so the map is only
+	// marked as learned: FindParameterMapEventMatch dispatches it from here on, and
+	// CommitHotMapping moves it into the list on the next property call.
+	CAAtomicCompareAndSwap32Barrier(0, 1, &mHotMapPending);
 	return true;
 }
 
+void CAAUMIDIMapManager::SetHotMapping (AUParameterMIDIMapping &inMap, AUBase &That)
+{
+	CommitHotMapping (That);
+	mHotMap = inMap;
+	mPendingHotMap = CAAUMIDIMap(inMap);
+	FillInMap (mPendingHotMap, That);
+	CAMemoryBarrier();
+	hotMapping = true;
+}
+
+void CAAUMIDIMapManager::CommitHotMapping (AUBase &That)
+{
+	// the MIDI thread keeps dispatching the pending map until the list has it
+	if (mHotMapPending) {
+		SortedInsertToParamaterMaps (&mHotMap, 1, That);
+		CAAtomicCompareAndSwap32Barrier(1, 0, &mHotMapPending);
+	}
+}
+
 #if DEBUG
 
 void CAAUMIDIMapManager::Print()
@@ -182,6 +233,11 @@ int CAAUMIDIMapManager::FindParameterIndex (AUParameterMIDIMapping &inMap)
 	return -1;
 }
 
+void CAAUMIDIMapManager::UpdateDispatchTable()
+{
+	mDispatch.Publish(new CAAUMIDIDispatchTable(mParameterMaps.empty() ? NULL : &mParameterMaps[0], mParameterMaps.size()));
+}
+
 bool CAAUMIDIMapManager::FindParameterMapEventMatch(	UInt8			inStatus,
 														UInt8			inChannel,
 														UInt8			inData1,
@@ -192,42 +248,49 @@ bool CAAUMIDIMapManager::FindParameterMapEventMatch(	UInt8			inStatus,
 	bool ret_value = false;
 
 	if (inStatus == 0x90 && !inData2)
-		inStatus = 0x80 | inChannel;
-	
-	//used to test for midi matches once map is made
-	CAAUMIDIMap tempMap;
-	tempMap.mStatus = inStatus | inChannel;
-	tempMap.mData1 = inData1;
-	
-	CompareMIDIMap compareObj;
-
-	AudioUnitEvent event;
-	event.mEventType = kAudioUnitEvent_ParameterValueChange;
-	event.mArgument.mParameter.mAudioUnit = inAUBase.GetComponentInstance();
+		inStatus = 0x80;
 	
-	ParameterMaps::iterator lower_iter = 
-	std::lower_bound(mParameterMaps.begin(), mParameterMaps.end(), tempMap, compareObj);
+	// a learned map that isn't in the list yet replaces the list's map for its parameter
+	const CAAUMIDIMap *hotMap = NULL;
+	if (mHotMapPending) {
+		CAMemoryBarrier();
+		hotMap = &mPendingHotMap;
+	}
 	
-	while (lower_iter < mParameterMaps.end()) 
-	{
-		CAAUMIDIMap & map = (*lower_iter);
-		if (compareObj.Finish(map, tempMap)) 
-			break;
+	const CAAUMIDIDispatchTable *table = mDispatch.BeginRead();
+	const CAAUMIDIMap *candidates = NULL;
+	UInt32 numCandidates = table ? table->GetCandidates(inStatus & 0xF0, inChannel, inData1, candidates) : 0;
+	if (numCandidates || hotMap) {
+		AudioUnitEvent event;
+		event.mEventType = kAudioUnitEvent_ParameterValueChange;
+		event.mArgument.mParameter.mAudioUnit = inAUBase.GetComponentInstance();
 		
-		Float32 value;
-		if (map.MIDI_Matches(inChannel, inData1, inData2, value))
-		{	
-			inAUBase.SetParameter ( map.mParameterID, map.mScope, map.mElement, 
-									map.ParamValueFromMIDILinear(value), inBufferOffset);
-
-			event.mArgument.mParameter.mParameterID = map.mParameterID;
-			event.mArgument.mParameter.mScope = map.mScope;
-			event.mArgument.mParameter.mElement = map.mElement;
+		for (UInt32 i = 0; i <= numCandidates; ++i)
+		{
+			const CAAUMIDIMap *candidate = i < numCandidates ? &candidates[i] : hotMap;
+			if (candidate == NULL)
+				break;
+			if (hotMap && candidate != hotMap && SameMIDIMapParameter(*candidate, *hotMap))
+				continue;
+			if (candidate == hotMap && (hotMap->mStatus & 0xF0) != (inStatus & 0xF0))
+				break;
+			const CAAUMIDIMap & map = *candidate;
 			
-			AUEventListenerNotify(NULL, NULL, &event);
-			ret_value = true;
+			Float32 value;
+			if (map.MIDI_Matches(inChannel, inData1, inData2, value))
+			{	
+				inAUBase.SetParameter ( map.mParameterID, map.mScope, map.mElement, 
+										map.ParamValueFromMIDILinear(value), inBufferOffset);
+
+				event.mArgument.mParameter.mParameterID = map.mParameterID;
+				event.mArgument.mParameter.mScope = map.mScope;
+				event.mArgument.mParameter.mElement = map.mElement;
+				
+				AUEventListenerNotify(NULL, NULL, &event);
+				ret_value = true;
+			}
 		}
-		++lower_iter;
 	}
+	mDispatch.EndRead();
 	return ret_value;
 }
@@ -49,6 +49,7 @@
 
 #include "AUBase.h"
 #include "CAAUMIDIMap.h"
+#include "CAAUMIDIDispatchTable.h"
 #include <vector>
 #include <AudioToolbox/AudioUnitUtilities.h>
 
@@ -62,6 +63,16 @@ protected:
 	bool								hotMapping;
 	AUParameterMIDIMapping				mHotMap;
 	
+		// set on the MIDI thread once mHotMap has been learned, cleared when CommitHotMapping inserts it
+	volatile SInt32						mHotMapPending;
+		// mHotMap filled in for dispatch by SetHotMapping, so the MIDI thread can use it while pending
+	CAAUMIDIMap							mPendingHotMap;
+	
+		// what FindParameterMapEventMatch reads; rebuilt from mParameterMaps whenever they change
+	CAAUMIDIDispatchPublisher			mDispatch;
+	
+	void					UpdateDispatchTable();
+	
 public:
 					
 							CAAUMIDIMapManager();
@@ -79,13 +90,18 @@ public:
 	void					ReplaceAllMaps (AUParameterMIDIMapping* inMappings, UInt32 inNumMaps, AUBase &That);
 	
 	bool					IsHotMapping(){return hotMapping;}
-	void					SetHotMapping (AUParameterMIDIMapping &inMap){hotMapping = true; mHotMap = inMap; }
+	void					SetHotMapping (AUParameterMIDIMapping &inMap, AUBase &That);
 	
 	bool					HandleHotMapping(	UInt8 	inStatus,
 												UInt8 	inChannel,
 												UInt8 	inData1,
 												AUBase	&That);
 	
+		// inserts a map learned by HandleHotMapping and rebuilds the dispatch table;
+		// call from a non-realtime thread, such as a property call. Until then
+		// FindParameterMapEventMatch dispatches the learned map itself.
+	void					CommitHotMapping (AUBase &That);
+	
 		
 	bool					FindParameterMapEventMatch(UInt8 	inStatus,
 													   UInt8 	inChannel,
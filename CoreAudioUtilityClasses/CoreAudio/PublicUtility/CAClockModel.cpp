@@ -0,0 +1,139 @@
+/*
+     File: CAClockModel.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+#include "CAClockModel.h"
+#include <math.h>
+
+// Hz; the widest the reported rate is smoothed at
+static const Float64 kRateBandwidth = 0.1;
+
+CAClockModel::CAClockModel(Float64 inHostTicksPerSecond, Float64 inBandwidth) :
+	mHostTicksPerSecond(inHostTicksPerSecond),
+	mBandwidth(inBandwidth),
+	mRelockThreshold(0.05)
+{
+	Reset();
+}
+
+void	CAClockModel::Reset()
+{
+	mLocked = false;
+	mBaseHostTime = 0;
+	mPhase = 0.;
+	mSampleTime = 0.;
+	mTicksPerSample = 0.;
+	mSmoothedTicksPerSample = 0.;
+	mNominalTicksPerSample = 0.;
+	ResetStatistics();
+}
+
+void	CAClockModel::ResetStatistics()
+{
+	mStatistics.mUpdates = 0;
+	mStatistics.mRelocks = 0;
+	mStatistics.mJitterRMS = 0.;
+	mStatistics.mJitterMax = 0.;
+	mStatistics.mDriftPPM = 0.;
+	mSumSquaredError = 0.;
+}
+
+void	CAClockModel::Lock(Float64 inSampleTime, UInt64 inHostTime)
+{
+	mBaseHostTime = inHostTime;
+	mPhase = 0.;
+	mSampleTime = inSampleTime;
+	mLocked = true;
+}
+
+void	CAClockModel::Update(Float64 inSampleTime, UInt64 inHostTime, Float64 inNominalSampleRate)
+{
+	mNominalTicksPerSample = mHostTicksPerSecond / inNominalSampleRate;
+	if (!mLocked) {
+		mTicksPerSample = mSmoothedTicksPerSample = mNominalTicksPerSample;
+		Lock(inSampleTime, inHostTime);
+		return;
+	}
+
+	Float64 deltaSamples = inSampleTime - mSampleTime;
+	Float64 predicted = mPhase + deltaSamples * mTicksPerSample;
+	Float64 error = static_cast<Float64>(static_cast<SInt64>(inHostTime - mBaseHostTime)) - predicted;
+	if (deltaSamples <= 0. || fabs(error) > mRelockThreshold * mHostTicksPerSecond) {
+		// a jump in the timeline, not jitter: start over from here, keeping the rate
+		Lock(inSampleTime, inHostTime);
+		++mStatistics.mRelocks;
+		return;
+	}
+
+	// F. Adriaensen's form of the loop, with omega worked out per update so that the
+	// observations needn't be evenly spaced
+	Float64 omega = 2. * M_PI * mBandwidth * deltaSamples * mTicksPerSample / mHostTicksPerSecond;
+	if (omega > 0.5)
+		omega = 0.5;		// a loop this wide would ring
+	predicted += M_SQRT2 * omega * error;
+	mTicksPerSample += omega * omega * error / deltaSamples;
+
+	// the loop's rate takes every correction, omega squared of the error, so a wide loop's
+	// rate is mostly jitter; the reported rate is smoothed at no more than kRateBandwidth
+	// whatever the loop's bandwidth
+	Float64 rateOmega = omega;
+	if (mBandwidth > kRateBandwidth)
+		rateOmega *= kRateBandwidth / mBandwidth;
+	mSmoothedTicksPerSample += 0.25 * rateOmega * (mTicksPerSample - mSmoothedTicksPerSample);
+
+	// rebase, keeping the fraction of a tick in the phase
+	Float64 wholeTicks = floor(predicted);
+	mBaseHostTime += static_cast<SInt64>(wholeTicks);
+	mPhase = predicted - wholeTicks;
+	mSampleTime = inSampleTime;
+
+	Float64 errorSeconds = fabs(error) / mHostTicksPerSecond;
+	++mStatistics.mUpdates;
+	mSumSquaredError += errorSeconds * errorSeconds;
+	mStatistics.mJitterRMS = sqrt(mSumSquaredError / mStatistics.mUpdates);
+	if (errorSeconds > mStatistics.mJitterMax)
+		mStatistics.mJitterMax = errorSeconds;
+	mStatistics.mDriftPPM = (mNominalTicksPerSample / mSmoothedTicksPerSample - 1.) * 1e6;
+}
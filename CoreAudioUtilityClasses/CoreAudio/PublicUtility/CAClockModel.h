@@ -0,0 +1,140 @@
+/*
+     File: CAClockModel.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+#ifndef __CAClockModel_h__
+#define __CAClockModel_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+//	CAClockModel
+//
+//	Tracks a sample clock against host time from a series of (sample time, host time) pairs
+//	such as the timestamps of I/O callbacks. Those host times are when the callback ran, so
+//	they carry its scheduling jitter; the model is a second order delay-locked loop that
+//	filters it out, following the sample clock's phase and its rate relative to host time.
+//	The loop bandwidth trades how much jitter gets through against how quickly the model
+//	follows real changes of rate: 0.1 to 1 Hz suits a free running audio device.
+//
+//	Conversions between sample time and host time use the model's phase and rate, so take
+//	constant time. Host times are in host ticks at the frequency given at construction.
+class CAClockModel {
+public:
+	struct Statistics {
+		UInt64		mUpdates;			// since the statistics were reset
+		UInt32		mRelocks;			// times the loop lost lock and started over
+		Float64		mJitterRMS;			// of the observed host times about the model, in seconds
+		Float64		mJitterMax;			// in seconds
+		Float64		mDriftPPM;			// of the measured sample rate from nominal
+	};
+
+	CAClockModel(Float64 inHostTicksPerSecond, Float64 inBandwidth = 0.5);
+
+	// Loop bandwidth, in Hz.
+	void			SetBandwidth(Float64 inBandwidth) { mBandwidth = inBandwidth; }
+	Float64			GetBandwidth() const { return mBandwidth; }
+
+	// An observation further than this from the model, in seconds, or going back in sample
+	// time, makes the loop start over from it rather than slew to it.
+	void			SetRelockThreshold(Float64 inSeconds) { mRelockThreshold = inSeconds; }
+	Float64			GetRelockThreshold() const { return mRelockThreshold; }
+
+	// Forgets everything; the next Update starts the model over.
+	void			Reset();
+
+	bool			IsLocked() const { return mLocked; }
+
+	// Adds an observation: the sample time inSampleTime happened at about inHostTime.
+	// inNominalSampleRate seeds the rate and is what drift is measured against.
+	void			Update(Float64 inSampleTime, UInt64 inHostTime, Float64 inNominalSampleRate);
+
+	// The model's host time for a sample time, and the reverse. Only once locked.
+	UInt64			SampleTimeToHostTime(Float64 inSampleTime) const
+	{
+		return mBaseHostTime + static_cast<SInt64>(mPhase + (inSampleTime - mSampleTime) * mTicksPerSample + 0.5);
+	}
+	Float64			HostTimeToSampleTime(UInt64 inHostTime) const
+	{
+		return mSampleTime + (static_cast<Float64>(static_cast<SInt64>(inHostTime - mBaseHostTime)) - mPhase) / mTicksPerSample;
+	}
+
+	// Host ticks per sample, and that over the nominal host ticks per sample: an
+	// AudioTimeStamp's mRateScalar. The loop's own rate moves with every correction it
+	// makes, so these are smoothed further, at no more than 0.1 Hz so that a wide loop's
+	// jitter doesn't reach them.
+	Float64			GetHostTicksPerSample() const { return mSmoothedTicksPerSample; }
+	Float64			GetRateScalar() const { return mSmoothedTicksPerSample / mNominalTicksPerSample; }
+	Float64			GetSampleRate() const { return mHostTicksPerSecond / mSmoothedTicksPerSample; }
+
+	const Statistics &	GetStatistics() const { return mStatistics; }
+	void			ResetStatistics();
+
+private:
+	void			Lock(Float64 inSampleTime, UInt64 inHostTime);
+
+	Float64			mHostTicksPerSecond;
+	Float64			mBandwidth;
+	Float64			mRelockThreshold;
+
+	bool			mLocked;
+	// the model: sample time mSampleTime is at host time mBaseHostTime + mPhase, and
+	// samples are mTicksPerSample ticks long. mBaseHostTime follows along so that mPhase,
+	// in ticks, stays small enough to be precise as a Float64.
+	UInt64			mBaseHostTime;
+	Float64			mPhase;
+	Float64			mSampleTime;
+	Float64			mTicksPerSample;
+	Float64			mSmoothedTicksPerSample;
+	Float64			mNominalTicksPerSample;
+
+	Statistics		mStatistics;
+	Float64			mSumSquaredError;
+};
+
+#endif // __CAClockModel_h__
@@ -0,0 +1,367 @@
+/*
+     File: CAClockModelBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+//	Benchmark and check for CAClockModel.
+//
+//	Synthetic traces: a 48 kHz device whose clock is off nominal by some ppm and wanders,
+//	called back with its timestamps' host times disturbed by different kinds of scheduling
+//	jitter. For each, prints how far the raw host times and the model's, at a few loop
+//	bandwidths, are from the true ones, after the loop has had time to settle, and how
+//	close the model's drift estimate comes, failing if it is off by more than kMaxDriftError
+//	at any bandwidth. Then feeds AUTimestampGenerator a trace where
+//	some timestamps lack a host time, and compares the host times it generates for them by
+//	extrapolating, as before, with those it gets from the model.
+//
+//	Recorded trace: a thread sleeps to the deadlines a 512 frame device would call back at,
+//	stamping each wakeup with CAHostTimeBase, or a trace of "sample-time host-time-in-ticks"
+//	lines is read from the file named on the command line. There is no true timeline, so
+//	the reference is the best fitting straight line through the whole trace.
+//
+//	Builds on other platforms given CoreAudioTypes.h, e.g.:
+//		c++ -O3 -I../AudioUnits/AUPublic/Utility -o CAClockModelBenchmark CAClockModelBenchmark.cpp
+//			CAClockModel.cpp CAHostTimeBase.cpp ../AudioUnits/AUPublic/Utility/AUTimestampGenerator.cpp
+
+#include "CAClockModel.h"
+#include "CAHostTimeBase.h"
+#include "AUTimestampGenerator.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+static const Float64	kSampleRate		= 48000.;
+static const Float64	kHostFrequency	= 1e9;		// synthetic traces are in nanoseconds
+static const Float64	kSettleSeconds	= 20.;
+static const Float64	kBandwidths[]	= { 0.1, 0.5, 1.0, 2.0 };
+static const int		kNumBandwidths	= sizeof(kBandwidths) / sizeof(kBandwidths[0]);
+static const Float64	kMaxDriftError	= 12.;		// ppm rms, at any bandwidth
+
+struct Callback {
+	Float64		mSampleTime;
+	UInt64		mHostTime;		// as observed
+	Float64		mTrueHostTime;	// or the reference's
+	Float64		mTrueDriftPPM;
+};
+
+// ____________________________________________________________________________________
+// random numbers
+
+static UInt64 sRandomState = 0x9E3779B97F4A7C15ULL;
+
+static Float64 Uniform()
+{
+	sRandomState ^= sRandomState << 13;
+	sRandomState ^= sRandomState >> 7;
+	sRandomState ^= sRandomState << 17;
+	return (sRandomState >> 11) * (1. / 9007199254740992.);
+}
+
+static Float64 Gaussian()
+{
+	Float64 u = Uniform(), v = Uniform();
+	return sqrt(-2. * log(u + 1e-300)) * cos(2. * M_PI * v);
+}
+
+// ____________________________________________________________________________________
+// synthetic traces
+
+enum JitterKind { kGaussian, kLateTail, kTimerQuantized };
+
+struct Scenario {
+	const char *	mName;
+	JitterKind		mJitter;
+	Float64			mDriftPPM;
+	Float64			mWanderPPM;		// sinusoidal, over a minute
+	bool			mVariableFrames;
+};
+
+static Float64 Jitter(JitterKind inKind)
+{
+	switch (inKind) {
+	case kGaussian:			// a loaded but well behaved system
+		return 150e-6 * fabs(Gaussian());
+	case kLateTail:			// mostly prompt, now and then very late
+		return Uniform() < 0.02 ? 0.5e-3 + 3e-3 * Uniform() : 40e-6 * Uniform();
+	case kTimerQuantized:	// woken by a 1 ms tick
+		return 1e-3 * Uniform();
+	}
+	return 0.;
+}
+
+static std::vector<Callback> MakeTrace(const Scenario &inScenario, Float64 inSeconds)
+{
+	std::vector<Callback> trace;
+	Float64 t = 1000.;			// seconds; host time doesn't start at zero
+	Float64 sampleTime = 0.;
+	while (t < 1000. + inSeconds) {
+		Float64 ppm = inScenario.mDriftPPM + inScenario.mWanderPPM * sin(2. * M_PI * (t - 1000.) / 60.);
+		Callback cb;
+		cb.mSampleTime = sampleTime;
+		cb.mTrueHostTime = t * kHostFrequency;
+		cb.mHostTime = static_cast<UInt64>((t + Jitter(inScenario.mJitter)) * kHostFrequency);
+		cb.mTrueDriftPPM = ppm;
+		trace.push_back(cb);
+		Float64 frames = inScenario.mVariableFrames ? floor(256. + 768. * Uniform()) : 512.;
+		sampleTime += frames;
+		t += frames / (kSampleRate * (1. + ppm * 1e-6));
+	}
+	return trace;
+}
+
+// ____________________________________________________________________________________
+// error statistics, about the mean: a constant latency isn't jitter
+
+struct ErrorStats {
+	std::vector<Float64>	mErrors;
+
+	void	Add(Float64 inError) { mErrors.push_back(inError); }
+	Float64	Mean() const
+	{
+		Float64 sum = 0.;
+		for (size_t i = 0; i < mErrors.size(); ++i)
+			sum += mErrors[i];
+		return mErrors.empty() ? 0. : sum / mErrors.size();
+	}
+	Float64	RMS() const
+	{
+		Float64 mean = Mean(), sum = 0.;
+		for (size_t i = 0; i < mErrors.size(); ++i)
+			sum += (mErrors[i] - mean) * (mErrors[i] - mean);
+		return mErrors.empty() ? 0. : sqrt(sum / mErrors.size());
+	}
+	Float64	Max() const
+	{
+		Float64 mean = Mean(), worst = 0.;
+		for (size_t i = 0; i < mErrors.size(); ++i)
+			if (fabs(mErrors[i] - mean) > worst)
+				worst = fabs(mErrors[i] - mean);
+		return worst;
+	}
+};
+
+// runs the trace through models of each bandwidth, printing jitter about the true times;
+// false if a drift estimate strays further than kMaxDriftError from the true drift
+static bool Measure(const char *inName, const std::vector<Callback> &inTrace, Float64 inHostFrequency, bool inShowTrueDrift)
+{
+	Float64 start = inTrace[0].mTrueHostTime;
+	ErrorStats raw;
+	for (size_t i = 0; i < inTrace.size(); ++i)
+		if (inTrace[i].mTrueHostTime - start >= kSettleSeconds * inHostFrequency)
+			raw.Add((static_cast<Float64>(inTrace[i].mHostTime) - inTrace[i].mTrueHostTime) / inHostFrequency);
+
+	printf("%-28s raw          %8.1f us rms %8.1f us max\n", inName, 1e6 * raw.RMS(), 1e6 * raw.Max());
+	bool ok = true;
+	for (int b = 0; b < kNumBandwidths; ++b) {
+		CAClockModel model(inHostFrequency, kBandwidths[b]);
+		ErrorStats modeled, drift;
+		for (size_t i = 0; i < inTrace.size(); ++i) {
+			const Callback &cb = inTrace[i];
+			model.Update(cb.mSampleTime, cb.mHostTime, kSampleRate);
+			if (cb.mTrueHostTime - start < kSettleSeconds * inHostFrequency)
+				continue;
+			// compared as a difference from the start, which a Float64 holds exactly
+			Float64 modelHostTime = static_cast<Float64>(static_cast<SInt64>(model.SampleTimeToHostTime(cb.mSampleTime) - inTrace[0].mHostTime));
+			modeled.Add((modelHostTime - (cb.mTrueHostTime - static_cast<Float64>(inTrace[0].mHostTime))) / inHostFrequency);
+			drift.Add(model.GetStatistics().mDriftPPM - cb.mTrueDriftPPM);
+		}
+		const CAClockModel::Statistics &stats = model.GetStatistics();
+		printf("%-28s DLL %4.1f Hz  %8.1f us rms %8.1f us max  (%4.1fx less)  drift %+7.2f ppm",
+			"", kBandwidths[b], 1e6 * modeled.RMS(), 1e6 * modeled.Max(), raw.RMS() / modeled.RMS(), stats.mDriftPPM);
+		if (inShowTrueDrift) {
+			Float64 driftError = sqrt(drift.RMS() * drift.RMS() + drift.Mean() * drift.Mean());
+			printf(", error %6.2f rms", driftError);
+			if (driftError > kMaxDriftError) {
+				printf(" FAILED");
+				ok = false;
+			}
+		}
+		if (stats.mRelocks)
+			printf(", %u relocks", (unsigned)stats.mRelocks);
+		printf("\n");
+	}
+	return ok;
+}
+
+// ____________________________________________________________________________________
+// AUTimestampGenerator, with and without the model, filling in missing host times
+
+static void MeasureGenerator(const std::vector<Callback> &inTrace)
+{
+	printf("\nAUTimestampGenerator, 3 of 4 downstream timestamps without host time:\n");
+	for (int useModel = 0; useModel < 2; ++useModel) {
+		AUTimestampGenerator generator(true);
+		generator.SetStartInputAtZero(false);
+		if (useModel)
+			generator.SetClockModelBandwidth(0.5);
+		ErrorStats synthesized;
+		Float64 start = inTrace[0].mTrueHostTime;
+		Float64 hostTicksPerNano = CAHostTimeBase::GetFrequency() / kHostFrequency;
+		for (size_t i = 0; i + 1 < inTrace.size(); ++i) {
+			const Callback &cb = inTrace[i];
+			AudioTimeStamp ts;
+			memset(&ts, 0, sizeof(ts));
+			ts.mSampleTime = cb.mSampleTime;
+			ts.mFlags = kAudioTimeStampSampleTimeValid;
+			bool hasHostTime = (i & 3) == 0;
+			if (hasHostTime) {
+				ts.mHostTime = static_cast<UInt64>(cb.mHostTime * hostTicksPerNano);
+				ts.mFlags |= kAudioTimeStampHostTimeValid;
+			}
+			Float64 frames = inTrace[i + 1].mSampleTime - cb.mSampleTime;
+			generator.AddOutputTime(ts, frames, kSampleRate);
+			const AudioTimeStamp &in = generator.GenerateInputTime(frames, kSampleRate);
+			if (!hasHostTime && cb.mTrueHostTime - start >= kSettleSeconds * kHostFrequency)
+				synthesized.Add((in.mHostTime / hostTicksPerNano - cb.mTrueHostTime) / kHostFrequency);
+		}
+		printf("%-28s %-12s %8.1f us rms %8.1f us max\n", "", useModel ? "clock model" : "extrapolated",
+			1e6 * synthesized.RMS(), 1e6 * synthesized.Max());
+	}
+}
+
+// ____________________________________________________________________________________
+// recorded trace
+
+static std::vector<Callback> RecordTrace(Float64 inSeconds)
+{
+	std::vector<Callback> trace;
+	const Float64 frames = 512.;
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	Float64 period = frames / kSampleRate;
+	for (Float64 sampleTime = 0.; sampleTime < inSeconds * kSampleRate; sampleTime += frames) {
+		Float64 ns = deadline.tv_nsec + period * 1e9 * (sampleTime > 0.);
+		deadline.tv_sec += static_cast<time_t>(ns / 1e9);
+		deadline.tv_nsec = static_cast<long>(fmod(ns, 1e9));
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+		Callback cb;
+		cb.mSampleTime = sampleTime;
+		cb.mHostTime = CAHostTimeBase::GetTheCurrentTime();
+		cb.mTrueDriftPPM = 0.;
+		trace.push_back(cb);
+	}
+	return trace;
+}
+
+static std::vector<Callback> ReadTrace(const char *inPath)
+{
+	std::vector<Callback> trace;
+	FILE *f = fopen(inPath, "r");
+	if (f == NULL) {
+		perror(inPath);
+		exit(1);
+	}
+	double sampleTime;
+	unsigned long long hostTime;
+	while (fscanf(f, "%lf %llu", &sampleTime, &hostTime) == 2) {
+		Callback cb;
+		cb.mSampleTime = sampleTime;
+		cb.mHostTime = hostTime;
+		cb.mTrueDriftPPM = 0.;
+		trace.push_back(cb);
+	}
+	fclose(f);
+	return trace;
+}
+
+// least squares line through the trace, relative to its first host time, as the reference
+static void FitReference(std::vector<Callback> &ioTrace)
+{
+	Float64 n = ioTrace.size(), sx = 0., sy = 0., sxx = 0., sxy = 0.;
+	UInt64 base = ioTrace[0].mHostTime;
+	for (size_t i = 0; i < ioTrace.size(); ++i) {
+		Float64 x = ioTrace[i].mSampleTime - ioTrace[0].mSampleTime;
+		Float64 y = static_cast<Float64>(static_cast<SInt64>(ioTrace[i].mHostTime - base));
+		sx += x; sy += y; sxx += x * x; sxy += x * y;
+	}
+	Float64 slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+	Float64 intercept = (sy - slope * sx) / n;
+	for (size_t i = 0; i < ioTrace.size(); ++i)
+		ioTrace[i].mTrueHostTime = static_cast<Float64>(base) + intercept + slope * (ioTrace[i].mSampleTime - ioTrace[0].mSampleTime);
+	printf("best fit line: %.0f ticks/s, %+.2f ppm from nominal\n",
+		kSampleRate * slope, ((CAHostTimeBase::GetFrequency() / kSampleRate) / slope - 1.) * 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+	const Scenario scenarios[] = {
+		{ "gaussian, +37 ppm",				kGaussian,			37.,	0.,		false },
+		{ "late tail, -12 ppm",				kLateTail,			-12.,	0.,		false },
+		{ "1 ms timer, +80 ppm",			kTimerQuantized,	80.,	0.,		false },
+		{ "gaussian, +20±5 ppm wander",		kGaussian,			20.,	5.,		false },
+		{ "gaussian, variable frames",		kGaussian,			37.,	0.,		true },
+	};
+	printf("synthetic traces, 48 kHz, 120 s, statistics after %.0f s, drift error at most %.0f ppm\n",
+		kSettleSeconds, kMaxDriftError);
+	bool ok = true;
+	for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+		std::vector<Callback> trace = MakeTrace(scenarios[i], 120.);
+		ok &= Measure(scenarios[i].mName, trace, kHostFrequency, true);
+	}
+	if (!ok)
+		printf("DRIFT ERROR\n");
+
+	Scenario generatorScenario = { "", kLateTail, 37., 0., false };
+	MeasureGenerator(MakeTrace(generatorScenario, 120.));
+
+	std::vector<Callback> recorded;
+	if (argc > 1) {
+		recorded = ReadTrace(argv[1]);
+		printf("\n%s: %u callbacks\n", argv[1], (unsigned)recorded.size());
+	} else {
+		Float64 seconds = 2. * kSettleSeconds;
+		printf("\nrecording %.0f s of 512 frame callbacks...\n", seconds);
+		recorded = RecordTrace(seconds);
+	}
+	if (recorded.size() < 16) {
+		printf("trace too short\n");
+		return 1;
+	}
+	FitReference(recorded);
+	Measure(argc > 1 ? "recorded trace" : "live trace", recorded, CAHostTimeBase::GetFrequency(), false);
+	return ok ? 0 : 1;
+}
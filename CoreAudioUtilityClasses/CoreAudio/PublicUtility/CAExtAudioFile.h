@@ -61,6 +61,9 @@
 #include "CAStreamBasicDescription.h"
 #include "CAAudioChannelLayout.h"
 #include "CACFObject.h"
+#if !TARGET_OS_WIN32
+	#include "CAWriteBehindFile.h"
+#endif
 
 // A C++ wrapper for ExtAudioFile
 // Error returns throw CAXExceptions.
@@ -68,7 +71,7 @@ class CAExtAudioFile {
 public:
 	// instances are not automatically associated with open files.
 	CAExtAudioFile() :
-		mExtAudioFile(NULL) { }
+		mExtAudioFile(NULL), mWrappedAudioFile(NULL) { }
 
 	virtual ~CAExtAudioFile()
 	{
@@ -119,6 +122,24 @@ public:
 		Check(ExtAudioFileCreateWithURL(url, filetype, &streamDesc, channelLayout, flags, &mExtAudioFile), "ExtAudioFileCreateWithURL");
 	}
 
+#if !TARGET_OS_WIN32
+	// creates a file that is written through a CAWriteBehindFile, so that Write never waits for the disk.
+	// the write-behind file must stay open until this one is closed.
+	void	CreateWithWriteBehind(CAWriteBehindFile &file, AudioFileTypeID filetype, const AudioStreamBasicDescription &streamDesc, const AudioChannelLayout *channelLayout, UInt32 flags)
+	{
+		Close();
+		AudioFileID fileID = NULL;
+		Check(AudioFileInitializeWithCallbacks(&file, WriteBehindRead, WriteBehindWrite, WriteBehindGetSize, WriteBehindSetSize, filetype, &streamDesc, flags, &fileID), "AudioFileInitializeWithCallbacks");
+		OSStatus res = ExtAudioFileWrapAudioFileID(fileID, true, &mExtAudioFile);
+		if (res)
+			AudioFileClose(fileID);
+		Check(res, "ExtAudioFileWrapAudioFileID");
+		mWrappedAudioFile = fileID;
+		if (channelLayout)
+			SetProperty(kExtAudioFileProperty_FileChannelLayout, CAAudioChannelLayout::CalculateByteSize(channelLayout->mNumberChannelDescriptions), channelLayout);
+	}
+#endif
+
 	// you may explicitly close a file, or have it closed automatically by the destructor.
 	void	Close()
 	{
@@ -126,6 +147,12 @@ public:
 			Check(ExtAudioFileDispose(mExtAudioFile), "ExtAudioFileClose");
 			mExtAudioFile = NULL;
 		}
+		if (mWrappedAudioFile != NULL) {
+			// disposing of an ExtAudioFile doesn't close the audio file it wraps
+			AudioFileID fileID = mWrappedAudioFile;
+			mWrappedAudioFile = NULL;
+			Check(AudioFileClose(fileID), "AudioFileClose");
+		}
 	}
 	
 	void	Read(UInt32 &ioNumberFrames, AudioBufferList *ioData)
@@ -281,12 +308,39 @@ protected:
 		return layoutObj;
 	}
 
+#if !TARGET_OS_WIN32
+	// AudioFile callbacks for CreateWithWriteBehind
+	static OSStatus	WriteBehindRead(void *inClientData, SInt64 inPosition, UInt32 requestCount, void *buffer, UInt32 *actualCount)
+	{
+		return static_cast<CAWriteBehindFile *>(inClientData)->ReadAt(inPosition, buffer, requestCount, *actualCount) ? noErr : kAudioFilePositionError;
+	}
+	
+	static OSStatus	WriteBehindWrite(void *inClientData, SInt64 inPosition, UInt32 requestCount, const void *buffer, UInt32 *actualCount)
+	{
+		// dropped data isn't an error, it's counted in the write-behind file's metrics
+		static_cast<CAWriteBehindFile *>(inClientData)->WriteAt(inPosition, buffer, requestCount);
+		*actualCount = requestCount;
+		return noErr;
+	}
+	
+	static SInt64	WriteBehindGetSize(void *inClientData)
+	{
+		return static_cast<CAWriteBehindFile *>(inClientData)->GetSize();
+	}
+	
+	static OSStatus	WriteBehindSetSize(void *inClientData, SInt64 inSize)
+	{
+		return static_cast<CAWriteBehindFile *>(inClientData)->SetSize(inSize) ? noErr : kAudioFilePermissionsError;
+	}
+#endif
+
 private:
 	CAExtAudioFile(const CAExtAudioFile &) { }	// prohibit
 	CAExtAudioFile & operator = (const CAExtAudioFile &) { return *this; } // prohibit
 
 private:
 	ExtAudioFileRef				mExtAudioFile;
+	AudioFileID					mWrappedAudioFile;	// opened by CreateWithWriteBehind
 	
 	// for convenience to the client, it helps if we hold onto some storage for these
 	CAStreamBasicDescription	mFileDataFormat;
@@ -93,6 +93,14 @@ void	CAHostTimeBase::Initialize()
 		sFromNanosNumerator = sToNanosDenominator;
 		sFromNanosDenominator = sToNanosNumerator;
 		sFrequency = static_cast<Float64>(*((UInt64*)&theFrequency));
+	#elif defined(__linux__)
+		//	host time is CLOCK_MONOTONIC_RAW in nanoseconds
+		sMinDelta = 1;
+		sToNanosNumerator = 1;
+		sToNanosDenominator = 1;
+		sFromNanosNumerator = 1;
+		sFromNanosDenominator = 1;
+		sFrequency = 1000000000.0;
 	#endif
 	sInverseFrequency = 1.0 / sFrequency;
 	
@@ -61,6 +61,8 @@
 	#include <mach/mach_time.h>
 #elif TARGET_OS_WIN32
 	#include <windows.h>
+#elif defined(__linux__)
+	#include <time.h>
 #else
 	#error	Unsupported operating system
 #endif
@@ -126,6 +128,12 @@ inline UInt64	CAHostTimeBase::GetTheCurrentTime()
 		LARGE_INTEGER theValue;
 		QueryPerformanceCounter(&theValue);
 		theTime = *((UInt64*)&theValue);
+	#elif defined(__linux__)
+		//	the raw clock isn't slewed by NTP, so like mach_absolute_time it runs at the
+		//	hardware's own rate, which is what audio clocks are measured against
+		struct timespec theValue;
+		clock_gettime(CLOCK_MONOTONIC_RAW, &theValue);
+		theTime = static_cast<UInt64>(theValue.tv_sec) * 1000000000ULL + theValue.tv_nsec;
 	#endif
 	
 	#if	Track_Host_TimeBase
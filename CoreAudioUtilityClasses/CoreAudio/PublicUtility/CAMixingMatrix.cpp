@@ -0,0 +1,330 @@
+/*
+     File: CAMixingMatrix.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+#include "CAMixingMatrix.h"
+#include <string.h>
+#include <algorithm>
+
+#if defined(__SSE__)
+	#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+#endif
+
+// Frames per tile. 512 frames of output is 2KB, which stays in the first level cache
+// while each group of inputs is accumulated into it.
+static const UInt32 kTileFrames = 512;
+
+// Inputs accumulated per pass over an output tile.
+static const UInt32 kGroupSize = 4;
+
+namespace {
+
+#if defined(__SSE__)
+	typedef __m128 Vec4;
+	inline Vec4		VLoad(const Float32 *p)				{ return _mm_loadu_ps(p); }
+	inline void		VStore(Float32 *p, Vec4 v)			{ _mm_storeu_ps(p, v); }
+	inline Vec4		VSplat(Float32 x)					{ return _mm_set1_ps(x); }
+	inline Vec4		VZero()								{ return _mm_setzero_ps(); }
+	inline Vec4		VAdd(Vec4 a, Vec4 b)				{ return _mm_add_ps(a, b); }
+	inline Vec4		VMulAdd(Vec4 a, Vec4 b, Vec4 c)		{ return _mm_add_ps(a, _mm_mul_ps(b, c)); }
+	inline Vec4		VRamp(Float32 x, Float32 step)		{ return _mm_setr_ps(x, x + step, x + 2 * step, x + 3 * step); }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	typedef float32x4_t Vec4;
+	inline Vec4		VLoad(const Float32 *p)				{ return vld1q_f32(p); }
+	inline void		VStore(Float32 *p, Vec4 v)			{ vst1q_f32(p, v); }
+	inline Vec4		VSplat(Float32 x)					{ return vdupq_n_f32(x); }
+	inline Vec4		VZero()								{ return vdupq_n_f32(0.f); }
+	inline Vec4		VAdd(Vec4 a, Vec4 b)				{ return vaddq_f32(a, b); }
+	inline Vec4		VMulAdd(Vec4 a, Vec4 b, Vec4 c)		{ return vmlaq_f32(a, b, c); }
+	inline Vec4		VRamp(Float32 x, Float32 step)		{ const Float32 v[4] = { x, x + step, x + 2 * step, x + 3 * step }; return vld1q_f32(v); }
+#else
+	struct Vec4 { Float32 v[4]; };
+	inline Vec4		VLoad(const Float32 *p)				{ Vec4 r = {{ p[0], p[1], p[2], p[3] }}; return r; }
+	inline void		VStore(Float32 *p, Vec4 v)			{ p[0] = v.v[0]; p[1] = v.v[1]; p[2] = v.v[2]; p[3] = v.v[3]; }
+	inline Vec4		VSplat(Float32 x)					{ Vec4 r = {{ x, x, x, x }}; return r; }
+	inline Vec4		VZero()								{ return VSplat(0.f); }
+	inline Vec4		VAdd(Vec4 a, Vec4 b)				{ for (int i = 0; i < 4; ++i) a.v[i] += b.v[i]; return a; }
+	inline Vec4		VMulAdd(Vec4 a, Vec4 b, Vec4 c)		{ for (int i = 0; i < 4; ++i) a.v[i] += b.v[i] * c.v[i]; return a; }
+	inline Vec4		VRamp(Float32 x, Float32 step)		{ Vec4 r = {{ x, x + step, x + 2 * step, x + 3 * step }}; return r; }
+#endif
+
+// out[i] = (accumulate ? out[i] : 0) + sum of gain[j] * in[j][i], for N inputs.
+template <int N>
+void Mix(Float32 *out, const Float32 * const *in, const Float32 *gain, bool accumulate, UInt32 frames)
+{
+	Vec4 g[N];
+	for (int j = 0; j < N; ++j)
+		g[j] = VSplat(gain[j]);
+
+	UInt32 i = 0;
+	for (; i + 4 <= frames; i += 4) {
+		Vec4 sum = accumulate ? VLoad(out + i) : VZero();
+		for (int j = 0; j < N; ++j)
+			sum = VMulAdd(sum, g[j], VLoad(in[j] + i));
+		VStore(out + i, sum);
+	}
+	for (; i < frames; ++i) {
+		Float32 sum = accumulate ? out[i] : 0.f;
+		for (int j = 0; j < N; ++j)
+			sum += gain[j] * in[j][i];
+		out[i] = sum;
+	}
+}
+
+// As Mix, with gain[j] + step[j] * i applied to frame i.
+template <int N>
+void MixRamp(Float32 *out, const Float32 * const *in, const Float32 *gain, const Float32 *step, bool accumulate, UInt32 frames)
+{
+	Vec4 g[N], dg[N];
+	for (int j = 0; j < N; ++j) {
+		g[j] = VRamp(gain[j], step[j]);
+		dg[j] = VSplat(4 * step[j]);
+	}
+
+	UInt32 i = 0;
+	for (; i + 4 <= frames; i += 4) {
+		Vec4 sum = accumulate ? VLoad(out + i) : VZero();
+		for (int j = 0; j < N; ++j) {
+			sum = VMulAdd(sum, g[j], VLoad(in[j] + i));
+			g[j] = VAdd(g[j], dg[j]);
+		}
+		VStore(out + i, sum);
+	}
+	for (; i < frames; ++i) {
+		Float32 sum = accumulate ? out[i] : 0.f;
+		for (int j = 0; j < N; ++j)
+			sum += (gain[j] + step[j] * i) * in[j][i];
+		out[i] = sum;
+	}
+}
+
+typedef void (*MixFunction)(Float32 *, const Float32 * const *, const Float32 *, bool, UInt32);
+typedef void (*MixRampFunction)(Float32 *, const Float32 * const *, const Float32 *, const Float32 *, bool, UInt32);
+
+const MixFunction kMix[kGroupSize + 1] = { NULL, Mix<1>, Mix<2>, Mix<3>, Mix<4> };
+const MixRampFunction kMixRamp[kGroupSize + 1] = { NULL, MixRamp<1>, MixRamp<2>, MixRamp<3>, MixRamp<4> };
+
+} // namespace
+
+//_____________________________________________________________________________
+//
+CAMixingMatrix::CAMixingMatrix()
+	: mNumberInputs(0), mNumberOutputs(0), mRampFramesRemaining(0)
+{
+}
+
+CAMixingMatrix::CAMixingMatrix(UInt32 inNumberInputs, UInt32 inNumberOutputs)
+	: mNumberInputs(0), mNumberOutputs(0), mRampFramesRemaining(0)
+{
+	SetDimensions(inNumberInputs, inNumberOutputs);
+}
+
+void	CAMixingMatrix::SetDimensions(UInt32 inNumberInputs, UInt32 inNumberOutputs)
+{
+	mNumberInputs = inNumberInputs;
+	mNumberOutputs = inNumberOutputs;
+	mTargetGains.assign(inNumberInputs * inNumberOutputs, 0.f);
+	mCurrentGains.assign(inNumberInputs * inNumberOutputs, 0.f);
+	mInputPointers.resize(inNumberInputs);
+	mOutputPointers.resize(inNumberOutputs);
+	mRampFramesRemaining = 0;
+
+	// Reserve for the densest schedule, so that Compile never allocates.
+	mTerms.reserve(inNumberInputs * inNumberOutputs);
+	mRoutes.reserve(inNumberOutputs);
+	Compile();
+}
+
+void	CAMixingMatrix::SetGains(const Float32 *inGains, UInt32 inRampFrames)
+{
+	std::copy(inGains, inGains + mTargetGains.size(), mTargetGains.begin());
+	if (inRampFrames == 0)
+		mCurrentGains = mTargetGains;
+	mRampFramesRemaining = inRampFrames;
+	Compile();
+}
+
+void	CAMixingMatrix::Compile()
+{
+	const bool ramping = mRampFramesRemaining > 0;
+	mTerms.clear();
+	mRoutes.clear();
+
+	for (UInt32 out = 0; out < mNumberOutputs; ++out) {
+		Route route = { kRoute_Silent, static_cast<UInt32>(mTerms.size()), 0 };
+		for (UInt32 in = 0; in < mNumberInputs; ++in) {
+			const Float32 current = mCurrentGains[in * mNumberOutputs + out];
+			const Float32 target = mTargetGains[in * mNumberOutputs + out];
+			if (current == 0.f && target == 0.f)
+				continue;
+			Term term = { in, current, ramping ? (target - current) / mRampFramesRemaining : 0.f };
+			mTerms.push_back(term);
+		}
+		route.mNumberTerms = static_cast<UInt32>(mTerms.size()) - route.mFirstTerm;
+		if (route.mNumberTerms == 1 && !ramping && mTerms[route.mFirstTerm].mGain == 1.f)
+			route.mKind = kRoute_Copy;
+		else if (route.mNumberTerms > 0)
+			route.mKind = kRoute_Mix;
+		mRoutes.push_back(route);
+	}
+}
+
+//_____________________________________________________________________________
+//
+void	CAMixingMatrix::Render(const Float32 * const *inInputs, Float32 * const *outOutputs, UInt32 inNumberFrames)
+{
+	UInt32 done = 0;
+	if (mRampFramesRemaining > 0) {
+		done = std::min(inNumberFrames, mRampFramesRemaining);
+		RenderRamp(inInputs, outOutputs, done);
+	}
+	if (done < inNumberFrames)
+		RenderSteady(inInputs, outOutputs, done, inNumberFrames - done);
+}
+
+void	CAMixingMatrix::Render(const AudioBufferList &inInput, AudioBufferList &outOutput, UInt32 inNumberFrames)
+{
+	const UInt32 inputs = std::min(mNumberInputs, static_cast<UInt32>(inInput.mNumberBuffers));
+	const UInt32 outputs = std::min(mNumberOutputs, static_cast<UInt32>(outOutput.mNumberBuffers));
+
+	// Rather than read or write past the buffer lists, output silence if they don't match.
+	if (inputs < mNumberInputs || outputs < mNumberOutputs) {
+		for (UInt32 i = 0; i < outOutput.mNumberBuffers; ++i)
+			memset(outOutput.mBuffers[i].mData, 0, inNumberFrames * sizeof(Float32));
+		return;
+	}
+
+	for (UInt32 i = 0; i < inputs; ++i)
+		mInputPointers[i] = static_cast<const Float32 *>(inInput.mBuffers[i].mData);
+	for (UInt32 i = 0; i < outputs; ++i)
+		mOutputPointers[i] = static_cast<Float32 *>(outOutput.mBuffers[i].mData);
+
+	Render(mInputPointers.empty() ? NULL : &mInputPointers[0],
+		   mOutputPointers.empty() ? NULL : &mOutputPointers[0], inNumberFrames);
+}
+
+void	CAMixingMatrix::RenderSteady(const Float32 * const *inInputs, Float32 * const *outOutputs, UInt32 inOffset, UInt32 inNumberFrames)
+{
+	for (UInt32 out = 0; out < mNumberOutputs; ++out) {
+		const Route &route = mRoutes[out];
+		Float32 *dest = outOutputs[out] + inOffset;
+
+		switch (route.mKind) {
+		case kRoute_Silent:
+			memset(dest, 0, inNumberFrames * sizeof(Float32));
+			break;
+
+		case kRoute_Copy:
+			memcpy(dest, inInputs[mTerms[route.mFirstTerm].mInput] + inOffset, inNumberFrames * sizeof(Float32));
+			break;
+
+		default:
+			for (UInt32 tile = 0; tile < inNumberFrames; tile += kTileFrames) {
+				const UInt32 frames = std::min(kTileFrames, inNumberFrames - tile);
+				for (UInt32 t = 0; t < route.mNumberTerms; t += kGroupSize) {
+					const UInt32 n = std::min(kGroupSize, route.mNumberTerms - t);
+					const Float32 *in[kGroupSize];
+					Float32 gain[kGroupSize];
+					for (UInt32 j = 0; j < n; ++j) {
+						const Term &term = mTerms[route.mFirstTerm + t + j];
+						in[j] = inInputs[term.mInput] + inOffset + tile;
+						gain[j] = term.mGain;
+					}
+					kMix[n](dest + tile, in, gain, t > 0, frames);
+				}
+			}
+			break;
+		}
+	}
+}
+
+void	CAMixingMatrix::RenderRamp(const Float32 * const *inInputs, Float32 * const *outOutputs, UInt32 inNumberFrames)
+{
+	for (UInt32 out = 0; out < mNumberOutputs; ++out) {
+		const Route &route = mRoutes[out];
+		Float32 *dest = outOutputs[out];
+
+		if (route.mNumberTerms == 0) {
+			memset(dest, 0, inNumberFrames * sizeof(Float32));
+			continue;
+		}
+
+		for (UInt32 tile = 0; tile < inNumberFrames; tile += kTileFrames) {
+			const UInt32 frames = std::min(kTileFrames, inNumberFrames - tile);
+			for (UInt32 t = 0; t < route.mNumberTerms; t += kGroupSize) {
+				const UInt32 n = std::min(kGroupSize, route.mNumberTerms - t);
+				const Float32 *in[kGroupSize];
+				Float32 gain[kGroupSize], step[kGroupSize];
+				for (UInt32 j = 0; j < n; ++j) {
+					const Term &term = mTerms[route.mFirstTerm + t + j];
+					in[j] = inInputs[term.mInput] + tile;
+					// The gain for ramp frame k (counting from 1) is mGain + k * mStep.
+					gain[j] = term.mGain + (tile + 1) * term.mStep;
+					step[j] = term.mStep;
+				}
+				kMixRamp[n](dest + tile, in, gain, step, t > 0, frames);
+			}
+		}
+	}
+
+	mRampFramesRemaining -= inNumberFrames;
+	if (mRampFramesRemaining == 0) {
+		// Land exactly on the targets and drop the entries that ramped to zero.
+		mCurrentGains = mTargetGains;
+		Compile();
+		return;
+	}
+
+	for (UInt32 out = 0; out < mNumberOutputs; ++out) {
+		const Route &route = mRoutes[out];
+		for (UInt32 t = 0; t < route.mNumberTerms; ++t) {
+			Term &term = mTerms[route.mFirstTerm + t];
+			term.mGain += inNumberFrames * term.mStep;
+			mCurrentGains[term.mInput * mNumberOutputs + out] = term.mGain;
+		}
+	}
+}
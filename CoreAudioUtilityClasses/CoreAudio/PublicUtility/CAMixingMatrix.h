@@ -0,0 +1,133 @@
+/*
+     File: CAMixingMatrix.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+#ifndef __CAMixingMatrix_h__
+#define __CAMixingMatrix_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+#include <vector>
+
+// CAMixingMatrix mixes deinterleaved Float32 input channels into output channels
+// through a matrix of gains, the operation behind bypass matrices and matrix mixers.
+//
+// Setting the gains compiles the matrix into a schedule: for each output, the list of
+// inputs with non-zero gain. Outputs with no inputs are cleared, outputs fed by one
+// input at unity gain are copied, and the rest are mixed in one pass per group of
+// four inputs, over tiles of frames small enough that the output stays in the first
+// level cache between passes. A sparse or diagonal matrix therefore costs about as
+// much as its non-zero entries, not inputs * outputs passes over the buffers.
+//
+// Gain changes can be ramped linearly over a number of frames to avoid zipper noise.
+//
+// SetDimensions allocates; SetGains and Render do not, so SetGains may be called on
+// the render thread. Calls must not overlap, and input and output buffers must not
+// alias.
+class CAMixingMatrix {
+public:
+	CAMixingMatrix();
+	CAMixingMatrix(UInt32 inNumberInputs, UInt32 inNumberOutputs);
+
+	void			SetDimensions(UInt32 inNumberInputs, UInt32 inNumberOutputs);
+						// all gains become zero
+	UInt32			GetNumberInputs() const { return mNumberInputs; }
+	UInt32			GetNumberOutputs() const { return mNumberOutputs; }
+
+	void			SetGains(const Float32 *inGains, UInt32 inRampFrames = 0);
+						// inGains[input * GetNumberOutputs() + output], the layout of
+						// kAudioFormatProperty_MatrixMixMap. With inRampFrames > 0, each gain
+						// moves linearly from its current value to the new one over that many
+						// frames, starting with the next Render; a ramp in progress continues
+						// from wherever it has reached.
+	Float32			GetGain(UInt32 inInput, UInt32 inOutput) const
+						{ return mTargetGains[inInput * mNumberOutputs + inOutput]; }
+	bool			IsRamping() const { return mRampFramesRemaining > 0; }
+	UInt32			GetNumberOfRoutes() const { return static_cast<UInt32>(mTerms.size()); }
+						// non-zero entries in the current schedule
+
+	void			Render(const Float32 * const *inInputs, Float32 * const *outOutputs, UInt32 inNumberFrames);
+	void			Render(const AudioBufferList &inInput, AudioBufferList &outOutput, UInt32 inNumberFrames);
+						// one channel per buffer
+
+private:
+	enum {
+		kRoute_Silent,
+		kRoute_Copy,
+		kRoute_Mix
+	};
+
+	struct Term {
+		UInt32		mInput;
+		Float32		mGain;		// current gain
+		Float32		mStep;		// per-frame change while ramping
+	};
+
+	struct Route {
+		UInt32		mKind;
+		UInt32		mFirstTerm;
+		UInt32		mNumberTerms;
+	};
+
+	void			Compile();
+	void			RenderSteady(const Float32 * const *inInputs, Float32 * const *outOutputs, UInt32 inOffset, UInt32 inNumberFrames);
+	void			RenderRamp(const Float32 * const *inInputs, Float32 * const *outOutputs, UInt32 inNumberFrames);
+
+	UInt32					mNumberInputs;
+	UInt32					mNumberOutputs;
+	std::vector<Float32>	mTargetGains;
+	std::vector<Float32>	mCurrentGains;
+	std::vector<Term>		mTerms;			// grouped by output
+	std::vector<Route>		mRoutes;		// one per output
+	UInt32					mRampFramesRemaining;
+	std::vector<const Float32 *>	mInputPointers;		// for the AudioBufferList interface
+	std::vector<Float32 *>			mOutputPointers;
+};
+
+#endif // __CAMixingMatrix_h__
@@ -0,0 +1,199 @@
+/*
+     File: CAMixingMatrixBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+// Benchmark and check for CAMixingMatrix.
+//
+// Compares CAMixingMatrix against the straightforward mix that clears each output and
+// then adds every input into it with its gain (one vDSP_vsma per matrix entry, zero or
+// not), over a range of matrix sizes and densities, and checks that the two agree.
+// Also checks that gain ramps move smoothly and land exactly on their targets.
+//
+// The engine has no dependencies beyond CoreAudioTypes.h, so this builds on other
+// platforms too given that header, e.g.:
+//	c++ -O3 -o CAMixingMatrixBenchmark CAMixingMatrixBenchmark.cpp CAMixingMatrix.cpp
+
+#include "CAMixingMatrix.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#if defined(__APPLE__)
+	#include <Accelerate/Accelerate.h>
+#endif
+
+static const UInt32 kFrames = 512;
+
+static double Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+// The mix AUPannerBase::BypassRender used to do.
+static void DenseMix(const Float32 *gains, const Float32 * const *in, Float32 * const *out, UInt32 inputs, UInt32 outputs, UInt32 frames)
+{
+	for (UInt32 o = 0; o < outputs; ++o) {
+		memset(out[o], 0, frames * sizeof(Float32));
+		for (UInt32 i = 0; i < inputs; ++i) {
+			const Float32 *amp = gains + i * outputs + o;
+#if defined(__APPLE__)
+			vDSP_vsma(in[i], 1, amp, out[o], 1, out[o], 1, frames);
+#else
+			for (UInt32 k = 0; k < frames; ++k)
+				out[o][k] += *amp * in[i][k];
+#endif
+		}
+	}
+}
+
+// A gain matrix with the given fraction of non-zero entries. Density 0 means the
+// identity (a straight bypass).
+static void MakeGains(std::vector<Float32> &gains, UInt32 inputs, UInt32 outputs, double density)
+{
+	gains.assign(inputs * outputs, 0.f);
+	for (UInt32 i = 0; i < inputs; ++i)
+		for (UInt32 o = 0; o < outputs; ++o)
+			if (density == 0 ? i == o : rand() < density * RAND_MAX)
+				gains[i * outputs + o] = density == 0 ? 1.f : Float32(rand()) / RAND_MAX;
+}
+
+static bool Benchmark(UInt32 channels, double density)
+{
+	std::vector<Float32> gains, inData(channels * kFrames), outData(channels * kFrames), refData(channels * kFrames);
+	std::vector<const Float32 *> in(channels);
+	std::vector<Float32 *> out(channels), ref(channels);
+	for (UInt32 c = 0; c < channels; ++c) {
+		in[c] = &inData[c * kFrames];
+		out[c] = &outData[c * kFrames];
+		ref[c] = &refData[c * kFrames];
+	}
+	for (size_t k = 0; k < inData.size(); ++k)
+		inData[k] = Float32(rand()) / RAND_MAX - 0.5f;
+	MakeGains(gains, channels, channels, density);
+
+	CAMixingMatrix matrix(channels, channels);
+	matrix.SetGains(&gains[0]);
+
+	// Agreement. Both sum in input order, so only the tiling may differ in rounding.
+	DenseMix(&gains[0], &in[0], &ref[0], channels, channels, kFrames);
+	matrix.Render(&in[0], &out[0], kFrames);
+	Float32 error = 0;
+	for (size_t k = 0; k < outData.size(); ++k)
+		error = std::max(error, fabsf(outData[k] - refData[k]));
+
+	const int iterations = std::max(1, int(4e7 / (channels * channels * kFrames)));
+	double t0 = Now();
+	for (int k = 0; k < iterations; ++k)
+		DenseMix(&gains[0], &in[0], &ref[0], channels, channels, kFrames);
+	double dense = (Now() - t0) / iterations;
+
+	t0 = Now();
+	for (int k = 0; k < iterations * 4; ++k)
+		matrix.Render(&in[0], &out[0], kFrames);
+	double sparse = (Now() - t0) / (iterations * 4);
+
+	char name[32];
+	if (density == 0)
+		snprintf(name, sizeof(name), "identity");
+	else
+		snprintf(name, sizeof(name), "%3.0f%% dense", density * 100);
+	printf("  %3u x %-3u %-12s routes %5u   dense %9.2f us   schedule %9.2f us   %6.1fx   max error %g\n",
+		(unsigned)channels, (unsigned)channels, name, (unsigned)matrix.GetNumberOfRoutes(),
+		dense * 1e6, sparse * 1e6, dense / sparse, error);
+	return error < 1e-5f;
+}
+
+// Ramp a single route from 0 to 1 across several render calls and check every sample.
+static bool CheckRamp()
+{
+	const UInt32 rampFrames = 1000;
+	CAMixingMatrix matrix(1, 1);
+	std::vector<Float32> ones(kFrames, 1.f), outData(kFrames);
+	const Float32 *in = &ones[0];
+	Float32 *out = &outData[0];
+	Float32 one = 1.f, zero = 0.f;
+
+	matrix.SetGains(&one, rampFrames);
+	Float32 error = 0;
+	UInt32 frame = 0;
+	for (int pass = 0; pass < 3; ++pass) {
+		matrix.Render(&in, &out, kFrames);
+		for (UInt32 k = 0; k < kFrames; ++k, ++frame) {
+			Float32 expected = frame < rampFrames ? Float32(frame + 1) / rampFrames : 1.f;
+			error = std::max(error, fabsf(outData[k] - expected));
+		}
+	}
+	bool ok = error < 1e-5f && !matrix.IsRamping() && matrix.GetNumberOfRoutes() == 1;
+
+	// Ramp back down; the route disappears from the schedule when it reaches zero.
+	matrix.SetGains(&zero, rampFrames);
+	for (int pass = 0; pass < 3; ++pass)
+		matrix.Render(&in, &out, kFrames);
+	ok = ok && outData[kFrames - 1] == 0.f && matrix.GetNumberOfRoutes() == 0;
+
+	printf("  ramp check: max error %g, %s\n", error, ok ? "passed" : "FAILED");
+	return ok;
+}
+
+int main()
+{
+	static const UInt32 sizes[] = { 2, 8, 16, 64 };
+	static const double densities[] = { 0, 0.1, 0.5, 1 };
+	bool ok = true;
+
+	printf("CAMixingMatrix, %u-frame buffers:\n", (unsigned)kFrames);
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+		for (size_t d = 0; d < sizeof(densities) / sizeof(densities[0]); ++d)
+			ok = Benchmark(sizes[s], densities[d]) && ok;
+	ok = CheckRamp() && ok;
+
+	printf(ok ? "All checks passed.\n" : "Some checks FAILED.\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,686 @@
+/*
+     File: CAPCMConverter.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+#include "CAPCMConverter.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+#endif
+
+// Samples per block through the work buffer; 1KB of Float32, 2KB of Float64.
+static const UInt32 kWorkSize = 256;
+
+// Bytes of the interleaved side per tile when converting between interleaved and
+// deinterleaved buffers.
+static const UInt32 kTileBytes = 16384;
+
+#if defined(__BIG_ENDIAN__) || (defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__))
+	static const bool kHostIsBigEndian = true;
+#else
+	static const bool kHostIsBigEndian = false;
+#endif
+
+typedef CAPCMConverter::KernelState KernelState;
+
+struct CAPCMConverter::BufferSet {
+	const void * const *		mPointers;
+	const AudioBufferList *		mList;
+
+	Byte *			Get(UInt32 inIndex) const
+						{ return static_cast<Byte *>(mList != NULL ? mList->mBuffers[inIndex].mData : const_cast<void *>(mPointers[inIndex])); }
+};
+
+namespace {
+
+inline UInt16	Swap16(UInt16 x) { return static_cast<UInt16>((x << 8) | (x >> 8)); }
+inline UInt32	Swap32(UInt32 x) { return (x >> 24) | ((x >> 8) & 0xFF00) | ((x << 8) & 0xFF0000) | (x << 24); }
+inline UInt64	Swap64(UInt64 x) { return (static_cast<UInt64>(Swap32(static_cast<UInt32>(x))) << 32) | Swap32(static_cast<UInt32>(x >> 32)); }
+
+// Rounds to nearest even, as the vector conversions do. lrint is usually a library call,
+// since it may set errno, so use the scalar conversion instructions where there are some.
+#if defined(__SSE2__)
+	inline SInt32	Round(Float32 x) { return _mm_cvtss_si32(_mm_set_ss(x)); }
+	inline SInt32	Round(Float64 x) { return _mm_cvtsd_si32(_mm_set_sd(x)); }
+#elif defined(__aarch64__)
+	inline SInt32	Round(Float32 x) { return vcvtns_s32_f32(x); }
+	inline SInt32	Round(Float64 x) { return static_cast<SInt32>(vcvtnd_s64_f64(x)); }
+#else
+	inline SInt32	Round(Float32 x) { return static_cast<SInt32>(lrintf(x)); }
+	inline SInt32	Round(Float64 x) { return static_cast<SInt32>(lrint(x)); }
+#endif
+
+// ____________________________________________________________________________
+// Sample formats
+//
+// Get reads one sample as an integer or float value, unscaled; Put writes one. They work on
+// unaligned bytes, since packed 24-bit samples and interleaved odd channel counts are common.
+
+struct Int8Sample {
+	enum { kType = CAPCMConverter::kSample_Int8, kBytes = 1, kIsInteger = 1, kIsInt32 = 0, kIsFloat64 = 0 };
+	static SInt32	Get(const Byte *p) { return static_cast<SInt8>(*p); }
+	static void		Put(Byte *p, SInt32 x) { *p = static_cast<Byte>(x); }
+};
+
+struct UInt8Sample {
+	enum { kType = CAPCMConverter::kSample_UInt8, kBytes = 1, kIsInteger = 1, kIsInt32 = 0, kIsFloat64 = 0 };
+	static SInt32	Get(const Byte *p) { return static_cast<SInt32>(*p) - 128; }
+	static void		Put(Byte *p, SInt32 x) { *p = static_cast<Byte>(x + 128); }
+};
+
+template <bool kSwap>
+struct Int16Sample {
+	enum { kType = CAPCMConverter::kSample_Int16, kBytes = 2, kIsInteger = 1, kIsInt32 = 0, kIsFloat64 = 0 };
+	static SInt32	Get(const Byte *p) { UInt16 x; memcpy(&x, p, 2); return static_cast<SInt16>(kSwap ? Swap16(x) : x); }
+	static void		Put(Byte *p, SInt32 x) { UInt16 y = static_cast<UInt16>(x); y = kSwap ? Swap16(y) : y; memcpy(p, &y, 2); }
+};
+
+template <bool kSwap>
+struct Int24Sample {
+	enum { kType = CAPCMConverter::kSample_Int24, kBytes = 3, kIsInteger = 1, kIsInt32 = 0, kIsFloat64 = 0 };
+	static SInt32	Get(const Byte *p) {
+						if (kHostIsBigEndian != kSwap)
+							return static_cast<SInt32>((UInt32(p[0]) << 24) | (UInt32(p[1]) << 16) | (UInt32(p[2]) << 8)) >> 8;
+						return static_cast<SInt32>((UInt32(p[2]) << 24) | (UInt32(p[1]) << 16) | (UInt32(p[0]) << 8)) >> 8;
+					}
+	static void		Put(Byte *p, SInt32 x) {
+						if (kHostIsBigEndian != kSwap) {
+							p[0] = static_cast<Byte>(x >> 16); p[1] = static_cast<Byte>(x >> 8); p[2] = static_cast<Byte>(x);
+						} else {
+							p[0] = static_cast<Byte>(x); p[1] = static_cast<Byte>(x >> 8); p[2] = static_cast<Byte>(x >> 16);
+						}
+					}
+};
+
+template <bool kSwap>
+struct Int32Sample {
+	enum { kType = CAPCMConverter::kSample_Int32, kBytes = 4, kIsInteger = 1, kIsInt32 = 1, kIsFloat64 = 0 };
+	static SInt32	Get(const Byte *p) { UInt32 x; memcpy(&x, p, 4); return static_cast<SInt32>(kSwap ? Swap32(x) : x); }
+	static void		Put(Byte *p, SInt32 x) { UInt32 y = static_cast<UInt32>(x); y = kSwap ? Swap32(y) : y; memcpy(p, &y, 4); }
+};
+
+template <bool kSwap>
+struct Float32Sample {
+	enum { kType = CAPCMConverter::kSample_Float32, kBytes = 4, kIsInteger = 0, kIsInt32 = 0, kIsFloat64 = 0 };
+	static Float32	Get(const Byte *p) { UInt32 x; memcpy(&x, p, 4); x = kSwap ? Swap32(x) : x; Float32 f; memcpy(&f, &x, 4); return f; }
+	static void		Put(Byte *p, Float32 f) { UInt32 x; memcpy(&x, &f, 4); x = kSwap ? Swap32(x) : x; memcpy(p, &x, 4); }
+};
+
+template <bool kSwap>
+struct Float64Sample {
+	enum { kType = CAPCMConverter::kSample_Float64, kBytes = 8, kIsInteger = 0, kIsInt32 = 0, kIsFloat64 = 1 };
+	static Float64	Get(const Byte *p) { UInt64 x; memcpy(&x, p, 8); x = kSwap ? Swap64(x) : x; Float64 f; memcpy(&f, &x, 8); return f; }
+	static void		Put(Byte *p, Float64 f) { UInt64 x; memcpy(&x, &f, 8); x = kSwap ? Swap64(x) : x; memcpy(p, &x, 8); }
+};
+
+// The work buffer is Float64 when Float32 would lose resolution.
+template <bool kCondition, class T, class F> struct Select { typedef T Type; };
+template <class T, class F> struct Select<false, T, F> { typedef F Type; };
+
+template <class A, class B> struct IsSame { enum { kValue = 0 }; };
+template <class A> struct IsSame<A, A> { enum { kValue = 1 }; };
+
+template <class S, class D>
+struct WorkType {
+	typedef typename Select<S::kIsFloat64 || D::kIsFloat64 || (S::kIsInt32 && D::kIsInt32), Float64, Float32>::Type Type;
+};
+
+inline Float32	Maximum(const KernelState &s, Float32) { return s.mDestinationMaximum32; }
+inline Float64	Maximum(const KernelState &s, Float64) { return s.mDestinationMaximum; }
+
+// ____________________________________________________________________________
+// SIMD loads and stores for the native endian integer formats, contiguous samples, Float32 work
+
+#if defined(__SSE2__)
+	void	LoadInt16(const SInt16 *p, UInt32 n, Float32 scale, Float32 *out)
+	{
+		const __m128 s = _mm_set1_ps(scale);
+		UInt32 i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), s));
+			_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), s));
+		}
+		for (; i < n; ++i)
+			out[i] = Float32(p[i]) * scale;
+	}
+
+	inline __m128i	ScaleClipRound(const Float32 *in, __m128 s, __m128 lo, __m128 hi)
+	{
+		// max first, so NaN becomes the minimum, as in the scalar code
+		return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in), s), lo), hi));
+	}
+
+	void	StoreInt16(const Float32 *in, UInt32 n, Float32 scale, Float32 minimum, Float32 maximum, SInt16 *p)
+	{
+		const __m128 s = _mm_set1_ps(scale), lo = _mm_set1_ps(minimum), hi = _mm_set1_ps(maximum);
+		UInt32 i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m128i a = ScaleClipRound(in + i, s, lo, hi);
+			__m128i b = ScaleClipRound(in + i + 4, s, lo, hi);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), _mm_packs_epi32(a, b));
+		}
+		for (; i < n; ++i) {
+			Float32 x = in[i] * scale;
+			x = (x > minimum) ? x : minimum;
+			x = (x < maximum) ? x : maximum;
+			p[i] = static_cast<SInt16>(Round(x));
+		}
+	}
+
+	void	LoadInt32(const SInt32 *p, UInt32 n, Float32 scale, Float32 *out)
+	{
+		const __m128 s = _mm_set1_ps(scale);
+		UInt32 i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i))), s));
+		for (; i < n; ++i)
+			out[i] = Float32(p[i]) * scale;
+	}
+
+	void	StoreInt32(const Float32 *in, UInt32 n, Float32 scale, Float32 minimum, Float32 maximum, SInt32 *p)
+	{
+		const __m128 s = _mm_set1_ps(scale), lo = _mm_set1_ps(minimum), hi = _mm_set1_ps(maximum);
+		UInt32 i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), ScaleClipRound(in + i, s, lo, hi));
+		for (; i < n; ++i) {
+			Float32 x = in[i] * scale;
+			x = (x > minimum) ? x : minimum;
+			x = (x < maximum) ? x : maximum;
+			p[i] = Round(x);
+		}
+	}
+	#define CA_PCM_SIMD 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	inline int32x4_t	ScaleClipRound(const Float32 *in, float32x4_t s, float32x4_t lo, float32x4_t hi)
+	{
+		float32x4_t x = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(in), s), lo), hi);
+	#if defined(__aarch64__)
+		return vcvtnq_s32_f32(x);
+	#else
+		// ARMv7 NEON only truncates, so this rounds halves away from zero
+		return vcvtq_s32_f32(vaddq_f32(x, vbslq_f32(vcltq_f32(x, vdupq_n_f32(0.f)), vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f))));
+	#endif
+	}
+
+	void	LoadInt16(const SInt16 *p, UInt32 n, Float32 scale, Float32 *out)
+	{
+		const float32x4_t s = vdupq_n_f32(scale);
+		UInt32 i = 0;
+		for (; i + 8 <= n; i += 8) {
+			int16x8_t v = vld1q_s16(p + i);
+			vst1q_f32(out + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), s));
+			vst1q_f32(out + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), s));
+		}
+		for (; i < n; ++i)
+			out[i] = Float32(p[i]) * scale;
+	}
+
+	void	StoreInt16(const Float32 *in, UInt32 n, Float32 scale, Float32 minimum, Float32 maximum, SInt16 *p)
+	{
+		const float32x4_t s = vdupq_n_f32(scale), lo = vdupq_n_f32(minimum), hi = vdupq_n_f32(maximum);
+		UInt32 i = 0;
+		for (; i + 8 <= n; i += 8) {
+			int32x4_t a = ScaleClipRound(in + i, s, lo, hi);
+			int32x4_t b = ScaleClipRound(in + i + 4, s, lo, hi);
+			vst1q_s16(p + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+		}
+		for (; i < n; ++i) {
+			Float32 x = in[i] * scale;
+			x = (x > minimum) ? x : minimum;
+			x = (x < maximum) ? x : maximum;
+			p[i] = static_cast<SInt16>(Round(x));
+		}
+	}
+
+	void	LoadInt32(const SInt32 *p, UInt32 n, Float32 scale, Float32 *out)
+	{
+		const float32x4_t s = vdupq_n_f32(scale);
+		UInt32 i = 0;
+		for (; i + 4 <= n; i += 4)
+			vst1q_f32(out + i, vmulq_f32(vcvtq_f32_s32(vld1q_s32(p + i)), s));
+		for (; i < n; ++i)
+			out[i] = Float32(p[i]) * scale;
+	}
+
+	void	StoreInt32(const Float32 *in, UInt32 n, Float32 scale, Float32 minimum, Float32 maximum, SInt32 *p)
+	{
+		const float32x4_t s = vdupq_n_f32(scale), lo = vdupq_n_f32(minimum), hi = vdupq_n_f32(maximum);
+		UInt32 i = 0;
+		for (; i + 4 <= n; i += 4)
+			vst1q_s32(p + i, ScaleClipRound(in + i, s, lo, hi));
+		for (; i < n; ++i) {
+			Float32 x = in[i] * scale;
+			x = (x > minimum) ? x : minimum;
+			x = (x < maximum) ? x : maximum;
+			p[i] = Round(x);
+		}
+	}
+	#define CA_PCM_SIMD 1
+#endif
+
+// ____________________________________________________________________________
+// Loading into and storing from the work buffer
+
+template <class S, class W>
+struct Loader {
+	static void		Load(const Byte *p, UInt32 stride, UInt32 n, W scale, W *out)
+	{
+		const UInt32 step = stride * S::kBytes;
+		if (S::kIsInteger) {
+			for (UInt32 i = 0; i < n; ++i, p += step)
+				out[i] = W(S::Get(p)) * scale;
+		} else {
+			for (UInt32 i = 0; i < n; ++i, p += step)
+				out[i] = W(S::Get(p));
+		}
+	}
+};
+
+template <class D, class W, bool kIsInteger = (D::kIsInteger != 0)>
+struct Storer {
+	static void		Store(const W *in, UInt32 n, const KernelState &s, Byte *p, UInt32 stride)
+	{
+		const UInt32 step = stride * D::kBytes;
+		const W scale = W(s.mDestinationScale), minimum = W(s.mDestinationMinimum), maximum = Maximum(s, W());
+		for (UInt32 i = 0; i < n; ++i, p += step) {
+			W x = in[i] * scale;
+			x = (x > minimum) ? x : minimum;
+			x = (x < maximum) ? x : maximum;
+			D::Put(p, Round(x));
+		}
+	}
+};
+
+template <class D, class W>
+struct Storer<D, W, false> {
+	static void		Store(const W *in, UInt32 n, const KernelState &, Byte *p, UInt32 stride)
+	{
+		const UInt32 step = stride * D::kBytes;
+		for (UInt32 i = 0; i < n; ++i, p += step)
+			D::Put(p, in[i]);
+	}
+};
+
+#if CA_PCM_SIMD
+	template <>
+	struct Loader<Int16Sample<false>, Float32> {
+		static void		Load(const Byte *p, UInt32 stride, UInt32 n, Float32 scale, Float32 *out)
+		{
+			if (stride == 1 && (reinterpret_cast<uintptr_t>(p) & 1) == 0)
+				LoadInt16(reinterpret_cast<const SInt16 *>(p), n, scale, out);
+			else
+				for (UInt32 i = 0; i < n; ++i, p += 2 * stride)
+					out[i] = Float32(Int16Sample<false>::Get(p)) * scale;
+		}
+	};
+
+	template <>
+	struct Loader<Int32Sample<false>, Float32> {
+		static void		Load(const Byte *p, UInt32 stride, UInt32 n, Float32 scale, Float32 *out)
+		{
+			if (stride == 1 && (reinterpret_cast<uintptr_t>(p) & 3) == 0)
+				LoadInt32(reinterpret_cast<const SInt32 *>(p), n, scale, out);
+			else
+				for (UInt32 i = 0; i < n; ++i, p += 4 * stride)
+					out[i] = Float32(Int32Sample<false>::Get(p)) * scale;
+		}
+	};
+
+	template <>
+	struct Storer<Int16Sample<false>, Float32, true> {
+		static void		Store(const Float32 *in, UInt32 n, const KernelState &s, Byte *p, UInt32 stride)
+		{
+			if (stride == 1 && (reinterpret_cast<uintptr_t>(p) & 1) == 0) {
+				StoreInt16(in, n, Float32(s.mDestinationScale), Float32(s.mDestinationMinimum), s.mDestinationMaximum32, reinterpret_cast<SInt16 *>(p));
+				return;
+			}
+			const Float32 scale = Float32(s.mDestinationScale), minimum = Float32(s.mDestinationMinimum), maximum = s.mDestinationMaximum32;
+			for (UInt32 i = 0; i < n; ++i, p += 2 * stride) {
+				Float32 x = in[i] * scale;
+				x = (x > minimum) ? x : minimum;
+				x = (x < maximum) ? x : maximum;
+				Int16Sample<false>::Put(p, Round(x));
+			}
+		}
+	};
+
+	template <>
+	struct Storer<Int32Sample<false>, Float32, true> {
+		static void		Store(const Float32 *in, UInt32 n, const KernelState &s, Byte *p, UInt32 stride)
+		{
+			if (stride == 1 && (reinterpret_cast<uintptr_t>(p) & 3) == 0) {
+				StoreInt32(in, n, Float32(s.mDestinationScale), Float32(s.mDestinationMinimum), s.mDestinationMaximum32, reinterpret_cast<SInt32 *>(p));
+				return;
+			}
+			const Float32 scale = Float32(s.mDestinationScale), minimum = Float32(s.mDestinationMinimum), maximum = s.mDestinationMaximum32;
+			for (UInt32 i = 0; i < n; ++i, p += 4 * stride) {
+				Float32 x = in[i] * scale;
+				x = (x > minimum) ? x : minimum;
+				x = (x < maximum) ? x : maximum;
+				Int32Sample<false>::Put(p, Round(x));
+			}
+		}
+	};
+#endif
+
+// Triangular dither: the difference of two uniform random values, each up to one LSB. Both
+// come from one step of a 64-bit LCG, from its upper bits, to keep the dependency chain short.
+template <class W>
+void	AddDither(W *io, UInt32 n, KernelState &s)
+{
+	const W amplitude = W(s.mDitherAmplitude / 16777216.0);
+	UInt64 seed = s.mDitherSeed;
+	for (UInt32 i = 0; i < n; ++i) {
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		SInt32 a = static_cast<SInt32>(seed >> 40);
+		SInt32 b = static_cast<SInt32>((seed >> 16) & 0xFFFFFF);
+		io[i] += W(a - b) * amplitude;
+	}
+	s.mDitherSeed = seed;
+}
+
+// ____________________________________________________________________________
+// Kernels
+
+template <class S, class D>
+void	ConvertKernel(const void *inSource, UInt32 inSourceStride, void *outDestination, UInt32 inDestinationStride, UInt32 inNumberSamples, KernelState &ioState)
+{
+	typedef typename WorkType<S, D>::Type W;
+	W work[kWorkSize];
+	const Byte *src = static_cast<const Byte *>(inSource);
+	Byte *dst = static_cast<Byte *>(outDestination);
+	const W sourceScale = W(ioState.mSourceScale);
+	while (inNumberSamples > 0) {
+		UInt32 n = std::min(inNumberSamples, kWorkSize);
+		Loader<S, W>::Load(src, inSourceStride, n, sourceScale, work);
+		if (D::kIsInteger && ioState.mDither)
+			AddDither(work, n, ioState);
+		Storer<D, W>::Store(work, n, ioState, dst, inDestinationStride);
+		src += n * inSourceStride * S::kBytes;
+		dst += n * inDestinationStride * D::kBytes;
+		inNumberSamples -= n;
+	}
+}
+
+// Same sample format and scale: the values are copied exactly, swapping bytes if need be.
+template <class S, class D>
+void	CopyKernel(const void *inSource, UInt32 inSourceStride, void *outDestination, UInt32 inDestinationStride, UInt32 inNumberSamples, KernelState &)
+{
+	const Byte *src = static_cast<const Byte *>(inSource);
+	Byte *dst = static_cast<Byte *>(outDestination);
+	if (inSourceStride == 1 && inDestinationStride == 1 && IsSame<S, D>::kValue) {
+		memcpy(dst, src, inNumberSamples * S::kBytes);
+		return;
+	}
+	for (UInt32 i = 0; i < inNumberSamples; ++i, src += inSourceStride * S::kBytes, dst += inDestinationStride * D::kBytes)
+		D::Put(dst, S::Get(src));
+}
+
+template <class S, class D, bool kSameType = (static_cast<int>(S::kType) == static_cast<int>(D::kType))>
+struct KernelChooser {
+	static CAPCMConverter::KernelProc	Get(bool) { return &ConvertKernel<S, D>; }
+};
+
+template <class S, class D>
+struct KernelChooser<S, D, true> {
+	static CAPCMConverter::KernelProc	Get(bool inSameScale) { return inSameScale ? &CopyKernel<S, D> : &ConvertKernel<S, D>; }
+};
+
+template <class S>
+CAPCMConverter::KernelProc	SelectDestination(const CAPCMConverter::SampleFormat &inDestination, bool inSameScale)
+{
+	const bool swapped = inDestination.mIsSwapped;
+	switch (inDestination.mType) {
+	case CAPCMConverter::kSample_Int8:		return KernelChooser<S, Int8Sample>::Get(inSameScale);
+	case CAPCMConverter::kSample_UInt8:		return KernelChooser<S, UInt8Sample>::Get(inSameScale);
+	case CAPCMConverter::kSample_Int16:		return swapped ? KernelChooser<S, Int16Sample<true> >::Get(inSameScale) : KernelChooser<S, Int16Sample<false> >::Get(inSameScale);
+	case CAPCMConverter::kSample_Int24:		return swapped ? KernelChooser<S, Int24Sample<true> >::Get(inSameScale) : KernelChooser<S, Int24Sample<false> >::Get(inSameScale);
+	case CAPCMConverter::kSample_Int32:		return swapped ? KernelChooser<S, Int32Sample<true> >::Get(inSameScale) : KernelChooser<S, Int32Sample<false> >::Get(inSameScale);
+	case CAPCMConverter::kSample_Float32:	return swapped ? KernelChooser<S, Float32Sample<true> >::Get(inSameScale) : KernelChooser<S, Float32Sample<false> >::Get(inSameScale);
+	case CAPCMConverter::kSample_Float64:	return swapped ? KernelChooser<S, Float64Sample<true> >::Get(inSameScale) : KernelChooser<S, Float64Sample<false> >::Get(inSameScale);
+	}
+	return NULL;
+}
+
+CAPCMConverter::KernelProc	SelectKernel(const CAPCMConverter::SampleFormat &inSource, const CAPCMConverter::SampleFormat &inDestination)
+{
+	const bool sameScale = inSource.mFractionBits == inDestination.mFractionBits;
+	const bool swapped = inSource.mIsSwapped;
+	switch (inSource.mType) {
+	case CAPCMConverter::kSample_Int8:		return SelectDestination<Int8Sample>(inDestination, sameScale);
+	case CAPCMConverter::kSample_UInt8:		return SelectDestination<UInt8Sample>(inDestination, sameScale);
+	case CAPCMConverter::kSample_Int16:		return swapped ? SelectDestination<Int16Sample<true> >(inDestination, sameScale) : SelectDestination<Int16Sample<false> >(inDestination, sameScale);
+	case CAPCMConverter::kSample_Int24:		return swapped ? SelectDestination<Int24Sample<true> >(inDestination, sameScale) : SelectDestination<Int24Sample<false> >(inDestination, sameScale);
+	case CAPCMConverter::kSample_Int32:		return swapped ? SelectDestination<Int32Sample<true> >(inDestination, sameScale) : SelectDestination<Int32Sample<false> >(inDestination, sameScale);
+	case CAPCMConverter::kSample_Float32:	return swapped ? SelectDestination<Float32Sample<true> >(inDestination, sameScale) : SelectDestination<Float32Sample<false> >(inDestination, sameScale);
+	case CAPCMConverter::kSample_Float64:	return swapped ? SelectDestination<Float64Sample<true> >(inDestination, sameScale) : SelectDestination<Float64Sample<false> >(inDestination, sameScale);
+	}
+	return NULL;
+}
+
+bool	IsInteger(const CAPCMConverter::SampleFormat &inFormat)
+{
+	return inFormat.mType != CAPCMConverter::kSample_Float32 && inFormat.mType != CAPCMConverter::kSample_Float64;
+}
+
+} // namespace
+
+// ____________________________________________________________________________
+
+bool	CAPCMConverter::IdentifyFormat(const AudioStreamBasicDescription &inFormat, SampleFormat &outFormat)
+{
+	memset(&outFormat, 0, sizeof(outFormat));
+	if (inFormat.mFormatID != kAudioFormatLinearPCM || inFormat.mFramesPerPacket != 1
+	|| inFormat.mBytesPerFrame == 0 || inFormat.mBytesPerFrame != inFormat.mBytesPerPacket || inFormat.mChannelsPerFrame == 0)
+		return false;
+
+	const UInt32 flags = inFormat.mFormatFlags;
+	const bool interleaved = (flags & kAudioFormatFlagIsNonInterleaved) == 0;
+	UInt32 bytes = inFormat.mBytesPerFrame;
+	if (interleaved) {
+		if (bytes % inFormat.mChannelsPerFrame != 0)
+			return false;
+		bytes /= inFormat.mChannelsPerFrame;
+	}
+	// packed samples only; high or low aligned ones in wider containers aren't handled
+	if (inFormat.mBitsPerChannel != 8 * bytes)
+		return false;
+
+	const UInt32 fractionBits = (flags & kLinearPCMFormatFlagsSampleFractionMask) >> kLinearPCMFormatFlagsSampleFractionShift;
+	UInt32 type = kSample_Unsupported;
+	if (flags & kAudioFormatFlagIsFloat) {
+		if (fractionBits != 0 || (flags & kAudioFormatFlagIsSignedInteger))
+			return false;
+		if (bytes == 4) type = kSample_Float32;
+		else if (bytes == 8) type = kSample_Float64;
+	} else if (flags & kAudioFormatFlagIsSignedInteger) {
+		if (bytes == 1) type = kSample_Int8;
+		else if (bytes == 2) type = kSample_Int16;
+		else if (bytes == 3) type = kSample_Int24;
+		else if (bytes == 4) type = kSample_Int32;
+	} else if (bytes == 1)
+		type = kSample_UInt8;		// the only unsigned format in common use
+	if (type == kSample_Unsupported)
+		return false;
+
+	outFormat.mType = type;
+	outFormat.mBytesPerSample = bytes;
+	outFormat.mNumberChannels = inFormat.mChannelsPerFrame;
+	outFormat.mIsInterleaved = interleaved;
+	outFormat.mIsSwapped = bytes > 1 && (flags & kAudioFormatFlagIsBigEndian) != (kAudioFormatFlagsNativeEndian & kAudioFormatFlagIsBigEndian);
+	if (type != kSample_Float32 && type != kSample_Float64) {
+		// plain integers are full scale, as AudioConverter treats them
+		if (fractionBits >= 8 * bytes)
+			return false;
+		outFormat.mFractionBits = (fractionBits != 0) ? fractionBits : 8 * bytes - 1;
+	}
+	return true;
+}
+
+CAPCMConverter::CAPCMConverter() :
+	mKernel(NULL),
+	mDither(false)
+{
+	memset(&mSource, 0, sizeof(mSource));
+	memset(&mDestination, 0, sizeof(mDestination));
+	memset(&mState, 0, sizeof(mState));
+}
+
+bool	CAPCMConverter::Initialize(const AudioStreamBasicDescription &inSource, const AudioStreamBasicDescription &inDestination, bool inDither)
+{
+	mKernel = NULL;
+	mDither = false;
+	if (!IdentifyFormat(inSource, mSource) || !IdentifyFormat(inDestination, mDestination)
+	|| mSource.mNumberChannels != mDestination.mNumberChannels)
+		return false;
+
+	mState.mSourceScale = IsInteger(mSource) ? ldexp(1., -static_cast<int>(mSource.mFractionBits)) : 1.;
+	if (IsInteger(mDestination)) {
+		const int bits = 8 * mDestination.mBytesPerSample;
+		mState.mDestinationScale = ldexp(1., mDestination.mFractionBits);
+		mState.mDestinationMinimum = -ldexp(1., bits - 1);
+		mState.mDestinationMaximum = ldexp(1., bits - 1) - 1.;
+		mState.mDitherAmplitude = 1. / mState.mDestinationScale;
+	} else {
+		mState.mDestinationScale = 1.;
+		mState.mDestinationMinimum = mState.mDestinationMaximum = 0.;
+		mState.mDitherAmplitude = 0.;
+	}
+	// 2^31 - 1 rounds up to 2^31 as a Float32, which would overflow the conversion
+	Float32 maximum32 = static_cast<Float32>(mState.mDestinationMaximum);
+	if (maximum32 > mState.mDestinationMaximum)
+		maximum32 = nextafterf(maximum32, 0.f);
+	mState.mDestinationMaximum32 = maximum32;
+	mState.mDitherSeed = 0x2545F491;
+
+	mKernel = SelectKernel(mSource, mDestination);
+	SetDither(inDither);
+	return mKernel != NULL;
+}
+
+bool	CAPCMConverter::DitherIsUseful() const
+{
+	if (!IsInteger(mDestination))
+		return false;
+	return !IsInteger(mSource) || mSource.mFractionBits > mDestination.mFractionBits;
+}
+
+void	CAPCMConverter::ConvertBuffers(const BufferSet &inSource, const BufferSet &inDestination, UInt32 inNumberFrames)
+{
+	const UInt32 channels = mSource.mNumberChannels;
+	const UInt32 srcBytes = mSource.mBytesPerSample, dstBytes = mDestination.mBytesPerSample;
+	mState.mDither = mDither;
+
+	if (mSource.mIsInterleaved == mDestination.mIsInterleaved) {
+		if (mSource.mIsInterleaved)
+			(*mKernel)(inSource.Get(0), 1, inDestination.Get(0), 1, inNumberFrames * channels, mState);
+		else
+			for (UInt32 ch = 0; ch < channels; ++ch)
+				(*mKernel)(inSource.Get(ch), 1, inDestination.Get(ch), 1, inNumberFrames, mState);
+		return;
+	}
+
+	// One side is interleaved: walk it a tile at a time, and each channel of the tile with a stride.
+	const UInt32 interleavedBytes = mSource.mIsInterleaved ? srcBytes : dstBytes;
+	const UInt32 tileFrames = std::max<UInt32>(kTileBytes / (channels * interleavedBytes), 16);
+	for (UInt32 frame = 0; frame < inNumberFrames; frame += tileFrames) {
+		const UInt32 frames = std::min(tileFrames, inNumberFrames - frame);
+		for (UInt32 ch = 0; ch < channels; ++ch) {
+			if (mSource.mIsInterleaved)
+				(*mKernel)(inSource.Get(0) + (frame * channels + ch) * srcBytes, channels,
+							inDestination.Get(ch) + frame * dstBytes, 1, frames, mState);
+			else
+				(*mKernel)(inSource.Get(ch) + frame * srcBytes, 1,
+							inDestination.Get(0) + (frame * channels + ch) * dstBytes, channels, frames, mState);
+		}
+	}
+}
+
+void	CAPCMConverter::Convert(const void * const *inSource, void * const *outDestination, UInt32 inNumberFrames)
+{
+	if (mKernel == NULL || inNumberFrames == 0)
+		return;
+	BufferSet src = { inSource, NULL };
+	BufferSet dst = { outDestination, NULL };
+	ConvertBuffers(src, dst, inNumberFrames);
+}
+
+bool	CAPCMConverter::Convert(const AudioBufferList &inSource, AudioBufferList &outDestination, UInt32 inNumberFrames)
+{
+	if (mKernel == NULL)
+		return false;
+	const UInt32 srcBuffers = mSource.mIsInterleaved ? 1 : mSource.mNumberChannels;
+	const UInt32 dstBuffers = mDestination.mIsInterleaved ? 1 : mDestination.mNumberChannels;
+	if (inSource.mNumberBuffers < srcBuffers || outDestination.mNumberBuffers < dstBuffers)
+		return false;
+
+	const UInt32 srcBytes = inNumberFrames * mSource.mBytesPerSample * (mSource.mIsInterleaved ? mSource.mNumberChannels : 1);
+	const UInt32 dstBytes = inNumberFrames * mDestination.mBytesPerSample * (mDestination.mIsInterleaved ? mDestination.mNumberChannels : 1);
+	for (UInt32 i = 0; i < srcBuffers; ++i)
+		if (inSource.mBuffers[i].mDataByteSize < srcBytes)
+			return false;
+	for (UInt32 i = 0; i < dstBuffers; ++i)
+		if (outDestination.mBuffers[i].mDataByteSize < dstBytes)
+			return false;
+
+	if (inNumberFrames > 0) {
+		BufferSet src = { NULL, &inSource };
+		BufferSet dst = { NULL, &outDestination };
+		ConvertBuffers(src, dst, inNumberFrames);
+	}
+	for (UInt32 i = 0; i < dstBuffers; ++i)
+		outDestination.mBuffers[i].mDataByteSize = dstBytes;
+	return true;
+}
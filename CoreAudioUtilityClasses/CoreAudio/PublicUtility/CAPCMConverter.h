@@ -0,0 +1,149 @@
+/*
+     File: CAPCMConverter.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+#ifndef __CAPCMConverter_h__
+#define __CAPCMConverter_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+// CAPCMConverter converts linear PCM between any two of these sample formats, described
+// directly by a pair of AudioStreamBasicDescriptions:
+//	8-bit signed or unsigned (as in WAVE files), 16-bit, packed 24-bit and 32-bit integers,
+//	including fixed point with fraction bits such as 8.24, and 32- and 64-bit floats,
+//	in either byte order, interleaved or not.
+// Both formats must have the same number of channels; sample rate conversion and channel
+// mapping are left to AudioConverter.
+//
+// Every format pair has its own kernel, instantiated from templates and picked once by
+// Initialize. A kernel loads and scales a block of samples into a small Float32 work buffer
+// (Float64 if either format is Float64, or both are 32-bit integers), dithers it if asked to,
+// then scales, rounds to nearest, clips and stores it. Native endian 16- and 32-bit integer
+// loads and stores use SSE2 or NEON. Pairs with the same sample format are copied, byte
+// swapped if need be, without going through the work buffer.
+//
+// Converting between interleaved and deinterleaved buffers goes through tiles of frames
+// small enough for the interleaved side to stay in the first level cache, so each channel
+// doesn't make its own pass over the whole interleaved buffer.
+//
+// The dither is triangular (TPDF), up to one LSB of the destination either side, and is only
+// applied when converting to an integer format with less resolution than the source.
+//
+// Initialize doesn't allocate and Convert doesn't block, so both can run on the render thread.
+class CAPCMConverter {
+public:
+	enum {
+		kSample_Unsupported,
+		kSample_Int8,
+		kSample_UInt8,
+		kSample_Int16,
+		kSample_Int24,			// packed in 3 bytes
+		kSample_Int32,
+		kSample_Float32,
+		kSample_Float64,
+		kNumberSampleTypes
+	};
+
+	struct SampleFormat {
+		UInt32		mType;
+		UInt32		mBytesPerSample;
+		UInt32		mFractionBits;		// integers: a sample is value / 2^mFractionBits
+		UInt32		mNumberChannels;
+		bool		mIsSwapped;			// not native endian
+		bool		mIsInterleaved;
+	};
+
+	static bool		IdentifyFormat(const AudioStreamBasicDescription &inFormat, SampleFormat &outFormat);
+						// false for formats this class can't convert
+
+	CAPCMConverter();
+
+	bool			Initialize(const AudioStreamBasicDescription &inSource, const AudioStreamBasicDescription &inDestination, bool inDither = false);
+	bool			IsInitialized() const { return mKernel != NULL; }
+	const SampleFormat &	GetSourceFormat() const { return mSource; }
+	const SampleFormat &	GetDestinationFormat() const { return mDestination; }
+
+	void			SetDither(bool inDither) { mDither = inDither && DitherIsUseful(); }
+	bool			GetDither() const { return mDither; }
+
+	void			Convert(const void * const *inSource, void * const *outDestination, UInt32 inNumberFrames);
+						// one pointer per buffer: one if interleaved, else one per channel
+	bool			Convert(const AudioBufferList &inSource, AudioBufferList &outDestination, UInt32 inNumberFrames);
+						// sets the destination buffers' mDataByteSize; false if either list
+						// has too few buffers or buffers too small for its format
+
+	// the state the kernels work with
+	struct KernelState {
+		Float64		mSourceScale;
+		Float64		mDestinationScale;
+		Float64		mDestinationMinimum;
+		Float64		mDestinationMaximum;
+		Float32		mDestinationMaximum32;	// the largest Float32 that doesn't exceed it
+		Float64		mDitherAmplitude;	// the destination's LSB, in the work buffer's units
+		bool		mDither;
+		UInt64		mDitherSeed;
+	};
+
+	typedef void	(*KernelProc)(const void *inSource, UInt32 inSourceStride, void *outDestination, UInt32 inDestinationStride, UInt32 inNumberSamples, KernelState &ioState);
+						// strides in samples
+
+private:
+	struct BufferSet;
+
+	bool			DitherIsUseful() const;
+	void			ConvertBuffers(const BufferSet &inSource, const BufferSet &inDestination, UInt32 inNumberFrames);
+
+	SampleFormat	mSource;
+	SampleFormat	mDestination;
+	KernelProc		mKernel;
+	KernelState		mState;
+	bool			mDither;
+};
+
+#endif // __CAPCMConverter_h__
@@ -0,0 +1,362 @@
+/*
+     File: CAPCMConverterBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+// Benchmark and check for CAPCMConverter.
+//
+// Checks every pair of sample formats, in both byte orders and in every combination of
+// interleaved and deinterleaved buffers, against a straightforward Float64 reference that
+// decodes and encodes one sample at a time, then prints a table of throughput for each
+// pair of native endian interleaved formats and for some byte swapping, layout changing
+// and dithering cases at high channel counts.
+//
+// The converter has no dependencies beyond CoreAudioTypes.h, so this builds on other
+// platforms too given that header, e.g.:
+//	c++ -O3 -o CAPCMConverterBenchmark CAPCMConverterBenchmark.cpp CAPCMConverter.cpp
+
+#include "CAPCMConverter.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__BIG_ENDIAN__) || (defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__))
+	static const bool kHostIsBigEndian = true;
+#else
+	static const bool kHostIsBigEndian = false;
+#endif
+
+static const char *kTypeNames[] = { "", "Int8", "UInt8", "Int16", "Int24", "Int32", "Float32", "Float64" };
+
+static double Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static AudioStreamBasicDescription MakeFormat(UInt32 type, bool swapped, bool interleaved, UInt32 channels, UInt32 fractionBits = 0)
+{
+	static const UInt32 kBytes[] = { 0, 1, 1, 2, 3, 4, 4, 8 };
+	AudioStreamBasicDescription format;
+	memset(&format, 0, sizeof(format));
+	format.mSampleRate = 48000.;
+	format.mFormatID = kAudioFormatLinearPCM;
+	format.mFormatFlags = kAudioFormatFlagIsPacked;
+	if (type >= CAPCMConverter::kSample_Float32)
+		format.mFormatFlags |= kAudioFormatFlagIsFloat;
+	else if (type != CAPCMConverter::kSample_UInt8)
+		format.mFormatFlags |= kAudioFormatFlagIsSignedInteger;
+	if (swapped != kHostIsBigEndian)
+		format.mFormatFlags |= kAudioFormatFlagIsBigEndian;
+	if (!interleaved)
+		format.mFormatFlags |= kAudioFormatFlagIsNonInterleaved;
+	format.mFormatFlags |= fractionBits << kLinearPCMFormatFlagsSampleFractionShift;
+	format.mBitsPerChannel = 8 * kBytes[type];
+	format.mChannelsPerFrame = channels;
+	format.mFramesPerPacket = 1;
+	format.mBytesPerFrame = format.mBytesPerPacket = kBytes[type] * (interleaved ? channels : 1);
+	return format;
+}
+
+// The reference: one sample at a time, in Float64, from the bytes.
+
+static UInt64 ReadBytes(const Byte *p, UInt32 bytes, bool bigEndian)
+{
+	UInt64 x = 0;
+	for (UInt32 i = 0; i < bytes; ++i)
+		x |= UInt64(p[bigEndian ? i : bytes - 1 - i]) << (8 * (bytes - 1 - i));
+	return x;
+}
+
+static void WriteBytes(Byte *p, UInt32 bytes, bool bigEndian, UInt64 x)
+{
+	for (UInt32 i = 0; i < bytes; ++i)
+		p[bigEndian ? i : bytes - 1 - i] = Byte(x >> (8 * (bytes - 1 - i)));
+}
+
+static double Decode(const Byte *p, const CAPCMConverter::SampleFormat &f)
+{
+	const bool bigEndian = kHostIsBigEndian != f.mIsSwapped;
+	UInt64 x = ReadBytes(p, f.mBytesPerSample, bigEndian);
+	if (f.mType == CAPCMConverter::kSample_Float32) {
+		UInt32 y = UInt32(x); Float32 v; memcpy(&v, &y, 4); return v;
+	}
+	if (f.mType == CAPCMConverter::kSample_Float64) {
+		Float64 v; memcpy(&v, &x, 8); return v;
+	}
+	const UInt32 bits = 8 * f.mBytesPerSample;
+	SInt64 v = (f.mType == CAPCMConverter::kSample_UInt8) ? SInt64(x) - 128 : SInt64(x << (64 - bits)) >> (64 - bits);
+	return ldexp(double(v), -int(f.mFractionBits));
+}
+
+static void Encode(Byte *p, const CAPCMConverter::SampleFormat &f, double v)
+{
+	const bool bigEndian = kHostIsBigEndian != f.mIsSwapped;
+	if (f.mType == CAPCMConverter::kSample_Float32) {
+		Float32 w = Float32(v); UInt32 y; memcpy(&y, &w, 4); WriteBytes(p, 4, bigEndian, y); return;
+	}
+	if (f.mType == CAPCMConverter::kSample_Float64) {
+		UInt64 y; memcpy(&y, &v, 8); WriteBytes(p, 8, bigEndian, y); return;
+	}
+	const UInt32 bits = 8 * f.mBytesPerSample;
+	const double hi = ldexp(1., bits - 1) - 1, lo = -ldexp(1., bits - 1);
+	double x = nearbyint(std::min(hi, std::max(lo, ldexp(v, f.mFractionBits))));
+	SInt64 y = SInt64(x) + (f.mType == CAPCMConverter::kSample_UInt8 ? 128 : 0);
+	WriteBytes(p, f.mBytesPerSample, bigEndian, UInt64(y));
+}
+
+// Buffers for one side of a conversion, in either layout.
+struct Buffers {
+	CAPCMConverter::SampleFormat	mFormat;
+	std::vector<Byte>				mData;
+	std::vector<void *>				mPointers;
+
+	void	Allocate(const CAPCMConverter::SampleFormat &inFormat, UInt32 frames)
+	{
+		mFormat = inFormat;
+		const UInt32 channels = inFormat.mNumberChannels;
+		// deinterleaved channels are offset by an odd number of samples, so not all aligned
+		const UInt32 pitch = inFormat.mIsInterleaved ? frames * channels : frames + 3;
+		mData.assign(size_t(pitch) * (inFormat.mIsInterleaved ? 1 : channels) * inFormat.mBytesPerSample + 16, 0);
+		mPointers.resize(inFormat.mIsInterleaved ? 1 : channels);
+		for (size_t i = 0; i < mPointers.size(); ++i)
+			mPointers[i] = &mData[i * pitch * inFormat.mBytesPerSample];
+	}
+	Byte *	Sample(UInt32 frame, UInt32 channel)
+	{
+		const UInt32 bytes = mFormat.mBytesPerSample;
+		if (mFormat.mIsInterleaved)
+			return static_cast<Byte *>(mPointers[0]) + (size_t(frame) * mFormat.mNumberChannels + channel) * bytes;
+		return static_cast<Byte *>(mPointers[channel]) + size_t(frame) * bytes;
+	}
+	void	Fill(UInt32 frames)
+	{
+		for (UInt32 c = 0; c < mFormat.mNumberChannels; ++c)
+			for (UInt32 k = 0; k < frames; ++k) {
+				Byte *p = Sample(k, c);
+				if (mFormat.mType >= CAPCMConverter::kSample_Float32)
+					Encode(p, mFormat, 2.2 * rand() / RAND_MAX - 1.1);	// some out of range
+				else
+					for (UInt32 b = 0; b < mFormat.mBytesPerSample; ++b)
+						p[b] = Byte(rand());
+			}
+	}
+};
+
+// Largest difference from the reference, in destination LSBs for integers and relative to
+// full scale for floats.
+static double Check(Buffers &src, Buffers &dst, UInt32 frames)
+{
+	std::vector<Byte> expected(8);
+	const CAPCMConverter::SampleFormat &df = dst.mFormat;
+	double worst = 0;
+	for (UInt32 c = 0; c < src.mFormat.mNumberChannels; ++c)
+		for (UInt32 k = 0; k < frames; ++k) {
+			Encode(&expected[0], df, Decode(src.Sample(k, c), src.mFormat));
+			double want = Decode(&expected[0], df), got = Decode(dst.Sample(k, c), df);
+			double error = fabs(got - want);
+			if (df.mType < CAPCMConverter::kSample_Float32) {
+				error = ldexp(error, df.mFractionBits);
+				// Float32 work clips 32-bit integers at the largest Float32 below 2^31
+				if (df.mBytesPerSample == 4 && ldexp(want, df.mFractionBits) > 2147483520. && ldexp(got, df.mFractionBits) >= 2147483520.)
+					error = 0;
+			}
+			else
+				error /= std::max(1., fabs(want));
+			if (!(error <= worst))
+				worst = (error == error) ? error : 1e9;
+		}
+	return worst;
+}
+
+static bool Verify(UInt32 srcType, bool srcSwapped, bool srcInterleaved, UInt32 srcFraction,
+					UInt32 dstType, bool dstSwapped, bool dstInterleaved, UInt32 dstFraction)
+{
+	const UInt32 channels = 5, frames = 1000;
+	CAPCMConverter converter;
+	if (!converter.Initialize(MakeFormat(srcType, srcSwapped, srcInterleaved, channels, srcFraction),
+							MakeFormat(dstType, dstSwapped, dstInterleaved, channels, dstFraction))) {
+		printf("FAILED to initialize %s -> %s\n", kTypeNames[srcType], kTypeNames[dstType]);
+		return false;
+	}
+	Buffers src, dst;
+	src.Allocate(converter.GetSourceFormat(), frames);
+	dst.Allocate(converter.GetDestinationFormat(), frames);
+	src.Fill(frames);
+	converter.Convert(&src.mPointers[0], &dst.mPointers[0], frames);
+
+	// Float32 work rounds a little differently from Float64 in a few cases, never by more
+	// than one LSB.
+	const double tolerance = dstType < CAPCMConverter::kSample_Float32 ? 1. : 1.2e-7;
+	double error = Check(src, dst, frames);
+	if (error > tolerance) {
+		printf("FAILED %s%s%s.%u -> %s%s%s.%u: error %g\n",
+			kTypeNames[srcType], srcSwapped ? " swapped" : "", srcInterleaved ? "" : " deinterleaved", unsigned(srcFraction),
+			kTypeNames[dstType], dstSwapped ? " swapped" : "", dstInterleaved ? "" : " deinterleaved", unsigned(dstFraction), error);
+		return false;
+	}
+	return true;
+}
+
+static double Throughput(const AudioStreamBasicDescription &srcFormat, const AudioStreamBasicDescription &dstFormat, UInt32 frames, bool dither = false)
+{
+	CAPCMConverter converter;
+	if (!converter.Initialize(srcFormat, dstFormat, dither))
+		return 0;
+	Buffers src, dst;
+	src.Allocate(converter.GetSourceFormat(), frames);
+	dst.Allocate(converter.GetDestinationFormat(), frames);
+	src.Fill(frames);
+	const double samples = double(frames) * srcFormat.mChannelsPerFrame;
+	const int iterations = std::max(1, int(2e8 / samples));
+	double best = 1e9;
+	for (int pass = 0; pass < 3; ++pass) {
+		double t0 = Now();
+		for (int k = 0; k < iterations / 3 + 1; ++k)
+			converter.Convert(&src.mPointers[0], &dst.mPointers[0], frames);
+		best = std::min(best, (Now() - t0) / (iterations / 3 + 1));
+	}
+	return samples / best * 1e-6;
+}
+
+int main()
+{
+	srand(1);
+	bool ok = true;
+
+	// every pair, byte order and layout
+	int pairs = 0;
+	for (UInt32 s = 1; s < CAPCMConverter::kNumberSampleTypes; ++s)
+		for (UInt32 d = 1; d < CAPCMConverter::kNumberSampleTypes; ++d)
+			for (int layout = 0; layout < 16; ++layout) {
+				const bool ss = layout & 1, ds = layout & 2, si = !(layout & 4), di = !(layout & 8);
+				if ((ss && s <= CAPCMConverter::kSample_UInt8) || (ds && d <= CAPCMConverter::kSample_UInt8))
+					continue;
+				ok &= Verify(s, ss, si, 0, d, ds, di, 0);
+				++pairs;
+			}
+	// fixed point: 8.24 to and from the others, and 16.16 to 8.24
+	for (UInt32 t = 1; t < CAPCMConverter::kNumberSampleTypes; ++t) {
+		ok &= Verify(CAPCMConverter::kSample_Int32, false, false, 24, t, false, true, 0);
+		ok &= Verify(t, false, true, 0, CAPCMConverter::kSample_Int32, false, false, 24);
+		pairs += 2;
+	}
+	ok &= Verify(CAPCMConverter::kSample_Int32, false, true, 16, CAPCMConverter::kSample_Int32, true, true, 24);
+	++pairs;
+	printf("%d format pairs checked against the Float64 reference: %s\n\n", pairs, ok ? "ok" : "FAILED");
+
+	// clipping and NaN to integers
+	{
+		CAPCMConverter converter;
+		converter.Initialize(MakeFormat(CAPCMConverter::kSample_Float32, false, true, 1), MakeFormat(CAPCMConverter::kSample_Int32, false, true, 1));
+		Float32 in[12] = { 2.f, -2.f, 1.f, -1.f, NAN, 0.5f, 2.f, -2.f, 1.f, -1.f, NAN, 0.5f };
+		SInt32 out[12];
+		const void *src = in; void *dst = out;
+		converter.Convert(&src, &dst, 12);
+		const bool clipped = out[0] > 2147483000 && out[1] == -2147483647 - 1 && out[4] == out[1] && out[5] == 1073741824
+							&& out[6] == out[0] && out[10] == out[1];
+		printf("Float32 to Int32 clipping: %s\n\n", clipped ? "ok" : "FAILED");
+		ok &= clipped;
+	}
+
+	// dither: a quarter LSB comes out as -1, 0 or 1 LSB averaging a quarter
+	{
+		CAPCMConverter converter;
+		converter.Initialize(MakeFormat(CAPCMConverter::kSample_Float32, false, true, 1), MakeFormat(CAPCMConverter::kSample_Int16, false, true, 1), true);
+		std::vector<Float32> in(100000, 0.25f / 32768.f);
+		std::vector<SInt16> out(in.size());
+		const void *src = &in[0]; void *dst = &out[0];
+		converter.Convert(&src, &dst, UInt32(in.size()));
+		double sum = 0;
+		int worst = 0;
+		for (size_t k = 0; k < out.size(); ++k) {
+			sum += out[k];
+			worst = std::max(worst, abs(out[k]));
+		}
+		const bool dithered = converter.GetDither() && worst <= 1 && fabs(sum / out.size() - 0.25) < 0.01;
+		printf("Float32 to Int16 dither: mean %.4f LSB: %s\n\n", sum / out.size(), dithered ? "ok" : "FAILED");
+		ok &= dithered;
+	}
+
+	// throughput
+	const UInt32 channels = 64, frames = 512;
+	printf("Msamples/s, %u channels x %u frames, native endian, interleaved (rows: source, columns: destination)\n", unsigned(channels), unsigned(frames));
+	printf("%-8s", "");
+	for (UInt32 d = 1; d < CAPCMConverter::kNumberSampleTypes; ++d)
+		printf("%9s", kTypeNames[d]);
+	printf("\n");
+	for (UInt32 s = 1; s < CAPCMConverter::kNumberSampleTypes; ++s) {
+		printf("%-8s", kTypeNames[s]);
+		for (UInt32 d = 1; d < CAPCMConverter::kNumberSampleTypes; ++d)
+			printf("%9.0f", Throughput(MakeFormat(s, false, true, channels), MakeFormat(d, false, true, channels), frames));
+		printf("\n");
+	}
+
+	struct Case { const char *mName; UInt32 mSrc; bool mSrcSwapped, mSrcInterleaved; UInt32 mDst; bool mDstSwapped, mDstInterleaved, mDither; UInt32 mChannels; };
+	static const Case kCases[] = {
+		{ "Int16 swapped -> Float32",					CAPCMConverter::kSample_Int16, true, true, CAPCMConverter::kSample_Float32, false, true, false, 64 },
+		{ "Float32 -> Int24 swapped",					CAPCMConverter::kSample_Float32, false, true, CAPCMConverter::kSample_Int24, true, true, false, 64 },
+		{ "Float32 swapped -> Float32",					CAPCMConverter::kSample_Float32, true, true, CAPCMConverter::kSample_Float32, false, true, false, 64 },
+		{ "Float32 -> Int16, dithered",					CAPCMConverter::kSample_Float32, false, true, CAPCMConverter::kSample_Int16, false, true, true, 64 },
+		{ "Float32 -> Int24, dithered",					CAPCMConverter::kSample_Float32, false, true, CAPCMConverter::kSample_Int24, false, true, true, 64 },
+		{ "Int16 interleaved -> Float32 deinterleaved",	CAPCMConverter::kSample_Int16, false, true, CAPCMConverter::kSample_Float32, false, false, false, 2 },
+		{ "Int24 interleaved -> Float32 deinterleaved",	CAPCMConverter::kSample_Int24, false, true, CAPCMConverter::kSample_Float32, false, false, false, 256 },
+		{ "Float32 deinterleaved -> Int24 interleaved",	CAPCMConverter::kSample_Float32, false, false, CAPCMConverter::kSample_Int24, false, true, false, 256 },
+		{ "Float32 deinterleaved -> Int16 interleaved",	CAPCMConverter::kSample_Float32, false, false, CAPCMConverter::kSample_Int16, false, true, false, 256 },
+		{ "Int32 deinterleaved -> Float32 deinterleaved",	CAPCMConverter::kSample_Int32, false, false, CAPCMConverter::kSample_Float32, false, false, false, 256 },
+	};
+	printf("\n");
+	for (size_t i = 0; i < sizeof(kCases) / sizeof(kCases[0]); ++i) {
+		const Case &c = kCases[i];
+		printf("%-46s %3u ch %9.0f Msamples/s\n", c.mName, unsigned(c.mChannels),
+			Throughput(MakeFormat(c.mSrc, c.mSrcSwapped, c.mSrcInterleaved, c.mChannels),
+						MakeFormat(c.mDst, c.mDstSwapped, c.mDstInterleaved, c.mChannels), frames, c.mDither));
+	}
+	return ok ? 0 : 1;
+}
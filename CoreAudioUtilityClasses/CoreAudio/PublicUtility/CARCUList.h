@@ -0,0 +1,490 @@
+/*
+     File: CARCUList.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+#ifndef __CARCUList_h__
+#define __CARCUList_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+#include "CAAtomic.h"
+#include "CAAtomicStack.h"
+#include "CAAutoDisposer.h"
+#include <new>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+//  TRCUList: a read-mostly set of T's, for listener and callback lists that are iterated on
+//	many threads (including real time ones) and changed now and then on others.
+//	T must define operator == and be copyable.
+//
+//	Readers see an immutable snapshot of the list. Reading is wait-free: a TRCUList::Reader
+//	announces itself on one of a few counters and picks up the current snapshot, and never
+//	blocks, allocates or frees, however busy the writers are.
+//
+//	Writers copy the current snapshot, change the copy and publish it, serialized by a spin
+//	lock. Changes can be batched (Update, or the deferred_ calls applied by update()) so
+//	that many of them make one copy. A replaced snapshot is freed only once no reader can
+//	still be looking at it, by the epoch scheme below, and only ever on a writer's thread:
+//	by the next write, Reclaim() or the destructor.
+//
+//	Epochs: readers count themselves in under the parity of the current epoch. The epoch
+//	may advance from E to E+1 once no reader is counted under the parity of E-1. A snapshot
+//	replaced during epoch E can't be seen by any reader once the epoch reaches E+2: readers
+//	that entered before it was replaced were counted under E's parity or earlier, and have
+//	all left by then; any reader since has loaded a newer snapshot.
+//
+//	The writer calls mustn't be made on a real time thread: they allocate and free. The
+//	deferred_ calls are like TThreadSafeList's, and may be. As there, T is assigned into
+//	raw memory by the deferred_ calls, so it should be a plain struct. A real time thread
+//	can apply queued removals itself with try_update(), which neither blocks, allocates
+//	nor frees: it fills a spare snapshot that writers keep, or a retired one no reader can
+//	see any more.
+template <class T>
+class TRCUList {
+private:
+	enum { kStripes = 8 };		// reader counters per parity, a cache line each
+
+	struct Snapshot {
+		UInt32		mCount;
+		UInt32		mCapacity;
+		SInt32		mRetiredEpoch;
+		Snapshot *	mNextRetired;
+		T *			mItems;		// follows the header
+	};
+
+	enum EEventType { kAdd, kRemove, kClear };
+	class Event {
+	public:
+		Event *		mNext;
+		EEventType	mEventType;
+		T			mObject;
+
+		Event *&	next() { return mNext; }
+	};
+
+	struct ReaderCount {
+		volatile SInt32		mCount;
+		char				mPad[64 - sizeof(SInt32)];
+	};
+
+public:
+	typedef const T *	iterator;
+
+	// Reads the current snapshot for as long as it's in scope; wait-free.
+	class Reader {
+	public:
+		Reader(const TRCUList &inList) : mList(inList) { mSnapshot = inList.Enter(mSlot); }
+		~Reader() { mList.Exit(mSlot); }
+
+		iterator	begin() const { return mSnapshot->mItems; }
+		iterator	end() const { return mSnapshot->mItems + mSnapshot->mCount; }
+		UInt32		size() const { return mSnapshot->mCount; }
+		bool		empty() const { return mSnapshot->mCount == 0; }
+
+	private:
+		Reader(const Reader &);
+		Reader &	operator=(const Reader &);
+
+		const TRCUList &	mList;
+		const Snapshot *	mSnapshot;
+		UInt32				mSlot;
+	};
+
+	// Batches changes into one new snapshot, published when it goes out of scope. Other
+	// writers wait meanwhile.
+	class Update {
+	public:
+		Update(TRCUList &inList) : mList(inList), mChanged(false)
+		{
+			mList.Lock();
+			const Snapshot *current = mList.mCurrent;
+			mItems.assign(current->mItems, current->mItems + current->mCount);
+		}
+		~Update()
+		{
+			if (mChanged)
+				mList.Publish(mItems.empty() ? NULL : &mItems[0], static_cast<UInt32>(mItems.size()));
+			mList.Reclaim_Locked();
+			mList.Unlock();
+		}
+
+		bool	add(const T &inObject)
+		{
+			for (size_t i = 0; i < mItems.size(); ++i)
+				if (mItems[i] == inObject)
+					return false;
+			mItems.push_back(inObject);
+			mChanged = true;
+			return true;
+		}
+		bool	remove(const T &inObject)
+		{
+			for (size_t i = 0; i < mItems.size(); ++i)
+				if (mItems[i] == inObject) {
+					mItems.erase(mItems.begin() + i);
+					mChanged = true;
+					return true;
+				}
+			return false;
+		}
+		void	clear() { mChanged = mChanged || !mItems.empty(); mItems.clear(); }
+
+	private:
+		Update(const Update &);
+		Update &	operator=(const Update &);
+
+		TRCUList &			mList;
+		std::vector<T>		mItems;
+		bool				mChanged;
+	};
+
+	TRCUList() : mCurrent(NULL), mRetired(NULL), mSpare(NULL), mEpoch(0), mWriteLock(0)
+	{
+		memset(const_cast<ReaderCount *>(mReaders), 0, sizeof(mReaders));
+		mCurrent = NewSnapshot(NULL, 0, 0);
+		mSpare = NewSnapshot(NULL, 0, 0);
+	}
+
+	~TRCUList()		// there must be no readers left
+	{
+		update();
+		FreeSnapshot(const_cast<Snapshot *>(mCurrent));
+		if (mSpare != NULL)
+			FreeSnapshot(mSpare);
+		while (mRetired != NULL) {
+			Snapshot *next = mRetired->mNextRetired;
+			FreeSnapshot(mRetired);
+			mRetired = next;
+		}
+		mPendingList.free_all();
+		mFreeList.free_all();
+	}
+
+	// Writers; any thread but a real time one. They return whether anything changed.
+
+	bool	add(const T &inObject)			{ Update u(*this); return u.add(inObject); }
+	bool	remove(const T &inObject)		{ Update u(*this); return u.remove(inObject); }
+	void	clear()							{ Update u(*this); u.clear(); }
+
+	// Frees the snapshots no reader can see any more. Writes do this too; call it now and
+	// then if writes are rare and snapshots big.
+	void	Reclaim()
+	{
+		Lock();
+		Reclaim_Locked();
+		Unlock();
+	}
+
+	// Like TThreadSafeList: these queue a change on any thread, and update() applies all the
+	// queued changes, in order, as one batch.
+
+	void	deferred_add(const T &inObject)		{ Defer(kAdd, &inObject); }
+	void	deferred_remove(const T &inObject)	{ Defer(kRemove, &inObject); }
+	void	deferred_clear()					{ Defer(kClear, NULL); }
+
+	void	update()
+	{
+		if (mPendingList.empty())
+			return;
+		Update u(*this);
+		Event *events = mPendingList.pop_all_reversed();	// with the lock held, so try_update can look
+		while (events != NULL) {
+			Event *next = events->mNext;
+			switch (events->mEventType) {
+			case kAdd:		u.add(events->mObject); break;
+			case kRemove:	u.remove(events->mObject); break;
+			case kClear:	u.clear(); break;
+			}
+			mFreeList.push_atomic(events);
+			events = next;
+		}
+	}
+
+	// For real time threads: applies the queued changes if they are all removals or clears,
+	// the write lock is free and a snapshot to fill is at hand, and otherwise leaves them for
+	// a later try_update() or update(). Returns whether the changes queued when it was
+	// called were applied.
+	bool	try_update()
+	{
+		if (mPendingList.empty())
+			return true;
+		if (!CASpinLockTry(&mWriteLock))
+			return false;
+
+		// pushes only ever change the head, so with the lock held the events queued so far
+		// can be walked; later ones are left for next time
+		Event *queued = mPendingList.head();
+		bool cleared = false;
+		for (Event *event = queued; event != NULL; event = event->mNext) {
+			if (event->mEventType == kAdd) {
+				Unlock();
+				return false;
+			}
+			cleared = cleared || event->mEventType == kClear;
+		}
+
+		const Snapshot *current = mCurrent;
+		UInt32 count = 0;
+		if (!cleared)
+			for (UInt32 i = 0; i < current->mCount; ++i)
+				count += !Removes(queued, current->mItems[i]);
+
+		Snapshot *snapshot = NULL;
+		if (count != current->mCount) {
+			snapshot = TakeSpare_Locked(count);
+			if (snapshot == NULL) {
+				Unlock();
+				return false;
+			}
+			for (UInt32 i = 0; i < current->mCount && snapshot->mCount < count; ++i)
+				if (!Removes(queued, current->mItems[i]))
+					new (&snapshot->mItems[snapshot->mCount++]) T(current->mItems[i]);
+		}
+
+		Event *events = mPendingList.pop_all();
+		if (events != queued) {
+			Event *later = events;
+			while (events->mNext != queued)
+				events = events->mNext;
+			events->mNext = NULL;
+			mPendingList.push_multiple_atomic(later);
+			events = queued;
+		}
+		while (events != NULL) {
+			Event *next = events->mNext;
+			mFreeList.push_atomic(events);
+			events = next;
+		}
+		if (snapshot != NULL)
+			Publish_Locked(snapshot);
+		Unlock();
+		return true;
+	}
+
+private:
+	TRCUList(const TRCUList &);
+	TRCUList &	operator=(const TRCUList &);
+
+	static UInt32	Stripe()
+	{
+		// threads' stacks are pages apart, so a local's address tells them apart; they're
+		// often a power of two apart, so hash it
+		char local;
+		UInt32 page = static_cast<UInt32>(reinterpret_cast<uintptr_t>(&local) >> 12);
+		return ((page * 0x9E3779B1U) >> 16) % kStripes;
+	}
+
+	const Snapshot *	Enter(UInt32 &outSlot) const
+	{
+		SInt32 epoch = mEpoch;
+		outSlot = static_cast<UInt32>(epoch & 1) * kStripes + Stripe();
+		CAAtomicIncrement32Barrier(&mReaders[outSlot].mCount);
+		return mCurrent;	// loaded after the increment is visible
+	}
+
+	void	Exit(UInt32 inSlot) const
+	{
+		CAAtomicDecrement32Barrier(&mReaders[inSlot].mCount);
+	}
+
+	void	Lock() { CASpinLockLock(&mWriteLock); }
+	void	Unlock() { CASpinLockUnlock(&mWriteLock); }
+
+	static Snapshot *	NewSnapshot(const T *inItems, UInt32 inCount, UInt32 inCapacity)
+	{
+		// the items follow the header, aligned for T
+		size_t header = (sizeof(Snapshot) + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+		Snapshot *snapshot = static_cast<Snapshot *>(CA_malloc(header + inCapacity * sizeof(T)));
+		snapshot->mCount = inCount;
+		snapshot->mCapacity = inCapacity;
+		snapshot->mRetiredEpoch = 0;
+		snapshot->mNextRetired = NULL;
+		snapshot->mItems = reinterpret_cast<T *>(reinterpret_cast<char *>(snapshot) + header);
+		for (UInt32 i = 0; i < inCount; ++i)
+			new (&snapshot->mItems[i]) T(inItems[i]);
+		return snapshot;
+	}
+
+	static void		EmptySnapshot(Snapshot *inSnapshot)
+	{
+		for (UInt32 i = 0; i < inSnapshot->mCount; ++i)
+			inSnapshot->mItems[i].~T();
+		inSnapshot->mCount = 0;
+	}
+
+	static void		FreeSnapshot(Snapshot *inSnapshot)
+	{
+		EmptySnapshot(inSnapshot);
+		free(inSnapshot);
+	}
+
+	// with the write lock held
+	void	Publish(const T *inItems, UInt32 inCount)
+	{
+		Publish_Locked(NewSnapshot(inItems, inCount, inCount));
+
+		// keep a spare big enough for try_update to remove from this one
+		if (mSpare == NULL || mSpare->mCapacity < inCount) {
+			if (mSpare != NULL)
+				FreeSnapshot(mSpare);
+			mSpare = NewSnapshot(NULL, 0, inCount);
+		}
+	}
+
+	// with the write lock held; neither allocates nor frees
+	void	Publish_Locked(Snapshot *snapshot)
+	{
+		Snapshot *old = const_cast<Snapshot *>(mCurrent);
+		CAMemoryBarrier();			// the snapshot is complete before it's seen
+		mCurrent = snapshot;
+		CAMemoryBarrier();			// and replaced before the epoch it's retired in is read
+		old->mRetiredEpoch = mEpoch;
+		old->mNextRetired = mRetired;
+		mRetired = old;
+	}
+
+	// with the write lock held
+	void	Reclaim_Locked()
+	{
+		if (mRetired == NULL)
+			return;
+		AdvanceEpoch_Locked();
+		SInt32 epoch = mEpoch;
+		for (Snapshot **p = &mRetired; *p != NULL; ) {
+			Snapshot *snapshot = *p;
+			if (epoch - snapshot->mRetiredEpoch >= 2) {
+				*p = snapshot->mNextRetired;
+				FreeSnapshot(snapshot);
+			} else
+				p = &snapshot->mNextRetired;
+		}
+	}
+
+	// with the write lock held; the spare, or a retired snapshot no reader can see, emptied
+	// and with room for inCount items; NULL if there's none
+	Snapshot *	TakeSpare_Locked(UInt32 inCount)
+	{
+		if (mSpare != NULL && mSpare->mCapacity >= inCount) {
+			Snapshot *spare = mSpare;
+			mSpare = NULL;
+			return spare;
+		}
+		AdvanceEpoch_Locked();
+		SInt32 epoch = mEpoch;
+		for (Snapshot **p = &mRetired; *p != NULL; p = &(*p)->mNextRetired) {
+			Snapshot *snapshot = *p;
+			if (epoch - snapshot->mRetiredEpoch >= 2 && snapshot->mCapacity >= inCount) {
+				*p = snapshot->mNextRetired;
+				EmptySnapshot(snapshot);
+				snapshot->mNextRetired = NULL;
+				return snapshot;
+			}
+		}
+		return NULL;
+	}
+
+	// with the write lock held
+	void	AdvanceEpoch_Locked()
+	{
+		for (int i = 0; i < 2; ++i) {
+			SInt32 epoch = mEpoch;
+			const ReaderCount *previous = &mReaders[((epoch + 1) & 1) * kStripes];
+			SInt32 readers = 0;
+			for (int s = 0; s < kStripes; ++s)
+				readers += previous[s].mCount;
+			if (readers != 0)
+				break;
+			CAMemoryBarrier();
+			mEpoch = epoch + 1;
+			CAMemoryBarrier();
+		}
+	}
+
+	// whether one of the events removes inObject
+	static bool	Removes(const Event *inEvents, const T &inObject)
+	{
+		for (const Event *event = inEvents; event != NULL; event = event->mNext)
+			if (event->mEventType == kRemove && event->mObject == inObject)
+				return true;
+		return false;
+	}
+
+	void	Defer(EEventType inType, const T *inObject)
+	{
+		Event *event = mFreeList.pop_atomic();
+		if (event == NULL)
+			event = static_cast<Event *>(CA_malloc(sizeof(Event)));
+		event->mEventType = inType;
+		if (inObject != NULL)
+			event->mObject = *inObject;
+		mPendingList.push_atomic(event);
+	}
+
+	class EventStack : public TAtomicStack<Event> {
+	public:
+		void free_all() {
+			Event *event;
+			while ((event = this->pop_NA()) != NULL)
+				free(event);
+		}
+	};
+
+	const Snapshot * volatile	mCurrent;
+	Snapshot *					mRetired;		// newest first; write lock
+	Snapshot *					mSpare;			// for try_update; write lock
+	volatile SInt32				mEpoch;
+	mutable ReaderCount			mReaders[2 * kStripes];
+	CASpinLock					mWriteLock;
+	EventStack					mPendingList;	// deferred changes
+	EventStack					mFreeList;		// events for reuse
+};
+
+#endif // __CARCUList_h__
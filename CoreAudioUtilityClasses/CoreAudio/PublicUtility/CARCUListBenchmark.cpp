@@ -0,0 +1,305 @@
+/*
+     File: CARCUListBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+// Contention benchmark and check for TRCUList.
+//
+// Several reader threads walk a list over and over, as render threads walk their render
+// notification lists, while a writer thread keeps adding and removing entries. Compares
+// TRCUList with TThreadSafeList, whose update() and iteration must be confined to one
+// thread at a time and so here share a spin lock. With the writer changing the list flat
+// out and then now and then, prints reads per second, the mean and
+// worst time a read took, and the writer's rate, for 1 to 8 readers.
+//
+// The writer adds and removes entries in pairs summing to zero, a pair per batch, so every
+// snapshot a TRCUList reader sees must sum to zero with an even count; the readers check.
+// Then checks the deferred calls, and that try_update applies queued removals on its own.
+//
+// Beyond CoreAudioTypes.h this needs CAAtomic.h's primitives, e.g. on Linux with a
+// libkern/OSAtomic.h shim over the compiler's builtins:
+//	c++ -O3 -DTARGET_OS_MAC=1 -o CARCUListBenchmark CARCUListBenchmark.cpp -lpthread
+
+#include "CARCUList.h"
+#include "CAThreadSafeList.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct Entry {
+	SInt32		mValue;
+	bool operator == (const Entry &other) const { return mValue == other.mValue; }
+};
+
+static const int kMaxReaders = 8;
+static const int kListSize = 16;		// pairs in the list at any time
+
+static double Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+struct ReaderStats {
+	UInt64		mReads;
+	double		mTotal;
+	double		mWorst;
+	UInt64		mErrors;
+	char		mPad[64];
+};
+
+static volatile bool gStop;
+static long gWriteInterval;		// ns between writes, or 0 to write flat out
+
+static void Pace()
+{
+	if (gWriteInterval > 0) {
+		struct timespec ts = { 0, gWriteInterval };
+		nanosleep(&ts, NULL);
+	}
+}
+
+// ____________________________________________________________________________________
+// TRCUList
+
+static TRCUList<Entry> *gRCUList;
+
+static void *RCUReader(void *arg)
+{
+	ReaderStats &stats = *static_cast<ReaderStats *>(arg);
+	while (!gStop) {
+		double start = Now();
+		SInt64 sum = 0;
+		UInt32 count = 0;
+		{
+			TRCUList<Entry>::Reader reader(*gRCUList);
+			for (TRCUList<Entry>::iterator it = reader.begin(); it != reader.end(); ++it) {
+				sum += it->mValue;
+				++count;
+			}
+		}
+		double elapsed = Now() - start;
+		if (sum != 0 || (count & 1))
+			++stats.mErrors;
+		++stats.mReads;
+		stats.mTotal += elapsed;
+		if (elapsed > stats.mWorst)
+			stats.mWorst = elapsed;
+	}
+	return NULL;
+}
+
+static void *RCUWriter(void *arg)
+{
+	UInt64 &writes = *static_cast<UInt64 *>(arg);
+	SInt32 next = 1 + kListSize;
+	for (SInt32 oldest = 1; !gStop; ++oldest, ++next, ++writes) {
+		{
+			TRCUList<Entry>::Update update(*gRCUList);
+			Entry e;
+			e.mValue = oldest;		update.remove(e);
+			e.mValue = -oldest;		update.remove(e);
+			e.mValue = next;		update.add(e);
+			e.mValue = -next;		update.add(e);
+		}
+		Pace();
+	}
+	return NULL;
+}
+
+// ____________________________________________________________________________________
+// TThreadSafeList, its update() and iteration serialized by a lock
+
+static TThreadSafeList<Entry> *gTSList;
+static CASpinLock gTSLock;
+
+static void *TSReader(void *arg)
+{
+	ReaderStats &stats = *static_cast<ReaderStats *>(arg);
+	while (!gStop) {
+		double start = Now();
+		SInt64 sum = 0;
+		CASpinLockLock(&gTSLock);
+		gTSList->update();
+		for (TThreadSafeList<Entry>::iterator it = gTSList->begin(); it != gTSList->end(); ++it)
+			sum += (*it).mValue;
+		CASpinLockUnlock(&gTSLock);
+		double elapsed = Now() - start;
+		(void)sum;		// a reader may apply half of a pair, so no check
+		++stats.mReads;
+		stats.mTotal += elapsed;
+		if (elapsed > stats.mWorst)
+			stats.mWorst = elapsed;
+	}
+	return NULL;
+}
+
+static void *TSWriter(void *arg)
+{
+	UInt64 &writes = *static_cast<UInt64 *>(arg);
+	SInt32 next = 1 + kListSize;
+	for (SInt32 oldest = 1; !gStop; ++oldest, ++next, ++writes) {
+		Entry e;
+		e.mValue = oldest;		gTSList->deferred_remove(e);
+		e.mValue = -oldest;		gTSList->deferred_remove(e);
+		e.mValue = next;		gTSList->deferred_add(e);
+		e.mValue = -next;		gTSList->deferred_add(e);
+		Pace();
+	}
+	return NULL;
+}
+
+// ____________________________________________________________________________________
+
+static void Run(const char *name, int nReaders, void *(*reader)(void *), void *(*writer)(void *), double seconds)
+{
+	ReaderStats stats[kMaxReaders];
+	memset(stats, 0, sizeof(stats));
+	UInt64 writes = 0;
+	pthread_t readers[kMaxReaders], writerThread;
+
+	gStop = false;
+	for (int i = 0; i < nReaders; ++i)
+		pthread_create(&readers[i], NULL, reader, &stats[i]);
+	pthread_create(&writerThread, NULL, writer, &writes);
+	double start = Now();
+	struct timespec ts = { time_t(seconds), long((seconds - time_t(seconds)) * 1e9) };
+	nanosleep(&ts, NULL);
+	gStop = true;
+	for (int i = 0; i < nReaders; ++i)
+		pthread_join(readers[i], NULL);
+	pthread_join(writerThread, NULL);
+	double elapsed = Now() - start;
+
+	UInt64 reads = 0, errors = 0;
+	double total = 0, worst = 0;
+	for (int i = 0; i < nReaders; ++i) {
+		reads += stats[i].mReads;
+		errors += stats[i].mErrors;
+		total += stats[i].mTotal;
+		if (stats[i].mWorst > worst)
+			worst = stats[i].mWorst;
+	}
+	printf("%-16s %2d  %12.0f  %10.1f  %12.1f  %12.0f  %s\n", name, nReaders,
+		reads / elapsed, reads ? 1e9 * total / reads : 0., 1e6 * worst, writes / elapsed,
+		errors ? "INCONSISTENT" : "ok");
+}
+
+int main(int argc, char *argv[])
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 1.;
+
+	TRCUList<Entry> rcuList;
+	TThreadSafeList<Entry> tsList;
+	gRCUList = &rcuList;
+	gTSList = &tsList;
+	{
+		TRCUList<Entry>::Update update(rcuList);
+		for (SInt32 i = 1; i <= kListSize; ++i) {
+			Entry e;
+			e.mValue = i;	update.add(e);	tsList.deferred_add(e);
+			e.mValue = -i;	update.add(e);	tsList.deferred_add(e);
+		}
+	}
+	tsList.update();
+
+	const long intervals[] = { 0, 100000 };
+	for (int i = 0; i < 2; ++i) {
+		gWriteInterval = intervals[i];
+		if (gWriteInterval > 0)
+			printf("\nwriter pausing %ld us between changes\n", gWriteInterval / 1000);
+		else
+			printf("writer changing the list flat out\n");
+		printf("%-16s %2s  %12s  %10s  %12s  %12s\n", "list", "rd", "reads/s", "mean ns", "worst us", "writes/s");
+		for (int n = 1; n <= kMaxReaders; n *= 2) {
+			Run("TThreadSafeList", n, TSReader, TSWriter, seconds);
+			Run("TRCUList", n, RCUReader, RCUWriter, seconds);
+		}
+	}
+
+	// the deferred calls apply as a batch too
+	for (SInt32 i = 1000000; i < 1000000 + 1000; ++i) {
+		Entry e;
+		e.mValue = i;	rcuList.deferred_add(e);
+		e.mValue = -i;	rcuList.deferred_add(e);
+	}
+	rcuList.deferred_clear();
+	Entry e;
+	e.mValue = 7;	rcuList.deferred_add(e);
+	e.mValue = -7;	rcuList.deferred_add(e);
+	rcuList.update();
+	{
+		TRCUList<Entry>::Reader reader(rcuList);
+		bool ok = reader.size() == 2 && reader.begin()[0].mValue == 7 && reader.begin()[1].mValue == -7;
+		printf("deferred updates: %s\n", ok ? "ok" : "WRONG");
+		if (!ok)
+			return 1;
+	}
+
+	// try_update applies removals one at a time with no writer in between, reusing
+	// retired snapshots, and leaves adds to update()
+	{
+		TRCUList<Entry> list;
+		for (SInt32 i = 1; i <= kListSize; ++i) {
+			e.mValue = i;	list.add(e);
+		}
+		bool ok = true;
+		for (SInt32 i = 1; i <= kListSize; ++i) {
+			e.mValue = i;	list.deferred_remove(e);
+			ok = ok && list.try_update();
+			TRCUList<Entry>::Reader reader(list);
+			ok = ok && reader.size() == UInt32(kListSize - i) && (reader.empty() || reader.begin()[0].mValue == i + 1);
+		}
+		e.mValue = 1;	list.deferred_add(e);
+		ok = ok && !list.try_update();
+		list.update();
+		ok = ok && list.try_update() && TRCUList<Entry>::Reader(list).size() == 1;
+		printf("try_update: %s\n", ok ? "ok" : "WRONG");
+		if (!ok)
+			return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,836 @@
+/*
+     File: CASettingsSharedImage.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+//==================================================================================================
+//	Includes
+//==================================================================================================
+
+//	Self Include
+#include "CASettingsSharedImage.h"
+
+//	PublicUtility Includes
+#include "CAAtomic.h"
+
+//	Standard Library Includes
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//==================================================================================================
+//	Image Layout
+//
+//	The file is the header, padded to kHeaderSize, then the slots, then the heap. All offsets in
+//	the image are from the start of the file, and everything in the heap is 8 byte aligned.
+//==================================================================================================
+
+struct CASettingsSharedImage::Header
+{
+	UInt32					mMagic;
+	UInt32					mVersion;
+	volatile SInt32			mSequence;			//	odd while a writer is changing the image
+	UInt32					mIsPopulated;
+	UInt32					mFileSize;
+	UInt32					mNumberSlots;		//	a power of two
+	UInt32					mHeapOffset;
+	UInt32					mHeapSize;
+	UInt32					mHeapUsed;
+	UInt32					mHeapGarbage;		//	bytes of replaced keys and values
+	UInt32					mNumberKeys;
+	UInt32					mNumberRemovedSlots;
+};
+
+struct CASettingsSharedImage::Slot
+{
+	UInt32					mType;				//	a kValueType, or one of the slot states below
+	UInt32					mHash;
+	UInt32					mKeyOffset;
+	UInt32					mKeyLength;
+	UInt32					mDataOffset;
+	UInt32					mDataLength;
+	UInt64					mScalar;
+};
+
+static const UInt32	kImageMagic			= 0x43417369;	//	'CAsi'
+static const UInt32	kImageVersion		= 1;
+static const UInt32	kHeaderSize			= 64;
+static const UInt32	kInitialSlots		= 64;
+static const UInt32	kInitialHeapSize	= 16384;
+static const UInt32	kSlotEmpty			= 0;			//	same as kValueType_None
+static const UInt32	kSlotRemoved		= 0xFFFFFFFF;
+static const UInt32	kNoSlot				= 0xFFFFFFFF;
+
+static inline UInt32	Align8(UInt32 inSize)
+{
+	return (inSize + 7) & ~7U;
+}
+
+static inline UInt32	HashKey(const char* inKey, UInt32 inKeyLength)
+{
+	//	FNV-1a
+	UInt32 theHash = 2166136261U;
+	for(UInt32 theIndex = 0; theIndex < inKeyLength; ++theIndex)
+	{
+		theHash = (theHash ^ static_cast<UInt8>(inKey[theIndex])) * 16777619U;
+	}
+	return theHash;
+}
+
+static inline bool	IsValueType(UInt32 inType)
+{
+	return (inType >= CASettingsSharedImage::kValueType_Boolean) && (inType <= CASettingsSharedImage::kValueType_Blob);
+}
+
+//==================================================================================================
+//	CASettingsSharedImage
+//==================================================================================================
+
+CASettingsSharedImage::CASettingsSharedImage(const char* inImageFilePath, mode_t inImageFileAccessMode)
+:
+	mImageFile(-1),
+	mProbeFile(-1),
+	mImageFileAccessMode(inImageFileAccessMode),
+	mMapping(NULL),
+	mRetiredMappings()
+{
+	pthread_mutex_init(&mMappingMutex, NULL);
+	pthread_mutex_init(&mUpdateMutex, NULL);
+	
+	mImageFile = open(inImageFilePath, O_RDWR | O_CREAT, (inImageFileAccessMode != 0) ? inImageFileAccessMode : 0644);
+	if(mImageFile >= 0)
+	{
+		mProbeFile = open(inImageFilePath, O_RDONLY);
+	}
+	if((mImageFile >= 0) && (mProbeFile >= 0))
+	{
+		flock(mImageFile, LOCK_EX);
+		
+		//	set the file access mode if necessary
+		if(mImageFileAccessMode != 0)
+		{
+			fchmod(mImageFile, mImageFileAccessMode);
+		}
+		
+		//	map what's there, and start over if it isn't an image we understand
+		UInt32 theNumberSlots = 0;
+		struct stat theFileInfo;
+		if((fstat(mImageFile, &theFileInfo) == 0) && (theFileInfo.st_size >= kHeaderSize))
+		{
+			UInt32 theFileSize = (theFileInfo.st_size > 0x7FFFFFFF) ? 0x7FFFFFFF : static_cast<UInt32>(theFileInfo.st_size);
+			Map(theFileSize);
+		}
+		if((mMapping == NULL) || (GetHeader()->mMagic != kImageMagic) || (GetHeader()->mVersion != kImageVersion) || !IsLayoutValid(mMapping, theNumberSlots))
+		{
+			Format(kInitialSlots, kInitialHeapSize);
+		}
+		else if(GetHeader()->mFileSize > mMapping->mSize)
+		{
+			Map(GetHeader()->mFileSize);
+		}
+		
+		flock(mImageFile, LOCK_UN);
+	}
+}
+
+CASettingsSharedImage::~CASettingsSharedImage()
+{
+	//	there can't be any readers left
+	if(mMapping != NULL)
+	{
+		munmap(mMapping->mBase, mMapping->mSize);
+		delete mMapping;
+	}
+	for(size_t theIndex = 0; theIndex < mRetiredMappings.size(); ++theIndex)
+	{
+		munmap(mRetiredMappings[theIndex]->mBase, mRetiredMappings[theIndex]->mSize);
+		delete mRetiredMappings[theIndex];
+	}
+	
+	if(mProbeFile >= 0)
+	{
+		close(mProbeFile);
+	}
+	if(mImageFile >= 0)
+	{
+		close(mImageFile);
+	}
+	
+	pthread_mutex_destroy(&mUpdateMutex);
+	pthread_mutex_destroy(&mMappingMutex);
+}
+
+CASettingsSharedImage::LookupResult	CASettingsSharedImage::GetNumberKeys(UInt32& outNumberKeys) const
+{
+	outNumberKeys = 0;
+	if(mMapping == NULL)
+	{
+		return kLookup_Unavailable;
+	}
+	
+	while(true)
+	{
+		const Mapping* theMapping = mMapping;
+		const Header* theHeader = reinterpret_cast<const Header*>(theMapping->mBase);
+		
+		SInt32 theSequence;
+		if(!WaitForStableSequence(theMapping, theSequence))
+		{
+			return kLookup_Unavailable;
+		}
+		
+		bool theImageIsPopulated = theHeader->mIsPopulated != 0;
+		UInt32 theNumberKeys = theHeader->mNumberKeys;
+		
+		CAMemoryBarrier();
+		if(theHeader->mSequence == theSequence)
+		{
+			if(!theImageIsPopulated)
+			{
+				return kLookup_Unavailable;
+			}
+			outNumberKeys = theNumberKeys;
+			return kLookup_Found;
+		}
+	}
+}
+
+CASettingsSharedImage::LookupResult	CASettingsSharedImage::FindValue(const char* inKey, UInt32 inKeyLength, Value& outValue) const
+{
+	if(mMapping == NULL)
+	{
+		return kLookup_Unavailable;
+	}
+	
+	UInt32 theHash = HashKey(inKey, inKeyLength);
+	while(true)
+	{
+		const Mapping* theMapping = mMapping;
+		const Header* theHeader = reinterpret_cast<const Header*>(theMapping->mBase);
+		
+		SInt32 theSequence;
+		if(!WaitForStableSequence(theMapping, theSequence))
+		{
+			return kLookup_Unavailable;
+		}
+		
+		//	another process grew the image, so map the rest of it and try again
+		UInt32 theFileSize = theHeader->mFileSize;
+		if(theFileSize > theMapping->mSize)
+		{
+			CAMemoryBarrier();
+			if((theHeader->mSequence == theSequence) && (Map(theFileSize)->mSize < theFileSize))
+			{
+				return kLookup_Unavailable;
+			}
+			continue;
+		}
+		
+		//	copy the value out; nothing read here can be trusted until the sequence is checked again
+		bool theImageIsPopulated = theHeader->mIsPopulated != 0;
+		UInt32 theNumberSlots = 0;
+		bool theLayoutIsValid = IsLayoutValid(theMapping, theNumberSlots);
+		bool theValueWasFound = false;
+		if(theImageIsPopulated && theLayoutIsValid)
+		{
+			bool theSlotWasFound = false;
+			UInt32 theSlotIndex = FindSlot(theMapping, theNumberSlots, theHash, inKey, inKeyLength, theSlotWasFound);
+			if(theSlotWasFound)
+			{
+				Slot theSlot;
+				memcpy(&theSlot, theMapping->mBase + kHeaderSize + theSlotIndex * sizeof(Slot), sizeof(Slot));
+				if(IsValueType(theSlot.mType))
+				{
+					outValue.mType = theSlot.mType;
+					outValue.mScalar = theSlot.mScalar;
+					outValue.mData.clear();
+					if(theSlot.mType == kValueType_Blob)
+					{
+						if(static_cast<UInt64>(theSlot.mDataOffset) + theSlot.mDataLength <= theMapping->mSize)
+						{
+							const Byte* theData = theMapping->mBase + theSlot.mDataOffset;
+							outValue.mData.assign(theData, theData + theSlot.mDataLength);
+							theValueWasFound = true;
+						}
+					}
+					else
+					{
+						theValueWasFound = true;
+					}
+				}
+			}
+		}
+		
+		CAMemoryBarrier();
+		if(theHeader->mSequence == theSequence)
+		{
+			if(!theImageIsPopulated || !theLayoutIsValid)
+			{
+				return kLookup_Unavailable;
+			}
+			return theValueWasFound ? kLookup_Found : kLookup_NotFound;
+		}
+	}
+}
+
+CASettingsSharedImage::LookupResult	CASettingsSharedImage::CopyAllValues(std::vector<Entry>& outEntries) const
+{
+	outEntries.clear();
+	if(mMapping == NULL)
+	{
+		return kLookup_Unavailable;
+	}
+	
+	while(true)
+	{
+		const Mapping* theMapping = mMapping;
+		const Header* theHeader = reinterpret_cast<const Header*>(theMapping->mBase);
+		
+		SInt32 theSequence;
+		if(!WaitForStableSequence(theMapping, theSequence))
+		{
+			return kLookup_Unavailable;
+		}
+		
+		UInt32 theFileSize = theHeader->mFileSize;
+		if(theFileSize > theMapping->mSize)
+		{
+			CAMemoryBarrier();
+			if((theHeader->mSequence == theSequence) && (Map(theFileSize)->mSize < theFileSize))
+			{
+				return kLookup_Unavailable;
+			}
+			continue;
+		}
+		
+		bool theImageIsPopulated = theHeader->mIsPopulated != 0;
+		UInt32 theNumberSlots = 0;
+		bool theLayoutIsValid = IsLayoutValid(theMapping, theNumberSlots);
+		outEntries.clear();
+		if(theImageIsPopulated && theLayoutIsValid)
+		{
+			for(UInt32 theSlotIndex = 0; theSlotIndex < theNumberSlots; ++theSlotIndex)
+			{
+				Slot theSlot;
+				memcpy(&theSlot, theMapping->mBase + kHeaderSize + theSlotIndex * sizeof(Slot), sizeof(Slot));
+				if(!IsValueType(theSlot.mType))
+				{
+					continue;
+				}
+				if(static_cast<UInt64>(theSlot.mKeyOffset) + theSlot.mKeyLength > theMapping->mSize)
+				{
+					continue;
+				}
+				if((theSlot.mType == kValueType_Blob) && (static_cast<UInt64>(theSlot.mDataOffset) + theSlot.mDataLength > theMapping->mSize))
+				{
+					continue;
+				}
+				
+				outEntries.push_back(Entry());
+				Entry& theEntry = outEntries.back();
+				theEntry.mKey.assign(reinterpret_cast<const char*>(theMapping->mBase + theSlot.mKeyOffset), theSlot.mKeyLength);
+				theEntry.mValue.mType = theSlot.mType;
+				theEntry.mValue.mScalar = theSlot.mScalar;
+				if(theSlot.mType == kValueType_Blob)
+				{
+					const Byte* theData = theMapping->mBase + theSlot.mDataOffset;
+					theEntry.mValue.mData.assign(theData, theData + theSlot.mDataLength);
+				}
+			}
+		}
+		
+		CAMemoryBarrier();
+		if(theHeader->mSequence == theSequence)
+		{
+			if(!theImageIsPopulated || !theLayoutIsValid)
+			{
+				outEntries.clear();
+				return kLookup_Unavailable;
+			}
+			return kLookup_Found;
+		}
+	}
+}
+
+void	CASettingsSharedImage::BeginUpdate()
+{
+	pthread_mutex_lock(&mUpdateMutex);
+	if(mMapping == NULL)
+	{
+		return;
+	}
+	
+	//	this blocks until writers in other processes are done
+	flock(mImageFile, LOCK_EX);
+	
+	//	pick up any growth by other processes
+	if(GetHeader()->mFileSize > mMapping->mSize)
+	{
+		Map(GetHeader()->mFileSize);
+	}
+	
+	//	an odd sequence number with the lock free means a writer died part way through, so none
+	//	of the image can be trusted
+	UInt32 theNumberSlots = 0;
+	if(((GetHeader()->mSequence & 1) != 0) || !IsLayoutValid(mMapping, theNumberSlots))
+	{
+		Format(kInitialSlots, kInitialHeapSize);
+	}
+}
+
+void	CASettingsSharedImage::EndUpdate()
+{
+	if(mMapping != NULL)
+	{
+		flock(mImageFile, LOCK_UN);
+	}
+	pthread_mutex_unlock(&mUpdateMutex);
+}
+
+bool	CASettingsSharedImage::IsPopulated() const
+{
+	return (mMapping != NULL) && (GetHeader()->mIsPopulated != 0);
+}
+
+void	CASettingsSharedImage::SetPopulated()
+{
+	if(mMapping != NULL)
+	{
+		BeginWrite();
+		GetHeader()->mIsPopulated = 1;
+		EndWrite();
+	}
+}
+
+void	CASettingsSharedImage::SetValue(const char* inKey, UInt32 inKeyLength, const Value& inValue)
+{
+	if(mMapping == NULL)
+	{
+		return;
+	}
+	if(!IsValueType(inValue.mType))
+	{
+		RemoveValue(inKey, inKeyLength);
+		return;
+	}
+	
+	UInt32 theHash = HashKey(inKey, inKeyLength);
+	bool theSlotWasFound = false;
+	UInt32 theSlotIndex = FindSlot(mMapping, GetHeader()->mNumberSlots, theHash, inKey, inKeyLength, theSlotWasFound);
+	
+	//	work out whether the table and the heap have room
+	Header* theHeader = GetHeader();
+	UInt32 theNewKeyBytes = theSlotWasFound ? 0 : Align8(inKeyLength);
+	UInt32 theNewDataBytes = (inValue.mType == kValueType_Blob) ? Align8(static_cast<UInt32>(inValue.mData.size())) : 0;
+	UInt32 theNumberSlots = theHeader->mNumberSlots;
+	bool theImageNeedsRebuilding = (theSlotIndex == kNoSlot) || (theHeader->mHeapUsed + theNewKeyBytes + theNewDataBytes > theHeader->mHeapSize);
+	if(!theSlotWasFound && ((theHeader->mNumberKeys + theHeader->mNumberRemovedSlots + 1) * 2 > theNumberSlots))
+	{
+		//	keep the table at most half full, counting removed slots, which the rebuild clears
+		while((theHeader->mNumberKeys + 1) * 2 > theNumberSlots)
+		{
+			theNumberSlots *= 2;
+		}
+		theImageNeedsRebuilding = true;
+	}
+	if(theImageNeedsRebuilding)
+	{
+		std::vector<Entry> theEntries;
+		CopyAllValuesWhileUpdating(theEntries);
+		UInt32 theLiveBytes = Align8(inKeyLength) + theNewDataBytes;
+		for(size_t theIndex = 0; theIndex < theEntries.size(); ++theIndex)
+		{
+			theLiveBytes += Align8(static_cast<UInt32>(theEntries[theIndex].mKey.size())) + Align8(static_cast<UInt32>(theEntries[theIndex].mValue.mData.size()));
+		}
+		UInt32 theHeapSize = (2 * theLiveBytes > theHeader->mHeapSize) ? 2 * theLiveBytes : theHeader->mHeapSize;
+		if(!Rebuild(theNumberSlots, theHeapSize, theEntries))
+		{
+			//	send readers back to the settings file until the image can be loaded again
+			BeginWrite();
+			GetHeader()->mIsPopulated = 0;
+			EndWrite();
+			return;
+		}
+		theHeader = GetHeader();
+		theSlotIndex = FindSlot(mMapping, GetHeader()->mNumberSlots, theHash, inKey, inKeyLength, theSlotWasFound);
+	}
+	
+	BeginWrite();
+	Slot& theSlot = reinterpret_cast<Slot*>(mMapping->mBase + kHeaderSize)[theSlotIndex];
+	if(!theSlotWasFound)
+	{
+		if(theSlot.mType == kSlotRemoved)
+		{
+			--theHeader->mNumberRemovedSlots;
+		}
+		++theHeader->mNumberKeys;
+		theSlot.mHash = theHash;
+		theSlot.mKeyOffset = AppendToHeap(inKey, inKeyLength);
+		theSlot.mKeyLength = inKeyLength;
+	}
+	else if(theSlot.mType == kValueType_Blob)
+	{
+		theHeader->mHeapGarbage += Align8(theSlot.mDataLength);
+	}
+	if(inValue.mType == kValueType_Blob)
+	{
+		theSlot.mDataLength = static_cast<UInt32>(inValue.mData.size());
+		theSlot.mDataOffset = AppendToHeap(inValue.mData.empty() ? NULL : &inValue.mData[0], theSlot.mDataLength);
+	}
+	else
+	{
+		theSlot.mDataOffset = 0;
+		theSlot.mDataLength = 0;
+	}
+	theSlot.mScalar = inValue.mScalar;
+	theSlot.mType = inValue.mType;
+	EndWrite();
+}
+
+void	CASettingsSharedImage::RemoveValue(const char* inKey, UInt32 inKeyLength)
+{
+	if(mMapping == NULL)
+	{
+		return;
+	}
+	
+	bool theSlotWasFound = false;
+	UInt32 theSlotIndex = FindSlot(mMapping, GetHeader()->mNumberSlots, HashKey(inKey, inKeyLength), inKey, inKeyLength, theSlotWasFound);
+	if(theSlotWasFound)
+	{
+		Header* theHeader = GetHeader();
+		Slot& theSlot = reinterpret_cast<Slot*>(mMapping->mBase + kHeaderSize)[theSlotIndex];
+		
+		BeginWrite();
+		theHeader->mHeapGarbage += Align8(theSlot.mKeyLength) + Align8(theSlot.mDataLength);
+		--theHeader->mNumberKeys;
+		++theHeader->mNumberRemovedSlots;
+		theSlot.mType = kSlotRemoved;
+		EndWrite();
+	}
+}
+
+void	CASettingsSharedImage::RemoveAllValues()
+{
+	if(mMapping == NULL)
+	{
+		return;
+	}
+	
+	Header* theHeader = GetHeader();
+	BeginWrite();
+	memset(mMapping->mBase + kHeaderSize, 0, theHeader->mNumberSlots * sizeof(Slot));
+	theHeader->mHeapUsed = 0;
+	theHeader->mHeapGarbage = 0;
+	theHeader->mNumberKeys = 0;
+	theHeader->mNumberRemovedSlots = 0;
+	EndWrite();
+}
+
+const CASettingsSharedImage::Mapping*	CASettingsSharedImage::Map(UInt32 inSize) const
+{
+	pthread_mutex_lock(&mMappingMutex);
+	
+	const Mapping* theMapping = mMapping;
+	if((theMapping == NULL) || (theMapping->mSize < inSize))
+	{
+		void* theBase = mmap(NULL, inSize, PROT_READ | PROT_WRITE, MAP_SHARED, mImageFile, 0);
+		if(theBase != MAP_FAILED)
+		{
+			Mapping* theNewMapping = new Mapping;
+			theNewMapping->mBase = static_cast<Byte*>(theBase);
+			theNewMapping->mSize = inSize;
+			
+			//	readers in this process may still be using the old mapping, so it stays mapped
+			if(theMapping != NULL)
+			{
+				mRetiredMappings.push_back(const_cast<Mapping*>(theMapping));
+			}
+			CAMemoryBarrier();
+			mMapping = theNewMapping;
+			theMapping = theNewMapping;
+		}
+	}
+	
+	pthread_mutex_unlock(&mMappingMutex);
+	return theMapping;
+}
+
+void	CASettingsSharedImage::Format(UInt32 inNumberSlots, UInt32 inHeapSize)
+{
+	//	lay out an empty, unpopulated image, keeping the file at least as big as it was
+	UInt32 thePageSize = static_cast<UInt32>(getpagesize());
+	UInt32 theFileSize = kHeaderSize + inNumberSlots * static_cast<UInt32>(sizeof(Slot)) + inHeapSize;
+	theFileSize = (theFileSize + thePageSize - 1) & ~(thePageSize - 1);
+	
+	struct stat theFileInfo;
+	if((fstat(mImageFile, &theFileInfo) == 0) && (theFileInfo.st_size > theFileSize) && (theFileInfo.st_size <= 0x7FFFFFFF))
+	{
+		theFileSize = static_cast<UInt32>(theFileInfo.st_size);
+	}
+	else if(ftruncate(mImageFile, theFileSize) != 0)
+	{
+		return;
+	}
+	if((Map(theFileSize) == NULL) || (mMapping->mSize < theFileSize))
+	{
+		return;
+	}
+	
+	Header* theHeader = GetHeader();
+	BeginWrite();
+	memset(mMapping->mBase + kHeaderSize, 0, inNumberSlots * sizeof(Slot));
+	theHeader->mMagic = kImageMagic;
+	theHeader->mVersion = kImageVersion;
+	theHeader->mIsPopulated = 0;
+	theHeader->mFileSize = theFileSize;
+	theHeader->mNumberSlots = inNumberSlots;
+	theHeader->mHeapOffset = kHeaderSize + inNumberSlots * static_cast<UInt32>(sizeof(Slot));
+	theHeader->mHeapSize = theFileSize - theHeader->mHeapOffset;
+	theHeader->mHeapUsed = 0;
+	theHeader->mHeapGarbage = 0;
+	theHeader->mNumberKeys = 0;
+	theHeader->mNumberRemovedSlots = 0;
+	EndWrite();
+}
+
+bool	CASettingsSharedImage::Rebuild(UInt32 inNumberSlots, UInt32 inHeapSize, const std::vector<Entry>& inEntries)
+{
+	//	grow the file if the new layout needs it
+	UInt32 thePageSize = static_cast<UInt32>(getpagesize());
+	UInt64 theNeededSize = kHeaderSize + static_cast<UInt64>(inNumberSlots) * sizeof(Slot) + inHeapSize;
+	theNeededSize = (theNeededSize + thePageSize - 1) & ~static_cast<UInt64>(thePageSize - 1);
+	if(theNeededSize > 0x7FFFFFFF)
+	{
+		return false;
+	}
+	UInt32 theFileSize = GetHeader()->mFileSize;
+	if(theNeededSize > theFileSize)
+	{
+		theFileSize = static_cast<UInt32>(theNeededSize);
+		if((ftruncate(mImageFile, theFileSize) != 0) || (Map(theFileSize)->mSize < theFileSize))
+		{
+			return false;
+		}
+	}
+	
+	//	lay the entries out again from scratch, which also drops the garbage and removed slots
+	Header* theHeader = GetHeader();
+	Slot* theSlots = reinterpret_cast<Slot*>(mMapping->mBase + kHeaderSize);
+	BeginWrite();
+	theHeader->mNumberSlots = inNumberSlots;
+	theHeader->mHeapOffset = kHeaderSize + inNumberSlots * static_cast<UInt32>(sizeof(Slot));
+	theHeader->mHeapSize = theFileSize - theHeader->mHeapOffset;
+	theHeader->mHeapUsed = 0;
+	theHeader->mHeapGarbage = 0;
+	theHeader->mNumberKeys = 0;
+	theHeader->mNumberRemovedSlots = 0;
+	memset(theSlots, 0, inNumberSlots * sizeof(Slot));
+	for(size_t theIndex = 0; theIndex < inEntries.size(); ++theIndex)
+	{
+		const Entry& theEntry = inEntries[theIndex];
+		UInt32 theKeyLength = static_cast<UInt32>(theEntry.mKey.size());
+		UInt32 theHash = HashKey(theEntry.mKey.data(), theKeyLength);
+		UInt32 theSlotIndex = theHash & (inNumberSlots - 1);
+		while(theSlots[theSlotIndex].mType != kSlotEmpty)
+		{
+			theSlotIndex = (theSlotIndex + 1) & (inNumberSlots - 1);
+		}
+		
+		Slot& theSlot = theSlots[theSlotIndex];
+		theSlot.mHash = theHash;
+		theSlot.mKeyOffset = AppendToHeap(theEntry.mKey.data(), theKeyLength);
+		theSlot.mKeyLength = theKeyLength;
+		theSlot.mDataLength = static_cast<UInt32>(theEntry.mValue.mData.size());
+		theSlot.mDataOffset = theEntry.mValue.mData.empty() ? 0 : AppendToHeap(&theEntry.mValue.mData[0], theSlot.mDataLength);
+		theSlot.mScalar = theEntry.mValue.mScalar;
+		theSlot.mType = theEntry.mValue.mType;
+		++theHeader->mNumberKeys;
+	}
+	theHeader->mFileSize = theFileSize;
+	EndWrite();
+	return true;
+}
+
+void	CASettingsSharedImage::CopyAllValuesWhileUpdating(std::vector<Entry>& outEntries) const
+{
+	//	writers are serialized, so the image can't change underneath this
+	outEntries.clear();
+	const Header* theHeader = GetHeader();
+	const Slot* theSlots = reinterpret_cast<const Slot*>(mMapping->mBase + kHeaderSize);
+	for(UInt32 theSlotIndex = 0; theSlotIndex < theHeader->mNumberSlots; ++theSlotIndex)
+	{
+		const Slot& theSlot = theSlots[theSlotIndex];
+		if(IsValueType(theSlot.mType))
+		{
+			outEntries.push_back(Entry());
+			Entry& theEntry = outEntries.back();
+			theEntry.mKey.assign(reinterpret_cast<const char*>(mMapping->mBase + theSlot.mKeyOffset), theSlot.mKeyLength);
+			theEntry.mValue.mType = theSlot.mType;
+			theEntry.mValue.mScalar = theSlot.mScalar;
+			if(theSlot.mType == kValueType_Blob)
+			{
+				const Byte* theData = mMapping->mBase + theSlot.mDataOffset;
+				theEntry.mValue.mData.assign(theData, theData + theSlot.mDataLength);
+			}
+		}
+	}
+}
+
+bool	CASettingsSharedImage::WaitForStableSequence(const Mapping* inMapping, SInt32& outSequence) const
+{
+	const Header* theHeader = reinterpret_cast<const Header*>(inMapping->mBase);
+	for(UInt32 theSpins = 0; ; ++theSpins)
+	{
+		SInt32 theSequence = theHeader->mSequence;
+		CAMemoryBarrier();
+		if((theSequence & 1) == 0)
+		{
+			outSequence = theSequence;
+			return true;
+		}
+		
+		//	spin briefly, then yield, and now and then check that the writer is still alive:
+		//	writers hold the exclusive lock for as long as the sequence is odd
+		if(theSpins < 64)
+		{
+			continue;
+		}
+		if((theSpins % 1024) == 0)
+		{
+			if(flock(mProbeFile, LOCK_SH | LOCK_NB) == 0)
+			{
+				bool theWriterDied = (theHeader->mSequence & 1) != 0;
+				flock(mProbeFile, LOCK_UN);
+				if(theWriterDied)
+				{
+					return false;
+				}
+			}
+		}
+		sched_yield();
+	}
+}
+
+bool	CASettingsSharedImage::IsLayoutValid(const Mapping* inMapping, UInt32& outNumberSlots)
+{
+	//	the header is read once, so what's checked is what the caller uses even if a writer is
+	//	changing it
+	const Header* theHeader = reinterpret_cast<const Header*>(inMapping->mBase);
+	outNumberSlots = theHeader->mNumberSlots;
+	UInt64 theHeapOffset = kHeaderSize + static_cast<UInt64>(outNumberSlots) * sizeof(Slot);
+	UInt64 theHeapEnd = theHeapOffset + theHeader->mHeapSize;
+	return	(outNumberSlots != 0) && ((outNumberSlots & (outNumberSlots - 1)) == 0) && (theHeapEnd <= inMapping->mSize);
+}
+
+UInt32	CASettingsSharedImage::FindSlot(const Mapping* inMapping, UInt32 inNumberSlots, UInt32 inHash, const char* inKey, UInt32 inKeyLength, bool& outFound)
+{
+	//	Returns the key's slot, or if the key isn't there, the slot a new key should go in, which is
+	//	the first removed slot on the probe sequence or else the empty slot that ends it.
+	//	inNumberSlots must have come from IsLayoutValid; the key offsets are checked here.
+	const Slot* theSlots = reinterpret_cast<const Slot*>(inMapping->mBase + kHeaderSize);
+	UInt32 theMask = inNumberSlots - 1;
+	UInt32 theFreeSlotIndex = kNoSlot;
+	
+	outFound = false;
+	for(UInt32 theProbe = 0; theProbe <= theMask; ++theProbe)
+	{
+		UInt32 theSlotIndex = (inHash + theProbe) & theMask;
+		const Slot& theSlot = theSlots[theSlotIndex];
+		UInt32 theType = theSlot.mType;
+		if(theType == kSlotEmpty)
+		{
+			return (theFreeSlotIndex != kNoSlot) ? theFreeSlotIndex : theSlotIndex;
+		}
+		if(theType == kSlotRemoved)
+		{
+			if(theFreeSlotIndex == kNoSlot)
+			{
+				theFreeSlotIndex = theSlotIndex;
+			}
+			continue;
+		}
+		UInt32 theKeyOffset = theSlot.mKeyOffset;
+		if((theSlot.mHash == inHash) && (theSlot.mKeyLength == inKeyLength) && (static_cast<UInt64>(theKeyOffset) + inKeyLength <= inMapping->mSize) &&
+			(memcmp(inMapping->mBase + theKeyOffset, inKey, inKeyLength) == 0))
+		{
+			outFound = true;
+			return theSlotIndex;
+		}
+	}
+	return theFreeSlotIndex;
+}
+
+UInt32	CASettingsSharedImage::AppendToHeap(const void* inData, UInt32 inLength)
+{
+	//	the caller has made sure there's room
+	Header* theHeader = GetHeader();
+	UInt32 theOffset = theHeader->mHeapOffset + theHeader->mHeapUsed;
+	if(inLength > 0)
+	{
+		memcpy(mMapping->mBase + theOffset, inData, inLength);
+	}
+	theHeader->mHeapUsed += Align8(inLength);
+	return theOffset;
+}
+
+void	CASettingsSharedImage::BeginWrite()
+{
+	//	make the sequence number odd, unless it already is because a dead writer left it that way
+	Header* theHeader = GetHeader();
+	if((theHeader->mSequence & 1) == 0)
+	{
+		CAAtomicIncrement32Barrier(&theHeader->mSequence);
+	}
+}
+
+void	CASettingsSharedImage::EndWrite()
+{
+	CAMemoryBarrier();
+	CAAtomicIncrement32Barrier(&GetHeader()->mSequence);
+}
@@ -0,0 +1,199 @@
+/*
+     File: CASettingsSharedImage.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+#if !defined(__CASettingsSharedImage_h__)
+#define __CASettingsSharedImage_h__
+
+//==================================================================================================
+//	Includes
+//==================================================================================================
+
+//	System Includes
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+//	Standard Library Includes
+#include <pthread.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+//==================================================================================================
+//	CASettingsSharedImage
+//
+//	A key/value image of a settings file, kept in a memory mapped file that every process using
+//	the settings maps shared. It lets CASettingsStorage answer lookups without stat-ing, locking,
+//	reading and re-parsing the settings file.
+//
+//	The image is an open addressed hash table of fixed size slots followed by a heap holding the
+//	key bytes and any value that doesn't fit in a slot. Booleans, integers and floats are stored
+//	in the slot itself; anything else is stored as an opaque blob (CASettingsStorage uses a binary
+//	property list).
+//
+//	Readers never lock. A sequence number in the image header is odd while a writer is changing
+//	the image; a reader copies what it needs out of the image and retries if the sequence number
+//	was odd or changed meanwhile. Every offset read from the image is checked against the mapping
+//	before it is used, so a reader can't fault on a half written image.
+//
+//	Writers, in any process, are serialized with flock on the image file and change only the
+//	slots and heap bytes for the keys they touch. When the table or heap fills, the writer
+//	rebuilds the image, growing the file if need be; the file never shrinks, and readers remap
+//	when they see the header's file size exceed their mapping.
+//
+//	If a writer dies part way through a change, the sequence number stays odd. Readers notice by
+//	finding that they can take a shared lock on the file after all, and report the image as
+//	unavailable; the next writer resets the image and marks it unpopulated.
+//==================================================================================================
+
+class CASettingsSharedImage
+{
+
+//	Types
+public:
+	enum
+	{
+		kValueType_None			= 0,
+		kValueType_Boolean		= 1,	//	mScalar is 0 or 1
+		kValueType_SInt64		= 2,	//	mScalar holds the SInt64
+		kValueType_Float64		= 3,	//	mScalar holds the bits of the Float64
+		kValueType_Blob			= 4		//	mData holds the bytes
+	};
+	
+	struct Value
+	{
+		UInt32				mType;
+		UInt64				mScalar;
+		std::vector<Byte>	mData;
+		
+							Value() : mType(kValueType_None), mScalar(0), mData() {}
+	};
+	
+	struct Entry
+	{
+		std::string			mKey;
+		Value				mValue;
+	};
+	
+	enum LookupResult
+	{
+		kLookup_NotFound,
+		kLookup_Found,
+		kLookup_Unavailable		//	the image can't be read, fall back on the settings file
+	};
+
+//	Construction/Destruction
+public:
+							CASettingsSharedImage(const char* inImageFilePath, mode_t inImageFileAccessMode = 0);
+							~CASettingsSharedImage();
+	
+	bool					IsValid() const { return mMapping != NULL; }
+
+//	Reading
+public:
+	LookupResult			GetNumberKeys(UInt32& outNumberKeys) const;
+	LookupResult			FindValue(const char* inKey, UInt32 inKeyLength, Value& outValue) const;
+	LookupResult			CopyAllValues(std::vector<Entry>& outEntries) const;
+
+//	Writing
+//	All of these must be bracketed by BeginUpdate and EndUpdate, which serialize writers in every
+//	process. While updating, the image can be read directly without retries.
+public:
+	void					BeginUpdate();
+	void					EndUpdate();
+	
+	bool					IsPopulated() const;
+	void					SetPopulated();
+								//	a new (or reset) image is unpopulated until the owner has loaded it,
+								//	and lookups in an unpopulated image return kLookup_Unavailable
+	
+	void					SetValue(const char* inKey, UInt32 inKeyLength, const Value& inValue);
+								//	if the image can't grow to hold the value, it is marked unpopulated
+	void					RemoveValue(const char* inKey, UInt32 inKeyLength);
+	void					RemoveAllValues();
+
+//	Implementation
+private:
+	struct Header;
+	struct Slot;
+	
+	struct Mapping
+	{
+		Byte*				mBase;
+		UInt32				mSize;
+	};
+
+	const Mapping*			Map(UInt32 inSize) const;
+	void					Format(UInt32 inNumberSlots, UInt32 inHeapSize);
+	bool					Rebuild(UInt32 inNumberSlots, UInt32 inHeapSize, const std::vector<Entry>& inEntries);
+	void					CopyAllValuesWhileUpdating(std::vector<Entry>& outEntries) const;
+	bool					WaitForStableSequence(const Mapping* inMapping, SInt32& outSequence) const;
+	static bool				IsLayoutValid(const Mapping* inMapping, UInt32& outNumberSlots);
+	static UInt32			FindSlot(const Mapping* inMapping, UInt32 inNumberSlots, UInt32 inHash, const char* inKey, UInt32 inKeyLength, bool& outFound);
+	UInt32					AppendToHeap(const void* inData, UInt32 inLength);
+	void					BeginWrite();
+	void					EndWrite();
+	
+	Header*					GetHeader() const { return reinterpret_cast<Header*>(mMapping->mBase); }
+
+	int								mImageFile;			//	used for writing, and locked by writers
+	int								mProbeFile;			//	used by readers to check on a stuck writer
+	mode_t							mImageFileAccessMode;
+	mutable const Mapping* volatile	mMapping;
+	mutable std::vector<Mapping*>	mRetiredMappings;	//	a reader may still be using these
+	mutable pthread_mutex_t			mMappingMutex;
+	pthread_mutex_t					mUpdateMutex;		//	flock doesn't serialize threads sharing mImageFile
+
+//	Unimplemented
+private:
+							CASettingsSharedImage(const CASettingsSharedImage&);
+	CASettingsSharedImage&	operator=(const CASettingsSharedImage&);
+
+};
+
+#endif
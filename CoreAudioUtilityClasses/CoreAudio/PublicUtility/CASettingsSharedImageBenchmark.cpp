@@ -0,0 +1,270 @@
+/*
+     File: CASettingsSharedImageBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+//	Benchmark and check for CASettingsSharedImage.
+//
+//	Fills an image with settings, then runs 32 reader processes doing lookups of random keys for
+//	a fixed time, with and without a writer process changing values as fast as it can, and
+//	reports the total lookups per second. For comparison, the readers also run with just the stat
+//	call that CASettingsStorage::RefreshSettings makes on every lookup when the settings are
+//	shared between processes, before it even gets to the lock, the read and the parse.
+//
+//	The writer stores each value as a blob of identical bytes, growing and shrinking it so the
+//	heap fills and the image is rebuilt, and the readers check that they never see a blob with
+//	mixed bytes, which would be a torn read.
+//
+//	Besides POSIX, the image needs CoreAudioTypes.h and CAAtomic.h, which includes
+//	CoreFoundation/CFBase.h and libkern/OSAtomic.h. On Mac OS X:
+//		c++ -O3 -o CASettingsSharedImageBenchmark CASettingsSharedImageBenchmark.cpp CASettingsSharedImage.cpp
+//	Elsewhere those headers must be provided, with -D__COREAUDIO_USE_FLAT_INCLUDES__
+//	-DTARGET_OS_MAC=0 -DTARGET_OS_WIN32=0, and -lpthread added.
+
+#include "CASettingsSharedImage.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+static const int	kNumberReaders	= 32;
+static const int	kNumberKeys		= 256;
+static const double	kSeconds		= 1.0;
+
+enum
+{
+	kMode_Stat,
+	kMode_Image
+};
+
+static double	Now()
+{
+	struct timespec theTime;
+	clock_gettime(CLOCK_MONOTONIC, &theTime);
+	return theTime.tv_sec + 1e-9 * theTime.tv_nsec;
+}
+
+static void	MakeKey(int inIndex, char* outKey, UInt32& outKeyLength)
+{
+	outKeyLength = static_cast<UInt32>(sprintf(outKey, "com.apple.audio.setting.%d", inIndex));
+}
+
+static void	MakeValue(int inIndex, UInt32 inGeneration, CASettingsSharedImage::Value& outValue)
+{
+	//	odd keys are scalars, even keys blobs of one repeated byte
+	if(inIndex & 1)
+	{
+		outValue.mType = CASettingsSharedImage::kValueType_SInt64;
+		outValue.mScalar = inGeneration;
+		outValue.mData.clear();
+	}
+	else
+	{
+		outValue.mType = CASettingsSharedImage::kValueType_Blob;
+		outValue.mScalar = 0;
+		outValue.mData.assign(16 + (inGeneration * 7 + inIndex) % 240, static_cast<Byte>(inGeneration));
+	}
+}
+
+static void	Writer(const char* inImagePath)
+{
+	CASettingsSharedImage theImage(inImagePath);
+	CASettingsSharedImage::Value theValue;
+	char theKey[64];
+	UInt32 theKeyLength;
+	for(UInt32 theGeneration = 1; ; ++theGeneration)
+	{
+		int theIndex = rand() % kNumberKeys;
+		MakeKey(theIndex, theKey, theKeyLength);
+		MakeValue(theIndex, theGeneration, theValue);
+		theImage.BeginUpdate();
+		theImage.SetValue(theKey, theKeyLength, theValue);
+		theImage.EndUpdate();
+	}
+}
+
+static void	Reader(const char* inImagePath, int inMode, int inPipe)
+{
+	srand(getpid());
+	CASettingsSharedImage theImage(inImagePath);
+	CASettingsSharedImage::Value theValue;
+	char theKeys[kNumberKeys][64];
+	UInt32 theKeyLengths[kNumberKeys];
+	for(int theIndex = 0; theIndex < kNumberKeys; ++theIndex)
+	{
+		MakeKey(theIndex, theKeys[theIndex], theKeyLengths[theIndex]);
+	}
+	UInt64 theLookups = 0;
+	UInt64 theErrors = 0;
+	
+	double theEndTime = Now() + kSeconds;
+	while(Now() < theEndTime)
+	{
+		for(int theIteration = 0; theIteration < 1024; ++theIteration)
+		{
+			int theIndex = rand() % kNumberKeys;
+			if(inMode == kMode_Stat)
+			{
+				struct stat theFileInfo;
+				if(stat(inImagePath, &theFileInfo) != 0)
+				{
+					++theErrors;
+				}
+			}
+			else if(theImage.FindValue(theKeys[theIndex], theKeyLengths[theIndex], theValue) != CASettingsSharedImage::kLookup_Found)
+			{
+				++theErrors;
+			}
+			else if(theValue.mType == CASettingsSharedImage::kValueType_Blob)
+			{
+				for(size_t theByte = 1; theByte < theValue.mData.size(); ++theByte)
+				{
+					if(theValue.mData[theByte] != theValue.mData[0])
+					{
+						++theErrors;
+						break;
+					}
+				}
+			}
+			++theLookups;
+		}
+	}
+	
+	UInt64 theResults[2] = { theLookups, theErrors };
+	write(inPipe, theResults, sizeof(theResults));
+	_exit(0);
+}
+
+static bool	Benchmark(const char* inImagePath, int inMode, bool inWithWriter, const char* inName)
+{
+	int thePipe[2];
+	if(pipe(thePipe) != 0)
+	{
+		return false;
+	}
+	
+	pid_t theWriter = 0;
+	if(inWithWriter)
+	{
+		theWriter = fork();
+		if(theWriter == 0)
+		{
+			Writer(inImagePath);
+		}
+	}
+	
+	double theStartTime = Now();
+	for(int theReader = 0; theReader < kNumberReaders; ++theReader)
+	{
+		if(fork() == 0)
+		{
+			Reader(inImagePath, inMode, thePipe[1]);
+		}
+	}
+	
+	UInt64 theLookups = 0;
+	UInt64 theErrors = 0;
+	for(int theReader = 0; theReader < kNumberReaders; ++theReader)
+	{
+		UInt64 theResults[2];
+		if(read(thePipe[0], theResults, sizeof(theResults)) != sizeof(theResults))
+		{
+			return false;
+		}
+		theLookups += theResults[0];
+		theErrors += theResults[1];
+	}
+	double theElapsedTime = Now() - theStartTime;
+	if(theWriter != 0)
+	{
+		kill(theWriter, SIGKILL);
+	}
+	while(wait(NULL) > 0)
+	{
+	}
+	close(thePipe[0]);
+	close(thePipe[1]);
+	
+	printf("%-32s %12.0f lookups/s  %s\n", inName, theLookups / theElapsedTime, (theErrors == 0) ? "ok" : "ERRORS");
+	return theErrors == 0;
+}
+
+int	main()
+{
+	char theImagePath[] = "/tmp/CASettingsSharedImageBenchmark.XXXXXX";
+	int theFile = mkstemp(theImagePath);
+	if(theFile < 0)
+	{
+		return 1;
+	}
+	close(theFile);
+	
+	{
+		CASettingsSharedImage theImage(theImagePath);
+		CASettingsSharedImage::Value theValue;
+		char theKey[64];
+		UInt32 theKeyLength;
+		theImage.BeginUpdate();
+		for(int theIndex = 0; theIndex < kNumberKeys; ++theIndex)
+		{
+			MakeKey(theIndex, theKey, theKeyLength);
+			MakeValue(theIndex, 0, theValue);
+			theImage.SetValue(theKey, theKeyLength, theValue);
+		}
+		theImage.SetPopulated();
+		theImage.EndUpdate();
+	}
+	
+	printf("%d reader processes, %d keys\n", kNumberReaders, kNumberKeys);
+	bool theAnswer = Benchmark(theImagePath, kMode_Stat, false, "stat per lookup");
+	theAnswer = Benchmark(theImagePath, kMode_Image, false, "shared image") && theAnswer;
+	theAnswer = Benchmark(theImagePath, kMode_Image, true, "shared image, busy writer") && theAnswer;
+	
+	unlink(theImagePath);
+	return theAnswer ? 0 : 1;
+}
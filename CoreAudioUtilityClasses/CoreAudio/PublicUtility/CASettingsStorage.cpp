@@ -58,16 +58,166 @@
 #include "CACFDictionary.h"
 #include "CACFDistributedNotification.h"
 #include "CACFNumber.h"
+#include "CASettingsSharedImage.h"
 
 //	Stamdard Library Includes
 #include <string.h>
 #include <sys/fcntl.h>
 
+//==================================================================================================
+//	Shared Image Keys and Values
+//==================================================================================================
+
+namespace
+{
+
+//	the UTF-8 bytes of a key, without allocating for keys of ordinary length
+class CASettingsKey
+{
+
+public:
+						CASettingsKey(CFStringRef inKey)
+						:
+							mBytes(CFStringGetCStringPtr(inKey, kCFStringEncodingUTF8)),
+							mLongBuffer()
+						{
+							if(mBytes == NULL)
+							{
+								char* theBuffer = mBuffer;
+								CFIndex theBufferSize = sizeof(mBuffer);
+								CFIndex theMaximumSize = CFStringGetMaximumSizeForEncoding(CFStringGetLength(inKey), kCFStringEncodingUTF8) + 1;
+								if(theMaximumSize > theBufferSize)
+								{
+									mLongBuffer.resize(theMaximumSize);
+									theBuffer = &mLongBuffer[0];
+									theBufferSize = theMaximumSize;
+								}
+								if(!CFStringGetCString(inKey, theBuffer, theBufferSize, kCFStringEncodingUTF8))
+								{
+									theBuffer[0] = 0;
+								}
+								mBytes = theBuffer;
+							}
+							mLength = static_cast<UInt32>(strlen(mBytes));
+						}
+
+	const char*			GetBytes() const { return mBytes; }
+	UInt32				GetLength() const { return mLength; }
+
+private:
+	const char*			mBytes;
+	UInt32				mLength;
+	char				mBuffer[256];
+	std::vector<char>	mLongBuffer;
+
+};
+
+bool	EncodeSharedImageValue(CFTypeRef inValue, CASettingsSharedImage::Value& outValue)
+{
+	//	booleans and numbers go in the slot, anything else is stored as a binary property list
+	outValue.mData.clear();
+	if(inValue == NULL)
+	{
+		return false;
+	}
+	if(CFGetTypeID(inValue) == CFBooleanGetTypeID())
+	{
+		outValue.mType = CASettingsSharedImage::kValueType_Boolean;
+		outValue.mScalar = CFBooleanGetValue(static_cast<CFBooleanRef>(inValue)) ? 1 : 0;
+		return true;
+	}
+	if(CFGetTypeID(inValue) == CFNumberGetTypeID())
+	{
+		CFNumberRef theNumber = static_cast<CFNumberRef>(inValue);
+		if(CFNumberIsFloatType(theNumber))
+		{
+			Float64 theFloat = 0;
+			CFNumberGetValue(theNumber, kCFNumberFloat64Type, &theFloat);
+			outValue.mType = CASettingsSharedImage::kValueType_Float64;
+			memcpy(&outValue.mScalar, &theFloat, sizeof(theFloat));
+			return true;
+		}
+		SInt64 theInteger = 0;
+		if(CFNumberGetValue(theNumber, kCFNumberSInt64Type, &theInteger))
+		{
+			outValue.mType = CASettingsSharedImage::kValueType_SInt64;
+			outValue.mScalar = static_cast<UInt64>(theInteger);
+			return true;
+		}
+	}
+	CACFData thePropertyListData(CFPropertyListCreateData(NULL, inValue, kCFPropertyListBinaryFormat_v1_0, 0, NULL), true);
+	if(thePropertyListData.GetCFData() == NULL)
+	{
+		return false;
+	}
+	outValue.mType = CASettingsSharedImage::kValueType_Blob;
+	outValue.mScalar = 0;
+	const Byte* theBytes = static_cast<const Byte*>(thePropertyListData.GetDataPtr());
+	outValue.mData.assign(theBytes, theBytes + thePropertyListData.GetSize());
+	return true;
+}
+
+CFTypeRef	CreateSharedImageValue(const CASettingsSharedImage::Value& inValue)
+{
+	CFTypeRef theAnswer = NULL;
+	switch(inValue.mType)
+	{
+		case CASettingsSharedImage::kValueType_Boolean:
+			theAnswer = (inValue.mScalar != 0) ? kCFBooleanTrue : kCFBooleanFalse;
+			CFRetain(theAnswer);
+			break;
+		
+		case CASettingsSharedImage::kValueType_SInt64:
+			{
+				SInt64 theInteger = static_cast<SInt64>(inValue.mScalar);
+				theAnswer = CFNumberCreate(NULL, kCFNumberSInt64Type, &theInteger);
+			}
+			break;
+		
+		case CASettingsSharedImage::kValueType_Float64:
+			{
+				Float64 theFloat;
+				memcpy(&theFloat, &inValue.mScalar, sizeof(theFloat));
+				theAnswer = CFNumberCreate(NULL, kCFNumberFloat64Type, &theFloat);
+			}
+			break;
+		
+		case CASettingsSharedImage::kValueType_Blob:
+			if(!inValue.mData.empty())
+			{
+				//	parse the same way the settings file is parsed
+				CACFData theData(CFDataCreateWithBytesNoCopy(NULL, &inValue.mData[0], static_cast<CFIndex>(inValue.mData.size()), kCFAllocatorNull), true);
+				if(theData.GetCFData() != NULL)
+				{
+					theAnswer = CFPropertyListCreateWithData(NULL, theData.GetCFData(), kCFPropertyListMutableContainersAndLeaves, NULL, NULL);
+				}
+			}
+			break;
+	}
+	return theAnswer;
+}
+
+void	AddToSharedImage(const void* inKey, const void* inValue, void* inSharedImage)
+{
+	CASettingsSharedImage* theSharedImage = static_cast<CASettingsSharedImage*>(inSharedImage);
+	if(CFGetTypeID(inKey) == CFStringGetTypeID())
+	{
+		CASettingsKey theKey(static_cast<CFStringRef>(inKey));
+		CASettingsSharedImage::Value theValue;
+		if(EncodeSharedImageValue(static_cast<CFTypeRef>(inValue), theValue))
+		{
+			theSharedImage->SetValue(theKey.GetBytes(), theKey.GetLength(), theValue);
+		}
+	}
+}
+
+}
+
 //==================================================================================================
 //	CASettingsStorage
 //==================================================================================================
 
-CASettingsStorage::CASettingsStorage(const char* inSettingsFilePath, mode_t inSettingsFileAccessMode, CFPropertyListFormat inSettingsCacheFormat, bool inIsSingleProcessOnly)
+CASettingsStorage::CASettingsStorage(const char* inSettingsFilePath, mode_t inSettingsFileAccessMode, CFPropertyListFormat inSettingsCacheFormat, bool inIsSingleProcessOnly, bool inUseSharedImage)
 :
 	mSettingsFilePath(NULL),
 	mSettingsFileAccessMode(inSettingsFileAccessMode),
@@ -75,7 +225,8 @@ CASettingsStorage::CASettingsStorage(const char* inSettingsFilePath, mode_t inSe
 	mSettingsCacheFormat(inSettingsCacheFormat),
 	mSettingsCacheTime(),
 	mSettingsCacheForceRefresh(true),
-	mIsSingleProcessOnly(inIsSingleProcessOnly)
+	mIsSingleProcessOnly(inIsSingleProcessOnly),
+	mSharedImage(NULL)
 {
 	size_t theLength = strlen(inSettingsFilePath);
 	mSettingsFilePath = new char[theLength + 2];
@@ -85,10 +236,30 @@ CASettingsStorage::CASettingsStorage(const char* inSettingsFilePath, mode_t inSe
 	mSettingsCacheTime.tv_nsec = 0;
 	
 	mSettingsCacheForceRefresh = true;
+	
+	if(inUseSharedImage)
+	{
+		//	open the image, and if it's new, fill it from the settings file
+		CAAutoArrayDelete<char> theImageFilePath(theLength + 7);
+		snprintf(theImageFilePath, theLength + 7, "%s.image", inSettingsFilePath);
+		mSharedImage = new CASettingsSharedImage(theImageFilePath, inSettingsFileAccessMode);
+		if(mSharedImage->IsValid())
+		{
+			BeginSharedImageUpdate();
+			EndSharedImageUpdate();
+		}
+		else
+		{
+			//	without an image, everything goes through the settings file as usual
+			delete mSharedImage;
+			mSharedImage = NULL;
+		}
+	}
 }
 
 CASettingsStorage::~CASettingsStorage()
 {
+	delete mSharedImage;
 	delete[] mSettingsFilePath;
 	
 	if(mSettingsCache != NULL)
@@ -99,6 +270,13 @@ CASettingsStorage::~CASettingsStorage()
 
 UInt32	CASettingsStorage::GetNumberKeys() const
 {
+	//	the shared image knows without looking at the file
+	UInt32 theNumberKeys = 0;
+	if((mSharedImage != NULL) && (mSharedImage->GetNumberKeys(theNumberKeys) == CASettingsSharedImage::kLookup_Found))
+	{
+		return theNumberKeys;
+	}
+	
 	//	make sure our cache is up to date
 	const_cast<CASettingsStorage*>(this)->RefreshSettings();
 
@@ -107,8 +285,11 @@ UInt32	CASettingsStorage::GetNumberKeys() const
 
 void	CASettingsStorage::GetKeys(UInt32 inNumberKeys, UInt32& outNumberKeys, CFStringRef* outKeys) const
 {
-	//	make sure our cache is up to date
-	const_cast<CASettingsStorage*>(this)->RefreshSettings();
+	//	make sure our cache is up to date, from the shared image if there is one
+	if(!const_cast<CASettingsStorage*>(this)->CopySharedImageToCache())
+	{
+		const_cast<CASettingsStorage*>(this)->RefreshSettings();
+	}
 
 	CFDictionaryGetKeysAndValues(mSettingsCache, reinterpret_cast<const void**>(outKeys), NULL);
 	outNumberKeys = inNumberKeys;
@@ -453,6 +634,27 @@ void	CASettingsStorage::CopyDataValue(CFStringRef inKey, CFDataRef& outValue, CF
 
 void	CASettingsStorage::CopyCFTypeValue(CFStringRef inKey, CFTypeRef& outValue, CFTypeRef inDefaultValue) const
 {
+	//	look in the shared image first, falling back on the file only if the image is unavailable
+	if(mSharedImage != NULL)
+	{
+		CASettingsKey theKey(inKey);
+		CASettingsSharedImage::Value theValue;
+		CASettingsSharedImage::LookupResult theResult = mSharedImage->FindValue(theKey.GetBytes(), theKey.GetLength(), theValue);
+		if(theResult != CASettingsSharedImage::kLookup_Unavailable)
+		{
+			outValue = (theResult == CASettingsSharedImage::kLookup_Found) ? CreateSharedImageValue(theValue) : NULL;
+			if(outValue == NULL)
+			{
+				outValue = inDefaultValue;
+				if(outValue != NULL)
+				{
+					CFRetain(outValue);
+				}
+			}
+			return;
+		}
+	}
+	
 	//	make sure our cache is up to date
 	const_cast<CASettingsStorage*>(this)->RefreshSettings();
 
@@ -533,6 +735,9 @@ void	CASettingsStorage::SetDataValue(CFStringRef inKey, CFDataRef inValue)
 
 void	CASettingsStorage::SetCFTypeValue(CFStringRef inKey, CFTypeRef inValue)
 {
+	//	writers in all processes take turns while there's a shared image
+	BeginSharedImageUpdate();
+	
 	//	make sure our cache is up to date
 	RefreshSettings();
 	
@@ -541,10 +746,28 @@ void	CASettingsStorage::SetCFTypeValue(CFStringRef inKey, CFTypeRef inValue)
 	
 	//	write the settings to the file
 	SaveSettings();
+	
+	//	and change just this key in the shared image
+	if(mSharedImage != NULL)
+	{
+		CASettingsKey theKey(inKey);
+		CASettingsSharedImage::Value theValue;
+		if(EncodeSharedImageValue(inValue, theValue))
+		{
+			mSharedImage->SetValue(theKey.GetBytes(), theKey.GetLength(), theValue);
+		}
+		else
+		{
+			mSharedImage->RemoveValue(theKey.GetBytes(), theKey.GetLength());
+		}
+	}
+	EndSharedImageUpdate();
 }
 
 void	CASettingsStorage::RemoveValue(CFStringRef inKey)
 {
+	BeginSharedImageUpdate();
+	
 	//	make sure our cache is up to date
 	RefreshSettings();
 	
@@ -553,10 +776,19 @@ void	CASettingsStorage::RemoveValue(CFStringRef inKey)
 	
 	//	write the settings to the file
 	SaveSettings();
+	
+	if(mSharedImage != NULL)
+	{
+		CASettingsKey theKey(inKey);
+		mSharedImage->RemoveValue(theKey.GetBytes(), theKey.GetLength());
+	}
+	EndSharedImageUpdate();
 }
 
 void	CASettingsStorage::RemoveAllValues()
 {
+	BeginSharedImageUpdate();
+	
 	//	make sure our cache is up to date
 	RefreshSettings();
 	
@@ -565,6 +797,12 @@ void	CASettingsStorage::RemoveAllValues()
 	
 	//	write the settings to the file
 	SaveSettings();
+	
+	if(mSharedImage != NULL)
+	{
+		mSharedImage->RemoveAllValues();
+	}
+	EndSharedImageUpdate();
 }
 
 void	CASettingsStorage::SendNotification(CFStringRef inName, CFDictionaryRef inData, bool inPostToAllSessions) const
@@ -575,6 +813,14 @@ void	CASettingsStorage::SendNotification(CFStringRef inName, CFDictionaryRef inD
 void	CASettingsStorage::ForceRefresh()
 {
 	mSettingsCacheForceRefresh = true;
+	
+	//	the shared image is only reloaded from the file when asked
+	if(mSharedImage != NULL)
+	{
+		mSharedImage->BeginUpdate();
+		LoadSharedImage();
+		mSharedImage->EndUpdate();
+	}
 }
 
 inline bool	operator<(const struct timespec& inX, const struct timespec& inY)
@@ -736,3 +982,80 @@ void	CASettingsStorage::SaveSettings()
 		}
 	}
 }
+
+void	CASettingsStorage::BeginSharedImageUpdate()
+{
+	if(mSharedImage != NULL)
+	{
+		//	this blocks until writers in other processes are done
+		mSharedImage->BeginUpdate();
+		
+		//	fill in a new image, or one left unusable by a writer that failed
+		if(!mSharedImage->IsPopulated())
+		{
+			LoadSharedImage();
+		}
+	}
+}
+
+void	CASettingsStorage::EndSharedImageUpdate()
+{
+	if(mSharedImage != NULL)
+	{
+		mSharedImage->EndUpdate();
+	}
+}
+
+void	CASettingsStorage::LoadSharedImage()
+{
+	//	the caller has begun an update
+	mSettingsCacheForceRefresh = true;
+	RefreshSettings();
+	
+	mSharedImage->RemoveAllValues();
+	CFDictionaryApplyFunction(mSettingsCache, AddToSharedImage, mSharedImage);
+	mSharedImage->SetPopulated();
+}
+
+bool	CASettingsStorage::CopySharedImageToCache()
+{
+	//	replace the cache with the contents of the shared image
+	if(mSharedImage == NULL)
+	{
+		return false;
+	}
+	std::vector<CASettingsSharedImage::Entry> theEntries;
+	if(mSharedImage->CopyAllValues(theEntries) != CASettingsSharedImage::kLookup_Found)
+	{
+		return false;
+	}
+	
+	CFMutableDictionaryRef theSettings = CFDictionaryCreateMutable(NULL, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+	for(size_t theIndex = 0; theIndex < theEntries.size(); ++theIndex)
+	{
+		CFStringRef theKey = CFStringCreateWithBytes(NULL, reinterpret_cast<const UInt8*>(theEntries[theIndex].mKey.data()), static_cast<CFIndex>(theEntries[theIndex].mKey.size()), kCFStringEncodingUTF8, false);
+		CFTypeRef theValue = CreateSharedImageValue(theEntries[theIndex].mValue);
+		if((theKey != NULL) && (theValue != NULL))
+		{
+			CFDictionarySetValue(theSettings, theKey, theValue);
+		}
+		if(theKey != NULL)
+		{
+			CFRelease(theKey);
+		}
+		if(theValue != NULL)
+		{
+			CFRelease(theValue);
+		}
+	}
+	
+	if(mSettingsCache != NULL)
+	{
+		CFRelease(mSettingsCache);
+	}
+	mSettingsCache = theSettings;
+	
+	//	the cache no longer reflects the file, so the next look at the file has to read it
+	mSettingsCacheForceRefresh = true;
+	return true;
+}
@@ -59,8 +59,18 @@
 #include <stdio.h>
 #include <sys/stat.h>
 
+//	Forward Declarations
+class	CASettingsSharedImage;
+
 //==================================================================================================
 //	CASettingsStorage
+//
+//	When inUseSharedImage is true, the settings are also published in a CASettingsSharedImage in
+//	a file next to the settings file, with ".image" appended to its name. Lookups then read the
+//	image without locks or file system calls, and changes update the image incrementally as well
+//	as rewriting the settings file, which remains the persistent copy. Every process sharing the
+//	settings file must then use the shared image, since changes made to the file directly are
+//	only picked up by ForceRefresh.
 //==================================================================================================
 
 class CASettingsStorage
@@ -68,7 +78,7 @@ class CASettingsStorage
 
 //	Construction/Destruction
 public:
-							CASettingsStorage(const char* inSettingsFilePath, mode_t inSettingsFileAccessMode = 0, CFPropertyListFormat inSettingsCacheFormat = kCFPropertyListXMLFormat_v1_0, bool inIsSingleProcessOnly = false);
+							CASettingsStorage(const char* inSettingsFilePath, mode_t inSettingsFileAccessMode = 0, CFPropertyListFormat inSettingsCacheFormat = kCFPropertyListXMLFormat_v1_0, bool inIsSingleProcessOnly = false, bool inUseSharedImage = false);
 							~CASettingsStorage();
 
 //	Operations
@@ -113,6 +123,11 @@ public:
 private:
 	void					RefreshSettings();
 	void					SaveSettings();
+	
+	void					BeginSharedImageUpdate();
+	void					EndSharedImageUpdate();
+	void					LoadSharedImage();
+	bool					CopySharedImageToCache();
 
 	char*					mSettingsFilePath;
 	mode_t					mSettingsFileAccessMode;
@@ -121,6 +136,7 @@ private:
 	struct timespec			mSettingsCacheTime;
 	bool					mSettingsCacheForceRefresh;
 	bool					mIsSingleProcessOnly;
+	CASettingsSharedImage*	mSharedImage;
 
 };
 
@@ -0,0 +1,1036 @@
+/*
+     File: CAWriteBehindFile.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+//==================================================================================================
+//	Includes
+//==================================================================================================
+
+//	Self Include
+#include "CAWriteBehindFile.h"
+
+//	PublicUtility Includes
+#include "CAAtomic.h"
+
+//	Standard Library Includes
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#if defined(__APPLE__)
+	#include <mach/mach_time.h>
+#endif
+
+static const UInt32	kNoBlock				= 0xFFFFFFFF;
+static const UInt32	kMaxCoalescedBlocks		= 16;				//	per system call
+static const UInt64	kShadowWriteInterval	= 1000000000ULL;	//	nanoseconds
+static const UInt64	kWaitInterval			= 10000000ULL;		//	nanoseconds
+
+static UInt64	GetNanos()
+{
+#if defined(__APPLE__)
+	static mach_timebase_info_data_t sTimeBase = { 0, 0 };
+	if(sTimeBase.denom == 0)
+	{
+		mach_timebase_info(&sTimeBase);
+	}
+	return mach_absolute_time() * sTimeBase.numer / sTimeBase.denom;
+#else
+	struct timespec theTime;
+	clock_gettime(CLOCK_MONOTONIC, &theTime);
+	return static_cast<UInt64>(theTime.tv_sec) * 1000000000ULL + theTime.tv_nsec;
+#endif
+}
+
+static void	MakeDeadline(UInt64 inNanos, struct timespec& outDeadline)
+{
+	//	pthread_cond_timedwait uses the wall clock
+	struct timeval theNow;
+	gettimeofday(&theNow, NULL);
+	UInt64 theDeadline = static_cast<UInt64>(theNow.tv_sec) * 1000000000ULL + static_cast<UInt64>(theNow.tv_usec) * 1000ULL + inNanos;
+	outDeadline.tv_sec = static_cast<time_t>(theDeadline / 1000000000ULL);
+	outDeadline.tv_nsec = static_cast<long>(theDeadline % 1000000000ULL);
+}
+
+static bool	WriteVectors(int inFile, SInt64 inPosition, struct iovec* ioVectors, int inNumberVectors)
+{
+	while(inNumberVectors > 0)
+	{
+#if defined(__linux__)
+		ssize_t theWritten = pwritev(inFile, ioVectors, inNumberVectors, inPosition);
+#else
+		ssize_t theWritten = pwrite(inFile, ioVectors[0].iov_base, ioVectors[0].iov_len, inPosition);
+#endif
+		if(theWritten < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		if(theWritten == 0)
+		{
+			return false;
+		}
+		inPosition += theWritten;
+		
+		//	skip what was written
+		size_t theRemaining = static_cast<size_t>(theWritten);
+		while((inNumberVectors > 0) && (theRemaining >= ioVectors[0].iov_len))
+		{
+			theRemaining -= ioVectors[0].iov_len;
+			++ioVectors;
+			--inNumberVectors;
+		}
+		if(inNumberVectors > 0)
+		{
+			ioVectors[0].iov_base = static_cast<Byte*>(ioVectors[0].iov_base) + theRemaining;
+			ioVectors[0].iov_len -= theRemaining;
+		}
+	}
+	return true;
+}
+
+static bool	WriteBytes(int inFile, SInt64 inPosition, const Byte* inData, UInt32 inSize)
+{
+	struct iovec theVector;
+	theVector.iov_base = const_cast<Byte*>(inData);
+	theVector.iov_len = inSize;
+	return WriteVectors(inFile, inPosition, &theVector, 1);
+}
+
+static inline UInt64	Max(UInt64 inA, UInt64 inB)
+{
+	return (inA > inB) ? inA : inB;
+}
+
+//==================================================================================================
+//	CAWriteBehindFile::Metrics
+//==================================================================================================
+
+void	CAWriteBehindFile::Metrics::Reset()
+{
+	mQueueDepth = 0;
+	mMaxQueueDepth = 0;
+	mFreeBlocks = 0;
+	mBytesWritten = 0;
+	mDiskWrites = 0;
+	mWorstDiskWriteNanos = 0;
+	mWorstCallNanos = 0;
+	mDroppedBuffers = 0;
+	mDroppedBytes = 0;
+	mSynchronousWrites = 0;
+	mWriteErrors = 0;
+}
+
+void	CAWriteBehindFile::Metrics::Accumulate(const Metrics& inMetrics)
+{
+	mQueueDepth += inMetrics.mQueueDepth;
+	mMaxQueueDepth = static_cast<UInt32>(Max(mMaxQueueDepth, inMetrics.mMaxQueueDepth));
+	mFreeBlocks += inMetrics.mFreeBlocks;
+	mBytesWritten += inMetrics.mBytesWritten;
+	mDiskWrites += inMetrics.mDiskWrites;
+	mWorstDiskWriteNanos = Max(mWorstDiskWriteNanos, inMetrics.mWorstDiskWriteNanos);
+	mWorstCallNanos = Max(mWorstCallNanos, inMetrics.mWorstCallNanos);
+	mDroppedBuffers += inMetrics.mDroppedBuffers;
+	mDroppedBytes += inMetrics.mDroppedBytes;
+	mSynchronousWrites += inMetrics.mSynchronousWrites;
+	mWriteErrors += inMetrics.mWriteErrors;
+}
+
+//==================================================================================================
+//	CAWriteBehindFile
+//==================================================================================================
+
+CAWriteBehindFile::CAWriteBehindFile(CAWriteBehindEngine& inEngine, const char* inPath, mode_t inAccessMode, UInt32 inBlockSize, UInt32 inNumberBlocks)
+:
+	mEngine(inEngine),
+	mFile(-1),
+	mDirectFile(-1),
+	mCloseOnDelete(true),
+	mIsOpen(false),
+	mBlockMemory(NULL),
+	mShadow(NULL)
+{
+	mFile = open(inPath, O_RDWR | O_CREAT | O_TRUNC, inAccessMode);
+	if(mFile >= 0)
+	{
+		//	a second descriptor for the aligned writes that can bypass the buffer cache
+#if defined(O_DIRECT)
+		mDirectFile = open(inPath, O_WRONLY | O_DIRECT);
+#elif defined(F_NOCACHE)
+		mDirectFile = open(inPath, O_WRONLY);
+		if((mDirectFile >= 0) && (fcntl(mDirectFile, F_NOCACHE, 1) != 0))
+		{
+			close(mDirectFile);
+			mDirectFile = -1;
+		}
+#endif
+		Initialize(inBlockSize, inNumberBlocks);
+	}
+}
+
+CAWriteBehindFile::CAWriteBehindFile(CAWriteBehindEngine& inEngine, int inFile, bool inCloseOnDelete, UInt32 inBlockSize, UInt32 inNumberBlocks)
+:
+	mEngine(inEngine),
+	mFile(inFile),
+	mDirectFile(-1),
+	mCloseOnDelete(inCloseOnDelete),
+	mIsOpen(false),
+	mBlockMemory(NULL),
+	mShadow(NULL)
+{
+	if(mFile >= 0)
+	{
+		Initialize(inBlockSize, inNumberBlocks);
+	}
+}
+
+CAWriteBehindFile::~CAWriteBehindFile()
+{
+	Close();
+	if((mFile >= 0) && mCloseOnDelete)
+	{
+		//	the file opened, but the rest of the set up failed
+		close(mFile);
+	}
+	if(mDirectFile >= 0)
+	{
+		close(mDirectFile);
+	}
+	free(mBlockMemory);
+	free(mShadow);
+}
+
+void	CAWriteBehindFile::Initialize(UInt32 inBlockSize, UInt32 inNumberBlocks)
+{
+	mBlockSize = (inBlockSize < kBlockAlignment) ? static_cast<UInt32>(kBlockAlignment) : ((inBlockSize + kBlockAlignment - 1) & ~(kBlockAlignment - 1));
+	mNumberBlocks = (inNumberBlocks < 2) ? 2 : inNumberBlocks;
+	mFillBlock = kNoBlock;
+	mShadowSequence = 0;
+	mShadowGeneration = 0;
+	mShadowFlushRequested = false;
+	mShadowWrittenGeneration = 0;
+	mShadowWrittenTime = 0;
+	mIsBusy = false;
+	
+	//	the blocks are allocated, and touched so they are resident, before any writing starts
+	void* theMemory = NULL;
+	if(posix_memalign(&theMemory, kBlockAlignment, static_cast<size_t>(mBlockSize) * mNumberBlocks) != 0)
+	{
+		theMemory = NULL;
+	}
+	mBlockMemory = static_cast<Byte*>(theMemory);
+	mShadow = static_cast<Byte*>(calloc(1, kShadowSize));
+	if((mBlockMemory == NULL) || (mShadow == NULL))
+	{
+		return;
+	}
+	memset(mBlockMemory, 0, static_cast<size_t>(mBlockSize) * mNumberBlocks);
+	mBlocks.resize(mNumberBlocks);
+	
+	UInt32 theQueueSize = 1;
+	while(theQueueSize < mNumberBlocks)
+	{
+		theQueueSize <<= 1;
+	}
+	mQueue.resize(theQueueSize);
+	mFreeList.resize(theQueueSize);
+	mQueueMask = theQueueSize - 1;
+	mQueueHead = 0;
+	mQueueTail = 0;
+	for(UInt32 theBlock = 0; theBlock < mNumberBlocks; ++theBlock)
+	{
+		mFreeList[theBlock] = theBlock;
+	}
+	mFreeHead = 0;
+	mFreeTail = mNumberBlocks;
+	
+	//	an existing file is appended to, and its start is the initial shadow
+	struct stat theFileInfo;
+	mSize = (fstat(mFile, &theFileInfo) == 0) ? theFileInfo.st_size : 0;
+	if(mSize > 0)
+	{
+		UInt32 theShadowBytes = (mSize < kShadowSize) ? static_cast<UInt32>(mSize) : static_cast<UInt32>(kShadowSize);
+		if(pread(mFile, mShadow, theShadowBytes, 0) != static_cast<ssize_t>(theShadowBytes))
+		{
+			return;
+		}
+	}
+	
+	mIsOpen = true;
+	mEngine.AddFile(this);
+}
+
+bool	CAWriteBehindFile::Write(const void* inData, UInt32 inSize)
+{
+	if(!mIsOpen)
+	{
+		return false;
+	}
+	
+	UInt64 theStartTime = GetNanos();
+	bool theAnswer = true;
+	const Byte* theData = static_cast<const Byte*>(inData);
+	if(GetNumberBlocksNeeded(inSize) <= GetNumberFreeBlocks())
+	{
+		Append(theData, inSize);
+	}
+	else
+	{
+		//	drop the data, leaving zeros in its place, but keep whatever part of it lies in the
+		//	shadow since that costs nothing
+		++mMetrics.mDroppedBuffers;
+		mMetrics.mDroppedBytes += inSize;
+		WriteShadow(mSize, theData, inSize, false);
+		SkipTo(mSize + inSize);
+		theAnswer = false;
+	}
+	mMetrics.mWorstCallNanos = Max(mMetrics.mWorstCallNanos, GetNanos() - theStartTime);
+	return theAnswer;
+}
+
+bool	CAWriteBehindFile::WriteAt(SInt64 inPosition, const void* inData, UInt32 inSize)
+{
+	if(!mIsOpen || (inPosition < 0))
+	{
+		return false;
+	}
+	
+	UInt64 theStartTime = GetNanos();
+	bool theAnswer = true;
+	const Byte* theData = static_cast<const Byte*>(inData);
+	if(inPosition > mSize)
+	{
+		SkipTo(inPosition);
+	}
+	else if(inPosition < mSize)
+	{
+		//	the part that overwrites what's already there
+		UInt32 thePatchSize = ((mSize - inPosition) < inSize) ? static_cast<UInt32>(mSize - inPosition) : inSize;
+		theAnswer = Patch(inPosition, theData, thePatchSize);
+		theData += thePatchSize;
+		inSize -= thePatchSize;
+	}
+	mMetrics.mWorstCallNanos = Max(mMetrics.mWorstCallNanos, GetNanos() - theStartTime);
+	
+	if(inSize > 0)
+	{
+		theAnswer = Write(theData, inSize) && theAnswer;
+	}
+	return theAnswer;
+}
+
+bool	CAWriteBehindFile::ReadAt(SInt64 inPosition, void* outData, UInt32 inSize, UInt32& outActualSize)
+{
+	outActualSize = 0;
+	if(!mIsOpen || (inPosition < 0))
+	{
+		return false;
+	}
+	if(inPosition >= mSize)
+	{
+		return true;
+	}
+	if((mSize - inPosition) < inSize)
+	{
+		inSize = static_cast<UInt32>(mSize - inPosition);
+	}
+	
+	Byte* theData = static_cast<Byte*>(outData);
+	SInt64 theEnd = inPosition + inSize;
+	SInt64 theFillStart = (mFillBlock != kNoBlock) ? mBlocks[mFillBlock].mBase + mBlocks[mFillBlock].mStart : mSize;
+	
+	//	the bytes between the shadow and the block being filled are read from the disk, once
+	//	the queued blocks have been written
+	SInt64 theDiskStart = (inPosition > kShadowSize) ? inPosition : static_cast<SInt64>(kShadowSize);
+	SInt64 theDiskEnd = (theEnd < theFillStart) ? theEnd : theFillStart;
+	if(theDiskStart < theDiskEnd)
+	{
+		mEngine.WaitUntilWritten(this);
+		
+		Byte* theDestination = theData + (theDiskStart - inPosition);
+		size_t theRemaining = static_cast<size_t>(theDiskEnd - theDiskStart);
+		while(theRemaining > 0)
+		{
+			ssize_t theRead = pread(mFile, theDestination, theRemaining, theDiskStart);
+			if((theRead < 0) && (errno == EINTR))
+			{
+				continue;
+			}
+			if(theRead < 0)
+			{
+				return false;
+			}
+			if(theRead == 0)
+			{
+				//	past the end of the file on disk, which will be extended to mSize at Close
+				memset(theDestination, 0, theRemaining);
+				break;
+			}
+			theDestination += theRead;
+			theDiskStart += theRead;
+			theRemaining -= static_cast<size_t>(theRead);
+		}
+	}
+	
+	//	the rest is in memory
+	if(inPosition < kShadowSize)
+	{
+		UInt32 theShadowEnd = (theEnd < kShadowSize) ? static_cast<UInt32>(theEnd) : static_cast<UInt32>(kShadowSize);
+		memcpy(theData, mShadow + inPosition, theShadowEnd - static_cast<UInt32>(inPosition));
+	}
+	SInt64 theFillCopyStart = (inPosition > theFillStart) ? inPosition : theFillStart;
+	if(theFillCopyStart < kShadowSize)
+	{
+		theFillCopyStart = kShadowSize;
+	}
+	if(theFillCopyStart < theEnd)
+	{
+		memcpy(theData + (theFillCopyStart - inPosition), GetBlockData(mFillBlock) + (theFillCopyStart - mBlocks[mFillBlock].mBase), static_cast<size_t>(theEnd - theFillCopyStart));
+	}
+	
+	outActualSize = inSize;
+	return true;
+}
+
+bool	CAWriteBehindFile::SetSize(SInt64 inSize)
+{
+	if(!mIsOpen || (inSize < 0))
+	{
+		return false;
+	}
+	if(inSize >= mSize)
+	{
+		SkipTo(inSize);
+		return true;
+	}
+	
+	//	shrinking: get everything to the disk and truncate it there
+	QueueFillBlock();
+	mEngine.WaitUntilWritten(this);
+	++mMetrics.mSynchronousWrites;
+	if(ftruncate(mFile, inSize) != 0)
+	{
+		++mMetrics.mWriteErrors;
+		return false;
+	}
+	if(inSize < kShadowSize)
+	{
+		//	the shadow is zero past the end of the file
+		static const Byte kZeros[4096] = { 0 };
+		for(SInt64 thePosition = inSize; thePosition < kShadowSize; thePosition += sizeof(kZeros))
+		{
+			UInt32 theSize = ((kShadowSize - thePosition) < static_cast<SInt64>(sizeof(kZeros))) ? static_cast<UInt32>(kShadowSize - thePosition) : static_cast<UInt32>(sizeof(kZeros));
+			WriteShadow(thePosition, kZeros, theSize, true);
+		}
+	}
+	mSize = inSize;
+	return true;
+}
+
+void	CAWriteBehindFile::Flush(bool inWait)
+{
+	if(mIsOpen)
+	{
+		QueueFillBlock();
+		if(inWait)
+		{
+			mShadowFlushRequested = true;
+			mEngine.WaitUntilWritten(this);
+		}
+	}
+}
+
+bool	CAWriteBehindFile::Close()
+{
+	if(!mIsOpen)
+	{
+		return false;
+	}
+	
+	QueueFillBlock();
+	mEngine.WaitUntilWritten(this);
+	mEngine.RemoveFile(this);
+	mIsOpen = false;
+	
+	//	no writer thread has the file now, so finish it here
+	if(!WriteShadowToDisk())
+	{
+		++mMetrics.mWriteErrors;
+	}
+	if(ftruncate(mFile, mSize) != 0)
+	{
+		++mMetrics.mWriteErrors;
+	}
+	
+	if(mDirectFile >= 0)
+	{
+		close(mDirectFile);
+		mDirectFile = -1;
+	}
+	if(mCloseOnDelete)
+	{
+		close(mFile);
+	}
+	mFile = -1;
+	return mMetrics.mWriteErrors == 0;
+}
+
+void	CAWriteBehindFile::GetMetrics(Metrics& outMetrics) const
+{
+	outMetrics = mMetrics;
+	outMetrics.mQueueDepth = GetQueueDepth();
+	outMetrics.mFreeBlocks = mIsOpen ? GetNumberFreeBlocks() : 0;
+}
+
+//==================================================================================================
+//	CAWriteBehindFile: caller side
+//==================================================================================================
+
+UInt32	CAWriteBehindFile::GetNumberFreeBlocks() const
+{
+	UInt32 theTail = mFreeTail;
+	CAMemoryBarrier();
+	return theTail - mFreeHead;
+}
+
+UInt32	CAWriteBehindFile::GetNumberBlocksNeeded(UInt32 inSize) const
+{
+	//	the room left in the block being filled, then whole blocks from a block boundary, except
+	//	when there is no block being filled, when the first block starts part way in
+	UInt32 theRoom = 0;
+	UInt32 theOffset = static_cast<UInt32>(mSize % mBlockSize);
+	if(mFillBlock != kNoBlock)
+	{
+		theRoom = mBlockSize - mBlocks[mFillBlock].mEnd;
+		theOffset = 0;
+	}
+	if(inSize <= theRoom)
+	{
+		return 0;
+	}
+	UInt64 theRest = static_cast<UInt64>(inSize - theRoom) + theOffset;
+	return static_cast<UInt32>((theRest + mBlockSize - 1) / mBlockSize);
+}
+
+void	CAWriteBehindFile::Append(const Byte* inData, UInt32 inSize)
+{
+	WriteShadow(mSize, inData, inSize, false);
+	
+	SInt64 thePosition = mSize;
+	while(inSize > 0)
+	{
+		if(mFillBlock == kNoBlock)
+		{
+			mFillBlock = mFreeList[mFreeHead & mQueueMask];
+			CAMemoryBarrier();
+			++mFreeHead;
+			
+			Block& theBlock = mBlocks[mFillBlock];
+			theBlock.mBase = thePosition - (thePosition % mBlockSize);
+			theBlock.mStart = static_cast<UInt32>(thePosition - theBlock.mBase);
+			theBlock.mEnd = theBlock.mStart;
+		}
+		
+		Block& theBlock = mBlocks[mFillBlock];
+		UInt32 theSize = ((mBlockSize - theBlock.mEnd) < inSize) ? (mBlockSize - theBlock.mEnd) : inSize;
+		memcpy(GetBlockData(mFillBlock) + theBlock.mEnd, inData, theSize);
+		theBlock.mEnd += theSize;
+		thePosition += theSize;
+		inData += theSize;
+		inSize -= theSize;
+		mSize = thePosition;
+		
+		if(theBlock.mEnd == mBlockSize)
+		{
+			QueueFillBlock();
+		}
+	}
+}
+
+void	CAWriteBehindFile::SkipTo(SInt64 inPosition)
+{
+	//	the bytes skipped over read back as zeros: in the block being filled they are zeroed,
+	//	past it the file is extended at Close, and in the shadow they are already zero
+	if(inPosition <= mSize)
+	{
+		return;
+	}
+	if(mFillBlock != kNoBlock)
+	{
+		Block& theBlock = mBlocks[mFillBlock];
+		if(inPosition < theBlock.mBase + mBlockSize)
+		{
+			UInt32 theEnd = static_cast<UInt32>(inPosition - theBlock.mBase);
+			memset(GetBlockData(mFillBlock) + theBlock.mEnd, 0, theEnd - theBlock.mEnd);
+			theBlock.mEnd = theEnd;
+		}
+		else
+		{
+			QueueFillBlock();
+		}
+	}
+	mSize = inPosition;
+}
+
+void	CAWriteBehindFile::QueueFillBlock()
+{
+	if(mFillBlock == kNoBlock)
+	{
+		return;
+	}
+	mQueue[mQueueTail & mQueueMask] = mFillBlock;
+	mFillBlock = kNoBlock;
+	CAMemoryBarrier();
+	++mQueueTail;
+	
+	UInt32 theDepth = GetQueueDepth();
+	if(theDepth > mMetrics.mMaxQueueDepth)
+	{
+		mMetrics.mMaxQueueDepth = theDepth;
+	}
+}
+
+bool	CAWriteBehindFile::Patch(SInt64 inPosition, const Byte* inData, UInt32 inSize)
+{
+	SInt64 theEnd = inPosition + inSize;
+	
+	//	the shadow is always on the disk eventually
+	if(inPosition < kShadowSize)
+	{
+		UInt32 theShadowSize = (theEnd < kShadowSize) ? inSize : static_cast<UInt32>(kShadowSize - inPosition);
+		WriteShadow(inPosition, inData, theShadowSize, true);
+		inPosition += theShadowSize;
+		inData += theShadowSize;
+		inSize -= theShadowSize;
+	}
+	if(inSize == 0)
+	{
+		return true;
+	}
+	
+	//	as is the block being filled
+	if(mFillBlock != kNoBlock)
+	{
+		Block& theBlock = mBlocks[mFillBlock];
+		SInt64 theFillStart = theBlock.mBase + theBlock.mStart;
+		if(theEnd > theFillStart)
+		{
+			SInt64 theCopyStart = (inPosition > theFillStart) ? inPosition : theFillStart;
+			memcpy(GetBlockData(mFillBlock) + (theCopyStart - theBlock.mBase), inData + (theCopyStart - inPosition), static_cast<size_t>(theEnd - theCopyStart));
+			inSize = static_cast<UInt32>(theCopyStart - inPosition);
+		}
+	}
+	if(inSize == 0)
+	{
+		return true;
+	}
+	
+	//	anything else may be queued, so wait until it's written and then write over it
+	++mMetrics.mSynchronousWrites;
+	mEngine.WaitUntilWritten(this);
+	if(!WriteBytes(mFile, inPosition, inData, inSize))
+	{
+		++mMetrics.mWriteErrors;
+		return false;
+	}
+	return true;
+}
+
+void	CAWriteBehindFile::WriteShadow(SInt64 inPosition, const Byte* inData, UInt32 inSize, bool inIsPatch)
+{
+	if(inPosition >= kShadowSize)
+	{
+		return;
+	}
+	UInt32 theSize = ((kShadowSize - inPosition) < inSize) ? static_cast<UInt32>(kShadowSize - inPosition) : inSize;
+	
+	//	this is the only writer of the shadow, so it never waits
+	++mShadowSequence;
+	CAMemoryBarrier();
+	memcpy(mShadow + inPosition, inData, theSize);
+	CAMemoryBarrier();
+	++mShadowSequence;
+	
+	if(inIsPatch)
+	{
+		++mShadowGeneration;
+	}
+}
+
+//==================================================================================================
+//	CAWriteBehindFile: writer thread side
+//==================================================================================================
+
+UInt32	CAWriteBehindFile::GetQueueDepth() const
+{
+	UInt32 theTail = mQueueTail;
+	CAMemoryBarrier();
+	return theTail - mQueueHead;
+}
+
+bool	CAWriteBehindFile::HasWork(UInt64 inNow) const
+{
+	if(GetQueueDepth() > 0)
+	{
+		return true;
+	}
+	if(mShadowGeneration != mShadowWrittenGeneration)
+	{
+		return mShadowFlushRequested || ((inNow - mShadowWrittenTime) >= kShadowWriteInterval);
+	}
+	return mShadowFlushRequested;
+}
+
+bool	CAWriteBehindFile::IsWritten() const
+{
+	return (GetQueueDepth() == 0) && !mShadowFlushRequested;
+}
+
+void	CAWriteBehindFile::Service(UInt64 inNow)
+{
+	UInt32 theHead = mQueueHead;
+	UInt32 theDepth = GetQueueDepth();
+	if(theDepth > 0)
+	{
+		//	take the run of consecutive blocks at the head of the queue
+		UInt32 theBlocks[kMaxCoalescedBlocks];
+		struct iovec theVectors[kMaxCoalescedBlocks];
+		UInt32 theNumberBlocks = 0;
+		UInt32 theSize = 0;
+		while((theNumberBlocks < theDepth) && (theNumberBlocks < kMaxCoalescedBlocks))
+		{
+			UInt32 theBlockIndex = mQueue[(theHead + theNumberBlocks) & mQueueMask];
+			const Block& theBlock = mBlocks[theBlockIndex];
+			if(theNumberBlocks > 0)
+			{
+				const Block& thePreviousBlock = mBlocks[theBlocks[theNumberBlocks - 1]];
+				if((thePreviousBlock.mEnd != mBlockSize) || (theBlock.mStart != 0) || (theBlock.mBase != thePreviousBlock.mBase + mBlockSize))
+				{
+					break;
+				}
+			}
+			
+			//	the shadow has the latest version of the bytes it covers
+			if(theBlock.mBase + theBlock.mStart < kShadowSize)
+			{
+				SInt64 theShadowEnd = (theBlock.mBase + theBlock.mEnd < kShadowSize) ? theBlock.mBase + theBlock.mEnd : static_cast<SInt64>(kShadowSize);
+				UInt32 theShadowStart = static_cast<UInt32>(theBlock.mBase + theBlock.mStart);
+				CopyShadow(theShadowStart, static_cast<UInt32>(theShadowEnd - theShadowStart), GetBlockData(theBlockIndex) + theBlock.mStart);
+			}
+			
+			theBlocks[theNumberBlocks] = theBlockIndex;
+			theVectors[theNumberBlocks].iov_base = GetBlockData(theBlockIndex) + theBlock.mStart;
+			theVectors[theNumberBlocks].iov_len = theBlock.mEnd - theBlock.mStart;
+			theSize += theBlock.mEnd - theBlock.mStart;
+			++theNumberBlocks;
+		}
+		
+		const Block& theFirstBlock = mBlocks[theBlocks[0]];
+		if(!WriteToDisk(theFirstBlock.mBase + theFirstBlock.mStart, theVectors, static_cast<int>(theNumberBlocks), theSize))
+		{
+			++mMetrics.mWriteErrors;
+		}
+		
+		//	hand the blocks back
+		CAMemoryBarrier();
+		mQueueHead = theHead + theNumberBlocks;
+		UInt32 theFreeTail = mFreeTail;
+		for(UInt32 theIndex = 0; theIndex < theNumberBlocks; ++theIndex)
+		{
+			mFreeList[(theFreeTail + theIndex) & mQueueMask] = theBlocks[theIndex];
+		}
+		CAMemoryBarrier();
+		mFreeTail = theFreeTail + theNumberBlocks;
+	}
+	
+	//	the header goes to the disk lazily, or when someone is waiting for it
+	bool theFlushWasRequested = mShadowFlushRequested;
+	if((mShadowGeneration != mShadowWrittenGeneration) && (theFlushWasRequested || ((inNow - mShadowWrittenTime) >= kShadowWriteInterval)))
+	{
+		if(!WriteShadowToDisk())
+		{
+			++mMetrics.mWriteErrors;
+		}
+		mShadowWrittenTime = inNow;
+	}
+	if(theFlushWasRequested && (GetQueueDepth() == 0))
+	{
+		mShadowFlushRequested = false;
+	}
+}
+
+void	CAWriteBehindFile::CopyShadow(UInt32 inOffset, UInt32 inSize, Byte* outData) const
+{
+	while(true)
+	{
+		UInt32 theSequence = mShadowSequence;
+		if((theSequence & 1) == 0)
+		{
+			CAMemoryBarrier();
+			memcpy(outData, mShadow + inOffset, inSize);
+			CAMemoryBarrier();
+			if(mShadowSequence == theSequence)
+			{
+				return;
+			}
+		}
+		sched_yield();
+	}
+}
+
+bool	CAWriteBehindFile::WriteShadowToDisk()
+{
+	SInt64 theFileSize = mSize;
+	UInt32 theSize = (theFileSize < kShadowSize) ? static_cast<UInt32>(theFileSize) : static_cast<UInt32>(kShadowSize);
+	if(theSize == 0)
+	{
+		return true;
+	}
+	
+	//	copied out, so the caller can go on changing the shadow while it's written
+	UInt32 theGeneration = mShadowGeneration;
+	CAMemoryBarrier();
+	Byte theCopy[kShadowSize];
+	CopyShadow(0, theSize, theCopy);
+	struct iovec theVector;
+	theVector.iov_base = theCopy;
+	theVector.iov_len = theSize;
+	if(!WriteToDisk(0, &theVector, 1, theSize))
+	{
+		return false;
+	}
+	mShadowWrittenGeneration = theGeneration;
+	return true;
+}
+
+bool	CAWriteBehindFile::WriteToDisk(SInt64 inPosition, struct iovec* ioVectors, int inNumberVectors, UInt32 inSize)
+{
+	//	block-aligned runs can bypass the buffer cache, if the file system lets them
+	bool theIsAligned = ((inPosition % kBlockAlignment) == 0) && ((inSize % kBlockAlignment) == 0);
+	for(int theIndex = 0; theIsAligned && (theIndex < inNumberVectors); ++theIndex)
+	{
+		theIsAligned = ((reinterpret_cast<uintptr_t>(ioVectors[theIndex].iov_base) % kBlockAlignment) == 0);
+	}
+	
+	UInt64 theStartTime = GetNanos();
+	bool theAnswer = false;
+	if(theIsAligned && (mDirectFile >= 0))
+	{
+		struct iovec theVectors[kMaxCoalescedBlocks];
+		memcpy(theVectors, ioVectors, inNumberVectors * sizeof(struct iovec));
+		theAnswer = WriteVectors(mDirectFile, inPosition, theVectors, inNumberVectors);
+		if(!theAnswer && (errno == EINVAL))
+		{
+			//	the file system doesn't do direct I/O after all
+			close(mDirectFile);
+			mDirectFile = -1;
+		}
+	}
+	if(!theAnswer)
+	{
+		theAnswer = WriteVectors(mFile, inPosition, ioVectors, inNumberVectors);
+	}
+	UInt64 theDuration = GetNanos() - theStartTime;
+	
+	++mMetrics.mDiskWrites;
+	if(theAnswer)
+	{
+		mMetrics.mBytesWritten += inSize;
+	}
+	mMetrics.mWorstDiskWriteNanos = Max(mMetrics.mWorstDiskWriteNanos, theDuration);
+	return theAnswer;
+}
+
+//==================================================================================================
+//	CAWriteBehindEngine
+//==================================================================================================
+
+CAWriteBehindEngine::CAWriteBehindEngine(UInt32 inNumberWriterThreads, UInt32 inPollIntervalMicroseconds)
+:
+	mThreads(),
+	mFiles(),
+	mNextFile(0),
+	mPollInterval(inPollIntervalMicroseconds),
+	mIsStopping(false)
+{
+	pthread_mutex_init(&mMutex, NULL);
+	pthread_cond_init(&mWorkCondition, NULL);
+	pthread_cond_init(&mWrittenCondition, NULL);
+	
+	if(inNumberWriterThreads == 0)
+	{
+		inNumberWriterThreads = 1;
+	}
+	for(UInt32 theIndex = 0; theIndex < inNumberWriterThreads; ++theIndex)
+	{
+		pthread_t theThread;
+		if(pthread_create(&theThread, NULL, WriterThreadEntry, this) == 0)
+		{
+			mThreads.push_back(theThread);
+		}
+	}
+}
+
+CAWriteBehindEngine::~CAWriteBehindEngine()
+{
+	pthread_mutex_lock(&mMutex);
+	mIsStopping = true;
+	pthread_cond_broadcast(&mWorkCondition);
+	pthread_mutex_unlock(&mMutex);
+	for(size_t theIndex = 0; theIndex < mThreads.size(); ++theIndex)
+	{
+		pthread_join(mThreads[theIndex], NULL);
+	}
+	
+	pthread_cond_destroy(&mWrittenCondition);
+	pthread_cond_destroy(&mWorkCondition);
+	pthread_mutex_destroy(&mMutex);
+}
+
+void	CAWriteBehindEngine::GetMetrics(CAWriteBehindFile::Metrics& outMetrics) const
+{
+	outMetrics.Reset();
+	pthread_mutex_lock(&mMutex);
+	for(size_t theIndex = 0; theIndex < mFiles.size(); ++theIndex)
+	{
+		CAWriteBehindFile::Metrics theMetrics;
+		mFiles[theIndex]->GetMetrics(theMetrics);
+		outMetrics.Accumulate(theMetrics);
+	}
+	pthread_mutex_unlock(&mMutex);
+}
+
+void	CAWriteBehindEngine::AddFile(CAWriteBehindFile* inFile)
+{
+	pthread_mutex_lock(&mMutex);
+	mFiles.push_back(inFile);
+	pthread_mutex_unlock(&mMutex);
+}
+
+void	CAWriteBehindEngine::RemoveFile(CAWriteBehindFile* inFile)
+{
+	pthread_mutex_lock(&mMutex);
+	for(size_t theIndex = 0; theIndex < mFiles.size(); ++theIndex)
+	{
+		if(mFiles[theIndex] == inFile)
+		{
+			mFiles.erase(mFiles.begin() + theIndex);
+			break;
+		}
+	}
+	while(inFile->mIsBusy)
+	{
+		pthread_cond_wait(&mWrittenCondition, &mMutex);
+	}
+	pthread_mutex_unlock(&mMutex);
+}
+
+void	CAWriteBehindEngine::WaitUntilWritten(CAWriteBehindFile* inFile)
+{
+	pthread_mutex_lock(&mMutex);
+	while(inFile->mIsBusy || !inFile->IsWritten())
+	{
+		pthread_cond_signal(&mWorkCondition);
+		struct timespec theDeadline;
+		MakeDeadline(kWaitInterval, theDeadline);
+		pthread_cond_timedwait(&mWrittenCondition, &mMutex, &theDeadline);
+	}
+	pthread_mutex_unlock(&mMutex);
+}
+
+CAWriteBehindFile*	CAWriteBehindEngine::ClaimFile(UInt64 inNow)
+{
+	//	called with mMutex held, starting where the last search left off so every file gets a turn
+	size_t theNumberFiles = mFiles.size();
+	for(size_t theCount = 0; theCount < theNumberFiles; ++theCount)
+	{
+		CAWriteBehindFile* theFile = mFiles[(mNextFile + theCount) % theNumberFiles];
+		if(!theFile->mIsBusy && theFile->HasWork(inNow))
+		{
+			theFile->mIsBusy = true;
+			mNextFile = (mNextFile + theCount + 1) % theNumberFiles;
+			return theFile;
+		}
+	}
+	return NULL;
+}
+
+void	CAWriteBehindEngine::WriterThread()
+{
+	pthread_mutex_lock(&mMutex);
+	while(!mIsStopping)
+	{
+		UInt64 theNow = GetNanos();
+		CAWriteBehindFile* theFile = ClaimFile(theNow);
+		if(theFile == NULL)
+		{
+			struct timespec theDeadline;
+			MakeDeadline(static_cast<UInt64>(mPollInterval) * 1000ULL, theDeadline);
+			pthread_cond_timedwait(&mWorkCondition, &mMutex, &theDeadline);
+			continue;
+		}
+		
+		pthread_mutex_unlock(&mMutex);
+		theFile->Service(theNow);
+		pthread_mutex_lock(&mMutex);
+		
+		theFile->mIsBusy = false;
+		pthread_cond_broadcast(&mWrittenCondition);
+	}
+	pthread_mutex_unlock(&mMutex);
+}
+
+void*	CAWriteBehindEngine::WriterThreadEntry(void* inEngine)
+{
+	static_cast<CAWriteBehindEngine*>(inEngine)->WriterThread();
+	return NULL;
+}
@@ -0,0 +1,285 @@
+/*
+     File: CAWriteBehindFile.h 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+#if !defined(__CAWriteBehindFile_h__)
+#define __CAWriteBehindFile_h__
+
+//==================================================================================================
+//	Includes
+//==================================================================================================
+
+//	System Includes
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+//	Standard Library Includes
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+
+class CAWriteBehindEngine;
+
+//==================================================================================================
+//	CAWriteBehindFile
+//
+//	A file written from a thread that must never wait for the disk, such as a capture thread or
+//	an IOProc. Appended data is copied into large preallocated blocks, and full blocks are handed
+//	through a lock-free queue to the writer threads of a CAWriteBehindEngine, which write runs of
+//	consecutive blocks with one system call and hand the blocks back through a second lock-free
+//	queue. When no block is free, the data of that call is dropped; the file keeps its length, so
+//	the dropped bytes read back as zeros (silence, for linear PCM) and everything after them stays
+//	where it belongs.
+//
+//	Blocks are aligned in memory and in the file, so on systems that have it full blocks bypass
+//	the buffer cache (O_DIRECT on Linux, F_NOCACHE on Mac OS X) and don't evict everything else
+//	while a long recording streams out. This is only done when the file is opened by path.
+//
+//	Audio file headers are rewritten in place as the file grows. Writes below the end of the
+//	file that fall in the first kShadowSize bytes go to a copy of the start of the file that the
+//	caller owns; the writer threads put it on disk lazily, at most every kShadowWriteInterval, and
+//	it is overlaid on any block covering the same bytes, so the disk always ends up with the
+//	latest header. Writes below the end of the file past the shadow are rare (a seek back into
+//	the audio data). They wait until the queued blocks are written and then write synchronously,
+//	and are counted in the metrics.
+//
+//	Write, WriteAt, ReadAt, SetSize, Flush and Close must not be called concurrently, which is
+//	how AudioFile and ExtAudioFile call their data sources anyway. GetMetrics can be called from
+//	any thread at any time.
+//==================================================================================================
+
+class CAWriteBehindFile
+{
+
+//	Types
+public:
+	enum
+	{
+		kDefaultBlockSize		= 256 * 1024,
+		kDefaultNumberBlocks	= 32,
+		kBlockAlignment			= 4096,			//	block sizes are rounded up to this
+		kShadowSize				= 64 * 1024
+	};
+	
+	struct Metrics
+	{
+		UInt32				mQueueDepth;			//	filled blocks waiting for a writer thread
+		UInt32				mMaxQueueDepth;
+		UInt32				mFreeBlocks;
+		UInt64				mBytesWritten;			//	to the disk, including header updates
+		UInt64				mDiskWrites;			//	system calls
+		UInt64				mWorstDiskWriteNanos;	//	longest single write system call
+		UInt64				mWorstCallNanos;		//	longest the caller spent in Write or WriteAt
+		UInt64				mDroppedBuffers;		//	Write calls that found too few free blocks
+		UInt64				mDroppedBytes;
+		UInt64				mSynchronousWrites;		//	writes that had to wait for the disk
+		UInt64				mWriteErrors;
+		
+							Metrics() { Reset(); }
+		void				Reset();
+		void				Accumulate(const Metrics& inMetrics);
+	};
+
+//	Construction/Destruction
+public:
+							CAWriteBehindFile(CAWriteBehindEngine& inEngine, const char* inPath, mode_t inAccessMode = 0644, UInt32 inBlockSize = kDefaultBlockSize, UInt32 inNumberBlocks = kDefaultNumberBlocks);
+								//	creates the file, or truncates it if it exists
+							CAWriteBehindFile(CAWriteBehindEngine& inEngine, int inFile, bool inCloseOnDelete, UInt32 inBlockSize = kDefaultBlockSize, UInt32 inNumberBlocks = kDefaultNumberBlocks);
+								//	appends to an open file, which must be readable and writable
+							~CAWriteBehindFile();
+	
+	bool					IsValid() const { return mIsOpen; }
+
+//	Operations
+public:
+	bool					Write(const void* inData, UInt32 inSize);
+								//	appends, returns false if the data was dropped
+	bool					WriteAt(SInt64 inPosition, const void* inData, UInt32 inSize);
+	bool					ReadAt(SInt64 inPosition, void* outData, UInt32 inSize, UInt32& outActualSize);
+								//	waits for the disk if the bytes aren't in memory
+	SInt64					GetSize() const { return mSize; }
+	bool					SetSize(SInt64 inSize);
+								//	growing is free, shrinking waits for the disk
+	void					Flush(bool inWait);
+								//	queues the partly filled block, and if asked, waits until
+								//	it and the header are on disk
+	bool					Close();
+								//	waits for everything to be written, returns false if
+								//	anything couldn't be
+	
+	void					GetMetrics(Metrics& outMetrics) const;
+
+//	Implementation
+private:
+	friend class CAWriteBehindEngine;
+	
+	struct Block
+	{
+		SInt64				mBase;					//	file offset of the start of the block
+		UInt32				mStart;					//	the valid bytes
+		UInt32				mEnd;
+	};
+	
+	void					Initialize(UInt32 inBlockSize, UInt32 inNumberBlocks);
+	Byte*					GetBlockData(UInt32 inBlock) const { return mBlockMemory + static_cast<size_t>(inBlock) * mBlockSize; }
+	
+	//	caller side
+	UInt32					GetNumberFreeBlocks() const;
+	UInt32					GetNumberBlocksNeeded(UInt32 inSize) const;
+	void					Append(const Byte* inData, UInt32 inSize);
+	void					SkipTo(SInt64 inPosition);
+	void					QueueFillBlock();
+	bool					Patch(SInt64 inPosition, const Byte* inData, UInt32 inSize);
+	void					WriteShadow(SInt64 inPosition, const Byte* inData, UInt32 inSize, bool inIsPatch);
+	
+	//	writer thread side
+	UInt32					GetQueueDepth() const;
+	bool					HasWork(UInt64 inNow) const;
+	bool					IsWritten() const;
+	void					Service(UInt64 inNow);
+	void					CopyShadow(UInt32 inOffset, UInt32 inSize, Byte* outData) const;
+	bool					WriteShadowToDisk();
+	bool					WriteToDisk(SInt64 inPosition, struct iovec* ioVectors, int inNumberVectors, UInt32 inSize);
+
+	CAWriteBehindEngine&	mEngine;
+	int						mFile;
+	int						mDirectFile;			//	-1 if the system can't bypass the buffer cache
+	bool					mCloseOnDelete;
+	bool					mIsOpen;
+	
+	UInt32					mBlockSize;
+	UInt32					mNumberBlocks;
+	Byte*					mBlockMemory;
+	std::vector<Block>		mBlocks;
+	
+	//	both queues hold block indices and have room for every block
+	std::vector<UInt32>		mQueue;					//	filled blocks, caller to writer thread
+	std::vector<UInt32>		mFreeList;				//	written blocks, writer thread to caller
+	UInt32					mQueueMask;
+	volatile UInt32			mQueueHead;				//	advanced by the writer thread
+	volatile UInt32			mQueueTail;				//	advanced by the caller
+	volatile UInt32			mFreeHead;				//	advanced by the caller
+	volatile UInt32			mFreeTail;				//	advanced by the writer thread
+	
+	//	caller side state
+	volatile SInt64			mSize;
+	UInt32					mFillBlock;				//	the block being filled, or kNoBlock
+	
+	//	the start of the file, seqlocked: the caller writes it, writer threads copy it
+	Byte*					mShadow;
+	volatile UInt32			mShadowSequence;		//	odd while the caller is writing
+	volatile UInt32			mShadowGeneration;		//	counts header writes
+	volatile bool			mShadowFlushRequested;
+	UInt32					mShadowWrittenGeneration;
+	UInt64					mShadowWrittenTime;
+	
+	//	guarded by the engine's mutex
+	bool					mIsBusy;				//	a writer thread is servicing the file
+	
+	Metrics					mMetrics;				//	each field is changed by only one side
+
+//	Unimplemented
+private:
+							CAWriteBehindFile(const CAWriteBehindFile&);
+	CAWriteBehindFile&		operator=(const CAWriteBehindFile&);
+
+};
+
+//==================================================================================================
+//	CAWriteBehindEngine
+//
+//	The writer threads shared by any number of CAWriteBehindFiles. Callers writing files never
+//	signal the writer threads, since that could block them; instead idle writer threads look for
+//	work every poll interval, and a busy one goes straight on to the next file that has filled
+//	blocks. Threads that are waiting for a file to be written (Flush, Close, or a synchronous
+//	write) do wake them.
+//==================================================================================================
+
+class CAWriteBehindEngine
+{
+
+//	Construction/Destruction
+public:
+							CAWriteBehindEngine(UInt32 inNumberWriterThreads = 2, UInt32 inPollIntervalMicroseconds = 2000);
+							~CAWriteBehindEngine();
+								//	all the files must have been closed
+
+//	Operations
+public:
+	void					GetMetrics(CAWriteBehindFile::Metrics& outMetrics) const;
+								//	summed over the open files, maxima are the largest of them
+
+//	Implementation
+private:
+	friend class CAWriteBehindFile;
+	
+	void					AddFile(CAWriteBehindFile* inFile);
+	void					RemoveFile(CAWriteBehindFile* inFile);
+	void					WaitUntilWritten(CAWriteBehindFile* inFile);
+	CAWriteBehindFile*		ClaimFile(UInt64 inNow);
+	void					WriterThread();
+	static void*			WriterThreadEntry(void* inEngine);
+
+	std::vector<pthread_t>			mThreads;
+	std::vector<CAWriteBehindFile*>	mFiles;
+	size_t							mNextFile;			//	where the next search for work starts
+	UInt32							mPollInterval;
+	bool							mIsStopping;
+	mutable pthread_mutex_t			mMutex;
+	pthread_cond_t					mWorkCondition;		//	signaled by threads waiting on a file
+	pthread_cond_t					mWrittenCondition;	//	broadcast when a writer thread finishes with a file
+
+//	Unimplemented
+private:
+							CAWriteBehindEngine(const CAWriteBehindEngine&);
+	CAWriteBehindEngine&	operator=(const CAWriteBehindEngine&);
+
+};
+
+#endif
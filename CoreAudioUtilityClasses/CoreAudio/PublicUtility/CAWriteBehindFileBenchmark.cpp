@@ -0,0 +1,348 @@
+/*
+     File: CAWriteBehindFileBenchmark.cpp 
+ Abstract:  Part of CoreAudio Utility Classes  
+  Version: 1.0.4 
+  
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple 
+ Inc. ("Apple") in consideration of your agreement to the following 
+ terms, and your use, installation, modification or redistribution of 
+ this Apple software constitutes acceptance of these terms.  If you do 
+ not agree with these terms, please do not use, install, modify or 
+ redistribute this Apple software. 
+  
+ In consideration of your agreement to abide by the following terms, and 
+ subject to these terms, Apple grants you a personal, non-exclusive 
+ license, under Apple's copyrights in this original Apple software (the 
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple 
+ Software, with or without modifications, in source and/or binary forms; 
+ provided that if you redistribute the Apple Software in its entirety and 
+ without modifications, you must retain this notice and the following 
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. may 
+ be used to endorse or promote products derived from the Apple Software 
+ without specific prior written permission from Apple.  Except as 
+ expressly stated in this notice, no other rights or licenses, express or 
+ implied, are granted by Apple herein, including but not limited to any 
+ patent rights that may be infringed by your derivative works or by other 
+ works in which the Apple Software may be incorporated. 
+  
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE 
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION 
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND 
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS. 
+  
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL 
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, 
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED 
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE), 
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+  
+ Copyright (C) 2013 Apple Inc. All Rights Reserved. 
+  
+*/
+//	Benchmark and check for CAWriteBehindFile.
+//
+//	Simulates a capture thread recording a number of tracks: every I/O cycle it appends one
+//	buffer to each track's file and rewrites the file's header with the new length, the way
+//	AudioFile does. The disk is made slow by interposing pwrite and pwritev with versions that
+//	sleep for a fixed latency plus the transfer time at a given bandwidth, with an occasional
+//	long stall, one write at a time. Each disk model is run writing synchronously from the capture thread, and then
+//	through CAWriteBehindFile, and reports the worst time the capture thread spent writing in
+//	one cycle, the number of cycles that overran, the deepest queue, the worst disk write and
+//	the dropped buffers. Finally each file is read back and checked: every buffer must be
+//	either intact or, if it was dropped, zeros, and the header must hold the final length.
+//
+//	Besides POSIX, CAWriteBehindFile needs CoreAudioTypes.h and CAAtomic.h, which includes
+//	CoreFoundation/CFBase.h and libkern/OSAtomic.h. On Mac OS X:
+//		c++ -O3 -o CAWriteBehindFileBenchmark CAWriteBehindFileBenchmark.cpp CAWriteBehindFile.cpp
+//	Elsewhere those headers must be provided, with -D__COREAUDIO_USE_FLAT_INCLUDES__
+//	-DTARGET_OS_MAC=0 -DTARGET_OS_WIN32=0, and -ldl -lpthread added.
+
+#include "CAWriteBehindFile.h"
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <vector>
+
+static const int	kNumberTracks		= 8;
+static const UInt32	kBufferSize			= 4096;				//	512 frames of stereo Float32
+static const double	kCycleSeconds		= 512.0 / 48000.0;
+static const int	kNumberCycles		= 300;				//	3.2 seconds of audio
+static const UInt32	kHeaderSize			= 44;
+
+struct DiskModel
+{
+	const char*		mName;
+	double			mLatency;			//	seconds per write
+	double			mBandwidth;			//	bytes per second, 0 for unlimited
+	int				mStallEvery;		//	writes, 0 for never
+	double			mStallSeconds;
+};
+
+static const DiskModel	kDiskModels[] =
+{
+	{ "fast",			0.0,		0.0,				0,		0.0 },
+	{ "slow",			0.002,		40.0e6,				0,		0.0 },
+	{ "stalling",		0.001,		80.0e6,				50,		0.250 },
+	{ "overloaded",		0.002,		1.5e6,				0,		0.0 }	//	half what the tracks need
+};
+
+static const DiskModel*	sDiskModel = NULL;
+static volatile int		sDiskWrites = 0;
+static pthread_mutex_t	sDiskMutex = PTHREAD_MUTEX_INITIALIZER;	//	the disk does one write at a time
+
+static double	Now()
+{
+	struct timespec theTime;
+	clock_gettime(CLOCK_MONOTONIC, &theTime);
+	return theTime.tv_sec + 1e-9 * theTime.tv_nsec;
+}
+
+static void	Sleep(double inSeconds)
+{
+	if(inSeconds > 0)
+	{
+		struct timespec theTime;
+		theTime.tv_sec = static_cast<time_t>(inSeconds);
+		theTime.tv_nsec = static_cast<long>((inSeconds - theTime.tv_sec) * 1e9);
+		nanosleep(&theTime, NULL);
+	}
+}
+
+static void	SimulateDisk(size_t inSize)
+{
+	if(sDiskModel != NULL)
+	{
+		double theDelay = sDiskModel->mLatency;
+		if(sDiskModel->mBandwidth > 0)
+		{
+			theDelay += inSize / sDiskModel->mBandwidth;
+		}
+		int theWrite = __sync_add_and_fetch(&sDiskWrites, 1);
+		if((sDiskModel->mStallEvery > 0) && ((theWrite % sDiskModel->mStallEvery) == 0))
+		{
+			theDelay += sDiskModel->mStallSeconds;
+		}
+		pthread_mutex_lock(&sDiskMutex);
+		Sleep(theDelay);
+		pthread_mutex_unlock(&sDiskMutex);
+	}
+}
+
+//	the slow disk, interposed on the system calls
+extern "C" ssize_t	pwrite(int inFile, const void* inData, size_t inSize, off_t inPosition)
+{
+	typedef ssize_t (*PWriteProc)(int, const void*, size_t, off_t);
+	static PWriteProc sPWrite = reinterpret_cast<PWriteProc>(dlsym(RTLD_NEXT, "pwrite"));
+	SimulateDisk(inSize);
+	return sPWrite(inFile, inData, inSize, inPosition);
+}
+
+#if defined(__linux__)
+extern "C" ssize_t	pwritev(int inFile, const struct iovec* inVectors, int inNumberVectors, off_t inPosition)
+{
+	typedef ssize_t (*PWriteVProc)(int, const struct iovec*, int, off_t);
+	static PWriteVProc sPWriteV = reinterpret_cast<PWriteVProc>(dlsym(RTLD_NEXT, "pwritev"));
+	size_t theSize = 0;
+	for(int theIndex = 0; theIndex < inNumberVectors; ++theIndex)
+	{
+		theSize += inVectors[theIndex].iov_len;
+	}
+	SimulateDisk(theSize);
+	return sPWriteV(inFile, inVectors, inNumberVectors, inPosition);
+}
+#endif
+
+static inline Byte	PatternByte(int inTrack, SInt64 inPosition)
+{
+	return static_cast<Byte>((inPosition * 131 + (inPosition >> 12) * 7 + inTrack * 29) | 1);
+}
+
+static void	MakeHeader(UInt32 inDataSize, Byte* outHeader)
+{
+	memset(outHeader, 0, kHeaderSize);
+	memcpy(outHeader, "RIFF", 4);
+	UInt32 theRIFFSize = inDataSize + kHeaderSize - 8;
+	memcpy(outHeader + 4, &theRIFFSize, 4);
+	memcpy(outHeader + 8, "WAVEfmt ", 8);
+	memcpy(outHeader + 36, "data", 4);
+	memcpy(outHeader + 40, &inDataSize, 4);
+}
+
+static void	MakeFilePath(const char* inDirectory, int inTrack, char* outPath)
+{
+	sprintf(outPath, "%s/CAWriteBehindFileBenchmark.%d.wav", inDirectory, inTrack);
+}
+
+//	returns the number of buffers found zeroed, or -1 if the file is wrong
+static int	CheckFile(const char* inPath, int inTrack)
+{
+	int theFile = open(inPath, O_RDONLY);
+	if(theFile < 0)
+	{
+		return -1;
+	}
+	//	one byte more than there should be, to catch a file that's too long
+	std::vector<Byte> theData(kHeaderSize + kNumberCycles * kBufferSize + 1);
+	ssize_t theSize = read(theFile, &theData[0], theData.size());
+	close(theFile);
+	if(theSize != static_cast<ssize_t>(theData.size() - 1))
+	{
+		return -1;
+	}
+	
+	Byte theHeader[kHeaderSize];
+	MakeHeader(kNumberCycles * kBufferSize, theHeader);
+	if(memcmp(&theData[0], theHeader, kHeaderSize) != 0)
+	{
+		return -1;
+	}
+	int theNumberZeroed = 0;
+	for(int theCycle = 0; theCycle < kNumberCycles; ++theCycle)
+	{
+		SInt64 theStart = kHeaderSize + static_cast<SInt64>(theCycle) * kBufferSize;
+		bool theIsIntact = true;
+		bool theIsZero = true;
+		for(UInt32 theIndex = 0; theIndex < kBufferSize; ++theIndex)
+		{
+			Byte theByte = theData[theStart + theIndex];
+			theIsIntact = theIsIntact && (theByte == PatternByte(inTrack, theStart + theIndex));
+			theIsZero = theIsZero && (theByte == 0);
+		}
+		if(!theIsIntact && !theIsZero)
+		{
+			return -1;
+		}
+		theNumberZeroed += theIsZero ? 1 : 0;
+	}
+	return theNumberZeroed;
+}
+
+static void	Run(const char* inDirectory, const DiskModel& inDiskModel, bool inWriteBehind)
+{
+	char thePath[1024];
+	std::vector<Byte> theBuffer(kBufferSize);
+	Byte theHeader[kHeaderSize];
+	CAWriteBehindEngine* theEngine = inWriteBehind ? new CAWriteBehindEngine(2) : NULL;
+	std::vector<CAWriteBehindFile*> theFiles(kNumberTracks, static_cast<CAWriteBehindFile*>(NULL));
+	std::vector<int> theDescriptors(kNumberTracks, -1);
+	
+	for(int theTrack = 0; theTrack < kNumberTracks; ++theTrack)
+	{
+		MakeFilePath(inDirectory, theTrack, thePath);
+		if(inWriteBehind)
+		{
+			//	8 blocks of 64k is 1.4 seconds of audio per track
+			theFiles[theTrack] = new CAWriteBehindFile(*theEngine, thePath, 0644, 64 * 1024, 8);
+		}
+		else
+		{
+			theDescriptors[theTrack] = open(thePath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		}
+	}
+	
+	sDiskWrites = 0;
+	sDiskModel = &inDiskModel;
+	double theWorstCycle = 0;
+	int theNumberOverruns = 0;
+	double theStartTime = Now();
+	for(int theCycle = 0; theCycle < kNumberCycles; ++theCycle)
+	{
+		//	wait for the next cycle, unless the last one overran
+		double theCycleTime = theStartTime + theCycle * kCycleSeconds;
+		double theNow = Now();
+		Sleep(theCycleTime - theNow);
+		
+		double theCycleStart = Now();
+		MakeHeader((theCycle + 1) * kBufferSize, theHeader);
+		for(int theTrack = 0; theTrack < kNumberTracks; ++theTrack)
+		{
+			SInt64 thePosition = kHeaderSize + static_cast<SInt64>(theCycle) * kBufferSize;
+			for(UInt32 theIndex = 0; theIndex < kBufferSize; ++theIndex)
+			{
+				theBuffer[theIndex] = PatternByte(theTrack, thePosition + theIndex);
+			}
+			if(inWriteBehind)
+			{
+				theFiles[theTrack]->WriteAt(thePosition, &theBuffer[0], kBufferSize);
+				theFiles[theTrack]->WriteAt(0, theHeader, kHeaderSize);
+			}
+			else
+			{
+				pwrite(theDescriptors[theTrack], &theBuffer[0], kBufferSize, thePosition);
+				pwrite(theDescriptors[theTrack], theHeader, kHeaderSize, 0);
+			}
+		}
+		double theCycleDuration = Now() - theCycleStart;
+		theWorstCycle = (theCycleDuration > theWorstCycle) ? theCycleDuration : theWorstCycle;
+		theNumberOverruns += (theCycleDuration > kCycleSeconds) ? 1 : 0;
+	}
+	double theCaptureTime = Now() - theStartTime;
+	
+	CAWriteBehindFile::Metrics theMetrics;
+	if(inWriteBehind)
+	{
+		theEngine->GetMetrics(theMetrics);
+	}
+	double theCloseStart = Now();
+	for(int theTrack = 0; theTrack < kNumberTracks; ++theTrack)
+	{
+		if(inWriteBehind)
+		{
+			theFiles[theTrack]->Close();
+			delete theFiles[theTrack];
+		}
+		else
+		{
+			close(theDescriptors[theTrack]);
+		}
+	}
+	double theCloseTime = Now() - theCloseStart;
+	sDiskModel = NULL;
+	delete theEngine;
+	
+	//	check the files
+	int theNumberZeroed = 0;
+	bool theFilesAreGood = true;
+	for(int theTrack = 0; theTrack < kNumberTracks; ++theTrack)
+	{
+		MakeFilePath(inDirectory, theTrack, thePath);
+		int theResult = CheckFile(thePath, theTrack);
+		theFilesAreGood = theFilesAreGood && (theResult >= 0);
+		theNumberZeroed += (theResult > 0) ? theResult : 0;
+		unlink(thePath);
+	}
+	
+	printf("%-11s %-13s  worst cycle %8.2f ms  overruns %4d/%d  capture %5.2f s  close %5.2f s  disk writes %6d\n",
+		inDiskModel.mName, inWriteBehind ? "write-behind" : "synchronous", theWorstCycle * 1e3, theNumberOverruns, kNumberCycles, theCaptureTime, theCloseTime, sDiskWrites);
+	if(inWriteBehind)
+	{
+		printf("%-11s %-13s  max queue %u  worst disk write %.2f ms  dropped %llu buffers  synchronous %llu  errors %llu\n", "", "",
+			theMetrics.mMaxQueueDepth, theMetrics.mWorstDiskWriteNanos * 1e-6, static_cast<unsigned long long>(theMetrics.mDroppedBuffers),
+			static_cast<unsigned long long>(theMetrics.mSynchronousWrites), static_cast<unsigned long long>(theMetrics.mWriteErrors));
+	}
+	bool theZeroesMatchDrops = !inWriteBehind ? (theNumberZeroed == 0) : (static_cast<UInt64>(theNumberZeroed) == theMetrics.mDroppedBuffers);
+	printf("%-11s %-13s  files %s\n", "", "", (theFilesAreGood && theZeroesMatchDrops) ? "check" : "ARE WRONG");
+}
+
+int	main(int argc, const char* argv[])
+{
+	const char* theDirectory = (argc > 1) ? argv[1] : "/tmp";
+	printf("%d tracks, %u byte buffers every %.2f ms\n", kNumberTracks, kBufferSize, kCycleSeconds * 1e3);
+	for(size_t theIndex = 0; theIndex < sizeof(kDiskModels) / sizeof(kDiskModels[0]); ++theIndex)
+	{
+		Run(theDirectory, kDiskModels[theIndex], false);
+		Run(theDirectory, kDiskModels[theIndex], true);
+	}
+	return 0;
+}
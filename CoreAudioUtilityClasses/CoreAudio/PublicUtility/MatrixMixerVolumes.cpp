@@ -46,6 +46,8 @@
 */
 #include "MatrixMixerVolumes.h"
 #include "CAXException.h"
+#include "CAMixingMatrix.h"
+#include <vector>
 
 OSStatus	NumberChannels (AudioUnit 		 	au,
 							AudioUnitScope		inScope,
@@ -147,3 +149,43 @@ OSStatus	NumberChannels (AudioUnit 		 	au,
 		outChans = desc.mChannelsPerFrame;
 	return result;
 }
+
+OSStatus GetMatrixMixerGains (AudioUnit au, CAMixingMatrix &outMatrix, UInt32 inRampFrames)
+{
+	UInt32 dims[2];
+	UInt32 theSize = sizeof(UInt32) * 2;
+	OSStatus result;
+
+	ca_require_noerr (result = AudioUnitGetProperty (au, kAudioUnitProperty_MatrixDimensions,
+							kAudioUnitScope_Global, 0, dims, &theSize), home);
+	{
+		const UInt32 inputs = dims[0];
+		const UInt32 outputs = dims[1];
+
+		// the levels have an extra column of input volumes, an extra row of output
+		// volumes, and the global volume in the corner
+		std::vector<Float32> theVols ((inputs + 1) * (outputs + 1));
+		theSize = UInt32(theVols.size() * sizeof(Float32));
+		ca_require_noerr (result = AudioUnitGetProperty (au, kAudioUnitProperty_MatrixLevels,
+								kAudioUnitScope_Global, 0, &theVols[0], &theSize), home);
+
+		const Float32 globalVolume = theVols[theVols.size() - 1];
+		std::vector<Float32> gains (inputs * outputs);
+		for (UInt32 i = 0; i < inputs; ++i) {
+			const Float32 inputVolume = theVols[(i + 1) * (outputs + 1) - 1];
+			for (UInt32 j = 0; j < outputs; ++j) {
+				const Float32 outputVolume = theVols[inputs * (outputs + 1) + j];
+				gains[i * outputs + j] = theVols[i * (outputs + 1) + j] * inputVolume * outputVolume * globalVolume;
+			}
+		}
+
+		if (outMatrix.GetNumberInputs() != inputs || outMatrix.GetNumberOutputs() != outputs) {
+			outMatrix.SetDimensions (inputs, outputs);
+			inRampFrames = 0;
+		}
+		if (!gains.empty())
+			outMatrix.SetGains (&gains[0], inRampFrames);
+	}
+home:
+	return result;
+}
@@ -68,4 +68,14 @@ OSStatus PrintBuses (FILE* file, char* str, AudioUnit au, AudioUnitScope inScope
 }
 #endif
 
+#if defined(__cplusplus)
+class CAMixingMatrix;
+
+// fills outMatrix with the effective gains of a matrix mixer audio unit: each crosspoint
+// volume multiplied by its input, output and global volumes. Any zero volume along a
+// path makes its gain zero, so the matrix's schedule skips it. The gains ramp
+// over inRampFrames frames if the matrix already has the same dimensions.
+OSStatus GetMatrixMixerGains (AudioUnit au, CAMixingMatrix &outMatrix, UInt32 inRampFrames = 0);
+#endif
+
 #endif
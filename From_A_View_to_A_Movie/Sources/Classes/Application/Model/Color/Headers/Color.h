@@ -66,6 +66,8 @@
 #import "CProfile.h"
 #import "CSpace.h"
 
+#import "CConversion.h"
+
 #endif
 
 #endif
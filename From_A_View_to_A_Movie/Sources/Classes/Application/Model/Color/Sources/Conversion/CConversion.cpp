@@ -0,0 +1,1095 @@
+/*
+     File: CConversion.cpp
+ Abstract: 
+ Color conversion of whole pixel buffers, through precomposed matrices and lookup tables.
+ 
+  Version: 1.2
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+ Inc. ("Apple") in consideration of your agreement to the following
+ terms, and your use, installation, modification or redistribution of
+ this Apple software constitutes acceptance of these terms.  If you do
+ not agree with these terms, please do not use, install, modify or
+ redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software.
+ Neither the name, trademarks, service marks or logos of Apple Inc. may
+ be used to endorse or promote products derived from the Apple Software
+ without specific prior written permission from Apple.  Except as
+ expressly stated in this notice, no other rights or licenses, express or
+ implied, are granted by Apple herein, including but not limited to any
+ patent rights that may be infringed by your derivative works or by other
+ works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2013 Apple Inc. All Rights Reserved.
+ 
+ */
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#import <algorithm>
+#import <cmath>
+#import <vector>
+
+//---------------------------------------------------------------------------
+
+#import "CEnums.h"
+#import "CMatrix.h"
+#import "CChromaticity.h"
+#import "CBradfordAdaptation.h"
+
+#import "Batch.h"
+
+#if defined(__SSE2__)
+	#import <emmintrin.h>
+#endif
+
+#import "CConversion.h"
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Constants
+
+//---------------------------------------------------------------------------
+//
+// With 4096 intervals the linear interpolation of either transfer
+// function is within 1e-6 of the exact value, about a hundredth of a
+// 16-bit step.
+//
+//---------------------------------------------------------------------------
+
+static const std::size_t kConversionTableSize = 4096;
+
+//---------------------------------------------------------------------------
+//
+// Encoding straight to 8 bits, rounding to the nearest table entry.  At
+// 16384 intervals that is within 0.04 of an 8-bit step.
+//
+//---------------------------------------------------------------------------
+
+static const std::size_t kConversionTable8Size = 16384;
+
+//---------------------------------------------------------------------------
+//
+// 8-bit pixels skip the floating point stages.  Each source value is
+// decoded and multiplied by its column of the matrix ahead of time, in
+// fixed point with 8 bits below an index into the 8-bit encoding table,
+// so that a pixel is three sums of three lookups.
+//
+//---------------------------------------------------------------------------
+
+static const int kConversionFixed8Shift = 8;
+static const int kConversionFixed8One   = int(kConversionTable8Size) << kConversionFixed8Shift;
+
+//---------------------------------------------------------------------------
+//
+// Pixels are converted in blocks, de-interleaved into one array per
+// channel so the matrix is applied with the Math batch operations.
+//
+//---------------------------------------------------------------------------
+
+static const std::size_t kConversionBlockSize = 256;
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Data Structures
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+struct Color::ConversionStruct
+{
+    Type mnGamma;
+    
+    // Linear source RGB to linear destination RGB
+    
+    Math::Matrix3<Type> m_Matrix;
+    
+    // Decoding, exact for 8-bit channels and interpolated otherwise,
+    // and encoding.  The interpolated tables have an extra entry at
+    // either end, so that 1 can be looked up like any other value.
+    
+    Type    m_Decode8[256];
+    Type    m_Decode[kConversionTableSize + 2];
+    Type    m_Encode[kConversionTableSize + 2];
+    uint8_t m_Encode8[kConversionTable8Size + 1];
+    
+    // For each 8-bit source channel and value, the decoded value times
+    // that column of the matrix, in fixed point, padded to four
+    
+    int32_t m_Transform8[3][256][4];
+    
+    // The n x n x n lattice of non-linear RGB triples, if any
+    
+    std::size_t       mnLattice;
+    std::vector<Type> m_Lattice;
+}; // ConversionStruct
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Utilities - Transfer Functions
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static inline Type CConversionClamp(const Type &x)
+{
+    // NaN goes to zero
+    return ( x > Type(0) ) ? ( ( x < Type(1) ) ? x : Type(1) ) : Type(0);
+} // CConversionClamp
+
+//---------------------------------------------------------------------------
+//
+// Display gamma, as in the Rec 709 shader.
+//
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static inline Type CConversionDecode(const Type &x, const Type &nGamma)
+{
+    return std::pow(CConversionClamp(x), nGamma);
+} // CConversionDecode
+
+//---------------------------------------------------------------------------
+//
+// Rec 709 transfer function, as in the Rec 709 shader.
+//
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static inline Type CConversionEncode(const Type &x)
+{
+    return ( x <= Type(0.018) ) ? Type(4.5) * x : Type(1.099) * std::pow(x, Type(0.45)) - Type(0.099);
+} // CConversionEncode
+
+//---------------------------------------------------------------------------
+//
+// Linear interpolation in a table of the interval [0,1].
+//
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static inline Type CConversionLookup(const Type * const pTable,
+                                     const Type &x)
+{
+    const Type s = x * Type(kConversionTableSize);
+    const int  i = int(s);
+    const Type f = s - Type(i);
+    
+    return pTable[i] + f * (pTable[i+1] - pTable[i]);
+} // CConversionLookup
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static void CConversionSetTables(Color::ConversionStruct<Type> *pSConversion)
+{
+    const Type nGamma = pSConversion->mnGamma;
+    
+    std::size_t i;
+    
+    for( i = 0; i < 256; ++i )
+    {
+        pSConversion->m_Decode8[i] = CConversionDecode(Type(i) / Type(255), nGamma);
+    } // for
+    
+    // Only the power law is tabulated for encoding, since the two parts
+    // of the Rec 709 curve do not quite meet at 0.018
+    
+    for( i = 0; i <= kConversionTableSize; ++i )
+    {
+        const Type x = Type(i) / Type(kConversionTableSize);
+        
+        pSConversion->m_Decode[i] = CConversionDecode(x, nGamma);
+        pSConversion->m_Encode[i] = Type(1.099) * std::pow(x, Type(0.45)) - Type(0.099);
+    } // for
+    
+    pSConversion->m_Decode[i] = pSConversion->m_Decode[i-1];
+    pSConversion->m_Encode[i] = pSConversion->m_Encode[i-1];
+    
+    for( i = 0; i <= kConversionTable8Size; ++i )
+    {
+        const Type x = CConversionEncode(Type(i) / Type(kConversionTable8Size));
+        
+        pSConversion->m_Encode8[i] = uint8_t(x * Type(255) + Type(0.5));
+    } // for
+    
+    for( std::size_t j = 0; j < 3; ++j )
+    {
+        for( i = 0; i < 256; ++i )
+        {
+            const double x = double(pSConversion->m_Decode8[i]) * double(kConversionFixed8One);
+            
+            for( std::size_t k = 0; k < 3; ++k )
+            {
+                pSConversion->m_Transform8[j][i][k] = int32_t(std::floor(double(pSConversion->m_Matrix(k,j)) * x + 0.5));
+            } // for
+            
+            pSConversion->m_Transform8[j][i][3] = 0;
+        } // for
+    } // for
+} // CConversionSetTables
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Utilities - Pixels
+
+//---------------------------------------------------------------------------
+//
+// Decoding from, and encoding to, each channel type.  Integer channels
+// are clamped to [0,1], floating point values outside it are encoded
+// exactly rather than from the table.
+//
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static inline Type CConversionDecode(const Color::ConversionStruct<Type> * const pSConversion,
+                                     const uint8_t &v)
+{
+    return pSConversion->m_Decode8[v];
+} // CConversionDecode
+
+template <typename Type>
+static inline Type CConversionDecode(const Color::ConversionStruct<Type> * const pSConversion,
+                                     const uint16_t &v)
+{
+    return CConversionLookup(pSConversion->m_Decode, Type(v) * Type(1.0/65535.0));
+} // CConversionDecode
+
+template <typename Type>
+static inline Type CConversionDecode(const Color::ConversionStruct<Type> * const pSConversion,
+                                     const float &v)
+{
+    return CConversionLookup(pSConversion->m_Decode, CConversionClamp(Type(v)));
+} // CConversionDecode
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static inline void CConversionEncode(const Color::ConversionStruct<Type> * const pSConversion,
+                                     const Type &x,
+                                     uint8_t &v)
+{
+    v = pSConversion->m_Encode8[int(CConversionClamp(x) * Type(kConversionTable8Size) + Type(0.5))];
+} // CConversionEncode
+
+template <typename Type>
+static inline void CConversionEncode(const Color::ConversionStruct<Type> * const pSConversion,
+                                     const Type &x,
+                                     uint16_t &v)
+{
+    const Type z = CConversionClamp(x);
+    const Type y = ( z <= Type(0.018) ) ? Type(4.5) * z : CConversionLookup(pSConversion->m_Encode, z);
+    
+    v = uint16_t(int(y * Type(65535) + Type(0.5)));
+} // CConversionEncode
+
+template <typename Type>
+static inline void CConversionEncode(const Color::ConversionStruct<Type> * const pSConversion,
+                                     const Type &x,
+                                     float &v)
+{
+    const Type y = ( ( x > Type(0.018) ) && ( x <= Type(1) ) )
+    ? CConversionLookup(pSConversion->m_Encode, x)
+    : CConversionEncode(x);
+    
+    v = float(y);
+} // CConversionEncode
+
+//---------------------------------------------------------------------------
+//
+// Storing values from the lattice, which are already encoded.
+//
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static inline void CConversionStore(const Type &x, uint8_t &v)
+{
+    v = uint8_t(int(CConversionClamp(x) * Type(255) + Type(0.5)));
+} // CConversionStore
+
+template <typename Type>
+static inline void CConversionStore(const Type &x, uint16_t &v)
+{
+    v = uint16_t(int(CConversionClamp(x) * Type(65535) + Type(0.5)));
+} // CConversionStore
+
+template <typename Type>
+static inline void CConversionStore(const Type &x, float &v)
+{
+    v = float(x);
+} // CConversionStore
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static inline Type CConversionNormalize(const uint8_t &v)
+{
+    return Type(v) * Type(1.0/255.0);
+} // CConversionNormalize
+
+template <typename Type>
+static inline Type CConversionNormalize(const uint16_t &v)
+{
+    return Type(v) * Type(1.0/65535.0);
+} // CConversionNormalize
+
+template <typename Type>
+static inline Type CConversionNormalize(const float &v)
+{
+    return CConversionClamp(Type(v));
+} // CConversionNormalize
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Utilities - Lattice
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static Math::Vector3<Type> CConversionApply(const Color::ConversionStruct<Type> * const pSConversion,
+                                            const Math::Vector3<Type> &rRGB)
+{
+    const Type nGamma = pSConversion->mnGamma;
+    
+    Math::Vector3<Type> v(CConversionDecode(rRGB.x, nGamma),
+                          CConversionDecode(rRGB.y, nGamma),
+                          CConversionDecode(rRGB.z, nGamma));
+    
+    v = pSConversion->m_Matrix * v;
+    
+    v.x = CConversionEncode(v.x);
+    v.y = CConversionEncode(v.y);
+    v.z = CConversionEncode(v.z);
+    
+    return v;
+} // CConversionApply
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static void CConversionSetLattice(Color::ConversionStruct<Type> *pSConversion,
+                                  const std::size_t &nSize)
+{
+    const std::size_t n = ( nSize == 1 ) ? 2 : nSize;
+    
+    pSConversion->mnLattice = n;
+    
+    pSConversion->m_Lattice.resize(3 * n * n * n);
+    
+    if( n )
+    {
+        const Type s = Type(1) / Type(n - 1);
+        
+        Type *pLattice = &pSConversion->m_Lattice[0];
+        
+        std::size_t r, g, b;
+        
+        for( r = 0; r < n; ++r )
+        {
+            for( g = 0; g < n; ++g )
+            {
+                for( b = 0; b < n; ++b )
+                {
+                    Math::Vector3<Type> v = CConversionApply(pSConversion, Math::Vector3<Type>(r * s, g * s, b * s));
+                    
+                    pLattice[0] = v.x;
+                    pLattice[1] = v.y;
+                    pLattice[2] = v.z;
+                    
+                    pLattice += 3;
+                } // for
+            } // for
+        } // for
+    } // if
+} // CConversionSetLattice
+
+//---------------------------------------------------------------------------
+//
+// The lattice cube containing (r,g,b) is split into six tetrahedra along
+// its main diagonal, and the value is interpolated within the one which
+// contains the point, from its four vertices.
+//
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static inline void CConversionInterpolate(const Color::ConversionStruct<Type> * const pSConversion,
+                                          const Type &r,
+                                          const Type &g,
+                                          const Type &b,
+                                          Type *pRGB)
+{
+    const int  n = int(pSConversion->mnLattice);
+    const Type s = Type(n - 1);
+    
+    const Type x = r * s;
+    const Type y = g * s;
+    const Type z = b * s;
+    
+    const int i = std::min(int(x), n - 2);
+    const int j = std::min(int(y), n - 2);
+    const int k = std::min(int(z), n - 2);
+    
+    const Type fx = x - Type(i);
+    const Type fy = y - Type(j);
+    const Type fz = z - Type(k);
+    
+    // Strides, in elements, along r, g and b
+    
+    const int dr = 3 * n * n;
+    const int dg = 3 * n;
+    const int db = 3;
+    
+    const Type *c000 = &pSConversion->m_Lattice[i * dr + j * dg + k * db];
+    const Type *c111 = c000 + dr + dg + db;
+    
+    const Type *c1;
+    const Type *c2;
+    
+    Type w1, w2, w3;
+    
+    if( fx >= fy )
+    {
+        if( fy >= fz )
+        {
+            c1 = c000 + dr; c2 = c000 + dr + dg; w1 = fx; w2 = fy; w3 = fz;
+        } // if
+        else if( fx >= fz )
+        {
+            c1 = c000 + dr; c2 = c000 + dr + db; w1 = fx; w2 = fz; w3 = fy;
+        } // else if
+        else
+        {
+            c1 = c000 + db; c2 = c000 + dr + db; w1 = fz; w2 = fx; w3 = fy;
+        } // else
+    } // if
+    else
+    {
+        if( fz >= fy )
+        {
+            c1 = c000 + db; c2 = c000 + dg + db; w1 = fz; w2 = fy; w3 = fx;
+        } // if
+        else if( fz >= fx )
+        {
+            c1 = c000 + dg; c2 = c000 + dg + db; w1 = fy; w2 = fz; w3 = fx;
+        } // else if
+        else
+        {
+            c1 = c000 + dg; c2 = c000 + dr + dg; w1 = fy; w2 = fx; w3 = fz;
+        } // else
+    } // else
+    
+    // c000 + w1 (c1 - c000) + w2 (c2 - c1) + w3 (c111 - c2)
+    
+    const Type w0 = Type(1) - w1;
+    
+    w1 -= w2;
+    w2 -= w3;
+    
+    pRGB[0] = w0 * c000[0] + w1 * c1[0] + w2 * c2[0] + w3 * c111[0];
+    pRGB[1] = w0 * c000[1] + w1 * c1[1] + w2 * c2[1] + w3 * c111[1];
+    pRGB[2] = w0 * c000[2] + w1 * c1[2] + w2 * c2[2] + w3 * c111[2];
+} // CConversionInterpolate
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Utilities - Buffers
+
+//---------------------------------------------------------------------------
+
+template <typename Type, typename Pixel>
+static void CConversionConvert(const Color::ConversionStruct<Type> * const pSConversion,
+                               const std::size_t &nPixels,
+                               const std::size_t &nChannels,
+                               const Pixel * const pSrc,
+                               Pixel * const pDst)
+{
+    if( ( pSConversion == NULL ) || ( pSrc == NULL ) || ( pDst == NULL ) )
+    {
+        return;
+    } // if
+    
+    Type r[kConversionBlockSize];
+    Type g[kConversionBlockSize];
+    Type b[kConversionBlockSize];
+    
+    Math::Vector3Array<Type> v = { r, g, b };
+    
+    const std::size_t c = ( nChannels == 4 ) ? 4 : 3;
+    
+    std::size_t i;
+    std::size_t j;
+    
+    for( i = 0; i < nPixels; i += kConversionBlockSize )
+    {
+        const std::size_t m = std::min(kConversionBlockSize, nPixels - i);
+        
+        const Pixel *p = pSrc + i * c;
+        Pixel       *q = pDst + i * c;
+        
+        if( pSConversion->mnLattice )
+        {
+            Type rgb[3];
+            
+            for( j = 0; j < m; ++j )
+            {
+                CConversionInterpolate(pSConversion,
+                                       CConversionNormalize<Type>(p[j * c]),
+                                       CConversionNormalize<Type>(p[j * c + 1]),
+                                       CConversionNormalize<Type>(p[j * c + 2]),
+                                       rgb);
+                
+                r[j] = rgb[0];
+                g[j] = rgb[1];
+                b[j] = rgb[2];
+            } // for
+            
+            for( j = 0; j < m; ++j )
+            {
+                CConversionStore(r[j], q[j * c]);
+                CConversionStore(g[j], q[j * c + 1]);
+                CConversionStore(b[j], q[j * c + 2]);
+            } // for
+        } // if
+        else
+        {
+            for( j = 0; j < m; ++j )
+            {
+                r[j] = CConversionDecode(pSConversion, p[j * c]);
+                g[j] = CConversionDecode(pSConversion, p[j * c + 1]);
+                b[j] = CConversionDecode(pSConversion, p[j * c + 2]);
+            } // for
+            
+            Math::transform(m, pSConversion->m_Matrix, v, v);
+            
+            for( j = 0; j < m; ++j )
+            {
+                CConversionEncode(pSConversion, r[j], q[j * c]);
+                CConversionEncode(pSConversion, g[j], q[j * c + 1]);
+                CConversionEncode(pSConversion, b[j], q[j * c + 2]);
+            } // for
+        } // else
+        
+        if( ( c == 4 ) && ( p != q ) )
+        {
+            for( j = 0; j < m; ++j )
+            {
+                q[j * 4 + 3] = p[j * 4 + 3];
+            } // for
+        } // if
+    } // for
+} // CConversionConvert
+
+//---------------------------------------------------------------------------
+//
+// 8-bit pixels always go through the fixed point tables, which are both
+// faster and closer to the exact conversion than any lattice.
+//
+//---------------------------------------------------------------------------
+
+static inline uint8_t CConversionEncode8(const uint8_t * const pEncode8,
+                                         const int32_t &x)
+{
+    const int32_t y = ( x > 0 ) ? ( ( x < kConversionFixed8One ) ? x : kConversionFixed8One ) : 0;
+    
+    return pEncode8[(y + (1 << (kConversionFixed8Shift - 1))) >> kConversionFixed8Shift];
+} // CConversionEncode8
+
+template <typename Type, std::size_t c>
+static void CConversionConvert8(const Color::ConversionStruct<Type> * const pSConversion,
+                                const std::size_t &nPixels,
+                                const uint8_t * const pSrc,
+                                uint8_t * const pDst)
+{
+    const int32_t (*pTransform)[256][4] = pSConversion->m_Transform8;
+    const uint8_t  *pEncode8            = pSConversion->m_Encode8;
+    
+    const uint8_t *p = pSrc;
+    uint8_t       *q = pDst;
+    
+    std::size_t i = 0;
+    
+#if defined(__SSE2__)
+    // Two pixels at a time, their three sums each in one register, rounded
+    // and clamped together as 16-bit indices
+    
+    const __m128i nHalf = _mm_set1_epi32(1 << (kConversionFixed8Shift - 1));
+    const __m128i nZero = _mm_setzero_si128();
+    const __m128i nOne  = _mm_set1_epi16(int16_t(kConversionTable8Size));
+    
+    for( ; i + 2 <= nPixels; i += 2, p += 2 * c, q += 2 * c )
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *)pTransform[0][p[0]]);
+        __m128i t = _mm_loadu_si128((const __m128i *)pTransform[0][p[c]]);
+        
+        s = _mm_add_epi32(s, _mm_loadu_si128((const __m128i *)pTransform[1][p[1]]));
+        t = _mm_add_epi32(t, _mm_loadu_si128((const __m128i *)pTransform[1][p[c + 1]]));
+        s = _mm_add_epi32(s, _mm_loadu_si128((const __m128i *)pTransform[2][p[2]]));
+        t = _mm_add_epi32(t, _mm_loadu_si128((const __m128i *)pTransform[2][p[c + 2]]));
+        
+        s = _mm_srai_epi32(_mm_add_epi32(s, nHalf), kConversionFixed8Shift);
+        t = _mm_srai_epi32(_mm_add_epi32(t, nHalf), kConversionFixed8Shift);
+        
+        const __m128i k = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(s, t), nZero), nOne);
+        
+        q[0]     = pEncode8[_mm_extract_epi16(k, 0)];
+        q[1]     = pEncode8[_mm_extract_epi16(k, 1)];
+        q[2]     = pEncode8[_mm_extract_epi16(k, 2)];
+        q[c]     = pEncode8[_mm_extract_epi16(k, 4)];
+        q[c + 1] = pEncode8[_mm_extract_epi16(k, 5)];
+        q[c + 2] = pEncode8[_mm_extract_epi16(k, 6)];
+        
+        if( c == 4 )
+        {
+            q[3]     = p[3];
+            q[c + 3] = p[c + 3];
+        } // if
+    } // for
+#endif
+    
+    for( ; i < nPixels; ++i, p += c, q += c )
+    {
+        // Everything is read before anything is written, since the buffers
+        // may be the same
+        
+        const int32_t *r = pTransform[0][p[0]];
+        const int32_t *g = pTransform[1][p[1]];
+        const int32_t *b = pTransform[2][p[2]];
+        
+        const uint8_t u = CConversionEncode8(pEncode8, r[0] + g[0] + b[0]);
+        const uint8_t v = CConversionEncode8(pEncode8, r[1] + g[1] + b[1]);
+        const uint8_t w = CConversionEncode8(pEncode8, r[2] + g[2] + b[2]);
+        
+        q[0] = u;
+        q[1] = v;
+        q[2] = w;
+        
+        if( c == 4 )
+        {
+            q[3] = p[3];
+        } // if
+    } // for
+} // CConversionConvert8
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Utilities - Matrices
+
+//---------------------------------------------------------------------------
+//
+// The RGB to CIE XYZ matrix of a working space, computed as in Space.
+//
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static Math::Matrix3<Type> CConversionGetCIEMatrix(const Type * const pSpace)
+{
+    Color::Chromaticity<Type> chromaticity;
+    
+    Color::Matrix<Type> C = chromaticity(pSpace);
+    
+    Math::Matrix3<Type> CIE_XYZ;
+    Math::Matrix3<Type> RGB_2_XYZ;
+    
+    long i;
+    
+    for( i = Color::Index::kRed; i < Color::Index::kWhitePt; ++i )
+    {
+        CIE_XYZ(Color::Coordinate::kX,i) = C(i, Color::Coordinate::kX) / C(i, Color::Coordinate::kY);
+        CIE_XYZ(Color::Coordinate::kY,i) = Type(1);
+        CIE_XYZ(Color::Coordinate::kZ,i) = C(i, Color::Coordinate::kZ) / C(i, Color::Coordinate::kY);
+    } // for
+    
+    Math::Matrix3<Type> CIE_XYZ_Inv = Math::inv(CIE_XYZ);
+    
+    Type xWhite = C(Color::Index::kWhitePt, Color::Coordinate::kX) / C(Color::Index::kWhitePt, Color::Coordinate::kY);
+    Type zWhite = C(Color::Index::kWhitePt, Color::Coordinate::kZ) / C(Color::Index::kWhitePt, Color::Coordinate::kY);
+    
+    for( i = Color::Index::kRed; i < Color::Index::kWhitePt; ++i )
+    {
+        Type nScale
+        = CIE_XYZ_Inv(i,Color::Index::kRed) * xWhite
+        + CIE_XYZ_Inv(i,Color::Index::kGreen)
+        + CIE_XYZ_Inv(i,Color::Index::kBlue) * zWhite;
+        
+        RGB_2_XYZ(Color::Coordinate::kX, i) = CIE_XYZ(Color::Coordinate::kX, i) * nScale;
+        RGB_2_XYZ(Color::Coordinate::kY, i) = CIE_XYZ(Color::Coordinate::kY, i) * nScale;
+        RGB_2_XYZ(Color::Coordinate::kZ, i) = CIE_XYZ(Color::Coordinate::kZ, i) * nScale;
+    } // for
+    
+    return Math::tr(RGB_2_XYZ);
+} // CConversionGetCIEMatrix
+
+//---------------------------------------------------------------------------
+//
+// Bradford adaptation from the source to the destination white point, as
+// in ChromaticAdaptation.
+//
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static Math::Matrix3<Type> CConversionGetAdaptation(const Type * const pSrcSpace,
+                                                    const Type * const pDstSpace)
+{
+    Math::Vector3<Type> src(pSrcSpace[6] / pSrcSpace[7],
+                            Type(1),
+                            (Type(1) - pSrcSpace[6] - pSrcSpace[7]) / pSrcSpace[7]);
+    
+    Math::Vector3<Type> dst(pDstSpace[6] / pDstSpace[7],
+                            Type(1),
+                            (Type(1) - pDstSpace[6] - pDstSpace[7]) / pDstSpace[7]);
+    
+    Math::Vector3<Type> delta = Math::diff(src, dst);
+    
+    if( ( delta.x <= Type(1E-4) ) && ( delta.y <= Type(1E-4) ) && ( delta.z <= Type(1E-4) ) )
+    {
+        return Math::diag(Math::Vector3<Type>(Type(1),Type(1),Type(1)));
+    } // if
+    
+    Color::BradfordAdaptation<Type> BAM(1);
+    Color::BradfordAdaptation<Type> BAMI(-1);
+    
+    Math::Matrix3<Type> A = BAM.GetBradfordAdaptation();
+    Math::Matrix3<Type> B = BAMI.GetBradfordAdaptation();
+    
+    Math::Vector3<Type> s = A * src;
+    Math::Vector3<Type> d = A * dst;
+    
+    Math::Matrix3<Type> S = Math::diag(Math::Vector3<Type>(d.x / s.x, d.y / s.y, d.z / s.z));
+    
+    // Matrix3::operator* composes right to left, so this is B S A
+    
+    return A * S * B;
+} // CConversionGetAdaptation
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Utilities - Constructors
+
+//---------------------------------------------------------------------------
+//
+// The Rec 709 shader reads the two space matrices transposed, so the
+// composite is tr(inv(P_dst)) A tr(P_src), written in reverse since
+// Matrix3::operator* composes right to left.
+//
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static Color::ConversionStruct<Type> *CConversionCreate(const Math::Matrix3<Type> &rSrcCIEMatrix,
+                                                        const Math::Matrix3<Type> &rAdaptation,
+                                                        const Math::Matrix3<Type> &rDstCIEMatrixInv,
+                                                        const Type &nGamma)
+{
+    Color::ConversionStruct<Type> *pSConversion = new Color::ConversionStruct<Type>;
+    
+    if( pSConversion != NULL )
+    {
+        pSConversion->mnGamma   = nGamma;
+        pSConversion->mnLattice = 0;
+        pSConversion->m_Matrix  = Math::tr(rSrcCIEMatrix) * rAdaptation * Math::tr(rDstCIEMatrixInv);
+        
+        CConversionSetTables<Type>(pSConversion);
+    } // if
+    
+    return pSConversion;
+} // CConversionCreate
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static Color::ConversionStruct<Type> *CConversionCreate(const Type * const pSrcSpace,
+                                                        const Type * const pDstSpace,
+                                                        const Type &nGamma)
+{
+    Color::ConversionStruct<Type> *pSConversion = NULL;
+    
+    if( ( pSrcSpace != NULL ) && ( pDstSpace != NULL ) )
+    {
+        Math::Matrix3<Type> P = CConversionGetCIEMatrix<Type>(pSrcSpace);
+        Math::Matrix3<Type> Q = CConversionGetCIEMatrix<Type>(pDstSpace);
+        Math::Matrix3<Type> A = CConversionGetAdaptation<Type>(pSrcSpace, pDstSpace);
+        
+        pSConversion = CConversionCreate<Type>(P, A, Math::inv(Q), nGamma);
+    } // if
+    
+    return pSConversion;
+} // CConversionCreate
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static Color::ConversionStruct<Type> *CConversionCreateCopy(const Color::ConversionStruct<Type> * const pSConversionSrc)
+{
+    Color::ConversionStruct<Type> *pSConversionDst = NULL;
+    
+    if( pSConversionSrc != NULL )
+    {
+        pSConversionDst = new Color::ConversionStruct<Type>(*pSConversionSrc);
+    } // if
+    
+    return pSConversionDst;
+} // CConversionCreateCopy
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+static void CConversionDelete(Color::ConversionStruct<Type> *pSConversion)
+{
+    if( pSConversion != NULL )
+    {
+        delete pSConversion;
+        
+        pSConversion = NULL;
+    } // if
+} // CConversionDelete
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Public - Constructors
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+Color::Conversion<Type>::Conversion(const Type * const pSrcSpace,
+                                    const Type * const pDstSpace,
+                                    const Type &nGamma)
+{
+    mpSConversion = CConversionCreate<Type>(pSrcSpace, pDstSpace, nGamma);
+} // Constructor
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+Color::Conversion<Type>::Conversion(const Math::Matrix3<Type> &rSrcCIEMatrix,
+                                    const Math::Matrix3<Type> &rAdaptation,
+                                    const Math::Matrix3<Type> &rDstCIEMatrixInv,
+                                    const Type &nGamma)
+{
+    mpSConversion = CConversionCreate<Type>(rSrcCIEMatrix, rAdaptation, rDstCIEMatrixInv, nGamma);
+} // Constructor
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Public - Destructor
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+Color::Conversion<Type>::~Conversion()
+{
+    CConversionDelete<Type>(mpSConversion);
+} // Destructor
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Public - Copy Constructors
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+Color::Conversion<Type>::Conversion(const Color::Conversion<Type> &rConversion)
+{
+    mpSConversion = CConversionCreateCopy<Type>(rConversion.mpSConversion);
+} // Copy Constructor
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+Color::Conversion<Type>::Conversion(const Color::Conversion<Type> * const pConversion)
+{
+    mpSConversion = ( pConversion != NULL ) ? CConversionCreateCopy<Type>(pConversion->mpSConversion) : NULL;
+} // Copy Constructor
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Public - Assignment Operator
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+Color::Conversion<Type> &Color::Conversion<Type>::operator=(const Color::Conversion<Type> &rConversion)
+{
+	if( ( this != &rConversion ) && ( rConversion.mpSConversion != NULL ) )
+	{
+        CConversionDelete<Type>(mpSConversion);
+        
+        mpSConversion = CConversionCreateCopy<Type>(rConversion.mpSConversion);
+	} // if
+	
+	return *this;
+} // Conversion::operator=
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Public - Accessors
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+const Math::Matrix3<Type> &Color::Conversion<Type>::GetMatrix() const
+{
+    return mpSConversion->m_Matrix;
+} // GetMatrix
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+const Type Color::Conversion<Type>::GetGamma() const
+{
+    return mpSConversion->mnGamma;
+} // GetGamma
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+void Color::Conversion<Type>::SetLattice(const std::size_t &nSize)
+{
+    CConversionSetLattice<Type>(mpSConversion, nSize);
+} // SetLattice
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+const std::size_t Color::Conversion<Type>::GetLattice() const
+{
+    return mpSConversion->mnLattice;
+} // GetLattice
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Public - Operators
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+const Math::Vector3<Type> Color::Conversion<Type>::operator()(const Math::Vector3<Type> &rRGB) const
+{
+    return CConversionApply<Type>(mpSConversion, rRGB);
+} // Function Operator
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+void Color::Conversion<Type>::Convert(const std::size_t &nPixels,
+                                      const std::size_t &nChannels,
+                                      const uint8_t * const pSrc,
+                                      uint8_t * const pDst) const
+{
+    if( ( mpSConversion == NULL ) || ( pSrc == NULL ) || ( pDst == NULL ) )
+    {
+        return;
+    } // if
+    
+    if( nChannels == 4 )
+    {
+        CConversionConvert8<Type,4>(mpSConversion, nPixels, pSrc, pDst);
+    } // if
+    else
+    {
+        CConversionConvert8<Type,3>(mpSConversion, nPixels, pSrc, pDst);
+    } // else
+} // Convert
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+void Color::Conversion<Type>::Convert(const std::size_t &nPixels,
+                                      const std::size_t &nChannels,
+                                      const uint16_t * const pSrc,
+                                      uint16_t * const pDst) const
+{
+    CConversionConvert<Type,uint16_t>(mpSConversion, nPixels, nChannels, pSrc, pDst);
+} // Convert
+
+//---------------------------------------------------------------------------
+
+template <typename Type>
+void Color::Conversion<Type>::Convert(const std::size_t &nPixels,
+                                      const std::size_t &nChannels,
+                                      const float * const pSrc,
+                                      float * const pDst) const
+{
+    CConversionConvert<Type,float>(mpSConversion, nPixels, nChannels, pSrc, pDst);
+} // Convert
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Public - Implementations - Template
+
+//---------------------------------------------------------------------------
+
+template class Color::Conversion<float>;
+template class Color::Conversion<double>;
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
@@ -0,0 +1,163 @@
+/*
+     File: CConversion.h
+ Abstract: 
+ Color conversion of whole pixel buffers, through precomposed matrices and lookup tables.
+ 
+  Version: 1.2
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+ Inc. ("Apple") in consideration of your agreement to the following
+ terms, and your use, installation, modification or redistribution of
+ this Apple software constitutes acceptance of these terms.  If you do
+ not agree with these terms, please do not use, install, modify or
+ redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software.
+ Neither the name, trademarks, service marks or logos of Apple Inc. may
+ be used to endorse or promote products derived from the Apple Software
+ without specific prior written permission from Apple.  Except as
+ expressly stated in this notice, no other rights or licenses, express or
+ implied, are granted by Apple herein, including but not limited to any
+ patent rights that may be infringed by your derivative works or by other
+ works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2013 Apple Inc. All Rights Reserved.
+ 
+ */
+
+#ifndef _COLOR_CONVERSION_H_
+#define _COLOR_CONVERSION_H_
+
+#ifdef __cplusplus
+
+#import <cstddef>
+#import <stdint.h>
+
+#import "Vector3.h"
+#import "Matrix3.h"
+
+//---------------------------------------------------------------------------
+//
+// The CPU counterpart of the Rec 709 shader.  A source RGB value is
+// decoded with the display gamma, mapped into CIE XYZ, adapted to the
+// destination white point, mapped into destination RGB and encoded with
+// the Rec 709 transfer function.
+//
+// The three matrices are composed into one when the conversion is made,
+// and both transfer functions are read from 1D tables.  Optionally the
+// whole conversion can instead be sampled into a 3D lattice, which is
+// then interpolated tetrahedrally.
+//
+// Which path to use:
+//
+//   8-bit   Tables, always.  Decoding and the matrix are folded into
+//           fixed point tables, so a pixel is only lookups and adds; a
+//           lattice is slower and less accurate, and is ignored for
+//           8-bit buffers.
+//   16-bit  Tables.  A lattice is no faster and far less accurate.
+//   float   Tables.  A lattice of 65 runs at about the same speed, to
+//           within 0.11 Delta E rather than 2.5e-4.
+//
+// With one matrix and two curves the lattice does not beat the tables
+// for any format; CConversionBenchmark compares the two.
+//
+// Pixels are interleaved RGB or RGBA, with 8-bit, 16-bit or floating
+// point channels; alpha is copied unchanged.  Integer channels are taken
+// to span [0,1]; floating point inputs are clamped to [0,1].
+//
+//---------------------------------------------------------------------------
+
+namespace Color
+{
+	template <typename Type>
+	struct ConversionStruct;
+	
+	template <typename Type>
+	class Conversion
+	{
+	public:
+		// From the 4x2 chromaticity matrices of the source and destination
+		// working spaces, as returned by WorkingSpace::GetWorkingSpace,
+		// using Bradford adaptation between the two white points.
+		Conversion(const Type * const pSrcSpace,
+				   const Type * const pDstSpace,
+				   const Type &nGamma = Type(2.2));
+		
+		// From the matrices used by the Rec 709 shader, those of
+		// Space::GetCIEMatrix, ChromaticAdaptation::GetChromaticAdaptation
+		// and Space::GetCIEMatrixInv.
+		Conversion(const Math::Matrix3<Type> &rSrcCIEMatrix,
+				   const Math::Matrix3<Type> &rAdaptation,
+				   const Math::Matrix3<Type> &rDstCIEMatrixInv,
+				   const Type &nGamma);
+		
+		virtual ~Conversion();
+		
+		Conversion(const Conversion<Type> &rConversion);
+		Conversion(const Conversion<Type> * const pConversion);
+		
+		Conversion<Type> &operator=(const Conversion<Type> &rConversion);
+		
+		// The composite matrix, taking linear source RGB to linear
+		// destination RGB as M * v.
+		const Math::Matrix3<Type> &GetMatrix() const;
+		
+		const Type GetGamma() const;
+		
+		// Sample the conversion on an n x n x n lattice, and interpolate
+		// that from then on for 16-bit and float buffers.  Zero goes back
+		// to the tables.
+		void SetLattice(const std::size_t &nSize);
+		
+		const std::size_t GetLattice() const;
+		
+		// The exact conversion of one non-linear RGB value, without tables.
+		const Math::Vector3<Type> operator()(const Math::Vector3<Type> &rRGB) const;
+		
+		// Convert n pixels of 3 (RGB) or 4 (RGBA) channels each. Source and
+		// destination may be the same buffer.
+		void Convert(const std::size_t &nPixels,
+					 const std::size_t &nChannels,
+					 const uint8_t * const pSrc,
+					 uint8_t * const pDst) const;
+		
+		void Convert(const std::size_t &nPixels,
+					 const std::size_t &nChannels,
+					 const uint16_t * const pSrc,
+					 uint16_t * const pDst) const;
+		
+		void Convert(const std::size_t &nPixels,
+					 const std::size_t &nChannels,
+					 const float * const pSrc,
+					 float * const pDst) const;
+		
+	private:
+		ConversionStruct<Type> *mpSConversion;
+	}; // Conversion
+} // Color
+
+#endif
+
+#endif
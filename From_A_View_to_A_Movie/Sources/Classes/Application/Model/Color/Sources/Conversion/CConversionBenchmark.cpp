@@ -0,0 +1,532 @@
+/*
+     File: CConversionBenchmark.cpp
+ Abstract: 
+ Checks buffer conversions against the exact conversion, as Delta E, and
+ times them in megapixels per second.
+ 
+ Build, for example, with
+ 
+   M=../../../Math; C=..
+   c++ -std=c++11 -O2 -mavx -x c++ -I. -I$C/Common -I$C/Matrix \
+       -I"$C/Color Space/Chromaticity" -I"$C/Chromatic Adaptation/Bradford Adaptation" \
+       -I$M/Batches -I$M/Vectors -I$M/Matrices -I$M/Quaternions \
+       CConversionBenchmark.cpp CConversion.cpp $C/Matrix/CMatrix.cpp \
+       "$C/Color Space/Chromaticity/CChromaticity.cpp" \
+       "$C/Chromatic Adaptation/Bradford Adaptation/CBradfordAdaptation.mm" \
+       $M/Batches/Batch.cpp $M/Vectors/Vector2.cpp $M/Vectors/Vector3.cpp \
+       $M/Matrices/Matrix3.cpp $M/Quaternions/Quaternion.cpp -o CConversionBenchmark
+ 
+  Version: 1.2
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+ Inc. ("Apple") in consideration of your agreement to the following
+ terms, and your use, installation, modification or redistribution of
+ this Apple software constitutes acceptance of these terms.  If you do
+ not agree with these terms, please do not use, install, modify or
+ redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software.
+ Neither the name, trademarks, service marks or logos of Apple Inc. may
+ be used to endorse or promote products derived from the Apple Software
+ without specific prior written permission from Apple.  Except as
+ expressly stated in this notice, no other rights or licenses, express or
+ implied, are granted by Apple herein, including but not limited to any
+ patent rights that may be infringed by your derivative works or by other
+ works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2013 Apple Inc. All Rights Reserved.
+ 
+ */
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#import <chrono>
+#import <cmath>
+#import <cstdio>
+#import <cstdlib>
+#import <cstring>
+#import <limits>
+#import <vector>
+
+//---------------------------------------------------------------------------
+
+#import "CConversion.h"
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Reference
+
+//---------------------------------------------------------------------------
+//
+// A D50 sRGB display, Bradford adaptation from D50 to D65, and Rec 709,
+// with the two space matrices as Space would return them.
+//
+//---------------------------------------------------------------------------
+
+static const double kDisplay[9] =
+{
+    0.4360747, 0.3850649, 0.1430804,
+    0.2225045, 0.7168786, 0.0606169,
+    0.0139322, 0.0971045, 0.7141733
+};
+
+static const double kAdaptation[9] =
+{
+     0.9555766, -0.0230393, 0.0631636,
+    -0.0282895,  1.0099416, 0.0210077,
+     0.0122982, -0.0204830, 1.3299098
+};
+
+static const double kRec709Inv[9] =
+{
+     3.2404542, -1.5371385, -0.4985314,
+    -0.9692660,  1.8760108,  0.0415560,
+     0.0556434, -0.2040259,  1.0572252
+};
+
+static const double kRec709[9] =
+{
+    0.4124564, 0.3575761, 0.1804375,
+    0.2126729, 0.7151522, 0.0721750,
+    0.0193339, 0.1191920, 0.9503041
+};
+
+static const double kGamma = 2.2;
+
+//---------------------------------------------------------------------------
+
+static inline double ConversionRec709(const double &x)
+{
+    return ( x <= 0.018 ) ? 4.5 * x : 1.099 * std::pow(x, 0.45) - 0.099;
+} // ConversionRec709
+
+//---------------------------------------------------------------------------
+//
+// The Rec 709 fragment shader in double precision, indexing the matrices
+// exactly as the shader does once they are uploaded untransposed.
+//
+//---------------------------------------------------------------------------
+
+static void ConversionReference(const double * const pIn, double * const pOut)
+{
+    double D[9], R[9];
+    
+    // Space returns the transposes
+    
+    for( int i = 0; i < 3; ++i )
+    {
+        for( int j = 0; j < 3; ++j )
+        {
+            D[3 * i + j] = kDisplay[3 * j + i];
+            R[3 * i + j] = kRec709Inv[3 * j + i];
+        } // for
+    } // for
+    
+    const double *A = kAdaptation;
+    
+    double r = std::pow(std::min(std::max(pIn[0], 0.0), 1.0), kGamma);
+    double g = std::pow(std::min(std::max(pIn[1], 0.0), 1.0), kGamma);
+    double b = std::pow(std::min(std::max(pIn[2], 0.0), 1.0), kGamma);
+    
+    double sx = D[0] * r + D[3] * g + D[6] * b;
+    double sy = D[1] * r + D[4] * g + D[7] * b;
+    double sz = D[2] * r + D[5] * g + D[8] * b;
+    
+    double dx = A[0] * sx + A[1] * sy + A[2] * sz;
+    double dy = A[3] * sx + A[4] * sy + A[5] * sz;
+    double dz = A[6] * sx + A[7] * sy + A[8] * sz;
+    
+    pOut[0] = ConversionRec709(R[0] * dx + R[3] * dy + R[6] * dz);
+    pOut[1] = ConversionRec709(R[1] * dx + R[4] * dy + R[7] * dz);
+    pOut[2] = ConversionRec709(R[2] * dx + R[5] * dy + R[8] * dz);
+} // ConversionReference
+
+//---------------------------------------------------------------------------
+//
+// CIE 1976 Delta E between two non-linear Rec 709 values.
+//
+//---------------------------------------------------------------------------
+
+static void ConversionLab(const double * const pRGB, double * const pLab)
+{
+    double v[3];
+    double xyz[3];
+    
+    for( int i = 0; i < 3; ++i )
+    {
+        v[i] = ( pRGB[i] < 0.081 ) ? pRGB[i] / 4.5 : std::pow((pRGB[i] + 0.099) / 1.099, 1.0 / 0.45);
+    } // for
+    
+    static const double kWhite[3] = { 0.95047, 1.0, 1.08883 };
+    
+    for( int i = 0; i < 3; ++i )
+    {
+        double t = (kRec709[3 * i] * v[0] + kRec709[3 * i + 1] * v[1] + kRec709[3 * i + 2] * v[2]) / kWhite[i];
+        
+        xyz[i] = ( t > 216.0 / 24389.0 ) ? std::cbrt(t) : t * (841.0 / 108.0) + 4.0 / 29.0;
+    } // for
+    
+    pLab[0] = 116.0 * xyz[1] - 16.0;
+    pLab[1] = 500.0 * (xyz[0] - xyz[1]);
+    pLab[2] = 200.0 * (xyz[1] - xyz[2]);
+} // ConversionLab
+
+static double ConversionDeltaE(const double * const pRGB1, const double * const pRGB2)
+{
+    double p[3], q[3];
+    
+    ConversionLab(pRGB1, p);
+    ConversionLab(pRGB2, q);
+    
+    return std::sqrt((p[0] - q[0]) * (p[0] - q[0]) + (p[1] - q[1]) * (p[1] - q[1]) + (p[2] - q[2]) * (p[2] - q[2]));
+} // ConversionDeltaE
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Formats
+
+//---------------------------------------------------------------------------
+
+template <typename Pixel>
+struct ConversionFormat
+{
+    static const char *Name()                { return "float"; }
+    static double      Scale()               { return 1.0; }
+    static Pixel       Random()              { return Pixel(std::rand()) / Pixel(RAND_MAX); }
+    static double      Quantize(double x)    { return x; }
+}; // ConversionFormat
+
+template <>
+struct ConversionFormat<uint8_t>
+{
+    static const char *Name()                { return "8-bit"; }
+    static double      Scale()               { return 255.0; }
+    static uint8_t     Random()              { return uint8_t(std::rand() & 0xff); }
+    static double      Quantize(double x)    { return std::floor(std::min(std::max(x, 0.0), 1.0) * 255.0 + 0.5) / 255.0; }
+}; // ConversionFormat<uint8_t>
+
+template <>
+struct ConversionFormat<uint16_t>
+{
+    static const char *Name()                { return "16-bit"; }
+    static double      Scale()               { return 65535.0; }
+    static uint16_t    Random()              { return uint16_t(std::rand() & 0xffff); }
+    static double      Quantize(double x)    { return std::floor(std::min(std::max(x, 0.0), 1.0) * 65535.0 + 0.5) / 65535.0; }
+}; // ConversionFormat<uint16_t>
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Timing
+
+//---------------------------------------------------------------------------
+//
+// Best of five runs of at least a quarter second, in megapixels per second.
+//
+//---------------------------------------------------------------------------
+
+template <typename Function>
+static double ConversionRate(const std::size_t &nPixels, Function f)
+{
+    typedef std::chrono::steady_clock Clock;
+    
+    double nBest = 0.0;
+    
+    for( std::size_t k = 0; k < 5; ++k )
+    {
+        std::size_t nIterations = 0;
+        
+        Clock::time_point tStart = Clock::now();
+        Clock::duration   tTotal;
+        
+        do
+        {
+            f();
+            
+            ++nIterations;
+            
+            tTotal = Clock::now() - tStart;
+        }
+        while( tTotal < std::chrono::milliseconds(250) );
+        
+        double s = std::chrono::duration<double>(tTotal).count();
+        double r = double(nIterations * nPixels) / s * 1.0e-6;
+        
+        nBest = std::max(nBest, r);
+    } // for
+    
+    return nBest;
+} // ConversionRate
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Benchmarks
+
+//---------------------------------------------------------------------------
+
+static const std::size_t kFrameWidth  = 1920;
+static const std::size_t kFrameHeight = 1080;
+static const std::size_t kFramePixels = kFrameWidth * kFrameHeight;
+
+//---------------------------------------------------------------------------
+
+template <typename Pixel>
+static bool ConversionBenchmark(Color::Conversion<float> &rConversion,
+                                const std::size_t &nLattice,
+                                const double &nMaxDeltaE)
+{
+    typedef ConversionFormat<Pixel> Format;
+    
+    std::vector<Pixel> src(4 * kFramePixels);
+    std::vector<Pixel> dst(4 * kFramePixels);
+    
+    std::size_t i;
+    
+    rConversion.SetLattice(nLattice);
+    
+    // Timed on a smooth frame, of ramps in red, green and blue
+    
+    for( i = 0; i < kFramePixels; ++i )
+    {
+        double x = double(i % kFrameWidth) / double(kFrameWidth - 1);
+        double y = double(i / kFrameWidth) / double(kFrameHeight - 1);
+        
+        src[4 * i]     = Pixel(x * Format::Scale());
+        src[4 * i + 1] = Pixel(y * Format::Scale());
+        src[4 * i + 2] = Pixel(0.5 * (x + y) * Format::Scale());
+        src[4 * i + 3] = Pixel(Format::Scale());
+    } // for
+    
+    double nRate = ConversionRate(kFramePixels, [&]() {
+        rConversion.Convert(kFramePixels, 4, &src[0], &dst[0]);
+    });
+    
+    double nCopy = ConversionRate(kFramePixels, [&]() {
+        std::memcpy(&dst[0], &src[0], src.size() * sizeof(Pixel));
+    });
+    
+    // Checked on random pixels
+    
+    for( i = 0; i < src.size(); ++i )
+    {
+        src[i] = Format::Random();
+    } // for
+    
+    rConversion.Convert(kFramePixels, 4, &src[0], &dst[0]);
+    
+    // Delta E against the exact conversion, quantized the same way
+    
+    double nMax  = 0.0;
+    double nMean = 0.0;
+    
+    bool bAlpha = true;
+    
+    const std::size_t nStep = 7;
+    
+    for( i = 0; i < kFramePixels; i += nStep )
+    {
+        double in[3], ref[3], out[3];
+        
+        for( int k = 0; k < 3; ++k )
+        {
+            in[k]  = double(src[4 * i + k]) / Format::Scale();
+            out[k] = double(dst[4 * i + k]) / Format::Scale();
+        } // for
+        
+        ConversionReference(in, ref);
+        
+        for( int k = 0; k < 3; ++k )
+        {
+            ref[k] = Format::Quantize(ref[k]);
+        } // for
+        
+        double e = ConversionDeltaE(ref, out);
+        
+        nMax   = std::max(nMax, e);
+        nMean += e;
+        
+        bAlpha = bAlpha && ( dst[4 * i + 3] == src[4 * i + 3] );
+    } // for
+    
+    nMean /= double((kFramePixels + nStep - 1) / nStep);
+    
+    bool bPassed = bAlpha && ( nMax <= nMaxDeltaE );
+    
+    char pPath[32];
+    
+    if( nLattice )
+    {
+        std::snprintf(pPath, 32, "lattice %zu", nLattice);
+    } // if
+    else
+    {
+        std::snprintf(pPath, 32, "tables");
+    } // else
+    
+    std::printf("%-7s %-11s %10.2e %10.2e %8.2f %9.1f %9.1f  %s\n",
+                Format::Name(), pPath, nMean, nMax, nMaxDeltaE, nRate, nCopy,
+                bPassed ? "ok" : "FAILED");
+    
+    return bPassed;
+} // ConversionBenchmark
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Public - Main
+
+//---------------------------------------------------------------------------
+
+int main(int argc, const char * argv[])
+{
+    Math::Matrix3<float> D, A, R;
+    
+    for( std::size_t i = 0; i < 3; ++i )
+    {
+        for( std::size_t j = 0; j < 3; ++j )
+        {
+            D(i,j) = float(kDisplay[3 * i + j]);
+            A(i,j) = float(kAdaptation[3 * i + j]);
+            R(i,j) = float(kRec709Inv[3 * i + j]);
+        } // for
+    } // for
+    
+    Color::Conversion<float> conversion(Math::tr(D), A, Math::tr(R), float(kGamma));
+    
+    // The exact conversion should match the reference to float precision
+    
+    double nExact = 0.0;
+    
+    std::srand(1);
+    
+    for( std::size_t i = 0; i < 100000; ++i )
+    {
+        double in[3] = { double(std::rand()) / RAND_MAX, double(std::rand()) / RAND_MAX, double(std::rand()) / RAND_MAX };
+        double ref[3], out[3];
+        
+        ConversionReference(in, ref);
+        
+        Math::Vector3<float> v = conversion(Math::Vector3<float>(float(in[0]), float(in[1]), float(in[2])));
+        
+        out[0] = v.x; out[1] = v.y; out[2] = v.z;
+        
+        nExact = std::max(nExact, ConversionDeltaE(ref, out));
+    } // for
+    
+    bool bPassed = nExact <= 1.0e-3;
+    
+    std::vector< Math::Vector3<float> > pixels(kFrameWidth, Math::Vector3<float>(0.25f, 0.5f, 0.75f));
+    
+    double nExactRate = ConversionRate(kFrameWidth, [&]() {
+        for( std::size_t i = 0; i < kFrameWidth; ++i )
+        {
+            pixels[i] = conversion(pixels[i]);
+        } // for
+    });
+    
+    std::printf("exact conversion, max Delta E %.2e, %.1f MPix/s  %s\n", nExact, nExactRate, bPassed ? "ok" : "FAILED");
+    
+    // From working spaces, sRGB primaries with a D50 white to Rec 709,
+    // white should go to white
+    
+    const float pD50[8] = { 0.64f, 0.33f, 0.30f, 0.60f, 0.15f, 0.06f, 0.3457f, 0.3585f };
+    const float pD65[8] = { 0.64f, 0.33f, 0.30f, 0.60f, 0.15f, 0.06f, 0.312713f, 0.329016f };
+    
+    Color::Conversion<float> spaces(pD50, pD65);
+    
+    Math::Vector3<float> w = spaces.GetMatrix() * Math::Vector3<float>(1.0f, 1.0f, 1.0f);
+    
+    double nWhite = std::max(std::fabs(w.x - 1.0), std::max(std::fabs(w.y - 1.0), std::fabs(w.z - 1.0)));
+    
+    // The Bradford matrices are given to four places
+    
+    bPassed &= nWhite <= 1.0e-3;
+    
+    std::printf("working spaces, white error %.2e  %s\n\n", nWhite, ( nWhite <= 1.0e-3 ) ? "ok" : "FAILED");
+    
+    std::printf("%-7s %-11s %10s %10s %8s %9s %9s\n", "format", "path", "mean dE", "max dE", "limit", "MPix/s", "memcpy");
+    
+    // Integer results may round the other way from the reference; one
+    // 8-bit step is up to about 2 Delta E in the darkest colors.
+    
+    bPassed &= ConversionBenchmark<uint8_t>(conversion, 0, 2.5);
+    bPassed &= ConversionBenchmark<uint8_t>(conversion, 33, 2.5);
+    bPassed &= ConversionBenchmark<uint16_t>(conversion, 0, 0.02);
+    bPassed &= ConversionBenchmark<uint16_t>(conversion, 33, 1.0);
+    bPassed &= ConversionBenchmark<uint16_t>(conversion, 65, 0.5);
+    bPassed &= ConversionBenchmark<float>(conversion, 0, 0.02);
+    bPassed &= ConversionBenchmark<float>(conversion, 65, 0.5);
+    
+    // 8-bit buffers always use the tables, whatever the lattice
+    
+    std::vector<uint8_t> src8(4 * kFrameWidth), tables8(4 * kFrameWidth), lattice8(4 * kFrameWidth);
+    
+    for( std::size_t i = 0; i < src8.size(); ++i )
+    {
+        src8[i] = ConversionFormat<uint8_t>::Random();
+    } // for
+    
+    conversion.SetLattice(0);
+    conversion.Convert(kFrameWidth, 4, &src8[0], &tables8[0]);
+    
+    conversion.SetLattice(33);
+    conversion.Convert(kFrameWidth, 4, &src8[0], &lattice8[0]);
+    
+    bool bTables8 = tables8 == lattice8;
+    
+    // And in place, as RGB
+    
+    conversion.Convert(kFrameWidth, 3, &src8[0], &tables8[0]);
+    conversion.Convert(4 * kFrameWidth / 3, 3, &src8[0], &src8[0]);
+    
+    bTables8 = bTables8 && ( std::memcmp(&src8[0], &tables8[0], 3 * kFrameWidth) == 0 );
+    
+    std::printf("\n8-bit lattice ignored  %s\n", bTables8 ? "ok" : "FAILED");
+    
+    bPassed &= bTables8;
+    
+    std::printf("\n%s\n", bPassed ? "all conversions within tolerance" : "CONVERSION ERROR");
+    
+    return bPassed ? EXIT_SUCCESS : EXIT_FAILURE;
+} // main
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
@@ -0,0 +1,463 @@
+/*
+     File: Batch.cpp
+ Abstract: 
+ Structure-of-arrays batch operations for 3-vectors and quaternions.
+ 
+  Version: 1.2
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+ Inc. ("Apple") in consideration of your agreement to the following
+ terms, and your use, installation, modification or redistribution of
+ this Apple software constitutes acceptance of these terms.  If you do
+ not agree with these terms, please do not use, install, modify or
+ redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software.
+ Neither the name, trademarks, service marks or logos of Apple Inc. may
+ be used to endorse or promote products derived from the Apple Software
+ without specific prior written permission from Apple.  Except as
+ expressly stated in this notice, no other rights or licenses, express or
+ implied, are granted by Apple herein, including but not limited to any
+ patent rights that may be infringed by your derivative works or by other
+ works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2013 Apple Inc. All Rights Reserved.
+ 
+ */
+
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+
+#import "BatchPack.h"
+#import "Batch.h"
+
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Kernels
+
+//------------------------------------------------------------------------------------
+//
+// Each kernel starts at element i, stops before the first pack that does not fit, and
+// returns where it stopped.  The operations are done in the same order as in the scalar
+// operators, so that the results are the same.
+//
+//------------------------------------------------------------------------------------
+
+template <typename Type, typename Pack>
+static std::size_t BatchTransform(std::size_t i,
+								  const std::size_t &n,
+								  const Math::Matrix3<Type> &A,
+								  const Math::Vector3Array<Type> &v,
+								  Math::Vector3Array<Type> &w)
+{
+	typedef typename Pack::Reg Reg;
+	
+	const Type *a = A.matrix;
+	
+	const Reg a_11 = Pack::splat(a[0]), a_12 = Pack::splat(a[1]), a_13 = Pack::splat(a[2]);
+	const Reg a_21 = Pack::splat(a[3]), a_22 = Pack::splat(a[4]), a_23 = Pack::splat(a[5]);
+	const Reg a_31 = Pack::splat(a[6]), a_32 = Pack::splat(a[7]), a_33 = Pack::splat(a[8]);
+	
+	for(; i + Pack::kWidth <= n; i += Pack::kWidth)
+	{
+		const Reg x = Pack::load(v.x + i);
+		const Reg y = Pack::load(v.y + i);
+		const Reg z = Pack::load(v.z + i);
+		
+		Pack::store(w.x + i, Pack::add(Pack::add(Pack::mul(x, a_11), Pack::mul(y, a_12)), Pack::mul(z, a_13)));
+		Pack::store(w.y + i, Pack::add(Pack::add(Pack::mul(x, a_21), Pack::mul(y, a_22)), Pack::mul(z, a_23)));
+		Pack::store(w.z + i, Pack::add(Pack::add(Pack::mul(x, a_31), Pack::mul(y, a_32)), Pack::mul(z, a_33)));
+	} // for
+	
+	return i;
+} // BatchTransform
+
+//------------------------------------------------------------------------------------
+//
+// As norml(v), vectors already within 1e-7 of unit length are left alone.
+//
+//------------------------------------------------------------------------------------
+
+template <typename Type, typename Pack>
+static std::size_t BatchNormalize(std::size_t i,
+								  const std::size_t &n,
+								  const Math::Vector3Array<Type> &v,
+								  Math::Vector3Array<Type> &w)
+{
+	typedef typename Pack::Reg  Reg;
+	typedef typename Pack::Mask Mask;
+	
+	const Reg kOne = Pack::splat(Type(1));
+	const Reg kEps = Pack::splat(Type(1e-7));
+	const Reg kNeg = Pack::splat(-Type(1e-7));
+	
+	for(; i + Pack::kWidth <= n; i += Pack::kWidth)
+	{
+		const Reg x = Pack::load(v.x + i);
+		const Reg y = Pack::load(v.y + i);
+		const Reg z = Pack::load(v.z + i);
+		
+		Reg L = Pack::sqrt(Pack::add(Pack::add(Pack::mul(x, x), Pack::mul(y, y)), Pack::mul(z, z)));
+		Reg D = Pack::sub(L, kOne);
+		
+		const Mask m = Pack::any(Pack::gt(D, kEps), Pack::lt(D, kNeg));
+		
+		L = Pack::div(kOne, L);
+		
+		Pack::store(w.x + i, Pack::select(m, Pack::mul(x, L), x));
+		Pack::store(w.y + i, Pack::select(m, Pack::mul(y, L), y));
+		Pack::store(w.z + i, Pack::select(m, Pack::mul(z, L), z));
+	} // for
+	
+	return i;
+} // BatchNormalize
+
+//------------------------------------------------------------------------------------
+
+template <typename Type, typename Pack>
+static std::size_t BatchMult(std::size_t i,
+							 const std::size_t &n,
+							 const Math::QuaternionArray<Type> &u,
+							 const Math::QuaternionArray<Type> &v,
+							 Math::QuaternionArray<Type> &w)
+{
+	typedef typename Pack::Reg Reg;
+	
+	for(; i + Pack::kWidth <= n; i += Pack::kWidth)
+	{
+		const Reg ut = Pack::load(u.t + i), ux = Pack::load(u.x + i);
+		const Reg uy = Pack::load(u.y + i), uz = Pack::load(u.z + i);
+		const Reg vt = Pack::load(v.t + i), vx = Pack::load(v.x + i);
+		const Reg vy = Pack::load(v.y + i), vz = Pack::load(v.z + i);
+		
+		Reg r;
+		
+		r = Pack::sub(Pack::mul(vt, ut), Pack::mul(vx, ux));
+		r = Pack::sub(r, Pack::mul(vy, uy));
+		r = Pack::sub(r, Pack::mul(vz, uz));
+		
+		Pack::store(w.t + i, r);
+		
+		r = Pack::sub(Pack::mul(vy, uz), Pack::mul(vz, uy));
+		r = Pack::add(r, Pack::mul(vt, ux));
+		r = Pack::add(r, Pack::mul(vx, ut));
+		
+		Pack::store(w.x + i, r);
+		
+		r = Pack::sub(Pack::mul(vz, ux), Pack::mul(vx, uz));
+		r = Pack::add(r, Pack::mul(vt, uy));
+		r = Pack::add(r, Pack::mul(vy, ut));
+		
+		Pack::store(w.y + i, r);
+		
+		r = Pack::sub(Pack::mul(vx, uy), Pack::mul(vy, ux));
+		r = Pack::add(r, Pack::mul(vt, uz));
+		r = Pack::add(r, Pack::mul(vz, ut));
+		
+		Pack::store(w.z + i, r);
+	} // for
+	
+	return i;
+} // BatchMult
+
+//------------------------------------------------------------------------------------
+//
+// The slerp weights sin(t a)/sin(a), with cos(a) = c, expanded as a series in c - 1
+// after D. Eberly, "A Fast and Accurate Algorithm for Computing SLERP":
+//
+//		sin(t a)/sin(a) = t (1 + b_1 (1 + b_2 (1 + ...))),
+//		b_k = (t^2 - k^2)/(k (2k + 1)) (c - 1)
+//
+// With c in [0,1] each factor is at most 1/2, so 20 terms are enough for floats and
+// 48 for doubles.  There are no branches, so this vectorizes where acos and sin do not.
+//
+//------------------------------------------------------------------------------------
+
+template <typename Type>
+struct BatchSlerpTerms
+{
+	static const std::size_t kCount = 48;
+}; // BatchSlerpTerms
+
+template <>
+struct BatchSlerpTerms<float>
+{
+	static const std::size_t kCount = 20;
+}; // BatchSlerpTerms<float>
+
+template <typename Type, typename Pack>
+static inline void BatchSlerpWeights(typename Pack::Reg &s0,
+									 typename Pack::Reg &s1,
+									 const typename Pack::Reg &cm1,
+									 const Type * const pU,
+									 const Type * const pV)
+{
+	typedef typename Pack::Reg Reg;
+	
+	const Reg kOne = Pack::splat(Type(1));
+	const Reg t0   = Pack::mul(s0, s0);
+	const Reg t1   = Pack::mul(s1, s1);
+	
+	Reg r0 = kOne;
+	Reg r1 = kOne;
+	
+	for(std::size_t k = BatchSlerpTerms<Type>::kCount; k > 0; --k)
+	{
+		const Reg u = Pack::splat(pU[k-1]);
+		const Reg v = Pack::splat(pV[k-1]);
+		
+		r0 = Pack::add(kOne, Pack::mul(Pack::mul(Pack::sub(Pack::mul(u, t0), v), cm1), r0));
+		r1 = Pack::add(kOne, Pack::mul(Pack::mul(Pack::sub(Pack::mul(u, t1), v), cm1), r1));
+	} // for
+	
+	s0 = Pack::mul(s0, r0);
+	s1 = Pack::mul(s1, r1);
+} // BatchSlerpWeights
+
+template <typename Type, typename Pack>
+static std::size_t BatchSlerp(std::size_t i,
+							  const std::size_t &n,
+							  const Math::QuaternionArray<Type> &u,
+							  const Math::QuaternionArray<Type> &v,
+							  const Type * const t,
+							  const Type * const pU,
+							  const Type * const pV,
+							  Math::QuaternionArray<Type> &w)
+{
+	typedef typename Pack::Reg Reg;
+	
+	const Reg kZero = Pack::splat(Type(0));
+	const Reg kOne  = Pack::splat(Type(1));
+	const Reg kNeg  = Pack::splat(-Type(1));
+	
+	for(; i + Pack::kWidth <= n; i += Pack::kWidth)
+	{
+		const Reg ut = Pack::load(u.t + i), ux = Pack::load(u.x + i);
+		const Reg uy = Pack::load(u.y + i), uz = Pack::load(u.z + i);
+		const Reg vt = Pack::load(v.t + i), vx = Pack::load(v.x + i);
+		const Reg vy = Pack::load(v.y + i), vz = Pack::load(v.z + i);
+		
+		Reg c = Pack::mul(ut, vt);
+		
+		c = Pack::add(c, Pack::mul(ux, vx));
+		c = Pack::add(c, Pack::mul(uy, vy));
+		c = Pack::add(c, Pack::mul(uz, vz));
+		
+		// take the shorter arc
+		const Reg s = Pack::select(Pack::lt(c, kZero), kNeg, kOne);
+		
+		c = Pack::mul(c, s);
+		
+		const Reg cm1 = Pack::sub(c, kOne);
+		
+		// In: the interpolation parameters, out: the weights of u and v
+		Reg s1 = Pack::load(t + i);
+		Reg s0 = Pack::sub(kOne, s1);
+		
+		BatchSlerpWeights<Type,Pack>(s0, s1, cm1, pU, pV);
+		
+		s1 = Pack::mul(s1, s);
+		
+		Pack::store(w.t + i, Pack::add(Pack::mul(s0, ut), Pack::mul(s1, vt)));
+		Pack::store(w.x + i, Pack::add(Pack::mul(s0, ux), Pack::mul(s1, vx)));
+		Pack::store(w.y + i, Pack::add(Pack::mul(s0, uy), Pack::mul(s1, vy)));
+		Pack::store(w.z + i, Pack::add(Pack::mul(s0, uz), Pack::mul(s1, vz)));
+	} // for
+	
+	return i;
+} // BatchSlerp
+
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Dispatch
+
+//------------------------------------------------------------------------------------
+
+template <typename Type>
+static void Vector3Transform(const std::size_t &n,
+							 const Math::Matrix3<Type> &A,
+							 const Math::Vector3Array<Type> &v,
+							 Math::Vector3Array<Type> &w)
+{
+	std::size_t i = BatchTransform<Type, BatchPack<Type> >(0, n, A, v, w);
+	
+	BatchTransform<Type, BatchScalar<Type> >(i, n, A, v, w);
+} // Vector3Transform
+
+//------------------------------------------------------------------------------------
+
+template <typename Type>
+static void Vector3Normalize(const std::size_t &n,
+							 const Math::Vector3Array<Type> &v,
+							 Math::Vector3Array<Type> &w)
+{
+	std::size_t i = BatchNormalize<Type, BatchPack<Type> >(0, n, v, w);
+	
+	BatchNormalize<Type, BatchScalar<Type> >(i, n, v, w);
+} // Vector3Normalize
+
+//------------------------------------------------------------------------------------
+
+template <typename Type>
+static void QuaternionMult(const std::size_t &n,
+						   const Math::QuaternionArray<Type> &u,
+						   const Math::QuaternionArray<Type> &v,
+						   Math::QuaternionArray<Type> &w)
+{
+	std::size_t i = BatchMult<Type, BatchPack<Type> >(0, n, u, v, w);
+	
+	BatchMult<Type, BatchScalar<Type> >(i, n, u, v, w);
+} // QuaternionMult
+
+//------------------------------------------------------------------------------------
+
+template <typename Type>
+static void QuaternionSlerp(const std::size_t &n,
+							const Math::QuaternionArray<Type> &u,
+							const Math::QuaternionArray<Type> &v,
+							const Type * const t,
+							Math::QuaternionArray<Type> &w)
+{
+	const std::size_t kCount = BatchSlerpTerms<Type>::kCount;
+	
+	Type pU[kCount];
+	Type pV[kCount];
+	
+	// b_k = (u_k t^2 - v_k) (c - 1)
+	for(std::size_t k = 1; k <= kCount; ++k)
+	{
+		pU[k-1] = Type(1) / Type(k * (2 * k + 1));
+		pV[k-1] = Type(k) / Type(2 * k + 1);
+	} // for
+	
+	std::size_t i = BatchSlerp<Type, BatchPack<Type> >(0, n, u, v, t, pU, pV, w);
+	
+	BatchSlerp<Type, BatchScalar<Type> >(i, n, u, v, t, pU, pV, w);
+} // QuaternionSlerp
+
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Public - Vectors
+
+//------------------------------------------------------------------------------------
+
+void Math::transform(const std::size_t &n,
+					 const Math::Matrix3<double> &A,
+					 const Math::Vector3Array<double> &v,
+					 Math::Vector3Array<double> &w)
+{
+	Vector3Transform<double>(n, A, v, w);
+} // transform
+
+//------------------------------------------------------------------------------------
+
+void Math::transform(const std::size_t &n,
+					 const Math::Matrix3<float> &A,
+					 const Math::Vector3Array<float> &v,
+					 Math::Vector3Array<float> &w)
+{
+	Vector3Transform<float>(n, A, v, w);
+} // transform
+
+//------------------------------------------------------------------------------------
+
+void Math::norml(const std::size_t &n,
+				 const Math::Vector3Array<double> &v,
+				 Math::Vector3Array<double> &w)
+{
+	Vector3Normalize<double>(n, v, w);
+} // norml
+
+//------------------------------------------------------------------------------------
+
+void Math::norml(const std::size_t &n,
+				 const Math::Vector3Array<float> &v,
+				 Math::Vector3Array<float> &w)
+{
+	Vector3Normalize<float>(n, v, w);
+} // norml
+
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Public - Quaternions
+
+//------------------------------------------------------------------------------------
+
+void Math::mult(const std::size_t &n,
+				const Math::QuaternionArray<double> &u,
+				const Math::QuaternionArray<double> &v,
+				Math::QuaternionArray<double> &w)
+{
+	QuaternionMult<double>(n, u, v, w);
+} // mult
+
+//------------------------------------------------------------------------------------
+
+void Math::mult(const std::size_t &n,
+				const Math::QuaternionArray<float> &u,
+				const Math::QuaternionArray<float> &v,
+				Math::QuaternionArray<float> &w)
+{
+	QuaternionMult<float>(n, u, v, w);
+} // mult
+
+//------------------------------------------------------------------------------------
+
+void Math::slerp(const std::size_t &n,
+				 const Math::QuaternionArray<double> &u,
+				 const Math::QuaternionArray<double> &v,
+				 const double * const t,
+				 Math::QuaternionArray<double> &w)
+{
+	QuaternionSlerp<double>(n, u, v, t, w);
+} // slerp
+
+//------------------------------------------------------------------------------------
+
+void Math::slerp(const std::size_t &n,
+				 const Math::QuaternionArray<float> &u,
+				 const Math::QuaternionArray<float> &v,
+				 const float * const t,
+				 Math::QuaternionArray<float> &w)
+{
+	QuaternionSlerp<float>(n, u, v, t, w);
+} // slerp
+
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
@@ -0,0 +1,112 @@
+/*
+     File: Batch.h
+ Abstract: 
+ Structure-of-arrays batch operations for 3-vectors and quaternions.
+ 
+  Version: 1.2
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+ Inc. ("Apple") in consideration of your agreement to the following
+ terms, and your use, installation, modification or redistribution of
+ this Apple software constitutes acceptance of these terms.  If you do
+ not agree with these terms, please do not use, install, modify or
+ redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software.
+ Neither the name, trademarks, service marks or logos of Apple Inc. may
+ be used to endorse or promote products derived from the Apple Software
+ without specific prior written permission from Apple.  Except as
+ expressly stated in this notice, no other rights or licenses, express or
+ implied, are granted by Apple herein, including but not limited to any
+ patent rights that may be infringed by your derivative works or by other
+ works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2013 Apple Inc. All Rights Reserved.
+ 
+ */
+
+#ifndef _MATH_BATCH_H_
+#define _MATH_BATCH_H_
+
+#ifdef __cplusplus
+
+#import <cstddef>
+
+#import "Vector.h"
+#import "Matrix3.h"
+#import "Quaternion.h"
+
+//------------------------------------------------------------------------------------
+//
+// Batch versions of the Matrix3, Vector3 and Quaternion operators.  The elements are
+// stored as a structure of arrays, so a batch of n vectors is three arrays of n
+// components each, and whole SIMD registers of elements are processed per step
+// (AVX, SSE2 or NEON, whichever the target was compiled for, else scalar code).
+//
+// Each result matches the corresponding scalar operator, up to rounding when the
+// compiler fuses the scalar multiply-adds.  Output arrays may be the input arrays.
+//
+//------------------------------------------------------------------------------------
+
+namespace Math
+{
+	template <typename Type>
+	struct Vector3Array
+	{
+		Type *x;
+		Type *y;
+		Type *z;
+	}; // Vector3Array
+	
+	template <typename Type>
+	struct QuaternionArray
+	{
+		Type *t;
+		Type *x;
+		Type *y;
+		Type *z;
+	}; // QuaternionArray
+	
+	// w[i] = A * v[i]
+	void transform(const std::size_t &n, const Matrix3<double> &A, const Vector3Array<double> &v, Vector3Array<double> &w);
+	void transform(const std::size_t &n, const Matrix3<float>  &A, const Vector3Array<float>  &v, Vector3Array<float>  &w);
+	
+	// w[i] = norml(v[i])
+	void norml(const std::size_t &n, const Vector3Array<double> &v, Vector3Array<double> &w);
+	void norml(const std::size_t &n, const Vector3Array<float>  &v, Vector3Array<float>  &w);
+	
+	// w[i] = u[i] ^ v[i], the Hamilton product
+	void mult(const std::size_t &n, const QuaternionArray<double> &u, const QuaternionArray<double> &v, QuaternionArray<double> &w);
+	void mult(const std::size_t &n, const QuaternionArray<float>  &u, const QuaternionArray<float>  &v, QuaternionArray<float>  &w);
+	
+	// w[i] = slerp(u[i], v[i], t[i]), where the weights come from a polynomial rather
+	// than from acos and sin, accurate to about the precision of the type.
+	void slerp(const std::size_t &n, const QuaternionArray<double> &u, const QuaternionArray<double> &v, const double * const t, QuaternionArray<double> &w);
+	void slerp(const std::size_t &n, const QuaternionArray<float>  &u, const QuaternionArray<float>  &v, const float  * const t, QuaternionArray<float>  &w);
+} // Math
+
+#endif
+
+#endif
@@ -0,0 +1,414 @@
+/*
+     File: BatchBenchmark.cpp
+ Abstract: 
+ Checks the batch operations against the scalar operators and times both.
+ 
+ Build, for example, with
+ 
+   c++ -std=c++11 -O2 -mavx -I. -I../Vectors -I../Matrices -I../Quaternions \
+       BatchBenchmark.cpp Batch.cpp ../Vectors/Vector2.cpp ../Vectors/Vector3.cpp \
+       ../Matrices/Matrix3.cpp ../Quaternions/Quaternion.cpp -o BatchBenchmark
+ 
+  Version: 1.2
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+ Inc. ("Apple") in consideration of your agreement to the following
+ terms, and your use, installation, modification or redistribution of
+ this Apple software constitutes acceptance of these terms.  If you do
+ not agree with these terms, please do not use, install, modify or
+ redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software.
+ Neither the name, trademarks, service marks or logos of Apple Inc. may
+ be used to endorse or promote products derived from the Apple Software
+ without specific prior written permission from Apple.  Except as
+ expressly stated in this notice, no other rights or licenses, express or
+ implied, are granted by Apple herein, including but not limited to any
+ patent rights that may be infringed by your derivative works or by other
+ works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2013 Apple Inc. All Rights Reserved.
+ 
+ */
+
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+
+#import <chrono>
+#import <cmath>
+#import <cstdio>
+#import <cstdlib>
+#import <limits>
+#import <vector>
+
+//------------------------------------------------------------------------------------
+
+#import "Batch.h"
+
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Data
+
+//------------------------------------------------------------------------------------
+
+static const std::size_t kBatchSize = 4099;  // Not a multiple of any register width
+
+//------------------------------------------------------------------------------------
+
+template <typename Type>
+struct BatchData
+{
+	std::vector<Type> m_Storage;
+	
+	Math::Vector3Array<Type>    v;
+	Math::Vector3Array<Type>    w;
+	Math::QuaternionArray<Type> p;
+	Math::QuaternionArray<Type> q;
+	Math::QuaternionArray<Type> r;
+	
+	Type *t;
+	
+	BatchData()
+	{
+		m_Storage.resize(19 * kBatchSize);
+		
+		Type *pData = &m_Storage[0];
+		
+		Type **pArrays[19] =
+		{
+			&v.x, &v.y, &v.z, &w.x, &w.y, &w.z,
+			&p.t, &p.x, &p.y, &p.z, &q.t, &q.x, &q.y, &q.z,
+			&r.t, &r.x, &r.y, &r.z, &t
+		};
+		
+		for(std::size_t k = 0; k < 19; ++k)
+		{
+			*pArrays[k] = pData + k * kBatchSize;
+		} // for
+		
+		std::srand(1);
+		
+		for(std::size_t i = 0; i < kBatchSize; ++i)
+		{
+			v.x[i] = random(-4, 4);
+			v.y[i] = random(-4, 4);
+			v.z[i] = random(-4, 4);
+			
+			// Unit quaternions, with every fourth pair nearly or exactly equal
+			Math::Quaternion<Type> a(random(-1, 1), random(-1, 1), random(-1, 1), random(-1, 1));
+			Math::Quaternion<Type> b(random(-1, 1), random(-1, 1), random(-1, 1), random(-1, 1));
+			
+			a = Math::norml(a);
+			b = Math::norml(b);
+			
+			if((i % 4) == 0)
+			{
+				b = a;
+				
+				b.x += Type(i % 8) * std::numeric_limits<Type>::epsilon();
+				
+				b = Math::norml(b);
+			} // if
+			
+			p.t[i] = a.t; p.x[i] = a.x; p.y[i] = a.y; p.z[i] = a.z;
+			q.t[i] = b.t; q.x[i] = b.x; q.y[i] = b.y; q.z[i] = b.z;
+			
+			t[i] = random(0, 1);
+		} // for
+		
+		// Some vectors already of unit length, which norml leaves alone
+		for(std::size_t i = 0; i < kBatchSize; i += 5)
+		{
+			Math::Vector3<Type> u = Math::norml(Math::Vector3<Type>(v.x[i], v.y[i], v.z[i]));
+			
+			v.x[i] = u.x; v.y[i] = u.y; v.z[i] = u.z;
+		} // for
+	} // BatchData
+	
+	static Type random(const Type &a, const Type &b)
+	{
+		return a + (b - a) * Type(std::rand()) / Type(RAND_MAX);
+	} // random
+}; // BatchData
+
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Timing
+
+//------------------------------------------------------------------------------------
+//
+// Runs a function repeatedly for at least a quarter second, and reports the best of
+// five such runs in nanoseconds per element.
+//
+//------------------------------------------------------------------------------------
+
+template <typename Function>
+static double BatchTime(Function f)
+{
+	typedef std::chrono::steady_clock Clock;
+	
+	double nBest = std::numeric_limits<double>::max();
+	
+	for(std::size_t k = 0; k < 5; ++k)
+	{
+		std::size_t nIterations = 0;
+		
+		Clock::time_point tStart = Clock::now();
+		Clock::duration   tTotal;
+		
+		do
+		{
+			f();
+			
+			++nIterations;
+			
+			tTotal = Clock::now() - tStart;
+		}
+		while(tTotal < std::chrono::milliseconds(250));
+		
+		double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(tTotal).count());
+		
+		ns /= double(nIterations * kBatchSize);
+		
+		if(ns < nBest)
+		{
+			nBest = ns;
+		} // if
+	} // for
+	
+	return nBest;
+} // BatchTime
+
+//------------------------------------------------------------------------------------
+
+template <typename Type>
+static double BatchError(const Type &a, const Type &b)
+{
+	double e = std::fabs(double(a) - double(b));
+	
+	return e / std::max(1.0, std::fabs(double(b)));
+} // BatchError
+
+//------------------------------------------------------------------------------------
+
+static bool BatchReport(const char * const pName,
+						const double &nError,
+						const double &nTolerance,
+						const double &nScalar,
+						const double &nBatch)
+{
+	bool bPassed = nError <= nTolerance;
+	
+	if(nBatch > 0.0)
+	{
+		std::printf("%-16s %10.3e %10.3e %9.2f %9.2f %7.2fx  %s\n",
+					pName, nError, nTolerance, nScalar, nBatch, nScalar / nBatch,
+					bPassed ? "ok" : "FAILED");
+	} // if
+	else
+	{
+		std::printf("%-16s %10.3e %10.3e %29s %s\n",
+					pName, nError, nTolerance, "", bPassed ? "ok" : "FAILED");
+	} // else
+	
+	return bPassed;
+} // BatchReport
+
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Benchmarks
+
+//------------------------------------------------------------------------------------
+
+template <typename Type>
+static bool BatchBenchmark(const char * const pType,
+						   const double &nSlerpTolerance)
+{
+	BatchData<Type> D;
+	
+	const double kEps = 8.0 * double(std::numeric_limits<Type>::epsilon());
+	
+	std::vector< Math::Vector3<Type> >    V(kBatchSize);
+	std::vector< Math::Quaternion<Type> > Q(kBatchSize);
+	
+	Type pA[9] = { 0.36, 0.48, -0.8, -0.8, 0.6, 0.0, 0.48, 0.64, 0.6 };
+	
+	Math::Matrix3<Type> A(true, pA);
+	
+	bool bPassed = true;
+	
+	double nError  = 0.0;
+	double nScalar = 0.0;
+	double nBatch  = 0.0;
+	
+	std::size_t i;
+	
+	// transform
+	
+	nScalar = BatchTime([&]() {
+		for(std::size_t i = 0; i < kBatchSize; ++i)
+		{
+			V[i] = A * Math::Vector3<Type>(D.v.x[i], D.v.y[i], D.v.z[i]);
+		} // for
+	});
+	
+	nBatch = BatchTime([&]() { Math::transform(kBatchSize, A, D.v, D.w); });
+	
+	for(i = 0, nError = 0.0; i < kBatchSize; ++i)
+	{
+		nError = std::max(nError, BatchError(D.w.x[i], V[i].x));
+		nError = std::max(nError, BatchError(D.w.y[i], V[i].y));
+		nError = std::max(nError, BatchError(D.w.z[i], V[i].z));
+	} // for
+	
+	std::printf("\n%-16s %10s %10s %9s %9s %8s\n", pType, "error", "tolerance", "scalar ns", "batch ns", "speedup");
+	
+	bPassed &= BatchReport("transform", nError, kEps, nScalar, nBatch);
+	
+	// norml
+	
+	nScalar = BatchTime([&]() {
+		for(std::size_t i = 0; i < kBatchSize; ++i)
+		{
+			V[i] = Math::norml(Math::Vector3<Type>(D.v.x[i], D.v.y[i], D.v.z[i]));
+		} // for
+	});
+	
+	nBatch = BatchTime([&]() { Math::norml(kBatchSize, D.v, D.w); });
+	
+	for(i = 0, nError = 0.0; i < kBatchSize; ++i)
+	{
+		nError = std::max(nError, BatchError(D.w.x[i], V[i].x));
+		nError = std::max(nError, BatchError(D.w.y[i], V[i].y));
+		nError = std::max(nError, BatchError(D.w.z[i], V[i].z));
+	} // for
+	
+	bPassed &= BatchReport("norml", nError, kEps, nScalar, nBatch);
+	
+	// Hamilton product
+	
+	nScalar = BatchTime([&]() {
+		for(std::size_t i = 0; i < kBatchSize; ++i)
+		{
+			Math::Quaternion<Type> u(D.p.t[i], D.p.x[i], D.p.y[i], D.p.z[i]);
+			Math::Quaternion<Type> v(D.q.t[i], D.q.x[i], D.q.y[i], D.q.z[i]);
+			
+			Q[i] = u ^ v;
+		} // for
+	});
+	
+	nBatch = BatchTime([&]() { Math::mult(kBatchSize, D.p, D.q, D.r); });
+	
+	for(i = 0, nError = 0.0; i < kBatchSize; ++i)
+	{
+		nError = std::max(nError, BatchError(D.r.t[i], Q[i].t));
+		nError = std::max(nError, BatchError(D.r.x[i], Q[i].x));
+		nError = std::max(nError, BatchError(D.r.y[i], Q[i].y));
+		nError = std::max(nError, BatchError(D.r.z[i], Q[i].z));
+	} // for
+	
+	bPassed &= BatchReport("mult", nError, kEps, nScalar, nBatch);
+	
+	// slerp
+	
+	nScalar = BatchTime([&]() {
+		for(std::size_t i = 0; i < kBatchSize; ++i)
+		{
+			Math::Quaternion<Type> u(D.p.t[i], D.p.x[i], D.p.y[i], D.p.z[i]);
+			Math::Quaternion<Type> v(D.q.t[i], D.q.x[i], D.q.y[i], D.q.z[i]);
+			
+			Q[i] = Math::slerp(u, v, D.t[i]);
+		} // for
+	});
+	
+	nBatch = BatchTime([&]() { Math::slerp(kBatchSize, D.p, D.q, D.t, D.r); });
+	
+	for(i = 0, nError = 0.0; i < kBatchSize; ++i)
+	{
+		nError = std::max(nError, BatchError(D.r.t[i], Q[i].t));
+		nError = std::max(nError, BatchError(D.r.x[i], Q[i].x));
+		nError = std::max(nError, BatchError(D.r.y[i], Q[i].y));
+		nError = std::max(nError, BatchError(D.r.z[i], Q[i].z));
+	} // for
+	
+	bPassed &= BatchReport("slerp", nError, nSlerpTolerance, nScalar, nBatch);
+	
+	// In place, output aliasing input
+	
+	Math::Vector3Array<Type> w = D.v;
+	
+	for(i = 0; i < kBatchSize; ++i)
+	{
+		V[i] = A * Math::Vector3<Type>(D.v.x[i], D.v.y[i], D.v.z[i]);
+	} // for
+	
+	Math::transform(kBatchSize, A, D.v, w);
+	
+	for(i = 0, nError = 0.0; i < kBatchSize; ++i)
+	{
+		nError = std::max(nError, BatchError(D.v.x[i], V[i].x));
+		nError = std::max(nError, BatchError(D.v.y[i], V[i].y));
+		nError = std::max(nError, BatchError(D.v.z[i], V[i].z));
+	} // for
+	
+	bPassed &= BatchReport("transform (in)", nError, kEps, 0.0, 0.0);
+	
+	return bPassed;
+} // BatchBenchmark
+
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Public - Main
+
+//------------------------------------------------------------------------------------
+
+int main(int argc, const char * argv[])
+{
+	bool bPassed = true;
+	
+	bPassed &= BatchBenchmark<float>("float", 2.0e-6);
+	bPassed &= BatchBenchmark<double>("double", 1.0e-13);
+	
+	std::printf("\n%s\n", bPassed ? "all batch results match the scalar operators" : "MISMATCH");
+	
+	return bPassed ? EXIT_SUCCESS : EXIT_FAILURE;
+} // main
+
+//------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------
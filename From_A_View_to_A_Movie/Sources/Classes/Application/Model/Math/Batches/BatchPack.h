@@ -0,0 +1,310 @@
+/*
+     File: BatchPack.h
+ Abstract: 
+ Register-wide packs of floats and doubles for the batch kernels.
+ 
+  Version: 1.2
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+ Inc. ("Apple") in consideration of your agreement to the following
+ terms, and your use, installation, modification or redistribution of
+ this Apple software constitutes acceptance of these terms.  If you do
+ not agree with these terms, please do not use, install, modify or
+ redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software.
+ Neither the name, trademarks, service marks or logos of Apple Inc. may
+ be used to endorse or promote products derived from the Apple Software
+ without specific prior written permission from Apple.  Except as
+ expressly stated in this notice, no other rights or licenses, express or
+ implied, are granted by Apple herein, including but not limited to any
+ patent rights that may be infringed by your derivative works or by other
+ works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2013 Apple Inc. All Rights Reserved.
+ 
+ */
+
+#ifndef _MATH_BATCH_PACK_H_
+#define _MATH_BATCH_PACK_H_
+
+#ifdef __cplusplus
+
+#import <cmath>
+#import <cstddef>
+
+#if defined(__AVX__)
+	#import <immintrin.h>
+#elif defined(__SSE2__)
+	#import <emmintrin.h>
+#elif defined(__ARM_NEON)
+	#import <arm_neon.h>
+#endif
+
+//------------------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Packs
+
+//------------------------------------------------------------------------------------
+//
+// A pack is as many elements as fit in one register, with the handful of lane-wise
+// operations the batch kernels need.  The kernels are written once against this
+// interface; the scalar pack runs whatever is left over after the last full register.
+//
+//------------------------------------------------------------------------------------
+
+template <typename Type>
+struct BatchScalar
+{
+	typedef Type Reg;
+	typedef bool Mask;
+	
+	static const std::size_t kWidth = 1;
+	
+	static inline Reg load(const Type * const p)       { return *p; }
+	static inline void store(Type * const p, const Reg &a) { *p = a; }
+	static inline Reg splat(const Type &k)             { return k; }
+	
+	static inline Reg add(const Reg &a, const Reg &b)  { return a + b; }
+	static inline Reg sub(const Reg &a, const Reg &b)  { return a - b; }
+	static inline Reg mul(const Reg &a, const Reg &b)  { return a * b; }
+	static inline Reg div(const Reg &a, const Reg &b)  { return a / b; }
+	static inline Reg sqrt(const Reg &a)               { return std::sqrt(a); }
+	
+	static inline Mask lt(const Reg &a, const Reg &b)  { return a < b; }
+	static inline Mask gt(const Reg &a, const Reg &b)  { return a > b; }
+	static inline Mask any(const Mask &a, const Mask &b) { return a || b; }
+	
+	static inline Reg select(const Mask &m, const Reg &a, const Reg &b) { return m ? a : b; }
+}; // BatchScalar
+
+//------------------------------------------------------------------------------------
+
+template <typename Type>
+struct BatchPack : public BatchScalar<Type>
+{
+}; // BatchPack
+
+//------------------------------------------------------------------------------------
+
+#if defined(__AVX__)
+
+template <>
+struct BatchPack<float>
+{
+	typedef __m256 Reg;
+	typedef __m256 Mask;
+	
+	static const std::size_t kWidth = 8;
+	
+	static inline Reg load(const float * const p)        { return _mm256_loadu_ps(p); }
+	static inline void store(float * const p, const Reg &a) { _mm256_storeu_ps(p, a); }
+	static inline Reg splat(const float &k)              { return _mm256_set1_ps(k); }
+	
+	static inline Reg add(const Reg &a, const Reg &b)    { return _mm256_add_ps(a, b); }
+	static inline Reg sub(const Reg &a, const Reg &b)    { return _mm256_sub_ps(a, b); }
+	static inline Reg mul(const Reg &a, const Reg &b)    { return _mm256_mul_ps(a, b); }
+	static inline Reg div(const Reg &a, const Reg &b)    { return _mm256_div_ps(a, b); }
+	static inline Reg sqrt(const Reg &a)                 { return _mm256_sqrt_ps(a); }
+	
+	static inline Mask lt(const Reg &a, const Reg &b)    { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static inline Mask gt(const Reg &a, const Reg &b)    { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static inline Mask any(const Mask &a, const Mask &b) { return _mm256_or_ps(a, b); }
+	
+	static inline Reg select(const Mask &m, const Reg &a, const Reg &b) { return _mm256_blendv_ps(b, a, m); }
+}; // BatchPack<float>
+
+template <>
+struct BatchPack<double>
+{
+	typedef __m256d Reg;
+	typedef __m256d Mask;
+	
+	static const std::size_t kWidth = 4;
+	
+	static inline Reg load(const double * const p)        { return _mm256_loadu_pd(p); }
+	static inline void store(double * const p, const Reg &a) { _mm256_storeu_pd(p, a); }
+	static inline Reg splat(const double &k)              { return _mm256_set1_pd(k); }
+	
+	static inline Reg add(const Reg &a, const Reg &b)     { return _mm256_add_pd(a, b); }
+	static inline Reg sub(const Reg &a, const Reg &b)     { return _mm256_sub_pd(a, b); }
+	static inline Reg mul(const Reg &a, const Reg &b)     { return _mm256_mul_pd(a, b); }
+	static inline Reg div(const Reg &a, const Reg &b)     { return _mm256_div_pd(a, b); }
+	static inline Reg sqrt(const Reg &a)                  { return _mm256_sqrt_pd(a); }
+	
+	static inline Mask lt(const Reg &a, const Reg &b)     { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+	static inline Mask gt(const Reg &a, const Reg &b)     { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+	static inline Mask any(const Mask &a, const Mask &b)  { return _mm256_or_pd(a, b); }
+	
+	static inline Reg select(const Mask &m, const Reg &a, const Reg &b) { return _mm256_blendv_pd(b, a, m); }
+}; // BatchPack<double>
+
+#elif defined(__SSE2__)
+
+template <>
+struct BatchPack<float>
+{
+	typedef __m128 Reg;
+	typedef __m128 Mask;
+	
+	static const std::size_t kWidth = 4;
+	
+	static inline Reg load(const float * const p)        { return _mm_loadu_ps(p); }
+	static inline void store(float * const p, const Reg &a) { _mm_storeu_ps(p, a); }
+	static inline Reg splat(const float &k)              { return _mm_set1_ps(k); }
+	
+	static inline Reg add(const Reg &a, const Reg &b)    { return _mm_add_ps(a, b); }
+	static inline Reg sub(const Reg &a, const Reg &b)    { return _mm_sub_ps(a, b); }
+	static inline Reg mul(const Reg &a, const Reg &b)    { return _mm_mul_ps(a, b); }
+	static inline Reg div(const Reg &a, const Reg &b)    { return _mm_div_ps(a, b); }
+	static inline Reg sqrt(const Reg &a)                 { return _mm_sqrt_ps(a); }
+	
+	static inline Mask lt(const Reg &a, const Reg &b)    { return _mm_cmplt_ps(a, b); }
+	static inline Mask gt(const Reg &a, const Reg &b)    { return _mm_cmpgt_ps(a, b); }
+	static inline Mask any(const Mask &a, const Mask &b) { return _mm_or_ps(a, b); }
+	
+	static inline Reg select(const Mask &m, const Reg &a, const Reg &b)
+	{
+		return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+	} // select
+}; // BatchPack<float>
+
+template <>
+struct BatchPack<double>
+{
+	typedef __m128d Reg;
+	typedef __m128d Mask;
+	
+	static const std::size_t kWidth = 2;
+	
+	static inline Reg load(const double * const p)        { return _mm_loadu_pd(p); }
+	static inline void store(double * const p, const Reg &a) { _mm_storeu_pd(p, a); }
+	static inline Reg splat(const double &k)              { return _mm_set1_pd(k); }
+	
+	static inline Reg add(const Reg &a, const Reg &b)     { return _mm_add_pd(a, b); }
+	static inline Reg sub(const Reg &a, const Reg &b)     { return _mm_sub_pd(a, b); }
+	static inline Reg mul(const Reg &a, const Reg &b)     { return _mm_mul_pd(a, b); }
+	static inline Reg div(const Reg &a, const Reg &b)     { return _mm_div_pd(a, b); }
+	static inline Reg sqrt(const Reg &a)                  { return _mm_sqrt_pd(a); }
+	
+	static inline Mask lt(const Reg &a, const Reg &b)     { return _mm_cmplt_pd(a, b); }
+	static inline Mask gt(const Reg &a, const Reg &b)     { return _mm_cmpgt_pd(a, b); }
+	static inline Mask any(const Mask &a, const Mask &b)  { return _mm_or_pd(a, b); }
+	
+	static inline Reg select(const Mask &m, const Reg &a, const Reg &b)
+	{
+		return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b));
+	} // select
+}; // BatchPack<double>
+
+#elif defined(__ARM_NEON)
+
+template <>
+struct BatchPack<float>
+{
+	typedef float32x4_t Reg;
+	typedef uint32x4_t  Mask;
+	
+	static const std::size_t kWidth = 4;
+	
+	static inline Reg load(const float * const p)        { return vld1q_f32(p); }
+	static inline void store(float * const p, const Reg &a) { vst1q_f32(p, a); }
+	static inline Reg splat(const float &k)              { return vdupq_n_f32(k); }
+	
+	static inline Reg add(const Reg &a, const Reg &b)    { return vaddq_f32(a, b); }
+	static inline Reg sub(const Reg &a, const Reg &b)    { return vsubq_f32(a, b); }
+	static inline Reg mul(const Reg &a, const Reg &b)    { return vmulq_f32(a, b); }
+	
+#if defined(__aarch64__)
+	static inline Reg div(const Reg &a, const Reg &b)    { return vdivq_f32(a, b); }
+	static inline Reg sqrt(const Reg &a)                 { return vsqrtq_f32(a); }
+#else
+	// ARMv7 NEON has only estimates, which would not match the scalar results
+	static inline Reg div(const Reg &a, const Reg &b)
+	{
+		float p[4], q[4];
+		
+		vst1q_f32(p, a);
+		vst1q_f32(q, b);
+		
+		p[0] /= q[0]; p[1] /= q[1]; p[2] /= q[2]; p[3] /= q[3];
+		
+		return vld1q_f32(p);
+	} // div
+	
+	static inline Reg sqrt(const Reg &a)
+	{
+		float p[4];
+		
+		vst1q_f32(p, a);
+		
+		p[0] = std::sqrt(p[0]); p[1] = std::sqrt(p[1]); p[2] = std::sqrt(p[2]); p[3] = std::sqrt(p[3]);
+		
+		return vld1q_f32(p);
+	} // sqrt
+#endif
+	
+	static inline Mask lt(const Reg &a, const Reg &b)    { return vcltq_f32(a, b); }
+	static inline Mask gt(const Reg &a, const Reg &b)    { return vcgtq_f32(a, b); }
+	static inline Mask any(const Mask &a, const Mask &b) { return vorrq_u32(a, b); }
+	
+	static inline Reg select(const Mask &m, const Reg &a, const Reg &b) { return vbslq_f32(m, a, b); }
+}; // BatchPack<float>
+
+#if defined(__aarch64__)
+
+template <>
+struct BatchPack<double>
+{
+	typedef float64x2_t Reg;
+	typedef uint64x2_t  Mask;
+	
+	static const std::size_t kWidth = 2;
+	
+	static inline Reg load(const double * const p)        { return vld1q_f64(p); }
+	static inline void store(double * const p, const Reg &a) { vst1q_f64(p, a); }
+	static inline Reg splat(const double &k)              { return vdupq_n_f64(k); }
+	
+	static inline Reg add(const Reg &a, const Reg &b)     { return vaddq_f64(a, b); }
+	static inline Reg sub(const Reg &a, const Reg &b)     { return vsubq_f64(a, b); }
+	static inline Reg mul(const Reg &a, const Reg &b)     { return vmulq_f64(a, b); }
+	static inline Reg div(const Reg &a, const Reg &b)     { return vdivq_f64(a, b); }
+	static inline Reg sqrt(const Reg &a)                  { return vsqrtq_f64(a); }
+	
+	static inline Mask lt(const Reg &a, const Reg &b)     { return vcltq_f64(a, b); }
+	static inline Mask gt(const Reg &a, const Reg &b)     { return vcgtq_f64(a, b); }
+	static inline Mask any(const Mask &a, const Mask &b)  { return vorrq_u64(a, b); }
+	
+	static inline Reg select(const Mask &m, const Reg &a, const Reg &b) { return vbslq_f64(m, a, b); }
+}; // BatchPack<double>
+
+#endif
+
+#endif
+
+#endif
+
+#endif
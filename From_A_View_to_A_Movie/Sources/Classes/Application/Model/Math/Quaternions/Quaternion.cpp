@@ -854,3 +854,75 @@ Math::Quaternion<float> Math::diff(const Math::Quaternion<float>  &u,
 
 //------------------------------------------------------------------------------------------------
 
+#pragma mark -
+#pragma mark Public - Utilities - Spherical Linear Interpolation
+
+//------------------------------------------------------------------------------------------------
+//
+// q and -q are the same rotation, so v is flipped when that makes the arc shorter.  When the
+// two are (nearly) the same the weights of a plain linear interpolation are used.
+//
+//------------------------------------------------------------------------------------------------
+
+template <typename Type>
+static inline Math::Quaternion<Type> QuaternionSlerp(const Math::Quaternion<Type> &u,
+													 const Math::Quaternion<Type> &v,
+													 const Type &t)
+{
+	Type c = u.t * v.t + u.x * v.x + u.y * v.y + u.z * v.z;
+	Type s = Type(1);
+	
+	if( c < Type(0) )
+	{
+		c = -c;
+		s = -s;
+	} // if
+	
+	Type w0 = Type(1) - t;
+	Type w1 = t;
+	
+	if( c < Type(1) )
+	{
+		Type theta = std::acos(c);
+		Type sine  = std::sin(theta);
+		
+		if( sine > Type(1e-6) )
+		{
+			w0 = std::sin(w0 * theta) / sine;
+			w1 = std::sin(w1 * theta) / sine;
+		} // if
+	} // if
+	
+	w1 *= s;
+	
+	Math::Quaternion<Type> w;
+	
+	w.t = w0 * u.t + w1 * v.t;
+	w.x = w0 * u.x + w1 * v.x;
+	w.y = w0 * u.y + w1 * v.y;
+	w.z = w0 * u.z + w1 * v.z;
+	
+	return w;
+} // QuaternionSlerp
+
+//------------------------------------------------------------------------------------------------
+
+Math::Quaternion<double> Math::slerp(const Math::Quaternion<double> &u,
+									 const Math::Quaternion<double> &v,
+									 const double &t)
+{
+	return QuaternionSlerp<double>(u, v, t);
+} // slerp
+
+//------------------------------------------------------------------------------------------------
+
+Math::Quaternion<float> Math::slerp(const Math::Quaternion<float> &u,
+									const Math::Quaternion<float> &v,
+									const float &t)
+{
+	return QuaternionSlerp<float>(u, v, t);
+} // slerp
+
+//------------------------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------------------------
@@ -147,6 +147,11 @@ namespace Math
 	
 	Quaternion<double> diff(const Quaternion<double> &u, const Quaternion<double> &v);
 	Quaternion<float>  diff(const Quaternion<float>  &u, const Quaternion<float>  &v);
+	
+	// Spherical linear interpolation from u (at t = 0) to v (at t = 1),
+	// along the shorter arc.
+	Quaternion<double> slerp(const Quaternion<double> &u, const Quaternion<double> &v, const double &t);
+	Quaternion<float>  slerp(const Quaternion<float>  &u, const Quaternion<float>  &v, const float  &t);
 } // Math
 
 #endif
@@ -59,17 +59,20 @@ enum OpenGLExoticSurfaceType
 
 typedef enum OpenGLExoticSurfaceType OpenGLExoticSurfaceType;
 
+@class OpenGLSurfaceMesh;
+
 @interface OpenGLExoticSurface : NSObject
 {
 	@private
-		GLuint mnDisplayList;
+		OpenGLSurfaceMesh *mpMesh;
 } // OpenGLExoticSurface
 
 - (id) initExoticSurfaceWithType:(const OpenGLExoticSurfaceType)theSurfaceType
 					subdivisions:(const GLuint)theSubdivisions
 						   ratio:(const GLuint)theRatio;
 
-- (GLuint) displayList;
+- (BOOL) setSubdivisions:(const GLuint)theSubdivisions
+				   ratio:(const GLuint)theRatio;
 
 - (void) callList;
 
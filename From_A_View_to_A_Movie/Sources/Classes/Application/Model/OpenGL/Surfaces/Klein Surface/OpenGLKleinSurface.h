@@ -47,15 +47,17 @@
  
  */
 
+@class OpenGLSurfaceMesh;
+
 @interface OpenGLKleinSurface : NSObject
 {
 @private
-	GLuint  mnDisplayList;
+	OpenGLSurfaceMesh *mpMesh;
 } // OpenGLKleinSurface
 
 - (id) initKleinSurfaceWithTessellationFactor:(const GLsizei)theTessellationFactor;
 
-- (GLuint) displayList;
+- (BOOL) setTessellationFactor:(const GLsizei)theTessellationFactor;
 
 - (void) callList;
 
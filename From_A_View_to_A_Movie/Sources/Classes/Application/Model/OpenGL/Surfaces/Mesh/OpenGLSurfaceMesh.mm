@@ -0,0 +1,247 @@
+/*
+     File: OpenGLSurfaceMesh.mm
+ Abstract: 
+ Vertex and index buffers of a tessellated surface.
+ 
+  Version: 1.2
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+ Inc. ("Apple") in consideration of your agreement to the following
+ terms, and your use, installation, modification or redistribution of
+ this Apple software constitutes acceptance of these terms.  If you do
+ not agree with these terms, please do not use, install, modify or
+ redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software.
+ Neither the name, trademarks, service marks or logos of Apple Inc. may
+ be used to endorse or promote products derived from the Apple Software
+ without specific prior written permission from Apple.  Except as
+ expressly stated in this notice, no other rights or licenses, express or
+ implied, are granted by Apple herein, including but not limited to any
+ patent rights that may be infringed by your derivative works or by other
+ works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2013 Apple Inc. All Rights Reserved.
+ 
+ */
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#import <cstddef>
+
+//------------------------------------------------------------------------
+
+#import "Tessellator.h"
+
+//------------------------------------------------------------------------
+
+#import "OpenGLSurfaceMesh.h"
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private Data Structures
+
+//------------------------------------------------------------------------
+
+struct OpenGLSurfaceMeshData
+{
+	Surface::Type  type;		// surface
+	GLuint         buffers[2];	// vertex and index buffers
+	GLsizei        count;		// index count
+};
+
+typedef struct OpenGLSurfaceMeshData  OpenGLSurfaceMeshData;
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#define BUFFER_OFFSET(i) ((char *)NULL + (i))
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Utilities
+
+//------------------------------------------------------------------------
+
+static BOOL OpenGLSurfaceMeshUpload(const GLuint theSubdivisions,
+									const GLuint theRatio,
+									OpenGLSurfaceMeshDataRef pSurfaceMesh)
+{
+	Surface::Tessellator &rTessellator = Surface::Tessellator::GetShared();
+	
+	const Surface::Mesh *pMesh = rTessellator.Acquire(pSurfaceMesh->type,
+													  theSubdivisions,
+													  theRatio);
+	
+	BOOL bSuccess = ( pMesh != NULL ) && !pMesh->m_Indices.empty();
+	
+	if( bSuccess )
+	{
+		if( !pSurfaceMesh->buffers[0] )
+		{
+			glGenBuffers(2, pSurfaceMesh->buffers);
+		} // if
+		
+		glBindBuffer(GL_ARRAY_BUFFER, pSurfaceMesh->buffers[0]);
+		glBufferData(GL_ARRAY_BUFFER,
+					 pMesh->m_Vertices.size() * sizeof(Surface::Vertex),
+					 &pMesh->m_Vertices[0],
+					 GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pSurfaceMesh->buffers[1]);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+					 pMesh->m_Indices.size() * sizeof(uint32_t),
+					 &pMesh->m_Indices[0],
+					 GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		
+		pSurfaceMesh->count = GLsizei(pMesh->m_Indices.size());
+	} // if
+	
+	// The buffers have their own copy, and the mesh stays in the cache
+	// for as long as it fits
+	
+	rTessellator.Release(pMesh);
+	
+	return bSuccess;
+} // OpenGLSurfaceMeshUpload
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+@implementation OpenGLSurfaceMesh
+
+//------------------------------------------------------------------------
+
+- (id) initSurfaceMeshWithType:(const GLuint)theType
+				  subdivisions:(const GLuint)theSubdivisions
+						 ratio:(const GLuint)theRatio
+{
+	self = [super init];
+	
+	if( self )
+	{
+		mpSurfaceMesh = (OpenGLSurfaceMeshDataRef)calloc(1, sizeof(OpenGLSurfaceMeshData));
+		
+		if( mpSurfaceMesh != NULL )
+		{
+			mpSurfaceMesh->type = Surface::Type(theType);
+			
+			if( !OpenGLSurfaceMeshUpload(theSubdivisions, theRatio, mpSurfaceMesh) )
+			{
+				NSLog( @">> ERROR: OpenGL Surface Mesh - Failure Creating Mesh!" );
+			} // if
+		} // if
+		else
+		{
+			NSLog( @">> ERROR: OpenGL Surface Mesh - Failure Allocating Memory For Attributes!" );
+		} // else
+	} // if
+	
+	return self;
+} // initSurfaceMeshWithType
+
+//------------------------------------------------------------------------
+
+- (void) dealloc
+{
+	if( mpSurfaceMesh != NULL )
+	{
+		if( mpSurfaceMesh->buffers[0] )
+		{
+			glDeleteBuffers(2, mpSurfaceMesh->buffers);
+		} // if
+		
+		free(mpSurfaceMesh);
+		
+		mpSurfaceMesh = NULL;
+	} // if
+	
+	[super dealloc];
+} // dealloc
+
+//------------------------------------------------------------------------
+
+- (BOOL) setSubdivisions:(const GLuint)theSubdivisions
+				   ratio:(const GLuint)theRatio
+{
+	BOOL bSuccess = NO;
+	
+	if( mpSurfaceMesh != NULL )
+	{
+		bSuccess = OpenGLSurfaceMeshUpload(theSubdivisions, theRatio, mpSurfaceMesh);
+	} // if
+	
+	return bSuccess;
+} // setSubdivisions
+
+//------------------------------------------------------------------------
+
+- (void) draw
+{
+	if( ( mpSurfaceMesh != NULL ) && mpSurfaceMesh->count )
+	{
+		const GLsizei stride = sizeof(Surface::Vertex);
+		
+		glBindBuffer(GL_ARRAY_BUFFER, mpSurfaceMesh->buffers[0]);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mpSurfaceMesh->buffers[1]);
+		
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		
+		glVertexPointer(3, GL_FLOAT, stride, BUFFER_OFFSET(offsetof(Surface::Vertex, position)));
+		glNormalPointer(GL_FLOAT, stride, BUFFER_OFFSET(offsetof(Surface::Vertex, normal)));
+		glTexCoordPointer(2, GL_FLOAT, stride, BUFFER_OFFSET(offsetof(Surface::Vertex, texCoord)));
+		
+		glDrawElements(GL_TRIANGLES, mpSurfaceMesh->count, GL_UNSIGNED_INT, BUFFER_OFFSET(0));
+		
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glDisableClientState(GL_NORMAL_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+		
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	} // if
+} // draw
+
+//------------------------------------------------------------------------
+
+@end
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
@@ -0,0 +1,1394 @@
+/*
+     File: Tessellator.cpp
+ Abstract: 
+ Parallel tessellation of parametric surfaces into indexed meshes.
+ 
+  Version: 1.2
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+ Inc. ("Apple") in consideration of your agreement to the following
+ terms, and your use, installation, modification or redistribution of
+ this Apple software constitutes acceptance of these terms.  If you do
+ not agree with these terms, please do not use, install, modify or
+ redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software.
+ Neither the name, trademarks, service marks or logos of Apple Inc. may
+ be used to endorse or promote products derived from the Apple Software
+ without specific prior written permission from Apple.  Except as
+ expressly stated in this notice, no other rights or licenses, express or
+ implied, are granted by Apple herein, including but not limited to any
+ patent rights that may be infringed by your derivative works or by other
+ works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2013 Apple Inc. All Rights Reserved.
+ 
+ */
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+//
+// Uses techniques described by Paul Bourke 1999 - 2002
+// Tranguloid Trefoil and other example surfaces by Roger Bagula
+// see <http://astronomy.swin.edu.au/~pbourke/surfaces/>
+//
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#import <algorithm>
+#import <cmath>
+#import <list>
+
+#import <pthread.h>
+#import <unistd.h>
+
+//------------------------------------------------------------------------
+
+#import "BatchPack.h"
+#import "GeometryConstants.h"
+
+#import "Tessellator.h"
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Constants
+
+//------------------------------------------------------------------------
+//
+// A tile is this many rows of vertices, and as many strips of
+// triangles.  Rows are evaluated in blocks of columns small enough for
+// the intermediate arrays to stay in the L1 cache.
+//
+//------------------------------------------------------------------------
+
+static const uint32_t kTessellatorTileRows  = 8;
+static const uint32_t kTessellatorBlockSize = 256;
+static const uint32_t kTessellatorMaxThreads = 64;
+
+//------------------------------------------------------------------------
+//
+// A normal is degenerate, where the surface pinches to a point, when the
+// cross product of the partial derivatives is this small relative to
+// the product of their lengths.  Those normals are taken a small step
+// away in the parameters instead.
+//
+//------------------------------------------------------------------------
+
+static const float  kTessellatorSine2   = 1.0e-10f;
+static const float  kTessellatorTiny    = 1.0e-30f;
+static const double kTessellatorNudge   = 1.0e-4;
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Data Structures
+
+//------------------------------------------------------------------------
+//
+// Every surface here is, coordinate by coordinate, a sum of at most two
+// products of a function of u and a function of v,
+//
+//		p[c] = a[2c] b[2c] + a[2c+1] b[2c+1]
+//
+// so the sines and cosines are evaluated once per row and once per
+// column rather than at every vertex, and the positions and partial
+// derivatives at the vertices are only multiply-adds.  The factor
+// functions give the six factors a (or b) and their derivatives.
+//
+//------------------------------------------------------------------------
+
+typedef void (*TessellatorFactorFuncPtr)(const double &u, double *a, double *da);
+
+struct TessellatorFactors
+{
+	TessellatorFactorFuncPtr  U;
+	TessellatorFactorFuncPtr  V;
+};
+
+typedef struct TessellatorFactors TessellatorFactors;
+
+//------------------------------------------------------------------------
+
+struct TessellatorRow
+{
+	double  u;		// parameter
+	float   s;		// texture coordinate
+	float   sign;	// -1 where the normals are flipped
+};
+
+typedef struct TessellatorRow TessellatorRow;
+
+//------------------------------------------------------------------------
+
+struct TessellatorColumn
+{
+	double  v;		// parameter
+	float   t;		// texture coordinate
+};
+
+typedef struct TessellatorColumn TessellatorColumn;
+
+//------------------------------------------------------------------------
+//
+// A strip is a row of quads between two rows of vertices, drawn as the
+// triangle or quad strip a0 b0 a1 b1 ... was drawn.
+//
+//------------------------------------------------------------------------
+
+struct TessellatorStrip
+{
+	uint32_t  a;
+	uint32_t  b;
+};
+
+typedef struct TessellatorStrip TessellatorStrip;
+
+//------------------------------------------------------------------------
+
+struct TessellatorGrid
+{
+	TessellatorFactors  m_Factors;
+	
+	std::vector<TessellatorRow>     m_Rows;
+	std::vector<TessellatorColumn>  m_Columns;
+	std::vector<TessellatorStrip>   m_Strips;
+	
+	// The last column joins the first
+	bool  mbWrap;
+	
+	// The column factors b and their derivatives, one array each
+	std::vector<float>  m_B[12];
+};
+
+typedef struct TessellatorGrid TessellatorGrid;
+
+//------------------------------------------------------------------------
+
+struct TessellatorJob
+{
+	const TessellatorGrid  *mpGrid;
+	
+	Surface::Mesh  *mpMesh;
+	
+	uint32_t  mnTiles;
+	
+	volatile uint32_t  mnNext;
+};
+
+typedef struct TessellatorJob TessellatorJob;
+
+//------------------------------------------------------------------------
+
+struct TessellatorEntry
+{
+	Surface::Mesh  *mpMesh;
+	uint32_t        mnRefs;
+};
+
+typedef struct TessellatorEntry TessellatorEntry;
+
+typedef std::list<TessellatorEntry> TessellatorEntries;
+
+//------------------------------------------------------------------------
+//
+// The entries are kept most recently used first.
+//
+//------------------------------------------------------------------------
+
+struct Surface::TessellatorStruct
+{
+	pthread_mutex_t  m_Mutex;
+	
+	std::size_t  mnCapacity;
+	std::size_t  mnSize;
+	uint32_t     mnThreads;
+	
+	TessellatorEntries  m_Entries;
+};
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Utilities - Exotic Surfaces
+
+//------------------------------------------------------------------------
+//
+// The factors of the surfaces of OpenGLExoticSurface, for which
+// -Pi <= u <= Pi and -Pi <= v <= Pi.  Unused factors are zero.
+//
+//------------------------------------------------------------------------
+
+static void TessellatorZero(double *a, double *da)
+{
+	std::size_t i;
+	
+	for( i = 0; i < 6; ++i )
+	{
+		a[i]  = 0.0;
+		da[i] = 0.0;
+	} // for
+} // TessellatorZero
+
+//------------------------------------------------------------------------
+
+static void TessellatorTranguloidTrefoilU(const double &u, double *a, double *da)
+{
+	TessellatorZero(a, da);
+	
+	a[0]  = 2.0 * sin(3.0 * u);
+	da[0] = 6.0 * cos(3.0 * u);
+	
+	a[2]  = 2.0 * (sin(u) + 2.0 * sin(2.0 * u));
+	da[2] = 2.0 * (cos(u) + 4.0 * cos(2.0 * u));
+	
+	a[4]  = 0.25 * (cos(u) - 2.0 * cos(2.0 * u));
+	da[4] = 0.25 * (4.0 * sin(2.0 * u) - sin(u));
+} // TessellatorTranguloidTrefoilU
+
+static void TessellatorTranguloidTrefoilV(const double &v, double *b, double *db)
+{
+	TessellatorZero(b, db);
+	
+	double t = v + kTwoPiThird;
+	double A = 2.0 + cos(t);
+	double B = 2.0 + cos(v);
+	
+	b[0]  = 1.0 / B;
+	db[0] = sin(v) / (B * B);
+	
+	b[2]  = 1.0 / A;
+	db[2] = sin(t) / (A * A);
+	
+	b[4]  = A * B;
+	db[4] = -sin(t) * B - A * sin(v);
+} // TessellatorTranguloidTrefoilV
+
+//------------------------------------------------------------------------
+
+static void TessellatorTriaxialTritorusU(const double &u, double *a, double *da)
+{
+	TessellatorZero(a, da);
+	
+	a[0]  = 2.0 * sin(u);
+	da[0] = 2.0 * cos(u);
+	
+	a[2]  = 2.0 * sin(u + kTwoPiThird);
+	da[2] = 2.0 * cos(u + kTwoPiThird);
+	
+	a[4]  = 2.0 * sin(u + kFourPiThird);
+	da[4] = 2.0 * cos(u + kFourPiThird);
+} // TessellatorTriaxialTritorusU
+
+static void TessellatorTriaxialTritorusV(const double &v, double *b, double *db)
+{
+	TessellatorZero(b, db);
+	
+	b[0]  =  1.0 + cos(v);
+	db[0] = -sin(v);
+	
+	b[2]  =  1.0 + cos(v + kTwoPiThird);
+	db[2] = -sin(v + kTwoPiThird);
+	
+	b[4]  =  1.0 + cos(v + kFourPiThird);
+	db[4] = -sin(v + kFourPiThird);
+} // TessellatorTriaxialTritorusV
+
+//------------------------------------------------------------------------
+//
+// The stiletto and the slippers swap u and v, so here u is their v.
+//
+//------------------------------------------------------------------------
+
+static void TessellatorStilettoU(const double &u, double *a, double *da)
+{
+	TessellatorZero(a, da);
+	
+	double V = 0.5 * (u + kPi);
+	double w = V + kTwoPiThird;
+	double c = cos(V);
+	double s = sin(V);
+	double t = pow(sin(w), 2.0) * pow(cos(w), 2.0);
+	double q = 0.5 * sin(4.0 * w);
+	
+	a[0]  = 4.0 * c * c * c * s;
+	da[0] = 2.0 * c * c * (c * c - 3.0 * s * s);
+	
+	a[2]  = 4.0 * t;
+	da[2] = 2.0 * q;
+	
+	a[4]  = -4.0 * t;
+	da[4] = -2.0 * q;
+} // TessellatorStilettoU
+
+static void TessellatorStilettoV(const double &v, double *b, double *db)
+{
+	TessellatorZero(b, db);
+	
+	double U = v + kPi;
+	
+	b[0]  =  2.0 + cos(U);
+	db[0] = -sin(U);
+	
+	b[2]  =  2.0 + cos(U + kTwoPiThird);
+	db[2] = -sin(U + kTwoPiThird);
+	
+	b[4]  =  2.0 + cos(U - kTwoPiThird);
+	db[4] = -sin(U - kTwoPiThird);
+} // TessellatorStilettoV
+
+//------------------------------------------------------------------------
+
+static void TessellatorSlipperU(const double &u, double *a, double *da)
+{
+	TessellatorZero(a, da);
+	
+	double V  = u + kPi;
+	double s  = kTwoPiThird + V;
+	double t  = kTwoPiThird - V;
+	double cV = cos(V);
+	double sV = sin(V);
+	double cs = cos(s);
+	double ss = sin(s);
+	double ct = cos(t);
+	double st = sin(t);
+	
+	a[0]  = 4.0 * cV * cV * cV * sV;
+	da[0] = 4.0 * cV * cV * (cV * cV - 3.0 * sV * sV);
+	
+	a[2]  = 4.0 * cs * cs * ss * ss;
+	da[2] = 2.0 * sin(4.0 * s);
+	
+	// d/du = -d/dt
+	
+	a[4]  = -4.0 * ct * ct * st * st * st;
+	da[4] =  4.0 * ct * st * st * (3.0 * ct * ct - 2.0 * st * st);
+} // TessellatorSlipperU
+
+static void TessellatorSlipperV(const double &v, double *b, double *db)
+{
+	TessellatorZero(b, db);
+	
+	double U = v + kTwoPi;
+	
+	b[0]  =  2.0 + cos(U);
+	db[0] = -sin(U);
+	
+	b[2]  =  2.0 + cos(U + kTwoPiThird);
+	db[2] = -sin(U + kTwoPiThird);
+	
+	b[4]  =  2.0 + cos(U - kTwoPiThird);
+	db[4] = -sin(U - kTwoPiThird);
+} // TessellatorSlipperV
+
+//------------------------------------------------------------------------
+//
+// With U = 2 (u + Pi) and V = (v + Pi) / 2 Pi, so dU/du = 2 and
+// dV/dv = 1 / 2 Pi.
+//
+//------------------------------------------------------------------------
+
+static void TessellatorMaedersOwlU(const double &u, double *a, double *da)
+{
+	TessellatorZero(a, da);
+	
+	double U = 2.0 * (u + kPi);
+	double c = cos(U);
+	double s = sin(U);
+	double C = cos(2.0 * U);
+	double S = sin(2.0 * U);
+	
+	a[0]  =  3.0 * c;
+	da[0] = -6.0 * s;
+	a[1]  = -0.5 * C;
+	da[1] =  2.0 * S;
+	
+	a[2]  = -3.0 * s;
+	da[2] = -6.0 * c;
+	a[3]  = -0.5 * S;
+	da[3] = -2.0 * C;
+	
+	a[4]  =   4.0 * cos(1.5 * U);
+	da[4] = -12.0 * sin(1.5 * U);
+} // TessellatorMaedersOwlU
+
+static void TessellatorMaedersOwlV(const double &v, double *b, double *db)
+{
+	TessellatorZero(b, db);
+	
+	double V = kTwoPiInv * (v + kPi);
+	
+	b[0]  = V;
+	db[0] = kTwoPiInv;
+	b[1]  = V * V;
+	db[1] = 2.0 * V * kTwoPiInv;
+	
+	b[2]  = b[0];
+	db[2] = db[0];
+	b[3]  = b[1];
+	db[3] = db[1];
+	
+	b[4]  = pow(V, 1.5);
+	db[4] = 1.5 * sqrt(V) * kTwoPiInv;
+} // TessellatorMaedersOwlV
+
+//------------------------------------------------------------------------
+
+static void TessellatorDefault(const double &u, double *a, double *da)
+{
+	TessellatorZero(a, da);
+} // TessellatorDefault
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Utilities - Klein Bottle
+
+//------------------------------------------------------------------------
+//
+// The factors of the Klein bottle of OpenGLKleinSurface, for which
+// 0 <= u <= 1 and 0 <= v <= 1.  It is scaled by a tenth and mirrored in
+// y, and which half of the bottle a point is on depends on u only.
+//
+//------------------------------------------------------------------------
+
+static void TessellatorKleinBottleU(const double &x, double *a, double *da)
+{
+	TessellatorZero(a, da);
+	
+	double u = (1.0 - x) * kTwoPi;
+	double c = cos(u);
+	double s = sin(u);
+	double k = -kTwoPi;	// du/dx
+	
+	a[0]  = 0.3 * c * (1.0 + s);
+	da[0] = 0.3 * (c * c - s * (1.0 + s)) * k;
+	
+	a[2]  = -0.8 * s;
+	da[2] = -0.8 * c * k;
+	
+	if( u < kPi )
+	{
+		a[1]  = 0.1 * (2.0 - c) * c;
+		da[1] = 0.2 * s * (c - 1.0) * k;
+		
+		a[3]  = -0.1 * (2.0 - c) * s;
+		da[3] = -0.1 * (s * s + (2.0 - c) * c) * k;
+	} // if
+	else
+	{
+		a[1]  = -0.1 * (2.0 - c);
+		da[1] = -0.1 * s * k;
+	} // else
+	
+	a[4]  = 0.1 * (2.0 - c);
+	da[4] = 0.1 * s * k;
+} // TessellatorKleinBottleU
+
+static void TessellatorKleinBottleV(const double &y, double *b, double *db)
+{
+	TessellatorZero(b, db);
+	
+	double v = y * kTwoPi;
+	double c = cos(v);
+	double s = sin(v);
+	
+	b[0] = 1.0;
+	b[1] = c;
+	
+	db[1] = -s * kTwoPi;
+	
+	b[2] = 1.0;
+	b[3] = c;
+	
+	db[3] = db[1];
+	
+	b[4]  = s;
+	db[4] = c * kTwoPi;
+} // TessellatorKleinBottleV
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Utilities - Grids
+
+//------------------------------------------------------------------------
+
+static TessellatorFactors TessellatorGetFactors(const Surface::Type &nType)
+{
+	TessellatorFactors factors = { &TessellatorDefault, &TessellatorDefault };
+	
+	switch( nType )
+	{
+		case Surface::eTranguloidTrefoil:
+			factors.U = &TessellatorTranguloidTrefoilU;
+			factors.V = &TessellatorTranguloidTrefoilV;
+			break;
+			
+		case Surface::eTriaxialTritorus:
+			factors.U = &TessellatorTriaxialTritorusU;
+			factors.V = &TessellatorTriaxialTritorusV;
+			break;
+			
+		case Surface::eStiletto:
+			factors.U = &TessellatorStilettoU;
+			factors.V = &TessellatorStilettoV;
+			break;
+			
+		case Surface::eSlipper:
+			factors.U = &TessellatorSlipperU;
+			factors.V = &TessellatorSlipperV;
+			break;
+			
+		case Surface::eMaedersOwl:
+			factors.U = &TessellatorMaedersOwlU;
+			factors.V = &TessellatorMaedersOwlV;
+			break;
+			
+		case Surface::eKleinBottle:
+			factors.U = &TessellatorKleinBottleU;
+			factors.V = &TessellatorKleinBottleV;
+			break;
+			
+		case Surface::eDefault:
+		default:
+			break;
+	} // switch
+	
+	return factors;
+} // TessellatorGetFactors
+
+//------------------------------------------------------------------------
+//
+// The grid of OpenGLExoticSurfaceCreateWithType, which wraps around in
+// both directions, and the strips of OpenGLExoticSurfaceCreateDisplayList.
+//
+//------------------------------------------------------------------------
+
+static void TessellatorExoticSurfaceGrid(const uint32_t &nRows,
+										 const uint32_t &nColumns,
+										 TessellatorGrid &rGrid)
+{
+	const double invMaxI = 1.0 / double(nRows);
+	const double invMaxJ = 1.0 / double(nColumns);
+	
+	uint32_t i;
+	uint32_t j;
+	
+	rGrid.m_Rows.resize(nRows);
+	rGrid.m_Strips.resize(nRows);
+	rGrid.m_Columns.resize(nColumns);
+	
+	rGrid.mbWrap = true;
+	
+	for( i = 0; i < nRows; ++i )
+	{
+		rGrid.m_Rows[i].u    = kTwoPi * double(i) * invMaxI - kPi;
+		rGrid.m_Rows[i].s    = float(double(i) * invMaxI * 5.0);
+		rGrid.m_Rows[i].sign = 1.0f;
+		
+		rGrid.m_Strips[i].a = i;
+		rGrid.m_Strips[i].b = (i + 1) % nRows;
+	} // for
+	
+	for( j = 0; j < nColumns; ++j )
+	{
+		rGrid.m_Columns[j].v = kTwoPi * double(j) * invMaxJ - kPi;
+		rGrid.m_Columns[j].t = float(double(j) * invMaxJ);
+	} // for
+} // TessellatorExoticSurfaceGrid
+
+//------------------------------------------------------------------------
+//
+// The grid of OpenGLKleinSurfaceCreateDisplayList.  The strips with
+// u < 1/8 have their normals flipped and their quads drawn the other way
+// round, so the row of vertices between the last such strip and the next
+// is made twice, once with flipped normals.
+//
+//------------------------------------------------------------------------
+
+static void TessellatorKleinBottleGrid(const uint32_t &nSlices,
+									   const uint32_t &nStacks,
+									   TessellatorGrid &rGrid)
+{
+	const double du = 1.0 / double(nSlices);
+	const double dv = 1.0 / double(nStacks);
+	
+	uint32_t i;
+	uint32_t j;
+	uint32_t n = 0;
+	
+	while( ( n < nSlices ) && ( double(n) * du < 0.125 ) )
+	{
+		++n;
+	} // while
+	
+	rGrid.m_Rows.resize(nSlices + 1);
+	rGrid.m_Strips.resize(nSlices);
+	rGrid.m_Columns.resize(nStacks + 1);
+	
+	rGrid.mbWrap = false;
+	
+	for( i = 0; i <= nSlices; ++i )
+	{
+		rGrid.m_Rows[i].u    = double(i) * du;
+		rGrid.m_Rows[i].s    = float(4.0 * rGrid.m_Rows[i].u);
+		rGrid.m_Rows[i].sign = ( i < n ) ? -1.0f : 1.0f;
+	} // for
+	
+	if( n > 0 )
+	{
+		TessellatorRow row = rGrid.m_Rows[n];
+		
+		row.sign = -1.0f;
+		
+		rGrid.m_Rows.push_back(row);
+	} // if
+	
+	for( i = 0; i < nSlices; ++i )
+	{
+		if( i < n )
+		{
+			rGrid.m_Strips[i].a = ( i + 1 == n ) ? nSlices + 1 : i + 1;
+			rGrid.m_Strips[i].b = i;
+		} // if
+		else
+		{
+			rGrid.m_Strips[i].a = i;
+			rGrid.m_Strips[i].b = i + 1;
+		} // else
+	} // for
+	
+	for( j = 0; j <= nStacks; ++j )
+	{
+		rGrid.m_Columns[j].v = double(j) * dv;
+		rGrid.m_Columns[j].t = float(rGrid.m_Columns[j].v);
+	} // for
+} // TessellatorKleinBottleGrid
+
+//------------------------------------------------------------------------
+
+static void TessellatorCreateGrid(const Surface::Type &nType,
+								  const uint32_t &nSubdivisions,
+								  const uint32_t &nRatio,
+								  TessellatorGrid &rGrid)
+{
+	rGrid.m_Factors = TessellatorGetFactors(nType);
+	
+	if( nType == Surface::eKleinBottle )
+	{
+		if( nSubdivisions >= 2 )
+		{
+			TessellatorKleinBottleGrid(nSubdivisions, nSubdivisions / 2, rGrid);
+		} // if
+	} // if
+	else if( ( nSubdivisions > 0 ) && ( nRatio > 0 ) )
+	{
+		TessellatorExoticSurfaceGrid(nSubdivisions * nRatio, nSubdivisions, rGrid);
+	} // else if
+	
+	const std::size_t nColumns = rGrid.m_Columns.size();
+	
+	double b[12];
+	
+	std::size_t j;
+	std::size_t k;
+	
+	for( k = 0; k < 12; ++k )
+	{
+		rGrid.m_B[k].resize(nColumns);
+	} // for
+	
+	for( j = 0; j < nColumns; ++j )
+	{
+		rGrid.m_Factors.V(rGrid.m_Columns[j].v, b, b + 6);
+		
+		for( k = 0; k < 12; ++k )
+		{
+			rGrid.m_B[k][j] = float(b[k]);
+		} // for
+	} // for
+} // TessellatorCreateGrid
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Utilities - Vertices
+
+//------------------------------------------------------------------------
+//
+// Positions and unit normals along a row, from the row factors a and
+// their derivatives da, splatted, and the column factors.  Degenerate
+// normals are left zero.  As with the Math batch kernels, this starts at
+// column j, stops before the first pack that does not fit, and returns
+// where it stopped.
+//
+//------------------------------------------------------------------------
+
+template <typename Pack>
+static std::size_t TessellatorEvaluate(std::size_t j,
+									   const std::size_t &n,
+									   const float * const pA,
+									   const float &nSign,
+									   const float * const * const pB,
+									   float * const * const pP,
+									   float * const * const pN)
+{
+	typedef typename Pack::Reg  Reg;
+	typedef typename Pack::Mask Mask;
+	
+	Reg a[12];
+	
+	std::size_t k;
+	
+	for( k = 0; k < 12; ++k )
+	{
+		a[k] = Pack::splat(pA[k]);
+	} // for
+	
+	const Reg kSign  = Pack::splat(nSign);
+	const Reg kOne   = Pack::splat(1.0f);
+	const Reg kZero  = Pack::splat(0.0f);
+	const Reg kSine2 = Pack::splat(kTessellatorSine2);
+	const Reg kTiny  = Pack::splat(kTessellatorTiny);
+	
+	for(; j + Pack::kWidth <= n; j += Pack::kWidth)
+	{
+		Reg p[3];
+		Reg pu[3];
+		Reg pv[3];
+		
+		for( k = 0; k < 3; ++k )
+		{
+			const Reg b0  = Pack::load(pB[2 * k] + j);
+			const Reg b1  = Pack::load(pB[2 * k + 1] + j);
+			const Reg db0 = Pack::load(pB[2 * k + 6] + j);
+			const Reg db1 = Pack::load(pB[2 * k + 7] + j);
+			
+			p[k]  = Pack::add(Pack::mul(a[2 * k], b0), Pack::mul(a[2 * k + 1], b1));
+			pu[k] = Pack::add(Pack::mul(a[2 * k + 6], b0), Pack::mul(a[2 * k + 7], b1));
+			pv[k] = Pack::add(Pack::mul(a[2 * k], db0), Pack::mul(a[2 * k + 1], db1));
+			
+			Pack::store(pP[k] + j, p[k]);
+		} // for
+		
+		// N = sign (pu ^ pv)
+		
+		Reg nx = Pack::mul(kSign, Pack::sub(Pack::mul(pu[1], pv[2]), Pack::mul(pu[2], pv[1])));
+		Reg ny = Pack::mul(kSign, Pack::sub(Pack::mul(pu[2], pv[0]), Pack::mul(pu[0], pv[2])));
+		Reg nz = Pack::mul(kSign, Pack::sub(Pack::mul(pu[0], pv[1]), Pack::mul(pu[1], pv[0])));
+		
+		const Reg L2 = Pack::add(Pack::add(Pack::mul(nx, nx), Pack::mul(ny, ny)), Pack::mul(nz, nz));
+		const Reg U2 = Pack::add(Pack::add(Pack::mul(pu[0], pu[0]), Pack::mul(pu[1], pu[1])), Pack::mul(pu[2], pu[2]));
+		const Reg V2 = Pack::add(Pack::add(Pack::mul(pv[0], pv[0]), Pack::mul(pv[1], pv[1])), Pack::mul(pv[2], pv[2]));
+		
+		const Mask m = Pack::lt(L2, Pack::add(Pack::mul(kSine2, Pack::mul(U2, V2)), kTiny));
+		
+		const Reg L = Pack::div(kOne, Pack::sqrt(L2));
+		
+		Pack::store(pN[0] + j, Pack::select(m, kZero, Pack::mul(nx, L)));
+		Pack::store(pN[1] + j, Pack::select(m, kZero, Pack::mul(ny, L)));
+		Pack::store(pN[2] + j, Pack::select(m, kZero, Pack::mul(nz, L)));
+	} // for
+	
+	return j;
+} // TessellatorEvaluate
+
+//------------------------------------------------------------------------
+//
+// The normal where the partial derivatives are parallel or vanish, as at
+// the tip of Maeder's owl, is the limit of the normals nearby.  Failing
+// that, as the display list did for the Klein bottle, it is along the
+// position.
+//
+//------------------------------------------------------------------------
+
+static void TessellatorFixNormal(const TessellatorGrid &rGrid,
+								 const TessellatorRow &rRow,
+								 const TessellatorColumn &rColumn,
+								 Surface::Vertex &rVertex)
+{
+	static const double kSteps[3][2] =
+	{
+		{ kTessellatorNudge, 0.0 },
+		{ 0.0, kTessellatorNudge },
+		{ kTessellatorNudge, kTessellatorNudge }
+	};
+	
+	double a[12];
+	double b[12];
+	double n[3];
+	double pu[3];
+	double pv[3];
+	double L2 = 0.0;
+	
+	std::size_t i;
+	std::size_t k;
+	
+	for( i = 0; i < 3; ++i )
+	{
+		rGrid.m_Factors.U(rRow.u + kSteps[i][0], a, a + 6);
+		rGrid.m_Factors.V(rColumn.v + kSteps[i][1], b, b + 6);
+		
+		for( k = 0; k < 3; ++k )
+		{
+			pu[k] = a[2 * k + 6] * b[2 * k] + a[2 * k + 7] * b[2 * k + 1];
+			pv[k] = a[2 * k] * b[2 * k + 6] + a[2 * k + 1] * b[2 * k + 7];
+		} // for
+		
+		n[0] = rRow.sign * (pu[1] * pv[2] - pu[2] * pv[1]);
+		n[1] = rRow.sign * (pu[2] * pv[0] - pu[0] * pv[2]);
+		n[2] = rRow.sign * (pu[0] * pv[1] - pu[1] * pv[0]);
+		
+		L2 = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+		
+		if( L2 > kTessellatorTiny )
+		{
+			break;
+		} // if
+	} // for
+	
+	if( L2 <= kTessellatorTiny )
+	{
+		n[0] = rVertex.position[0];
+		n[1] = rVertex.position[1];
+		n[2] = rVertex.position[2];
+		
+		L2 = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+	} // if
+	
+	if( L2 > kTessellatorTiny )
+	{
+		const double L = 1.0 / sqrt(L2);
+		
+		rVertex.normal[0] = float(n[0] * L);
+		rVertex.normal[1] = float(n[1] * L);
+		rVertex.normal[2] = float(n[2] * L);
+	} // if
+} // TessellatorFixNormal
+
+//------------------------------------------------------------------------
+
+static void TessellatorCreateRow(const TessellatorGrid &rGrid,
+								 const uint32_t &i,
+								 Surface::Vertex *pVertices)
+{
+	const TessellatorRow &rRow = rGrid.m_Rows[i];
+	
+	const std::size_t nColumns = rGrid.m_Columns.size();
+	
+	float x[3][kTessellatorBlockSize];
+	float y[3][kTessellatorBlockSize];
+	
+	float *pP[3] = { x[0], x[1], x[2] };
+	float *pN[3] = { y[0], y[1], y[2] };
+	
+	const float *pB[12];
+	
+	double a[12];
+	float  A[12];
+	
+	std::size_t j;
+	std::size_t k;
+	std::size_t l;
+	std::size_t m;
+	
+	rGrid.m_Factors.U(rRow.u, a, a + 6);
+	
+	for( k = 0; k < 12; ++k )
+	{
+		A[k] = float(a[k]);
+	} // for
+	
+	for( j = 0; j < nColumns; j += kTessellatorBlockSize )
+	{
+		m = std::min(std::size_t(kTessellatorBlockSize), nColumns - j);
+		
+		for( k = 0; k < 12; ++k )
+		{
+			pB[k] = &rGrid.m_B[k][j];
+		} // for
+		
+		l = TessellatorEvaluate< BatchPack<float> >(0, m, A, rRow.sign, pB, pP, pN);
+		l = TessellatorEvaluate< BatchScalar<float> >(l, m, A, rRow.sign, pB, pP, pN);
+		
+		for( l = 0; l < m; ++l )
+		{
+			Surface::Vertex &rVertex = pVertices[j + l];
+			
+			rVertex.position[0] = x[0][l];
+			rVertex.position[1] = x[1][l];
+			rVertex.position[2] = x[2][l];
+			
+			rVertex.normal[0] = y[0][l];
+			rVertex.normal[1] = y[1][l];
+			rVertex.normal[2] = y[2][l];
+			
+			rVertex.texCoord[0] = rRow.s;
+			rVertex.texCoord[1] = rGrid.m_Columns[j + l].t;
+			
+			if( ( y[0][l] == 0.0f ) && ( y[1][l] == 0.0f ) && ( y[2][l] == 0.0f ) )
+			{
+				TessellatorFixNormal(rGrid, rRow, rGrid.m_Columns[j + l], rVertex);
+			} // if
+		} // for
+	} // for
+} // TessellatorCreateRow
+
+//------------------------------------------------------------------------
+//
+// Two triangles per quad, in the order and winding of the strips.
+//
+//------------------------------------------------------------------------
+
+static void TessellatorCreateStrip(const TessellatorGrid &rGrid,
+								   const uint32_t &i,
+								   uint32_t *pIndices)
+{
+	const uint32_t nColumns = uint32_t(rGrid.m_Columns.size());
+	const uint32_t nQuads   = rGrid.mbWrap ? nColumns : nColumns - 1;
+	const uint32_t a        = rGrid.m_Strips[i].a * nColumns;
+	const uint32_t b        = rGrid.m_Strips[i].b * nColumns;
+	
+	uint32_t j;
+	uint32_t k;
+	
+	for( j = 0; j < nQuads; ++j )
+	{
+		k = ( j + 1 == nColumns ) ? 0 : j + 1;
+		
+		pIndices[0] = a + j;
+		pIndices[1] = b + j;
+		pIndices[2] = a + k;
+		
+		pIndices[3] = a + k;
+		pIndices[4] = b + j;
+		pIndices[5] = b + k;
+		
+		pIndices += 6;
+	} // for
+} // TessellatorCreateStrip
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Utilities - Threads
+
+//------------------------------------------------------------------------
+//
+// Tile t is rows and strips t * kTessellatorTileRows onwards.  Threads
+// take the next tile until there are none left.
+//
+//------------------------------------------------------------------------
+
+static void *TessellatorWorker(void *pContext)
+{
+	TessellatorJob *pJob = static_cast<TessellatorJob *>(pContext);
+	
+	const TessellatorGrid &rGrid = *pJob->mpGrid;
+	
+	const uint32_t nRows    = uint32_t(rGrid.m_Rows.size());
+	const uint32_t nStrips  = uint32_t(rGrid.m_Strips.size());
+	const uint32_t nColumns = uint32_t(rGrid.m_Columns.size());
+	const uint32_t nQuads   = rGrid.mbWrap ? nColumns : nColumns - 1;
+	
+	Surface::Vertex *pVertices = &pJob->mpMesh->m_Vertices[0];
+	uint32_t        *pIndices  = pJob->mpMesh->m_Indices.empty() ? NULL : &pJob->mpMesh->m_Indices[0];
+	
+	uint32_t i;
+	uint32_t t;
+	
+	while( ( t = __sync_fetch_and_add(&pJob->mnNext, 1) ) < pJob->mnTiles )
+	{
+		const uint32_t first = t * kTessellatorTileRows;
+		const uint32_t last  = first + kTessellatorTileRows;
+		
+		for( i = first; ( i < last ) && ( i < nRows ); ++i )
+		{
+			TessellatorCreateRow(rGrid, i, pVertices + std::size_t(i) * nColumns);
+		} // for
+		
+		if( pIndices != NULL )
+		{
+			for( i = first; ( i < last ) && ( i < nStrips ); ++i )
+			{
+				TessellatorCreateStrip(rGrid, i, pIndices + std::size_t(i) * nQuads * 6);
+			} // for
+		} // if
+	} // while
+	
+	return NULL;
+} // TessellatorWorker
+
+//------------------------------------------------------------------------
+
+static uint32_t TessellatorGetThreads(const uint32_t &nThreads)
+{
+	uint32_t threads = nThreads;
+	
+	if( threads == 0 )
+	{
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		
+		threads = ( cpus > 0 ) ? uint32_t(cpus) : 1;
+	} // if
+	
+	return std::min(threads, kTessellatorMaxThreads);
+} // TessellatorGetThreads
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Utilities - Cache
+
+//------------------------------------------------------------------------
+
+static bool TessellatorIsMesh(const Surface::Mesh * const pMesh,
+							  const Surface::Type &nType,
+							  const uint32_t &nSubdivisions,
+							  const uint32_t &nRatio)
+{
+	return(		( pMesh->mnType == nType )
+		   &&	( pMesh->mnSubdivisions == nSubdivisions )
+		   &&	( pMesh->mnRatio == nRatio ) );
+} // TessellatorIsMesh
+
+//------------------------------------------------------------------------
+//
+// Called with the mutex held.  Delete the least recently used meshes
+// not in use until those left fit in the capacity.
+//
+//------------------------------------------------------------------------
+
+static void TessellatorEvict(Surface::TessellatorStruct *pSTessellator,
+							 const std::size_t &nCapacity)
+{
+	std::size_t nUnused = 0;
+	
+	TessellatorEntries::iterator iter;
+	
+	for( iter = pSTessellator->m_Entries.begin(); iter != pSTessellator->m_Entries.end(); ++iter )
+	{
+		if( iter->mnRefs == 0 )
+		{
+			nUnused += iter->mpMesh->GetSize();
+		} // if
+	} // for
+	
+	iter = pSTessellator->m_Entries.end();
+	
+	while( ( nUnused > nCapacity ) && ( iter != pSTessellator->m_Entries.begin() ) )
+	{
+		--iter;
+		
+		if( iter->mnRefs == 0 )
+		{
+			const std::size_t nSize = iter->mpMesh->GetSize();
+			
+			nUnused -= nSize;
+			
+			pSTessellator->mnSize -= nSize;
+			
+			delete iter->mpMesh;
+			
+			iter = pSTessellator->m_Entries.erase(iter);
+		} // if
+	} // while
+} // TessellatorEvict
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Public - Mesh
+
+//------------------------------------------------------------------------
+
+std::size_t Surface::Mesh::GetSize() const
+{
+	return m_Vertices.size() * sizeof(Vertex) + m_Indices.size() * sizeof(uint32_t);
+} // GetSize
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Public - Tessellator
+
+//------------------------------------------------------------------------
+
+Surface::Mesh *Surface::Tessellator::Create(const Type &nType,
+										   const uint32_t &nSubdivisions,
+										   const uint32_t &nRatio,
+										   const uint32_t &nThreads)
+{
+	Mesh *pMesh = new Mesh;
+	
+	pMesh->mnType         = nType;
+	pMesh->mnSubdivisions = nSubdivisions;
+	pMesh->mnRatio        = ( nType == eKleinBottle ) ? 1 : nRatio;
+	
+	TessellatorGrid grid;
+	
+	TessellatorCreateGrid(nType, nSubdivisions, pMesh->mnRatio, grid);
+	
+	const std::size_t nRows    = grid.m_Rows.size();
+	const std::size_t nStrips  = grid.m_Strips.size();
+	const std::size_t nColumns = grid.m_Columns.size();
+	const std::size_t nQuads   = grid.mbWrap ? nColumns : nColumns - 1;
+	
+	if( nRows && nColumns )
+	{
+		pMesh->m_Vertices.resize(nRows * nColumns);
+		pMesh->m_Indices.resize(nStrips * nQuads * 6);
+		
+		TessellatorJob job;
+		
+		job.mpGrid  = &grid;
+		job.mpMesh  = pMesh;
+		job.mnTiles = uint32_t((std::max(nRows, nStrips) + kTessellatorTileRows - 1) / kTessellatorTileRows);
+		job.mnNext  = 0;
+		
+		const uint32_t nCount = std::min(TessellatorGetThreads(nThreads), job.mnTiles);
+		
+		pthread_t threads[kTessellatorMaxThreads];
+		
+		uint32_t nStarted = 0;
+		uint32_t i;
+		
+		// The calling thread takes part too
+		
+		for( i = 1; i < nCount; ++i )
+		{
+			if( pthread_create(&threads[nStarted], NULL, TessellatorWorker, &job) == 0 )
+			{
+				++nStarted;
+			} // if
+		} // for
+		
+		TessellatorWorker(&job);
+		
+		for( i = 0; i < nStarted; ++i )
+		{
+			pthread_join(threads[i], NULL);
+		} // for
+	} // if
+	
+	return pMesh;
+} // Create
+
+//------------------------------------------------------------------------
+
+Surface::Tessellator::Tessellator(const std::size_t &nCapacity,
+								  const uint32_t &nThreads)
+{
+	mpSTessellator = new TessellatorStruct;
+	
+	pthread_mutex_init(&mpSTessellator->m_Mutex, NULL);
+	
+	mpSTessellator->mnCapacity = nCapacity;
+	mpSTessellator->mnSize     = 0;
+	mpSTessellator->mnThreads  = nThreads;
+} // Constructor
+
+//------------------------------------------------------------------------
+
+Surface::Tessellator::~Tessellator()
+{
+	if( mpSTessellator != NULL )
+	{
+		TessellatorEntries::iterator iter;
+		
+		for( iter = mpSTessellator->m_Entries.begin(); iter != mpSTessellator->m_Entries.end(); ++iter )
+		{
+			delete iter->mpMesh;
+		} // for
+		
+		pthread_mutex_destroy(&mpSTessellator->m_Mutex);
+		
+		delete mpSTessellator;
+		
+		mpSTessellator = NULL;
+	} // if
+} // Destructor
+
+//------------------------------------------------------------------------
+
+Surface::Tessellator &Surface::Tessellator::GetShared()
+{
+	static Tessellator sTessellator;
+	
+	return sTessellator;
+} // GetShared
+
+//------------------------------------------------------------------------
+//
+// Meshes are made without the mutex held, so that other meshes can be
+// acquired meanwhile.  If two threads make the same mesh at once, the
+// first one in the cache is kept.
+//
+//------------------------------------------------------------------------
+
+const Surface::Mesh *Surface::Tessellator::Acquire(const Type &nType,
+												   const uint32_t &nSubdivisions,
+												   const uint32_t &nRatio)
+{
+	const uint32_t nKey = ( nType == eKleinBottle ) ? 1 : nRatio;
+	
+	TessellatorEntries::iterator iter;
+	
+	Mesh *pMesh = NULL;
+	
+	pthread_mutex_lock(&mpSTessellator->m_Mutex);
+	{
+		for( iter = mpSTessellator->m_Entries.begin(); iter != mpSTessellator->m_Entries.end(); ++iter )
+		{
+			if( TessellatorIsMesh(iter->mpMesh, nType, nSubdivisions, nKey) )
+			{
+				iter->mnRefs++;
+				
+				pMesh = iter->mpMesh;
+				
+				mpSTessellator->m_Entries.splice(mpSTessellator->m_Entries.begin(), mpSTessellator->m_Entries, iter);
+				
+				break;
+			} // if
+		} // for
+	}
+	pthread_mutex_unlock(&mpSTessellator->m_Mutex);
+	
+	if( pMesh == NULL )
+	{
+		Mesh *pNewMesh = Create(nType, nSubdivisions, nKey, mpSTessellator->mnThreads);
+		
+		pthread_mutex_lock(&mpSTessellator->m_Mutex);
+		{
+			for( iter = mpSTessellator->m_Entries.begin(); iter != mpSTessellator->m_Entries.end(); ++iter )
+			{
+				if( TessellatorIsMesh(iter->mpMesh, nType, nSubdivisions, nKey) )
+				{
+					iter->mnRefs++;
+					
+					pMesh = iter->mpMesh;
+					
+					break;
+				} // if
+			} // for
+			
+			if( pMesh == NULL )
+			{
+				TessellatorEntry entry = { pNewMesh, 1 };
+				
+				mpSTessellator->m_Entries.push_front(entry);
+				
+				mpSTessellator->mnSize += pNewMesh->GetSize();
+				
+				pMesh    = pNewMesh;
+				pNewMesh = NULL;
+			} // if
+		}
+		pthread_mutex_unlock(&mpSTessellator->m_Mutex);
+		
+		delete pNewMesh;
+	} // if
+	
+	return pMesh;
+} // Acquire
+
+//------------------------------------------------------------------------
+
+void Surface::Tessellator::Release(const Mesh *pMesh)
+{
+	if( pMesh != NULL )
+	{
+		pthread_mutex_lock(&mpSTessellator->m_Mutex);
+		{
+			TessellatorEntries::iterator iter;
+			
+			for( iter = mpSTessellator->m_Entries.begin(); iter != mpSTessellator->m_Entries.end(); ++iter )
+			{
+				if( ( iter->mpMesh == pMesh ) && ( iter->mnRefs > 0 ) )
+				{
+					iter->mnRefs--;
+					
+					break;
+				} // if
+			} // for
+			
+			TessellatorEvict(mpSTessellator, mpSTessellator->mnCapacity);
+		}
+		pthread_mutex_unlock(&mpSTessellator->m_Mutex);
+	} // if
+} // Release
+
+//------------------------------------------------------------------------
+
+void Surface::Tessellator::Purge()
+{
+	pthread_mutex_lock(&mpSTessellator->m_Mutex);
+	{
+		TessellatorEvict(mpSTessellator, 0);
+	}
+	pthread_mutex_unlock(&mpSTessellator->m_Mutex);
+} // Purge
+
+//------------------------------------------------------------------------
+
+const std::size_t Surface::Tessellator::GetSize() const
+{
+	std::size_t nSize = 0;
+	
+	pthread_mutex_lock(&mpSTessellator->m_Mutex);
+	{
+		nSize = mpSTessellator->mnSize;
+	}
+	pthread_mutex_unlock(&mpSTessellator->m_Mutex);
+	
+	return nSize;
+} // GetSize
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
@@ -0,0 +1,163 @@
+/*
+     File: Tessellator.h
+ Abstract: 
+ Parallel tessellation of parametric surfaces into indexed meshes.
+ 
+  Version: 1.2
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+ Inc. ("Apple") in consideration of your agreement to the following
+ terms, and your use, installation, modification or redistribution of
+ this Apple software constitutes acceptance of these terms.  If you do
+ not agree with these terms, please do not use, install, modify or
+ redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software.
+ Neither the name, trademarks, service marks or logos of Apple Inc. may
+ be used to endorse or promote products derived from the Apple Software
+ without specific prior written permission from Apple.  Except as
+ expressly stated in this notice, no other rights or licenses, express or
+ implied, are granted by Apple herein, including but not limited to any
+ patent rights that may be infringed by your derivative works or by other
+ works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2013 Apple Inc. All Rights Reserved.
+ 
+ */
+
+#ifndef _SURFACE_TESSELLATOR_H_
+#define _SURFACE_TESSELLATOR_H_
+
+#ifdef __cplusplus
+
+#import <cstddef>
+#import <vector>
+
+#import <stdint.h>
+
+//------------------------------------------------------------------------
+//
+// Meshes of the exotic surfaces and the Klein bottle, built on the CPU
+// without an OpenGL context.  Each mesh has one vertex per parameter
+// grid point, shared by every triangle that uses it, with analytic
+// normals, and the triangles are listed by index.  The triangles are
+// the ones the display lists drew, with the same winding.
+//
+// The grid is evaluated in tiles of rows on several threads, and along
+// each row with SIMD.  Meshes are kept in a cache by surface type and
+// subdivision, so that switching between subdivision levels does not
+// rebuild meshes made before.
+//
+//------------------------------------------------------------------------
+
+namespace Surface
+{
+	// The exotic surfaces are in the order of OpenGLExoticSurfaceType
+	enum Type
+	{
+		eTranguloidTrefoil = 0,
+		eTriaxialTritorus,
+		eStiletto,
+		eSlipper,
+		eMaedersOwl,
+		eDefault,
+		eKleinBottle
+	};
+	
+	struct Vertex
+	{
+		float position[3];
+		float normal[3];
+		float texCoord[2];
+	}; // Vertex
+	
+	// Triangles, three indices each
+	struct Mesh
+	{
+		Type      mnType;
+		uint32_t  mnSubdivisions;
+		uint32_t  mnRatio;
+		
+		std::vector<Vertex>    m_Vertices;
+		std::vector<uint32_t>  m_Indices;
+		
+		// Bytes of vertices and indices
+		std::size_t GetSize() const;
+	}; // Mesh
+	
+	struct TessellatorStruct;
+	
+	class Tessellator
+	{
+	public:
+		// An exotic surface has subdivisions x ratio rows and subdivisions
+		// columns, as initExoticSurfaceWithType:subdivisions:ratio: had.
+		// The Klein bottle has subdivisions slices of subdivisions / 2
+		// stacks, as initKleinSurfaceWithTessellationFactor: had, and the
+		// ratio is ignored.
+		//
+		// Zero threads uses one thread per CPU.
+		static Mesh *Create(const Type &nType,
+							const uint32_t &nSubdivisions,
+							const uint32_t &nRatio = 1,
+							const uint32_t &nThreads = 0);
+		
+		// A cache keeping up to nCapacity bytes of meshes that are not
+		// in use.
+		Tessellator(const std::size_t &nCapacity = 32 * 1024 * 1024,
+					const uint32_t &nThreads = 0);
+		
+		virtual ~Tessellator();
+		
+		// The cache the surface classes share
+		static Tessellator &GetShared();
+		
+		// A mesh from the cache, made if it is not there.  Each mesh that
+		// is acquired must be released; until then it stays valid.
+		const Mesh *Acquire(const Type &nType,
+							const uint32_t &nSubdivisions,
+							const uint32_t &nRatio = 1);
+		
+		void Release(const Mesh *pMesh);
+		
+		// Delete the meshes not in use
+		void Purge();
+		
+		// Bytes of all meshes held, in use or not
+		const std::size_t GetSize() const;
+		
+	private:
+		Tessellator(const Tessellator &rTessellator);
+		
+		Tessellator &operator=(const Tessellator &rTessellator);
+		
+	private:
+		TessellatorStruct *mpSTessellator;
+	}; // Tessellator
+} // Surface
+
+#endif
+
+#endif
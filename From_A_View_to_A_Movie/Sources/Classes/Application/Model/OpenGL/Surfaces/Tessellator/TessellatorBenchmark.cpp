@@ -0,0 +1,752 @@
+/*
+     File: TessellatorBenchmark.cpp
+ Abstract: 
+ Checks and times the surface tessellator against the display list code.
+ 
+ Build, for example, with
+ 
+   c++ -std=c++11 -O2 -mavx -I. -I../Constants -I../../../Math/Batches \
+       TessellatorBenchmark.cpp Tessellator.cpp -lpthread -o TessellatorBenchmark
+ 
+  Version: 1.2
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+ Inc. ("Apple") in consideration of your agreement to the following
+ terms, and your use, installation, modification or redistribution of
+ this Apple software constitutes acceptance of these terms.  If you do
+ not agree with these terms, please do not use, install, modify or
+ redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software.
+ Neither the name, trademarks, service marks or logos of Apple Inc. may
+ be used to endorse or promote products derived from the Apple Software
+ without specific prior written permission from Apple.  Except as
+ expressly stated in this notice, no other rights or licenses, express or
+ implied, are granted by Apple herein, including but not limited to any
+ patent rights that may be infringed by your derivative works or by other
+ works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2013 Apple Inc. All Rights Reserved.
+ 
+ */
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#import <algorithm>
+#import <chrono>
+#import <cmath>
+#import <cstdio>
+#import <cstdlib>
+#import <vector>
+
+#import <unistd.h>
+
+//------------------------------------------------------------------------
+
+#import "GeometryConstants.h"
+#import "Tessellator.h"
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Reference Surfaces
+
+//------------------------------------------------------------------------
+//
+// The surfaces as OpenGLExoticSurface and OpenGLKleinSurface evaluate
+// them, in double precision.
+//
+//------------------------------------------------------------------------
+
+typedef void (*ReferenceFuncPtr)(double u, double v, double *p);
+
+static void ReferenceTranguloidTrefoil(double u, double v, double *p)
+{
+	double t = v + kTwoPiThird;
+	double w = 2.0 * u;
+	double A = 2.0 + cos(t);
+	double B = 2.0 + cos(v);
+	
+	p[0] = 2.0  * sin(3.0 * u) / B;
+	p[1] = 2.0  * (sin(u) + 2.0 * sin(w)) / A;
+	p[2] = 0.25 * (cos(u) - 2.0 * cos(w)) * A * B;
+} // ReferenceTranguloidTrefoil
+
+static void ReferenceTriaxialTritorus(double u, double v, double *p)
+{
+	p[0] = 2.0 * sin(u) * (1.0 + cos(v));
+	p[1] = 2.0 * sin(u + kTwoPiThird) * (1.0 + cos(v + kTwoPiThird));
+	p[2] = 2.0 * sin(u + kFourPiThird) * (1.0 + cos(v + kFourPiThird));
+} // ReferenceTriaxialTritorus
+
+static void ReferenceStiletto(double u, double v, double *p)
+{
+	double s = u;
+	
+	u = v + kPi;
+	v = 0.5 * (s + kPi);
+	
+	double w = v + kTwoPiThird;
+	double t = pow(sin(w),2.0) * pow(cos(w),2.0);
+	
+	p[0] =  4.0 * (2.0 + cos(u)) * pow(cos(v), 3.0) * sin(v);
+	p[1] =  4.0 * (2.0 + cos(u + kTwoPiThird)) * t;
+	p[2] = -4.0 * (2.0 + cos(u - kTwoPiThird)) * t;
+} // ReferenceStiletto
+
+static void ReferenceSlipper(double u, double v, double *p)
+{
+	double w = u;
+	
+	u = v + kTwoPi;
+	v = w + kPi;
+	
+	double s = kTwoPiThird + v;
+	double t = kTwoPiThird - v;
+	
+	p[0] =  4.0 * (2.0 + cos(u)) * pow(cos(v), 3.0) * sin(v);
+	p[1] =  4.0 * (2.0 + cos(u + kTwoPiThird)) * pow(cos(s), 2.0) * pow(sin(s), 2.0);
+	p[2] = -4.0 * (2.0 + cos(u - kTwoPiThird)) * pow(cos(t), 2.0) * pow(sin(t), 3.0);
+} // ReferenceSlipper
+
+static void ReferenceMaedersOwl(double u, double v, double *p)
+{
+	u = 2.0 * (u + kPi);
+	v = kTwoPiInv * (v + kPi);
+	
+	double t = 2.0 * u;
+	double r = 0.5 * v * v;
+	double s = 3.0 * v;
+	
+	p[0] =  s * cos(u) - r * cos(t);
+	p[1] = -s * sin(u) - r * sin(t);
+	p[2] =  4.0 * pow(v,1.5) * cos(1.5*u);
+} // ReferenceMaedersOwl
+
+static void ReferenceKleinBottle(double x, double y, double *p)
+{
+	double u = (1.0 - x) * kTwoPi;
+	double v = y * kTwoPi;
+	
+	double p0 = cos(v);
+	double p1 = cos(v + kPi);
+	double q0 = sin(v);
+	double r0 = sin(u);
+	double r1 = 8.0 * r0;
+	double r2 = 1.0 + r0;
+	double s0 = cos(u);
+	double s1 = 3.0 * s0;
+	double s2 = 2.0 - s0;
+	double t0 = s2 * p0;
+	double t1 = s1 * r2;
+	
+	p[0] = 0.1 * ( u < kPi ? t1 + t0 * s0 : t1 + s2 * p1 );
+	p[1] = 0.1 * -( u < kPi ? r1 + t0 * r0 : r1 );
+	p[2] = 0.1 * s2 * q0;
+} // ReferenceKleinBottle
+
+//------------------------------------------------------------------------
+
+static void Sub(const double *a, const double *b, double *c)
+{
+	c[0] = a[0] - b[0];
+	c[1] = a[1] - b[1];
+	c[2] = a[2] - b[2];
+} // Sub
+
+static void Cross(const double *a, const double *b, double *c)
+{
+	c[0] = a[1] * b[2] - a[2] * b[1];
+	c[1] = a[2] * b[0] - a[0] * b[2];
+	c[2] = a[0] * b[1] - a[1] * b[0];
+} // Cross
+
+static double Norm(const double *a)
+{
+	return sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+} // Norm
+
+// As atan2 of the sine and cosine, since acos loses half the digits near 0
+
+static double Angle(const double *a, const float *b)
+{
+	const double c[3] = { b[0], b[1], b[2] };
+	
+	double d[3];
+	
+	Cross(a, c, d);
+	
+	return atan2(Norm(d), a[0] * c[0] + a[1] * c[1] + a[2] * c[2]);
+} // Angle
+
+//------------------------------------------------------------------------
+
+static double Seconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+} // Seconds
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Display Lists
+
+//------------------------------------------------------------------------
+//
+// What the display list code did on the CPU, with the immediate mode
+// calls replaced by appending normal, texture coordinate and vertex to
+// a stream of floats, which is roughly what a display list stores.
+//
+//------------------------------------------------------------------------
+
+struct ReferenceVertex
+{
+	double p[3];
+	double n[3];
+	double t[3];
+};
+
+static void ReferenceEmit(std::vector<float> &rStream, const double *n, const double s, const double t, const double *p)
+{
+	const float v[8] = { float(n[0]), float(n[1]), float(n[2]), float(s), float(t), float(p[0]), float(p[1]), float(p[2]) };
+	
+	rStream.insert(rStream.end(), v, v + 8);
+} // ReferenceEmit
+
+static void ReferenceNormalv(const double *p, const double *q, const double *r, double *n)
+{
+	double a[3];
+	double b[3];
+	
+	Sub(q, p, a);
+	Sub(r, p, b);
+	Cross(a, b, n);
+	
+	double L = Norm(n);
+	
+	n[0] /= L;
+	n[1] /= L;
+	n[2] /= L;
+} // ReferenceNormalv
+
+static void ReferenceExoticSurface(ReferenceFuncPtr f,
+								   const int maxI,
+								   const int maxJ,
+								   std::vector<float> &rStream)
+{
+	std::vector<ReferenceVertex> vertices;
+	
+	const double invMaxI = 1.0 / double(maxI);
+	const double invMaxJ = 1.0 / double(maxJ);
+	const double delta   = 0.0005;
+	
+	int i;
+	int j;
+	
+	for( i = 0; i < maxI; i++ )
+	{
+		for( j = 0; j < maxJ; j++ )
+		{
+			ReferenceVertex vertex;
+			
+			double q[3];
+			double r[3];
+			double u = kTwoPi * i * invMaxI - kPi;
+			double v = kTwoPi * j * invMaxJ - kPi;
+			
+			f(u, v, vertex.p);
+			f(u + delta, v, q);
+			f(u, v + delta, r);
+			
+			ReferenceNormalv(vertex.p, q, r, vertex.n);
+			
+			vertex.t[0] = double(i) * invMaxI * 5.0;
+			vertex.t[1] = double(j) * invMaxJ;
+			
+			vertices.push_back(vertex);
+		} // for
+	} // for
+	
+	for( i = 0; i < maxI; i++ )
+	{
+		for( j = 0; j <= maxJ; j++ )
+		{
+			const ReferenceVertex &k = vertices[(i % maxI) * maxJ + j % maxJ];
+			const ReferenceVertex &l = vertices[((i + 1) % maxI) * maxJ + j % maxJ];
+			
+			ReferenceEmit(rStream, k.n, k.t[0], k.t[1], k.p);
+			ReferenceEmit(rStream, l.n, l.t[0], l.t[1], l.p);
+		} // for
+	} // for
+} // ReferenceExoticSurface
+
+static void ReferenceKleinVertex(const bool isFlipped, double du, double dv, double u, double v, std::vector<float> &rStream)
+{
+	double p[4][3];
+	double a[3];
+	double b[3];
+	double n[3];
+	double w = u + 0.5 * du;
+	
+	ReferenceKleinBottle(u, v, p[0]);
+	ReferenceKleinBottle(w, v, p[1]);
+	ReferenceKleinBottle(w + du, v, p[3]);
+	ReferenceKleinBottle(w, isFlipped ? v - dv : v + dv, p[2]);
+	
+	Sub(p[3], p[1], a);
+	Sub(p[2], p[1], b);
+	Cross(a, b, n);
+	
+	if( Norm(n) < 0.00001 )
+	{
+		n[0] = p[0][0]; n[1] = p[0][1]; n[2] = p[0][2];
+	} // if
+	
+	double L = Norm(n);
+	
+	n[0] /= L; n[1] /= L; n[2] /= L;
+	
+	ReferenceEmit(rStream, n, 4.0 * u, v, p[0]);
+} // ReferenceKleinVertex
+
+static void ReferenceKlein(const int nFactor, std::vector<float> &rStream)
+{
+	int    stacks = nFactor / 2;
+	double du     = 1.0 / (double)nFactor;
+	double dv     = 1.0 / (double)stacks;
+	double uMax   = 1.0 - 0.5 * du;
+	double vMax   = 1.0 + 0.5 * dv;
+	double u;
+	double v;
+	
+	for( u = 0.0; u < uMax; u += du )
+	{
+		bool isFlipped = u < 0.125;
+		
+		for( v = 0.0; v < vMax; v += dv )
+		{
+			ReferenceKleinVertex(isFlipped, du, dv, isFlipped ? u + du : u, v, rStream);
+			ReferenceKleinVertex(isFlipped, du, dv, isFlipped ? u : u + du, v, rStream);
+		} // for
+	} // for
+} // ReferenceKlein
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Checks
+
+//------------------------------------------------------------------------
+
+struct ReferenceSurface
+{
+	const char        *name;
+	Surface::Type      type;
+	ReferenceFuncPtr   f;
+};
+
+static const ReferenceSurface kSurfaces[] =
+{
+	{ "trefoil",  Surface::eTranguloidTrefoil, &ReferenceTranguloidTrefoil },
+	{ "tritorus", Surface::eTriaxialTritorus,  &ReferenceTriaxialTritorus },
+	{ "stiletto", Surface::eStiletto,          &ReferenceStiletto },
+	{ "slipper",  Surface::eSlipper,           &ReferenceSlipper },
+	{ "owl",      Surface::eMaedersOwl,        &ReferenceMaedersOwl },
+	{ "klein",    Surface::eKleinBottle,       &ReferenceKleinBottle }
+};
+
+static const std::size_t kSurfaceCount = sizeof(kSurfaces) / sizeof(kSurfaces[0]);
+
+//------------------------------------------------------------------------
+//
+// The parameters of mesh vertex k, as the tessellator lays them out.
+//
+//------------------------------------------------------------------------
+
+static void Parameters(const ReferenceSurface &rSurface,
+					   const std::size_t &nSubdivisions,
+					   const std::size_t &nRatio,
+					   const std::size_t &k,
+					   double &u,
+					   double &v,
+					   double &sign)
+{
+	sign = 1.0;
+	
+	if( rSurface.type == Surface::eKleinBottle )
+	{
+		const std::size_t nSlices  = nSubdivisions;
+		const std::size_t nColumns = nSubdivisions / 2 + 1;
+		
+		std::size_t i = k / nColumns;
+		std::size_t j = k % nColumns;
+		std::size_t n = 0;
+		
+		while( ( n < nSlices ) && ( double(n) / double(nSlices) < 0.125 ) )
+		{
+			++n;
+		} // while
+		
+		if( i == nSlices + 1 )
+		{
+			i    = n;
+			sign = -1.0;
+		} // if
+		else if( i < n )
+		{
+			sign = -1.0;
+		} // else if
+		
+		u = double(i) / double(nSlices);
+		v = double(j) / double(nColumns - 1);
+	} // if
+	else
+	{
+		const std::size_t nRows = nSubdivisions * nRatio;
+		
+		u = kTwoPi * double(k / nSubdivisions) / double(nRows) - kPi;
+		v = kTwoPi * double(k % nSubdivisions) / double(nSubdivisions) - kPi;
+	} // else
+} // Parameters
+
+//------------------------------------------------------------------------
+//
+// Positions against the reference surface, relative to the size of the
+// surface, and normals against central differences.  Where the surface
+// pinches to a point, the normals are only checked to be unit vectors.
+// Nearly every triangle should also face the same way as its vertex
+// normals, as the display list's did; on coarse grids some triangles
+// across tight folds do not.
+//
+//------------------------------------------------------------------------
+
+static bool Check(const ReferenceSurface &rSurface,
+				  const std::size_t &nSubdivisions,
+				  const std::size_t &nRatio)
+{
+	const Surface::Mesh *pMesh = Surface::Tessellator::Create(rSurface.type, uint32_t(nSubdivisions), uint32_t(nRatio));
+	
+	const std::size_t nVertices = pMesh->m_Vertices.size();
+	const std::size_t nIndices  = pMesh->m_Indices.size();
+	
+	const double h = 1.0e-6;
+	
+	double nExtent   = 0.0;
+	double nPosition = 0.0;
+	double nNormal   = 0.0;
+	double nUnit     = 0.0;
+	
+	std::size_t nPinched = 0;
+	std::size_t nFacing  = 0;
+	std::size_t k;
+	
+	for( k = 0; k < nVertices; ++k )
+	{
+		const Surface::Vertex &rVertex = pMesh->m_Vertices[k];
+		
+		double u, v, sign;
+		double p[3], a[3], b[3], c[3], d[3], pu[3], pv[3], n[3];
+		
+		Parameters(rSurface, nSubdivisions, nRatio, k, u, v, sign);
+		
+		rSurface.f(u, v, p);
+		
+		// The halves of the Klein bottle meet along u = 1/2 with a kink,
+		// and the tessellator takes the side below
+		
+		if( rSurface.type == Surface::eKleinBottle )
+		{
+			rSurface.f(u, v, a);
+			rSurface.f(u - 2.0 * h, v, b);
+		} // if
+		else
+		{
+			rSurface.f(u + h, v, a);
+			rSurface.f(u - h, v, b);
+		} // else
+		
+		rSurface.f(u, v + h, c);
+		rSurface.f(u, v - h, d);
+		
+		Sub(a, b, pu);
+		Sub(c, d, pv);
+		Cross(pu, pv, n);
+		
+		n[0] *= sign; n[1] *= sign; n[2] *= sign;
+		
+		nExtent = std::max(nExtent, Norm(p));
+		
+		for( std::size_t l = 0; l < 3; ++l )
+		{
+			nPosition = std::max(nPosition, std::fabs(p[l] - rVertex.position[l]));
+		} // for
+		
+		const double L = std::sqrt(double(rVertex.normal[0]) * rVertex.normal[0]
+								   + double(rVertex.normal[1]) * rVertex.normal[1]
+								   + double(rVertex.normal[2]) * rVertex.normal[2]);
+		
+		nUnit = std::max(nUnit, std::fabs(L - 1.0));
+		
+		if( Norm(n) > 1.0e-4 * Norm(pu) * Norm(pv) )
+		{
+			nNormal = std::max(nNormal, Angle(n, rVertex.normal));
+		} // if
+		else
+		{
+			++nPinched;
+		} // else
+	} // for
+	
+	for( k = 0; k < nIndices; k += 3 )
+	{
+		const Surface::Vertex &A = pMesh->m_Vertices[pMesh->m_Indices[k]];
+		const Surface::Vertex &B = pMesh->m_Vertices[pMesh->m_Indices[k + 1]];
+		const Surface::Vertex &C = pMesh->m_Vertices[pMesh->m_Indices[k + 2]];
+		
+		double e[3], f[3], g[3];
+		
+		for( std::size_t l = 0; l < 3; ++l )
+		{
+			e[l] = double(B.position[l]) - A.position[l];
+			f[l] = double(C.position[l]) - A.position[l];
+		} // for
+		
+		Cross(e, f, g);
+		
+		double s = 0.0;
+		
+		for( std::size_t l = 0; l < 3; ++l )
+		{
+			s += g[l] * (double(A.normal[l]) + B.normal[l] + C.normal[l]);
+		} // for
+		
+		nFacing += ( s >= 0.0 ) ? 1 : 0;
+	} // for
+	
+	const double nTriangles = double(nIndices / 3);
+	const double nFace      = nTriangles > 0.0 ? double(nFacing) / nTriangles : 1.0;
+	const double nRelative  = nPosition / std::max(nExtent, 1.0e-30);
+	
+	const bool bPassed = ( nRelative < 1.0e-5 ) && ( nNormal < 1.0e-4 ) && ( nUnit < 1.0e-5 ) && ( nFace > 0.95 );
+	
+	std::printf("%-9s %9zu %10zu   %9.2e  %9.2e  %9.2e %8zu   %6.2f%%  %s\n",
+				rSurface.name, nVertices, nIndices / 3, nRelative, nNormal, nUnit, nPinched,
+				100.0 * nFace, bPassed ? "ok" : "FAILED");
+	
+	delete pMesh;
+	
+	return bPassed;
+} // Check
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+#pragma mark -
+#pragma mark Private - Timing
+
+//------------------------------------------------------------------------
+
+static double TimeReference(const ReferenceSurface &rSurface,
+							const std::size_t &nSubdivisions,
+							const std::size_t &nRatio,
+							std::size_t &nBytes)
+{
+	double nBest = 1.0e30;
+	
+	for( int r = 0; r < 3; ++r )
+	{
+		std::vector<float> stream;
+		
+		double t = Seconds();
+		
+		if( rSurface.type == Surface::eKleinBottle )
+		{
+			ReferenceKlein(int(nSubdivisions), stream);
+		} // if
+		else
+		{
+			ReferenceExoticSurface(rSurface.f, int(nSubdivisions * nRatio), int(nSubdivisions), stream);
+		} // else
+		
+		nBest  = std::min(nBest, Seconds() - t);
+		nBytes = stream.size() * sizeof(float);
+	} // for
+	
+	return nBest;
+} // TimeReference
+
+//------------------------------------------------------------------------
+
+static double TimeTessellator(const ReferenceSurface &rSurface,
+							  const std::size_t &nSubdivisions,
+							  const std::size_t &nRatio,
+							  const uint32_t &nThreads,
+							  std::size_t &nBytes)
+{
+	double nBest = 1.0e30;
+	
+	for( int r = 0; r < 3; ++r )
+	{
+		double t = Seconds();
+		
+		Surface::Mesh *pMesh = Surface::Tessellator::Create(rSurface.type, uint32_t(nSubdivisions), uint32_t(nRatio), nThreads);
+		
+		nBest  = std::min(nBest, Seconds() - t);
+		nBytes = pMesh->GetSize();
+		
+		delete pMesh;
+	} // for
+	
+	return nBest;
+} // TimeTessellator
+
+//------------------------------------------------------------------------
+//
+// A second acquire of the same mesh is a lookup, and the cache keeps
+// the meshes that are released until they exceed its capacity.
+//
+//------------------------------------------------------------------------
+
+static bool CheckCache()
+{
+	Surface::Tessellator cache(4 * 1024 * 1024);
+	
+	double t0 = Seconds();
+	
+	const Surface::Mesh *pA = cache.Acquire(Surface::eTriaxialTritorus, 128, 16);
+	
+	double t1 = Seconds();
+	
+	const Surface::Mesh *pB = cache.Acquire(Surface::eTriaxialTritorus, 128, 16);
+	
+	double t2 = Seconds();
+	
+	const Surface::Mesh *pC = cache.Acquire(Surface::eKleinBottle, 64, 7);
+	const Surface::Mesh *pD = cache.Acquire(Surface::eKleinBottle, 64);
+	
+	bool bPassed = ( pA == pB ) && ( pC == pD ) && ( pA != pC );
+	
+	const std::size_t nSize = cache.GetSize();
+	
+	// The tritorus alone exceeds the capacity, so once released it goes
+	
+	cache.Release(pA);
+	
+	bPassed &= cache.GetSize() == nSize;
+	
+	cache.Release(pB);
+	
+	bPassed &= cache.GetSize() == pC->GetSize();
+	
+	// The Klein bottle fits, so it stays until purged
+	
+	const std::size_t nKlein = pC->GetSize();
+	
+	cache.Release(pC);
+	cache.Release(pD);
+	
+	bPassed &= cache.GetSize() == nKlein;
+	
+	cache.Purge();
+	
+	bPassed &= cache.GetSize() == 0;
+	
+	std::printf("\ncache: create %.2f ms, hit %.2f us, %s\n",
+				1.0e3 * (t1 - t0), 1.0e6 * (t2 - t1), bPassed ? "ok" : "FAILED");
+	
+	return bPassed;
+} // CheckCache
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
+
+int main(int argc, const char * argv[])
+{
+	const long nCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+	
+	bool bPassed = true;
+	
+	std::size_t i;
+	std::size_t k;
+	
+	std::printf("surface    vertices  triangles   position     normal       unit  pinched   facing\n");
+	
+	for( i = 0; i < kSurfaceCount; ++i )
+	{
+		bPassed &= Check(kSurfaces[i], kSurfaces[i].type == Surface::eKleinBottle ? 64 : 128, 16);
+	} // for
+	
+	bPassed &= Check(kSurfaces[0], 7, 3);
+	bPassed &= Check(kSurfaces[5], 13, 1);
+	
+	bPassed &= CheckCache();
+	
+	std::printf("\n%ld CPUs online\n\n", nCPUs);
+	std::printf("surface   subdiv  display list ms      MB   mesh ms (1 thread)  (all)      MB  speedup\n");
+	
+	const std::size_t kSubdivisions[] = { 16, 32, 64, 128, 256 };
+	
+	for( i = 0; i < kSurfaceCount; ++i )
+	{
+		for( k = 0; k < sizeof(kSubdivisions) / sizeof(kSubdivisions[0]); ++k )
+		{
+			const ReferenceSurface &rSurface = kSurfaces[i];
+			
+			// The Klein bottle exhibit uses 64 slices, the others 128 x 16
+			
+			const std::size_t nSubdivisions = kSubdivisions[k] * ( rSurface.type == Surface::eKleinBottle ? 4 : 1 );
+			const std::size_t nRatio        = 16;
+			
+			std::size_t nListBytes = 0;
+			std::size_t nMeshBytes = 0;
+			
+			double t0 = TimeReference(rSurface, nSubdivisions, nRatio, nListBytes);
+			double t1 = TimeTessellator(rSurface, nSubdivisions, nRatio, 1, nMeshBytes);
+			double t2 = TimeTessellator(rSurface, nSubdivisions, nRatio, 0, nMeshBytes);
+			
+			std::printf("%-9s %6zu  %15.2f  %6.2f  %18.2f  %6.2f  %6.2f  %6.1fx\n",
+						rSurface.name, nSubdivisions, 1.0e3 * t0, nListBytes / 1048576.0,
+						1.0e3 * t1, 1.0e3 * t2, nMeshBytes / 1048576.0, t0 / std::min(t1, t2));
+		} // for
+	} // for
+	
+	std::printf("\n%s\n", bPassed ? "all meshes match the display lists" : "MISMATCH");
+	
+	return bPassed ? EXIT_SUCCESS : EXIT_FAILURE;
+} // main
+
+//------------------------------------------------------------------------
+
+//------------------------------------------------------------------------
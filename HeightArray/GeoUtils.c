@@ -47,21 +47,36 @@
 
 #include "GeoUtils.h"
 
-static unsigned int randseed, m_lo, m_hi;
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__SSE__)
+	#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+#endif
+
+// ---------------------------------------------------------------------
+// 32 bit RANROT-B PRNG state, kept per call so that GenHeightMap is reentrant
+// ---------------------------------------------------------------------
+typedef struct { unsigned int lo, hi; } RanRot;
+
 // ---------------------------------------------------------------------
 // seed 32 bit RANROT-B PRNG
 // ---------------------------------------------------------------------
-static inline void rands(int seed){ randseed = m_lo = seed; m_hi = ~seed; }
+static inline void rands(RanRot *rng, int seed){ rng->lo = seed; rng->hi = ~seed; }
 
 // ---------------------------------------------------------------------
 // get 32 bits of noise
 // ---------------------------------------------------------------------
-static inline int randi(void) { m_hi = (m_hi<<16) + (m_hi>>16); m_hi += m_lo; m_lo += m_hi; return m_hi; }
+static inline int randi(RanRot *rng) { rng->hi = (rng->hi<<16) + (rng->hi>>16); rng->hi += rng->lo; rng->lo += rng->hi; return rng->hi; }
 
 // ---------------------------------------------------------------------
 // get random float in range [-x..x]
 // ---------------------------------------------------------------------
-static inline float randf(float x) { return (x * randi() / (float)0x7FFFFFFF); }
+static inline float randf(RanRot *rng, float x) { return (x * randi(rng) / (float)0x7FFFFFFF); }
 
 float *GenHeightMap(int wide, int deep, int seed)
 {
@@ -73,8 +88,9 @@ float *GenHeightMap(int wide, int deep, int seed)
     float r = 0.5;
     float *h = malloc(wide * deep * sizeof(float));
     float *map = calloc(1, wide * deep * sizeof(float) * 6);
-    rands(seed);
-    h[0] = randf(noiseRange);
+    RanRot rng;
+    rands(&rng, seed);
+    h[0] = randf(&rng, noiseRange);
     while(w > 0)
     {
     	// diamond midpoint displacement
@@ -90,7 +106,7 @@ float *GenHeightMap(int wide, int deep, int seed)
 				(h[i  +  j * wide] + 
 				 h[ni +  j * wide] + 
 				 h[i  + nj * wide] + 
-				 h[ni + nj * wide]) * 0.25f + randf(noiseRange);
+				 h[ni + nj * wide]) * 0.25f + randf(&rng, noiseRange);
             }
         }
         
@@ -109,12 +125,12 @@ float *GenHeightMap(int wide, int deep, int seed)
 				(h[i  + j   * wide] + 
 				 h[ni + j   * wide] + 
 				 h[mi + pmj * wide] + 
-				 h[mi + mj  * wide]) * 0.25f + randf(noiseRange);
+				 h[mi + mj  * wide]) * 0.25f + randf(&rng, noiseRange);
                 h[i + mj * wide] = 
 				(h[i   + j  * wide] + 
 				 h[i   + nj * wide] + 
 				 h[pmi + mj * wide] + 
-				 h[mi  + mj * wide]) * 0.25f +  randf(noiseRange);
+				 h[mi  + mj * wide]) * 0.25f +  randf(&rng, noiseRange);
             }
         }
 		
@@ -175,3 +191,438 @@ float *GenHeightMap(int wide, int deep, int seed)
     free(h);
     return map;
 }
+
+// ---------------------------------------------------------------------
+// 4-wide float vectors for the inner loop. Every sample, including the
+// ragged end of a run, goes through the same vector operations so that a
+// height never depends on which lane computed it.
+// ---------------------------------------------------------------------
+#if defined(__SSE__)
+typedef __m128 GeoVec4;
+static inline GeoVec4 GeoLoad4(const float *p) { return _mm_loadu_ps(p); }
+static inline void GeoStore4(float *p, GeoVec4 v) { _mm_storeu_ps(p, v); }
+static inline GeoVec4 GeoSplat4(float x) { return _mm_set1_ps(x); }
+static inline GeoVec4 GeoMulAdd4(GeoVec4 acc, GeoVec4 a, GeoVec4 d, GeoVec4 s) { return _mm_add_ps(acc, _mm_add_ps(a, _mm_mul_ps(d, s))); }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+typedef float32x4_t GeoVec4;
+static inline GeoVec4 GeoLoad4(const float *p) { return vld1q_f32(p); }
+static inline void GeoStore4(float *p, GeoVec4 v) { vst1q_f32(p, v); }
+static inline GeoVec4 GeoSplat4(float x) { return vdupq_n_f32(x); }
+static inline GeoVec4 GeoMulAdd4(GeoVec4 acc, GeoVec4 a, GeoVec4 d, GeoVec4 s) { return vaddq_f32(acc, vaddq_f32(a, vmulq_f32(d, s))); }
+#else
+typedef struct { float f[4]; } GeoVec4;
+static inline GeoVec4 GeoLoad4(const float *p) { GeoVec4 v; memcpy(v.f, p, sizeof(v.f)); return v; }
+static inline void GeoStore4(float *p, GeoVec4 v) { memcpy(p, v.f, sizeof(v.f)); }
+static inline GeoVec4 GeoSplat4(float x) { GeoVec4 v = {{ x, x, x, x }}; return v; }
+static inline GeoVec4 GeoMulAdd4(GeoVec4 acc, GeoVec4 a, GeoVec4 d, GeoVec4 s)
+{
+	int k;
+	for (k = 0; k < 4; k++)
+		acc.f[k] += a.f[k] + d.f[k] * s.f[k];
+	return acc;
+}
+#endif
+
+// ---------------------------------------------------------------------
+// counter-based RNG: a strong 32 bit integer mix applied to (key, counter)
+// ---------------------------------------------------------------------
+static inline uint32_t GeoMix32(uint32_t x)
+{
+	x ^= x >> 16; x *= 0x7FEB352Du;
+	x ^= x >> 15; x *= 0x846CA68Bu;
+	x ^= x >> 16;
+	return x;
+}
+
+uint32_t GeoRandom(uint32_t key, uint64_t counter)
+{
+	uint32_t h = GeoMix32((uint32_t)(counter >> 32) + 0x9E3779B9u);
+	h = GeoMix32(h ^ (uint32_t)counter);
+	return GeoMix32(h ^ key);
+}
+
+// lattice value in [-1..1) for cell (cx, cy) of an octave
+static inline float GeoLattice(uint32_t key, int64_t cx, int64_t cy)
+{
+	uint32_t h = GeoRandom(key, ((uint64_t)(uint32_t)cx << 32) | (uint32_t)cy);
+	return (float)(int32_t)h * (1.0f / 2147483648.0f);
+}
+
+static inline uint32_t GeoOctaveKey(const GeoTerrainParams *params, int octave)
+{
+	return GeoMix32(params->seed + (uint32_t)octave * 0x9E3779B9u);
+}
+
+// floor(v / 2^s) for negative coordinates too
+static inline int64_t GeoFloorShift(int64_t v, int s)
+{
+	return (v >= 0) ? (v >> s) : -(((-v) - 1) >> s) - 1;
+}
+
+// c * 2^s, the world position of cell c; multiplied because shifting a negative value left is undefined
+static inline int64_t GeoCellOrigin(int64_t c, int s)
+{
+	return c * ((int64_t)1 << s);
+}
+
+// quintic fade, t in [0..1)
+static inline float GeoFade(float t)
+{
+	return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+void GeoTerrainDefaultParams(GeoTerrainParams *params, uint32_t seed)
+{
+	params->seed = seed;
+	params->log2CellSize = 9;
+	params->octaves = 9;
+	params->amplitude = 96.0f;
+	params->persistence = 0.5f;
+}
+
+int GeoTerrainOctavesForLod(const GeoTerrainParams *params, int lod)
+{
+	// octave o survives while its lattice spacing spans at least two samples
+	int octaves = params->log2CellSize - lod;
+	if (octaves > params->octaves)
+		octaves = params->octaves;
+	return (octaves > 0) ? octaves : 0;
+}
+
+// ---------------------------------------------------------------------
+// Evaluate w x h samples. Rows are generated one at a time and each
+// octave is accumulated into the row while it sits in L1: the lattice
+// values of the row are blended in y once per cell, then every run of
+// samples inside a cell is a single vector multiply-add against a fade
+// table shared by all rows.
+// ---------------------------------------------------------------------
+static void GeoEvalRows(const GeoTerrainParams *params, int64_t x0, int64_t y0, int w, int h, int lod, int octaves, float *out, size_t rowStride)
+{
+	int i, j, o;
+	const int64_t step = (int64_t)1 << lod;
+	const int64_t phase = x0 & (step - 1);	// offset of the samples from the step grid
+	const int cellCapacity = w / 2 + 4;
+	int fadeSize = 0;
+	float *fades, *lerps, *lattice;
+	int64_t *latticeRow;
+	
+	for (o = 0; o < octaves; o++)
+		fadeSize += 1 << (params->log2CellSize - o - lod);
+	fades = malloc(sizeof(float) * (fadeSize + 4));
+	lerps = malloc(sizeof(float) * cellCapacity);
+	lattice = malloc(sizeof(float) * cellCapacity * 2 * (octaves + 1));
+	latticeRow = malloc(sizeof(int64_t) * (octaves + 1));
+	
+	// per octave fade tables: sample t of a cell lies at offset phase + t * step
+	{
+		float *fade = fades;
+		for (o = 0; o < octaves; o++)
+		{
+			int shift = params->log2CellSize - o, k = 1 << (shift - lod);
+			for (i = 0; i < k; i++)
+				fade[i] = GeoFade((float)(phase + i * step) / (float)((int64_t)1 << shift));
+			fade += k;
+			latticeRow[o] = INT64_MIN;
+		}
+	}
+	
+	for (j = 0; j < h; j++)
+	{
+		const int64_t y = y0 + j * step;
+		float *row = out + j * rowStride;
+		const float *fade = fades;
+		float amp = params->amplitude;
+		
+		memset(row, 0, sizeof(float) * w);
+		for (o = 0; o < octaves; o++)
+		{
+			const int shift = params->log2CellSize - o, k = 1 << (shift - lod);
+			const int64_t cy = GeoFloorShift(y, shift);
+			const float sy = GeoFade((float)(y - GeoCellOrigin(cy, shift)) / (float)((int64_t)1 << shift));
+			const int64_t cFirst = GeoFloorShift(x0, shift);
+			const int cells = (int)(GeoFloorShift(x0 + (int64_t)(w - 1) * step, shift) - cFirst) + 2;
+			float *below = lattice + o * cellCapacity * 2, *above = below + cellCapacity;
+			int64_t c;
+			int t0 = (int)(((x0 - GeoCellOrigin(cFirst, shift)) - phase) >> lod);
+			
+			// the lattice rows bracketing y are shared by every sample row inside the cell,
+			// so they are only hashed when y crosses into the next row of cells
+			if (cy != latticeRow[o])
+			{
+				const uint32_t key = GeoOctaveKey(params, o);
+				if (cy == latticeRow[o] + 1)
+					memcpy(below, above, sizeof(float) * cells);
+				else
+					for (c = 0; c < cells; c++)
+						below[c] = GeoLattice(key, cFirst + c, cy);
+				for (c = 0; c < cells; c++)
+					above[c] = GeoLattice(key, cFirst + c, cy + 1);
+				latticeRow[o] = cy;
+			}
+			for (c = 0; c < cells; c++)
+				lerps[c] = below[c] + (above[c] - below[c]) * sy;
+			
+			// with fewer than four samples per cell the runs are too short for whole vectors,
+			// so the lanes are gathered from consecutive cells instead
+			if (k < 4)
+			{
+				int t = t0;
+				c = 0;
+				for (i = 0; i < w; i += 4)
+				{
+					float va[4] = { 0, 0, 0, 0 }, vd[4] = { 0, 0, 0, 0 }, vs[4] = { 0, 0, 0, 0 }, accum[4] = { 0, 0, 0, 0 };
+					const int lanes = (w - i < 4) ? (w - i) : 4;
+					int lane;
+					for (lane = 0; lane < lanes; lane++)
+					{
+						va[lane] = amp * lerps[c];
+						vd[lane] = amp * (lerps[c + 1] - lerps[c]);
+						vs[lane] = fade[t];
+						accum[lane] = row[i + lane];
+						if (++t == k)
+						{
+							t = 0;
+							c++;
+						}
+					}
+					GeoStore4(accum, GeoMulAdd4(GeoLoad4(accum), GeoLoad4(va), GeoLoad4(vd), GeoLoad4(vs)));
+					memcpy(row + i, accum, sizeof(float) * lanes);
+				}
+			}
+			else for (i = 0, c = 0; i < w; c++)
+			{
+				const int run = (k - t0 < w - i) ? (k - t0) : (w - i);
+				const float lo = lerps[c], hi = lerps[c + 1];
+				const GeoVec4 va = GeoSplat4(amp * lo), vd = GeoSplat4(amp * (hi - lo));
+				float *dst = row + i;
+				const float *s = fade + t0;
+				int t = 0;
+				
+				for (; t + 4 <= run; t += 4)
+					GeoStore4(dst + t, GeoMulAdd4(GeoLoad4(dst + t), va, vd, GeoLoad4(s + t)));
+				if (t < run)
+				{
+					float accum[4] = { 0, 0, 0, 0 }, fd[4] = { 0, 0, 0, 0 };
+					memcpy(accum, dst + t, sizeof(float) * (run - t));
+					memcpy(fd, s + t, sizeof(float) * (run - t));
+					GeoStore4(accum, GeoMulAdd4(GeoLoad4(accum), va, vd, GeoLoad4(fd)));
+					memcpy(dst + t, accum, sizeof(float) * (run - t));
+				}
+				i += run;
+				t0 = 0;
+			}
+			fade += k;
+			amp *= params->persistence;
+		}
+	}
+	free(latticeRow);
+	free(lattice);
+	free(lerps);
+	free(fades);
+}
+
+// ---------------------------------------------------------------------
+// simple work sharing: threads pull item indices from a shared counter
+// ---------------------------------------------------------------------
+typedef struct
+{
+	void (*body)(void *context, int64_t item, float *scratch);
+	void *context;
+	int64_t next, count;
+	size_t scratchFloats;
+} GeoWork;
+
+static void *GeoWorker(void *arg)
+{
+	GeoWork *work = arg;
+	float *scratch = work->scratchFloats ? malloc(sizeof(float) * work->scratchFloats) : NULL;
+	int64_t item;
+	while ((item = __sync_fetch_and_add(&work->next, 1)) < work->count)
+		work->body(work->context, item, scratch);
+	free(scratch);
+	return NULL;
+}
+
+static void GeoRunWork(GeoWork *work, int threadCount)
+{
+	pthread_t threads[64];
+	int i, started = 0;
+	
+	if (threadCount <= 0)
+	{
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threadCount = (cpus > 0) ? (int)cpus : 1;
+	}
+	if (threadCount > 64)
+		threadCount = 64;
+	if (threadCount > work->count)
+		threadCount = (int)work->count;
+	
+	// the calling thread is one of the workers
+	for (i = 1; i < threadCount; i++)
+		if (pthread_create(&threads[started], NULL, GeoWorker, work) == 0)
+			started++;
+	GeoWorker(work);
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+}
+
+// ---------------------------------------------------------------------
+// regions, in bands of rows
+// ---------------------------------------------------------------------
+#define kGeoBandRows 16
+
+typedef struct
+{
+	const GeoTerrainParams *params;
+	int64_t x0, y0;
+	int w, h, lod, octaves;
+	float *heights;
+	size_t rowStride;
+} GeoRegion;
+
+static void GeoRegionBand(void *context, int64_t band, float *scratch)
+{
+	GeoRegion *region = context;
+	int j0 = (int)band * kGeoBandRows;
+	int rows = (region->h - j0 < kGeoBandRows) ? region->h - j0 : kGeoBandRows;
+	(void)scratch;
+	GeoEvalRows(region->params, region->x0, region->y0 + ((int64_t)j0 << region->lod), region->w, rows, region->lod, region->octaves,
+				region->heights + j0 * region->rowStride, region->rowStride);
+}
+
+void GeoGenTerrainRegion(const GeoTerrainParams *params, int64_t x0, int64_t y0, int w, int h, int lod, float *heights, size_t rowStride, int threadCount)
+{
+	GeoRegion region = { params, x0, y0, w, h, lod, GeoTerrainOctavesForLod(params, lod), heights, rowStride };
+	GeoWork work = { GeoRegionBand, &region, 0, (h + kGeoBandRows - 1) / kGeoBandRows, 0 };
+	
+	if (w <= 0 || h <= 0)
+		return;
+	GeoRunWork(&work, threadCount);
+}
+
+// ---------------------------------------------------------------------
+// level of detail seams: along an edge shared with a coarser patch, take
+// the coarse patch's own vertex values (evaluated exactly as it evaluates
+// them) and interpolate the fine vertices in between, removing T-junction
+// cracks. grid points at the patch corner, rows rowStride floats apart.
+// ---------------------------------------------------------------------
+static void GeoStitchEdge(const GeoTerrainParams *params, int64_t x0, int64_t y0, int size, int lod, int edge, int neighborLod, float *grid, size_t rowStride)
+{
+	const int64_t step = (int64_t)1 << lod, coarseStep = (int64_t)1 << neighborLod;
+	const int vertical = (edge == kGeoEdgeLeft || edge == kGeoEdgeRight);
+	const int64_t fixedCoord = (edge == kGeoEdgeLeft) ? x0 : (edge == kGeoEdgeRight) ? x0 + size * step
+							 : (edge == kGeoEdgeBottom) ? y0 : y0 + size * step;
+	const int64_t start = vertical ? y0 : x0;
+	const int64_t coarseStart = GeoCellOrigin(GeoFloorShift(start, neighborLod), neighborLod);
+	const int coarseCount = (int)(GeoFloorShift(start + size * step, neighborLod) - GeoFloorShift(start, neighborLod)) + 2;
+	const int octaves = GeoTerrainOctavesForLod(params, neighborLod);
+	float *coarse = malloc(sizeof(float) * coarseCount);
+	int i;
+	
+	if (vertical)
+		GeoEvalRows(params, fixedCoord, coarseStart, 1, coarseCount, neighborLod, octaves, coarse, 1);
+	else
+		GeoEvalRows(params, coarseStart, fixedCoord, coarseCount, 1, neighborLod, octaves, coarse, coarseCount);
+	
+	for (i = 0; i <= size; i++)
+	{
+		int64_t p = start + i * step, offset = p - coarseStart;
+		int64_t index = offset >> neighborLod, remainder = offset - GeoCellOrigin(index, neighborLod);
+		float value = coarse[index];
+		if (remainder)
+			value += (coarse[index + 1] - coarse[index]) * ((float)remainder / (float)coarseStep);
+		
+		if (edge == kGeoEdgeLeft)
+			grid[i * rowStride] = value;
+		else if (edge == kGeoEdgeRight)
+			grid[i * rowStride + size] = value;
+		else if (edge == kGeoEdgeBottom)
+			grid[i] = value;
+		else
+			grid[size * rowStride + i] = value;
+	}
+	free(coarse);
+}
+
+static void GeoStitchPatch(const GeoTerrainParams *params, int64_t x0, int64_t y0, int size, int lod, const int neighborLods[kGeoEdgeCount], float *grid, size_t rowStride)
+{
+	int edge;
+	if (!neighborLods)
+		return;
+	for (edge = 0; edge < kGeoEdgeCount; edge++)
+		if (neighborLods[edge] > lod)
+			GeoStitchEdge(params, x0, y0, size, lod, edge, neighborLods[edge], grid, rowStride);
+}
+
+void GeoGenTerrainPatch(const GeoTerrainParams *params, int64_t x0, int64_t y0, int size, int lod, const int neighborLods[kGeoEdgeCount], float *heights)
+{
+	GeoEvalRows(params, x0, y0, size + 1, size + 1, lod, GeoTerrainOctavesForLod(params, lod), heights, size + 1);
+	GeoStitchPatch(params, x0, y0, size, lod, neighborLods, heights, size + 1);
+}
+
+float *GenTerrainPatchMap(const GeoTerrainParams *params, int64_t x0, int64_t y0, int size, int lod, const int neighborLods[kGeoEdgeCount])
+{
+	const int n = size + 1, apron = size + 3;
+	const float step = (float)((int64_t)1 << lod);
+	float *h = malloc(sizeof(float) * apron * apron);
+	float *map = malloc(sizeof(float) * n * n * 6);
+	int i, j;
+	
+	// one extra sample on every side so that normals on the edges see their neighbours
+	GeoEvalRows(params, x0 - ((int64_t)1 << lod), y0 - ((int64_t)1 << lod), apron, apron, lod, GeoTerrainOctavesForLod(params, lod), h, apron);
+	GeoStitchPatch(params, x0, y0, size, lod, neighborLods, h + apron + 1, apron);
+	
+	for (j = 0; j < n; j++)
+	{
+		for (i = 0; i < n; i++)
+		{
+			const float *c = h + (j + 1) * apron + (i + 1);
+			float *v = map + (j * n + i) * 6;
+			float nx = c[-1] - c[1], ny = c[-apron] - c[apron], nz = 2.0f * step;
+			float len = sqrtf(nx * nx + ny * ny + nz * nz);
+			
+			v[0] = (float)(x0 + ((int64_t)i << lod));
+			v[1] = (float)(y0 + ((int64_t)j << lod));
+			v[2] = c[0];
+			v[3] = nx / len;
+			v[4] = ny / len;
+			v[5] = nz / len;
+		}
+	}
+	free(h);
+	return map;
+}
+
+// ---------------------------------------------------------------------
+// streaming: threads pull chunk indices and hand each chunk to the callback
+// ---------------------------------------------------------------------
+typedef struct
+{
+	const GeoTerrainParams *params;
+	int64_t chunkX0, chunkY0, chunksAcross;
+	int size, lod, octaves;
+	GeoTerrainChunkCallback callback;
+	void *context;
+} GeoStream;
+
+static void GeoStreamChunk(void *context, int64_t item, float *heights)
+{
+	GeoStream *stream = context;
+	int64_t cx = stream->chunkX0 + item % stream->chunksAcross;
+	int64_t cy = stream->chunkY0 + item / stream->chunksAcross;
+	int64_t span = (int64_t)stream->size << stream->lod;
+	
+	GeoEvalRows(stream->params, cx * span, cy * span, stream->size + 1, stream->size + 1, stream->lod, stream->octaves, heights, stream->size + 1);
+	stream->callback(stream->context, cx, cy, stream->lod, heights, stream->size);
+}
+
+void GeoStreamTerrain(const GeoTerrainParams *params, int64_t chunkX0, int64_t chunkY0, int64_t chunksAcross, int64_t chunksDown, int size, int lod, int threadCount, GeoTerrainChunkCallback callback, void *context)
+{
+	GeoStream stream = { params, chunkX0, chunkY0, chunksAcross, size, lod, GeoTerrainOctavesForLod(params, lod), callback, context };
+	GeoWork work = { GeoStreamChunk, &stream, 0, chunksAcross * chunksDown, (size_t)(size + 1) * (size + 1) };
+	
+	if (chunksAcross <= 0 || chunksDown <= 0 || size <= 0)
+		return;
+	GeoRunWork(&work, threadCount);
+}
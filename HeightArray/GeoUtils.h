@@ -49,12 +49,72 @@
 #define __GEO_UTILS__
 
 #include <stdlib.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Classic diamond-square height map of wide x deep vertices (both powers of two), returned as
+// interleaved position/normal triples (6 floats per vertex). The caller frees the result.
 float *GenHeightMap(int wide, int deep, int seed);
+
+// ---------------------------------------------------------------------
+// Chunked multi-octave terrain
+//
+// Heights are a pure function of the integer world sample position: every octave is value
+// noise over a lattice whose values come from a counter-based RNG keyed by (seed, octave)
+// and indexed by the lattice coordinates. Any chunk can therefore be generated on its own,
+// on any thread, in any order, and neighbouring chunks agree bit for bit on shared edges.
+// ---------------------------------------------------------------------
+
+// Stateless 32 bit random number for (key, counter).
+uint32_t GeoRandom(uint32_t key, uint64_t counter);
+
+typedef struct
+{
+	uint32_t seed;
+	int log2CellSize;	// octave 0 lattice spacing is 1 << log2CellSize world samples
+	int octaves;		// octave o has spacing 1 << (log2CellSize - o); clamped to log2CellSize
+	float amplitude;	// height range of octave 0 is [-amplitude, amplitude]
+	float persistence;	// amplitude ratio between successive octaves
+} GeoTerrainParams;
+
+void GeoTerrainDefaultParams(GeoTerrainParams *params, uint32_t seed);
+
+// Number of octaves used at a level of detail. A patch at lod samples every (1 << lod) world
+// samples and drops the octaves that step cannot represent, which band-limits (downsamples)
+// the terrain and makes coarse levels proportionally cheaper.
+int GeoTerrainOctavesForLod(const GeoTerrainParams *params, int lod);
+
+// Heights of the w x h samples at world positions (x0 + i * step, y0 + j * step), where
+// step = 1 << lod, written row by row rowStride floats apart. Rows are split into bands that
+// are generated on threadCount threads (0 uses every online CPU, 1 stays on the caller).
+void GeoGenTerrainRegion(const GeoTerrainParams *params, int64_t x0, int64_t y0, int w, int h, int lod, float *heights, size_t rowStride, int threadCount);
+
+// Edge order used by neighborLods.
+enum { kGeoEdgeLeft, kGeoEdgeRight, kGeoEdgeBottom, kGeoEdgeTop, kGeoEdgeCount };
+
+// Heights of the (size + 1) x (size + 1) patch whose corner is world sample (x0, y0), sampled
+// at 1 << lod. neighborLods, if not NULL, gives the level of detail of the patch across each
+// edge; where the neighbour is coarser the edge is stitched to it (its vertices take the
+// neighbour's values and the ones in between are interpolated along the edge), so that
+// adjacent levels meet without cracks.
+void GeoGenTerrainPatch(const GeoTerrainParams *params, int64_t x0, int64_t y0, int size, int lod, const int neighborLods[kGeoEdgeCount], float *heights);
+
+// The patch above as interleaved position/normal triples, in the layout GenHeightMap returns
+// (positions are in world samples). Normals come from central differences over a one sample
+// apron, so they are continuous across patch boundaries. The caller frees the result.
+float *GenTerrainPatchMap(const GeoTerrainParams *params, int64_t x0, int64_t y0, int size, int lod, const int neighborLods[kGeoEdgeCount]);
+
+// Receives one generated chunk. heights holds (size + 1) x (size + 1) samples and is only
+// valid during the call. Called concurrently from several threads.
+typedef void (*GeoTerrainChunkCallback)(void *context, int64_t chunkX, int64_t chunkY, int lod, const float *heights, int size);
+
+// Streams chunksAcross x chunksDown chunks starting at chunk (chunkX0, chunkY0). Chunk (cx, cy)
+// covers world samples [cx, cx + 1] * (size << lod) in each direction. Only one chunk per
+// thread is resident at a time, so arbitrarily large worlds can be generated in bounded memory.
+void GeoStreamTerrain(const GeoTerrainParams *params, int64_t chunkX0, int64_t chunkY0, int64_t chunksAcross, int64_t chunksDown, int size, int lod, int threadCount, GeoTerrainChunkCallback callback, void *context);
 	
 #ifdef __cplusplus
 }
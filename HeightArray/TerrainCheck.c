@@ -0,0 +1,243 @@
+/*
+     File: TerrainCheck.c
+ Abstract: Checks that chunked terrain agrees across chunk edges and LOD seams.
+  Version: 1.3
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+ Inc. ("Apple") in consideration of your agreement to the following
+ terms, and your use, installation, modification or redistribution of
+ this Apple software constitutes acceptance of these terms.  If you do
+ not agree with these terms, please do not use, install, modify or
+ redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software.
+ Neither the name, trademarks, service marks or logos of Apple Inc. may
+ be used to endorse or promote products derived from the Apple Software
+ without specific prior written permission from Apple.  Except as
+ expressly stated in this notice, no other rights or licenses, express or
+ implied, are granted by Apple herein, including but not limited to any
+ patent rights that may be infringed by your derivative works or by other
+ works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2014 Apple Inc. All Rights Reserved.
+ 
+ */
+
+// Build and run on any POSIX system:
+//
+//	cc -O2 -std=gnu99 -pthread GeoUtils.c TerrainCheck.c -lm -o TerrainCheck
+//	./TerrainCheck
+//
+// Add -fsanitize=undefined to also check that negative world coordinates are handled
+// without undefined behaviour.
+//
+// Every check straddles the world origin, so chunks and patches with negative origins are
+// compared with their positive neighbours. Shared chunk edges, regions against patches,
+// thread counts and streamed chunks must agree bit for bit; a patch stitched to a coarser
+// neighbour must take the neighbour's vertex values exactly along the shared edge and
+// interpolate them linearly in between.
+
+#include "GeoUtils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define kPatchSize	32
+#define kChunkMin	-3	// chunks kChunkMin .. kChunkMax - 1 in each direction
+#define kChunkMax	2
+#define kChunks		(kChunkMax - kChunkMin)
+
+static int failures = 0;
+
+static void Check(int ok, const char *what, int lod, int64_t x, int64_t y)
+{
+	if (!ok && failures++ < 20)
+		printf("FAILED: %s at lod %d, (%lld, %lld)\n", what, lod, (long long)x, (long long)y);
+}
+
+static float *Patch(const GeoTerrainParams *params, int64_t x0, int64_t y0, int size, int lod, const int neighborLods[kGeoEdgeCount])
+{
+	float *heights = malloc(sizeof(float) * (size + 1) * (size + 1));
+	GeoGenTerrainPatch(params, x0, y0, size, lod, neighborLods, heights);
+	return heights;
+}
+
+// Adjacent patches agree on shared edges, and a region covering them all (on one thread and
+// on several) reproduces every patch.
+static void CheckChunkEdges(const GeoTerrainParams *params, int lod)
+{
+	const int n = kPatchSize + 1, regionSize = kChunks * kPatchSize + 1;
+	const int64_t span = (int64_t)kPatchSize << lod, origin = kChunkMin * span;
+	float *region = malloc(sizeof(float) * regionSize * regionSize);
+	float *threaded = malloc(sizeof(float) * regionSize * regionSize);
+	float *patches[kChunks][kChunks];
+	int cx, cy, i, j;
+	
+	GeoGenTerrainRegion(params, origin, origin, regionSize, regionSize, lod, region, regionSize, 1);
+	GeoGenTerrainRegion(params, origin, origin, regionSize, regionSize, lod, threaded, regionSize, 4);
+	Check(!memcmp(region, threaded, sizeof(float) * regionSize * regionSize), "region depends on thread count", lod, origin, origin);
+	
+	for (cy = 0; cy < kChunks; cy++)
+		for (cx = 0; cx < kChunks; cx++)
+		{
+			const int64_t x0 = origin + cx * span, y0 = origin + cy * span;
+			int same = 1;
+			patches[cy][cx] = Patch(params, x0, y0, kPatchSize, lod, NULL);
+			for (j = 0; j < n; j++)
+				same &= !memcmp(patches[cy][cx] + j * n, region + (cy * kPatchSize + j) * regionSize + cx * kPatchSize, sizeof(float) * n);
+			Check(same, "patch differs from region", lod, x0, y0);
+		}
+	
+	for (cy = 0; cy < kChunks; cy++)
+		for (cx = 0; cx < kChunks; cx++)
+		{
+			const int64_t x0 = origin + cx * span, y0 = origin + cy * span;
+			int right = 1, top = 1;
+			for (i = 0; i < n; i++)
+			{
+				if (cx + 1 < kChunks)
+					right &= (patches[cy][cx][i * n + kPatchSize] == patches[cy][cx + 1][i * n]);
+				if (cy + 1 < kChunks)
+					top &= (patches[cy][cx][kPatchSize * n + i] == patches[cy + 1][cx][i]);
+			}
+			Check(right, "right edge differs from neighbour", lod, x0, y0);
+			Check(top, "top edge differs from neighbour", lod, x0, y0);
+		}
+	
+	for (cy = 0; cy < kChunks; cy++)
+		for (cx = 0; cx < kChunks; cx++)
+			free(patches[cy][cx]);
+	free(region);
+	free(threaded);
+}
+
+// A patch at lod whose neighbour across edge is at lod + d. The neighbour covers the same
+// span with kPatchSize >> d samples; its edge vertices must be copied exactly and the fine
+// vertices between them must lie on the straight line joining them.
+static void CheckStitchedEdge(const GeoTerrainParams *params, int64_t x0, int64_t y0, int lod, int d, int edge)
+{
+	const int n = kPatchSize + 1, coarseSize = kPatchSize >> d, cn = coarseSize + 1, ratio = 1 << d;
+	const int64_t span = (int64_t)kPatchSize << lod;
+	const int64_t nx = (edge == kGeoEdgeLeft) ? x0 - span : (edge == kGeoEdgeRight) ? x0 + span : x0;
+	const int64_t ny = (edge == kGeoEdgeBottom) ? y0 - span : (edge == kGeoEdgeTop) ? y0 + span : y0;
+	int neighborLods[kGeoEdgeCount] = { lod, lod, lod, lod };
+	float *fine, *coarse;
+	int exact = 1, linear = 1, i;
+	
+	neighborLods[edge] = lod + d;
+	fine = Patch(params, x0, y0, kPatchSize, lod, neighborLods);
+	coarse = Patch(params, nx, ny, coarseSize, lod + d, NULL);
+	
+	for (i = 0; i < n; i++)
+	{
+		float f, a, b, expected;
+		int k = i / ratio, r = i % ratio;
+		
+		// the shared edge in the fine patch, and the coarse vertices on either side of it
+		switch (edge)
+		{
+			case kGeoEdgeLeft:	f = fine[i * n];			a = coarse[k * cn + coarseSize];		b = (r ? coarse[(k + 1) * cn + coarseSize] : a);	break;
+			case kGeoEdgeRight:	f = fine[i * n + kPatchSize];		a = coarse[k * cn];				b = (r ? coarse[(k + 1) * cn] : a);			break;
+			case kGeoEdgeBottom:	f = fine[i];				a = coarse[coarseSize * cn + k];		b = (r ? coarse[coarseSize * cn + k + 1] : a);		break;
+			default:		f = fine[kPatchSize * n + i];		a = coarse[k];					b = (r ? coarse[k + 1] : a);				break;
+		}
+		if (!r)
+			exact &= (f == a);
+		else
+		{
+			expected = a + (b - a) * ((float)r / (float)ratio);
+			linear &= (fabsf(f - expected) <= 1e-5f * params->amplitude);
+		}
+	}
+	Check(exact, "stitched edge vertex differs from coarse neighbour", lod, x0, y0);
+	Check(linear, "stitched edge is not linear between coarse vertices", lod, x0, y0);
+	free(fine);
+	free(coarse);
+}
+
+static void CheckStitching(const GeoTerrainParams *params, int lod)
+{
+	const int64_t span = (int64_t)kPatchSize << lod;
+	int cx, cy, d, edge;
+	
+	for (cy = kChunkMin; cy < kChunkMax; cy++)
+		for (cx = kChunkMin; cx < kChunkMax; cx++)
+			for (d = 1; d <= 2; d++)
+				for (edge = 0; edge < kGeoEdgeCount; edge++)
+					CheckStitchedEdge(params, cx * span, cy * span, lod, d, edge);
+}
+
+typedef struct
+{
+	const GeoTerrainParams *params;
+	volatile int mismatches;
+} StreamCheck;
+
+static void StreamChunk(void *context, int64_t chunkX, int64_t chunkY, int lod, const float *heights, int size)
+{
+	StreamCheck *check = context;
+	const int64_t span = (int64_t)size << lod;
+	float *expected = Patch(check->params, chunkX * span, chunkY * span, size, lod, NULL);
+	if (memcmp(expected, heights, sizeof(float) * (size + 1) * (size + 1)))
+		__sync_fetch_and_add(&check->mismatches, 1);
+	free(expected);
+}
+
+// Streamed chunks, generated concurrently, match patches generated one by one.
+static void CheckStream(const GeoTerrainParams *params, int lod)
+{
+	StreamCheck check = { params, 0 };
+	GeoStreamTerrain(params, kChunkMin, kChunkMin, kChunks, kChunks, kPatchSize, lod, 4, StreamChunk, &check);
+	Check(check.mismatches == 0, "streamed chunk differs from patch", lod, kChunkMin, kChunkMin);
+}
+
+int main(void)
+{
+	GeoTerrainParams params;
+	int lod;
+	
+	GeoTerrainDefaultParams(&params, 1234);
+	
+	// log2CellSize 9 puts the chunks inside one octave 0 cell; a smaller cell crosses many
+	// cells, and lattice lines, on both sides of the origin.
+	params.log2CellSize = 6;
+	params.octaves = 7;
+	
+	for (lod = 0; lod <= 2; lod++)
+	{
+		CheckChunkEdges(&params, lod);
+		CheckStitching(&params, lod);
+		CheckStream(&params, lod);
+	}
+	
+	if (failures)
+	{
+		printf("%d checks FAILED\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("All terrain checks passed (chunks %d .. %d, lod 0 .. 2)\n", kChunkMin, kChunkMax - 1);
+	return EXIT_SUCCESS;
+}
@@ -90,8 +90,8 @@ static bool MyCancelCallback(void *context)
 	// Create a generic rgb color space
 	CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceGenericRGB);
 
-	// Setup our data provider
-	CGDataProviderRef provider = CreateDataProvider(w, h, self, MyProgressCallback, MyCancelCallback);
+	// Setup our data provider - tiles are generated on worker threads ahead of Image IO's reads
+	CGDataProviderRef provider = CreateTiledDataProvider(w, h, 0, self, MyProgressCallback, MyCancelCallback);
 
 	// Create the image with our data provider and color space - it will retain both so we will release them both after
 	CGImageRef image = CGImageCreate(
@@ -46,9 +46,12 @@ Copyright (C) 2010 Apple Inc. All Rights Reserved.
 */
 
 #include "DataProvider.h"
+#include "TileCache.h"
 
 size_t MyGetBytesAtOffset(void *info, void *buffer, off_t offset, size_t count);
+size_t MyTiledGetBytesAtOffset(void *info, void *buffer, off_t offset, size_t count);
 void MyReleaseInfo(void * info);
+void MyTiledReleaseInfo(void * info);
 
 static CGDataProviderDirectCallbacks callbacks = 
 {
@@ -59,6 +62,21 @@ static CGDataProviderDirectCallbacks callbacks =
 	&MyReleaseInfo // CGDataProviderReleaseInfoCallback
 };
 
+static CGDataProviderDirectCallbacks tiledCallbacks = 
+{
+	0, // version
+	NULL, // CGDataProviderGetBytePointerCallback
+	NULL, // CGDataProviderReleaseBytePointerCallback
+	&MyTiledGetBytesAtOffset, // CGDataProviderGetBytesAtOffsetCallback
+	&MyTiledReleaseInfo // CGDataProviderReleaseInfoCallback
+};
+
+// Tile geometry for the tiled provider. Quartz reads whole rows in order, so short, wide
+// tiles keep a row of tiles (and the read-ahead window) small even for 65500 pixel wide images.
+#define kTileWidth 256
+#define kTileHeight 64
+#define kReadAheadTileRows 4
+
 typedef struct
 {
 	// necessary for filling out the image data
@@ -68,6 +86,8 @@ typedef struct
 	void *uiContext;
 	DataProviderProgressCallback uiProgressCallback;
 	DataProviderCancelCallback uiCancelCallback;
+	// Only used by the tiled data provider.
+	TileCacheRef tiles;
 } DataProviderInfo;
 
 // Simple inlines to make sure that we only call the callbacks if they were specified.
@@ -136,12 +156,36 @@ size_t MyGetBytesAtOffset(void * info, void * buffer, off_t offset, size_t count
 	return provided;
 }
 
+// Same contract as MyGetBytesAtOffset, but the pixels are copied out of the tile cache,
+// which has usually generated them on other threads while the previous rows were consumed.
+size_t MyTiledGetBytesAtOffset(void * info, void * buffer, off_t offset, size_t count)
+{
+	DataProviderInfo * data = (DataProviderInfo *)info;
+	
+	// Deference to UI - check for cancel
+	if(SafeCancelCallback(data))
+		return 0;
+	
+	size_t provided = TileCacheCopyBytes(data->tiles, buffer, offset, count);
+	
+	// Deference to UI - we're just signallying the controller
+	SafeProgressCallback(data, 100.0f * (float)(offset + provided) / (float)data->totalBytes);
+	return provided;
+}
+
 void MyReleaseInfo(void * info)
 {
 	// info block was malloc()'d, so free() it.
 	free(info);
 }
 
+void MyTiledReleaseInfo(void * info)
+{
+	DataProviderInfo * data = (DataProviderInfo *)info;
+	TileCacheRelease(data->tiles);
+	free(data);
+}
+
 CGDataProviderRef CreateDataProvider(size_t width, size_t height, void * context, DataProviderProgressCallback progressCallback, DataProviderCancelCallback cancelCallback)
 {
 	DataProviderInfo *info = (DataProviderInfo*)malloc(sizeof(DataProviderInfo));
@@ -151,5 +195,37 @@ CGDataProviderRef CreateDataProvider(size_t width, size_t height, void * context
 	info->uiContext = context;
 	info->uiProgressCallback = progressCallback;
 	info->uiCancelCallback = cancelCallback;
+	info->tiles = NULL;
 	return CGDataProviderCreateDirect(info, info->totalBytes, &callbacks);
+}
+
+CGDataProviderRef CreateTiledDataProvider(size_t width, size_t height, size_t memoryBudget, void * context, DataProviderProgressCallback progressCallback, DataProviderCancelCallback cancelCallback)
+{
+	TileCacheConfig config = { 0 };
+	config.width = width;
+	config.height = height;
+	config.bytesPerPixel = kBytesPerPixel;
+	config.tileWidth = kTileWidth;
+	config.tileHeight = kTileHeight;
+	config.memoryBudget = memoryBudget;
+	config.readAheadRows = kReadAheadTileRows;
+	
+	TileSource source = TileSourceCreatePattern(width, height);
+	TileCacheRef tiles = TileCacheCreate(&config, source);
+	if(tiles == NULL)
+	{
+		if(source.release != NULL)
+			source.release(source.info);
+		return NULL;
+	}
+	
+	DataProviderInfo *info = (DataProviderInfo*)malloc(sizeof(DataProviderInfo));
+	info->width = width;
+	info->height = height;
+	info->totalBytes = (off_t)width * (off_t)height * kBytesPerPixel;
+	info->uiContext = context;
+	info->uiProgressCallback = progressCallback;
+	info->uiCancelCallback = cancelCallback;
+	info->tiles = tiles;
+	return CGDataProviderCreateDirect(info, info->totalBytes, &tiledCallbacks);
 }
\ No newline at end of file
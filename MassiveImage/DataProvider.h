@@ -62,3 +62,8 @@ typedef bool (*DataProviderCancelCallback)(void *context);
 
 // Create a custom data provider with optional progress & cancel callbacks.
 CGDataProviderRef CreateDataProvider(size_t width, size_t height, void * context, DataProviderProgressCallback progressCallback, DataProviderCancelCallback cancelCallback);
+
+// Create a data provider for the same image that is backed by a TileCache (see TileCache.h):
+// worker threads generate tiles ahead of Quartz's sequential reads and the resident tiles are
+// kept within memoryBudget bytes (0 selects the cache's default budget).
+CGDataProviderRef CreateTiledDataProvider(size_t width, size_t height, size_t memoryBudget, void * context, DataProviderProgressCallback progressCallback, DataProviderCancelCallback cancelCallback);
@@ -0,0 +1,284 @@
+/*
+    File: TileBenchmark.c
+Abstract: Command line benchmark for the tile cache: streams an image and reports throughput and peak memory
+ Version: 1.1
+
+Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+Inc. ("Apple") in consideration of your agreement to the following
+terms, and your use, installation, modification or redistribution of
+this Apple software constitutes acceptance of these terms.  If you do
+not agree with these terms, please do not use, install, modify or
+redistribute this Apple software.
+
+In consideration of your agreement to abide by the following terms, and
+subject to these terms, Apple grants you a personal, non-exclusive
+license, under Apple's copyrights in this original Apple software (the
+"Apple Software"), to use, reproduce, modify and redistribute the Apple
+Software, with or without modifications, in source and/or binary forms;
+provided that if you redistribute the Apple Software in its entirety and
+without modifications, you must retain this notice and the following
+text and disclaimers in all such redistributions of the Apple Software.
+Neither the name, trademarks, service marks or logos of Apple Inc. may
+be used to endorse or promote products derived from the Apple Software
+without specific prior written permission from Apple.  Except as
+expressly stated in this notice, no other rights or licenses, express or
+implied, are granted by Apple herein, including but not limited to any
+patent rights that may be infringed by your derivative works or by other
+works in which the Apple Software may be incorporated.
+
+The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+
+IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+Copyright (C) 2010 Apple Inc. All Rights Reserved.
+
+*/
+
+
+// Build and run on any POSIX system:
+//
+//	cc -O3 -std=gnu99 -pthread TileCache.c TileBenchmark.c -o TileBenchmark
+//	./TileBenchmark [-w width] [-h height] [-t tileWidth tileHeight] [-m budgetMB]
+//	                [-j workers] [-r readAheadRows] [-c chunkKB] [-f rawFile] [-n randomTiles]
+//
+// The defaults stream a 100000 x 100000 XRGB image (40 GB) generated by the pattern source
+// through TileCacheCopyBytes in the same sequential fashion Image IO reads a data provider,
+// then time random-access tile requests. With -f the tiles are read from a headerless
+// raw file of width x height pixels instead.
+
+#include "TileCache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+static double Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static double PeakRSSMegabytes(void)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+	return (double)usage.ru_maxrss / (1024.0 * 1024.0);	// bytes
+#else
+	return (double)usage.ru_maxrss / 1024.0;		// kilobytes
+#endif
+}
+
+// Wraps a source to count how often each tile is filled, so that the sequential stream can
+// check that read-ahead never throws away a tile before it is read and fills it again.
+typedef struct
+{
+	TileSource inner;
+	size_t tileWidth, tileHeight, tilesAcross;
+	uint32_t *fills;
+} CountingInfo;
+
+static bool CountingFill(void *sourceInfo, size_t x, size_t y, size_t width, size_t height, uint8_t *pixels, size_t rowBytes)
+{
+	CountingInfo *info = (CountingInfo*)sourceInfo;
+	__sync_fetch_and_add(&info->fills[(y / info->tileHeight) * info->tilesAcross + x / info->tileWidth], 1);
+	return info->inner.fill(info->inner.info, x, y, width, height, pixels, rowBytes);
+}
+
+static void CountingRelease(void *sourceInfo)
+{
+	CountingInfo *info = (CountingInfo*)sourceInfo;
+	if(info->inner.release != NULL)
+		info->inner.release(info->inner.info);
+}
+
+// Checks a few pixels of a chunk against the pattern source's definition.
+static bool VerifyPatternChunk(const uint8_t *chunk, off_t offset, size_t count, size_t width, size_t height)
+{
+	const off_t rowBytes = (off_t)width * 4;
+	for(size_t i = 0; i + 4 <= count; i += count / 7 + 4)
+	{
+		off_t byte = (offset + (off_t)i) & ~(off_t)3;
+		if(byte < offset)
+			continue;
+		uint64_t y = (uint64_t)(byte / rowBytes), x = (uint64_t)((byte % rowBytes) / 4);
+		const uint8_t *p = chunk + (byte - offset);
+		uint8_t blue = (uint8_t)(((y + 1) * 255 + height / 2) / height);
+		if((p[0] != 0) || (p[1] != (uint8_t)(y & 255)) || (p[2] != (uint8_t)(x & 255)) || (p[3] != blue))
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	TileCacheConfig config = { 0 };
+	config.width = 100000;
+	config.height = 100000;
+	config.bytesPerPixel = 4;
+	config.tileWidth = 512;
+	config.tileHeight = 64;
+	config.memoryBudget = (size_t)256 << 20;
+	config.readAheadRows = 4;
+	size_t chunkBytes = (size_t)1 << 20, randomTiles = 20000;
+	const char *rawFile = NULL;
+	
+	for(int i = 1; i < argc; ++i)
+	{
+		const char *arg = argv[i];
+		bool hasValue = (i + 1 < argc);
+		if(!strcmp(arg, "-w") && hasValue)
+			config.width = strtoull(argv[++i], NULL, 0);
+		else if(!strcmp(arg, "-h") && hasValue)
+			config.height = strtoull(argv[++i], NULL, 0);
+		else if(!strcmp(arg, "-t") && (i + 2 < argc))
+		{
+			config.tileWidth = strtoull(argv[++i], NULL, 0);
+			config.tileHeight = strtoull(argv[++i], NULL, 0);
+		}
+		else if(!strcmp(arg, "-m") && hasValue)
+			config.memoryBudget = (size_t)strtoull(argv[++i], NULL, 0) << 20;
+		else if(!strcmp(arg, "-j") && hasValue)
+			config.workerCount = strtoull(argv[++i], NULL, 0);
+		else if(!strcmp(arg, "-r") && hasValue)
+			config.readAheadRows = strtoull(argv[++i], NULL, 0);
+		else if(!strcmp(arg, "-c") && hasValue)
+			chunkBytes = (size_t)strtoull(argv[++i], NULL, 0) << 10;
+		else if(!strcmp(arg, "-f") && hasValue)
+			rawFile = argv[++i];
+		else if(!strcmp(arg, "-n") && hasValue)
+			randomTiles = strtoull(argv[++i], NULL, 0);
+		else
+		{
+			fprintf(stderr, "Unknown or incomplete option %s\n", arg);
+			return EXIT_FAILURE;
+		}
+	}
+	
+	TileSource source = rawFile ? TileSourceCreateRawFile(rawFile, config.width, config.height, config.bytesPerPixel) : TileSourceCreatePattern(config.width, config.height);
+	if(source.fill == NULL)
+	{
+		fprintf(stderr, "Could not open %s\n", rawFile ? rawFile : "pattern source");
+		return EXIT_FAILURE;
+	}
+	
+	// The counting wrapper needs the tile geometry before the cache exists, so the defaults
+	// TileCacheCreate would pick are not available here; the benchmark always sets a tile size.
+	CountingInfo counting = { source, config.tileWidth, config.tileHeight, 0, NULL };
+	if((config.tileWidth != 0) && (config.tileHeight != 0))
+	{
+		counting.tilesAcross = (config.width + config.tileWidth - 1) / config.tileWidth;
+		counting.fills = (uint32_t*)calloc(counting.tilesAcross * ((config.height + config.tileHeight - 1) / config.tileHeight), sizeof(uint32_t));
+	}
+	if(counting.fills != NULL)
+	{
+		source.fill = CountingFill;
+		source.release = CountingRelease;
+		source.info = &counting;
+	}
+	
+	TileCacheRef cache = TileCacheCreate(&config, source);
+	uint8_t *chunk = (uint8_t*)malloc(chunkBytes);
+	if((cache == NULL) || (chunk == NULL))
+	{
+		fprintf(stderr, "Could not create the tile cache\n");
+		return EXIT_FAILURE;
+	}
+	
+	size_t tileWidth, tileHeight, tilesAcross, tilesDown;
+	TileCacheGetGeometry(cache, &tileWidth, &tileHeight, &tilesAcross, &tilesDown);
+	const off_t totalBytes = (off_t)config.width * (off_t)config.height * (off_t)config.bytesPerPixel;
+	printf("Image %zu x %zu (%.2f GB), tiles %zu x %zu (%zu x %zu), budget %zu MB, chunk %zu KB\n",
+		config.width, config.height, (double)totalBytes / 1e9, tileWidth, tileHeight, tilesAcross, tilesDown,
+		config.memoryBudget >> 20, chunkBytes >> 10);
+	
+	// Sequential stream.
+	bool verified = true;
+	double start = Now();
+	for(off_t offset = 0; offset < totalBytes; )
+	{
+		size_t provided = TileCacheCopyBytes(cache, chunk, offset, chunkBytes);
+		if(provided == 0)
+		{
+			fprintf(stderr, "Short read at offset %lld\n", (long long)offset);
+			return EXIT_FAILURE;
+		}
+		if((rawFile == NULL) && verified)
+			verified = VerifyPatternChunk(chunk, offset, provided, config.width, config.height);
+		offset += (off_t)provided;
+	}
+	double elapsed = Now() - start;
+	
+	// A single pass reads every tile once, so every tile must have been filled exactly once, as
+	// long as the budget holds the row of tiles being read (otherwise the reader's own tiles
+	// have to be dropped between chunks).
+	size_t refilled = 0;
+	if((counting.fills != NULL) && (config.memoryBudget / (tileWidth * tileHeight * config.bytesPerPixel) >= tilesAcross))
+		for(size_t i = 0; i < tilesAcross * tilesDown; ++i)
+			refilled += (counting.fills[i] != 1);
+	
+	TileCacheStatistics statistics;
+	TileCacheGetStatistics(cache, &statistics);
+	printf("Sequential: %.2f s, %.1f MB/s, %llu hits, %llu misses, %llu prefetched, %llu evictions, peak tiles %.1f MB%s\n",
+		elapsed, (double)totalBytes / 1e6 / elapsed,
+		(unsigned long long)statistics.hits, (unsigned long long)statistics.misses,
+		(unsigned long long)statistics.prefetched, (unsigned long long)statistics.evictions,
+		(double)statistics.peakResidentBytes / (1024.0 * 1024.0),
+		(rawFile == NULL) ? (verified ? ", pixels verified" : ", PIXEL MISMATCH") : "");
+	if(refilled != 0)
+	{
+		printf("Sequential: %zu tiles were not filled exactly once (read-ahead refilled evicted tiles)\n", refilled);
+		verified = false;
+	}
+	
+	// Random access through the tile interface.
+	// Only the first byte is read: edge tiles and small -t sizes may have a single pixel.
+	uint64_t state = 0x2545F4914F6CDD1DULL, checksum = 0;
+	size_t failed = 0;
+	start = Now();
+	for(size_t i = 0; i < randomTiles; ++i)
+	{
+		state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+		size_t tx = (size_t)(state % tilesAcross), ty = (size_t)((state >> 32) % tilesDown);
+		size_t rowBytes;
+		const uint8_t *pixels = TileCacheAcquireTile(cache, tx, ty, &rowBytes);
+		if(pixels == NULL)
+		{
+			++failed;
+			continue;
+		}
+		checksum += pixels[0];
+		TileCacheReleaseTile(cache, tx, ty);
+	}
+	elapsed = Now() - start;
+	if(failed != 0)
+	{
+		printf("Random: %zu tiles could not be acquired\n", failed);
+		verified = false;
+	}
+	printf("Random: %zu tiles in %.2f s, %.0f tiles/s, %.1f MB/s (checksum %llu)\n",
+		randomTiles, elapsed, (double)randomTiles / elapsed,
+		(double)randomTiles * (double)(tileWidth * tileHeight * config.bytesPerPixel) / 1e6 / elapsed,
+		(unsigned long long)checksum);
+	
+	printf("Peak RSS: %.1f MB\n", PeakRSSMegabytes());
+	
+	TileCacheRelease(cache);
+	free(counting.fills);
+	free(chunk);
+	return verified ? EXIT_SUCCESS : EXIT_FAILURE;
+}
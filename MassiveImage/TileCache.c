@@ -0,0 +1,771 @@
+/*
+    File: TileCache.c
+Abstract: Tiled, multi-threaded, LRU-cached pixel source used by the tiled data provider
+ Version: 1.1
+
+Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+Inc. ("Apple") in consideration of your agreement to the following
+terms, and your use, installation, modification or redistribution of
+this Apple software constitutes acceptance of these terms.  If you do
+not agree with these terms, please do not use, install, modify or
+redistribute this Apple software.
+
+In consideration of your agreement to abide by the following terms, and
+subject to these terms, Apple grants you a personal, non-exclusive
+license, under Apple's copyrights in this original Apple software (the
+"Apple Software"), to use, reproduce, modify and redistribute the Apple
+Software, with or without modifications, in source and/or binary forms;
+provided that if you redistribute the Apple Software in its entirety and
+without modifications, you must retain this notice and the following
+text and disclaimers in all such redistributions of the Apple Software.
+Neither the name, trademarks, service marks or logos of Apple Inc. may
+be used to endorse or promote products derived from the Apple Software
+without specific prior written permission from Apple.  Except as
+expressly stated in this notice, no other rights or licenses, express or
+implied, are granted by Apple herein, including but not limited to any
+patent rights that may be infringed by your derivative works or by other
+works in which the Apple Software may be incorporated.
+
+The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+
+IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+Copyright (C) 2010 Apple Inc. All Rights Reserved.
+
+*/
+
+
+#include "TileCache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+#endif
+
+#define kDefaultTileSize 256
+#define kDefaultMemoryBudget ((size_t)256 << 20)
+#define kMinimumBucketCount 64
+
+// A tile moves Queued -> Filling -> Ready, or directly Filling -> Ready when a consumer
+// asks for it before any worker does. Only Ready tiles with no pins live on the LRU list,
+// and only those may be evicted.
+typedef enum
+{
+	kTileQueued,
+	kTileFilling,
+	kTileReady
+} TileState;
+
+typedef struct Tile
+{
+	size_t index;			// tileY * tilesAcross + tileX
+	uint8_t *pixels;
+	TileState state;
+	unsigned pinCount;		// consumers holding the tile, plus one while it sits in the work queue
+	bool used;			// acquired at least once since it was filled
+	struct Tile *hashNext;
+	struct Tile *lruPrev, *lruNext;
+	struct Tile *queueNext;
+} Tile;
+
+struct TileCache
+{
+	TileCacheConfig config;
+	TileSource source;
+	
+	// Geometry is computed once here rather than on every request.
+	size_t tilesAcross, tilesDown;
+	size_t tileRowBytes, tileBytes;
+	size_t imageRowBytes;
+	off_t imageBytes;
+	
+	pthread_mutex_t lock;
+	pthread_cond_t tileFilled;
+	pthread_cond_t workAvailable;
+	
+	Tile **buckets;
+	size_t bucketMask;
+	Tile *lruHead, *lruTail;	// head is the most recently used
+	Tile *queueHead, *queueTail;
+	size_t readAheadFrom;		// first tile row not yet handed to the workers
+	size_t unreadTiles;		// prefetched tiles not acquired yet
+	size_t maxUnreadTiles;		// budget left for read-ahead beside a row of tiles being read
+	
+	pthread_t *workers;
+	size_t workerCount;
+	bool stopping;
+	
+	TileCacheStatistics statistics;
+};
+
+#pragma mark Bookkeeping (called with the lock held)
+
+static inline Tile **BucketForIndex(TileCacheRef cache, size_t index)
+{
+	// Tiles are mostly visited in runs of consecutive indices, so a multiplicative hash is
+	// plenty to spread them over the buckets.
+	uint64_t h = (uint64_t)index * 0x9E3779B97F4A7C15ULL;
+	return &cache->buckets[(size_t)(h >> 32) & cache->bucketMask];
+}
+
+static Tile *FindTile(TileCacheRef cache, size_t index)
+{
+	Tile *tile = *BucketForIndex(cache, index);
+	while((tile != NULL) && (tile->index != index))
+		tile = tile->hashNext;
+	return tile;
+}
+
+static void InsertTile(TileCacheRef cache, Tile *tile)
+{
+	Tile **bucket = BucketForIndex(cache, tile->index);
+	tile->hashNext = *bucket;
+	*bucket = tile;
+}
+
+static void RemoveTile(TileCacheRef cache, Tile *tile)
+{
+	Tile **link = BucketForIndex(cache, tile->index);
+	while(*link != tile)
+		link = &(*link)->hashNext;
+	*link = tile->hashNext;
+}
+
+static void LRUPushFront(TileCacheRef cache, Tile *tile)
+{
+	tile->lruPrev = NULL;
+	tile->lruNext = cache->lruHead;
+	if(cache->lruHead != NULL)
+		cache->lruHead->lruPrev = tile;
+	else
+		cache->lruTail = tile;
+	cache->lruHead = tile;
+}
+
+static void LRURemove(TileCacheRef cache, Tile *tile)
+{
+	if(tile->lruPrev != NULL)
+		tile->lruPrev->lruNext = tile->lruNext;
+	else
+		cache->lruHead = tile->lruNext;
+	if(tile->lruNext != NULL)
+		tile->lruNext->lruPrev = tile->lruPrev;
+	else
+		cache->lruTail = tile->lruPrev;
+	tile->lruPrev = tile->lruNext = NULL;
+}
+
+// Takes a tile a consumer is about to fill off the work queue, with the queue's pin. Leaving
+// it for a worker to skip would keep it pinned, and so unevictable, until a busy machine got
+// round to running one.
+static void DequeueTile(TileCacheRef cache, Tile *tile)
+{
+	Tile **link = &cache->queueHead, *previous = NULL;
+	while(*link != tile)
+	{
+		previous = *link;
+		link = &previous->queueNext;
+	}
+	*link = tile->queueNext;
+	if(cache->queueTail == tile)
+		cache->queueTail = previous;
+	tile->queueNext = NULL;
+	tile->pinCount--;
+}
+
+static void UnpinTile(TileCacheRef cache, Tile *tile)
+{
+	if((--tile->pinCount == 0) && (tile->state == kTileReady))
+		LRUPushFront(cache, tile);
+}
+
+// Returns the least recently used tile that has been read since it was filled, or NULL if
+// every unpinned tile is read-ahead nobody has consumed yet. Consumed tiles drift to the tail
+// as reading moves on while fresh read-ahead sits near the head, so the walk is short.
+static Tile *LeastRecentlyUsedConsumedTile(TileCacheRef cache)
+{
+	Tile *tile = cache->lruTail;
+	while((tile != NULL) && !tile->used)
+		tile = tile->lruPrev;
+	return tile;
+}
+
+// Returns a tile record with pixel storage for index, recycling the least recently used
+// consumed tile when the budget is exhausted. Neither prefetching nor demand requests evict
+// a tile that was prefetched but not consumed yet, since it would only be filled again; a
+// demand request falls back to the oldest such tile only when nothing else is unpinned (the
+// reader moved away from its read-ahead), and otherwise overshoots the budget. Prefetching
+// never goes over budget.
+static Tile *ObtainTile(TileCacheRef cache, size_t index, bool forPrefetch)
+{
+	Tile *tile = NULL;
+	if(cache->statistics.residentBytes + cache->tileBytes > cache->config.memoryBudget)
+	{
+		Tile *victim = LeastRecentlyUsedConsumedTile(cache);
+		if((victim == NULL) && !forPrefetch)
+		{
+			victim = cache->lruTail;
+			if(victim != NULL)
+				cache->unreadTiles--;
+		}
+		if(victim != NULL)
+		{
+			LRURemove(cache, victim);
+			RemoveTile(cache, victim);
+			cache->statistics.evictions++;
+			tile = victim;
+		}
+		else if(forPrefetch)
+		{
+			return NULL;
+		}
+	}
+	if(tile == NULL)
+	{
+		tile = (Tile*)calloc(1, sizeof(Tile));
+		if(tile == NULL)
+			return NULL;
+		tile->pixels = (uint8_t*)malloc(cache->tileBytes);
+		if(tile->pixels == NULL)
+		{
+			free(tile);
+			return NULL;
+		}
+		cache->statistics.residentBytes += cache->tileBytes;
+		if(cache->statistics.residentBytes > cache->statistics.peakResidentBytes)
+			cache->statistics.peakResidentBytes = cache->statistics.residentBytes;
+	}
+	tile->index = index;
+	tile->pinCount = 0;
+	tile->used = false;
+	tile->hashNext = tile->lruPrev = tile->lruNext = tile->queueNext = NULL;
+	InsertTile(cache, tile);
+	return tile;
+}
+
+#pragma mark Filling (called without the lock)
+
+static void FillTile(TileCacheRef cache, Tile *tile)
+{
+	size_t tileX = tile->index % cache->tilesAcross, tileY = tile->index / cache->tilesAcross;
+	size_t x = tileX * cache->config.tileWidth, y = tileY * cache->config.tileHeight;
+	size_t w = cache->config.width - x, h = cache->config.height - y;
+	if(w > cache->config.tileWidth)
+		w = cache->config.tileWidth;
+	if(h > cache->config.tileHeight)
+		h = cache->config.tileHeight;
+	
+	if(!cache->source.fill(cache->source.info, x, y, w, h, tile->pixels, cache->tileRowBytes))
+		memset(tile->pixels, 0, cache->tileBytes);
+}
+
+// Fills a tile this thread has just claimed (state set to kTileFilling with the lock held),
+// then publishes it. Entered and left with the lock held.
+static void FillClaimedTile(TileCacheRef cache, Tile *tile)
+{
+	pthread_mutex_unlock(&cache->lock);
+	FillTile(cache, tile);
+	pthread_mutex_lock(&cache->lock);
+	tile->state = kTileReady;
+	pthread_cond_broadcast(&cache->tileFilled);
+}
+
+static void *WorkerMain(void *arg)
+{
+	TileCacheRef cache = (TileCacheRef)arg;
+	pthread_mutex_lock(&cache->lock);
+	while(!cache->stopping)
+	{
+		Tile *tile = cache->queueHead;
+		if(tile == NULL)
+		{
+			pthread_cond_wait(&cache->workAvailable, &cache->lock);
+			continue;
+		}
+		cache->queueHead = tile->queueNext;
+		if(cache->queueHead == NULL)
+			cache->queueTail = NULL;
+		tile->queueNext = NULL;
+		
+		// Consumers take the tiles they claim off the queue, so every queued tile needs filling.
+		tile->state = kTileFilling;
+		FillClaimedTile(cache, tile);
+		cache->statistics.prefetched++;
+		UnpinTile(cache, tile);
+	}
+	pthread_mutex_unlock(&cache->lock);
+	return NULL;
+}
+
+#pragma mark Creation
+
+static size_t OnlineProcessorCount(void)
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return (count > 0) ? (size_t)count : 1;
+}
+
+TileCacheRef TileCacheCreate(const TileCacheConfig *config, TileSource source)
+{
+	if((config == NULL) || (source.fill == NULL) || (config->width == 0) || (config->height == 0) || (config->bytesPerPixel == 0))
+		return NULL;
+	
+	TileCacheRef cache = (TileCacheRef)calloc(1, sizeof(struct TileCache));
+	if(cache == NULL)
+		return NULL;
+	
+	cache->config = *config;
+	if(cache->config.tileWidth == 0)
+		cache->config.tileWidth = kDefaultTileSize;
+	if(cache->config.tileHeight == 0)
+		cache->config.tileHeight = kDefaultTileSize;
+	if(cache->config.memoryBudget == 0)
+		cache->config.memoryBudget = kDefaultMemoryBudget;
+	if(cache->config.workerCount == 0)
+		cache->config.workerCount = OnlineProcessorCount();
+	cache->source = source;
+	
+	cache->tilesAcross = (config->width + cache->config.tileWidth - 1) / cache->config.tileWidth;
+	cache->tilesDown = (config->height + cache->config.tileHeight - 1) / cache->config.tileHeight;
+	cache->tileRowBytes = cache->config.tileWidth * config->bytesPerPixel;
+	cache->tileBytes = cache->tileRowBytes * cache->config.tileHeight;
+	cache->imageRowBytes = config->width * config->bytesPerPixel;
+	cache->imageBytes = (off_t)cache->imageRowBytes * (off_t)config->height;
+	
+	// Size the hash table for the number of tiles the budget can hold, at a load factor of 1/2.
+	size_t bucketCount = kMinimumBucketCount, residentTiles = cache->config.memoryBudget / cache->tileBytes + 1;
+	
+	// Read-ahead may use what the budget holds beyond one row of tiles, the most a sequential
+	// reader has in flight; more would push out tiles that are still being read.
+	size_t budgetTiles = cache->config.memoryBudget / cache->tileBytes;
+	cache->maxUnreadTiles = (budgetTiles > cache->tilesAcross) ? budgetTiles - cache->tilesAcross : 0;
+	while(bucketCount < residentTiles * 2)
+		bucketCount <<= 1;
+	cache->buckets = (Tile**)calloc(bucketCount, sizeof(Tile*));
+	cache->bucketMask = bucketCount - 1;
+	cache->workers = (pthread_t*)calloc(cache->config.workerCount, sizeof(pthread_t));
+	if((cache->buckets == NULL) || (cache->workers == NULL))
+	{
+		free(cache->buckets);
+		free(cache->workers);
+		free(cache);
+		return NULL;
+	}
+	
+	pthread_mutex_init(&cache->lock, NULL);
+	pthread_cond_init(&cache->tileFilled, NULL);
+	pthread_cond_init(&cache->workAvailable, NULL);
+	
+	for(size_t i = 0; i < cache->config.workerCount; ++i)
+	{
+		if(pthread_create(&cache->workers[i], NULL, WorkerMain, cache) != 0)
+			break;
+		cache->workerCount++;
+	}
+	return cache;
+}
+
+void TileCacheRelease(TileCacheRef cache)
+{
+	if(cache == NULL)
+		return;
+	
+	pthread_mutex_lock(&cache->lock);
+	cache->stopping = true;
+	pthread_cond_broadcast(&cache->workAvailable);
+	pthread_mutex_unlock(&cache->lock);
+	for(size_t i = 0; i < cache->workerCount; ++i)
+		pthread_join(cache->workers[i], NULL);
+	
+	for(size_t i = 0; i <= cache->bucketMask; ++i)
+	{
+		Tile *tile = cache->buckets[i];
+		while(tile != NULL)
+		{
+			Tile *next = tile->hashNext;
+			free(tile->pixels);
+			free(tile);
+			tile = next;
+		}
+	}
+	
+	if(cache->source.release != NULL)
+		cache->source.release(cache->source.info);
+	pthread_cond_destroy(&cache->workAvailable);
+	pthread_cond_destroy(&cache->tileFilled);
+	pthread_mutex_destroy(&cache->lock);
+	free(cache->workers);
+	free(cache->buckets);
+	free(cache);
+}
+
+#pragma mark Access
+
+static Tile *AcquireTileAtIndex(TileCacheRef cache, size_t index)
+{
+	pthread_mutex_lock(&cache->lock);
+	Tile *tile = FindTile(cache, index);
+	if(tile == NULL)
+	{
+		cache->statistics.misses++;
+		tile = ObtainTile(cache, index, false);
+		if(tile != NULL)
+		{
+			tile->used = true;
+			tile->pinCount = 1;
+			tile->state = kTileFilling;
+			FillClaimedTile(cache, tile);
+		}
+	}
+	else if(tile->state == kTileReady)
+	{
+		cache->statistics.hits++;
+		if(tile->pinCount++ == 0)
+			LRURemove(cache, tile);
+	}
+	else
+	{
+		cache->statistics.misses++;
+		tile->pinCount++;
+		if(tile->state == kTileQueued)
+		{
+			// No worker got to it yet - fill it here rather than wait.
+			DequeueTile(cache, tile);
+			tile->state = kTileFilling;
+			FillClaimedTile(cache, tile);
+		}
+		else
+		{
+			while(tile->state != kTileReady)
+				pthread_cond_wait(&cache->tileFilled, &cache->lock);
+		}
+	}
+	if((tile != NULL) && !tile->used)
+	{
+		tile->used = true;
+		cache->unreadTiles--;
+	}
+	pthread_mutex_unlock(&cache->lock);
+	return tile;
+}
+
+static void ReleaseTile(TileCacheRef cache, Tile *tile)
+{
+	pthread_mutex_lock(&cache->lock);
+	UnpinTile(cache, tile);
+	pthread_mutex_unlock(&cache->lock);
+}
+
+const uint8_t *TileCacheAcquireTile(TileCacheRef cache, size_t tileX, size_t tileY, size_t *rowBytes)
+{
+	if((tileX >= cache->tilesAcross) || (tileY >= cache->tilesDown))
+		return NULL;
+	Tile *tile = AcquireTileAtIndex(cache, tileY * cache->tilesAcross + tileX);
+	if(tile == NULL)
+		return NULL;
+	if(rowBytes != NULL)
+		*rowBytes = cache->tileRowBytes;
+	return tile->pixels;
+}
+
+void TileCacheReleaseTile(TileCacheRef cache, size_t tileX, size_t tileY)
+{
+	pthread_mutex_lock(&cache->lock);
+	Tile *tile = FindTile(cache, tileY * cache->tilesAcross + tileX);
+	if((tile != NULL) && (tile->pinCount > 0))
+		UnpinTile(cache, tile);
+	pthread_mutex_unlock(&cache->lock);
+}
+
+// Queues the tiles of the rectangle that are not resident yet. Returns false if the budget
+// ran out before the whole rectangle was queued. Called with the lock held.
+static bool QueueTiles(TileCacheRef cache, size_t tileX, size_t tileY, size_t tilesAcross, size_t tilesDown)
+{
+	bool queuedAll = true, queuedAny = false;
+	for(size_t ty = tileY; queuedAll && (ty < tileY + tilesDown) && (ty < cache->tilesDown); ++ty)
+	{
+		for(size_t tx = tileX; (tx < tileX + tilesAcross) && (tx < cache->tilesAcross); ++tx)
+		{
+			size_t index = ty * cache->tilesAcross + tx;
+			if(FindTile(cache, index) != NULL)
+				continue;
+			Tile *tile = (cache->unreadTiles < cache->maxUnreadTiles) ? ObtainTile(cache, index, true) : NULL;
+			if(tile == NULL)
+			{
+				queuedAll = false;
+				break;
+			}
+			cache->unreadTiles++;
+			tile->state = kTileQueued;
+			tile->pinCount = 1;
+			if(cache->queueTail != NULL)
+				cache->queueTail->queueNext = tile;
+			else
+				cache->queueHead = tile;
+			cache->queueTail = tile;
+			queuedAny = true;
+		}
+	}
+	if(queuedAny)
+		pthread_cond_broadcast(&cache->workAvailable);
+	return queuedAll;
+}
+
+void TileCachePrefetch(TileCacheRef cache, size_t tileX, size_t tileY, size_t tilesAcross, size_t tilesDown)
+{
+	pthread_mutex_lock(&cache->lock);
+	QueueTiles(cache, tileX, tileY, tilesAcross, tilesDown);
+	pthread_mutex_unlock(&cache->lock);
+}
+
+// Keeps the workers readAheadRows tile rows ahead of a sequential reader at tile row tileY.
+static void ReadAhead(TileCacheRef cache, size_t tileY)
+{
+	size_t rows = cache->config.readAheadRows;
+	if(rows == 0)
+		return;
+	
+	pthread_mutex_lock(&cache->lock);
+	// A reader that jumped backwards (a second pass, say) restarts the read-ahead window.
+	if(cache->readAheadFrom > tileY + 1 + rows)
+		cache->readAheadFrom = tileY + 1;
+	while((cache->readAheadFrom <= tileY + rows) && (cache->readAheadFrom < cache->tilesDown))
+	{
+		if(cache->readAheadFrom <= tileY)
+			cache->readAheadFrom = tileY + 1;
+		else if(QueueTiles(cache, 0, cache->readAheadFrom, cache->tilesAcross, 1))
+			cache->readAheadFrom++;
+		else
+			break;
+	}
+	pthread_mutex_unlock(&cache->lock);
+}
+
+size_t TileCacheCopyBytes(TileCacheRef cache, void *buffer, off_t offset, size_t count)
+{
+	if((offset < 0) || (offset >= cache->imageBytes))
+		return 0;
+	if((off_t)count > cache->imageBytes - offset)
+		count = (size_t)(cache->imageBytes - offset);
+	
+	const off_t rowBytes = (off_t)cache->imageRowBytes, end = offset + (off_t)count;
+	uint8_t *dst = (uint8_t*)buffer;
+	off_t position = offset;
+	while(position < end)
+	{
+		// Serve the part of the request that falls in one row of tiles, one tile at a time,
+		// so that each tile is acquired once however many of its rows are requested.
+		size_t tileY = (size_t)(position / rowBytes) / cache->config.tileHeight;
+		off_t bandFirstRow = (off_t)(tileY * cache->config.tileHeight);
+		off_t bandEnd = (bandFirstRow + (off_t)cache->config.tileHeight) * rowBytes;
+		if(bandEnd > end)
+			bandEnd = end;
+		off_t firstRow = position / rowBytes, lastRow = (bandEnd - 1) / rowBytes;
+		
+		ReadAhead(cache, tileY);
+		
+		for(size_t tileX = 0; tileX < cache->tilesAcross; ++tileX)
+		{
+			off_t columnStart = (off_t)(tileX * cache->tileRowBytes), columnEnd = columnStart + (off_t)cache->tileRowBytes;
+			if(columnEnd > rowBytes)
+				columnEnd = rowBytes;
+			// Partial single-row requests only touch a few of the tiles.
+			if((firstRow == lastRow) && ((firstRow * rowBytes + columnEnd <= position) || (firstRow * rowBytes + columnStart >= bandEnd)))
+				continue;
+			
+			Tile *tile = AcquireTileAtIndex(cache, tileY * cache->tilesAcross + tileX);
+			if(tile == NULL)
+				return (size_t)(position - offset);
+			for(off_t row = firstRow; row <= lastRow; ++row)
+			{
+				off_t rowStart = row * rowBytes;
+				off_t segmentStart = rowStart + columnStart, segmentEnd = rowStart + columnEnd;
+				if(segmentStart < position)
+					segmentStart = position;
+				if(segmentEnd > bandEnd)
+					segmentEnd = bandEnd;
+				if(segmentStart >= segmentEnd)
+					continue;
+				const uint8_t *src = tile->pixels + (size_t)(row - bandFirstRow) * cache->tileRowBytes + (size_t)(segmentStart - rowStart - columnStart);
+				memcpy(dst + (segmentStart - offset), src, (size_t)(segmentEnd - segmentStart));
+			}
+			ReleaseTile(cache, tile);
+		}
+		position = bandEnd;
+	}
+	return count;
+}
+
+void TileCacheGetGeometry(TileCacheRef cache, size_t *tileWidth, size_t *tileHeight, size_t *tilesAcross, size_t *tilesDown)
+{
+	if(tileWidth != NULL)
+		*tileWidth = cache->config.tileWidth;
+	if(tileHeight != NULL)
+		*tileHeight = cache->config.tileHeight;
+	if(tilesAcross != NULL)
+		*tilesAcross = cache->tilesAcross;
+	if(tilesDown != NULL)
+		*tilesDown = cache->tilesDown;
+}
+
+void TileCacheGetStatistics(TileCacheRef cache, TileCacheStatistics *statistics)
+{
+	pthread_mutex_lock(&cache->lock);
+	*statistics = cache->statistics;
+	pthread_mutex_unlock(&cache->lock);
+}
+
+#pragma mark Pattern source
+
+typedef struct
+{
+	size_t width, height;
+} PatternInfo;
+
+// Writes count XRGB pixels starting at image column x: bytes are X = 0, R = red,
+// G = column & 255, B = blue, matching MyGetBytesAtOffset in DataProvider.c.
+static void FillPatternRow(uint8_t *pixels, size_t x, size_t count, uint8_t red, uint8_t blue)
+{
+	size_t i = 0;
+#if defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+	// Both targets are little endian, so the pixel bytes read as 0xBBGGRR00.
+	const uint32_t base = ((uint32_t)red << 8) | ((uint32_t)blue << 24);
+	#if defined(__SSE2__)
+	__m128i green = _mm_setr_epi32((int)x, (int)x + 1, (int)x + 2, (int)x + 3);
+	const __m128i four = _mm_set1_epi32(4), mask = _mm_set1_epi32(0xFF), fixed = _mm_set1_epi32((int)base);
+	for(; i + 4 <= count; i += 4)
+	{
+		__m128i g = _mm_and_si128(green, mask);
+		_mm_storeu_si128((__m128i*)(pixels + i * 4), _mm_or_si128(_mm_slli_epi32(g, 16), fixed));
+		green = _mm_add_epi32(green, four);
+	}
+	#else
+	const uint32_t start[4] = { (uint32_t)x, (uint32_t)x + 1, (uint32_t)x + 2, (uint32_t)x + 3 };
+	uint32x4_t green = vld1q_u32(start);
+	const uint32x4_t four = vdupq_n_u32(4), mask = vdupq_n_u32(0xFF), fixed = vdupq_n_u32(base);
+	for(; i + 4 <= count; i += 4)
+	{
+		uint32x4_t g = vandq_u32(green, mask);
+		vst1q_u8(pixels + i * 4, vreinterpretq_u8_u32(vorrq_u32(vshlq_n_u32(g, 16), fixed)));
+		green = vaddq_u32(green, four);
+	}
+	#endif
+#endif
+	for(; i < count; ++i)
+	{
+		uint8_t *p = pixels + i * 4;
+		p[0] = 0;
+		p[1] = red;
+		p[2] = (uint8_t)((x + i) & 255);
+		p[3] = blue;
+	}
+}
+
+static bool PatternFill(void *sourceInfo, size_t x, size_t y, size_t width, size_t height, uint8_t *pixels, size_t rowBytes)
+{
+	const PatternInfo *info = (const PatternInfo*)sourceInfo;
+	for(size_t row = 0; row < height; ++row)
+	{
+		uint64_t line = y + row;
+		uint8_t blue = (uint8_t)(((line + 1) * 255 + info->height / 2) / info->height);
+		FillPatternRow(pixels + row * rowBytes, x, width, (uint8_t)(line & 255), blue);
+	}
+	return true;
+}
+
+static void PatternRelease(void *sourceInfo)
+{
+	free(sourceInfo);
+}
+
+TileSource TileSourceCreatePattern(size_t width, size_t height)
+{
+	TileSource source = { NULL, NULL, NULL };
+	PatternInfo *info = (PatternInfo*)malloc(sizeof(PatternInfo));
+	if(info != NULL)
+	{
+		info->width = width;
+		info->height = height;
+		source.fill = PatternFill;
+		source.release = PatternRelease;
+		source.info = info;
+	}
+	return source;
+}
+
+#pragma mark Raw file source
+
+typedef struct
+{
+	int fd;
+	size_t width, height, bytesPerPixel;
+} RawFileInfo;
+
+static bool RawFileFill(void *sourceInfo, size_t x, size_t y, size_t width, size_t height, uint8_t *pixels, size_t rowBytes)
+{
+	const RawFileInfo *info = (const RawFileInfo*)sourceInfo;
+	const size_t length = width * info->bytesPerPixel;
+	for(size_t row = 0; row < height; ++row)
+	{
+		off_t position = ((off_t)(y + row) * (off_t)info->width + (off_t)x) * (off_t)info->bytesPerPixel;
+		size_t done = 0;
+		while(done < length)
+		{
+			ssize_t result = pread(info->fd, pixels + row * rowBytes + done, length - done, position + (off_t)done);
+			if(result < 0 && errno == EINTR)
+				continue;
+			if(result <= 0)
+				return false;
+			done += (size_t)result;
+		}
+	}
+	return true;
+}
+
+static void RawFileRelease(void *sourceInfo)
+{
+	RawFileInfo *info = (RawFileInfo*)sourceInfo;
+	close(info->fd);
+	free(info);
+}
+
+TileSource TileSourceCreateRawFile(const char *path, size_t width, size_t height, size_t bytesPerPixel)
+{
+	TileSource source = { NULL, NULL, NULL };
+	int fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return source;
+	RawFileInfo *info = (RawFileInfo*)malloc(sizeof(RawFileInfo));
+	if(info == NULL)
+	{
+		close(fd);
+		return source;
+	}
+	info->fd = fd;
+	info->width = width;
+	info->height = height;
+	info->bytesPerPixel = bytesPerPixel;
+	source.fill = RawFileFill;
+	source.release = RawFileRelease;
+	source.info = info;
+	return source;
+}
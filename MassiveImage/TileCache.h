@@ -0,0 +1,153 @@
+/*
+    File: TileCache.h
+Abstract: Tiled, multi-threaded, LRU-cached pixel source used by the tiled data provider
+ Version: 1.1
+
+Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+Inc. ("Apple") in consideration of your agreement to the following
+terms, and your use, installation, modification or redistribution of
+this Apple software constitutes acceptance of these terms.  If you do
+not agree with these terms, please do not use, install, modify or
+redistribute this Apple software.
+
+In consideration of your agreement to abide by the following terms, and
+subject to these terms, Apple grants you a personal, non-exclusive
+license, under Apple's copyrights in this original Apple software (the
+"Apple Software"), to use, reproduce, modify and redistribute the Apple
+Software, with or without modifications, in source and/or binary forms;
+provided that if you redistribute the Apple Software in its entirety and
+without modifications, you must retain this notice and the following
+text and disclaimers in all such redistributions of the Apple Software.
+Neither the name, trademarks, service marks or logos of Apple Inc. may
+be used to endorse or promote products derived from the Apple Software
+without specific prior written permission from Apple.  Except as
+expressly stated in this notice, no other rights or licenses, express or
+implied, are granted by Apple herein, including but not limited to any
+patent rights that may be infringed by your derivative works or by other
+works in which the Apple Software may be incorporated.
+
+The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+
+IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+Copyright (C) 2010 Apple Inc. All Rights Reserved.
+
+*/
+
+
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The tile cache is deliberately free of any CoreGraphics dependency so that it can be
+// driven by the CGDataProvider in DataProvider.c as well as by command line tools
+// (see TileBenchmark.c) on any POSIX system.
+//
+// The image is split into fixed-size tiles. Tiles are produced by a TileSource, either
+// on the thread that asks for them or ahead of time by a pool of worker threads, and are
+// kept in an LRU cache whose pixel storage never grows past a memory budget (except
+// transiently when every resident tile is in use).
+
+// Fills one tile. x, y, width and height describe the tile in image pixels (edge tiles
+// may be smaller than the configured tile size). Rows are rowBytes apart in pixels.
+// Called concurrently from several threads, so it must not touch shared mutable state.
+// Return false if the pixels could not be produced; the tile is then zero filled.
+typedef bool (*TileSourceFillCallback)(void *sourceInfo, size_t x, size_t y, size_t width, size_t height, uint8_t *pixels, size_t rowBytes);
+
+// Releases sourceInfo when the cache is destroyed. May be NULL.
+typedef void (*TileSourceReleaseCallback)(void *sourceInfo);
+
+typedef struct
+{
+	TileSourceFillCallback fill;
+	TileSourceReleaseCallback release;
+	void *info;
+} TileSource;
+
+typedef struct
+{
+	size_t width, height;		// image size in pixels
+	size_t bytesPerPixel;
+	size_t tileWidth, tileHeight;	// tile size in pixels; 0 selects a default
+	size_t memoryBudget;		// bytes of tile storage; 0 selects a default
+	size_t workerCount;		// prefetch threads; 0 uses the number of online CPUs
+	size_t readAheadRows;		// tile rows prefetched ahead of sequential reads; 0 disables
+} TileCacheConfig;
+
+typedef struct
+{
+	uint64_t hits;			// requests satisfied by a resident tile
+	uint64_t misses;		// requests that had to fill (or wait for) a tile
+	uint64_t prefetched;		// tiles filled by the worker threads
+	uint64_t evictions;		// tiles dropped to stay within the memory budget
+	size_t residentBytes;		// current tile storage
+	size_t peakResidentBytes;	// high water mark of tile storage
+} TileCacheStatistics;
+
+typedef struct TileCache *TileCacheRef;
+
+// Creates a cache over source. Returns NULL if the configuration is invalid or if
+// allocation fails; source.release is not called in that case.
+TileCacheRef TileCacheCreate(const TileCacheConfig *config, TileSource source);
+
+// Stops the worker threads, frees all tiles and releases the source.
+// No tile may be acquired at that point.
+void TileCacheRelease(TileCacheRef cache);
+
+// Random access: returns the pixels of tile (tileX, tileY), filling it if needed, and pins
+// it until the matching TileCacheReleaseTile. *rowBytes receives the tile's row stride.
+// Returns NULL if the tile coordinates are out of range.
+const uint8_t *TileCacheAcquireTile(TileCacheRef cache, size_t tileX, size_t tileY, size_t *rowBytes);
+void TileCacheReleaseTile(TileCacheRef cache, size_t tileX, size_t tileY);
+
+// Asks the worker threads to fill the given rectangle of tiles (in tile coordinates) in the
+// background, as long as the memory budget allows. Prefetched tiles that have not been
+// acquired yet are never evicted to make room for others, so read-ahead is limited to what
+// the budget holds beyond one row of tiles; the rest of the rectangle is skipped. Returns
+// immediately.
+void TileCachePrefetch(TileCacheRef cache, size_t tileX, size_t tileY, size_t tilesAcross, size_t tilesDown);
+
+// Sequential access: copies count bytes starting at offset of the image laid out row by
+// row with no padding, as a CGDataProvider delivers it. Tile rows after the one being read
+// are prefetched according to readAheadRows. Returns the number of bytes copied.
+size_t TileCacheCopyBytes(TileCacheRef cache, void *buffer, off_t offset, size_t count);
+
+void TileCacheGetGeometry(TileCacheRef cache, size_t *tileWidth, size_t *tileHeight, size_t *tilesAcross, size_t *tilesDown);
+void TileCacheGetStatistics(TileCacheRef cache, TileCacheStatistics *statistics);
+
+// Built-in sources.
+
+// The repeating XRGB pattern the original data provider produced: R = y, G = x and
+// B ramps from 0 to 255 from the top of the image to the bottom. Rows are built with
+// SIMD stores where available. Requires 4 bytes per pixel.
+TileSource TileSourceCreatePattern(size_t width, size_t height);
+
+// Reads tiles from a headerless file of width * height pixels stored row by row, using
+// pread so that workers do not contend for a file position. Returns a source with a NULL
+// fill callback if the file cannot be opened.
+TileSource TileSourceCreateRawFile(const char *path, size_t width, size_t height, size_t bytesPerPixel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TILECACHE_H
@@ -83,6 +83,8 @@
 #include <mach/mach_time.h>
 #include <math.h>
 
+#include "transpose_cpu.h"
+
 /////////////////////////////////////////////////////////////////////////////
 
 #define PADDING         (32)
@@ -91,9 +93,6 @@
 #define LOG_GROUP_DIMX  (5)
 #define GROUP_DIMY      (2)
 
-#define WIDTH           (256)
-#define HEIGHT          (4096)
-
 static int iterations = 100;
 static int width      = 256;
 static int height     = 4096;
@@ -121,6 +120,16 @@ load_program_source(const char *filename)
 
 /////////////////////////////////////////////////////////////////////////////
 
+static double
+elapsed_seconds(uint64_t t0, uint64_t t1)
+{
+    struct mach_timebase_info info;
+    mach_timebase_info(&info);
+    return 1e-9 * (t1 - t0) * info.numer / info.denom;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
 int main(int argc, char **argv)
 {
     uint64_t         t0, t1, t2;
@@ -132,6 +141,21 @@ int main(int argc, char **argv)
     cl_program       program;
     cl_mem			 dst, src;
 
+    // The matrix size may be given on the command line as "transpose width height".
+    // Any size works; sizes that are not multiples of GROUP_DIMX are handled by
+    // the edge checks in the kernel.
+    //
+    if (argc == 3)
+    {
+        width  = atoi(argv[1]);
+        height = atoi(argv[2]);
+        if (width <= 0 || height <= 0)
+        {
+            printf("Usage: %s [width height]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
     // Create some random input data on the host 
     //
     float *h_data = malloc(width * height * sizeof(float));
@@ -206,7 +230,7 @@ int main(int argc, char **argv)
 
     // Create the compute kernel from within the program
     //
-    kernel = clCreateKernel(program, "transpose", &err);
+    kernel = clCreateKernel(program, "transpose_sized", &err);
     if (!kernel || err != CL_SUCCESS)
     {
         printf("Error: Failed to create compute kernel!\n");
@@ -245,17 +269,22 @@ int main(int argc, char **argv)
     err  = clSetKernelArg(kernel,  0, sizeof(cl_mem), &dst);
     err |= clSetKernelArg(kernel,  1, sizeof(cl_mem), &src);
     err |= clSetKernelArg(kernel,  2, sizeof(float) * GROUP_DIMX * (GROUP_DIMX + 1), NULL);
+    cl_uint arg_width = width, arg_height = height, arg_stride = height + PADDING;
+    err |= clSetKernelArg(kernel,  3, sizeof(cl_uint), &arg_width);
+    err |= clSetKernelArg(kernel,  4, sizeof(cl_uint), &arg_height);
+    err |= clSetKernelArg(kernel,  5, sizeof(cl_uint), &arg_stride);
     if (err != CL_SUCCESS)
     {
         printf("Error: Failed to set kernel arguments!\n");
         return EXIT_FAILURE;
     }
 
-    // Determine the global and local dimensions for the execution
+    // Determine the global and local dimensions for the execution, rounding
+    // up to whole work-groups
     //
     size_t global[2], local[2];
-    global[0] = width * GROUP_DIMY;
-    global[1] = height / GROUP_DIMX;
+    global[0] = ((width + GROUP_DIMX - 1) / GROUP_DIMX) * GROUP_DIMX * GROUP_DIMY;
+    global[1] = (height + GROUP_DIMX - 1) / GROUP_DIMX;
     local[0] = GROUP_DIMX * GROUP_DIMY;
     local[1] = 1;
 
@@ -289,18 +318,29 @@ int main(int argc, char **argv)
 
     // Calculate the total bandwidth that was obtained on the device for all memory transfers
     //
-    struct mach_timebase_info info;
-    mach_timebase_info(&info);
-    double t = 1e-9 * (t2 - t1) * info.numer / info.denom;
+    double t = elapsed_seconds(t1, t2);
     printf("Bandwidth Achieved = %f GB/sec\n", 2e-9 * sizeof(float) * width * height * iterations / t);
 
-    // Verify the results are correct by performing the matrix transpose on the host
+    // Perform the same transpose on the host with the CPU library, which also
+    // provides the reference results, and compare with memcpy of the same data
     //
     float *reference = (float *) malloc(sizeof(float) * width * height);
     int l;
-    for (k = 0; k < height; k++)
-        for (l = 0; l < width; l++)
-            reference[l*height + k] = h_data[k*width + l];
+    t1 = mach_absolute_time();
+    for (k = 0; k < iterations; k++)
+        transpose_cpu(reference, height, h_data, width, height, width);
+    t2 = mach_absolute_time();
+    t = elapsed_seconds(t1, t2);
+    printf("CPU Bandwidth Achieved = %f GB/sec\n", 2e-9 * sizeof(float) * width * height * iterations / t);
+
+    float *h_copy = (float *) malloc(sizeof(float) * width * height);
+    t1 = mach_absolute_time();
+    for (k = 0; k < iterations; k++)
+        memcpy(h_copy, h_data, sizeof(float) * width * height);
+    t2 = mach_absolute_time();
+    t = elapsed_seconds(t1, t2);
+    printf("CPU memcpy Bandwidth = %f GB/sec\n", 2e-9 * sizeof(float) * width * height * iterations / t);
+    free(h_copy);
 
     float *h_result = (float *) malloc(sizeof(float) * width * (height + PADDING));
     memset(h_result, 0, sizeof(float)*width*(height + PADDING));
@@ -328,6 +368,7 @@ int main(int argc, char **argv)
 
     free(h_data);
     free(h_result);
+    free(reference);
     
     clReleaseMemObject(src);
     clReleaseMemObject(dst);
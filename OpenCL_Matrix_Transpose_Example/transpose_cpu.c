@@ -0,0 +1,687 @@
+//
+// File:       transpose_cpu.c
+//
+// Abstract:   Implements the CPU matrix transpose library declared in transpose_cpu.h.
+//
+//             The out-of-place transpose recursively halves the longer dimension of the matrix
+//             until a piece is at most LEAF_DIM x LEAF_DIM elements, at which point both the
+//             source and destination rows it touches fit in the first-level cache.  Leaves are
+//             transposed in 8x8 register blocks, with scalar code only for the ragged edges of
+//             matrices whose dimensions are not multiples of eight.
+//
+//             Matrices with both dimensions of at least LEAF_DIM are instead moved in squares
+//             of up to TILE_DIM x TILE_DIM:  the rows of the source square are copied whole into
+//             the square of the destination, and that square is then transposed in place while
+//             it is still in the second-level cache.  Each row is then a run of up to a
+//             kilobyte in both matrices, rather than the 256 bytes of a leaf, and the in-place
+//             transpose reads and writes the same cache lines, so fewer lines travel to and
+//             from memory than when leaves are read from one matrix and written to another.
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "transpose_cpu.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Largest piece the recursion hands to the leaf routines.  64 x 64 floats
+// is 16KB for the source and 16KB for the destination, which fits in the
+// first-level cache while keeping runs along rows long enough to stream.
+#define LEAF_DIM        (64)
+
+// Size of the register blocks used by the micro-kernels.
+#define BLOCK_DIM       (8)
+
+// Side of the squares the out-of-place transpose moves at a time.  256 x 256
+// floats is 256KB, which stays in the second-level cache while it is
+// transposed in place.
+#define TILE_DIM        (256)
+
+// Rows ahead of the copy to prefetch, in both matrices, when moving a square.
+#define PREFETCH_ROWS   (2)
+
+// Floats of scratch used to gather the rows of the in-place transpose of
+// shapes that are not made of whole squares.
+#define SCRATCH_COUNT   (16384)
+
+/////////////////////////////////////////////////////////////////////////////
+
+static inline void
+transpose_4x4(float *dst, size_t dst_stride, const float *src, size_t src_stride)
+{
+#if defined(__SSE__)
+    __m128 r0 = _mm_loadu_ps(src + 0 * src_stride);
+    __m128 r1 = _mm_loadu_ps(src + 1 * src_stride);
+    __m128 r2 = _mm_loadu_ps(src + 2 * src_stride);
+    __m128 r3 = _mm_loadu_ps(src + 3 * src_stride);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(dst + 0 * dst_stride, r0);
+    _mm_storeu_ps(dst + 1 * dst_stride, r1);
+    _mm_storeu_ps(dst + 2 * dst_stride, r2);
+    _mm_storeu_ps(dst + 3 * dst_stride, r3);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    float32x4x2_t a = vtrnq_f32(vld1q_f32(src + 0 * src_stride), vld1q_f32(src + 1 * src_stride));
+    float32x4x2_t b = vtrnq_f32(vld1q_f32(src + 2 * src_stride), vld1q_f32(src + 3 * src_stride));
+    vst1q_f32(dst + 0 * dst_stride, vcombine_f32(vget_low_f32(a.val[0]),  vget_low_f32(b.val[0])));
+    vst1q_f32(dst + 1 * dst_stride, vcombine_f32(vget_low_f32(a.val[1]),  vget_low_f32(b.val[1])));
+    vst1q_f32(dst + 2 * dst_stride, vcombine_f32(vget_high_f32(a.val[0]), vget_high_f32(b.val[0])));
+    vst1q_f32(dst + 3 * dst_stride, vcombine_f32(vget_high_f32(a.val[1]), vget_high_f32(b.val[1])));
+#else
+    int i, j;
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++)
+            dst[j * dst_stride + i] = src[i * src_stride + j];
+#endif
+}
+
+// Transpose one 8x8 block.  All loads happen before any store, except in
+// the four-by-four fallback, so callers must not pass overlapping blocks.
+//
+static inline void
+transpose_8x8(float *dst, size_t dst_stride, const float *src, size_t src_stride)
+{
+#if defined(__AVX__)
+    __m256 r0 = _mm256_loadu_ps(src + 0 * src_stride);
+    __m256 r1 = _mm256_loadu_ps(src + 1 * src_stride);
+    __m256 r2 = _mm256_loadu_ps(src + 2 * src_stride);
+    __m256 r3 = _mm256_loadu_ps(src + 3 * src_stride);
+    __m256 r4 = _mm256_loadu_ps(src + 4 * src_stride);
+    __m256 r5 = _mm256_loadu_ps(src + 5 * src_stride);
+    __m256 r6 = _mm256_loadu_ps(src + 6 * src_stride);
+    __m256 r7 = _mm256_loadu_ps(src + 7 * src_stride);
+
+    // Interleave pairs of rows, then pairs of pairs, within each 128-bit lane...
+    __m256 t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpackhi_ps(r0, r1);
+    __m256 t2 = _mm256_unpacklo_ps(r2, r3), t3 = _mm256_unpackhi_ps(r2, r3);
+    __m256 t4 = _mm256_unpacklo_ps(r4, r5), t5 = _mm256_unpackhi_ps(r4, r5);
+    __m256 t6 = _mm256_unpacklo_ps(r6, r7), t7 = _mm256_unpackhi_ps(r6, r7);
+
+    __m256 s0 = _mm256_shuffle_ps(t0, t2, 0x44), s1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+    __m256 s2 = _mm256_shuffle_ps(t1, t3, 0x44), s3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+    __m256 s4 = _mm256_shuffle_ps(t4, t6, 0x44), s5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+    __m256 s6 = _mm256_shuffle_ps(t5, t7, 0x44), s7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+
+    // ...then exchange the lanes.
+    _mm256_storeu_ps(dst + 0 * dst_stride, _mm256_permute2f128_ps(s0, s4, 0x20));
+    _mm256_storeu_ps(dst + 1 * dst_stride, _mm256_permute2f128_ps(s1, s5, 0x20));
+    _mm256_storeu_ps(dst + 2 * dst_stride, _mm256_permute2f128_ps(s2, s6, 0x20));
+    _mm256_storeu_ps(dst + 3 * dst_stride, _mm256_permute2f128_ps(s3, s7, 0x20));
+    _mm256_storeu_ps(dst + 4 * dst_stride, _mm256_permute2f128_ps(s0, s4, 0x31));
+    _mm256_storeu_ps(dst + 5 * dst_stride, _mm256_permute2f128_ps(s1, s5, 0x31));
+    _mm256_storeu_ps(dst + 6 * dst_stride, _mm256_permute2f128_ps(s2, s6, 0x31));
+    _mm256_storeu_ps(dst + 7 * dst_stride, _mm256_permute2f128_ps(s3, s7, 0x31));
+#else
+    transpose_4x4(dst,                      dst_stride, src,                      src_stride);
+    transpose_4x4(dst + 4,                  dst_stride, src + 4 * src_stride,     src_stride);
+    transpose_4x4(dst + 4 * dst_stride,     dst_stride, src + 4,                  src_stride);
+    transpose_4x4(dst + 4 * dst_stride + 4, dst_stride, src + 4 * src_stride + 4, src_stride);
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Split n into a first part that is a multiple of the block size, so that
+// the leaves see as few ragged edges as possible.
+//
+static inline size_t
+split(size_t n)
+{
+    size_t half = n / 2;
+    return half > BLOCK_DIM ? half & ~(size_t) (BLOCK_DIM - 1) : half;
+}
+
+static void
+transpose_leaf(
+    float *dst, size_t dst_stride,
+    const float *src, size_t src_stride,
+    size_t rows, size_t cols)
+{
+    size_t full_rows = rows & ~(size_t) (BLOCK_DIM - 1);
+    size_t full_cols = cols & ~(size_t) (BLOCK_DIM - 1);
+    size_t i, j;
+
+    // Walk down the source so that each destination row is written in one
+    // contiguous run, completing its cache lines back to back.
+    for (j = 0; j < full_cols; j += BLOCK_DIM)
+        for (i = 0; i < full_rows; i += BLOCK_DIM)
+            transpose_8x8(dst + j * dst_stride + i, dst_stride,
+                          src + i * src_stride + j, src_stride);
+
+    // Ragged right edge, then ragged bottom edge.
+    for (i = 0; i < rows; i++)
+        for (j = full_cols; j < cols; j++)
+            dst[j * dst_stride + i] = src[i * src_stride + j];
+
+    for (i = full_rows; i < rows; i++)
+        for (j = 0; j < full_cols; j++)
+            dst[j * dst_stride + i] = src[i * src_stride + j];
+}
+
+static void
+transpose_recursive(
+    float *dst, size_t dst_stride,
+    const float *src, size_t src_stride,
+    size_t rows, size_t cols)
+{
+    while (rows > LEAF_DIM || cols > LEAF_DIM)
+    {
+        if (rows >= cols)
+        {
+            // Top rows of src become the left columns of dst.
+            size_t half = split(rows);
+            transpose_recursive(dst, dst_stride, src, src_stride, half, cols);
+            dst  += half;
+            src  += half * src_stride;
+            rows -= half;
+        }
+        else
+        {
+            // Left columns of src become the top rows of dst.
+            size_t half = split(cols);
+            transpose_recursive(dst, dst_stride, src, src_stride, rows, half);
+            dst  += half * dst_stride;
+            src  += half;
+            cols -= half;
+        }
+    }
+    transpose_leaf(dst, dst_stride, src, src_stride, rows, cols);
+}
+
+static void transpose_square_recursive(float *a, size_t stride, size_t n);
+
+// Transpose the n x n square at src into dst by copying its rows into place
+// and transposing them there.
+//
+static void
+transpose_tile(float *dst, size_t dst_stride, const float *src, size_t src_stride, size_t n)
+{
+    size_t i, k;
+
+    for (i = 0; i < n; i++)
+    {
+        if (i + PREFETCH_ROWS < n)
+        {
+            for (k = 0; k < n; k += 64 / sizeof *src)
+            {
+                __builtin_prefetch(src + (i + PREFETCH_ROWS) * src_stride + k, 0);
+                __builtin_prefetch(dst + (i + PREFETCH_ROWS) * dst_stride + k, 1);
+            }
+        }
+        memcpy(dst + i * dst_stride, src + i * src_stride, n * sizeof *dst);
+    }
+    transpose_square_recursive(dst, dst_stride, n);
+}
+
+// Move the matrix in squares of up to TILE_DIM.  The strips left over at the
+// right and bottom are narrower than the squares, and are moved in squares as
+// wide as they are, until what is left is narrower than a leaf.
+//
+static void
+transpose_tiled(
+    float *dst, size_t dst_stride,
+    const float *src, size_t src_stride,
+    size_t rows, size_t cols)
+{
+    size_t side = rows < cols ? rows : cols;
+    size_t tiled_rows, tiled_cols, i, j;
+
+    if (side > TILE_DIM)
+        side = TILE_DIM;
+    if (side < LEAF_DIM)
+    {
+        transpose_recursive(dst, dst_stride, src, src_stride, rows, cols);
+        return;
+    }
+
+    tiled_rows = rows - rows % side;
+    tiled_cols = cols - cols % side;
+    for (i = 0; i < tiled_rows; i += side)
+        for (j = 0; j < tiled_cols; j += side)
+            transpose_tile(dst + j * dst_stride + i, dst_stride,
+                           src + i * src_stride + j, src_stride, side);
+
+    if (tiled_cols < cols)
+        transpose_tiled(dst + tiled_cols * dst_stride, dst_stride,
+                        src + tiled_cols, src_stride, tiled_rows, cols - tiled_cols);
+    if (tiled_rows < rows)
+        transpose_tiled(dst + tiled_rows, dst_stride,
+                        src + tiled_rows * src_stride, src_stride, rows - tiled_rows, cols);
+}
+
+void
+transpose_cpu(
+    float *dst, size_t dst_stride,
+    const float *src, size_t src_stride,
+    size_t rows, size_t cols)
+{
+    if (rows == 0 || cols == 0)
+        return;
+    transpose_tiled(dst, dst_stride, src, src_stride, rows, cols);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Exchange the rows x cols block at a with the cols x rows block at b,
+// transposing both:  afterwards a holds the old b transposed and vice versa.
+// The blocks must not overlap.
+//
+static void
+swap_leaf(float *a, float *b, size_t stride, size_t rows, size_t cols)
+{
+    float tmp[BLOCK_DIM * BLOCK_DIM];
+    size_t full_rows = rows & ~(size_t) (BLOCK_DIM - 1);
+    size_t full_cols = cols & ~(size_t) (BLOCK_DIM - 1);
+    size_t i, j, k;
+
+    for (i = 0; i < full_rows; i += BLOCK_DIM)
+    {
+        for (j = 0; j < full_cols; j += BLOCK_DIM)
+        {
+            float *pa = a + i * stride + j, *pb = b + j * stride + i;
+            transpose_8x8(tmp, BLOCK_DIM, pa, stride);
+            transpose_8x8(pa, stride, pb, stride);
+            for (k = 0; k < BLOCK_DIM; k++)
+                memcpy(pb + k * stride, tmp + k * BLOCK_DIM, sizeof tmp / BLOCK_DIM);
+        }
+    }
+
+    for (i = 0; i < rows; i++)
+    {
+        for (j = (i < full_rows ? full_cols : 0); j < cols; j++)
+        {
+            float t = a[i * stride + j];
+            a[i * stride + j] = b[j * stride + i];
+            b[j * stride + i] = t;
+        }
+    }
+}
+
+static void
+swap_recursive(float *a, float *b, size_t stride, size_t rows, size_t cols)
+{
+    while (rows > LEAF_DIM || cols > LEAF_DIM)
+    {
+        if (rows >= cols)
+        {
+            size_t half = split(rows);
+            swap_recursive(a, b, stride, half, cols);
+            a    += half * stride;
+            b    += half;
+            rows -= half;
+        }
+        else
+        {
+            size_t half = split(cols);
+            swap_recursive(a, b, stride, rows, half);
+            a    += half;
+            b    += half * stride;
+            cols -= half;
+        }
+    }
+    swap_leaf(a, b, stride, rows, cols);
+}
+
+// Transpose the n x n block on the diagonal at a in place.
+//
+static void
+transpose_square_recursive(float *a, size_t stride, size_t n)
+{
+    if (n > LEAF_DIM)
+    {
+        size_t half = split(n);
+        transpose_square_recursive(a, stride, half);
+        transpose_square_recursive(a + half * stride + half, stride, n - half);
+        swap_recursive(a + half, a + half * stride, stride, half, n - half);
+        return;
+    }
+
+    {
+        float tmp[BLOCK_DIM * BLOCK_DIM];
+        size_t full = n & ~(size_t) (BLOCK_DIM - 1);
+        size_t i, k;
+
+        for (i = 0; i < full; i += BLOCK_DIM)
+        {
+            float *p = a + i * stride + i;
+            transpose_8x8(tmp, BLOCK_DIM, p, stride);
+            for (k = 0; k < BLOCK_DIM; k++)
+                memcpy(p + k * stride, tmp + k * BLOCK_DIM, sizeof tmp / BLOCK_DIM);
+            if (i + BLOCK_DIM < n)
+                swap_leaf(p + BLOCK_DIM, p + BLOCK_DIM * stride, stride,
+                          BLOCK_DIM, n - i - BLOCK_DIM);
+        }
+
+        // Ragged bottom-right corner.
+        for (i = full; i < n; i++)
+            for (k = i + 1; k < n; k++)
+            {
+                float t = a[i * stride + k];
+                a[i * stride + k] = a[k * stride + i];
+                a[k * stride + i] = t;
+            }
+    }
+}
+
+// Transpose a rows x cols matrix whose elements are runs of chunk floats.
+// Element (r, c) moves from r * cols + c to c * rows + r.  Walk each cycle
+// of that permutation backward, pulling every element into the slot it
+// belongs in, and mark the slots done in a bitmap.
+//
+static int
+transpose_cycles(float *data, size_t rows, size_t cols, size_t chunk)
+{
+    size_t count = rows * cols;
+    uint64_t *done = calloc((count + 63) / 64, sizeof *done);
+    float *saved = malloc(chunk * sizeof *saved);
+    size_t start;
+
+    if (!done || !saved)
+    {
+        free(done);
+        free(saved);
+        return -1;
+    }
+
+    // The first and last elements never move.
+    for (start = 1; start + 1 < count; start++)
+    {
+        size_t dst, src;
+
+        if (done[start / 64] & (UINT64_C(1) << (start % 64)))
+            continue;
+
+        memcpy(saved, data + start * chunk, chunk * sizeof *saved);
+        for (dst = start; ; dst = src)
+        {
+            // dst is element (dst / rows, dst % rows) of the transpose.
+            src = (dst % rows) * cols + dst / rows;
+            done[dst / 64] |= UINT64_C(1) << (dst % 64);
+            if (src == start)
+                break;
+            if (chunk == 1)
+                data[dst] = data[src];
+            else
+                memcpy(data + dst * chunk, data + src * chunk, chunk * sizeof *data);
+        }
+        memcpy(data + dst * chunk, saved, chunk * sizeof *saved);
+    }
+
+    free(done);
+    free(saved);
+    return 0;
+}
+
+static void
+reverse(float *p, size_t n)
+{
+    float *q = p + n;
+
+    while (p + 1 < q)
+    {
+        float t = *p;
+        *p++ = *--q;
+        *q = t;
+    }
+}
+
+// Rotate the n floats at p left by k, so that p[k] comes first.  When either
+// part fits in the scratch buffer it is set aside while the other part moves;
+// otherwise the three reversals touch every float twice.
+//
+static void
+rotate(float *p, size_t k, size_t n, float *scratch)
+{
+    if (k == 0 || k == n)
+        return;
+
+    if (k <= SCRATCH_COUNT)
+    {
+        memcpy(scratch, p, k * sizeof *p);
+        memmove(p, p + k, (n - k) * sizeof *p);
+        memcpy(p + n - k, scratch, k * sizeof *p);
+    }
+    else if (n - k <= SCRATCH_COUNT)
+    {
+        memcpy(scratch, p + k, (n - k) * sizeof *p);
+        memmove(p + n - k, p, k * sizeof *p);
+        memcpy(p, scratch, (n - k) * sizeof *p);
+    }
+    else
+    {
+        reverse(p, k);
+        reverse(p + k, n - k);
+        reverse(p, n);
+    }
+}
+
+// p holds count rows, each a run of a floats followed by a run of b floats.
+// Gather the runs of a of every row, in order, ahead of the runs of b.  Rows
+// whose runs of b fit in the scratch buffer are gathered in one pass; more
+// rows are split in half, gathered separately, and the runs of b of the
+// first half rotated past the runs of a of the second.
+//
+static void
+gather_rows(float *p, size_t count, size_t a, size_t b, float *scratch)
+{
+    size_t half, i;
+
+    if (count <= 1)
+        return;
+
+    if (count * b <= SCRATCH_COUNT)
+    {
+        for (i = 0; i < count; i++)
+            memcpy(scratch + i * b, p + i * (a + b) + a, b * sizeof *p);
+        for (i = 1; i < count; i++)
+            memmove(p + i * a, p + i * (a + b), a * sizeof *p);
+        memcpy(p + count * a, scratch, count * b * sizeof *p);
+        return;
+    }
+
+    half = count / 2;
+    gather_rows(p, half, a, b, scratch);
+    gather_rows(p + half * (a + b), count - half, a, b, scratch);
+    rotate(p + half * a, half * b, half * b + (count - half) * a, scratch);
+}
+
+// The inverse of gather_rows():  p holds count runs of a floats followed by
+// count runs of b floats; interleave them into rows.
+//
+static void
+scatter_rows(float *p, size_t count, size_t a, size_t b, float *scratch)
+{
+    size_t half, i;
+
+    if (count <= 1)
+        return;
+
+    if (count * b <= SCRATCH_COUNT)
+    {
+        memcpy(scratch, p + count * a, count * b * sizeof *p);
+        for (i = count - 1; i > 0; i--)
+            memmove(p + i * (a + b), p + i * a, a * sizeof *p);
+        for (i = 0; i < count; i++)
+            memcpy(p + i * (a + b) + a, scratch + i * b, b * sizeof *p);
+        return;
+    }
+
+    half = count / 2;
+    rotate(p + half * a, (count - half) * a, (count - half) * a + half * b, scratch);
+    scatter_rows(p, half, a, b, scratch);
+    scatter_rows(p + half * (a + b), count - half, a, b, scratch);
+}
+
+// Transpose a matrix that is a square, or a stack or row of whole squares.
+//
+static int
+transpose_squares(float *data, size_t rows, size_t cols)
+{
+    size_t k;
+
+    if (rows == cols)
+    {
+        transpose_square_recursive(data, cols, rows);
+        return 0;
+    }
+
+    // A tall matrix made of k stacked squares:  transpose each square, after
+    // which row r of the result is row r of every square in turn, which is a
+    // k x cols transpose of whole rows.
+    if (rows % cols == 0)
+    {
+        for (k = 0; k < rows / cols; k++)
+            transpose_square_recursive(data + k * cols * cols, cols, cols);
+        return transpose_cycles(data, rows / cols, cols, cols);
+    }
+
+    // A wide matrix made of k squares side by side:  the same steps in the
+    // opposite order.
+    if (transpose_cycles(data, rows, cols / rows, rows) != 0)
+        return -1;
+    for (k = 0; k < cols / rows; k++)
+        transpose_square_recursive(data + k * rows * rows, rows, rows);
+    return 0;
+}
+
+// Transpose any shape by splitting off as many whole squares as fit along
+// the longer side, and transposing them and the narrower remainder
+// separately, which repeats on the remainder as Euclid's algorithm does.
+//
+static int
+transpose_in_place_recursive(float *data, size_t rows, size_t cols, float *scratch)
+{
+    size_t whole, rest;
+
+    if (rows <= 1 || cols <= 1)
+        return 0;   // A vector has the same layout as its transpose.
+    if (rows % cols == 0 || cols % rows == 0)
+        return transpose_squares(data, rows, cols);
+
+    if (cols > rows)
+    {
+        // Each row is a run of whole squares and a run of the rest.  Gather
+        // the squares ahead of the rest, after which the transposes of the
+        // two are the top and bottom rows of the result.
+        whole = cols - cols % rows;
+        rest = cols - whole;
+        gather_rows(data, rows, whole, rest, scratch);
+        if (transpose_squares(data, rows, whole) != 0)
+            return -1;
+        return transpose_in_place_recursive(data + rows * whole, rows, rest, scratch);
+    }
+
+    // The top rows are whole squares and the bottom rows the rest; their
+    // transposes are the left and right of each row of the result.
+    whole = rows - rows % cols;
+    rest = rows - whole;
+    if (transpose_squares(data, whole, cols) != 0 ||
+        transpose_in_place_recursive(data + whole * cols, rest, cols, scratch) != 0)
+        return -1;
+    scatter_rows(data, cols, whole, rest, scratch);
+    return 0;
+}
+
+int
+transpose_cpu_in_place(float *data, size_t rows, size_t cols)
+{
+    float *scratch;
+    int status;
+
+    if (rows <= 1 || cols <= 1)
+        return 0;   // A vector has the same layout as its transpose.
+    if (rows % cols == 0 || cols % rows == 0)
+        return transpose_squares(data, rows, cols);
+
+    scratch = malloc(SCRATCH_COUNT * sizeof *scratch);
+    if (!scratch)
+        return -1;
+    status = transpose_in_place_recursive(data, rows, cols, scratch);
+    free(scratch);
+    return status;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void
+transpose_cpu_batch(
+    float *dst, size_t dst_matrix_stride,
+    const float *src, size_t src_matrix_stride,
+    size_t rows, size_t cols, size_t count)
+{
+    size_t k;
+
+    if (rows == 8 && cols == 8)
+    {
+        for (k = 0; k < count; k++)
+            transpose_8x8(dst + k * dst_matrix_stride, 8, src + k * src_matrix_stride, 8);
+    }
+    else if (rows == 4 && cols == 4)
+    {
+        for (k = 0; k < count; k++)
+            transpose_4x4(dst + k * dst_matrix_stride, 4, src + k * src_matrix_stride, 4);
+    }
+    else if (rows <= LEAF_DIM && cols <= LEAF_DIM)
+    {
+        for (k = 0; k < count; k++)
+            transpose_leaf(dst + k * dst_matrix_stride, rows,
+                           src + k * src_matrix_stride, cols, rows, cols);
+    }
+    else
+    {
+        for (k = 0; k < count; k++)
+            transpose_cpu(dst + k * dst_matrix_stride, rows,
+                          src + k * src_matrix_stride, cols, rows, cols);
+    }
+}
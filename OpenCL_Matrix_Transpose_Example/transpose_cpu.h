@@ -0,0 +1,116 @@
+//
+// File:       transpose_cpu.h
+//
+// Abstract:   Declares a CPU matrix transpose library for matrices of any size:  a cache-
+//             oblivious recursive out-of-place transpose, an in-place transpose for square and
+//             non-square matrices, and a batched transpose for many small matrices.
+//
+//             All routines operate on row-major single-precision matrices.  The innermost work is
+//             done by 8x8 register-block micro-kernels using AVX, SSE or NEON when available.
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __TRANSPOSE_CPU_H__
+#define __TRANSPOSE_CPU_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Transpose the rows x cols matrix src into the cols x rows matrix dst.
+// Strides are in elements between the starts of consecutive rows, so either
+// matrix may be a sub-matrix of a larger (or padded) one.  src and dst must
+// not overlap.
+//
+// The matrix is moved in squares of up to 256 x 256 elements, each copied a
+// row at a time into place in dst and transposed there while it is in the
+// second-level cache, so both matrices are read and written in runs of up to
+// a kilobyte whatever their strides.  What is too narrow for a square is split
+// recursively along its longer dimension until the pieces fit in the
+// first-level cache.
+//
+void transpose_cpu(
+    float *dst, size_t dst_stride,
+    const float *src, size_t src_stride,
+    size_t rows, size_t cols);
+
+// Transpose the rows x cols matrix in data, stored without padding, in place.
+// Afterwards data holds the cols x rows transpose, also without padding.
+//
+// Square matrices are transposed by swapping blocks across the diagonal.
+// Matrices made of whole squares stacked vertically or side by side (one
+// dimension a multiple of the other, as in most FFT corner turns) transpose
+// each square that way and then permute whole rows of the squares.  Other
+// shapes are split into the whole squares that fit along the longer side and
+// a narrower remainder, whose rows are gathered apart from those of the
+// squares by rotations; the remainder is split the same way in turn, as in
+// Euclid's algorithm.  Non-square shapes need a scratch bitmap of one bit per
+// row of squares, and other shapes 64KB of scratch as well, instead of a full
+// copy.
+//
+// Returns 0 on success, or -1 if the scratch could not be allocated.
+//
+int transpose_cpu_in_place(float *data, size_t rows, size_t cols);
+
+// Transpose count rows x cols matrices, each stored without padding, with
+// consecutive matrices src_matrix_stride and dst_matrix_stride elements apart.
+// 4x4 and 8x8 matrices go straight to the micro-kernels, without any of
+// the per-call overhead of the general routine.
+//
+void transpose_cpu_batch(
+    float *dst, size_t dst_matrix_stride,
+    const float *src, size_t src_matrix_stride,
+    size_t rows, size_t cols, size_t count);
+
+/////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TRANSPOSE_CPU_H__
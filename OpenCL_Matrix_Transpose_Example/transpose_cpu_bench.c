@@ -0,0 +1,268 @@
+//
+// File:       transpose_cpu_bench.c
+//
+// Abstract:   Validates and times the CPU transpose library in transpose_cpu.c against a naive
+//             transpose, and reports its bandwidth next to that of memcpy moving the same number
+//             of bytes, which is the practical upper bound for any transpose.
+//
+//             This program uses only standard C and builds on any platform, for example:
+//
+//                 cc -O3 -march=native -std=gnu99 -o transpose_cpu_bench transpose_cpu_bench.c
+//             transpose_cpu.c
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "transpose_cpu.h"
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Minimum time to spend timing each case, in seconds.
+static const double min_seconds = 0.25;
+
+/////////////////////////////////////////////////////////////////////////////
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static void
+fill(float *data, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+        data[i] = (float) i;
+}
+
+static int
+check(const float *dst, const float *src, size_t rows, size_t cols)
+{
+    size_t i, j;
+    for (i = 0; i < rows; i++)
+        for (j = 0; j < cols; j++)
+            if (dst[j * rows + i] != src[i * cols + j])
+                return 0;
+    return 1;
+}
+
+// Report GB/s for moving bytes (read once and written once) per call.
+static void
+report(const char *name, size_t rows, size_t cols, size_t bytes, double t, double copy)
+{
+    double rate = 2e-9 * bytes / t;
+    printf("    %-22s [%6lu x %-6lu] %8.2f GB/sec (%3.0f%% of memcpy)\n",
+           name, (unsigned long) rows, (unsigned long) cols, rate, 100.0 * rate / copy);
+}
+
+static double
+time_memcpy(float *dst, const float *src, size_t bytes)
+{
+    int iterations = 0;
+    double t0 = now(), t;
+    do
+    {
+        memcpy(dst, src, bytes);
+        iterations++;
+    } while ((t = now() - t0) < min_seconds);
+    return 2e-9 * bytes * iterations / t;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+static int
+bench_out_of_place(size_t rows, size_t cols)
+{
+    size_t count = rows * cols, bytes = count * sizeof(float);
+    float *src = malloc(bytes), *dst = malloc(bytes);
+    double copy, t0, t;
+    int iterations = 0, ok;
+
+    if (!src || !dst)
+        return 0;
+    fill(src, count);
+
+    copy = time_memcpy(dst, src, bytes);
+
+    transpose_cpu(dst, rows, src, cols, rows, cols);
+    ok = check(dst, src, rows, cols);
+
+    t0 = now();
+    do
+    {
+        transpose_cpu(dst, rows, src, cols, rows, cols);
+        iterations++;
+    } while ((t = now() - t0) < min_seconds);
+
+    report("out-of-place", rows, cols, bytes, t / iterations, copy);
+
+    free(src);
+    free(dst);
+    return ok;
+}
+
+static int
+bench_in_place(size_t rows, size_t cols)
+{
+    size_t count = rows * cols, bytes = count * sizeof(float);
+    float *src = malloc(bytes), *data = malloc(bytes);
+    double copy, t0, t;
+    int iterations = 0, ok;
+
+    if (!src || !data)
+        return 0;
+    fill(src, count);
+    memcpy(data, src, bytes);
+
+    copy = time_memcpy(data, src, bytes);
+
+    memcpy(data, src, bytes);
+    ok = transpose_cpu_in_place(data, rows, cols) == 0 && check(data, src, rows, cols);
+
+    // Alternate between the matrix and its transpose so each pass has work to do.
+    t0 = now();
+    do
+    {
+        if (iterations & 1)
+            transpose_cpu_in_place(data, rows, cols);
+        else
+            transpose_cpu_in_place(data, cols, rows);
+        iterations++;
+    } while ((t = now() - t0) < min_seconds);
+
+    report("in-place", rows, cols, bytes, t / iterations, copy);
+
+    free(src);
+    free(data);
+    return ok;
+}
+
+static int
+bench_batch(size_t rows, size_t cols, size_t count)
+{
+    size_t elements = rows * cols, bytes = count * elements * sizeof(float);
+    float *src = malloc(bytes), *dst = malloc(bytes);
+    double copy, t0, t;
+    int iterations = 0, ok = 1;
+    size_t k;
+    char name[64];
+
+    if (!src || !dst)
+        return 0;
+    fill(src, count * elements);
+
+    copy = time_memcpy(dst, src, bytes);
+
+    transpose_cpu_batch(dst, elements, src, elements, rows, cols, count);
+    for (k = 0; k < count; k++)
+        ok &= check(dst + k * elements, src + k * elements, rows, cols);
+
+    t0 = now();
+    do
+    {
+        transpose_cpu_batch(dst, elements, src, elements, rows, cols, count);
+        iterations++;
+    } while ((t = now() - t0) < min_seconds);
+
+    snprintf(name, sizeof name, "batch of %lu", (unsigned long) count);
+    report(name, rows, cols, bytes, t / iterations, copy);
+
+    free(src);
+    free(dst);
+    return ok;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+    static const size_t shapes[][2] =
+    {
+        {  256, 4096 }, { 1024, 1024 }, { 4096, 4096 }, { 4096, 1000 },
+        { 1000, 4096 }, { 8192, 2048 }, { 3001, 2999 },
+    };
+    static const size_t in_place_shapes[][2] =
+    {
+        { 1024, 1024 }, { 4096, 4096 }, { 1000, 1000 }, { 256, 4096 }, { 4096, 256 },
+        { 1000, 3000 }, { 1000, 3001 },
+    };
+    static const size_t batch_shapes[][3] =
+    {
+        { 4, 4, 1 << 16 }, { 8, 8, 1 << 16 }, { 16, 16, 1 << 14 }, { 12, 20, 1 << 14 },
+        { 64, 64, 1 << 10 },
+    };
+    size_t i;
+    int ok = 1;
+
+    (void) argc;
+    (void) argv;
+
+    printf("Out-of-place transpose:\n");
+    for (i = 0; i < sizeof shapes / sizeof *shapes; i++)
+        ok &= bench_out_of_place(shapes[i][0], shapes[i][1]);
+
+    printf("In-place transpose:\n");
+    for (i = 0; i < sizeof in_place_shapes / sizeof *in_place_shapes; i++)
+        ok &= bench_in_place(in_place_shapes[i][0], in_place_shapes[i][1]);
+
+    printf("Batched transpose:\n");
+    for (i = 0; i < sizeof batch_shapes / sizeof *batch_shapes; i++)
+        ok &= bench_batch(batch_shapes[i][0], batch_shapes[i][1], batch_shapes[i][2]);
+
+    if (!ok)
+    {
+        printf("Error:  Incorrect results obtained!\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("Results Validated!\n");
+    return 0;
+}
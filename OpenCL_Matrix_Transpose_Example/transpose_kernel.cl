@@ -146,4 +146,50 @@ __kernel void transpose(
 	output[output_index] = tile[local_output]; local_output += local_output_stride; output_index += global_output_stride;
 	output[output_index] = tile[local_output]; 
 	
-}
\ No newline at end of file
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The same tiling as transpose(), but with the matrix dimensions and the row
+// stride of the (padded) output passed at run time instead of being compiled
+// in, so one program serves any matrix size.  Work-groups along the right and
+// bottom edges of matrices whose dimensions are not multiples of GROUP_DIMX
+// skip the elements that fall outside the matrix.  Global indices are computed
+// at full width since large matrices overflow the 24-bit range of mad24.
+//
+__kernel void transpose_sized(
+    __global float *output,
+    __global const float *input,
+    __local float *tile,
+    const uint width,
+    const uint height,
+    const uint output_stride)
+{
+    uint block_x = get_group_id(0);
+    uint block_y = get_group_id(1);
+
+    uint local_x = get_local_id(0) & (GROUP_DIMX - 1);
+    uint local_y = get_local_id(0) >> LOG_GROUP_DIMX;
+
+    uint in_x  = block_x * GROUP_DIMX + local_x;
+    uint in_y  = block_y * GROUP_DIMX + local_y;
+    uint out_x = block_y * GROUP_DIMX + local_x;
+    uint out_y = block_x * GROUP_DIMX + local_y;
+
+    uint i;
+    for (i = 0; i < GROUP_DIMX; i += GROUP_DIMY)
+    {
+        if (in_x < width && in_y + i < height)
+            tile[mad24(local_y + i, GROUP_DIMX + 1, local_x)] =
+                input[(size_t) (in_y + i) * width + in_x];
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (i = 0; i < GROUP_DIMX; i += GROUP_DIMY)
+    {
+        if (out_x < height && out_y + i < width)
+            output[(size_t) (out_y + i) * output_stride + out_x] =
+                tile[mad24(local_x, GROUP_DIMX + 1, local_y + i)];
+    }
+}
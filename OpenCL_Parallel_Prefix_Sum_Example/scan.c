@@ -64,6 +64,8 @@
 
 #include <OpenCL/opencl.h>
 
+#include "scan_cpu.h"
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #define DEBUG_INFO      (0)
@@ -592,6 +594,69 @@ void ScanReference( float* reference, float* input, const unsigned int count)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+int ScanOnHost(float* input, const unsigned int count)
+{
+    int i;
+    uint64_t t1 = 0;
+    uint64_t t2 = 0;
+    size_t buffer_size = sizeof(float) * count;
+    float* result = (float*)malloc(buffer_size);
+    float* reference = (float*)malloc(buffer_size);
+
+    printf(SEPARATOR);
+    printf("Scanning on the host with the CPU scan library...\n");
+    printf(SEPARATOR);
+
+    // Scan with one thread per processor and SIMD within each thread
+    //
+    printf("Starting timing run of '%d' iterations...\n", iterations);
+
+    t1 = GetCurrentTime();
+    for (i = 0; i < iterations; i++)
+    {
+        if (scan_cpu(result, input, count, SCAN_CPU_FLOAT, SCAN_CPU_EXCLUSIVE, 0) != 0)
+        {
+            printf("Error: Failed to scan on the host!\n");
+            return EXIT_FAILURE;
+        }
+    }
+    t2 = GetCurrentTime();
+
+    // Calculate the statistics for execution time and throughput
+    //
+    double t = SubtractTimeInSec(t2, t1);
+    printf("Exec Time:  %.2f ms\n", 1000.0 * t / (double)(iterations));
+    printf("Throughput: %.2f GB/sec\n", 1e-9 * buffer_size * iterations / t);
+    printf(SEPARATOR);
+
+    // Verify the results are correct
+    //
+    ScanReference(reference, input, count);
+
+    float error = 0.0f;
+    float diff = 0.0f;
+    for(i = 0; i < count; i++)
+    {
+        diff = fabs(reference[i] - result[i]);
+        error = diff > error ? diff : error;
+    }
+
+    free(reference);
+    free(result);
+
+    if (error > MAX_ERROR)
+    {
+        printf("Error:   Incorrect results obtained! Max error = %f\n", error);
+        return EXIT_FAILURE;
+    }
+
+    printf("Results Validated!\n");
+    printf(SEPARATOR);
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 int main(int argc, char **argv)
 {
     int i;
@@ -610,13 +675,32 @@ int main(int argc, char **argv)
         float_data[i] = (int)(10 * ((float) rand() / (float) RAND_MAX));
     }
 
-    // Connect to a GPU compute device
+    // Run "scan host" to scan on the host with the CPU library instead of a GPU
     //
-    err = clGetDeviceIDs(NULL, CL_DEVICE_TYPE_GPU, 1, &ComputeDeviceId, NULL);
-    if (err != CL_SUCCESS)
+    bool use_host = false;
+    for (i = 1; i < argc; i++)
     {
-        printf("Error: Failed to locate a compute device!\n");
-        return EXIT_FAILURE;
+        if (strstr(argv[i], "host"))
+            use_host = true;
+    }
+
+    // Connect to a GPU compute device, falling back to the host if there is none
+    //
+    if (!use_host)
+    {
+        err = clGetDeviceIDs(NULL, CL_DEVICE_TYPE_GPU, 1, &ComputeDeviceId, NULL);
+        if (err != CL_SUCCESS)
+        {
+            printf("Warning: Failed to locate a GPU compute device!  Scanning on the host instead.\n");
+            use_host = true;
+        }
+    }
+
+    if (use_host)
+    {
+        err = ScanOnHost(float_data, count);
+        free(float_data);
+        return err;
     }
 
     size_t returned_size = 0;
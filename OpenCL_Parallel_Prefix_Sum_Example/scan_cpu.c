@@ -0,0 +1,761 @@
+//
+// File:       scan_cpu.c
+//
+// Abstract:   A multi-threaded CPU scan (prefix sum) library for int and float data of one, two
+//             or four channels, with inclusive, exclusive and segmented scans.  See scan_cpu.h.
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "scan_cpu.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Size of the tiles handed to threads.  A thread reads its tile once to find
+// the tile's total and again to scan it, so the tile should stay in the
+// second-level cache in between.
+#define TILE_BYTES              (64 * 1024)
+
+// Inputs smaller than this are scanned by the calling thread alone; starting
+// threads would cost more than it saves.
+#define MIN_THREADED_BYTES      (256 * 1024)
+
+#define MAX_THREADS             (64)
+
+// How long to spin on a tile that has not published its total yet before
+// giving up the processor to the thread that is working on it.
+#define SPINS_BEFORE_YIELD      (256)
+
+#define ALWAYS_INLINE           static inline __attribute__((always_inline))
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Four 32-bit lanes holding int or float values.  A vector holds four int or
+// float elements, two int2 or float2 elements or one int4 or float4 element,
+// so lane i always holds channel (i % channels).
+//
+// Running totals ("carries") are kept broadcast to every element of a vector,
+// e.g. (x, y, x, y) for two channels, so they can be added to whole vectors.
+
+#if defined(__SSE2__)
+
+typedef __m128 vec4;
+
+ALWAYS_INLINE vec4 v_load(const void *p)        { return _mm_loadu_ps((const float *) p); }
+ALWAYS_INLINE void v_store(void *p, vec4 a)     { _mm_storeu_ps((float *) p, a); }
+ALWAYS_INLINE vec4 v_zero(void)                 { return _mm_setzero_ps(); }
+ALWAYS_INLINE vec4 v_or(vec4 a, vec4 b)         { return _mm_or_ps(a, b); }
+ALWAYS_INLINE vec4 v_andnot(vec4 m, vec4 a)     { return _mm_andnot_ps(m, a); }
+ALWAYS_INLINE void v_pause(void)                { _mm_pause(); }
+
+ALWAYS_INLINE vec4
+v_add(vec4 a, vec4 b, int integer)
+{
+    if (integer)
+        return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(a), _mm_castps_si128(b)));
+    return _mm_add_ps(a, b);
+}
+
+// Move lane i to lane i + n, shifting in zeros.
+ALWAYS_INLINE vec4
+v_shift(vec4 a, int n)
+{
+    return _mm_castsi128_ps(n == 1 ? _mm_slli_si128(_mm_castps_si128(a), 4) :
+                                     _mm_slli_si128(_mm_castps_si128(a), 8));
+}
+
+// Broadcast the last element of a.
+ALWAYS_INLINE vec4
+v_last(vec4 a, int channels)
+{
+    if (channels == 1)
+        return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3));
+    if (channels == 2)
+        return _mm_movehl_ps(a, a);
+    return a;
+}
+
+// Shift a up by one element, shifting in the last element of the broadcast c.
+ALWAYS_INLINE vec4
+v_shift_in(vec4 a, vec4 c, int channels)
+{
+    if (channels == 1)
+        return _mm_move_ss(v_shift(a, 1), c);
+    if (channels == 2)
+        return _mm_shuffle_ps(c, a, _MM_SHUFFLE(1, 0, 1, 0));
+    return c;
+}
+
+ALWAYS_INLINE vec4 v_swap_halves(vec4 a)        { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2)); }
+ALWAYS_INLINE vec4 v_swap_pairs(vec4 a)         { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)); }
+
+// All ones in the lanes of elements whose head byte is set.
+ALWAYS_INLINE vec4
+v_heads(const unsigned char *heads, int channels)
+{
+    __m128i zero = _mm_setzero_si128(), m;
+    if (channels == 1)
+    {
+        int bytes;
+        memcpy(&bytes, heads, sizeof(bytes));
+        m = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+        return _mm_castsi128_ps(_mm_cmpgt_epi32(m, zero));
+    }
+    if (channels == 2)
+        m = _mm_set_epi32(-!!heads[1], -!!heads[1], -!!heads[0], -!!heads[0]);
+    else
+        m = _mm_set1_epi32(-!!heads[0]);
+    return _mm_castsi128_ps(m);
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+typedef float32x4_t vec4;
+
+#define U32(a)                  vreinterpretq_u32_f32(a)
+#define F32(a)                  vreinterpretq_f32_u32(a)
+
+ALWAYS_INLINE vec4 v_load(const void *p)        { return vld1q_f32((const float *) p); }
+ALWAYS_INLINE void v_store(void *p, vec4 a)     { vst1q_f32((float *) p, a); }
+ALWAYS_INLINE vec4 v_zero(void)                 { return vdupq_n_f32(0.0f); }
+ALWAYS_INLINE vec4 v_or(vec4 a, vec4 b)         { return F32(vorrq_u32(U32(a), U32(b))); }
+ALWAYS_INLINE vec4 v_andnot(vec4 m, vec4 a)     { return F32(vbicq_u32(U32(a), U32(m))); }
+ALWAYS_INLINE void v_pause(void)                { }
+
+ALWAYS_INLINE vec4
+v_add(vec4 a, vec4 b, int integer)
+{
+    if (integer)
+        return F32(vaddq_u32(U32(a), U32(b)));
+    return vaddq_f32(a, b);
+}
+
+ALWAYS_INLINE vec4
+v_shift(vec4 a, int n)
+{
+    return n == 1 ? vextq_f32(v_zero(), a, 3) : vextq_f32(v_zero(), a, 2);
+}
+
+ALWAYS_INLINE vec4
+v_last(vec4 a, int channels)
+{
+    if (channels == 1)
+        return vdupq_n_f32(vgetq_lane_f32(a, 3));
+    if (channels == 2)
+        return vcombine_f32(vget_high_f32(a), vget_high_f32(a));
+    return a;
+}
+
+ALWAYS_INLINE vec4
+v_shift_in(vec4 a, vec4 c, int channels)
+{
+    if (channels == 1)
+        return vextq_f32(c, a, 3);
+    if (channels == 2)
+        return vextq_f32(c, a, 2);
+    return c;
+}
+
+ALWAYS_INLINE vec4 v_swap_halves(vec4 a)        { return vcombine_f32(vget_high_f32(a), vget_low_f32(a)); }
+ALWAYS_INLINE vec4 v_swap_pairs(vec4 a)         { return vrev64q_f32(a); }
+
+ALWAYS_INLINE vec4
+v_heads(const unsigned char *heads, int channels)
+{
+    int i;
+    uint32_t m[4];
+    for (i = 0; i < 4; i++)
+        m[i] = heads[i / channels] ? 0xFFFFFFFFu : 0u;
+    return F32(vld1q_u32(m));
+}
+
+#else
+
+typedef struct { uint32_t u[4]; } vec4;
+
+ALWAYS_INLINE vec4 v_load(const void *p)        { vec4 a; memcpy(a.u, p, sizeof(a.u)); return a; }
+ALWAYS_INLINE void v_store(void *p, vec4 a)     { memcpy(p, a.u, sizeof(a.u)); }
+ALWAYS_INLINE vec4 v_zero(void)                 { vec4 a = { { 0, 0, 0, 0 } }; return a; }
+ALWAYS_INLINE void v_pause(void)                { }
+
+ALWAYS_INLINE vec4
+v_or(vec4 a, vec4 b)
+{
+    int i;
+    for (i = 0; i < 4; i++)
+        a.u[i] |= b.u[i];
+    return a;
+}
+
+ALWAYS_INLINE vec4
+v_andnot(vec4 m, vec4 a)
+{
+    int i;
+    for (i = 0; i < 4; i++)
+        a.u[i] &= ~m.u[i];
+    return a;
+}
+
+ALWAYS_INLINE vec4
+v_add(vec4 a, vec4 b, int integer)
+{
+    int i;
+    for (i = 0; i < 4; i++)
+    {
+        if (integer)
+        {
+            a.u[i] += b.u[i];
+        }
+        else
+        {
+            float x, y;
+            memcpy(&x, &a.u[i], sizeof(x));
+            memcpy(&y, &b.u[i], sizeof(y));
+            x += y;
+            memcpy(&a.u[i], &x, sizeof(x));
+        }
+    }
+    return a;
+}
+
+ALWAYS_INLINE vec4
+v_shift(vec4 a, int n)
+{
+    vec4 r = v_zero();
+    int i;
+    for (i = n; i < 4; i++)
+        r.u[i] = a.u[i - n];
+    return r;
+}
+
+ALWAYS_INLINE vec4
+v_last(vec4 a, int channels)
+{
+    vec4 r;
+    int i;
+    for (i = 0; i < 4; i++)
+        r.u[i] = a.u[4 - channels + i % channels];
+    return r;
+}
+
+ALWAYS_INLINE vec4
+v_shift_in(vec4 a, vec4 c, int channels)
+{
+    vec4 r;
+    int i;
+    for (i = 0; i < 4; i++)
+        r.u[i] = i < channels ? c.u[i] : a.u[i - channels];
+    return r;
+}
+
+ALWAYS_INLINE vec4 v_swap_halves(vec4 a)        { vec4 r = { { a.u[2], a.u[3], a.u[0], a.u[1] } }; return r; }
+ALWAYS_INLINE vec4 v_swap_pairs(vec4 a)         { vec4 r = { { a.u[1], a.u[0], a.u[3], a.u[2] } }; return r; }
+
+ALWAYS_INLINE vec4
+v_heads(const unsigned char *heads, int channels)
+{
+    vec4 r;
+    int i;
+    for (i = 0; i < 4; i++)
+        r.u[i] = heads[i / channels] ? 0xFFFFFFFFu : 0u;
+    return r;
+}
+
+#endif
+
+// Broadcast the sum of the elements of a.
+ALWAYS_INLINE vec4
+v_fold(vec4 a, int channels, int integer)
+{
+    if (channels <= 2)
+        a = v_add(a, v_swap_halves(a), integer);
+    if (channels == 1)
+        a = v_add(a, v_swap_pairs(a), integer);
+    return a;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Inclusive scan of the elements within one vector.
+ALWAYS_INLINE vec4
+scan_vector(vec4 a, int channels, int integer)
+{
+    if (channels == 1)
+        a = v_add(a, v_shift(a, 1), integer);
+    if (channels <= 2)
+        a = v_add(a, v_shift(a, 2), integer);
+    return a;
+}
+
+// Segmented inclusive scan of the elements within one vector, where heads
+// marks the lanes of elements that start a segment.  On return heads marks
+// every lane at or after a head.
+ALWAYS_INLINE vec4
+scan_vector_segmented(vec4 a, vec4 *heads, int channels, int integer)
+{
+    vec4 f = *heads;
+    if (channels == 1)
+    {
+        a = v_add(a, v_andnot(f, v_shift(a, 1)), integer);
+        f = v_or(f, v_shift(f, 1));
+    }
+    if (channels <= 2)
+    {
+        a = v_add(a, v_andnot(f, v_shift(a, 2)), integer);
+        f = v_or(f, v_shift(f, 2));
+    }
+    *heads = f;
+    return a;
+}
+
+// Scan one vector at in to out, given the running total before it, and
+// return the running total after it.
+ALWAYS_INLINE vec4
+scan_step(void *out, const void *in, const unsigned char *heads, vec4 carry,
+          int integer, int channels, int inclusive, int segmented)
+{
+    vec4 r;
+    if (segmented)
+    {
+        vec4 f = v_heads(heads, channels), after = f;
+        r = scan_vector_segmented(v_load(in), &after, channels, integer);
+        r = v_add(r, v_andnot(after, carry), integer);
+        v_store(out, inclusive ? r : v_andnot(f, v_shift_in(r, carry, channels)));
+    }
+    else
+    {
+        r = v_add(scan_vector(v_load(in), channels, integer), carry, integer);
+        v_store(out, inclusive ? r : v_shift_in(r, carry, channels));
+    }
+    return v_last(r, channels);
+}
+
+// Scan count elements from in to out, starting from the running total carry,
+// and return the running total after the last element.
+ALWAYS_INLINE vec4
+scan_block(char *out, const char *in, const unsigned char *heads, size_t count, vec4 carry,
+           int integer, int channels, int inclusive, int segmented)
+{
+    const size_t per_vector = 4 / channels;
+    const size_t vectors = count / per_vector;
+    const size_t tail = count - vectors * per_vector;
+    size_t i = 0;
+
+    // Without segments, scan four vectors independently and then add each
+    // one's total, which keeps the chain of dependent additions short.
+    if (!segmented)
+    {
+        for (; i + 4 <= vectors; i += 4)
+        {
+            vec4 s0 = scan_vector(v_load(in + 16 * (i + 0)), channels, integer);
+            vec4 s1 = scan_vector(v_load(in + 16 * (i + 1)), channels, integer);
+            vec4 s2 = scan_vector(v_load(in + 16 * (i + 2)), channels, integer);
+            vec4 s3 = scan_vector(v_load(in + 16 * (i + 3)), channels, integer);
+
+            vec4 t01  = v_add(v_last(s0, channels), v_last(s1, channels), integer);
+            vec4 t012 = v_add(t01, v_last(s2, channels), integer);
+            vec4 c1   = v_add(carry, v_last(s0, channels), integer);
+            vec4 c2   = v_add(carry, t01, integer);
+            vec4 c3   = v_add(carry, t012, integer);
+
+            vec4 r0 = v_add(s0, carry, integer);
+            vec4 r1 = v_add(s1, c1, integer);
+            vec4 r2 = v_add(s2, c2, integer);
+            vec4 r3 = v_add(s3, c3, integer);
+
+            v_store(out + 16 * (i + 0), inclusive ? r0 : v_shift_in(r0, carry, channels));
+            v_store(out + 16 * (i + 1), inclusive ? r1 : v_shift_in(r1, c1, channels));
+            v_store(out + 16 * (i + 2), inclusive ? r2 : v_shift_in(r2, c2, channels));
+            v_store(out + 16 * (i + 3), inclusive ? r3 : v_shift_in(r3, c3, channels));
+
+            carry = v_add(carry, v_add(t012, v_last(s3, channels), integer), integer);
+        }
+    }
+
+    for (; i < vectors; i++)
+        carry = scan_step(out + 16 * i, in + 16 * i, segmented ? heads + i * per_vector : NULL,
+                          carry, integer, channels, inclusive, segmented);
+
+    // Pad the last partial vector with zeros, which cannot change the
+    // results of the elements before them.
+    if (tail)
+    {
+        uint32_t buffer[4] = { 0, 0, 0, 0 };
+        unsigned char head_buffer[4] = { 0, 0, 0, 0 };
+        memcpy(buffer, in + 16 * vectors, tail * channels * 4);
+        if (segmented)
+            memcpy(head_buffer, heads + vectors * per_vector, tail);
+        carry = scan_step(buffer, buffer, head_buffer, carry, integer, channels, inclusive, segmented);
+        memcpy(out + 16 * vectors, buffer, tail * channels * 4);
+    }
+    return carry;
+}
+
+// Return the sum of count elements, broadcast.
+ALWAYS_INLINE vec4
+sum_block(const char *in, size_t count, int integer, int channels)
+{
+    const size_t per_vector = 4 / channels;
+    const size_t vectors = count / per_vector;
+    const size_t tail = count - vectors * per_vector;
+    vec4 a0 = v_zero(), a1 = v_zero(), a2 = v_zero(), a3 = v_zero();
+    size_t i = 0;
+
+    for (; i + 4 <= vectors; i += 4)
+    {
+        a0 = v_add(a0, v_load(in + 16 * (i + 0)), integer);
+        a1 = v_add(a1, v_load(in + 16 * (i + 1)), integer);
+        a2 = v_add(a2, v_load(in + 16 * (i + 2)), integer);
+        a3 = v_add(a3, v_load(in + 16 * (i + 3)), integer);
+    }
+    for (; i < vectors; i++)
+        a0 = v_add(a0, v_load(in + 16 * i), integer);
+    if (tail)
+    {
+        uint32_t buffer[4] = { 0, 0, 0, 0 };
+        memcpy(buffer, in + 16 * vectors, tail * channels * 4);
+        a1 = v_add(a1, v_load(buffer), integer);
+    }
+
+    a0 = v_add(v_add(a0, a1, integer), v_add(a2, a3, integer), integer);
+    return v_fold(a0, channels, integer);
+}
+
+// Specialize the kernels for each element type, so that the type and mode
+// tests above are resolved at compile time.
+#define SCAN_KERNELS(name, integer, channels)                                                   \
+    static vec4                                                                                 \
+    name##_scan(char *out, const char *in, const unsigned char *heads, size_t count,           \
+                vec4 carry, int inclusive, int segmented)                                       \
+    {                                                                                           \
+        if (segmented)                                                                          \
+            return inclusive ? scan_block(out, in, heads, count, carry, integer, channels, 1, 1) \
+                             : scan_block(out, in, heads, count, carry, integer, channels, 0, 1); \
+        return inclusive ? scan_block(out, in, heads, count, carry, integer, channels, 1, 0)     \
+                         : scan_block(out, in, heads, count, carry, integer, channels, 0, 0);    \
+    }                                                                                           \
+    static vec4                                                                                 \
+    name##_sum(const char *in, size_t count)                                                    \
+    {                                                                                           \
+        return sum_block(in, count, integer, channels);                                         \
+    }
+
+SCAN_KERNELS(int1,   1, 1)
+SCAN_KERNELS(int2,   1, 2)
+SCAN_KERNELS(int4,   1, 4)
+SCAN_KERNELS(float1, 0, 1)
+SCAN_KERNELS(float2, 0, 2)
+SCAN_KERNELS(float4, 0, 4)
+
+typedef struct
+{
+    vec4 (*scan)(char *out, const char *in, const unsigned char *heads, size_t count,
+                 vec4 carry, int inclusive, int segmented);
+    vec4 (*sum)(const char *in, size_t count);
+    int  integer;
+    int  channels;
+} scan_kernels;
+
+// Indexed by scan_cpu_type.
+static const scan_kernels kernels[] =
+{
+    { int1_scan,   int1_sum,   1, 1 },
+    { int2_scan,   int2_sum,   1, 2 },
+    { int4_scan,   int4_sum,   1, 4 },
+    { float1_scan, float1_sum, 0, 1 },
+    { float2_scan, float2_sum, 0, 2 },
+    { float4_scan, float4_sum, 0, 4 },
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Tiles publish their totals for the tiles after them.  TILE_AGGREGATE means
+// aggregate holds the total of the tile's own elements; TILE_PREFIX means
+// prefix holds the running total up to and including the tile, so tiles
+// further on need look no further back.
+enum
+{
+    TILE_EMPTY,
+    TILE_AGGREGATE,
+    TILE_PREFIX
+};
+
+typedef struct
+{
+    vec4            aggregate;
+    vec4            prefix;
+    volatile int    status;
+    char            padding[64 - 2 * sizeof(vec4) - sizeof(int)];
+} tile_state;
+
+typedef struct
+{
+    char                    *output;
+    const char              *input;
+    const unsigned char     *heads;
+    size_t                  count;
+    size_t                  element_size;
+    size_t                  tile_elements;
+    size_t                  tile_count;
+    const scan_kernels      *kernels;
+    int                     inclusive;
+    tile_state              *tiles;
+    volatile long           next_tile;
+} scan_job;
+
+static void
+publish(tile_state *tile, vec4 value, int status)
+{
+    if (status == TILE_PREFIX)
+        tile->prefix = value;
+    else
+        tile->aggregate = value;
+    __sync_synchronize();
+    tile->status = status;
+}
+
+// Index of the last head in heads[0..count), or count if there is none.
+static size_t
+last_head(const unsigned char *heads, size_t count)
+{
+    size_t i = count;
+    uint64_t word;
+
+    while (i >= sizeof(word))
+    {
+        memcpy(&word, heads + i - sizeof(word), sizeof(word));
+        if (word)
+            break;
+        i -= sizeof(word);
+    }
+    while (i > 0)
+        if (heads[--i])
+            return i;
+    return count;
+}
+
+// Add up the totals of the tiles before tile, walking back until a tile with
+// a running total (or one that starts a new segment) is found.  Tiles that
+// are still being read are waited for; they are already owned by running
+// threads, since tiles are handed out in order.
+static vec4
+look_back(scan_job *job, size_t tile)
+{
+    vec4 total = v_zero();
+    int integer = job->kernels->integer;
+
+    while (tile-- > 0)
+    {
+        tile_state *state = &job->tiles[tile];
+        int status, spins = 0;
+
+        while ((status = state->status) == TILE_EMPTY)
+        {
+            v_pause();
+            if (++spins == SPINS_BEFORE_YIELD)
+            {
+                sched_yield();
+                spins = 0;
+            }
+        }
+        __sync_synchronize();
+
+        if (status == TILE_PREFIX)
+            return v_add(state->prefix, total, integer);
+        total = v_add(state->aggregate, total, integer);
+    }
+    return total;
+}
+
+static void
+scan_tile(scan_job *job, size_t tile)
+{
+    const scan_kernels *k = job->kernels;
+    size_t begin = tile * job->tile_elements;
+    size_t count = job->count - begin < job->tile_elements ? job->count - begin : job->tile_elements;
+    const char *in = job->input + begin * job->element_size;
+    const unsigned char *heads = job->heads ? job->heads + begin : NULL;
+    size_t first = 0;
+    int restarts = 0;
+    vec4 carry = v_zero(), total;
+
+    // A tile with a head only adds up the elements after its last head, and
+    // that is also the running total, so it can be published as such at once.
+    if (heads)
+    {
+        first = last_head(heads, count);
+        restarts = first < count;
+        if (!restarts)
+            first = 0;
+    }
+    total = k->sum(in + first * job->element_size, count - first);
+
+    if (tile == 0 || restarts)
+    {
+        publish(&job->tiles[tile], total, TILE_PREFIX);
+        if (tile > 0)
+            carry = look_back(job, tile);
+    }
+    else
+    {
+        publish(&job->tiles[tile], total, TILE_AGGREGATE);
+        carry = look_back(job, tile);
+        publish(&job->tiles[tile], v_add(carry, total, k->integer), TILE_PREFIX);
+    }
+
+    k->scan(job->output + begin * job->element_size, in, heads, count, carry, job->inclusive, heads != NULL);
+}
+
+static void *
+scan_worker(void *arg)
+{
+    scan_job *job = arg;
+    size_t tile;
+
+    while ((tile = (size_t) __sync_fetch_and_add(&job->next_tile, 1)) < job->tile_count)
+        scan_tile(job, tile);
+    return NULL;
+}
+
+static int
+processor_count(void)
+{
+    static int count = 0;
+    if (!count)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        count = n > 0 ? (int) n : 1;
+    }
+    return count;
+}
+
+static int
+scan_any(void *output, const void *input, const unsigned char *heads, size_t count,
+         scan_cpu_type type, scan_cpu_mode mode, int threads)
+{
+    const scan_kernels *k;
+    pthread_t workers[MAX_THREADS];
+    scan_job job;
+    int i, started = 0;
+
+    if ((int) type < SCAN_CPU_INT || (int) type > SCAN_CPU_FLOAT4 ||
+        (mode != SCAN_CPU_EXCLUSIVE && mode != SCAN_CPU_INCLUSIVE))
+        return -1;
+    if (count == 0)
+        return 0;
+
+    k = &kernels[type];
+    memset(&job, 0, sizeof(job));
+    job.output = output;
+    job.input = input;
+    job.heads = heads;
+    job.count = count;
+    job.element_size = 4 * k->channels;
+    job.tile_elements = TILE_BYTES / job.element_size;
+    job.tile_count = (count + job.tile_elements - 1) / job.tile_elements;
+    job.kernels = k;
+    job.inclusive = mode == SCAN_CPU_INCLUSIVE;
+
+    if (count * job.element_size < MIN_THREADED_BYTES)
+        threads = 1;
+    else if (threads <= 0)
+        threads = processor_count();
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if ((size_t) threads > job.tile_count)
+        threads = (int) job.tile_count;
+
+    // One thread scans in a single pass, without reading each tile twice.
+    if (threads <= 1)
+    {
+        k->scan(output, input, heads, count, v_zero(), job.inclusive, heads != NULL);
+        return 0;
+    }
+
+    job.tiles = calloc(job.tile_count, sizeof(tile_state));
+    if (!job.tiles)
+        return -1;
+
+    for (i = 1; i < threads; i++)
+        if (pthread_create(&workers[started], NULL, scan_worker, &job) == 0)
+            started++;
+    scan_worker(&job);
+    for (i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+
+    free(job.tiles);
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int
+scan_cpu(
+    void *output, const void *input, size_t count,
+    scan_cpu_type type, scan_cpu_mode mode, int threads)
+{
+    return scan_any(output, input, NULL, count, type, mode, threads);
+}
+
+int
+scan_cpu_segmented(
+    void *output, const void *input, const unsigned char *heads, size_t count,
+    scan_cpu_type type, scan_cpu_mode mode, int threads)
+{
+    if (!heads)
+        return -1;
+    return scan_any(output, input, heads, count, type, mode, threads);
+}
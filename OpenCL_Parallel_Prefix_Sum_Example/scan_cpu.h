@@ -0,0 +1,121 @@
+//
+// File:       scan_cpu.h
+//
+// Abstract:   Declares a multi-threaded CPU scan (prefix sum) library:  inclusive and exclusive
+//             scans, and segmented scans which restart at the head of each segment, for int and
+//             float data of one, two or four channels (int, int2, int4, float, float2, float4).
+//
+//             Large inputs are split into tiles which threads scan in a single pass over memory,
+//             passing running totals between tiles with decoupled look-back.  Within a tile the
+//             work is done in registers using SSE or NEON when available.
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SCAN_CPU_H__
+#define __SCAN_CPU_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Element types.  Vector types are stored as interleaved channels, as with
+// the matching OpenCL types, and each channel is scanned independently.
+//
+typedef enum
+{
+    SCAN_CPU_INT,
+    SCAN_CPU_INT2,
+    SCAN_CPU_INT4,
+    SCAN_CPU_FLOAT,
+    SCAN_CPU_FLOAT2,
+    SCAN_CPU_FLOAT4
+} scan_cpu_type;
+
+// An exclusive scan writes the sum of the elements before each element,
+// starting from zero (as ScanReference() in scan.c does); an inclusive scan
+// also adds the element itself.
+//
+typedef enum
+{
+    SCAN_CPU_EXCLUSIVE,
+    SCAN_CPU_INCLUSIVE
+} scan_cpu_mode;
+
+// Scan count elements of the given type from input to output.  output may be
+// the same buffer as input, but the two must not otherwise overlap.  Integer
+// sums wrap around on overflow.
+//
+// threads is the most threads to use, counting the calling thread; 0 uses one
+// per online processor.  Inputs that fit comfortably in cache are always
+// scanned by the calling thread alone.  With more than one thread, float
+// results may differ between calls in the last bits, since the order in which
+// the totals of earlier tiles are added up depends on timing.
+//
+// Returns 0 on success, or -1 if the type or mode is invalid or the tile
+// state could not be allocated.
+//
+int scan_cpu(
+    void *output, const void *input, size_t count,
+    scan_cpu_type type, scan_cpu_mode mode, int threads);
+
+// Segmented scan.  heads holds one byte per element, and each non-zero byte
+// starts a new segment at that element, so the scan restarts from zero there
+// (the exclusive result at a head is zero).  The first element always starts
+// a segment.  Otherwise the same as scan_cpu().
+//
+int scan_cpu_segmented(
+    void *output, const void *input, const unsigned char *heads, size_t count,
+    scan_cpu_type type, scan_cpu_mode mode, int threads);
+
+/////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __SCAN_CPU_H__
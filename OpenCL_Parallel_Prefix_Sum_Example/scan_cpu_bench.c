@@ -0,0 +1,337 @@
+//
+// File:       scan_cpu_bench.c
+//
+// Abstract:   Validates the CPU scan library in scan_cpu.c against serial scans for every element
+//             type and mode, then times it for 1K to 1G elements and reports its bandwidth next to
+//             that of memcpy moving the same number of bytes, which is the practical upper bound
+//             for any scan.  Sizes that do not fit in three quarters of physical memory are skipped.
+//
+//             This program uses only standard C and POSIX threads and builds on any platform, for
+//             example:
+//
+//                 cc -O3 -march=native -std=gnu99 -o scan_cpu_bench scan_cpu_bench.c scan_cpu.c
+//             -lpthread
+//
+//             Usage:  scan_cpu_bench [max_elements [threads]]
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "scan_cpu.h"
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Minimum time to spend timing each case, in seconds.
+static const double min_seconds = 0.25;
+
+static const char *type_names[] = { "int", "int2", "int4", "float", "float2", "float4" };
+
+/////////////////////////////////////////////////////////////////////////////
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static int
+channels_of(scan_cpu_type type)
+{
+    static const int channels[] = { 1, 2, 4, 1, 2, 4 };
+    return channels[type];
+}
+
+static int
+is_integer(scan_cpu_type type)
+{
+    return type <= SCAN_CPU_INT4;
+}
+
+// Small whole numbers, so that float sums of up to a few million elements are
+// exact and can be compared bit for bit.  Ints also get large values, to
+// check that they wrap around the same way as the reference.
+static void
+fill(void *data, size_t values, int integer)
+{
+    size_t i;
+    for (i = 0; i < values; i++)
+    {
+        int v = rand() % 10;
+        if (integer)
+        {
+            if (rand() % 16 == 0)
+                v = (int) ((unsigned) rand() * 65599u);
+            ((int32_t *) data)[i] = v;
+        }
+        else
+        {
+            ((float *) data)[i] = (float) v;
+        }
+    }
+}
+
+static void
+fill_heads(unsigned char *heads, size_t count, int one_in)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+        heads[i] = rand() % one_in == 0;
+}
+
+static void
+reference_scan(void *output, const void *input, const unsigned char *heads, size_t count,
+               scan_cpu_type type, scan_cpu_mode mode)
+{
+    int c, channels = channels_of(type);
+    size_t i;
+
+    for (c = 0; c < channels; c++)
+    {
+        uint32_t isum = 0;
+        float fsum = 0.0f;
+        for (i = 0; i < count; i++)
+        {
+            size_t k = i * channels + c;
+            if (heads && heads[i])
+                isum = 0, fsum = 0.0f;
+            if (is_integer(type))
+            {
+                uint32_t v = ((const uint32_t *) input)[k];
+                ((uint32_t *) output)[k] = mode == SCAN_CPU_INCLUSIVE ? isum + v : isum;
+                isum += v;
+            }
+            else
+            {
+                float v = ((const float *) input)[k];
+                ((float *) output)[k] = mode == SCAN_CPU_INCLUSIVE ? fsum + v : fsum;
+                fsum += v;
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+static int
+validate(size_t count, int threads)
+{
+    int type, mode, segmented, ok = 1;
+
+    for (type = SCAN_CPU_INT; type <= SCAN_CPU_FLOAT4; type++)
+    {
+        size_t bytes = count * channels_of(type) * 4 + 16;
+        void *input = malloc(bytes), *output = malloc(bytes), *expected = malloc(bytes);
+        unsigned char *heads = malloc(count + 1);
+
+        fill(input, count * channels_of(type), is_integer(type));
+        fill_heads(heads, count, (type & 1) ? 3 : 1000);
+
+        for (mode = SCAN_CPU_EXCLUSIVE; mode <= SCAN_CPU_INCLUSIVE; mode++)
+        {
+            for (segmented = 0; segmented <= 1; segmented++)
+            {
+                const unsigned char *h = segmented ? heads : NULL;
+                int in_place, err;
+
+                reference_scan(expected, input, h, count, type, mode);
+
+                // Scan out of place, then in place on a copy of the input.
+                for (in_place = 0; in_place <= 1; in_place++)
+                {
+                    void *src = input;
+                    if (in_place)
+                        src = memcpy(output, input, count * channels_of(type) * 4);
+                    else
+                        memset(output, 0xCD, bytes);
+
+                    if (segmented)
+                        err = scan_cpu_segmented(output, src, h, count, type, mode, threads);
+                    else
+                        err = scan_cpu(output, src, count, type, mode, threads);
+
+                    if (err || memcmp(output, expected, count * channels_of(type) * 4) != 0)
+                    {
+                        printf("    FAILED: %s %s%s scan of %lu elements with %d threads%s\n",
+                               mode == SCAN_CPU_INCLUSIVE ? "inclusive" : "exclusive",
+                               segmented ? "segmented " : "", type_names[type],
+                               (unsigned long) count, threads, in_place ? ", in place" : "");
+                        ok = 0;
+                    }
+                }
+            }
+        }
+
+        free(input);
+        free(output);
+        free(expected);
+        free(heads);
+    }
+    return ok;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+static double
+time_memcpy(void *dst, const void *src, size_t bytes)
+{
+    int iterations = -1;
+    double t0 = 0.0, t;
+    do
+    {
+        // Start timing after the first copy, which pays for the page faults
+        // of a new buffer.
+        memcpy(dst, src, bytes);
+        if (++iterations == 0)
+            t0 = now();
+    } while ((t = now() - t0) < min_seconds || iterations == 0);
+    return 2e-9 * bytes * iterations / t;
+}
+
+// Time one kind of scan and report GB/s for reading the input (and heads)
+// once and writing the output once.
+static void
+bench_scan(const char *name, void *output, const void *input, const unsigned char *heads,
+           size_t count, scan_cpu_type type, scan_cpu_mode mode, int threads, double copy)
+{
+    size_t bytes = count * channels_of(type) * 4;
+    int iterations = 0;
+    double t0 = now(), t, rate;
+
+    do
+    {
+        if (heads)
+            scan_cpu_segmented(output, input, heads, count, type, mode, threads);
+        else
+            scan_cpu(output, input, count, type, mode, threads);
+        iterations++;
+    } while ((t = now() - t0) < min_seconds);
+
+    rate = 1e-9 * (2 * bytes + (heads ? count : 0)) * iterations / t;
+    printf("    %-26s %8.2f GB/sec (%3.0f%% of memcpy)\n", name, rate, 100.0 * rate / copy);
+}
+
+static void
+bench(size_t count, int threads, size_t memory)
+{
+    size_t bytes = count * sizeof(float);
+    void *input, *output;
+    unsigned char *heads;
+    double copy;
+
+    printf("%lu elements (%.1f MB):\n", (unsigned long) count, bytes / 1048576.0);
+    if (2 * bytes + count > memory ||
+        !(input = malloc(bytes)) || !(output = malloc(bytes)) || !(heads = malloc(count)))
+    {
+        printf("    skipped, not enough memory\n");
+        return;
+    }
+
+    fill(input, count, 0);
+    fill_heads(heads, count, 1000);
+    copy = time_memcpy(output, input, bytes);
+    printf("    %-26s %8.2f GB/sec\n", "memcpy", copy);
+
+    bench_scan("exclusive float", output, input, NULL, count,
+               SCAN_CPU_FLOAT, SCAN_CPU_EXCLUSIVE, threads, copy);
+    bench_scan("inclusive int", output, input, NULL, count,
+               SCAN_CPU_INT, SCAN_CPU_INCLUSIVE, threads, copy);
+    bench_scan("exclusive float4", output, input, NULL, count / 4,
+               SCAN_CPU_FLOAT4, SCAN_CPU_EXCLUSIVE, threads, copy);
+    bench_scan("segmented exclusive float", output, input, heads, count,
+               SCAN_CPU_FLOAT, SCAN_CPU_EXCLUSIVE, threads, copy);
+
+    free(input);
+    free(output);
+    free(heads);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+    static const size_t validation_counts[] =
+    {
+        0, 1, 2, 3, 5, 17, 1000, 4099, 65539, 300001, 1 << 20,
+    };
+    size_t max_count = (size_t) 1 << 30, count, memory, i;
+    int threads = 0, ok = 1;
+
+    if (argc > 1)
+        max_count = (size_t) strtod(argv[1], NULL);
+    if (argc > 2)
+        threads = atoi(argv[2]);
+
+    memory = (size_t) sysconf(_SC_PHYS_PAGES) * (size_t) sysconf(_SC_PAGESIZE) / 4 * 3;
+
+    // Validate with one thread, with several (which exercises the look-back
+    // even on a single processor), and with the default.
+    printf("Validating...\n");
+    for (i = 0; i < sizeof validation_counts / sizeof *validation_counts; i++)
+    {
+        ok &= validate(validation_counts[i], 1);
+        ok &= validate(validation_counts[i], 4);
+        ok &= validate(validation_counts[i], 0);
+    }
+
+    printf("Timing with %d threads (0 is one per processor):\n", threads);
+    for (count = 1024; count <= max_count; count *= 4)
+        bench(count, threads, memory);
+
+    if (!ok)
+    {
+        printf("Error:  Incorrect results obtained!\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("Results Validated!\n");
+    return 0;
+}
@@ -61,9 +61,12 @@
 
 #include <OpenCL/opencl.h>
 
+#include "reduce_cpu.h"
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #define MIN_ERROR       (1e-7)
+#define MAX_RELATIVE_ERROR (1e-6)
 #define MAX_GROUPS      (64)
 #define MAX_WORK_ITEMS  (64)
 #define SEPARATOR       ("----------------------------------------------------------------------\n")
@@ -316,6 +319,132 @@ void create_reduction_pass_counts(
 
 /////////////////////////////////////////////////////////////////////////////
 
+int reduce_on_host(void *input_data)
+{
+    uint64_t t1 = 0;
+    uint64_t t2 = 0;
+    int c, k;
+
+    reduce_cpu_type type;
+    switch(channels)
+    {
+        case 4:
+            type = integer ? REDUCE_CPU_INT4 : REDUCE_CPU_FLOAT4;
+            break;
+        case 2:
+            type = integer ? REDUCE_CPU_INT2 : REDUCE_CPU_FLOAT2;
+            break;
+        case 1:
+            type = integer ? REDUCE_CPU_INT : REDUCE_CPU_FLOAT;
+            break;
+        default:
+            printf("Invalid channel count specified!\n");
+            return EXIT_FAILURE;
+    };
+
+    // Time the reduction with one thread per processor and SIMD within each thread
+    //
+    printf(SEPARATOR);
+    printf("Timing %d iterations of host reduction with %d elements of type %s%s...\n", 
+        iterations, count, integer ? "int" : "float", 
+        (channels <= 1) ? (" ") : (channels == 2) ? "2" : "4");
+    printf(SEPARATOR);
+
+    union { int i[4]; float f[4]; } computed_result;
+    t1 = current_time();
+    for (k = 0 ; k < iterations; k++)
+    {
+        if (reduce_cpu(&computed_result, NULL, input_data, count, type, REDUCE_CPU_SUM, 0) != 0)
+        {
+            printf("Error: Failed to reduce on the host!\n");
+            return EXIT_FAILURE;
+        }
+    }
+    t2 = current_time();
+
+    // Calculate the statistics for execution time and throughput
+    //
+    size_t buffer_size = (integer ? sizeof(int) : sizeof(float)) * count * channels;
+    double t = subtract_time_in_seconds(t2, t1);
+    printf("Exec Time:  %.2f ms\n", 1000.0 * t / (double)(iterations));
+    printf("Throughput: %.2f GB/sec\n", 1e-9 * buffer_size * iterations / t);
+    printf(SEPARATOR);
+
+    // Verify the results are correct.  Integer sums must match exactly; float sums
+    // are added up in a different order than the reference, so allow for rounding.
+    //
+    float error = 0.0f;
+    float diff = 0.0f;
+    if(integer)
+    {
+        int reference[4] = { 0, 0, 0, 0};    
+        switch(channels)
+        {
+            case 4:
+                reduce_validate_int4(input_data, count, reference);
+                break;
+            case 2:
+                reduce_validate_int2(input_data, count, reference);
+                break;
+            default:
+                reduce_validate_int(input_data, count, reference);
+                break;
+        }    
+
+        for(c = 0; c < channels; c++)
+        {
+            diff = fabs(reference[c] - computed_result.i[c]);
+            error = diff > error ? diff : error;
+        }
+
+        if (error > MIN_ERROR)
+        {
+            for(c = 0; c < channels; c++)
+                printf("Result[%d] %d != %d\n", c, reference[c], computed_result.i[c]);
+    
+            printf("Error:  Incorrect results obtained! Max error = %f\n", error);
+            return EXIT_FAILURE;
+        }
+    }
+    else
+    {
+        float reference[4] = { 0.0f, 0.0f, 0.0f, 0.0f};    
+        switch(channels)
+        {
+            case 4:
+                reduce_validate_float4(input_data, count, reference);
+                break;
+            case 2:
+                reduce_validate_float2(input_data, count, reference);
+                break;
+            default:
+                reduce_validate_float(input_data, count, reference);
+                break;
+        }
+
+        for(c = 0; c < channels; c++)
+        {
+            diff = fabs(reference[c] - computed_result.f[c]) / fabs(reference[c]);
+            error = diff > error ? diff : error;
+        }
+    
+        if (error > MAX_RELATIVE_ERROR)
+        {
+            for(c = 0; c < channels; c++)
+                printf("Result[%d] %f != %f\n", c, reference[c], computed_result.f[c]);
+    
+            printf("Error:  Incorrect results obtained! Max relative error = %g\n", error);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("Results Validated!\n");
+    printf(SEPARATOR);
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
 int main(int argc, char **argv)
 {
     uint64_t         t1 = 0;
@@ -334,6 +463,7 @@ int main(int argc, char **argv)
     int*             operation_counts = 0;
     int*             entry_counts = 0;
     int              use_gpu = 1;
+    int              use_host = 0;
     
     int i;
     int c;
@@ -345,7 +475,11 @@ int main(int argc, char **argv)
         if(!argv[i])
             continue;
             
-        if(strstr(argv[i], "cpu"))
+        if(i > 0 && strstr(argv[i], "host"))
+        {
+            use_host = 1;
+        }
+        else if(strstr(argv[i], "cpu"))
         {
             use_gpu = 0;        
         }
@@ -395,13 +529,25 @@ int main(int argc, char **argv)
         integer_data[i] = (int) (255.0f * float_data[i]);
     }
 
-    // Connect to a compute device
+    // Connect to a compute device, or reduce on the host with the CPU library if
+    // asked to ("reduce host") or if there is no such device
     //
-    err = clGetDeviceIDs(NULL, use_gpu ? CL_DEVICE_TYPE_GPU : CL_DEVICE_TYPE_CPU, 1, &device_id, NULL);
-    if (err != CL_SUCCESS)
+    if(!use_host)
     {
-        printf("Error: Failed to locate a compute device!\n");
-        return EXIT_FAILURE;
+        err = clGetDeviceIDs(NULL, use_gpu ? CL_DEVICE_TYPE_GPU : CL_DEVICE_TYPE_CPU, 1, &device_id, NULL);
+        if (err != CL_SUCCESS)
+        {
+            printf("Warning: Failed to locate a compute device!  Reducing on the host instead.\n");
+            use_host = 1;
+        }
+    }
+
+    if(use_host)
+    {
+        err = reduce_on_host(integer ? (void*)integer_data : (void*)float_data);
+        free(float_data);
+        free(integer_data);
+        return err;
     }
 
     size_t returned_size = 0;
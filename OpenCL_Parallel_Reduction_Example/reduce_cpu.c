@@ -0,0 +1,633 @@
+//
+// File:       reduce_cpu.c
+//
+// Abstract:   A multi-threaded CPU reduction library for int and float data of one, two or four
+//             channels, computing sums, minima, maxima and their positions.  See reduce_cpu.h.
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "reduce_cpu.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Size of the tiles that are reduced independently.  The tiles are the same
+// for any number of threads, which keeps float sums reproducible.
+#define TILE_BYTES              (64 * 1024)
+
+// Inputs smaller than this are reduced by the calling thread alone; starting
+// threads would cost more than it saves.
+#define MIN_THREADED_BYTES      (256 * 1024)
+
+#define MAX_THREADS             (64)
+
+// Tile results kept on the stack before resorting to malloc.
+#define LOCAL_TILES             (16)
+
+#define ALWAYS_INLINE           static inline __attribute__((always_inline))
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Four 32-bit lanes holding int or float values.  A vector holds four int or
+// float elements, two int2 or float2 elements or one int4 or float4 element,
+// so lane i always holds channel (i % channels).  Masks have all bits set in
+// the lanes where a comparison holds.
+
+#if defined(__SSE2__)
+
+typedef __m128 vec4;
+
+#define SI(a)                   _mm_castps_si128(a)
+#define PS(a)                   _mm_castsi128_ps(a)
+
+ALWAYS_INLINE vec4 v_load(const void *p)        { return _mm_loadu_ps((const float *) p); }
+ALWAYS_INLINE void v_store(void *p, vec4 a)     { _mm_storeu_ps((float *) p, a); }
+ALWAYS_INLINE vec4 v_zero(void)                 { return _mm_setzero_ps(); }
+ALWAYS_INLINE vec4 v_int(int i)                 { return PS(_mm_set1_epi32(i)); }
+ALWAYS_INLINE vec4 v_or(vec4 a, vec4 b)         { return _mm_or_ps(a, b); }
+ALWAYS_INLINE vec4 v_and(vec4 a, vec4 b)        { return _mm_and_ps(a, b); }
+
+ALWAYS_INLINE vec4
+v_select(vec4 m, vec4 a, vec4 b)
+{
+    return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+
+ALWAYS_INLINE vec4
+v_add(vec4 a, vec4 b, int integer)
+{
+    return integer ? PS(_mm_add_epi32(SI(a), SI(b))) : _mm_add_ps(a, b);
+}
+
+ALWAYS_INLINE vec4
+v_less(vec4 a, vec4 b, int integer)
+{
+    return integer ? PS(_mm_cmplt_epi32(SI(a), SI(b))) : _mm_cmplt_ps(a, b);
+}
+
+ALWAYS_INLINE vec4
+v_equal(vec4 a, vec4 b, int integer)
+{
+    return integer ? PS(_mm_cmpeq_epi32(SI(a), SI(b))) : _mm_cmpeq_ps(a, b);
+}
+
+ALWAYS_INLINE vec4
+v_min(vec4 a, vec4 b, int integer)
+{
+    return integer ? v_select(v_less(a, b, 1), a, b) : _mm_min_ps(a, b);
+}
+
+ALWAYS_INLINE vec4
+v_max(vec4 a, vec4 b, int integer)
+{
+    return integer ? v_select(v_less(b, a, 1), a, b) : _mm_max_ps(a, b);
+}
+
+ALWAYS_INLINE vec4 v_swap_halves(vec4 a)        { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2)); }
+ALWAYS_INLINE vec4 v_swap_pairs(vec4 a)         { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)); }
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+typedef float32x4_t vec4;
+
+#define U32(a)                  vreinterpretq_u32_f32(a)
+#define S32(a)                  vreinterpretq_s32_f32(a)
+#define F32(a)                  vreinterpretq_f32_u32(a)
+#define F32S(a)                 vreinterpretq_f32_s32(a)
+
+ALWAYS_INLINE vec4 v_load(const void *p)        { return vld1q_f32((const float *) p); }
+ALWAYS_INLINE void v_store(void *p, vec4 a)     { vst1q_f32((float *) p, a); }
+ALWAYS_INLINE vec4 v_zero(void)                 { return vdupq_n_f32(0.0f); }
+ALWAYS_INLINE vec4 v_int(int i)                 { return F32S(vdupq_n_s32(i)); }
+ALWAYS_INLINE vec4 v_or(vec4 a, vec4 b)         { return F32(vorrq_u32(U32(a), U32(b))); }
+ALWAYS_INLINE vec4 v_and(vec4 a, vec4 b)        { return F32(vandq_u32(U32(a), U32(b))); }
+ALWAYS_INLINE vec4 v_select(vec4 m, vec4 a, vec4 b) { return vbslq_f32(U32(m), a, b); }
+
+ALWAYS_INLINE vec4
+v_add(vec4 a, vec4 b, int integer)
+{
+    return integer ? F32S(vaddq_s32(S32(a), S32(b))) : vaddq_f32(a, b);
+}
+
+ALWAYS_INLINE vec4
+v_less(vec4 a, vec4 b, int integer)
+{
+    return F32(integer ? vcltq_s32(S32(a), S32(b)) : vcltq_f32(a, b));
+}
+
+ALWAYS_INLINE vec4
+v_equal(vec4 a, vec4 b, int integer)
+{
+    return F32(integer ? vceqq_s32(S32(a), S32(b)) : vceqq_f32(a, b));
+}
+
+ALWAYS_INLINE vec4
+v_min(vec4 a, vec4 b, int integer)
+{
+    return integer ? F32S(vminq_s32(S32(a), S32(b))) : vminq_f32(a, b);
+}
+
+ALWAYS_INLINE vec4
+v_max(vec4 a, vec4 b, int integer)
+{
+    return integer ? F32S(vmaxq_s32(S32(a), S32(b))) : vmaxq_f32(a, b);
+}
+
+ALWAYS_INLINE vec4 v_swap_halves(vec4 a)        { return vcombine_f32(vget_high_f32(a), vget_low_f32(a)); }
+ALWAYS_INLINE vec4 v_swap_pairs(vec4 a)         { return vrev64q_f32(a); }
+
+#else
+
+typedef union { uint32_t u[4]; int32_t i[4]; float f[4]; } vec4;
+
+ALWAYS_INLINE vec4 v_load(const void *p)        { vec4 a; memcpy(a.u, p, sizeof(a.u)); return a; }
+ALWAYS_INLINE void v_store(void *p, vec4 a)     { memcpy(p, a.u, sizeof(a.u)); }
+ALWAYS_INLINE vec4 v_zero(void)                 { vec4 a = { { 0, 0, 0, 0 } }; return a; }
+
+ALWAYS_INLINE vec4
+v_int(int i)
+{
+    vec4 a;
+    a.i[0] = a.i[1] = a.i[2] = a.i[3] = i;
+    return a;
+}
+
+#define LANEWISE(expression)                                                    \
+    vec4 r;                                                                     \
+    int l;                                                                      \
+    for (l = 0; l < 4; l++)                                                     \
+        r.u[l] = (expression);                                                  \
+    return r
+
+ALWAYS_INLINE vec4 v_or(vec4 a, vec4 b)         { LANEWISE(a.u[l] | b.u[l]); }
+ALWAYS_INLINE vec4 v_and(vec4 a, vec4 b)        { LANEWISE(a.u[l] & b.u[l]); }
+ALWAYS_INLINE vec4 v_select(vec4 m, vec4 a, vec4 b) { LANEWISE((m.u[l] & a.u[l]) | (~m.u[l] & b.u[l])); }
+
+ALWAYS_INLINE vec4
+v_add(vec4 a, vec4 b, int integer)
+{
+    vec4 r;
+    int l;
+    for (l = 0; l < 4; l++)
+    {
+        if (integer)
+            r.u[l] = a.u[l] + b.u[l];
+        else
+            r.f[l] = a.f[l] + b.f[l];
+    }
+    return r;
+}
+
+ALWAYS_INLINE vec4
+v_less(vec4 a, vec4 b, int integer)
+{
+    LANEWISE((integer ? a.i[l] < b.i[l] : a.f[l] < b.f[l]) ? 0xFFFFFFFFu : 0u);
+}
+
+ALWAYS_INLINE vec4
+v_equal(vec4 a, vec4 b, int integer)
+{
+    LANEWISE((integer ? a.i[l] == b.i[l] : a.f[l] == b.f[l]) ? 0xFFFFFFFFu : 0u);
+}
+
+ALWAYS_INLINE vec4 v_min(vec4 a, vec4 b, int integer) { return v_select(v_less(a, b, integer), a, b); }
+ALWAYS_INLINE vec4 v_max(vec4 a, vec4 b, int integer) { return v_select(v_less(b, a, integer), a, b); }
+
+ALWAYS_INLINE vec4 v_swap_halves(vec4 a)        { vec4 r = { { a.u[2], a.u[3], a.u[0], a.u[1] } }; return r; }
+ALWAYS_INLINE vec4 v_swap_pairs(vec4 a)         { vec4 r = { { a.u[1], a.u[0], a.u[3], a.u[2] } }; return r; }
+
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+// The result of reducing one tile:  the reduced value of each channel, and
+// for REDUCE_CPU_ARGMIN and REDUCE_CPU_ARGMAX, where in the input it is.
+typedef struct
+{
+    uint32_t    value[4];
+    size_t      index[4];
+} tile_result;
+
+ALWAYS_INLINE vec4
+v_combine(vec4 a, vec4 b, int integer, int op)
+{
+    if (op == REDUCE_CPU_SUM)
+        return v_add(a, b, integer);
+    if (op == REDUCE_CPU_MIN)
+        return v_min(a, b, integer);
+    return v_max(a, b, integer);
+}
+
+// Mask of the lanes where a is strictly better than b:  smaller for the
+// minimum, larger for the maximum.
+ALWAYS_INLINE vec4
+v_better(vec4 a, vec4 b, int integer, int op)
+{
+    return op == REDUCE_CPU_ARGMIN ? v_less(a, b, integer) : v_less(b, a, integer);
+}
+
+static inline int
+better(uint32_t a, uint32_t b, int integer, int op)
+{
+    if (integer)
+    {
+        int32_t x = (int32_t) a, y = (int32_t) b;
+        return op == REDUCE_CPU_MIN || op == REDUCE_CPU_ARGMIN ? x < y : x > y;
+    }
+    else
+    {
+        float x, y;
+        memcpy(&x, &a, sizeof(x));
+        memcpy(&y, &b, sizeof(y));
+        return op == REDUCE_CPU_MIN || op == REDUCE_CPU_ARGMIN ? x < y : x > y;
+    }
+}
+
+// Reduce count elements with REDUCE_CPU_SUM, REDUCE_CPU_MIN or REDUCE_CPU_MAX.
+ALWAYS_INLINE void
+reduce_values(tile_result *result, const char *in, size_t count, int integer, int channels, int op)
+{
+    const size_t per_vector = 4 / channels;
+    const size_t vectors = count / per_vector;
+    const size_t tail = count - vectors * per_vector;
+    uint32_t buffer[4] = { 0, 0, 0, 0 };
+    vec4 a0, a1, a2, a3;
+    size_t i = 0;
+    int l;
+
+    // Pad the last partial vector with zeros for sums, or with copies of its
+    // first element otherwise, neither of which changes the result.
+    if (tail)
+    {
+        memcpy(buffer, in + 16 * vectors, tail * channels * 4);
+        if (op != REDUCE_CPU_SUM)
+            for (l = (int) (tail * channels); l < 4; l++)
+                buffer[l] = buffer[l % channels];
+    }
+
+    if (op == REDUCE_CPU_SUM)
+        a0 = v_zero();
+    else
+        a0 = v_load(vectors ? in : (const char *) buffer);
+    a1 = a2 = a3 = a0;
+
+    for (; i + 4 <= vectors; i += 4)
+    {
+        a0 = v_combine(a0, v_load(in + 16 * (i + 0)), integer, op);
+        a1 = v_combine(a1, v_load(in + 16 * (i + 1)), integer, op);
+        a2 = v_combine(a2, v_load(in + 16 * (i + 2)), integer, op);
+        a3 = v_combine(a3, v_load(in + 16 * (i + 3)), integer, op);
+    }
+    for (; i < vectors; i++)
+        a0 = v_combine(a0, v_load(in + 16 * i), integer, op);
+    if (tail)
+        a1 = v_combine(a1, v_load(buffer), integer, op);
+
+    a0 = v_combine(v_combine(a0, a1, integer, op), v_combine(a2, a3, integer, op), integer, op);
+    if (channels <= 2)
+        a0 = v_combine(a0, v_swap_halves(a0), integer, op);
+    if (channels == 1)
+        a0 = v_combine(a0, v_swap_pairs(a0), integer, op);
+    v_store(buffer, a0);
+    memcpy(result->value, buffer, sizeof(buffer));
+}
+
+// Reduce count elements with REDUCE_CPU_ARGMIN or REDUCE_CPU_ARGMAX, where the
+// first element is at position first in the whole input.
+ALWAYS_INLINE void
+reduce_positions(tile_result *result, const char *in, size_t count, size_t first,
+                 int integer, int channels, int op)
+{
+    const size_t per_vector = 4 / channels;
+    const size_t vectors = count / per_vector;
+    const uint32_t *values = (const uint32_t *) in;
+    int32_t index[4];
+    size_t i = 0;
+    int c, l;
+
+    for (c = 0; c < channels; c++)
+    {
+        result->value[c] = values[c];
+        result->index[c] = 0;
+    }
+
+    // Track the best value seen in each lane and the element it came from,
+    // in two independent sets to keep the dependency chains short.
+    if (vectors)
+    {
+        vec4 step = v_int((int) per_vector), at, best0, best1, where0, where1, m;
+        uint32_t best[4];
+
+        for (l = 0; l < 4; l++)
+            index[l] = l / channels;
+        at = v_load(index);
+        best0 = best1 = v_load(in);
+        where0 = where1 = at;
+
+        for (i = 1; i + 2 <= vectors; i += 2)
+        {
+            vec4 x0 = v_load(in + 16 * i), x1 = v_load(in + 16 * (i + 1));
+            vec4 at0 = v_add(at, step, 1), at1 = v_add(at0, step, 1);
+            vec4 m0 = v_better(x0, best0, integer, op), m1 = v_better(x1, best1, integer, op);
+            best0 = v_select(m0, x0, best0);
+            best1 = v_select(m1, x1, best1);
+            where0 = v_select(m0, at0, where0);
+            where1 = v_select(m1, at1, where1);
+            at = at1;
+        }
+        if (i < vectors)
+        {
+            vec4 x0 = v_load(in + 16 * i), at0 = v_add(at, step, 1);
+            m = v_better(x0, best0, integer, op);
+            best0 = v_select(m, x0, best0);
+            where0 = v_select(m, at0, where0);
+            i++;
+        }
+
+        // Merge the sets, preferring the earlier element on ties.
+        m = v_or(v_better(best1, best0, integer, op),
+                 v_and(v_equal(best1, best0, integer), v_less(where1, where0, 1)));
+        best0 = v_select(m, best1, best0);
+        where0 = v_select(m, where1, where0);
+
+        v_store(best, best0);
+        v_store(index, where0);
+        for (l = 0; l < 4; l++)
+        {
+            c = l % channels;
+            if (l < channels ||
+                better(best[l], result->value[c], integer, op) ||
+                (best[l] == result->value[c] && (size_t) index[l] < result->index[c]))
+            {
+                result->value[c] = best[l];
+                result->index[c] = (size_t) index[l];
+            }
+        }
+        i *= per_vector;
+    }
+
+    // Finish the last partial vector, or a whole tile smaller than a vector.
+    for (; i < count; i++)
+        for (c = 0; c < channels; c++)
+            if (better(values[i * channels + c], result->value[c], integer, op))
+            {
+                result->value[c] = values[i * channels + c];
+                result->index[c] = i;
+            }
+
+    for (c = 0; c < channels; c++)
+        result->index[c] += first;
+}
+
+// Specialize the kernels for each element type and operation, so that the
+// tests above are resolved at compile time.
+#define REDUCE_KERNELS(name, integer, channels)                                                 \
+    static void                                                                                 \
+    name##_reduce(tile_result *result, const char *in, size_t count, size_t first, int op)      \
+    {                                                                                           \
+        switch (op)                                                                             \
+        {                                                                                       \
+            case REDUCE_CPU_SUM:                                                                \
+                reduce_values(result, in, count, integer, channels, REDUCE_CPU_SUM);            \
+                break;                                                                          \
+            case REDUCE_CPU_MIN:                                                                \
+                reduce_values(result, in, count, integer, channels, REDUCE_CPU_MIN);            \
+                break;                                                                          \
+            case REDUCE_CPU_MAX:                                                                \
+                reduce_values(result, in, count, integer, channels, REDUCE_CPU_MAX);            \
+                break;                                                                          \
+            case REDUCE_CPU_ARGMIN:                                                             \
+                reduce_positions(result, in, count, first, integer, channels, REDUCE_CPU_ARGMIN); \
+                break;                                                                          \
+            default:                                                                            \
+                reduce_positions(result, in, count, first, integer, channels, REDUCE_CPU_ARGMAX); \
+                break;                                                                          \
+        }                                                                                       \
+    }
+
+REDUCE_KERNELS(int1,   1, 1)
+REDUCE_KERNELS(int2,   1, 2)
+REDUCE_KERNELS(int4,   1, 4)
+REDUCE_KERNELS(float1, 0, 1)
+REDUCE_KERNELS(float2, 0, 2)
+REDUCE_KERNELS(float4, 0, 4)
+
+typedef struct
+{
+    void (*reduce)(tile_result *result, const char *in, size_t count, size_t first, int op);
+    int  integer;
+    int  channels;
+} reduce_kernels;
+
+// Indexed by reduce_cpu_type.
+static const reduce_kernels kernels[] =
+{
+    { int1_reduce,   1, 1 },
+    { int2_reduce,   1, 2 },
+    { int4_reduce,   1, 4 },
+    { float1_reduce, 0, 1 },
+    { float2_reduce, 0, 2 },
+    { float4_reduce, 0, 4 },
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+    const char              *input;
+    size_t                  count;
+    size_t                  element_size;
+    size_t                  tile_elements;
+    size_t                  tile_count;
+    const reduce_kernels    *kernels;
+    int                     op;
+    tile_result             *results;
+    volatile long           next_tile;
+} reduce_job;
+
+static void *
+reduce_worker(void *arg)
+{
+    reduce_job *job = arg;
+    size_t tile;
+
+    while ((tile = (size_t) __sync_fetch_and_add(&job->next_tile, 1)) < job->tile_count)
+    {
+        size_t begin = tile * job->tile_elements;
+        size_t count = job->count - begin < job->tile_elements ? job->count - begin : job->tile_elements;
+        job->kernels->reduce(&job->results[tile], job->input + begin * job->element_size,
+                             count, begin, job->op);
+    }
+    return NULL;
+}
+
+static int
+processor_count(void)
+{
+    static int count = 0;
+    if (!count)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        count = n > 0 ? (int) n : 1;
+    }
+    return count;
+}
+
+// Combine the tile results in order.
+static void
+combine(void *result, size_t *index, const reduce_job *job)
+{
+    const int integer = job->kernels->integer, channels = job->kernels->channels;
+    const tile_result *tiles = job->results;
+    uint32_t value[4];
+    size_t tile;
+    int c;
+
+    for (c = 0; c < channels; c++)
+    {
+        if (job->op == REDUCE_CPU_SUM && integer)
+        {
+            uint32_t sum = 0;
+            for (tile = 0; tile < job->tile_count; tile++)
+                sum += tiles[tile].value[c];
+            value[c] = sum;
+        }
+        else if (job->op == REDUCE_CPU_SUM)
+        {
+            double sum = 0.0;
+            float f;
+            for (tile = 0; tile < job->tile_count; tile++)
+            {
+                memcpy(&f, &tiles[tile].value[c], sizeof(f));
+                sum += f;
+            }
+            f = (float) sum;
+            memcpy(&value[c], &f, sizeof(f));
+        }
+        else
+        {
+            size_t best = 0;
+            for (tile = 1; tile < job->tile_count; tile++)
+                if (better(tiles[tile].value[c], tiles[best].value[c], integer, job->op))
+                    best = tile;
+            value[c] = tiles[best].value[c];
+            if (index && (job->op == REDUCE_CPU_ARGMIN || job->op == REDUCE_CPU_ARGMAX))
+                index[c] = tiles[best].index[c];
+        }
+    }
+    memcpy(result, value, channels * sizeof(uint32_t));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int
+reduce_cpu(
+    void *result, size_t *index, const void *input, size_t count,
+    reduce_cpu_type type, reduce_cpu_op op, int threads)
+{
+    tile_result local[LOCAL_TILES];
+    pthread_t workers[MAX_THREADS];
+    reduce_job job;
+    int i, started = 0;
+
+    if ((int) type < REDUCE_CPU_INT || (int) type > REDUCE_CPU_FLOAT4 ||
+        (int) op < REDUCE_CPU_SUM || (int) op > REDUCE_CPU_ARGMAX)
+        return -1;
+    if (count == 0)
+    {
+        if (op != REDUCE_CPU_SUM)
+            return -1;
+        memset(result, 0, 4 * kernels[type].channels);
+        return 0;
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.input = input;
+    job.count = count;
+    job.kernels = &kernels[type];
+    job.element_size = 4 * job.kernels->channels;
+    job.tile_elements = TILE_BYTES / job.element_size;
+    job.tile_count = (count + job.tile_elements - 1) / job.tile_elements;
+    job.op = op;
+    job.results = local;
+    if (job.tile_count > LOCAL_TILES)
+    {
+        job.results = malloc(job.tile_count * sizeof(tile_result));
+        if (!job.results)
+            return -1;
+    }
+
+    if (count * job.element_size < MIN_THREADED_BYTES)
+        threads = 1;
+    else if (threads <= 0)
+        threads = processor_count();
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if ((size_t) threads > job.tile_count)
+        threads = (int) job.tile_count;
+
+    for (i = 1; i < threads; i++)
+        if (pthread_create(&workers[started], NULL, reduce_worker, &job) == 0)
+            started++;
+    reduce_worker(&job);
+    for (i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+
+    combine(result, index, &job);
+
+    if (job.results != local)
+        free(job.results);
+    return 0;
+}
@@ -0,0 +1,116 @@
+//
+// File:       reduce_cpu.h
+//
+// Abstract:   Declares a multi-threaded CPU reduction library:  sum, minimum, maximum, and the
+//             position of the minimum or maximum, for int and float data of one, two or four
+//             channels (int, int2, int4, float, float2, float4).
+//
+//             The input is split into fixed tiles which threads reduce independently, using SSE
+//             or NEON when available, and the results of the tiles are then combined in order, so
+//             the result does not depend on the number of threads.
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __REDUCE_CPU_H__
+#define __REDUCE_CPU_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Element types.  Vector types are stored as interleaved channels, as with
+// the matching OpenCL types, and each channel is reduced independently.
+//
+typedef enum
+{
+    REDUCE_CPU_INT,
+    REDUCE_CPU_INT2,
+    REDUCE_CPU_INT4,
+    REDUCE_CPU_FLOAT,
+    REDUCE_CPU_FLOAT2,
+    REDUCE_CPU_FLOAT4
+} reduce_cpu_type;
+
+typedef enum
+{
+    REDUCE_CPU_SUM,
+    REDUCE_CPU_MIN,
+    REDUCE_CPU_MAX,
+    REDUCE_CPU_ARGMIN,
+    REDUCE_CPU_ARGMAX
+} reduce_cpu_op;
+
+// Reduce count elements of the given type and store one element of that type
+// in result.  For REDUCE_CPU_ARGMIN and REDUCE_CPU_ARGMAX, result receives the
+// minimum or maximum and index, unless it is NULL, receives the position of
+// its first occurrence in each channel (one size_t per channel).
+//
+// Integer sums wrap around on overflow.  Float sums are accumulated in single
+// precision within each tile and in double precision across tiles, which is
+// both deterministic and more accurate than a serial sum.  Results are
+// undefined if the float input contains NaNs.
+//
+// threads is the most threads to use, counting the calling thread; 0 uses one
+// per online processor.  Inputs that fit comfortably in cache are always
+// reduced by the calling thread alone.
+//
+// Returns 0 on success, or -1 if the type or operation is invalid, count is
+// zero for an operation other than REDUCE_CPU_SUM, or the tile results could
+// not be allocated.
+//
+int reduce_cpu(
+    void *result, size_t *index, const void *input, size_t count,
+    reduce_cpu_type type, reduce_cpu_op op, int threads);
+
+/////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __REDUCE_CPU_H__
@@ -0,0 +1,318 @@
+//
+// File:       reduce_cpu_bench.c
+//
+// Abstract:   Validates the CPU reduction library in reduce_cpu.c against serial reductions for
+//             every element type and operation, then times it for 1K to 1G elements and reports
+//             its bandwidth next to that of memcpy.  Both rates count every byte read or written;
+//             a reduction only reads, so where memory is the limit it can approach twice the
+//             memcpy rate.  Sizes that do not fit in three quarters of physical memory are skipped.
+//
+//             This program uses only standard C and POSIX threads and builds on any platform, for
+//             example:
+//
+//                 cc -O3 -march=native -std=gnu99 -o reduce_cpu_bench reduce_cpu_bench.c
+//             reduce_cpu.c -lpthread
+//
+//             Usage:  reduce_cpu_bench [max_elements [threads]]
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "reduce_cpu.h"
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Minimum time to spend timing each case, in seconds.
+static const double min_seconds = 0.25;
+
+static const char *type_names[] = { "int", "int2", "int4", "float", "float2", "float4" };
+static const char *op_names[] = { "sum", "min", "max", "argmin", "argmax" };
+
+/////////////////////////////////////////////////////////////////////////////
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static int
+channels_of(reduce_cpu_type type)
+{
+    static const int channels[] = { 1, 2, 4, 1, 2, 4 };
+    return channels[type];
+}
+
+static int
+is_integer(reduce_cpu_type type)
+{
+    return type <= REDUCE_CPU_INT4;
+}
+
+// Few distinct values, so that minima and maxima occur many times and the
+// first occurrence has to be found.  Ints also get large values, to check
+// that sums wrap around the same way as the reference.
+static void
+fill(void *data, size_t values, int integer)
+{
+    size_t i;
+    for (i = 0; i < values; i++)
+    {
+        int v = rand() % 2001 - 1000;
+        if (integer)
+        {
+            if (rand() % 16 == 0)
+                v = (int) ((unsigned) rand() * 65599u);
+            ((int32_t *) data)[i] = v;
+        }
+        else
+        {
+            ((float *) data)[i] = v * 0.125f;
+        }
+    }
+}
+
+// Serial reduction of channel c.  Float sums are accumulated in double
+// precision; the others are exact.
+static double
+reference(size_t *index, const void *input, size_t count, reduce_cpu_type type, reduce_cpu_op op, int c)
+{
+    int channels = channels_of(type);
+    double best = 0.0;
+    uint32_t sum = 0;
+    size_t i;
+
+    *index = 0;
+    for (i = 0; i < count; i++)
+    {
+        size_t k = i * channels + c;
+        double v = is_integer(type) ? (double) ((const int32_t *) input)[k] : (double) ((const float *) input)[k];
+        if (op == REDUCE_CPU_SUM)
+        {
+            if (is_integer(type))
+                sum += ((const uint32_t *) input)[k];
+            else
+                best += v;
+        }
+        else if (i == 0 ||
+                 ((op == REDUCE_CPU_MIN || op == REDUCE_CPU_ARGMIN) ? v < best : v > best))
+        {
+            best = v;
+            *index = i;
+        }
+    }
+    if (op == REDUCE_CPU_SUM && is_integer(type))
+        return (double) (int32_t) sum;
+    return best;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+static int
+validate(size_t count, int threads)
+{
+    int type, op, c, ok = 1;
+
+    for (type = REDUCE_CPU_INT; type <= REDUCE_CPU_FLOAT4; type++)
+    {
+        void *input = malloc(count * channels_of(type) * 4 + 16);
+        fill(input, count * channels_of(type), is_integer(type));
+
+        for (op = REDUCE_CPU_SUM; op <= REDUCE_CPU_ARGMAX; op++)
+        {
+            union { int32_t i[4]; float f[4]; } result;
+            size_t index[4] = { 0, 0, 0, 0 };
+            int err = reduce_cpu(&result, index, input, count, type, op, threads);
+
+            if (count == 0)
+            {
+                if ((err == 0) != (op == REDUCE_CPU_SUM))
+                    ok = 0;
+                continue;
+            }
+
+            for (c = 0; c < channels_of(type); c++)
+            {
+                size_t expected_index;
+                double expected = reference(&expected_index, input, count, type, op, c);
+                double got = is_integer(type) ? (double) result.i[c] : (double) result.f[c];
+                int good = !err;
+
+                if (op == REDUCE_CPU_SUM && !is_integer(type))
+                    good &= fabs(got - expected) <= 1e-6 * fabs(expected) + 1e-3;
+                else
+                    good &= got == expected;
+                if (op == REDUCE_CPU_ARGMIN || op == REDUCE_CPU_ARGMAX)
+                    good &= index[c] == expected_index;
+
+                if (!good)
+                {
+                    printf("    FAILED: %s of %lu %s elements with %d threads, channel %d: "
+                           "%.9g at %lu != %.9g at %lu\n",
+                           op_names[op], (unsigned long) count, type_names[type], threads, c,
+                           got, (unsigned long) index[c], expected, (unsigned long) expected_index);
+                    ok = 0;
+                }
+            }
+        }
+        free(input);
+    }
+    return ok;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+static double
+time_memcpy(void *dst, const void *src, size_t bytes)
+{
+    int iterations = -1;
+    double t0 = 0.0, t;
+    do
+    {
+        // Start timing after the first copy, which pays for the page faults
+        // of a new buffer.
+        memcpy(dst, src, bytes);
+        if (++iterations == 0)
+            t0 = now();
+    } while ((t = now() - t0) < min_seconds || iterations == 0);
+    return 2e-9 * bytes * iterations / t;
+}
+
+static void
+bench_reduce(const void *input, size_t count, reduce_cpu_type type, reduce_cpu_op op,
+             int threads, double copy)
+{
+    size_t bytes = count * channels_of(type) * 4, index[4];
+    int iterations = 0;
+    double t0 = now(), t, rate;
+    char name[64];
+    float result[4];
+
+    do
+    {
+        reduce_cpu(result, index, input, count, type, op, threads);
+        iterations++;
+    } while ((t = now() - t0) < min_seconds);
+
+    rate = 1e-9 * bytes * iterations / t;
+    snprintf(name, sizeof name, "%s %s", op_names[op], type_names[type]);
+    printf("    %-26s %8.2f GB/sec (%3.0f%% of memcpy)\n", name, rate, 100.0 * rate / copy);
+}
+
+static void
+bench(size_t count, int threads, size_t memory)
+{
+    size_t bytes = count * sizeof(float);
+    void *input, *output;
+    double copy;
+
+    printf("%lu elements (%.1f MB):\n", (unsigned long) count, bytes / 1048576.0);
+    if (2 * bytes > memory || !(input = malloc(bytes)) || !(output = malloc(bytes)))
+    {
+        printf("    skipped, not enough memory\n");
+        return;
+    }
+
+    fill(input, count, 0);
+    copy = time_memcpy(output, input, bytes);
+    printf("    %-26s %8.2f GB/sec\n", "memcpy", copy);
+    free(output);
+
+    bench_reduce(input, count, REDUCE_CPU_FLOAT, REDUCE_CPU_SUM, threads, copy);
+    bench_reduce(input, count, REDUCE_CPU_INT, REDUCE_CPU_SUM, threads, copy);
+    bench_reduce(input, count, REDUCE_CPU_FLOAT, REDUCE_CPU_MIN, threads, copy);
+    bench_reduce(input, count, REDUCE_CPU_FLOAT, REDUCE_CPU_ARGMIN, threads, copy);
+    bench_reduce(input, count / 4, REDUCE_CPU_INT4, REDUCE_CPU_ARGMAX, threads, copy);
+
+    free(input);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+    static const size_t validation_counts[] =
+    {
+        0, 1, 2, 3, 5, 17, 1000, 4099, 65539, 300001, 1 << 20,
+    };
+    size_t max_count = (size_t) 1 << 30, count, memory, i;
+    int threads = 0, ok = 1;
+
+    if (argc > 1)
+        max_count = (size_t) strtod(argv[1], NULL);
+    if (argc > 2)
+        threads = atoi(argv[2]);
+
+    memory = (size_t) sysconf(_SC_PHYS_PAGES) * (size_t) sysconf(_SC_PAGESIZE) / 4 * 3;
+
+    printf("Validating...\n");
+    for (i = 0; i < sizeof validation_counts / sizeof *validation_counts; i++)
+    {
+        ok &= validate(validation_counts[i], 1);
+        ok &= validate(validation_counts[i], 4);
+        ok &= validate(validation_counts[i], 0);
+    }
+
+    printf("Timing with %d threads (0 is one per processor):\n", threads);
+    for (count = 1024; count <= max_count; count *= 4)
+        bench(count, threads, memory);
+
+    if (!ok)
+    {
+        printf("Error:  Incorrect results obtained!\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("Results Validated!\n");
+    return 0;
+}
@@ -61,6 +61,7 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 
 #include <OpenGL/OpenGL.h>
 #include <GLUT/glut.h>
@@ -68,6 +69,8 @@
 
 #include <mach/mach_time.h>
 
+#include "displacement_cpu.h"
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #define USE_GL_ATTACHMENTS                      (1)  // enable OpenGL attachments for Compute results
@@ -79,6 +82,10 @@
 
 static int Animate                              = 1;
 
+static int UseHost                              = 0;
+static displacement_cpu* HostDisplacement       = 0;
+static displacement_cpu_normals HostNormals     = DISPLACEMENT_CPU_SMOOTH_NORMALS;
+
 static int Width                                = 1024;
 static int Height                               = 1024;
 
@@ -315,115 +322,151 @@ file_to_string(const char *file_name, char **result_string, size_t *string_len)
     return 0;
 }
 
+// Map a PFM image into memory.  When the file holds RGB floats in the byte
+// order of the host, suitably aligned, *data points straight into the mapped
+// file and nothing is copied; otherwise the pixels are converted from the
+// mapped file into a new buffer and *mapping is set to NULL.  Either way,
+// release the image with unload_pfm().
+//
 static int
 load_pfm(
     const char *file_name, 
     float **data, 
     unsigned int *width, 
     unsigned int *height, 
-    unsigned int *channels)
+    unsigned int *channels,
+    void **mapping,
+    size_t *mapping_bytes)
 {
-
-    FILE *fd = 0;
-    int a, b, x, y;
+    int fd;
+    int x, y, n = 0;
     char tmp;
+    char header[128];
     unsigned int w, h, c;
-    unsigned int bytes;
+    size_t bytes, offset, i;
+    struct stat file_status;
 
     float scale;
     float *buffer;
-    float *scanline;
+    const unsigned char *file;
 
-    fd = fopen(file_name, "rb");
-    if (!fd)
+    fd = open(file_name, O_RDONLY);
+    if (fd == -1)
     {
         printf("Error opening file %s\n", file_name);
         return -1;
     }
 
-    a = fgetc(fd);
-    b = fgetc(fd);
-    tmp = fgetc(fd);
+    if (fstat(fd, &file_status) || file_status.st_size < 3)
+    {
+        close(fd);
+        printf("Error opening file %s:  Does not appear to be a PFM image!\n", file_name);
+        return 0;
+    }
+
+    bytes = file_status.st_size;
+    file = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED)
+    {
+        printf("Error mapping file %s\n", file_name);
+        return -1;
+    }
 
-    if ((a != 'P') || ((b != 'F') && (b != 'f')))
+    if ((file[0] != 'P') || ((file[1] != 'F') && (file[1] != 'f')))
     {
-        fclose(fd);
+        munmap((void *) file, bytes);
         printf("Error opening file %s:  Does not appear to be a PFM image!\n", file_name);
         return 0;
     }
 
-    fscanf(fd, "%d %d%c", &x, &y, &tmp);
-    if ((x <= 0) || (y <= 0))
+    // Parse the rest of the header from a terminated copy, since the
+    // mapped file is not.
+    offset = bytes - 3 < sizeof(header) - 1 ? bytes - 3 : sizeof(header) - 1;
+    memcpy(header, file + 3, offset);
+    header[offset] = 0;
+
+    if (sscanf(header, "%d %d%c%f%c%n", &x, &y, &tmp, &scale, &tmp, &n) < 5 || (x <= 0) || (y <= 0))
     {
-        fclose(fd);
+        munmap((void *) file, bytes);
         printf("Error opening file %s:  Invalid dimensions in PFM header!\n", file_name);
         return 0;
     }
 
     w = x;
     h = y;
-    c = (b == 'F' ? 3 : 1); // 'F' = RGB,  'f' = monochrome
+    c = (file[1] == 'F' ? 3 : 1); // 'F' = RGB,  'f' = monochrome
+    offset = 3 + n;
+
+    if (bytes < offset || (bytes - offset) / sizeof(float) / c / w < h)
+    {
+        munmap((void *) file, bytes);
+        printf("Error opening file %s:  Image data is truncated!\n", file_name);
+        return 0;
+    }
+
+    *width = w;
+    *height = h;
+    *channels = 3;
 
-    fscanf(fd, "%f%c", &scale, &tmp);
+    // A negative scale means little endian, the byte order of the host.
+    if (c == 3 && scale < 0.0 && (offset % sizeof(float)) == 0)
+    {
+        madvise((void *) file, bytes, MADV_SEQUENTIAL);
+        *data = (float *) (file + offset);
+        *mapping = (void *) file;
+        *mapping_bytes = bytes;
+        return 1;
+    }
 
-    bytes = w * h * c * sizeof(float);
-    buffer = (float*)calloc(w * h * c, sizeof(float));
-    scanline = (float*)calloc(w * c, sizeof(float));
-    if (!buffer || !scanline)
+    buffer = (float*)calloc((size_t) w * h * 3, sizeof(float));
+    if (!buffer)
     {
-        fclose(fd);
+        munmap((void *) file, bytes);
         printf("Error opening file %s:  Out of memory!\n", file_name);
         return 0;
     }
 
-
-    float *f = buffer;
-    for (y = 0; y < h; y++)
+    for (i = 0; i < (size_t) w * h; i++)
     {
-        if (fread(scanline, sizeof(float), w * c, fd) != (size_t) (w * c))
+        float *f = buffer + 3 * i;
+
+        if (c == 3)
         {
-            fclose(fd);
-            free(scanline);
-            free(buffer);
-            return 0;
+            memcpy(f, file + offset + 3 * i * sizeof(float), 3 * sizeof(float));
         }
-
-        float *temp = scanline;
-        for (x = 0; x < w; x++)
+        else
         {
-            if (c == 3)
-            {
-                f[0] = *temp++;
-                f[1] = *temp++;
-                f[2] = *temp++;
-            }
-            else
-            {
-                f[0] = *temp++;
-                f[1] = f[0];
-                f[2] = f[0];
-            }
+            memcpy(f, file + offset + i * sizeof(float), sizeof(float));
+            f[1] = f[0];
+            f[2] = f[0];
+        }
 
-            if (scale > 0.0)		// MSB
-            {
-                f[0] = reverse_bytes_float(f[0]);
-                f[1] = reverse_bytes_float(f[1]);
-                f[2] = reverse_bytes_float(f[2]);
-            }
-            f = f + 3;
+        if (scale > 0.0)		// MSB
+        {
+            f[0] = reverse_bytes_float(f[0]);
+            f[1] = reverse_bytes_float(f[1]);
+            f[2] = reverse_bytes_float(f[2]);
         }
     }
 
-    free(scanline);
-    fclose(fd);
+    munmap((void *) file, bytes);
 
     *data = buffer;
-    *width = w;
-    *height = h;
-    *channels = 3;
+    *mapping = 0;
+    *mapping_bytes = 0;
     return 1;
 }
 
+static void
+unload_pfm(float *data, void *mapping, size_t mapping_bytes)
+{
+    if (mapping)
+        munmap(mapping, mapping_bytes);
+    else
+        free(data);
+}
+
 void normalize(float v[3])
 {
     float d = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
@@ -539,6 +582,37 @@ void create_skybox()
 
 ////////////////////////////////////////////////////////////////////////////////
 
+static int
+recompute_on_host(void)
+{
+    int err;
+    displacement_cpu_params params;
+
+    params.frequency = Frequency;
+    params.amplitude = Amplitude;
+    params.phase = Phase;
+    params.lacunarity = Lacunarity;
+    params.increment = Increment;
+    params.octaves = Octaves;
+    params.roughness = Roughness;
+
+    // Only the octaves that depend on a changed parameter are recomputed,
+    // and nothing is uploaded if the sphere did not change at all.
+    err = displacement_cpu_update(HostDisplacement, &params, VertexBuffer, NormalBuffer);
+    if (err < 0)
+        return -20;
+    if (err == 0)
+        return 0;
+
+    glBindBuffer(GL_ARRAY_BUFFER_ARB, VertexBufferId);
+    glBufferSubData(GL_ARRAY_BUFFER_ARB, 0, VertexBytes, VertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER_ARB, NormalBufferId);
+    glBufferSubData(GL_ARRAY_BUFFER_ARB, 0, VertexBytes, NormalBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER_ARB, 0);
+
+    return 0;
+}
+
 static int
 recompute(void)
 {
@@ -561,6 +635,9 @@ recompute(void)
     float octaves = Octaves;
     float roughness = Roughness;
 
+    if (UseHost)
+        return recompute_on_host();
+
     unsigned int v = 0, s = 0;
     unsigned int count = VertexElements;
     values[v++] = &InputVertexBuffer;
@@ -899,6 +976,26 @@ setup_compute_kernels(void)
     return CL_SUCCESS;
 }
 
+static int
+setup_host(void)
+{
+    printf(SEPARATOR);
+    printf("Displacing on the host with %s normals...\n",
+           HostNormals == DISPLACEMENT_CPU_SMOOTH_NORMALS ? "smooth" : "kernel");
+
+    if (HostDisplacement)
+        displacement_cpu_destroy(HostDisplacement);
+
+    HostDisplacement = displacement_cpu_create(SphereResolution, HostNormals, 0);
+    if (!HostDisplacement || displacement_cpu_vertex_count(HostDisplacement) != VertexElements)
+    {
+        printf("Failed to create host displacement!\n");
+        return -1;
+    }
+
+    return CL_SUCCESS;
+}
+
 static int
 setup_opencl(int use_gpu)
 {
@@ -925,15 +1022,23 @@ setup_opencl(int use_gpu)
 static void
 shutdown_opencl(void)
 {
-    clFinish(ComputeCommands);
+    if (UseHost)
+    {
+        displacement_cpu_destroy(HostDisplacement);
+        HostDisplacement = 0;
+    }
+    else
+    {
+        clFinish(ComputeCommands);
 
-    clReleaseMemObject(InputVertexBuffer);
-    clReleaseMemObject(OutputVertexBuffer);
-    clReleaseMemObject(OutputNormalBuffer);
+        clReleaseMemObject(InputVertexBuffer);
+        clReleaseMemObject(OutputVertexBuffer);
+        clReleaseMemObject(OutputNormalBuffer);
 
-    clReleaseKernel(ComputeKernel);
-    clReleaseProgram(ComputeProgram);
-    clReleaseContext(ComputeContext);
+        clReleaseKernel(ComputeKernel);
+        clReleaseProgram(ComputeProgram);
+        clReleaseContext(ComputeContext);
+    }
 
     if(VertexBuffer)
         free(VertexBuffer);
@@ -988,13 +1093,17 @@ void
 create_light_probe_texture(const char *filename)
 {
     float *data;
+    void *mapping;
+    size_t mapping_bytes;
 
     printf("Loading Light Probe \"%s\"\n", filename);
 
-    load_pfm(filename, &data, 
-             &LightProbeWidth, 
-             &LightProbeHeight, 
-             &LightProbeComponents);
+    if (load_pfm(filename, &data, 
+                 &LightProbeWidth, 
+                 &LightProbeHeight, 
+                 &LightProbeComponents,
+                 &mapping, &mapping_bytes) != 1)
+        return;
 
     printf("Creating Light Probe Texture (%d x %d)....\n", 
         LightProbeWidth, LightProbeHeight);
@@ -1011,7 +1120,7 @@ create_light_probe_texture(const char *filename)
                  GL_RGB, GL_FLOAT, data);
     glActiveTextureARB(DisableTexUnit);
 
-    free(data);
+    unload_pfm(data, mapping, mapping_bytes);
 
 }
 
@@ -2560,9 +2669,13 @@ report_stats(uint64_t start, uint64_t end)
         double fMs = (TimeElapsed * 1000.0 / (double) FrameCount);
         double fFps = 1.0 / (fMs / 1000.0);
         
-        sprintf(StatsString, "[%s] Compute: %3.2f ms  Display: %3.2f fps (%s)\n", 
-                (ComputeDeviceType == CL_DEVICE_TYPE_GPU) ? "GPU" : "CPU", 
-                fMs, fFps, USE_GL_ATTACHMENTS ? "attached" : "copying");
+        if (UseHost)
+            sprintf(StatsString, "[HOST] Compute: %3.2f ms  Display: %3.2f fps (%s normals)\n", 
+                    fMs, fFps, HostNormals == DISPLACEMENT_CPU_SMOOTH_NORMALS ? "smooth" : "kernel");
+        else
+            sprintf(StatsString, "[%s] Compute: %3.2f ms  Display: %3.2f fps (%s)\n", 
+                    (ComputeDeviceType == CL_DEVICE_TYPE_GPU) ? "GPU" : "CPU", 
+                    fMs, fFps, USE_GL_ATTACHMENTS ? "attached" : "copying");
 		
 		glutSetWindowTitle(StatsString);
 
@@ -2909,6 +3022,22 @@ void keyboard(unsigned char key, int x, int y)
         ShowStats = ShowStats ? 0 : 1;
         break;
 
+    case 'h':
+        if (UseHost)
+        {
+            HostNormals = (HostNormals == DISPLACEMENT_CPU_SMOOTH_NORMALS) ? 
+                DISPLACEMENT_CPU_KERNEL_NORMALS : DISPLACEMENT_CPU_SMOOTH_NORMALS;
+            if (setup_host() != CL_SUCCESS)
+            {
+                shutdown_opencl();
+                exit(1);
+            }
+            sprintf(InfoString,"HostNormals = %s\n", 
+                    HostNormals == DISPLACEMENT_CPU_SMOOTH_NORMALS ? "smooth" : "kernel");
+            ShowInfo = 1;
+        }
+        break;
+
     case 'q':
     case 27:
         shutdown_opencl();
@@ -2929,11 +3058,24 @@ int init(int gpu)
         exit (err);
     }
 
-    err = setup_opencl(gpu);
-    if (err != GL_NO_ERROR)
+    if (!UseHost)
     {
-        printf ("Failed to setup OpenCL state! Error %d\n", err);
-        exit (err);
+        err = setup_opencl(gpu);
+        if (err != GL_NO_ERROR)
+        {
+            printf ("Warning: Failed to setup OpenCL state! Error %d.  Displacing on the host instead.\n", err);
+            UseHost = 1;
+        }
+    }
+
+    if (UseHost)
+    {
+        err = setup_host();
+        if (err != CL_SUCCESS)
+        {
+            printf ("Failed to setup host displacement! Error %d\n", err);
+            exit (err);
+        }
     }
 
     return CL_SUCCESS;
@@ -2942,6 +3084,13 @@ int init(int gpu)
 int main(int argc, char** argv)
 {
     int use_gpu = 1;
+    int i;
+
+    for (i = 1; i < argc && argv[i]; i++)
+    {
+        if (strstr(argv[i], "host"))
+            UseHost = 1;
+    }
     
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
@@ -0,0 +1,966 @@
+//
+// File:       displacement_cpu.c
+//
+// Abstract:   A multi-threaded CPU version of the displace kernel which evaluates ridged
+//             multifractal noise for four vertices at a time with SSE or NEON, and keeps every
+//             octave so that parameter changes only recompute what depends on them.  See
+//             displacement_cpu.h.
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "displacement_cpu.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+// The sample offsets and lattice tables of displacement_kernel.cl.
+#define PHASE_OFFSET            (100.0f)
+#define THRESHOLD               (0.5f)
+#define OFFSET                  (1.0f)
+#define P_MASK                  (255)
+#define G_MASK                  (15)
+
+#define MAX_SAMPLES             (4)
+#define MAX_LEVELS              (DISPLACEMENT_CPU_MAX_OCTAVES + 1)
+#define MIN_RESOLUTION          (3)
+#define MAX_RESOLUTION          (12)
+
+// Grid points handed to a thread at a time; tiles are made of whole rows.
+#define TILE_POINTS             (4096)
+#define MAX_THREADS             (64)
+
+#define ALWAYS_INLINE           static inline __attribute__((always_inline))
+
+static const int P[512] =
+{
+    151,160,137,91,90,15,
+    131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,8,99,37,240,21,10,23,
+    190, 6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,35,11,32,57,177,33,
+    88,237,149,56,87,174,20,125,136,171,168, 68,175,74,165,71,134,139,48,27,166,
+    77,146,158,231,83,111,229,122,60,211,133,230,220,105,92,41,55,46,245,40,244,
+    102,143,54, 65,25,63,161, 1,216,80,73,209,76,132,187,208, 89,18,169,200,196,
+    135,130,116,188,159,86,164,100,109,198,173,186, 3,64,52,217,226,250,124,123,
+    5,202,38,147,118,126,255,82,85,212,207,206,59,227,47,16,58,17,182,189,28,42,
+    223,183,170,213,119,248,152, 2,44,154,163, 70,221,153,101,155,167, 43,172,9,
+    129,22,39,253, 19,98,108,110,79,113,224,232,178,185, 112,104,218,246,97,228,
+    251,34,242,193,238,210,144,12,191,179,162,241, 81,51,145,235,249,14,239,107,
+    49,192,214, 31,181,199,106,157,184, 84,204,176,115,121,50,45,127, 4,150,254,
+    138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180,
+    151,160,137,91,90,15,
+    131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,8,99,37,240,21,10,23,
+    190, 6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,35,11,32,57,177,33,
+    88,237,149,56,87,174,20,125,136,171,168, 68,175,74,165,71,134,139,48,27,166,
+    77,146,158,231,83,111,229,122,60,211,133,230,220,105,92,41,55,46,245,40,244,
+    102,143,54, 65,25,63,161, 1,216,80,73,209,76,132,187,208, 89,18,169,200,196,
+    135,130,116,188,159,86,164,100,109,198,173,186, 3,64,52,217,226,250,124,123,
+    5,202,38,147,118,126,255,82,85,212,207,206,59,227,47,16,58,17,182,189,28,42,
+    223,183,170,213,119,248,152, 2,44,154,163, 70,221,153,101,155,167, 43,172,9,
+    129,22,39,253, 19,98,108,110,79,113,224,232,178,185, 112,104,218,246,97,228,
+    251,34,242,193,238,210,144,12,191,179,162,241, 81,51,145,235,249,14,239,107,
+    49,192,214, 31,181,199,106,157,184, 84,204,176,115,121,50,45,127, 4,150,254,
+    138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180,
+};
+
+static const float G[16][3] =
+{
+    { +1.0f, +1.0f, +0.0f }, { -1.0f, +1.0f, +0.0f }, { +1.0f, -1.0f, +0.0f }, { -1.0f, -1.0f, +0.0f },
+    { +1.0f, +0.0f, +1.0f }, { -1.0f, +0.0f, +1.0f }, { +1.0f, +0.0f, -1.0f }, { -1.0f, +0.0f, -1.0f },
+    { +0.0f, +1.0f, +1.0f }, { +0.0f, -1.0f, +1.0f }, { +0.0f, +1.0f, -1.0f }, { +0.0f, -1.0f, -1.0f },
+    { +1.0f, +1.0f, +0.0f }, { -1.0f, +1.0f, +0.0f }, { +0.0f, -1.0f, +1.0f }, { +0.0f, -1.0f, -1.0f },
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Four float lanes, one vertex per lane.
+
+#if defined(__SSE2__)
+
+typedef __m128 vec4;
+
+ALWAYS_INLINE vec4 v_set(float a)                   { return _mm_set1_ps(a); }
+ALWAYS_INLINE vec4 v_load(const float *p)           { return _mm_loadu_ps(p); }
+ALWAYS_INLINE void v_store(float *p, vec4 a)        { _mm_storeu_ps(p, a); }
+ALWAYS_INLINE vec4 v_add(vec4 a, vec4 b)            { return _mm_add_ps(a, b); }
+ALWAYS_INLINE vec4 v_sub(vec4 a, vec4 b)            { return _mm_sub_ps(a, b); }
+ALWAYS_INLINE vec4 v_mul(vec4 a, vec4 b)            { return _mm_mul_ps(a, b); }
+ALWAYS_INLINE vec4 v_div(vec4 a, vec4 b)            { return _mm_div_ps(a, b); }
+ALWAYS_INLINE vec4 v_min(vec4 a, vec4 b)            { return _mm_min_ps(a, b); }
+ALWAYS_INLINE vec4 v_max(vec4 a, vec4 b)            { return _mm_max_ps(a, b); }
+ALWAYS_INLINE vec4 v_sqrt(vec4 a)                   { return _mm_sqrt_ps(a); }
+ALWAYS_INLINE vec4 v_abs(vec4 a)                    { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+// a where it is positive and 1 elsewhere.
+ALWAYS_INLINE vec4
+v_positive_or_one(vec4 a)
+{
+    __m128 m = _mm_cmpgt_ps(a, _mm_setzero_ps());
+    return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, _mm_set1_ps(1.0f)));
+}
+
+// Round towards minus infinity, returning the result as floats and as
+// integers.  The sample points are far below 2^31.
+ALWAYS_INLINE vec4
+v_floor(vec4 a, int32_t i[4])
+{
+    __m128i t = _mm_cvttps_epi32(a);
+    __m128 f = _mm_cvtepi32_ps(t);
+    __m128 m = _mm_cmpgt_ps(f, a);
+    t = _mm_add_epi32(t, _mm_castps_si128(m));
+    _mm_storeu_si128((__m128i *) i, t);
+    return _mm_sub_ps(f, _mm_and_ps(m, _mm_set1_ps(1.0f)));
+}
+
+ALWAYS_INLINE vec4
+v_gather(const float *p0, const float *p1, const float *p2, const float *p3)
+{
+    return _mm_setr_ps(*p0, *p1, *p2, *p3);
+}
+
+// Turn four lanes of x, y, z and w into four float4s.
+ALWAYS_INLINE void
+v_transpose(vec4 *x, vec4 *y, vec4 *z, vec4 *w)
+{
+    _MM_TRANSPOSE4_PS(*x, *y, *z, *w);
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+typedef float32x4_t vec4;
+
+ALWAYS_INLINE vec4 v_set(float a)                   { return vdupq_n_f32(a); }
+ALWAYS_INLINE vec4 v_load(const float *p)           { return vld1q_f32(p); }
+ALWAYS_INLINE void v_store(float *p, vec4 a)        { vst1q_f32(p, a); }
+ALWAYS_INLINE vec4 v_add(vec4 a, vec4 b)            { return vaddq_f32(a, b); }
+ALWAYS_INLINE vec4 v_sub(vec4 a, vec4 b)            { return vsubq_f32(a, b); }
+ALWAYS_INLINE vec4 v_mul(vec4 a, vec4 b)            { return vmulq_f32(a, b); }
+ALWAYS_INLINE vec4 v_div(vec4 a, vec4 b)            { return vdivq_f32(a, b); }
+ALWAYS_INLINE vec4 v_min(vec4 a, vec4 b)            { return vminq_f32(a, b); }
+ALWAYS_INLINE vec4 v_max(vec4 a, vec4 b)            { return vmaxq_f32(a, b); }
+ALWAYS_INLINE vec4 v_sqrt(vec4 a)                   { return vsqrtq_f32(a); }
+ALWAYS_INLINE vec4 v_abs(vec4 a)                    { return vabsq_f32(a); }
+
+ALWAYS_INLINE vec4
+v_positive_or_one(vec4 a)
+{
+    return vbslq_f32(vcgtq_f32(a, vdupq_n_f32(0.0f)), a, vdupq_n_f32(1.0f));
+}
+
+ALWAYS_INLINE vec4
+v_floor(vec4 a, int32_t i[4])
+{
+    float32x4_t f = vrndmq_f32(a);
+    vst1q_s32(i, vcvtq_s32_f32(f));
+    return f;
+}
+
+ALWAYS_INLINE vec4
+v_gather(const float *p0, const float *p1, const float *p2, const float *p3)
+{
+    float32x4_t r = vld1q_dup_f32(p0);
+    r = vld1q_lane_f32(p1, r, 1);
+    r = vld1q_lane_f32(p2, r, 2);
+    return vld1q_lane_f32(p3, r, 3);
+}
+
+ALWAYS_INLINE void
+v_transpose(vec4 *x, vec4 *y, vec4 *z, vec4 *w)
+{
+    float32x4x2_t xy = vzipq_f32(*x, *y);
+    float32x4x2_t zw = vzipq_f32(*z, *w);
+    *x = vcombine_f32(vget_low_f32(xy.val[0]), vget_low_f32(zw.val[0]));
+    *y = vcombine_f32(vget_high_f32(xy.val[0]), vget_high_f32(zw.val[0]));
+    *z = vcombine_f32(vget_low_f32(xy.val[1]), vget_low_f32(zw.val[1]));
+    *w = vcombine_f32(vget_high_f32(xy.val[1]), vget_high_f32(zw.val[1]));
+}
+
+#else
+
+typedef struct { float f[4]; } vec4;
+
+#define MAP1(expr)              { vec4 r; int i; for (i = 0; i < 4; i++) r.f[i] = (expr); return r; }
+
+ALWAYS_INLINE vec4 v_set(float a)                   MAP1(a)
+ALWAYS_INLINE vec4 v_load(const float *p)           MAP1(p[i])
+ALWAYS_INLINE void v_store(float *p, vec4 a)        { memcpy(p, a.f, sizeof(a.f)); }
+ALWAYS_INLINE vec4 v_add(vec4 a, vec4 b)            MAP1(a.f[i] + b.f[i])
+ALWAYS_INLINE vec4 v_sub(vec4 a, vec4 b)            MAP1(a.f[i] - b.f[i])
+ALWAYS_INLINE vec4 v_mul(vec4 a, vec4 b)            MAP1(a.f[i] * b.f[i])
+ALWAYS_INLINE vec4 v_div(vec4 a, vec4 b)            MAP1(a.f[i] / b.f[i])
+ALWAYS_INLINE vec4 v_min(vec4 a, vec4 b)            MAP1(a.f[i] < b.f[i] ? a.f[i] : b.f[i])
+ALWAYS_INLINE vec4 v_max(vec4 a, vec4 b)            MAP1(a.f[i] > b.f[i] ? a.f[i] : b.f[i])
+ALWAYS_INLINE vec4 v_sqrt(vec4 a)                   MAP1(sqrtf(a.f[i]))
+ALWAYS_INLINE vec4 v_abs(vec4 a)                    MAP1(fabsf(a.f[i]))
+ALWAYS_INLINE vec4 v_positive_or_one(vec4 a)        MAP1(a.f[i] > 0.0f ? a.f[i] : 1.0f)
+
+ALWAYS_INLINE vec4
+v_floor(vec4 a, int32_t i[4])
+{
+    int k;
+    for (k = 0; k < 4; k++)
+    {
+        a.f[k] = floorf(a.f[k]);
+        i[k] = (int32_t) a.f[k];
+    }
+    return a;
+}
+
+ALWAYS_INLINE vec4
+v_gather(const float *p0, const float *p1, const float *p2, const float *p3)
+{
+    vec4 r = { { *p0, *p1, *p2, *p3 } };
+    return r;
+}
+
+ALWAYS_INLINE void
+v_transpose(vec4 *x, vec4 *y, vec4 *z, vec4 *w)
+{
+    vec4 *rows[4] = { x, y, z, w };
+    float m[4][4];
+    int i, j;
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++)
+            m[j][i] = rows[i]->f[j];
+    for (i = 0; i < 4; i++)
+        memcpy(rows[i]->f, m[i], sizeof(m[i]));
+}
+
+#undef MAP1
+
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+ALWAYS_INLINE vec4
+v_mix(vec4 a, vec4 b, vec4 t)
+{
+    return v_add(a, v_mul(t, v_sub(b, a)));
+}
+
+ALWAYS_INLINE vec4
+v_smooth(vec4 t)
+{
+    vec4 p = v_add(v_mul(t, v_sub(v_mul(t, v_set(6.0f)), v_set(15.0f))), v_set(10.0f));
+    return v_mul(v_mul(v_mul(t, t), t), p);
+}
+
+// gradient_noise3d() for four points.  The kernel samples at float4
+// positions whose w is 1, or 2 for the offset samples, and its gradients have
+// a w of 1, so the fractional part of w times the frequency is added to the
+// dot product at every corner; fw is that fraction.
+ALWAYS_INLINE vec4
+v_gradient_noise3d(vec4 x, vec4 y, vec4 z, float fw)
+{
+    int32_t ix[4], iy[4], iz[4];
+    const float *g[8][4];
+    vec4 n[8], fx, fy, fz, w = v_set(fw), one = v_set(1.0f);
+    int lane, c;
+
+    fx = v_sub(x, v_floor(x, ix));
+    fy = v_sub(y, v_floor(y, iy));
+    fz = v_sub(z, v_floor(z, iz));
+
+    // Hash the eight corners of each lane's cell; corner c is at x + (c >> 2),
+    // y + ((c >> 1) & 1) and z + (c & 1), as n000 to n111 in the kernel.
+    for (lane = 0; lane < 4; lane++)
+    {
+        int i = ix[lane] & P_MASK, j = iy[lane] & P_MASK, k = iz[lane] & P_MASK;
+        int z0 = P[k], z1 = P[k + 1];
+        int y00 = P[j + z0], y01 = P[j + z1], y10 = P[j + 1 + z0], y11 = P[j + 1 + z1];
+        g[0][lane] = G[P[i + y00] & G_MASK];
+        g[1][lane] = G[P[i + y01] & G_MASK];
+        g[2][lane] = G[P[i + y10] & G_MASK];
+        g[3][lane] = G[P[i + y11] & G_MASK];
+        g[4][lane] = G[P[i + 1 + y00] & G_MASK];
+        g[5][lane] = G[P[i + 1 + y01] & G_MASK];
+        g[6][lane] = G[P[i + 1 + y10] & G_MASK];
+        g[7][lane] = G[P[i + 1 + y11] & G_MASK];
+    }
+
+    for (c = 0; c < 8; c++)
+    {
+        vec4 vx = (c & 4) ? v_sub(fx, one) : fx;
+        vec4 vy = (c & 2) ? v_sub(fy, one) : fy;
+        vec4 vz = (c & 1) ? v_sub(fz, one) : fz;
+        vec4 gx = v_gather(&g[c][0][0], &g[c][1][0], &g[c][2][0], &g[c][3][0]);
+        vec4 gy = v_gather(&g[c][0][1], &g[c][1][1], &g[c][2][1], &g[c][3][1]);
+        vec4 gz = v_gather(&g[c][0][2], &g[c][1][2], &g[c][2][2], &g[c][3][2]);
+        n[c] = v_add(v_add(v_add(v_mul(vx, gx), v_mul(vy, gy)), v_mul(vz, gz)), w);
+    }
+
+    {
+        vec4 sx = v_smooth(fx), sy = v_smooth(fy), sz = v_smooth(fz);
+        vec4 n4x = v_mix(n[0], n[4], sx), n4y = v_mix(n[1], n[5], sx);
+        vec4 n4z = v_mix(n[2], n[6], sx), n4w = v_mix(n[3], n[7], sx);
+        vec4 n2x = v_mix(n4x, n4z, sy), n2y = v_mix(n4y, n4w, sy);
+        return v_sub(v_set(0.5f), v_mul(v_set(0.5f), v_mix(n2x, n2y, sz)));
+    }
+}
+
+// One octave of ridgedmultifractal3d() before weighting.
+ALWAYS_INLINE vec4
+v_ridge(vec4 x, vec4 y, vec4 z, float frequency, float fw)
+{
+    vec4 f = v_set(frequency);
+    vec4 n = v_gradient_noise3d(v_mul(x, f), v_mul(y, f), v_mul(z, f), fw);
+    vec4 signal = v_sub(v_set(OFFSET), v_abs(v_sub(v_set(1.0f), v_mul(v_set(2.0f), n))));
+    return v_mul(signal, signal);
+}
+
+ALWAYS_INLINE vec4
+v_normalized(vec4 *x, vec4 *y, vec4 *z)
+{
+    vec4 d = v_positive_or_one(v_sqrt(v_add(v_add(v_mul(*x, *x), v_mul(*y, *y)), v_mul(*z, *z))));
+    *x = v_div(*x, d);
+    *y = v_div(*y, d);
+    *z = v_div(*z, d);
+    return d;
+}
+
+// Store four vertices and their normals into quad strip slots, eight floats
+// apart since the strips interleave two rows of the sphere.
+ALWAYS_INLINE void
+v_store_strip(float *vertices, float *normals, vec4 vx, vec4 vy, vec4 vz, vec4 nx, vec4 ny, vec4 nz)
+{
+    vec4 vw = v_set(1.0f), nw = v_set(1.0f);
+    v_transpose(&vx, &vy, &vz, &vw);
+    v_transpose(&nx, &ny, &nz, &nw);
+    v_store(vertices + 0, vx);
+    v_store(vertices + 8, vy);
+    v_store(vertices + 16, vz);
+    v_store(vertices + 24, vw);
+    v_store(normals + 0, nx);
+    v_store(normals + 8, ny);
+    v_store(normals + 16, nz);
+    v_store(normals + 24, nw);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+struct displacement_cpu
+{
+    int stacks;                         // rows of the sphere, pole to pole
+    int slices;                         // columns; the last repeats the first
+    int points;                         // stacks * slices
+    int samples;                        // noise samples per vertex, 4 or 1
+    displacement_cpu_normals normals;
+    int threads;
+
+    float *base[3];                     // undisplaced positions
+
+    // value[k][s] is the noise of sample s summed over octaves 0 to k, and
+    // levels[s] is the number of these that are valid.  signal0[s] is the
+    // signal of octave 0, and signal[s] that of octave levels[s] - 1, from
+    // which further octaves continue.
+    float *value[MAX_LEVELS][MAX_SAMPLES];
+    float *signal0[MAX_SAMPLES];
+    float *signal[MAX_SAMPLES];
+    int levels[MAX_SAMPLES];
+
+    // The parameters the cached octaves were computed with.
+    int cached;
+    float frequency;
+    float phase;
+    float lacunarity;
+    float roughness;                    // divided by amplitude, as in the kernel
+
+    // What the last output was made from.
+    int output_valid;
+    int output_levels;
+    float output_amplitude;
+
+    // Displaced positions for smooth normals, with a column of padding at
+    // each end of every row holding the neighbouring column across the seam.
+    float *displaced[3];
+    int stride;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Work shared by the threads of one pass.
+typedef struct
+{
+    displacement_cpu *d;
+    void (*run)(void *job, int first_row, int rows);
+    int rows_per_tile;
+    long tile_count;
+    volatile long next_tile;
+
+    float *vertices;
+    float *normals;
+
+    int levels;                         // octaves to sum, counting the first
+    int first_level[MAX_SAMPLES];       // first octave to compute per sample
+    float frequency[MAX_LEVELS];
+    float fraction_w[MAX_LEVELS][2];    // for w of 1 and 2
+    float octave_scale;
+    float shift;                        // phase + 100
+    float roughness;
+    float amplitude;
+} update_job;
+
+// Compute the missing octaves of every sample for rows of the sphere.
+static void
+update_noise(const update_job *job, int first, int count)
+{
+    const displacement_cpu *d = job->d;
+    int s, i, k;
+
+    for (s = 0; s < d->samples; s++)
+    {
+        int k0 = job->first_level[s];
+        float dx = s == 1 ? job->roughness : 0.0f;
+        float dy = s == 2 ? job->roughness : 0.0f;
+        float dz = s == 3 ? job->roughness : 0.0f;
+        int w = s == 0 ? 0 : 1;
+
+        if (k0 >= job->levels)
+            continue;
+
+        for (i = first; i < first + count; i += 4)
+        {
+            vec4 shift = v_set(job->shift);
+            vec4 x = v_add(v_add(v_load(d->base[0] + i), shift), v_set(dx));
+            vec4 y = v_add(v_add(v_load(d->base[1] + i), shift), v_set(dy));
+            vec4 z = v_add(v_add(v_load(d->base[2] + i), shift), v_set(dz));
+            vec4 signal, value;
+
+            if (k0 == 0)
+            {
+                signal = v_ridge(x, y, z, job->frequency[0], job->fraction_w[0][w]);
+                value = signal;
+                v_store(d->signal0[s] + i, signal);
+                v_store(d->value[0][s] + i, value);
+            }
+            else
+            {
+                signal = v_load((k0 == 1 ? d->signal0[s] : d->signal[s]) + i);
+                value = v_load(d->value[k0 - 1][s] + i);
+            }
+
+            for (k = k0 > 1 ? k0 : 1; k < job->levels; k++)
+            {
+                vec4 weight = v_min(v_max(v_mul(signal, v_set(THRESHOLD)), v_set(0.0f)), v_set(1.0f));
+                signal = v_mul(v_ridge(x, y, z, job->frequency[k], job->fraction_w[k][w]), weight);
+                value = v_add(value, v_mul(signal, v_set(job->octave_scale)));
+                v_store(d->value[k][s] + i, value);
+            }
+
+            if (job->levels > 1)
+                v_store(d->signal[s] + i, signal);
+        }
+    }
+}
+
+// displace, for sphere rows computed with four samples per vertex.
+static void
+run_kernel_normals(void *arg, int first_row, int rows)
+{
+    const update_job *job = arg;
+    const displacement_cpu *d = job->d;
+    const float *f0 = d->value[job->levels - 1][0], *f1 = d->value[job->levels - 1][1];
+    const float *f2 = d->value[job->levels - 1][2], *f3 = d->value[job->levels - 1][3];
+    vec4 amplitude = v_set(job->amplitude), roughness = v_set(job->roughness);
+    int r, j;
+
+    update_noise(job, first_row * d->slices, rows * d->slices);
+
+    for (r = first_row; r < first_row + rows; r++)
+    {
+        for (j = 0; j < d->slices; j += 4)
+        {
+            int i = r * d->slices + j;
+            vec4 px = v_load(d->base[0] + i), py = v_load(d->base[1] + i), pz = v_load(d->base[2] + i);
+            vec4 n0 = v_load(f0 + i), n1 = v_load(f1 + i), n2 = v_load(f2 + i), n3 = v_load(f3 + i);
+            vec4 displacement = v_div(v_add(v_add(v_add(n0, n1), n2), n3), v_set(4.0f));
+            vec4 scale = v_mul(amplitude, displacement);
+            vec4 vx = v_add(px, v_mul(scale, px));
+            vec4 vy = v_add(py, v_mul(scale, py));
+            vec4 vz = v_add(pz, v_mul(scale, pz));
+            vec4 nx = v_div(v_sub(px, v_sub(n1, n0)), roughness);
+            vec4 ny = v_div(v_sub(py, v_sub(n2, n0)), roughness);
+            vec4 nz = v_div(v_sub(pz, v_sub(n3, n0)), roughness);
+            v_normalized(&nx, &ny, &nz);
+
+            // Row r starts strip r and ends strip r - 1.
+            if (r < d->stacks - 1)
+                v_store_strip(job->vertices + (size_t) (r * d->slices + j) * 8,
+                              job->normals + (size_t) (r * d->slices + j) * 8,
+                              vx, vy, vz, nx, ny, nz);
+            if (r > 0)
+                v_store_strip(job->vertices + (size_t) ((r - 1) * d->slices + j) * 8 + 4,
+                              job->normals + (size_t) ((r - 1) * d->slices + j) * 8 + 4,
+                              vx, vy, vz, nx, ny, nz);
+        }
+    }
+}
+
+// First pass of smooth normals: displace rows with one sample per vertex.
+static void
+run_displace(void *arg, int first_row, int rows)
+{
+    const update_job *job = arg;
+    const displacement_cpu *d = job->d;
+    const float *f0 = d->value[job->levels - 1][0];
+    vec4 amplitude = v_set(job->amplitude);
+    int r, j, c;
+
+    update_noise(job, first_row * d->slices, rows * d->slices);
+
+    for (r = first_row; r < first_row + rows; r++)
+    {
+        for (j = 0; j < d->slices; j += 4)
+        {
+            int i = r * d->slices + j;
+            vec4 scale = v_mul(amplitude, v_load(f0 + i));
+            for (c = 0; c < 3; c++)
+            {
+                vec4 p = v_load(d->base[c] + i);
+                v_store(d->displaced[c] + r * d->stride + 1 + j, v_add(p, v_mul(scale, p)));
+            }
+        }
+
+        // Column slices - 1 is column 0 again, so the neighbours across the
+        // seam are columns slices - 2 and 1.
+        for (c = 0; c < 3; c++)
+        {
+            float *row = d->displaced[c] + r * d->stride;
+            row[0] = row[d->slices - 1];
+            row[d->slices + 1] = row[2];
+        }
+    }
+}
+
+// The normal at a pole, from the fan of triangles around it.
+static void
+pole_normal(const displacement_cpu *d, int pole, int ring, float n[3])
+{
+    const float *p = d->displaced[0] + pole * d->stride + 1;
+    const float *q = d->displaced[1] + pole * d->stride + 1;
+    const float *t = d->displaced[2] + pole * d->stride + 1;
+    int a = ring * d->stride, j;
+    float len;
+
+    n[0] = n[1] = n[2] = 0.0f;
+    for (j = 0; j < d->slices - 1; j++)
+    {
+        float ax = p[a + j] - p[0], ay = q[a + j] - q[0], az = t[a + j] - t[0];
+        float bx = p[a + j + 1] - p[0], by = q[a + j + 1] - q[0], bz = t[a + j + 1] - t[0];
+        n[0] += ay * bz - az * by;
+        n[1] += az * bx - ax * bz;
+        n[2] += ax * by - ay * bx;
+    }
+
+    // Point away from the centre, whichever way the ring winds.
+    len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (n[0] * p[0] + n[1] * q[0] + n[2] * t[0] < 0.0f)
+        len = -len;
+    if (len != 0.0f)
+    {
+        n[0] /= len;
+        n[1] /= len;
+        n[2] /= len;
+    }
+}
+
+// Second pass of smooth normals: take the normal of each vertex from the
+// central differences of its displaced neighbours, and write the strips.
+static void
+run_smooth_normals(void *arg, int first_row, int rows)
+{
+    const update_job *job = arg;
+    const displacement_cpu *d = job->d;
+    int r, j;
+
+    for (r = first_row; r < first_row + rows; r++)
+    {
+        const float *x = d->displaced[0] + r * d->stride + 1;
+        const float *y = d->displaced[1] + r * d->stride + 1;
+        const float *z = d->displaced[2] + r * d->stride + 1;
+        int pole = r == 0 || r == d->stacks - 1;
+        float n[3] = { 0.0f, 0.0f, 0.0f };
+
+        if (pole)
+            pole_normal(d, r, r == 0 ? 1 : -1, n);
+
+        for (j = 0; j < d->slices; j += 4)
+        {
+            vec4 vx = v_load(x + j), vy = v_load(y + j), vz = v_load(z + j);
+            vec4 nx, ny, nz;
+
+            if (pole)
+            {
+                nx = v_set(n[0]);
+                ny = v_set(n[1]);
+                nz = v_set(n[2]);
+            }
+            else
+            {
+                int up = d->stride, down = -d->stride;
+
+                // Along the meridian (towards +y) and along the parallel.
+                vec4 ux = v_sub(v_load(x + up + j), v_load(x + down + j));
+                vec4 uy = v_sub(v_load(y + up + j), v_load(y + down + j));
+                vec4 uz = v_sub(v_load(z + up + j), v_load(z + down + j));
+                vec4 tx = v_sub(v_load(x + j + 1), v_load(x + j - 1));
+                vec4 ty = v_sub(v_load(y + j + 1), v_load(y + j - 1));
+                vec4 tz = v_sub(v_load(z + j + 1), v_load(z + j - 1));
+                nx = v_sub(v_mul(uy, tz), v_mul(uz, ty));
+                ny = v_sub(v_mul(uz, tx), v_mul(ux, tz));
+                nz = v_sub(v_mul(ux, ty), v_mul(uy, tx));
+                v_normalized(&nx, &ny, &nz);
+            }
+
+            if (r < d->stacks - 1)
+                v_store_strip(job->vertices + (size_t) (r * d->slices + j) * 8,
+                              job->normals + (size_t) (r * d->slices + j) * 8,
+                              vx, vy, vz, nx, ny, nz);
+            if (r > 0)
+                v_store_strip(job->vertices + (size_t) ((r - 1) * d->slices + j) * 8 + 4,
+                              job->normals + (size_t) ((r - 1) * d->slices + j) * 8 + 4,
+                              vx, vy, vz, nx, ny, nz);
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+static void *
+pass_worker(void *arg)
+{
+    update_job *job = arg;
+    int rows = job->d->stacks;
+    long tile;
+
+    while ((tile = __sync_fetch_and_add(&job->next_tile, 1)) < job->tile_count)
+    {
+        int first = (int) tile * job->rows_per_tile;
+        int count = rows - first < job->rows_per_tile ? rows - first : job->rows_per_tile;
+        job->run(job, first, count);
+    }
+    return NULL;
+}
+
+static int
+processor_count(void)
+{
+    static int count = 0;
+    if (!count)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        count = n > 0 ? (int) n : 1;
+    }
+    return count;
+}
+
+// Run job->run over every row of the sphere, in tiles of whole rows.
+static void
+run_pass(update_job *job, void (*run)(void *job, int first_row, int rows))
+{
+    pthread_t workers[MAX_THREADS];
+    int threads = job->d->threads, i, started = 0;
+
+    job->run = run;
+    job->rows_per_tile = TILE_POINTS / job->d->slices;
+    if (job->rows_per_tile < 1)
+        job->rows_per_tile = 1;
+    job->tile_count = (job->d->stacks + job->rows_per_tile - 1) / job->rows_per_tile;
+    job->next_tile = 0;
+
+    if (threads <= 0)
+        threads = processor_count();
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if (threads > job->tile_count)
+        threads = (int) job->tile_count;
+
+    for (i = 1; i < threads; i++)
+        if (pthread_create(&workers[started], NULL, pass_worker, job) == 0)
+            started++;
+    pass_worker(job);
+    for (i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+displacement_cpu *
+displacement_cpu_create(int resolution, displacement_cpu_normals normals, int threads)
+{
+    displacement_cpu *d;
+    float pi = M_PI;
+    int subdiv, r, j, c, s;
+
+    if (resolution < MIN_RESOLUTION || resolution > MAX_RESOLUTION ||
+        (normals != DISPLACEMENT_CPU_KERNEL_NORMALS && normals != DISPLACEMENT_CPU_SMOOTH_NORMALS))
+        return NULL;
+
+    d = calloc(1, sizeof(*d));
+    if (!d)
+        return NULL;
+
+    subdiv = 1 << resolution;
+    d->stacks = subdiv / 2;
+    d->slices = subdiv;
+    d->points = d->stacks * d->slices;
+    d->samples = normals == DISPLACEMENT_CPU_KERNEL_NORMALS ? 4 : 1;
+    d->normals = normals;
+    d->threads = threads;
+    d->stride = d->slices + 2;
+
+    for (c = 0; c < 3; c++)
+    {
+        d->base[c] = malloc(sizeof(float) * d->points);
+        if (!d->base[c])
+            goto fail;
+        if (normals == DISPLACEMENT_CPU_SMOOTH_NORMALS)
+        {
+            d->displaced[c] = malloc(sizeof(float) * d->stacks * d->stride);
+            if (!d->displaced[c])
+                goto fail;
+        }
+    }
+    for (s = 0; s < d->samples; s++)
+    {
+        d->signal0[s] = malloc(sizeof(float) * d->points);
+        d->signal[s] = malloc(sizeof(float) * d->points);
+        if (!d->signal0[s] || !d->signal[s])
+            goto fail;
+    }
+
+    // The distinct vertices of fill_sphere(), computed the same way.  Row r
+    // is the first row of strip r and the second of strip r - 1.
+    for (r = 0; r < d->stacks; r++)
+    {
+        float t = r / (d->stacks - 1.f);
+        float phi = pi * t - pi / 2;
+
+        for (j = 0; j < d->slices; j++)
+        {
+            float u = j / (d->slices - 1.f);
+            float theta = 2 * pi * u;
+            float v[3], len;
+
+            v[0] = cos(phi) * cos(theta);
+            v[1] = sin(phi);
+            v[2] = cos(phi) * sin(theta);
+
+            len = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            for (c = 0; c < 3; c++)
+            {
+                if (len != 0.0f)
+                    v[c] /= len;
+                d->base[c][r * d->slices + j] = v[c];
+            }
+        }
+    }
+
+    return d;
+
+fail:
+    displacement_cpu_destroy(d);
+    return NULL;
+}
+
+void
+displacement_cpu_destroy(displacement_cpu *d)
+{
+    int c, s, k;
+
+    if (!d)
+        return;
+    for (c = 0; c < 3; c++)
+    {
+        free(d->base[c]);
+        free(d->displaced[c]);
+    }
+    for (s = 0; s < MAX_SAMPLES; s++)
+    {
+        free(d->signal0[s]);
+        free(d->signal[s]);
+        for (k = 0; k < MAX_LEVELS; k++)
+            free(d->value[k][s]);
+    }
+    free(d);
+}
+
+int
+displacement_cpu_vertex_count(const displacement_cpu *d)
+{
+    return (d->stacks - 1) * d->slices * 2;
+}
+
+void
+displacement_cpu_invalidate(displacement_cpu *d)
+{
+    d->cached = 0;
+    d->output_valid = 0;
+}
+
+int
+displacement_cpu_update(displacement_cpu *d, const displacement_cpu_params *params,
+                        float *vertices, float *normals)
+{
+    update_job job;
+    float roughness = params->roughness / params->amplitude;
+    float fi = 0.0f;
+    int iterations = (int) params->octaves, s, k, work = 0, full;
+
+    if (iterations < 0)
+        iterations = 0;
+    if (iterations > DISPLACEMENT_CPU_MAX_OCTAVES)
+        return -1;
+
+    // Smooth normals take no offset samples, so roughness does not matter.
+    if (d->normals == DISPLACEMENT_CPU_SMOOTH_NORMALS)
+        roughness = 0.0f;
+
+    // Drop the cached octaves that depend on a parameter that changed.  Every
+    // octave depends on frequency and phase, octaves after the first on
+    // lacunarity, and the offset samples on roughness.  Increment is never
+    // used, since the kernel scales octaves by pow(lacunarity, -fi * increment)
+    // without ever advancing fi from 0.
+    if (!d->cached || params->frequency != d->frequency || params->phase != d->phase)
+        full = 1;
+    else
+    {
+        if (params->lacunarity != d->lacunarity)
+            for (s = 0; s < d->samples; s++)
+                d->levels[s] = d->levels[s] < 1 ? d->levels[s] : 1;
+        if (roughness != d->roughness)
+            for (s = 1; s < d->samples; s++)
+                d->levels[s] = 0;
+
+        // When no sample keeps an octave, continuing from the cache saves
+        // nothing, so fall back to the full pass below.
+        full = 1;
+        for (s = 0; s < d->samples; s++)
+            if (d->levels[s] > 0)
+                full = 0;
+    }
+
+    // A full pass starts every sample from its first octave and never reads
+    // the cache, so it costs the same as an update after
+    // displacement_cpu_invalidate().
+    if (full)
+        for (s = 0; s < d->samples; s++)
+            d->levels[s] = 0;
+    d->cached = 1;
+    d->frequency = params->frequency;
+    d->phase = params->phase;
+    d->lacunarity = params->lacunarity;
+    d->roughness = roughness;
+
+    memset(&job, 0, sizeof(job));
+    job.d = d;
+    job.vertices = vertices;
+    job.normals = normals;
+    job.levels = iterations + 1;
+    for (s = 0; s < d->samples; s++)
+    {
+        job.first_level[s] = d->levels[s];
+        if (d->levels[s] < job.levels)
+            work = 1;
+        for (k = d->levels[s]; k < job.levels; k++)
+        {
+            if (!d->value[k][s])
+                d->value[k][s] = malloc(sizeof(float) * d->points);
+            if (!d->value[k][s])
+            {
+                d->levels[s] = 0;
+                d->output_valid = 0;
+                return -1;
+            }
+        }
+    }
+
+    if (!work && d->output_valid && d->output_levels == job.levels &&
+        d->output_amplitude == params->amplitude)
+        return 0;
+
+    // The frequency of each octave, multiplied up in the same order as the
+    // kernel, and the fraction that w adds to its noise.
+    job.frequency[0] = params->frequency;
+    for (k = 1; k < job.levels; k++)
+        job.frequency[k] = job.frequency[k - 1] * params->lacunarity;
+    for (k = 0; k < job.levels; k++)
+    {
+        float w1 = job.frequency[k], w2 = 2.0f * job.frequency[k];
+        job.fraction_w[k][0] = w1 - floorf(w1);
+        job.fraction_w[k][1] = w2 - floorf(w2);
+    }
+    job.octave_scale = powf(params->lacunarity, -fi * params->increment);
+    job.shift = params->phase + PHASE_OFFSET;
+    job.roughness = roughness;
+    job.amplitude = params->amplitude;
+
+    if (d->normals == DISPLACEMENT_CPU_KERNEL_NORMALS)
+    {
+        run_pass(&job, run_kernel_normals);
+    }
+    else
+    {
+        run_pass(&job, run_displace);
+        run_pass(&job, run_smooth_normals);
+    }
+
+    for (s = 0; s < d->samples; s++)
+        if (d->levels[s] < job.levels)
+            d->levels[s] = job.levels;
+    d->output_valid = 1;
+    d->output_levels = job.levels;
+    d->output_amplitude = params->amplitude;
+    return 1;
+}
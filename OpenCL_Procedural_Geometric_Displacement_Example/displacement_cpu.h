@@ -0,0 +1,143 @@
+//
+// File:       displacement_cpu.h
+//
+// Abstract:   Declares a multi-threaded CPU version of the displace kernel in
+//             displacement_kernel.cl, which pushes the vertices of the sphere built by fill_sphere()
+//             outwards with ridged multifractal noise.
+//
+//             Noise is evaluated four vertices at a time with SSE or NEON, once for each distinct
+//             vertex of the sphere rather than once for each vertex of its quad strips.  Every
+//             octave of every noise sample is kept, so that a change to a parameter recomputes
+//             only the octaves that depend on it: adding an octave evaluates one more octave,
+//             removing one evaluates none, and an update with unchanged parameters does nothing.
+//             A change that leaves no octave usable, such as a new phase, is a full update.
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __DISPLACEMENT_CPU_H__
+#define __DISPLACEMENT_CPU_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+// The most octaves that can be added to the first; displace has no limit,
+// but the example never goes beyond 7.
+//
+#define DISPLACEMENT_CPU_MAX_OCTAVES    (32)
+
+// The arguments of displace.
+//
+typedef struct
+{
+    float frequency;
+    float amplitude;
+    float phase;
+    float lacunarity;
+    float increment;
+    float octaves;
+    float roughness;
+} displacement_cpu_params;
+
+// How normals are computed.
+//
+typedef enum
+{
+    // As displace does: the noise is sampled at each vertex and at three
+    // points a distance of roughness / amplitude away, the vertex is pushed
+    // out by the mean of the four, and the normal is bent by their
+    // differences.  The results match the kernel.
+    //
+    DISPLACEMENT_CPU_KERNEL_NORMALS = 0,
+
+    // The noise is sampled once at each vertex, and each normal is the
+    // normal of the displaced surface, found from the displaced neighbours
+    // of its vertex.  This needs a quarter of the noise evaluations, and the
+    // normals follow the geometry that is drawn.  Roughness is not used.
+    //
+    DISPLACEMENT_CPU_SMOOTH_NORMALS = 1
+} displacement_cpu_normals;
+
+typedef struct displacement_cpu displacement_cpu;
+
+// Create the sphere that fill_sphere(resolution) builds, for resolutions
+// from 3 to 12.  threads is the most threads to use, counting the calling
+// thread; 0 uses one per online processor.
+//
+// Returns NULL if an argument is invalid or memory is short.
+//
+displacement_cpu *displacement_cpu_create(
+    int resolution, displacement_cpu_normals normals, int threads);
+
+void displacement_cpu_destroy(displacement_cpu *displacement);
+
+// The number of quad strip vertices that displacement_cpu_update() writes,
+// the VertexElements of fill_sphere().
+//
+int displacement_cpu_vertex_count(const displacement_cpu *displacement);
+
+// Displace the sphere, writing four floats per vertex into vertices and
+// normals in the layout of fill_sphere().  Both must hold the results of the
+// previous call, since an update with the same parameters leaves them alone.
+//
+// Returns 1 if vertices and normals were written, 0 if the parameters were
+// unchanged, or -1 if the octaves are out of range or memory is short.
+//
+int displacement_cpu_update(
+    displacement_cpu *displacement, const displacement_cpu_params *params,
+    float *vertices, float *normals);
+
+// Forget all cached noise, so that the next update recomputes everything.
+//
+void displacement_cpu_invalidate(displacement_cpu *displacement);
+
+/////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __DISPLACEMENT_CPU_H__
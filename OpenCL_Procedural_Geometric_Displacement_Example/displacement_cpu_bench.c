@@ -0,0 +1,637 @@
+//
+// File:       displacement_cpu_bench.c
+//
+// Abstract:   Validates the CPU displacement library in displacement_cpu.c against a scalar port
+//             of the displace kernel, through a sequence of parameter changes like those the
+//             keyboard makes, then sweeps the sphere resolution and reports the latency of each
+//             kind of incremental update next to that of a full update to the same parameters,
+//             timed alternately with it.  Only the validation decides whether it passes; the
+//             timings are for reading.
+//
+//             This program uses only standard C and POSIX threads and builds on any platform, for
+//             example:
+//
+//                 cc -O3 -march=native -std=gnu99 -o displacement_cpu_bench displacement_cpu_bench.c
+//             displacement_cpu.c -lpthread -lm
+//
+//             Usage:  displacement_cpu_bench [max_resolution [threads]]
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "displacement_cpu.h"
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Minimum time to spend timing each case, in seconds.
+static const double min_seconds = 0.25;
+
+// Largest difference allowed from the reference, in any component.
+#define TOLERANCE               (1e-4f)
+
+static const char *normal_names[] = { "kernel normals", "smooth normals" };
+
+// The initial settings of displacement.c.
+static const displacement_cpu_params default_params =
+{
+    1.0f,       // frequency
+    0.35f,      // amplitude
+    0.0f,       // phase
+    2.0f,       // lacunarity
+    1.5f,       // increment
+    5.5f,       // octaves
+    0.025f,     // roughness
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// A scalar port of displacement_kernel.cl, line for line.
+
+static const int P[512] =
+{
+    151,160,137,91,90,15,
+    131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,8,99,37,240,21,10,23,
+    190, 6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,35,11,32,57,177,33,
+    88,237,149,56,87,174,20,125,136,171,168, 68,175,74,165,71,134,139,48,27,166,
+    77,146,158,231,83,111,229,122,60,211,133,230,220,105,92,41,55,46,245,40,244,
+    102,143,54, 65,25,63,161, 1,216,80,73,209,76,132,187,208, 89,18,169,200,196,
+    135,130,116,188,159,86,164,100,109,198,173,186, 3,64,52,217,226,250,124,123,
+    5,202,38,147,118,126,255,82,85,212,207,206,59,227,47,16,58,17,182,189,28,42,
+    223,183,170,213,119,248,152, 2,44,154,163, 70,221,153,101,155,167, 43,172,9,
+    129,22,39,253, 19,98,108,110,79,113,224,232,178,185, 112,104,218,246,97,228,
+    251,34,242,193,238,210,144,12,191,179,162,241, 81,51,145,235,249,14,239,107,
+    49,192,214, 31,181,199,106,157,184, 84,204,176,115,121,50,45,127, 4,150,254,
+    138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180,
+    151,160,137,91,90,15,
+    131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,8,99,37,240,21,10,23,
+    190, 6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,35,11,32,57,177,33,
+    88,237,149,56,87,174,20,125,136,171,168, 68,175,74,165,71,134,139,48,27,166,
+    77,146,158,231,83,111,229,122,60,211,133,230,220,105,92,41,55,46,245,40,244,
+    102,143,54, 65,25,63,161, 1,216,80,73,209,76,132,187,208, 89,18,169,200,196,
+    135,130,116,188,159,86,164,100,109,198,173,186, 3,64,52,217,226,250,124,123,
+    5,202,38,147,118,126,255,82,85,212,207,206,59,227,47,16,58,17,182,189,28,42,
+    223,183,170,213,119,248,152, 2,44,154,163, 70,221,153,101,155,167, 43,172,9,
+    129,22,39,253, 19,98,108,110,79,113,224,232,178,185, 112,104,218,246,97,228,
+    251,34,242,193,238,210,144,12,191,179,162,241, 81,51,145,235,249,14,239,107,
+    49,192,214, 31,181,199,106,157,184, 84,204,176,115,121,50,45,127, 4,150,254,
+    138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180,
+};
+
+static const float G[16 * 4] =
+{
+    +1.0, +1.0, +0.0, 0.0, -1.0, +1.0, +0.0, 0.0, +1.0, -1.0, +0.0, 0.0, -1.0, -1.0, +0.0, 0.0,
+    +1.0, +0.0, +1.0, 0.0, -1.0, +0.0, +1.0, 0.0, +1.0, +0.0, -1.0, 0.0, -1.0, +0.0, -1.0, 0.0,
+    +0.0, +1.0, +1.0, 0.0, +0.0, -1.0, +1.0, 0.0, +0.0, +1.0, -1.0, 0.0, +0.0, -1.0, -1.0, 0.0,
+    +1.0, +1.0, +0.0, 0.0, -1.0, +1.0, +0.0, 0.0, +0.0, -1.0, +1.0, 0.0, +0.0, -1.0, -1.0, 0.0,
+};
+
+static float
+mix1d(float a, float b, float t)
+{
+    return a + t * (b - a);
+}
+
+static float
+smooth(float t)
+{
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+static float
+gradient3d(const int i[4], const float v[4])
+{
+    int index = (P[i[0] + P[i[1] + P[i[2]]]] & 15) * 4;
+    return v[0] * G[index + 0] + v[1] * G[index + 1] + v[2] * G[index + 2] + v[3] * 1.0f;
+}
+
+static float
+gradient_noise3d(const float position[4])
+{
+    float pf[4], fp[4], n[8], n4[4], n2[2];
+    int ip[4], c, k;
+
+    for (k = 0; k < 4; k++)
+    {
+        pf[k] = floorf(position[k]);
+        ip[k] = (int) pf[k] & 255;
+        fp[k] = position[k] - pf[k];
+    }
+
+    for (c = 0; c < 8; c++)
+    {
+        int i[4] = { ip[0] + (c >> 2), ip[1] + ((c >> 1) & 1), ip[2] + (c & 1), ip[3] };
+        float v[4] = { fp[0] - (c >> 2), fp[1] - ((c >> 1) & 1), fp[2] - (c & 1), fp[3] };
+        n[c] = gradient3d(i, v);
+    }
+
+    for (k = 0; k < 4; k++)
+        n4[k] = mix1d(n[k], n[k + 4], smooth(fp[0]));
+    n2[0] = mix1d(n4[0], n4[2], smooth(fp[1]));
+    n2[1] = mix1d(n4[1], n4[3], smooth(fp[1]));
+    return 0.5f - 0.5f * mix1d(n2[0], n2[1], smooth(fp[2]));
+}
+
+static float
+ridged_noise(const float position[4], float frequency)
+{
+    float p[4] = { position[0] * frequency, position[1] * frequency,
+                   position[2] * frequency, position[3] * frequency };
+    float signal = fabsf(1.0f - 2.0f * gradient_noise3d(p));
+    signal = 1.0f - signal;
+    return signal * signal;
+}
+
+static float
+ridgedmultifractal3d(const float position[4], float frequency, float lacunarity,
+                     float increment, float octaves)
+{
+    float fi = 0.0f, value, weight, signal;
+    int i, iterations = (int) octaves;
+
+    signal = ridged_noise(position, frequency);
+    value = signal;
+
+    for (i = 0; i < iterations; i++)
+    {
+        frequency *= lacunarity;
+        weight = signal * 0.5f;
+        weight = weight < 0.0f ? 0.0f : weight > 1.0f ? 1.0f : weight;
+        signal = ridged_noise(position, frequency) * weight;
+        value += signal * powf(lacunarity, -fi * increment);
+    }
+    return value;
+}
+
+static void
+normalized(float v[4])
+{
+    float d = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    d = d > 0.0f ? d : 1.0f;
+    v[0] /= d;
+    v[1] /= d;
+    v[2] /= d;
+    v[3] = 1.0f;
+}
+
+// fill_sphere() from displacement.c.
+static float *
+fill_sphere(int resolution, int *count)
+{
+    int subdiv = (int) powf(2.0f, resolution);
+    int stacks = subdiv / 2;
+    int slices = subdiv;
+    float pi = M_PI;
+    float *buffer = malloc(sizeof(float) * 4 * (stacks - 1) * slices * 2);
+    unsigned int index = 0;
+    int i, j, k;
+
+    *count = (stacks - 1) * slices * 2;
+    for (i = 0; i < stacks - 1; i++)
+    {
+        float t = i / (stacks - 1.f);
+        float t2 = (i + 1) / (stacks - 1.f);
+        float phi = pi * t - pi / 2;
+        float phi2 = pi * t2 - pi / 2;
+
+        for (j = 0; j < slices; j++)
+        {
+            float s = j / (slices - 1.f);
+            float theta = 2 * pi * s;
+            float v[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+            for (k = 0; k < 2; k++)
+            {
+                float d, p = k ? phi2 : phi;
+                v[0] = cos(p) * cos(theta);
+                v[1] = sin(p);
+                v[2] = cos(p) * sin(theta);
+
+                d = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+                if (d != 0.0f)
+                {
+                    v[0] /= d;
+                    v[1] /= d;
+                    v[2] /= d;
+                }
+                memcpy(buffer + index, v, sizeof(v));
+                index += 4;
+            }
+        }
+    }
+    return buffer;
+}
+
+// The displace kernel, for every vertex of the quad strips.
+static void
+reference_kernel(float *output, float *normals, const float *vertices, int count,
+                 const displacement_cpu_params *p)
+{
+    int index, k;
+
+    for (index = 0; index < count; index++)
+    {
+        float position[4], normal[4], sample[4], f[4], vertex[4], displacement;
+        float roughness = p->roughness / p->amplitude;
+
+        memcpy(position, vertices + 4 * index, sizeof(position));
+        memcpy(normal, position, sizeof(normal));
+        position[3] = 1.0f;
+
+        for (k = 0; k < 4; k++)
+        {
+            int axis;
+            for (axis = 0; axis < 3; axis++)
+                sample[axis] = position[axis] + (p->phase + 100.0f) + (k == axis + 1 ? roughness : 0.0f);
+            sample[3] = position[3] + (k ? 1.0f : 0.0f);
+            f[k] = ridgedmultifractal3d(sample, p->frequency, p->lacunarity, p->increment, p->octaves);
+        }
+
+        displacement = (f[0] + f[1] + f[2] + f[3]) / 4.0;
+        for (k = 0; k < 3; k++)
+            vertex[k] = position[k] + (p->amplitude * displacement * normal[k]);
+        vertex[3] = 1.0f;
+
+        for (k = 0; k < 3; k++)
+            normal[k] = (normal[k] - (f[k + 1] - f[0])) / roughness;
+        normalized(normal);
+
+        memcpy(output + 4 * index, vertex, sizeof(vertex));
+        memcpy(normals + 4 * index, normal, sizeof(normal));
+    }
+}
+
+// One sample per vertex, with normals from the central differences of the
+// displaced neighbours, and from the fan of triangles around the poles.
+static void
+reference_smooth(float *output, float *normals, const float *vertices, int resolution,
+                 const displacement_cpu_params *p)
+{
+    int slices = 1 << resolution, stacks = slices / 2, r, j, k;
+    float *grid = malloc(sizeof(float) * 3 * stacks * slices);
+
+#define GRID(r, j)  (grid + 3 * ((r) * slices + (j)))
+#define STRIP(r, j) (((r) < stacks - 1) ? 2 * ((r) * slices + (j)) : 2 * (((r) - 1) * slices + (j)) + 1)
+
+    for (r = 0; r < stacks; r++)
+    {
+        for (j = 0; j < slices; j++)
+        {
+            const float *v = vertices + 4 * STRIP(r, j);
+            float sample[4], f;
+            for (k = 0; k < 3; k++)
+                sample[k] = v[k] + (p->phase + 100.0f);
+            sample[3] = 1.0f;
+            f = ridgedmultifractal3d(sample, p->frequency, p->lacunarity, p->increment, p->octaves);
+            for (k = 0; k < 3; k++)
+                GRID(r, j)[k] = v[k] + p->amplitude * f * v[k];
+        }
+    }
+
+    for (r = 0; r < stacks; r++)
+    {
+        for (j = 0; j < slices; j++)
+        {
+            float n[4] = { 0.0f, 0.0f, 0.0f, 1.0f }, u[3], t[3];
+
+            if (r == 0 || r == stacks - 1)
+            {
+                const float *c = GRID(r, 0);
+                int ring = r == 0 ? 1 : stacks - 2, m;
+                for (m = 0; m < slices - 1; m++)
+                {
+                    for (k = 0; k < 3; k++)
+                    {
+                        u[k] = GRID(ring, m)[k] - c[k];
+                        t[k] = GRID(ring, m + 1)[k] - c[k];
+                    }
+                    n[0] += u[1] * t[2] - u[2] * t[1];
+                    n[1] += u[2] * t[0] - u[0] * t[2];
+                    n[2] += u[0] * t[1] - u[1] * t[0];
+                }
+                if (n[0] * c[0] + n[1] * c[1] + n[2] * c[2] < 0.0f)
+                    for (k = 0; k < 3; k++)
+                        n[k] = -n[k];
+            }
+            else
+            {
+                int left = j == 0 ? slices - 2 : j - 1;
+                int right = j == slices - 1 ? 1 : j + 1;
+                for (k = 0; k < 3; k++)
+                {
+                    u[k] = GRID(r + 1, j)[k] - GRID(r - 1, j)[k];
+                    t[k] = GRID(r, right)[k] - GRID(r, left)[k];
+                }
+                n[0] = u[1] * t[2] - u[2] * t[1];
+                n[1] = u[2] * t[0] - u[0] * t[2];
+                n[2] = u[0] * t[1] - u[1] * t[0];
+            }
+            normalized(n);
+
+            for (k = 0; k < 2; k++)
+            {
+                int index;
+                if ((k == 0 && r == stacks - 1) || (k == 1 && r == 0))
+                    continue;
+                index = k == 0 ? 2 * (r * slices + j) : 2 * ((r - 1) * slices + j) + 1;
+                memcpy(output + 4 * index, GRID(r, j), 3 * sizeof(float));
+                output[4 * index + 3] = 1.0f;
+                memcpy(normals + 4 * index, n, sizeof(n));
+            }
+        }
+    }
+
+#undef GRID
+#undef STRIP
+
+    free(grid);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+static float
+max_difference(const float *a, const float *b, int count)
+{
+    float worst = 0.0f;
+    int i;
+    for (i = 0; i < 4 * count; i++)
+    {
+        float d = fabsf(a[i] - b[i]);
+        if (!(d <= worst))
+            worst = d;
+    }
+    return worst;
+}
+
+static int
+validate(int resolution, displacement_cpu_normals mode, int threads)
+{
+    // A sequence of changes, each applied to the parameters before it, and
+    // whether it should change the output.
+    static const struct
+    {
+        const char *name;
+        int field;              // index into displacement_cpu_params
+        float scale;
+        int kernel_changes;
+        int smooth_changes;
+    } steps[] =
+    {
+        { "initial",                    -1, 1.0f,   1, 1 },
+        { "unchanged",                  -1, 1.0f,   0, 0 },
+        { "more octaves",               5,  1.3f,   1, 1 },
+        { "fewer octaves",              5,  0.5f,   1, 1 },
+        { "octaves, same count",        5,  1.05f,  0, 0 },
+        { "more octaves again",         5,  2.5f,   1, 1 },
+        { "lacunarity",                 3,  1.01f,  1, 1 },
+        { "increment",                  4,  1.05f,  0, 0 },
+        { "roughness",                  6,  0.95f,  1, 0 },
+        { "amplitude",                  1,  1.05f,  1, 1 },
+        { "frequency",                  0,  0.99f,  1, 1 },
+        { "phase",                      2,  -1.0f,  1, 1 },
+        { "fewer octaves again",        5,  0.3f,   1, 1 },
+    };
+    displacement_cpu_params params = default_params;
+    displacement_cpu *d = displacement_cpu_create(resolution, mode, threads);
+    int count, n, ok = 1;
+    float *sphere = fill_sphere(resolution, &count);
+    float *vertices = malloc(sizeof(float) * 4 * count), *normals = malloc(sizeof(float) * 4 * count);
+    float *expected_vertices = malloc(sizeof(float) * 4 * count);
+    float *expected_normals = malloc(sizeof(float) * 4 * count);
+
+    if (!d || displacement_cpu_vertex_count(d) != count)
+    {
+        printf("    FAILED: resolution %d with %s: could not create\n", resolution, normal_names[mode]);
+        return 0;
+    }
+
+    for (n = 0; n < (int) (sizeof(steps) / sizeof(*steps)); n++)
+    {
+        float *field = (float *) &params + steps[n].field;
+        int expected_change = mode == DISPLACEMENT_CPU_KERNEL_NORMALS ? steps[n].kernel_changes : steps[n].smooth_changes;
+        int changed;
+        float dv, dn;
+
+        if (steps[n].field == 2)
+            *field += 0.37f;
+        else if (steps[n].field >= 0)
+            *field *= steps[n].scale;
+
+        changed = displacement_cpu_update(d, &params, vertices, normals);
+        if (mode == DISPLACEMENT_CPU_KERNEL_NORMALS)
+            reference_kernel(expected_vertices, expected_normals, sphere, count, &params);
+        else
+            reference_smooth(expected_vertices, expected_normals, sphere, resolution, &params);
+
+        dv = max_difference(vertices, expected_vertices, count);
+        dn = max_difference(normals, expected_normals, count);
+        if (changed != expected_change || dv > TOLERANCE || dn > TOLERANCE)
+        {
+            printf("    FAILED: resolution %d with %s and %d threads, %s: "
+                   "update returned %d, vertices differ by %g, normals by %g\n",
+                   resolution, normal_names[mode], threads, steps[n].name, changed, dv, dn);
+            ok = 0;
+        }
+    }
+
+    displacement_cpu_destroy(d);
+    free(sphere);
+    free(vertices);
+    free(normals);
+    free(expected_vertices);
+    free(expected_normals);
+    return ok;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Time an update to changed from parameters already displaced, incrementally
+// and as a full update, in milliseconds.  The two alternate from the same
+// starting state, and the best time of each is kept, so that neither is
+// measured with caches the other warmed.
+static void
+time_update(displacement_cpu *d, const displacement_cpu_params *from,
+            const displacement_cpu_params *changed, float *vertices, float *normals,
+            double *incremental, double *full)
+{
+    double start = now();
+    int iterations = 0;
+
+    *incremental = *full = 0.0;
+    do
+    {
+        double t0, t;
+
+        displacement_cpu_invalidate(d);
+        displacement_cpu_update(d, from, vertices, normals);
+        t0 = now();
+        displacement_cpu_update(d, changed, vertices, normals);
+        t = now() - t0;
+        if (!iterations || t < *incremental)
+            *incremental = t;
+
+        displacement_cpu_update(d, from, vertices, normals);
+        displacement_cpu_invalidate(d);
+        t0 = now();
+        displacement_cpu_update(d, changed, vertices, normals);
+        t = now() - t0;
+        if (!iterations || t < *full)
+            *full = t;
+
+        iterations++;
+    } while (iterations < 5 || now() - start < min_seconds);
+
+    *incremental *= 1e3;
+    *full *= 1e3;
+}
+
+// Time each kind of update.  The last column is the first as a percentage of
+// the full update timed alongside it, in the column before.
+static void
+bench(int resolution, displacement_cpu_normals mode, int threads)
+{
+    displacement_cpu *d = displacement_cpu_create(resolution, mode, threads);
+    displacement_cpu_params base = default_params, changed;
+    int count = displacement_cpu_vertex_count(d);
+    float *vertices = malloc(sizeof(float) * 4 * count), *normals = malloc(sizeof(float) * 4 * count);
+    double full, incremental;
+
+    printf("Resolution %d (%d vertices), %s:\n", resolution, count, normal_names[mode]);
+    printf("    %-26s %9s %9s %9s\n", "", "ms", "full ms", "% of full");
+
+    time_update(d, &base, &base, vertices, normals, &incremental, &full);
+    printf("    %-26s %9.3f\n", "full update", full);
+
+    // For scale, the scalar port of the kernel, which evaluates every quad
+    // strip vertex and so every interior vertex twice.
+    if (mode == DISPLACEMENT_CPU_KERNEL_NORMALS && resolution <= 8)
+    {
+        int sphere_count;
+        float *sphere = fill_sphere(resolution, &sphere_count);
+        double t0 = now(), t;
+        reference_kernel(vertices, normals, sphere, sphere_count, &base);
+        t = 1e3 * (now() - t0);
+        printf("    %-26s %9.3f %9.3f %9.1f\n", "scalar kernel", t, full, 100.0 * t / full);
+        free(sphere);
+    }
+
+    // Each case is compared with a full update to the same parameters.
+#define CASE(name, statement)                                                   \
+    do                                                                          \
+    {                                                                           \
+        changed = base;                                                         \
+        statement;                                                              \
+        time_update(d, &base, &changed, vertices, normals, &incremental, &full); \
+        printf("    %-26s %9.3f %9.3f %9.1f\n", name, incremental, full,         \
+               100.0 * incremental / full);                                     \
+    } while (0)
+
+    CASE("add an octave", changed.octaves += 1.0f);
+    CASE("remove an octave", changed.octaves -= 1.0f);
+    CASE("change lacunarity", changed.lacunarity *= 1.01f);
+    if (mode == DISPLACEMENT_CPU_KERNEL_NORMALS)
+        CASE("change roughness", changed.roughness *= 1.05f);
+    CASE("change amplitude", changed.amplitude *= 1.05f);
+    CASE("change increment", changed.increment *= 1.05f);
+    CASE("change phase", changed.phase += 0.01f);
+
+#undef CASE
+
+    displacement_cpu_destroy(d);
+    free(vertices);
+    free(normals);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+    int max_resolution = 10, threads = 0, ok = 1, resolution, mode;
+
+    if (argc > 1)
+        max_resolution = atoi(argv[1]);
+    if (argc > 2)
+        threads = atoi(argv[2]);
+
+    printf("Validating...\n");
+    for (resolution = 3; resolution <= 7; resolution++)
+    {
+        for (mode = DISPLACEMENT_CPU_KERNEL_NORMALS; mode <= DISPLACEMENT_CPU_SMOOTH_NORMALS; mode++)
+        {
+            ok &= validate(resolution, mode, 1);
+            ok &= validate(resolution, mode, 3);
+            ok &= validate(resolution, mode, 0);
+        }
+    }
+    ok &= validate(8, DISPLACEMENT_CPU_KERNEL_NORMALS, 0);
+    ok &= validate(8, DISPLACEMENT_CPU_SMOOTH_NORMALS, 0);
+
+    printf("Timing with %d threads (0 is one per processor):\n", threads);
+    for (resolution = 4; resolution <= max_resolution; resolution++)
+        for (mode = DISPLACEMENT_CPU_KERNEL_NORMALS; mode <= DISPLACEMENT_CPU_SMOOTH_NORMALS; mode++)
+            bench(resolution, mode, threads);
+
+    if (!ok)
+    {
+        printf("Error:  Incorrect results obtained!\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("Results Validated!\n");
+    return 0;
+}
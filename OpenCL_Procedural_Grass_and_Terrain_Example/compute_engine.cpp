@@ -50,8 +50,7 @@
 
 #include <assert.h>
 #include <math.h>
-
-#include <OpenCL/opencl.h>
+#include <string.h>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -392,7 +391,10 @@ ComputeEngine::ComputeEngine() :
     m_uiDeviceCount(0),
     m_kContext(0),
     m_akDeviceIds(0),
-    m_akCommandQueues(0)
+    m_akCommandQueues(0),
+    m_akTransferQueues(0),
+    m_bProfiling(false),
+    m_uiKernelArgBindCount(0)
 {
     m_akPrograms.clear();
     m_akKernels.clear();
@@ -409,7 +411,8 @@ bool
 ComputeEngine::connect(
     DeviceType eDeviceType, 
     uint uiCount,
-    bool bUseOpenGLContext)
+    bool bUseOpenGLContext,
+    bool bEnableProfiling)
 {   
     assert(uiCount < ms_uiMaxDeviceCount);
 
@@ -423,6 +426,7 @@ ComputeEngine::connect(
     cl_device_id akAvailableDeviceIds[ms_uiMaxDeviceCount];
     cl_device_type kRequestedDeviceType = (cl_device_type)eDeviceType;
                
+#ifdef __APPLE__
     if(bUseOpenGLContext)
     {
         printf(SEPARATOR);
@@ -441,6 +445,7 @@ ComputeEngine::connect(
         m_kContext = clCreateContext(akProperties, 0, 0, clLogMessagesToStdoutAPPLE, 0, 0);
     }
     else
+#endif
     {
         uint uiAvailableDeviceCount = 0;
         iError = clGetDeviceIDs(NULL, kRequestedDeviceType, uiCount, akAvailableDeviceIds, &uiAvailableDeviceCount);
@@ -472,7 +477,8 @@ ComputeEngine::connect(
     uiDeviceCount = kReturnedSize / sizeof(cl_device_id);
     m_akDeviceIds = new cl_device_id[uiDeviceCount];
     m_akCommandQueues = new cl_command_queue[uiDeviceCount];
-    if(!m_akDeviceIds || !m_akCommandQueues)
+    m_akTransferQueues = new cl_command_queue[uiDeviceCount];
+    if(!m_akDeviceIds || !m_akCommandQueues || !m_akTransferQueues)
     {
         printf("Compute Engine: Error: Failed to allocate device ids!\n");
         return false;
@@ -505,16 +511,26 @@ ComputeEngine::connect(
         printf(SEPARATOR);
         printf("Creating command queue for %s %s...\n", acVendorName, acDeviceName);
         
-        m_akCommandQueues[i] = clCreateCommandQueue(m_kContext, m_akDeviceIds[i], 0, &iError);
+        cl_command_queue_properties kProperties = bEnableProfiling ? CL_QUEUE_PROFILING_ENABLE : 0;
+        m_akCommandQueues[i] = clCreateCommandQueue(m_kContext, m_akDeviceIds[i], kProperties, &iError);
         if (!m_akCommandQueues[i] || iError)
         {
             printf("Error: Failed to create a command queue!\n");
             return false;
         }
+
+        // reads and writes enqueued as tasks go here, so they can run alongside kernels
+        m_akTransferQueues[i] = clCreateCommandQueue(m_kContext, m_akDeviceIds[i], kProperties, &iError);
+        if (!m_akTransferQueues[i] || iError)
+        {
+            printf("Error: Failed to create a transfer queue!\n");
+            return false;
+        }
     }
 
     printf(SEPARATOR);
 
+    m_bProfiling = bEnableProfiling;
     m_akPrograms.clear();
     m_akKernels.clear();
     m_akMemObjects.clear();
@@ -529,25 +545,34 @@ ComputeEngine::disconnect()
     if(m_kContext)
     {
         for(i = 0; i < m_uiDeviceCount; i++)
+        {
             clFinish(m_akCommandQueues[i]);
+            clFinish(m_akTransferQueues[i]);
+        }
     }
+    releaseTasks();
         
-    MemObjectMapIter pkMemObjIter;
-    for(pkMemObjIter = m_akMemObjects.begin(); pkMemObjIter != m_akMemObjects.end(); pkMemObjIter++)
+    for(i = 0; i < m_akMemObjectSlots.size(); i++)
     {
-        if(pkMemObjIter->second)
-            clReleaseMemObject(pkMemObjIter->second);
+        if(m_akMemObjectSlots[i])
+            clReleaseMemObject(m_akMemObjectSlots[i]);
     }
+    m_akMemObjectSlots.clear();
     m_akMemObjects.clear();
 
-    KernelMapIter pkKernelIter;
-    for(pkKernelIter = m_akKernels.begin(); pkKernelIter != m_akKernels.end(); pkKernelIter++)
+    for(i = 0; i < m_akKernelSlots.size(); i++)
     {
-        if(pkKernelIter->second)
-            clReleaseKernel(pkKernelIter->second);
+        if(m_akKernelSlots[i])
+            clReleaseKernel(m_akKernelSlots[i]);
     }
+    m_akKernelSlots.clear();
+    m_akKernelArgValues.clear();
     m_akKernels.clear();
 
+    for(i = 0; i < m_akInternedNames.size(); i++)
+        free(m_akInternedNames[i]);
+    m_akInternedNames.clear();
+
     ProgramMapIter pkPgmIter;
     for(pkPgmIter = m_akPrograms.begin(); pkPgmIter != m_akPrograms.end(); pkPgmIter++)
     {
@@ -558,13 +583,22 @@ ComputeEngine::disconnect()
 
     if(m_akCommandQueues)
     {
-        for(uint i; i < m_uiDeviceCount; i++)
+        for(uint i = 0; i < m_uiDeviceCount; i++)
             clReleaseCommandQueue(m_akCommandQueues[i]);
             
         delete [] m_akCommandQueues;
         m_akCommandQueues = 0;
     }
 
+    if(m_akTransferQueues)
+    {
+        for(uint i = 0; i < m_uiDeviceCount; i++)
+            clReleaseCommandQueue(m_akTransferQueues[i]);
+            
+        delete [] m_akTransferQueues;
+        m_akTransferQueues = 0;
+    }
+
     if(m_akDeviceIds)
     {
         delete [] m_akDeviceIds;
@@ -696,12 +730,13 @@ ComputeEngine::createKernel(
     const char* acProgramName,
     const char* acKernelName)
 {
-    KernelMapIter pkKernelIter = m_akKernels.find(acKernelName);
-    if(pkKernelIter != m_akKernels.end())
+    uint uiSlot = internKernelName(acKernelName);
+    if(m_akKernelSlots[uiSlot])
     {
         printf("Compute Engine: Releasing existing kernel '%s'...\n", acKernelName);
-        clReleaseKernel(pkKernelIter->second);
-        m_akKernels.erase(pkKernelIter);
+        clReleaseKernel(m_akKernelSlots[uiSlot]);
+        m_akKernelSlots[uiSlot] = 0;
+        m_akKernelArgValues[uiSlot].clear();
     }    
     
     ProgramMapIter pkPgmIter = m_akPrograms.find(acProgramName);
@@ -721,20 +756,26 @@ ComputeEngine::createKernel(
         return false;
     }
     
-    m_akKernels[acKernelName] = kKernel;
+    m_akKernelSlots[uiSlot] = kKernel;
     return true;
 }
 
 uint 
 ComputeEngine::getKernelArgCount(
     const char* acKernelName)
+{
+    return getKernelArgCount(getKernelHandle(acKernelName));
+}
+
+uint 
+ComputeEngine::getKernelArgCount(
+    KernelHandle kKernelHandle)
 {
     uint uiArgCount = 0;
-    KernelMapIter pkKernelIter = m_akKernels.find(acKernelName);
-    if(pkKernelIter == m_akKernels.end())
+    cl_kernel kKernel = getKernelObject(kKernelHandle);
+    if(kKernel == 0)
         return 0;
         
-    cl_kernel kKernel = pkKernelIter->second;
     clGetKernelInfo(kKernel, CL_KERNEL_NUM_ARGS, sizeof(uiArgCount),  &uiArgCount, 0);
     return uiArgCount;
 }
@@ -746,18 +787,29 @@ ComputeEngine::setKernelArg(
     void *pvArgsValue, 
     size_t ptArgsSize)
 {
-    KernelMapIter pkKernelIter = m_akKernels.find(acKernelName);
-    if(pkKernelIter == m_akKernels.end())
+    return setKernelArg(getKernelHandle(acKernelName), uiIndex, pvArgsValue, ptArgsSize);
+}
+
+bool
+ComputeEngine::setKernelArg(
+    KernelHandle kKernelHandle,
+    uint uiIndex,  
+    void *pvArgsValue, 
+    size_t ptArgsSize)
+{
+    cl_kernel kKernel = getKernelObject(kKernelHandle);
+    if(kKernel == 0)
         return false;
+
+    const char* acKernelName = m_akInternedNames[kKernelHandle.m_uiIndex];
 		
 #ifdef DEBUG
 	printf("Compute Engine SetKernelArg: %s %d %f (%d)\n", 
 		acKernelName, uiIndex, *(float*)pvArgsValue, *(unsigned int*)pvArgsValue);
 #endif
 
-    cl_kernel kKernel = pkKernelIter->second;
-    
     int iError = clSetKernelArg(kKernel, uiIndex, ptArgsSize, pvArgsValue);
+    m_uiKernelArgBindCount++;
     if(iError)
     {
         printf("Compute Engine: Error setting kernel argument '%d' for '%s'\n", uiIndex, acKernelName);
@@ -765,9 +817,37 @@ ComputeEngine::setKernelArg(
         return false;
     }
 
+    std::vector<KernelArgValue> &rakValues = m_akKernelArgValues[kKernelHandle.m_uiIndex];
+    if(rakValues.size() <= uiIndex)
+        rakValues.resize(uiIndex + 1);
+    if(pvArgsValue)
+        rakValues[uiIndex].assign((const unsigned char*)pvArgsValue, (const unsigned char*)pvArgsValue + ptArgsSize);
+    else
+        rakValues[uiIndex].clear();     // local memory sizes are always rebound
     return true;
 }
 
+bool
+ComputeEngine::updateKernelArg(
+    KernelHandle kKernelHandle,
+    uint uiIndex,  
+    const void *pvArgsValue, 
+    size_t ptArgsSize)
+{
+    if(getKernelObject(kKernelHandle) == 0)
+        return false;
+
+    const std::vector<KernelArgValue> &rakValues = m_akKernelArgValues[kKernelHandle.m_uiIndex];
+    if(pvArgsValue && uiIndex < rakValues.size())
+    {
+        const KernelArgValue &rkValue = rakValues[uiIndex];
+        if(ptArgsSize && rkValue.size() == ptArgsSize && memcmp(&rkValue[0], pvArgsValue, ptArgsSize) == 0)
+            return true;
+    }
+    
+    return setKernelArg(kKernelHandle, uiIndex, (void*)pvArgsValue, ptArgsSize);
+}
+
 bool
 ComputeEngine::setKernelArgs(
     const char* acKernelName,
@@ -776,11 +856,12 @@ ComputeEngine::setKernelArgs(
     void **pvArgsValue, 
     size_t *ptArgsSize)
 {
-    KernelMapIter pkKernelIter = m_akKernels.find(acKernelName);
-    if(pkKernelIter == m_akKernels.end())
+    cl_kernel kKernel = getKernelObject(acKernelName);
+    if(kKernel == 0)
         return false;
        
-    cl_kernel kKernel = pkKernelIter->second;
+    // these bypass the cache used by updateKernelArg()
+    m_akKernelArgValues[m_akKernels[acKernelName]].clear();
     for( uint i = 0; i < uiNumArgs; i++)
     {
         int iError = clSetKernelArg(kKernel, i, ptArgsSize[i], pvArgsValue[i]);
@@ -802,11 +883,22 @@ ComputeEngine::executeKernel(
     size_t* auiLocalDim,
     uint uiDimCount)
 {
-    KernelMapIter pkKernelIter = m_akKernels.find(acKernelName);
-    if(pkKernelIter == m_akKernels.end())
+    return executeKernel(getKernelHandle(acKernelName), uiDeviceIndex, auiGlobalDim, auiLocalDim, uiDimCount);
+}
+
+bool
+ComputeEngine::executeKernel(
+    KernelHandle kKernelHandle,
+    uint uiDeviceIndex,
+    size_t* auiGlobalDim,
+    size_t* auiLocalDim,
+    uint uiDimCount)
+{
+    cl_kernel kKernel = getKernelObject(kKernelHandle);
+    if(kKernel == 0)
         return false;
                 
-    cl_kernel kKernel = pkKernelIter->second;
+    const char* acKernelName = m_akInternedNames[kKernelHandle.m_uiIndex];
     
 #ifdef DEBUG    
     printf("Compute Engine: Execute Kernel '%s': Global[%d, %d]  Local[%d, %d]\n",
@@ -840,13 +932,7 @@ ComputeEngine::createBuffer(
     printf("Compute Engine: Creating Buffer '%s' with %d bytes (%5.2f Mbytes) total)...\n",
         acMemObjName, (int)kBytes, (float)kBytes / 1024.0f / 1024.0f);
         
-    MemObjectMapIter pkMemObjIter = m_akMemObjects.find(acMemObjName);
-    if(pkMemObjIter != m_akMemObjects.end())
-    {
-        printf("Compute Engine: Releasing Existing Buffer\n");
-        clReleaseMemObject(pkMemObjIter->second);
-        m_akMemObjects.erase(pkMemObjIter);
-    }
+    setMemObject(acMemObjName, 0);
     
     int iError = CL_SUCCESS;
     cl_mem kBuffer = clCreateBuffer(m_kContext, (cl_mem_flags)eMemFlags, (size_t)kBytes, NULL, &iError);
@@ -857,7 +943,7 @@ ComputeEngine::createBuffer(
         return false;
     }
     
-    m_akMemObjects[acMemObjName] = kBuffer;
+    setMemObject(acMemObjName, kBuffer);
     return true;
 }
 
@@ -869,10 +955,22 @@ ComputeEngine::readBuffer(
     size_t kBytes,
     void* pvData)
 {
-    cl_mem kBuffer = getMemObject(acMemObjName);
+    return readBuffer(getMemObjectHandle(acMemObjName), uiDeviceIndex, uiStart, kBytes, pvData);
+}
+
+bool
+ComputeEngine::readBuffer(
+    MemObjectHandle kMemObjectHandle,
+    uint uiDeviceIndex,
+    uint uiStart,
+    size_t kBytes,
+    void* pvData)
+{
+    cl_mem kBuffer = getMemObject(kMemObjectHandle);
     if(kBuffer == 0)
         return false;
 
+    const char* acMemObjName = m_akInternedNames[kMemObjectHandle.m_uiIndex];
     if(uiDeviceIndex > m_uiDeviceCount)
     {
         printf("Invalid device index for reading buffer '%s'!\n", acMemObjName);
@@ -900,10 +998,22 @@ ComputeEngine::writeBuffer(
     size_t kBytes,
     void* pvData)
 {
-    cl_mem kBuffer = getMemObject(acMemObjName);
+    return writeBuffer(getMemObjectHandle(acMemObjName), uiDeviceIndex, uiStart, kBytes, pvData);
+}
+
+bool
+ComputeEngine::writeBuffer(
+    MemObjectHandle kMemObjectHandle,
+    uint uiDeviceIndex,
+    uint uiStart,
+    size_t kBytes,
+    void* pvData)
+{
+    cl_mem kBuffer = getMemObject(kMemObjectHandle);
     if(kBuffer == 0)
         return false;
 
+    const char* acMemObjName = m_akInternedNames[kMemObjectHandle.m_uiIndex];
     if(uiDeviceIndex > m_uiDeviceCount)
     {
         printf("Invalid device index for writing to buffer '%s'\n", acMemObjName);
@@ -938,20 +1048,18 @@ ComputeEngine::clearMemory(
     if(kMemObject == 0)
         return false;
                 
-    KernelMapIter pkKernelIter = m_akKernels.find(acMemSetKernelName);
-    if(pkKernelIter == m_akKernels.end())
+    cl_kernel kKernel = getKernelObject(acMemSetKernelName);
+    if(kKernel == 0)
     {
         createProgramFromSourceString(acMemSetProgramName, MemSetKernelSourceString);
         createKernel(acMemSetProgramName, acMemSetKernelName);
         s_uiMaxWorkGroupSize = getEstimatedWorkGroupSize(acMemSetKernelName);
         s_uiMinWorkGroupSize = (s_uiMinWorkGroupSize > s_uiMaxWorkGroupSize) ? s_uiMaxWorkGroupSize : s_uiMinWorkGroupSize;
-        pkKernelIter = m_akKernels.find(acMemSetKernelName);
+        kKernel = getKernelObject(acMemSetKernelName);
     }
     
-    if(pkKernelIter == m_akKernels.end())
+    if(kKernel == 0)
         return false;
-        
-    cl_kernel kKernel = pkKernelIter->second;
 
     uint uiElements = kBytes / sizeof(float);
     uint uiSqrt2 = (uint)(ceil(powf(uiElements, (1.0f/2.0f))));
@@ -1024,8 +1132,8 @@ ComputeEngine::swapMemObjects(
     if(kB == 0)
         return false;
 
-    m_akMemObjects[acMemObjNameA] = kB;
-    m_akMemObjects[acMemObjNameB] = kA;
+    m_akMemObjectSlots[m_akMemObjects[acMemObjNameA]] = kB;
+    m_akMemObjectSlots[m_akMemObjects[acMemObjNameB]] = kA;
     return true;
 }
 
@@ -1043,7 +1151,7 @@ ComputeEngine::getKernelObject(
     KernelMapIter pkKernelIter = m_akKernels.find(acKernelName);
     if(pkKernelIter != m_akKernels.end())
     {
-        return pkKernelIter->second;
+        return m_akKernelSlots[pkKernelIter->second];
     }
     
     return (cl_kernel) 0;
@@ -1060,13 +1168,7 @@ ComputeEngine::createImage2D(
     uint uiRowPitch,
     void* pvData)
 {
-    MemObjectMapIter pkMemObjIter = m_akMemObjects.find(acMemObjName);
-    if(pkMemObjIter != m_akMemObjects.end())
-    {
-        printf("Compute Engine: Releasing Existing Image '%s'\n", acMemObjName);
-        clReleaseMemObject(pkMemObjIter->second);
-        m_akMemObjects.erase(pkMemObjIter);
-    }
+    setMemObject(acMemObjName, 0);
 
     uint uiChannelCount = getChannelCount(eOrder);
     if(uiChannelCount == 0)
@@ -1092,7 +1194,7 @@ ComputeEngine::createImage2D(
         return false;
     }
     
-    m_akMemObjects[acMemObjName] = kImage;
+    setMemObject(acMemObjName, kImage);
     return true;
 }
 
@@ -1176,13 +1278,13 @@ ComputeEngine::getMemObject(
     const char* acMemObjName)
 {
     MemObjectMapIter pkMemObjIter = m_akMemObjects.find(acMemObjName);
-    if(pkMemObjIter == m_akMemObjects.end())
+    if(pkMemObjIter == m_akMemObjects.end() || m_akMemObjectSlots[pkMemObjIter->second] == 0)
 	{
 		printf("Compute Engine: Failed to locate memory object '%s'!\n", acMemObjName);
         return 0;
 	}
 	
-    cl_mem kMemObject = pkMemObjIter->second;
+    cl_mem kMemObject = m_akMemObjectSlots[pkMemObjIter->second];
 	return kMemObject;
 }
         
@@ -1225,13 +1327,7 @@ ComputeEngine::createGLBufferReference(
     printf("Compute Engine: Creating OpenGL buffer reference '%s' for buffer id '%d'...\n",
         acMemObjName, uiBufferId);
         
-    MemObjectMapIter pkMemObjIter = m_akMemObjects.find(acMemObjName);
-    if(pkMemObjIter != m_akMemObjects.end())
-    {
-        printf("Compute Engine: Releasing existing memory object '%s'...\n", acMemObjName);
-        clReleaseMemObject(pkMemObjIter->second);
-        m_akMemObjects.erase(pkMemObjIter);
-    }
+    setMemObject(acMemObjName, 0);
 
     int iError = CL_SUCCESS;
     cl_mem_flags kFlags = (cl_mem_flags) eMemFlags;
@@ -1245,7 +1341,7 @@ ComputeEngine::createGLBufferReference(
         return false;
     }
     
-    m_akMemObjects[acMemObjName] = kReference;
+    setMemObject(acMemObjName, kReference);
     return true;
 }
 
@@ -1254,10 +1350,20 @@ ComputeEngine::attachGLBuffer(
     const char* acMemObjName,
     uint uiDeviceIndex)
 {
-    cl_mem kMemObj = getMemObject(acMemObjName);
+    return attachGLBuffer(getMemObjectHandle(acMemObjName), uiDeviceIndex);
+}
+
+bool
+ComputeEngine::attachGLBuffer(
+    MemObjectHandle kMemObjectHandle,
+    uint uiDeviceIndex)
+{
+    cl_mem kMemObj = getMemObject(kMemObjectHandle);
     if(kMemObj == 0)
         return false;
 
+    const char* acMemObjName = m_akInternedNames[kMemObjectHandle.m_uiIndex];
+
     if(uiDeviceIndex > m_uiDeviceCount)
     {
         printf("Invalid device index for attaching GL object!\n");
@@ -1303,10 +1409,20 @@ ComputeEngine::detachGLBuffer(
     const char* acMemObjName,
     uint uiDeviceIndex)
 {
-    cl_mem kMemObj = getMemObject(acMemObjName);
+    return detachGLBuffer(getMemObjectHandle(acMemObjName), uiDeviceIndex);
+}
+
+bool
+ComputeEngine::detachGLBuffer(
+    MemObjectHandle kMemObjectHandle,
+    uint uiDeviceIndex)
+{
+    cl_mem kMemObj = getMemObject(kMemObjectHandle);
     if(kMemObj == 0)
         return false;
 
+    const char* acMemObjName = m_akInternedNames[kMemObjectHandle.m_uiIndex];
+
     if(uiDeviceIndex > m_uiDeviceCount)
     {
         printf("Invalid device index for attaching GL object!\n");
@@ -1357,13 +1473,7 @@ ComputeEngine::createGLTexture2DReference(
     printf("Compute Engine: Creating OpenGL buffer reference '%s' for buffer id '%d'...\n",
         acMemObjName, uiBufferId);
         
-    MemObjectMapIter pkMemObjIter = m_akMemObjects.find(acMemObjName);
-    if(pkMemObjIter != m_akMemObjects.end())
-    {
-        printf("Compute Engine: Releasing existing memory object '%s'...\n", acMemObjName);
-        clReleaseMemObject(pkMemObjIter->second);
-        m_akMemObjects.erase(pkMemObjIter);
-    }
+    setMemObject(acMemObjName, 0);
 
     int iError = CL_SUCCESS;
     cl_mem_flags kFlags = (cl_mem_flags) eMemFlags;
@@ -1377,7 +1487,7 @@ ComputeEngine::createGLTexture2DReference(
         return false;
     }
     
-    m_akMemObjects[acMemObjName] = kReference;
+    setMemObject(acMemObjName, kReference);
     return true;
 }
 
@@ -1489,8 +1599,16 @@ ComputeEngine::getEstimatedWorkGroupSize(
     const char *acKernelName,
     uint uiDeviceIndex)
 {
-    KernelMapIter pkKernelIter = m_akKernels.find(acKernelName);
-    if(pkKernelIter == m_akKernels.end())
+    return getEstimatedWorkGroupSize(getKernelHandle(acKernelName), uiDeviceIndex);
+}
+
+uint
+ComputeEngine::getEstimatedWorkGroupSize(
+    KernelHandle kKernelHandle,
+    uint uiDeviceIndex)
+{
+    cl_kernel kKernel = getKernelObject(kKernelHandle);
+    if(kKernel == 0)
     {
         printf("Compute Engine: Failed to retrieve kernel for work group size estimation!\n");
         return 0;
@@ -1504,7 +1622,6 @@ ComputeEngine::getEstimatedWorkGroupSize(
         
     size_t iMaxSize = 0;
     size_t kReturnedSize = 0;
-    cl_kernel kKernel = pkKernelIter->second;
     int iError = clGetKernelWorkGroupInfo( kKernel, m_akDeviceIds[uiDeviceIndex], CL_KERNEL_WORK_GROUP_SIZE, 
                                            sizeof(iMaxSize), &iMaxSize, &kReturnedSize);
 
@@ -1542,3 +1659,356 @@ ComputeEngine::dumpBuffer(
     delete [] acBuffer;
 }
 
+
+////////////////////////////////////////////////////////////////////////////////
+
+ComputeEngine::KernelHandle
+ComputeEngine::getKernelHandle(
+    const char* acKernelName)
+{
+    KernelMapIter pkKernelIter = m_akKernels.find(acKernelName);
+    if(pkKernelIter == m_akKernels.end())
+        return KernelHandle();
+        
+    return KernelHandle(pkKernelIter->second);
+}
+
+ComputeEngine::MemObjectHandle
+ComputeEngine::getMemObjectHandle(
+    const char* acMemObjName)
+{
+    MemObjectMapIter pkMemObjIter = m_akMemObjects.find(acMemObjName);
+    if(pkMemObjIter == m_akMemObjects.end())
+        return MemObjectHandle();
+        
+    return MemObjectHandle(pkMemObjIter->second);
+}
+
+uint
+ComputeEngine::internKernelName(
+    const char* acKernelName)
+{
+    KernelMapIter pkKernelIter = m_akKernels.find(acKernelName);
+    if(pkKernelIter != m_akKernels.end())
+        return pkKernelIter->second;
+
+    // slots are shared between kernels and memory objects so that a handle's index 
+    // also finds its name
+    uint uiSlot = (uint)m_akInternedNames.size();
+    char* acName = strdup(acKernelName);
+    m_akInternedNames.push_back(acName);
+    m_akKernelSlots.resize(uiSlot + 1, 0);
+    m_akKernelArgValues.resize(uiSlot + 1);
+    m_akMemObjectSlots.resize(uiSlot + 1, 0);
+    m_akKernels[acName] = uiSlot;
+    return uiSlot;
+}
+
+uint
+ComputeEngine::internMemObjectName(
+    const char* acMemObjName)
+{
+    MemObjectMapIter pkMemObjIter = m_akMemObjects.find(acMemObjName);
+    if(pkMemObjIter != m_akMemObjects.end())
+        return pkMemObjIter->second;
+
+    uint uiSlot = (uint)m_akInternedNames.size();
+    char* acName = strdup(acMemObjName);
+    m_akInternedNames.push_back(acName);
+    m_akKernelSlots.resize(uiSlot + 1, 0);
+    m_akKernelArgValues.resize(uiSlot + 1);
+    m_akMemObjectSlots.resize(uiSlot + 1, 0);
+    m_akMemObjects[acName] = uiSlot;
+    return uiSlot;
+}
+
+void
+ComputeEngine::setMemObject(
+    const char* acMemObjName,
+    cl_mem kMemObject)
+{
+    uint uiSlot = internMemObjectName(acMemObjName);
+    if(m_akMemObjectSlots[uiSlot] && m_akMemObjectSlots[uiSlot] != kMemObject)
+    {
+        printf("Compute Engine: Releasing existing memory object '%s'...\n", acMemObjName);
+        clReleaseMemObject(m_akMemObjectSlots[uiSlot]);
+    }
+    m_akMemObjectSlots[uiSlot] = kMemObject;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void
+ComputeEngine::beginTasks()
+{
+    releaseTasks();
+    m_akTaskProfiles.clear();
+}
+
+bool
+ComputeEngine::prepareWaitList(
+    uint uiWaitCount, 
+    const TaskId* auiWaitTasks, 
+    std::vector<cl_event> &rakEvents)
+{
+    rakEvents.clear();
+    for(uint i = 0; i < uiWaitCount; i++)
+    {
+        if(auiWaitTasks[i] == INVALID_TASK)
+            continue;
+            
+        if(auiWaitTasks[i] >= m_akTasks.size())
+        {
+            printf("Compute Engine: Invalid task '%d' in wait list!\n", auiWaitTasks[i]);
+            return false;
+        }
+        rakEvents.push_back(m_akTasks[auiWaitTasks[i]].kEvent);
+    }
+    return true;
+}
+
+ComputeEngine::TaskId
+ComputeEngine::addTask(
+    cl_event kEvent, 
+    const char* acName, 
+    cl_command_type kCommandType)
+{
+    Task kTask;
+    kTask.kEvent = kEvent;
+    kTask.acName = acName;
+    kTask.kCommandType = kCommandType;
+    m_akTasks.push_back(kTask);
+    return (TaskId)(m_akTasks.size() - 1);
+}
+
+ComputeEngine::TaskId
+ComputeEngine::enqueueKernel(
+    KernelHandle kKernelHandle,
+    uint uiDeviceIndex,
+    size_t* auiGlobalDim,
+    size_t* auiLocalDim,
+    uint uiDimCount,
+    uint uiWaitCount,
+    const TaskId* auiWaitTasks)
+{
+    cl_kernel kKernel = getKernelObject(kKernelHandle);
+    if(kKernel == 0 || uiDeviceIndex >= m_uiDeviceCount)
+        return INVALID_TASK;
+
+    std::vector<cl_event> akWaitEvents;
+    if(!prepareWaitList(uiWaitCount, auiWaitTasks, akWaitEvents))
+        return INVALID_TASK;
+
+    const char* acKernelName = m_akInternedNames[kKernelHandle.m_uiIndex];
+    cl_event kEvent = 0;
+    int iError = clEnqueueNDRangeKernel(m_akCommandQueues[uiDeviceIndex], kKernel, 
+                                        uiDimCount, NULL, auiGlobalDim, auiLocalDim, 
+                                        (cl_uint)akWaitEvents.size(), 
+                                        akWaitEvents.empty() ? NULL : &akWaitEvents[0], 
+                                        &kEvent);
+    if(iError != CL_SUCCESS)
+	{
+        printf("Compute Engine: Error enqueueing kernel '%s'\n", acKernelName);
+		ReportError(iError);
+		return INVALID_TASK;
+	}  
+
+    return addTask(kEvent, acKernelName, CL_COMMAND_NDRANGE_KERNEL);
+}
+
+ComputeEngine::TaskId
+ComputeEngine::enqueueReadBuffer(
+    MemObjectHandle kMemObjectHandle,
+    uint uiDeviceIndex,
+    uint uiStart,
+    size_t kBytes,
+    void* pvData,
+    uint uiWaitCount,
+    const TaskId* auiWaitTasks)
+{
+    cl_mem kBuffer = getMemObject(kMemObjectHandle);
+    if(kBuffer == 0 || uiDeviceIndex >= m_uiDeviceCount)
+        return INVALID_TASK;
+
+    std::vector<cl_event> akWaitEvents;
+    if(!prepareWaitList(uiWaitCount, auiWaitTasks, akWaitEvents))
+        return INVALID_TASK;
+
+    const char* acMemObjName = m_akInternedNames[kMemObjectHandle.m_uiIndex];
+    cl_event kEvent = 0;
+    int iError = clEnqueueReadBuffer(m_akTransferQueues[uiDeviceIndex], kBuffer, CL_FALSE, 
+                                     (size_t)uiStart, (size_t)kBytes, pvData, 
+                                     (cl_uint)akWaitEvents.size(), 
+                                     akWaitEvents.empty() ? NULL : &akWaitEvents[0], 
+                                     &kEvent);
+    if(iError)
+	{
+        printf("Compute Engine: Error enqueueing read of buffer %s\n", acMemObjName);
+		ReportError(iError);
+		return INVALID_TASK;
+	}
+
+    return addTask(kEvent, acMemObjName, CL_COMMAND_READ_BUFFER);
+}
+
+ComputeEngine::TaskId
+ComputeEngine::enqueueWriteBuffer(
+    MemObjectHandle kMemObjectHandle,
+    uint uiDeviceIndex,
+    uint uiStart,
+    size_t kBytes,
+    const void* pvData,
+    uint uiWaitCount,
+    const TaskId* auiWaitTasks)
+{
+    cl_mem kBuffer = getMemObject(kMemObjectHandle);
+    if(kBuffer == 0 || uiDeviceIndex >= m_uiDeviceCount)
+        return INVALID_TASK;
+
+    std::vector<cl_event> akWaitEvents;
+    if(!prepareWaitList(uiWaitCount, auiWaitTasks, akWaitEvents))
+        return INVALID_TASK;
+
+    const char* acMemObjName = m_akInternedNames[kMemObjectHandle.m_uiIndex];
+    cl_event kEvent = 0;
+    int iError = clEnqueueWriteBuffer(m_akTransferQueues[uiDeviceIndex], kBuffer, CL_FALSE, 
+                                      (size_t)uiStart, (size_t)kBytes, pvData, 
+                                      (cl_uint)akWaitEvents.size(), 
+                                      akWaitEvents.empty() ? NULL : &akWaitEvents[0], 
+                                      &kEvent);
+    if(iError)
+	{
+        printf("Compute Engine: Error enqueueing write of buffer %s\n", acMemObjName);
+		ReportError(iError);
+		return INVALID_TASK;
+	}
+
+    return addTask(kEvent, acMemObjName, CL_COMMAND_WRITE_BUFFER);
+}
+
+bool
+ComputeEngine::waitForTask(
+    TaskId uiTask)
+{
+    if(uiTask >= m_akTasks.size())
+        return false;
+
+    // the queues may not have been flushed, and waiting on an event whose command 
+    // hasn't been submitted could wait forever
+    for(uint i = 0; i < m_uiDeviceCount; i++)
+    {
+        clFlush(m_akCommandQueues[i]);
+        clFlush(m_akTransferQueues[i]);
+    }
+    
+    int iError = clWaitForEvents(1, &m_akTasks[uiTask].kEvent);
+    if(iError != CL_SUCCESS)
+    {
+        printf("Compute Engine: Error waiting for task '%s'\n", m_akTasks[uiTask].acName);
+		ReportError(iError);
+        return false;
+    }
+    return true;
+}
+
+bool
+ComputeEngine::finishTasks()
+{
+    int iError = CL_SUCCESS;
+    for(uint i = 0; i < m_uiDeviceCount; i++)
+    {
+        iError |= clFinish(m_akCommandQueues[i]);
+        iError |= clFinish(m_akTransferQueues[i]);
+    }
+    if(iError != CL_SUCCESS)
+    {
+        printf("Compute Engine: Error finishing tasks!\n");
+		ReportError(iError);
+    }
+
+    m_akTaskProfiles.clear();
+    if(m_bProfiling)
+    {
+        for(uint i = 0; i < m_akTasks.size(); i++)
+        {
+            TaskProfile kProfile;
+            kProfile.acName = m_akTasks[i].acName;
+            kProfile.kCommandType = m_akTasks[i].kCommandType;
+
+            cl_event kEvent = m_akTasks[i].kEvent;
+            int iInfoError = clGetEventProfilingInfo(kEvent, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &kProfile.kQueued, 0);
+            iInfoError |= clGetEventProfilingInfo(kEvent, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &kProfile.kSubmit, 0);
+            iInfoError |= clGetEventProfilingInfo(kEvent, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &kProfile.kStart, 0);
+            iInfoError |= clGetEventProfilingInfo(kEvent, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &kProfile.kEnd, 0);
+            if(iInfoError != CL_SUCCESS)
+                memset(&kProfile.kQueued, 0, 4 * sizeof(cl_ulong));
+            m_akTaskProfiles.push_back(kProfile);
+
+            if(iInfoError == CL_SUCCESS)
+            {
+                TaskStatistics &rkStats = m_akTaskStatistics[TaskKey(kProfile.acName, kProfile.kCommandType)];
+                rkStats.uiCount++;
+                rkStats.dQueuedToSubmit += (double)(kProfile.kSubmit - kProfile.kQueued);
+                rkStats.dSubmitToStart += (double)(kProfile.kStart - kProfile.kSubmit);
+                rkStats.dStartToEnd += (double)(kProfile.kEnd - kProfile.kStart);
+            }
+        }
+    }
+
+    releaseTasks();
+    return iError == CL_SUCCESS;
+}
+
+void
+ComputeEngine::releaseTasks()
+{
+    for(uint i = 0; i < m_akTasks.size(); i++)
+    {
+        if(m_akTasks[i].kEvent)
+            clReleaseEvent(m_akTasks[i].kEvent);
+    }
+    m_akTasks.clear();
+}
+
+bool 
+ComputeEngine::getTaskProfile(
+    TaskId uiTask, 
+    TaskProfile &rkProfile)
+{
+    if(uiTask >= m_akTaskProfiles.size())
+        return false;
+        
+    rkProfile = m_akTaskProfiles[uiTask];
+    return true;
+}
+
+void
+ComputeEngine::reportTaskProfiles()
+{
+    printf(SEPARATOR);
+    printf("Compute Engine: Task profile (mean microseconds)\n");
+    printf("%-32s %-8s %8s %12s %12s %12s\n", "Name", "Command", "Count", "Queued", "Submitted", "Running");
+    
+    TaskStatisticsMapIter pkIter;
+    for(pkIter = m_akTaskStatistics.begin(); pkIter != m_akTaskStatistics.end(); pkIter++)
+    {
+        const TaskStatistics &rkStats = pkIter->second;
+        const char* acCommand = "Other";
+        switch(pkIter->first.second)
+        {
+        case CL_COMMAND_NDRANGE_KERNEL: acCommand = "Kernel";  break;
+        case CL_COMMAND_READ_BUFFER:    acCommand = "Read";    break;
+        case CL_COMMAND_WRITE_BUFFER:   acCommand = "Write";   break;
+        }
+        double dScale = 1.0 / (1000.0 * rkStats.uiCount);
+        printf("%-32s %-8s %8d %12.1f %12.1f %12.1f\n", pkIter->first.first, acCommand, rkStats.uiCount,
+            rkStats.dQueuedToSubmit * dScale, rkStats.dSubmitToStart * dScale, rkStats.dStartToEnd * dScale);
+    }
+    printf(SEPARATOR);
+}
+
+void
+ComputeEngine::resetTaskProfiles()
+{
+    m_akTaskStatistics.clear();
+}
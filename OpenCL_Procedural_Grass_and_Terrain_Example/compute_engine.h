@@ -50,14 +50,21 @@
 #define odd(x) (x%2)
 
 #include <map>
+#include <vector>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifdef __APPLE__
 #include <OpenGL/OpenGL.h>
 #include <OpenCL/opencl.h>
+#else
+#include <GL/gl.h>
+#include <CL/cl.h>
+#include <CL/cl_gl.h>
+#endif
 
 #include "compute_types.h"
 
@@ -112,13 +119,54 @@ public:
         FLOAT                      = CL_FLOAT
     };
 
+    // Kernels and memory objects can be named by handles instead of strings, resolved 
+    // once with getKernelHandle() and getMemObjectHandle(), so that per frame calls don't 
+    // look names up.  A handle stays bound to its name: recreating or swapping the object
+    // behind a name is seen through it.  Handles are valid until disconnect().
+    
+    template <int iKind>
+    class Handle
+    {
+    public:
+        Handle() : m_uiIndex(UINT_MAX) {}
+        bool isValid() const { return m_uiIndex != UINT_MAX; }
+
+    private:
+        friend class ComputeEngine;
+        explicit Handle(uint uiIndex) : m_uiIndex(uiIndex) {}
+        uint m_uiIndex;
+    };
+    
+    typedef Handle<0> KernelHandle;
+    typedef Handle<1> MemObjectHandle;
+
+    // Tasks are commands enqueued without blocking, ordered only by the tasks each one
+    // waits for.  Kernels go to the device's command queue, reads and writes to its
+    // transfer queue, so transfers can overlap with compute.  Buffers given to reads and 
+    // writes must stay valid until the task completes.  Task ids are valid from 
+    // beginTasks() to finishTasks().
+
+    typedef uint TaskId;
+    enum { INVALID_TASK = UINT_MAX };
+
+    struct TaskProfile
+    {
+        const char*     acName;             // kernel or memory object
+        cl_command_type kCommandType;
+        cl_ulong        kQueued;            // device time stamps in nanoseconds
+        cl_ulong        kSubmit;
+        cl_ulong        kStart;
+        cl_ulong        kEnd;
+    };
+
     ComputeEngine();
     ~ComputeEngine();
     
     bool connect(
         DeviceType eDeviceType = DEVICE_TYPE_ALL, 
         uint uiCount = 1,
-        bool bUseOpenGLContext = false);
+        bool bUseOpenGLContext = false,
+        bool bEnableProfiling = false);
     
     bool disconnect();
 
@@ -145,8 +193,28 @@ public:
         void **pvArgsValue, 
         size_t *ptArgsSize);
 
+    bool setKernelArg(
+        KernelHandle kKernel,
+        uint uiIndex,  
+        void *pvArgsValue, 
+        size_t ptArgsSize);
+
+    // Same as setKernelArg(), but only calls into OpenCL when the value differs from 
+    // the last one set for that argument, so a kernel's full argument list can be 
+    // updated every frame for the cost of a compare.
+    bool updateKernelArg(
+        KernelHandle kKernel,
+        uint uiIndex,  
+        const void *pvArgsValue, 
+        size_t ptArgsSize);
+
+    uint getKernelArgBindCount()      { return m_uiKernelArgBindCount; }
+
     uint getKernelArgCount(
         const char* acKernelName);
+
+    uint getKernelArgCount(
+        KernelHandle kKernel);
         
     bool createKernel(
         const char* acProgramName,
@@ -158,6 +226,13 @@ public:
         size_t* uiGlobalDim,
         size_t* uiLocalDim,
         uint uiDimCount);
+
+    bool executeKernel(
+        KernelHandle kKernel,
+        uint uiDeviceId,
+        size_t* uiGlobalDim,
+        size_t* uiLocalDim,
+        uint uiDimCount);
         
     bool createBuffer(
         const char* acMemObjName, 
@@ -171,12 +246,26 @@ public:
         size_t kBytes,
         void* pvData);
         
+    bool readBuffer(
+        MemObjectHandle kMemObject,
+        uint uiDeviceIndex,
+        uint uiStart,
+        size_t kBytes,
+        void* pvData);
+        
     bool writeBuffer(
         const char* acMemObjName,
         uint uiDeviceIndex,
         uint uiStart,
         size_t kBytes,
         void* pvData);
+
+    bool writeBuffer(
+        MemObjectHandle kMemObject,
+        uint uiDeviceIndex,
+        uint uiStart,
+        size_t kBytes,
+        void* pvData);
     
     cl_mem getBuffer(
         const char* acMemObjName);
@@ -221,6 +310,18 @@ public:
     cl_mem getMemObject(
         const char* acMemObjName);
 
+    KernelHandle getKernelHandle(
+        const char* acKernelName);
+
+    MemObjectHandle getMemObjectHandle(
+        const char* acMemObjName);
+
+    cl_kernel getKernelObject(
+        KernelHandle kKernel)   { return (kKernel.m_uiIndex < m_akKernelSlots.size()) ? m_akKernelSlots[kKernel.m_uiIndex] : (cl_kernel)0; }
+
+    cl_mem getMemObject(
+        MemObjectHandle kMemObject) { return (kMemObject.m_uiIndex < m_akMemObjectSlots.size()) ? m_akMemObjectSlots[kMemObject.m_uiIndex] : (cl_mem)0; }
+
     bool clearMemory(
         const char* acMemObjName,
         uint uiValue,
@@ -252,6 +353,14 @@ public:
         const char* acMemObjName,
         uint uiDeviceIndex = 0);
 
+    bool attachGLBuffer(
+        MemObjectHandle kMemObject,
+        uint uiDeviceIndex = 0);
+
+    bool detachGLBuffer(
+        MemObjectHandle kMemObject,
+        uint uiDeviceIndex = 0);
+
     bool createGLTexture2DReference(
         const char* acMemObjName,
         MemFlags eMemFlags, 
@@ -278,6 +387,50 @@ public:
     uint getContextDeviceCount();
     unsigned long getMaxAllocationSizeInBytes();
     uint getEstimatedWorkGroupSize(const char* acKernelName, uint uiDeviceIndex = 0 );
+    uint getEstimatedWorkGroupSize(KernelHandle kKernel, uint uiDeviceIndex = 0 );
+
+    void beginTasks();
+    
+    TaskId enqueueKernel(
+        KernelHandle kKernel,
+        uint uiDeviceIndex,
+        size_t* auiGlobalDim,
+        size_t* auiLocalDim,
+        uint uiDimCount,
+        uint uiWaitCount = 0,
+        const TaskId* auiWaitTasks = 0);
+
+    TaskId enqueueReadBuffer(
+        MemObjectHandle kMemObject,
+        uint uiDeviceIndex,
+        uint uiStart,
+        size_t kBytes,
+        void* pvData,
+        uint uiWaitCount = 0,
+        const TaskId* auiWaitTasks = 0);
+
+    TaskId enqueueWriteBuffer(
+        MemObjectHandle kMemObject,
+        uint uiDeviceIndex,
+        uint uiStart,
+        size_t kBytes,
+        const void* pvData,
+        uint uiWaitCount = 0,
+        const TaskId* auiWaitTasks = 0);
+
+    bool waitForTask(
+        TaskId uiTask);
+
+    // Waits for every task, and with profiling, records when each was queued, submitted,
+    // started and ended, until the next beginTasks().
+    bool finishTasks();
+
+    uint getTaskCount()         { return (uint)m_akTasks.size(); }
+    bool getTaskProfile(TaskId uiTask, TaskProfile &rkProfile);
+    
+    // Prints the mean times of the tasks finished since the last reset, by name and command.
+    void reportTaskProfiles();
+    void resetTaskProfiles();
     
     bool isConnected()			{ return m_kContext != 0; }
     cl_context getContext()		{ return m_kContext; }
@@ -286,9 +439,35 @@ public:
 
 protected:
 
-    typedef std::map<const char*, cl_kernel>::iterator KernelMapIter;
+    typedef std::map<const char*, uint, ltstr>::iterator KernelMapIter;
     typedef std::map<const char*, cl_program>::iterator ProgramMapIter;
-    typedef std::map<const char*, cl_mem>::iterator MemObjectMapIter;
+    typedef std::map<const char*, uint, ltstr>::iterator MemObjectMapIter;
+
+    struct Task
+    {
+        cl_event        kEvent;
+        const char*     acName;
+        cl_command_type kCommandType;
+    };
+    
+    struct TaskStatistics
+    {
+        uint            uiCount;
+        double          dQueuedToSubmit;    // in nanoseconds, summed
+        double          dSubmitToStart;
+        double          dStartToEnd;
+    };
+    
+    typedef std::vector<unsigned char> KernelArgValue;
+    typedef std::pair<const char*, cl_command_type> TaskKey;
+    typedef std::map<TaskKey, TaskStatistics>::iterator TaskStatisticsMapIter;
+
+    uint internKernelName(const char* acKernelName);
+    uint internMemObjectName(const char* acMemObjName);
+    void setMemObject(const char* acMemObjName, cl_mem kMemObject);
+    bool prepareWaitList(uint uiWaitCount, const TaskId* auiWaitTasks, std::vector<cl_event> &rakEvents);
+    TaskId addTask(cl_event kEvent, const char* acName, cl_command_type kCommandType);
+    void releaseTasks();
     
     static unsigned int ms_uiMaxDeviceCount;
     
@@ -296,10 +475,21 @@ protected:
     cl_context        m_kContext;
     cl_device_id*     m_akDeviceIds;
     cl_command_queue* m_akCommandQueues;
+    cl_command_queue* m_akTransferQueues;
+    bool              m_bProfiling;
 
 	std::map<const char*, cl_program, ltstr> m_akPrograms;
-	std::map<const char*, cl_kernel, ltstr> m_akKernels;
-	std::map<const char*, cl_mem, ltstr> m_akMemObjects;
+	std::map<const char*, uint, ltstr> m_akKernels;           // name to slot
+	std::map<const char*, uint, ltstr> m_akMemObjects;
+	std::vector<cl_kernel> m_akKernelSlots;
+	std::vector<cl_mem> m_akMemObjectSlots;
+	std::vector<char*> m_akInternedNames;                       // the maps' keys, indexed by slot
+	std::vector< std::vector<KernelArgValue> > m_akKernelArgValues;  // last value set, per slot and index
+	uint m_uiKernelArgBindCount;
+
+	std::vector<Task> m_akTasks;
+	std::vector<TaskProfile> m_akTaskProfiles;
+	std::map<TaskKey, TaskStatistics> m_akTaskStatistics;
 
 private:
     ComputeEngine(const ComputeEngine &rkCopy);
@@ -0,0 +1,254 @@
+//
+// File:       compute_engine_benchmark.cpp
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Frame time benchmark for the ComputeEngine task graph.  Each frame uploads a number of
+// pages, runs a kernel over each and reads the results back, first with the blocking
+// writeBuffer / executeKernel / readBuffer calls and then as a task graph where each 
+// page's write, kernel and read only wait on each other, so one page's transfers can 
+// overlap another page's kernel.  Checks that both produce the host's results and prints 
+// the mean frame times and the per-command profile.  Needs an OpenCL platform; it isn't 
+// part of the Grass target, but builds on other platforms with an OpenCL ICD, e.g.:
+//
+//   c++ -O3 compute_engine_benchmark.cpp compute_engine.cpp compute_math.cpp -lOpenCL
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "compute_engine.h"
+#include "data_loader.h"
+#include "compute_math.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __APPLE__
+#include "timing.h"
+#else
+#include <time.h>
+
+static inline uint64_t
+GetCurrentTime()
+{
+    struct timespec kTime;
+    clock_gettime(CLOCK_MONOTONIC, &kTime);
+    return (uint64_t)kTime.tv_sec * 1000000000ull + kTime.tv_nsec;
+}
+
+static inline double
+SubtractTime( uint64_t uiEndTime, uint64_t uiStartTime )
+{
+    return 1e-9 * (double)(uiEndTime - uiStartTime);
+}
+
+// the benchmark only builds programs from strings, data_loader.m is Cocoa
+
+int FindResourcePath(const char* acFilename, char** acPathname, unsigned int *uiPathLength)
+{
+    *acPathname = strdup(acFilename);
+    *uiPathLength = (unsigned int)strlen(acFilename);
+    return 0;
+}
+
+int LoadTextFromFile(const char * /* file_name */, char **result_string, size_t *string_len)
+{
+    *result_string = 0;
+    *string_len = 0;
+    return -1;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const uint PageCount = 8;
+static const uint PageElements = 256 * 1024;
+static const uint Iterations = 32;
+static const uint FrameCount = 50;
+
+static const char* BenchmarkKernelSource = 
+"__kernel void Shade(__global const float* input, __global float* output, uint count, uint iterations)\n"
+"{\n"
+"    uint i = get_global_id(0);\n"
+"    if(i >= count) return;\n"
+"    float x = input[i];\n"
+"    float y = 0.0f;\n"
+"    for(uint k = 0; k < iterations; k++)\n"
+"        y = y * 0.5f + x * (float)(k + 1) * 0.25f;\n"
+"    output[i] = y;\n"
+"}\n";
+
+static float
+ShadeOnHost(float x)
+{
+    float y = 0.0f;
+    for(uint k = 0; k < Iterations; k++)
+        y = y * 0.5f + x * (float)(k + 1) * 0.25f;
+    return y;
+}
+
+static bool
+CheckOutputs(const char* acLabel, float** aafOutputs, float** aafInputs)
+{
+    double dMaxError = 0.0;
+    for(uint p = 0; p < PageCount; p++)
+    {
+        for(uint i = 0; i < PageElements; i++)
+        {
+            double dExpected = ShadeOnHost(aafInputs[p][i]);
+            double dError = fabs(aafOutputs[p][i] - dExpected) / (fabs(dExpected) + 1.0);
+            dMaxError = dError > dMaxError ? dError : dMaxError;
+        }
+    }
+    bool bOk = dMaxError < 1e-4;
+    printf("%-10s max relative error %g %s\n", acLabel, dMaxError, bOk ? "ok" : "FAILED");
+    return bOk;
+}
+
+int main(int argc, char** argv)
+{
+    ComputeEngine kCompute;
+    if(!kCompute.connect(ComputeEngine::DEVICE_TYPE_ALL, 1, false, true))
+    {
+        printf("No OpenCL device available, nothing to measure.\n");
+        return 0;
+    }
+    if(!kCompute.createProgramFromSourceString("benchmark", BenchmarkKernelSource) ||
+       !kCompute.createKernel("benchmark", "Shade"))
+    {
+        printf("Failed to build the benchmark kernel!\n");
+        return 1;
+    }
+
+    float* aafInputs[PageCount];
+    float* aafOutputs[PageCount];
+    ComputeEngine::MemObjectHandle akInputs[PageCount];
+    ComputeEngine::MemObjectHandle akOutputs[PageCount];
+    for(uint p = 0; p < PageCount; p++)
+    {
+        char acName[32];
+        aafInputs[p] = new float[PageElements];
+        aafOutputs[p] = new float[PageElements];
+        for(uint i = 0; i < PageElements; i++)
+            aafInputs[p][i] = (float)((i * 7 + p * 131) % 1024) / 1024.0f;
+
+        snprintf(acName, sizeof(acName), "input_%d", p);
+        kCompute.createBuffer(acName, ComputeEngine::MEM_READ_ONLY, PageElements * sizeof(float));
+        akInputs[p] = kCompute.getMemObjectHandle(acName);
+        snprintf(acName, sizeof(acName), "output_%d", p);
+        kCompute.createBuffer(acName, ComputeEngine::MEM_WRITE_ONLY, PageElements * sizeof(float));
+        akOutputs[p] = kCompute.getMemObjectHandle(acName);
+    }
+
+    ComputeEngine::KernelHandle kKernel = kCompute.getKernelHandle("Shade");
+    uint uiCount = PageElements;
+    uint uiIterations = Iterations;
+    uint uiLocal = kCompute.getEstimatedWorkGroupSize(kKernel);
+    uiLocal = uiLocal ? uiLocal : 1;
+    size_t auiGlobalDim[1] = { divide_up(PageElements, uiLocal) * uiLocal };
+    size_t auiLocalDim[1] = { uiLocal };
+    
+    kCompute.setKernelArg(kKernel, 2, &uiCount, sizeof(uint));
+    kCompute.setKernelArg(kKernel, 3, &uiIterations, sizeof(uint));
+
+    // blocking: every call waits for the one before it
+
+    double dBlocking = 0.0;
+    for(uint f = 0; f < FrameCount; f++)
+    {
+        uint64_t uiStart = GetCurrentTime();
+        for(uint p = 0; p < PageCount; p++)
+        {
+            cl_mem kInput = kCompute.getMemObject(akInputs[p]);
+            cl_mem kOutput = kCompute.getMemObject(akOutputs[p]);
+            kCompute.writeBuffer(akInputs[p], 0, 0, PageElements * sizeof(float), aafInputs[p]);
+            kCompute.setKernelArg(kKernel, 0, &kInput, sizeof(cl_mem));
+            kCompute.setKernelArg(kKernel, 1, &kOutput, sizeof(cl_mem));
+            kCompute.executeKernel(kKernel, 0, auiGlobalDim, auiLocalDim, 1);
+            kCompute.readBuffer(akOutputs[p], 0, 0, PageElements * sizeof(float), aafOutputs[p]);
+        }
+        dBlocking += SubtractTime(GetCurrentTime(), uiStart);
+    }
+    bool bOk = CheckOutputs("blocking", aafOutputs, aafInputs);
+
+    for(uint p = 0; p < PageCount; p++)
+        memset(aafOutputs[p], 0, PageElements * sizeof(float));
+
+    // task graph: each page's kernel waits on its own write, each read on its own kernel
+
+    double dGraph = 0.0;
+    kCompute.resetTaskProfiles();
+    for(uint f = 0; f < FrameCount; f++)
+    {
+        uint64_t uiStart = GetCurrentTime();
+        kCompute.beginTasks();
+        for(uint p = 0; p < PageCount; p++)
+        {
+            cl_mem kInput = kCompute.getMemObject(akInputs[p]);
+            cl_mem kOutput = kCompute.getMemObject(akOutputs[p]);
+            ComputeEngine::TaskId uiWrite = kCompute.enqueueWriteBuffer(akInputs[p], 0, 0, PageElements * sizeof(float), aafInputs[p]);
+            kCompute.setKernelArg(kKernel, 0, &kInput, sizeof(cl_mem));
+            kCompute.setKernelArg(kKernel, 1, &kOutput, sizeof(cl_mem));
+            ComputeEngine::TaskId uiKernel = kCompute.enqueueKernel(kKernel, 0, auiGlobalDim, auiLocalDim, 1, 1, &uiWrite);
+            kCompute.enqueueReadBuffer(akOutputs[p], 0, 0, PageElements * sizeof(float), aafOutputs[p], 1, &uiKernel);
+        }
+        bOk = kCompute.finishTasks() && bOk;
+        dGraph += SubtractTime(GetCurrentTime(), uiStart);
+    }
+    bOk = CheckOutputs("graph", aafOutputs, aafInputs) && bOk;
+
+    printf("%d pages of %d floats, %d frames\n", PageCount, PageElements, FrameCount);
+    printf("blocking   %8.3f ms/frame\n", 1000.0 * dBlocking / FrameCount);
+    printf("graph      %8.3f ms/frame (%.2fx)\n", 1000.0 * dGraph / FrameCount, dBlocking / dGraph);
+    kCompute.reportTaskProfiles();
+
+    for(uint p = 0; p < PageCount; p++)
+    {
+        delete [] aafInputs[p];
+        delete [] aafOutputs[p];
+    }
+    kCompute.disconnect();
+    return bOk ? 0 : 1;
+}
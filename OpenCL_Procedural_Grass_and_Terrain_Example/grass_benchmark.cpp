@@ -0,0 +1,219 @@
+//
+// File:       grass_benchmark.cpp
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Headless benchmark for the grass simulator.  Sweeps the camera around the field and, 
+// for every view, times whole frames (culling, compaction and the per-blade kernel) with 
+// culling off, with frustum and distance culling, and with culling plus distance LOD, 
+// reporting how many blades were processed, the frame time and how many kernel arguments 
+// actually had to be rebound.  Run it from this directory so grass_kernels.cl is found.  
+// Prefers a CPU OpenCL device; not part of the Grass target, but builds on other 
+// platforms with an OpenCL ICD, e.g.:
+//
+//   c++ -O3 -DGL_GLEXT_PROTOTYPES grass_benchmark.cpp grass_simulator.cpp compute_engine.cpp compute_math.cpp -lOpenCL -lGL
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "grass_simulator.h"
+#include "data_loader.h"
+#include "compute_math.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __APPLE__
+#include "timing.h"
+#else
+#include <time.h>
+
+static inline uint64_t
+GetCurrentTime()
+{
+    struct timespec kTime;
+    clock_gettime(CLOCK_MONOTONIC, &kTime);
+    return (uint64_t)kTime.tv_sec * 1000000000ull + kTime.tv_nsec;
+}
+
+static inline double
+SubtractTime( uint64_t uiEndTime, uint64_t uiStartTime )
+{
+    return 1e-9 * (double)(uiEndTime - uiStartTime);
+}
+
+// data_loader.m is Cocoa, resources are looked up in the working directory instead
+
+int FindResourcePath(const char* acFilename, char** acPathname, unsigned int *uiPathLength)
+{
+    *acPathname = strdup(acFilename);
+    *uiPathLength = (unsigned int)strlen(acFilename);
+    return 0;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const uint BladeCount = 256 * 256;
+static const uint ViewCount = 12;
+static const uint FrameCount = 10;
+
+enum Mode
+{
+    MODE_ALL,
+    MODE_CULLED,
+    MODE_CULLED_LOD,
+    MODE_COUNT
+};
+
+static const char* ModeNames[MODE_COUNT] = { "all", "culled", "culled+lod" };
+
+static void
+SetView(GrassSimulator &rkGrass, uint uiView)
+{
+    // walk around a circle, looking slightly down and alternately in and out
+    float fAngle = 2.0f * (float)M_PI * uiView / ViewCount;
+    float fYaw = (uiView & 1) ? fAngle + (float)M_PI : fAngle;
+    float3 kPosition = make_float3(200.0f * cosf(fAngle), 20.0f, 200.0f * sinf(fAngle));
+    float3 kView = normalize(make_float3(sinf(fYaw), -0.2f, cosf(fYaw)));
+    float3 kUp = make_float3(0.0f, 1.0f, 0.0f);
+    float3 kLeft = normalize(cross(kUp, kView));
+    kUp = cross(kView, kLeft);
+    
+    rkGrass.setCameraPosition(make_float4(kPosition.x, kPosition.y, kPosition.z, 1.0f));
+    rkGrass.setCameraRotation(make_float4(fYaw * 180.0f / (float)M_PI, -10.0f, 0.0f, 0.0f));
+    rkGrass.setCameraFrame(make_float4(kUp.x, kUp.y, kUp.z, 0.0f),
+                           make_float4(kView.x, kView.y, kView.z, 0.0f),
+                           make_float4(kLeft.x, kLeft.y, kLeft.z, 0.0f));
+}
+
+int main(int argc, char** argv)
+{
+    ComputeEngine kCompute;
+    if(!kCompute.connect(ComputeEngine::DEVICE_TYPE_CPU, 1, false) &&
+       !kCompute.connect(ComputeEngine::DEVICE_TYPE_ALL, 1, false))
+    {
+        printf("No OpenCL device available, nothing to measure.\n");
+        return 0;
+    }
+
+    GrassSimulator kGrass;
+    kGrass.setMaxElementCount(4);
+    kGrass.setMaxSegmentCount(6);
+    kGrass.setFalloffDistance(200.0f);
+    kGrass.setCameraFov(70.0f);
+    kGrass.setClipRange(make_float2(0.9f, 1.02f));
+    kGrass.setBladeOpacity(0.2f);
+    kGrass.setBladeIntensity(1.4f);
+    kGrass.setBladeLengthRange(make_float2(5.64f, 1.1f));
+    kGrass.setBladeThicknessRange(make_float2(1.99f, 2.0f));
+    kGrass.setNoiseBias(make_float2(0.5f, 0.5f));
+    kGrass.setNoiseScale(make_float2(1.0f, 10.0f));
+    kGrass.setNoiseAmplitude(0.25f);
+    kGrass.setFlowScale(100.0f);
+    kGrass.setFlowSpeed(100.0f);
+    kGrass.setFlowAmount(30.0f);
+    kGrass.setJitterAmount(2.0f);
+    kGrass.setCullDistance(400.0f);
+    if(!kGrass.setup(kCompute, BladeCount, 1000, 1000))
+    {
+        kCompute.disconnect();
+        return 1;
+    }
+
+    double adTime[MODE_COUNT] = { 0 };
+    double adBlades[MODE_COUNT] = { 0 };
+    double adBinds[MODE_COUNT] = { 0 };
+    uint uiIteration = 0;
+    
+    printf("%-6s", "view");
+    for(uint m = 0; m < MODE_COUNT; m++)
+        printf("  %12s blades %8s", ModeNames[m], "ms");
+    printf("\n");
+    
+    for(uint v = 0; v < ViewCount; v++)
+    {
+        SetView(kGrass, v);
+        printf("%-6d", v);
+        for(uint m = 0; m < MODE_COUNT; m++)
+        {
+            kGrass.setCulling(m != MODE_ALL);
+            kGrass.setLodDistance(m == MODE_CULLED_LOD ? 150.0f : 0.0f, 0.25f);
+            
+            // one untimed frame to settle the arguments for this mode
+            kGrass.computeGrassOnTerrain(kCompute, uiIteration++);
+            
+            uint uiBinds = kCompute.getKernelArgBindCount();
+            uint64_t uiStart = GetCurrentTime();
+            for(uint f = 0; f < FrameCount; f++)
+            {
+                if(!kGrass.computeGrassOnTerrain(kCompute, uiIteration++))
+                {
+                    kCompute.disconnect();
+                    return 1;
+                }
+                kCompute.finish();
+            }
+            double dTime = SubtractTime(GetCurrentTime(), uiStart) / FrameCount;
+            
+            adTime[m] += dTime;
+            adBlades[m] += kGrass.getVisibleBladeCount();
+            adBinds[m] += (double)(kCompute.getKernelArgBindCount() - uiBinds) / FrameCount;
+            printf("  %19d %8.2f", kGrass.getVisibleBladeCount(), 1000.0 * dTime);
+        }
+        printf("\n");
+    }
+
+    printf("\n%d blades, %d views, %d frames per view\n", BladeCount, ViewCount, FrameCount);
+    for(uint m = 0; m < MODE_COUNT; m++)
+    {
+        printf("%-12s %9.0f blades/frame %8.2f ms/frame (%.2fx) %5.1f args rebound/frame\n", 
+            ModeNames[m], adBlades[m] / ViewCount, 1000.0 * adTime[m] / ViewCount, 
+            adTime[MODE_ALL] / adTime[m], adBinds[m] / ViewCount);
+    }
+
+    kCompute.disconnect();
+    return 0;
+}
@@ -982,59 +982,23 @@ ComputeRadialGridPosition(
     return position;
 }
 
-__kernel void
-ComputeGrassOnTerrainKernel(
+float4
+ComputeBladePosition(
+    int index,
     int2 grid_resolution,
     float jitter_amount,
-    float time_delta,
-    float falloff_distance,
-    float camera_fov,
+    float2 clip_range,
     float4 camera_position,
     float4 camera_rotation,
     float4 camera_view,
     float4 camera_left,
-    float4 camera_up,
-    float2 clip_range,
-    float2 blade_length_range,
-    float2 blade_thickness_range,
-    float2 blade_luminance_alpha,
-    float4 flow_scale_speed_amount,
-    float4 noise_bias_scale,
-    float noise_amplitude,
-    uint4 blade_curve_segment_counts,
-    __global float4 *output_vertices,
-    __global float4 *output_colors)
+    float camera_fov,
+    float2 *blade_uv)
 {
-    int tx = get_global_id(0);
-    int ty = get_global_id(1);
-    int sx = get_global_size(0);
-    int sy = get_global_size(1);
-    int index = ty * sx + tx;
-
-    uint blade_count = blade_curve_segment_counts.x;
-    float max_elements = blade_curve_segment_counts.y;
-    float max_segments = blade_curve_segment_counts.z;
-    if (index >= blade_count)
-        return;
-
-    float ir = (float) index / (float) blade_count;
-    uint vertex_index = index * max_elements * max_segments;
-    uint max_element_vertices = max_elements * max_segments;
-    float4 empty = (float4){-999999.0f, -999999.0f, -999999.0f, 0.0f };
-
-    int2 di = (int2){ tx, ty };
     float2 vt = GetGridCoordinates(index, grid_resolution);
     float2 vs = (float2){ 1.0f / (float)(grid_resolution.x), 1.0f / (float)(grid_resolution.y) };
     float2 ve = (float2){ (float)grid_resolution.x, (float)grid_resolution.y };
     float2 uv = vt * vs;
-    
-    float4 look_at = camera_position + camera_view;
-    float4 near_pos = camera_position + camera_view * clip_range.x;
-    float4 far_pos = camera_position + camera_view * clip_range.y;
- 
-    float2 jitter_amplitude = (float2){ jitter_amount, jitter_amount };
-    float4 jitter_bias_scale = (float4){ 0.0f, 0.0f, 10.0f, 10.0f };
-    float clip_distance = length(clip_range);
 
     float frequency = 0.0025f;
     float amplitude = 70.00f;
@@ -1057,6 +1021,219 @@ ComputeGrassOnTerrainKernel(
     float4 rdnoise = RotatedSimplexNoise2dfs(sample.xz, uv.x * uv.y) * jitter_amount;
     blade_position = blade_position + rdnoise.y * left + rdnoise.z * view - fabs(rdnoise.x) * up;
 
+    *blade_uv = uv;
+    return blade_position;
+}
+
+uint
+HashBladeIndex(
+    uint index)
+{
+    index ^= index >> 16;
+    index *= 0x7feb352dU;
+    index ^= index >> 15;
+    index *= 0x846ca68bU;
+    index ^= index >> 16;
+    return index;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Writes a visibility flag for every blade (and zeros for the padding up to the global 
+// size), so that the expensive per-blade kernel below only runs for the blades that 
+// survive.  Blades are kept if they are within the view cone and the cull distance, both 
+// widened by cull_params.x to cover the blade's length and any instancing offsets.  Beyond 
+// the LOD distance only a fraction of the blades are kept, falling off with distance down 
+// to the minimum density.
+//
+//   cull_params = { margin, cull distance (0 = off), lod distance (0 = off), lod min density }
+
+__kernel void
+CullGrassBladesKernel(
+    int2 grid_resolution,
+    float jitter_amount,
+    float camera_fov,
+    float4 camera_position,
+    float4 camera_rotation,
+    float4 camera_view,
+    float4 camera_left,
+    float2 clip_range,
+    float2 blade_length_range,
+    float4 cull_params,
+    uint cull_enable,
+    uint blade_count,
+    __global uint *visible_flags)
+{
+    uint index = get_global_id(0);
+    if (index >= blade_count)
+    {
+        visible_flags[index] = 0;
+        return;
+    }
+    
+    if (!cull_enable)
+    {
+        visible_flags[index] = 1;
+        return;
+    }
+
+    float2 uv;
+    float4 blade_position = ComputeBladePosition(index, grid_resolution, jitter_amount, clip_range, camera_position, camera_rotation, camera_view, camera_left, camera_fov, &uv);
+
+    float3 delta = blade_position.xyz - camera_position.xyz;
+    float eye_distance = length(delta);
+    float reach = cull_params.x + blade_length_range.y;
+
+    bool visible = (cull_params.y <= 0.0f) || (eye_distance <= cull_params.y + reach);
+
+    float3 view = normalize(camera_view.xyz);
+    float along = dot(delta, view);
+    float cone = RADIANS(camera_fov) + atan2(reach, fmax(eye_distance, 1e-3f));
+    visible = visible && (cone >= M_PI_F || along >= eye_distance * native_cos(cone));
+
+    if (visible && cull_params.z > 0.0f && eye_distance > cull_params.z)
+    {
+        float density = fmax(cull_params.z / eye_distance, cull_params.w);
+        visible = (HashBladeIndex(index) & 0xffff) < (uint)(density * 65536.0f);
+    }
+    
+    visible_flags[index] = visible ? 1 : 0;
+}
+
+// Exclusive prefix sum of the flags within each work-group, plus each group's total.
+
+__kernel void
+ScanBladeFlagsKernel(
+    __global const uint *visible_flags,
+    __global uint *visible_offsets,
+    __global uint *group_totals,
+    __local uint *scratch)
+{
+    uint gid = get_global_id(0);
+    uint lid = get_local_id(0);
+    uint size = get_local_size(0);
+
+    uint flag = visible_flags[gid];
+    scratch[lid] = flag;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (uint offset = 1; offset < size; offset <<= 1)
+    {
+        uint value = (lid >= offset) ? scratch[lid - offset] : 0;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        scratch[lid] += value;
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    visible_offsets[gid] = scratch[lid] - flag;
+    if (lid == size - 1)
+        group_totals[get_group_id(0)] = scratch[lid];
+}
+
+// Turns the group totals into exclusive group offsets in place and writes the number of 
+// visible blades.  Runs as a single work-group, stepping through the totals one 
+// work-group's worth at a time.
+
+__kernel void
+ScanGroupTotalsKernel(
+    __global uint *group_totals,
+    uint group_count,
+    __global uint *visible_count,
+    __local uint *scratch)
+{
+    uint lid = get_local_id(0);
+    uint size = get_local_size(0);
+    uint running = 0;
+
+    for (uint base = 0; base < group_count; base += size)
+    {
+        uint total = (base + lid < group_count) ? group_totals[base + lid] : 0;
+        scratch[lid] = total;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (uint offset = 1; offset < size; offset <<= 1)
+        {
+            uint value = (lid >= offset) ? scratch[lid - offset] : 0;
+            barrier(CLK_LOCAL_MEM_FENCE);
+            scratch[lid] += value;
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+
+        if (base + lid < group_count)
+            group_totals[base + lid] = running + scratch[lid] - total;
+            
+        running += scratch[size - 1];
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (lid == 0)
+        visible_count[0] = running;
+}
+
+// Writes the index of every visible blade to its slot in the compacted list.  Must run 
+// with the same local size as ScanBladeFlagsKernel.
+
+__kernel void
+CompactGrassBladesKernel(
+    __global const uint *visible_flags,
+    __global const uint *visible_offsets,
+    __global const uint *group_offsets,
+    uint blade_count,
+    __global uint *visible_blades)
+{
+    uint gid = get_global_id(0);
+    if (gid >= blade_count || !visible_flags[gid])
+        return;
+
+    visible_blades[group_offsets[get_group_id(0)] + visible_offsets[gid]] = gid;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+__kernel void
+ComputeGrassOnTerrainKernel(
+    int2 grid_resolution,
+    float jitter_amount,
+    float time_delta,
+    float falloff_distance,
+    float camera_fov,
+    float4 camera_position,
+    float4 camera_rotation,
+    float4 camera_view,
+    float4 camera_left,
+    float4 camera_up,
+    float2 clip_range,
+    float2 blade_length_range,
+    float2 blade_thickness_range,
+    float2 blade_luminance_alpha,
+    float4 flow_scale_speed_amount,
+    float4 noise_bias_scale,
+    float noise_amplitude,
+    uint4 blade_curve_segment_counts,
+    __global float4 *output_vertices,
+    __global float4 *output_colors,
+    __global const uint *visible_blades,
+    uint visible_count)
+{
+    // one work-item per visible blade, written to the vertex range of its compacted slot
+    uint slot = get_global_id(0);
+    if (slot >= visible_count)
+        return;
+        
+    int index = visible_blades[slot];
+
+    uint blade_count = blade_curve_segment_counts.x;
+    float max_elements = blade_curve_segment_counts.y;
+    float max_segments = blade_curve_segment_counts.z;
+
+    float ir = (float) index / (float) blade_count;
+    uint vertex_index = slot * max_elements * max_segments;
+    uint max_element_vertices = max_elements * max_segments;
+    float4 empty = (float4){-999999.0f, -999999.0f, -999999.0f, 0.0f };
+
+    float2 uv;
+    float4 blade_position = ComputeBladePosition(index, grid_resolution, jitter_amount, clip_range, camera_position, camera_rotation, camera_view, camera_left, camera_fov, &uv);
+
     float2 np = blade_position.xz;  
     float4 field_range = noise_bias_scale;
     field_range.xy = noise_bias_scale.xy;
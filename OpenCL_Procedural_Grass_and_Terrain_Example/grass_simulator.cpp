@@ -71,6 +71,14 @@
 
 GrassSimulator::GrassSimulator() :
     m_bInitialized(0),
+    m_uiScanGroupSize(0),
+    m_uiScanGroupCount(0),
+    m_uiVisibleBladeCount(0),
+    m_bCulling(true),
+    m_fCullMargin(0),
+    m_fCullDistance(0),
+    m_fLodDistance(0),
+    m_fLodMinDensity(0),
     m_uiWorkItemCount(0),
     m_uiRowCount(0),
     m_uiColumnCount(0),
@@ -235,6 +243,57 @@ GrassSimulator::reset(
         return false;
     }
 
+    m_kVertices = rkCompute.getMemObjectHandle("grass_vertices");
+    m_kColors = rkCompute.getMemObjectHandle("grass_colors");
+
+    // culling buffers, padded to whole scan groups
+    
+    uint uiPaddedCount = divide_up(m_uiBladeCount, m_uiScanGroupSize) * m_uiScanGroupSize;
+    m_uiScanGroupCount = uiPaddedCount / m_uiScanGroupSize;
+    
+    bOk = true;
+    bOk = bOk && rkCompute.createBuffer("grass_visible_flags",   ComputeEngine::MEM_READ_WRITE, uiPaddedCount * sizeof(uint));
+    bOk = bOk && rkCompute.createBuffer("grass_visible_offsets", ComputeEngine::MEM_READ_WRITE, uiPaddedCount * sizeof(uint));
+    bOk = bOk && rkCompute.createBuffer("grass_group_totals",    ComputeEngine::MEM_READ_WRITE, m_uiScanGroupCount * sizeof(uint));
+    bOk = bOk && rkCompute.createBuffer("grass_visible_blades",  ComputeEngine::MEM_READ_WRITE, m_uiBladeCount * sizeof(uint));
+    bOk = bOk && rkCompute.createBuffer("grass_visible_count",   ComputeEngine::MEM_READ_WRITE, sizeof(uint));
+    if(!bOk)
+    {
+        printf("Grass Simulator: Device memory allocation failed!\n");
+        return false;
+    }
+    
+    m_kVisibleFlags = rkCompute.getMemObjectHandle("grass_visible_flags");
+    m_kVisibleOffsets = rkCompute.getMemObjectHandle("grass_visible_offsets");
+    m_kGroupTotals = rkCompute.getMemObjectHandle("grass_group_totals");
+    m_kVisibleBlades = rkCompute.getMemObjectHandle("grass_visible_blades");
+    m_kVisibleCount = rkCompute.getMemObjectHandle("grass_visible_count");
+
+    // the scan and compaction arguments only change with the buffers
+    
+    cl_mem kVisibleFlags = rkCompute.getMemObject(m_kVisibleFlags);
+    cl_mem kVisibleOffsets = rkCompute.getMemObject(m_kVisibleOffsets);
+    cl_mem kGroupTotals = rkCompute.getMemObject(m_kGroupTotals);
+    cl_mem kVisibleBlades = rkCompute.getMemObject(m_kVisibleBlades);
+    cl_mem kVisibleCount = rkCompute.getMemObject(m_kVisibleCount);
+    size_t kScratchBytes = m_uiScanGroupSize * sizeof(uint);
+
+    rkCompute.setKernelArg(m_kScanKernel, 0, &kVisibleFlags,           sizeof(cl_mem));
+    rkCompute.setKernelArg(m_kScanKernel, 1, &kVisibleOffsets,         sizeof(cl_mem));
+    rkCompute.setKernelArg(m_kScanKernel, 2, &kGroupTotals,            sizeof(cl_mem));
+    rkCompute.setKernelArg(m_kScanKernel, 3, 0,                        kScratchBytes);
+
+    rkCompute.setKernelArg(m_kScanTotalsKernel, 0, &kGroupTotals,      sizeof(cl_mem));
+    rkCompute.setKernelArg(m_kScanTotalsKernel, 1, &m_uiScanGroupCount, sizeof(uint));
+    rkCompute.setKernelArg(m_kScanTotalsKernel, 2, &kVisibleCount,     sizeof(cl_mem));
+    rkCompute.setKernelArg(m_kScanTotalsKernel, 3, 0,                  kScratchBytes);
+
+    rkCompute.setKernelArg(m_kCompactKernel, 0, &kVisibleFlags,        sizeof(cl_mem));
+    rkCompute.setKernelArg(m_kCompactKernel, 1, &kVisibleOffsets,      sizeof(cl_mem));
+    rkCompute.setKernelArg(m_kCompactKernel, 2, &kGroupTotals,         sizeof(cl_mem));
+    rkCompute.setKernelArg(m_kCompactKernel, 3, &m_uiBladeCount,       sizeof(uint));
+    rkCompute.setKernelArg(m_kCompactKernel, 4, &kVisibleBlades,       sizeof(cl_mem));
+
     m_bInitialized = true;
     return true;
 }
@@ -256,13 +315,29 @@ GrassSimulator::setup(
     bool bOk = true;
     bOk = bOk && rkCompute.createProgramFromFile("gs", "grass_kernels.cl");
     bOk = bOk && rkCompute.createKernel("gs", "ComputeGrassOnTerrainKernel");
+    bOk = bOk && rkCompute.createKernel("gs", "CullGrassBladesKernel");
+    bOk = bOk && rkCompute.createKernel("gs", "ScanBladeFlagsKernel");
+    bOk = bOk && rkCompute.createKernel("gs", "ScanGroupTotalsKernel");
+    bOk = bOk && rkCompute.createKernel("gs", "CompactGrassBladesKernel");
     if(!bOk)
     {
         printf("Grass Simulator: Failed to create device kernel!\n");
         return false;
     }
 
-	m_uiWorkItemCount = rkCompute.getEstimatedWorkGroupSize("ComputeGrassOnTerrainKernel", 0);
+    m_kKernel = rkCompute.getKernelHandle("ComputeGrassOnTerrainKernel");
+    m_kCullKernel = rkCompute.getKernelHandle("CullGrassBladesKernel");
+    m_kScanKernel = rkCompute.getKernelHandle("ScanBladeFlagsKernel");
+    m_kScanTotalsKernel = rkCompute.getKernelHandle("ScanGroupTotalsKernel");
+    m_kCompactKernel = rkCompute.getKernelHandle("CompactGrassBladesKernel");
+	m_uiWorkItemCount = rkCompute.getEstimatedWorkGroupSize(m_kKernel, 0);
+    m_uiWorkItemCount = m_uiWorkItemCount ? m_uiWorkItemCount : 1;
+
+    // the scan needs a power of two group size that all three scan kernels can run with
+    uint uiMaxScanGroupSize = rkCompute.getEstimatedWorkGroupSize(m_kScanKernel, 0);
+    uiMaxScanGroupSize = min(uiMaxScanGroupSize, rkCompute.getEstimatedWorkGroupSize(m_kScanTotalsKernel, 0));
+    uiMaxScanGroupSize = min(uiMaxScanGroupSize, rkCompute.getEstimatedWorkGroupSize(m_kCompactKernel, 0));
+    for(m_uiScanGroupSize = 256; m_uiScanGroupSize > 1 && m_uiScanGroupSize > uiMaxScanGroupSize; m_uiScanGroupSize >>= 1);
     
     return reset(rkCompute);
 }
@@ -275,15 +350,18 @@ GrassSimulator::computeGrassOnTerrain(
     if(rkCompute.isConnected() == false || !m_bInitialized)
         return false;
 
-	uint uiWorkItems = m_uiWorkItemCount; 
+    if(!cullBlades(rkCompute))
+        return false;
+
+    uint uiWorkItems = m_uiWorkItemCount; 
 
     float fSqrtElements = ceil(sqrtf(m_uiBladeCount));
-    float fSqrtItems = floor(sqrtf(uiWorkItems));
     
-    int aiGridResolution[] = { fSqrtElements, fSqrtElements };
+    int aiGridResolution[] = { (int)fSqrtElements, (int)fSqrtElements };
 
-    size_t auiGlobalDim[2] = { divide_up(fSqrtElements, fSqrtItems) * fSqrtItems, divide_up(fSqrtElements, fSqrtItems) * fSqrtItems };
-    size_t auiLocalDim[2]  = { fSqrtItems, fSqrtItems };   
+    // one work-item per visible blade
+    size_t auiGlobalDim[1] = { divide_up(m_uiVisibleBladeCount, uiWorkItems) * uiWorkItems };
+    size_t auiLocalDim[1]  = { uiWorkItems };   
 
     float fDT = 0.01f * uiIteration;
     
@@ -315,38 +393,44 @@ GrassSimulator::computeGrassOnTerrain(
         m_uiMaxVertexCount 
     };
         
-    const char *acKernelName = "ComputeGrassOnTerrainKernel";
+    ComputeEngine::KernelHandle kKernel = m_kKernel;
 
-    cl_mem kGrassVertices = rkCompute.getMemObject("grass_vertices");
-    cl_mem kGrassColors = rkCompute.getMemObject("grass_colors");
+    cl_mem kGrassVertices = rkCompute.getMemObject(m_kVertices);
+    cl_mem kGrassColors = rkCompute.getMemObject(m_kColors);
+    cl_mem kVisibleBlades = rkCompute.getMemObject(m_kVisibleBlades);
     
+    // only the arguments that differ from last frame are passed on to OpenCL
     uint uiArgIndex = 0;
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, aiGridResolution,    sizeof(int) * 2);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_fJitterAmount,                         sizeof(float) * 1);   
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &fDT,                                     sizeof(float) * 1);   
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_fFalloff,                              sizeof(float) * 1);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_fCameraFov,                            sizeof(float) * 1);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_kCameraPosition,                       sizeof(float) * 4);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_kCameraRotation,                       sizeof(float) * 4);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_kCameraView,                           sizeof(float) * 4);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_kCameraLeft,                           sizeof(float) * 4);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_kCameraUp,                             sizeof(float) * 4);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_kClipRange,                            sizeof(float) * 2);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_kBladeLengthRange,                     sizeof(float) * 2);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_kBladeThicknessRange,                  sizeof(float) * 2);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &fBladeLuminanceAlpha,                    sizeof(float) * 2);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &fFlowScaleSpeedAmount,                   sizeof(float) * 4);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, afNoiseBiasScale,                         sizeof(float) * 4);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_fNoiseAmplitude,                       sizeof(float) * 1);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, auiBladeCurveSegmentCounts,               sizeof(uint)  * 4);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &kGrassVertices,                          sizeof(cl_mem));
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &kGrassColors,                            sizeof(cl_mem));
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, aiGridResolution,    sizeof(int) * 2);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_fJitterAmount,                         sizeof(float) * 1);   
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &fDT,                                     sizeof(float) * 1);   
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_fFalloff,                              sizeof(float) * 1);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_fCameraFov,                            sizeof(float) * 1);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_kCameraPosition,                       sizeof(float) * 4);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_kCameraRotation,                       sizeof(float) * 4);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_kCameraView,                           sizeof(float) * 4);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_kCameraLeft,                           sizeof(float) * 4);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_kCameraUp,                             sizeof(float) * 4);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_kClipRange,                            sizeof(float) * 2);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_kBladeLengthRange,                     sizeof(float) * 2);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_kBladeThicknessRange,                  sizeof(float) * 2);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &fBladeLuminanceAlpha,                    sizeof(float) * 2);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &fFlowScaleSpeedAmount,                   sizeof(float) * 4);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, afNoiseBiasScale,                         sizeof(float) * 4);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_fNoiseAmplitude,                       sizeof(float) * 1);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, auiBladeCurveSegmentCounts,               sizeof(uint)  * 4);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &kGrassVertices,                          sizeof(cl_mem));
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &kGrassColors,                            sizeof(cl_mem));
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &kVisibleBlades,                         sizeof(cl_mem));
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_uiVisibleBladeCount,                  sizeof(uint));
     
-    assert(uiArgIndex == rkCompute.getKernelArgCount(acKernelName));
+    assert(uiArgIndex == rkCompute.getKernelArgCount(kKernel));
 
     attachMemory(rkCompute);
 
-    bool bSuccess = rkCompute.executeKernel(acKernelName, 0, auiGlobalDim, auiLocalDim, 2);
+    bool bSuccess = true;
+    if(m_uiVisibleBladeCount)
+        bSuccess = rkCompute.executeKernel(kKernel, 0, auiGlobalDim, auiLocalDim, 1);
 
     updateOutputs(rkCompute);
     detachMemory(rkCompute);
@@ -357,6 +441,61 @@ GrassSimulator::computeGrassOnTerrain(
     return true;
 }
 
+bool
+GrassSimulator::cullBlades(
+    ComputeEngine &rkCompute)
+{
+    float fSqrtElements = ceil(sqrtf(m_uiBladeCount));
+    int aiGridResolution[] = { (int)fSqrtElements, (int)fSqrtElements };
+    float afCullParams[4] = { m_fCullMargin, m_fCullDistance, m_fLodDistance, m_fLodMinDensity };
+    uint uiCullEnable = m_bCulling ? 1 : 0;
+    cl_mem kVisibleFlags = rkCompute.getMemObject(m_kVisibleFlags);
+
+    ComputeEngine::KernelHandle kKernel = m_kCullKernel;
+    uint uiArgIndex = 0;
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, aiGridResolution,          sizeof(int) * 2);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_fJitterAmount,          sizeof(float) * 1);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_fCameraFov,             sizeof(float) * 1);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_kCameraPosition,        sizeof(float) * 4);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_kCameraRotation,        sizeof(float) * 4);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_kCameraView,            sizeof(float) * 4);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_kCameraLeft,            sizeof(float) * 4);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_kClipRange,             sizeof(float) * 2);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_kBladeLengthRange,      sizeof(float) * 2);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, afCullParams,              sizeof(float) * 4);
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &uiCullEnable,             sizeof(uint));
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &m_uiBladeCount,           sizeof(uint));
+    rkCompute.updateKernelArg(kKernel, uiArgIndex++, &kVisibleFlags,            sizeof(cl_mem));
+
+    assert(uiArgIndex == rkCompute.getKernelArgCount(kKernel));
+
+    // flag, scan and compact the visible blades, then fetch their count to size the 
+    // per-blade kernel
+    
+    size_t auiGlobalDim[1] = { m_uiScanGroupCount * m_uiScanGroupSize };
+    size_t auiLocalDim[1]  = { m_uiScanGroupSize };
+    
+    ComputeEngine::TaskId auiTasks[5];
+    rkCompute.beginTasks();
+    auiTasks[0] = rkCompute.enqueueKernel(m_kCullKernel, 0, auiGlobalDim, 0, 1);
+    auiTasks[1] = rkCompute.enqueueKernel(m_kScanKernel, 0, auiGlobalDim, auiLocalDim, 1, 1, &auiTasks[0]);
+    auiTasks[2] = rkCompute.enqueueKernel(m_kScanTotalsKernel, 0, auiLocalDim, auiLocalDim, 1, 1, &auiTasks[1]);
+    auiTasks[3] = rkCompute.enqueueKernel(m_kCompactKernel, 0, auiGlobalDim, auiLocalDim, 1, 1, &auiTasks[2]);
+    auiTasks[4] = rkCompute.enqueueReadBuffer(m_kVisibleCount, 0, 0, sizeof(uint), &m_uiVisibleBladeCount, 1, &auiTasks[3]);
+
+    bool bSuccess = rkCompute.finishTasks();
+    for(uint i = 0; i < 5; i++)
+        bSuccess = bSuccess && (auiTasks[i] != ComputeEngine::INVALID_TASK);
+        
+    if(!bSuccess)
+    {
+        printf("Grass Simulator: Failed to cull blades!\n");
+        m_uiVisibleBladeCount = 0;
+        return false;
+    }
+    return true;
+}
+
 void
 GrassSimulator::attachMemory(
     ComputeEngine &rkCompute)
@@ -385,14 +524,19 @@ void
 GrassSimulator::updateOutputs(
     ComputeEngine &rkCompute)
 {
+    // only the visible blades were written, and they're at the front of the buffers
+    uint uiVertexCount = getVisibleVertexCount();
+    if(uiVertexCount == 0)
+        return;
+        
     if(m_afVertexData && m_bCopyVertexData)
     {
-        rkCompute.readBuffer("grass_vertices", 0, 0, m_uiVertexComponents * sizeof(float) * m_uiMaxVertexCount, m_afVertexData);
+        rkCompute.readBuffer(m_kVertices, 0, 0, m_uiVertexComponents * sizeof(float) * uiVertexCount, m_afVertexData);
         
         if(m_uiVertexBufferId)
         {
             glBindBuffer(GL_ARRAY_BUFFER_ARB, m_uiVertexBufferId);
-            glBufferSubData(GL_ARRAY_BUFFER_ARB, 0, m_uiVertexComponents * sizeof(float) * m_uiMaxVertexCount, m_afVertexData);
+            glBufferSubData(GL_ARRAY_BUFFER_ARB, 0, m_uiVertexComponents * sizeof(float) * uiVertexCount, m_afVertexData);
             glVertexPointer(m_uiVertexComponents, GL_FLOAT, 0, 0);
             glBindBuffer(GL_ARRAY_BUFFER_ARB, 0);
         }    
@@ -400,12 +544,12 @@ GrassSimulator::updateOutputs(
     
     if(m_afColorData && m_bCopyColorData)
     {
-        rkCompute.readBuffer("grass_colors", 0, 0, m_uiColorComponents * sizeof(float) * m_uiMaxVertexCount, m_afColorData);
+        rkCompute.readBuffer(m_kColors, 0, 0, m_uiColorComponents * sizeof(float) * uiVertexCount, m_afColorData);
         
         if(m_uiColorBufferId)
         {
             glBindBuffer(GL_ARRAY_BUFFER_ARB, m_uiColorBufferId);
-            glBufferSubData(GL_ARRAY_BUFFER_ARB, 0, m_uiColorComponents * sizeof(float) * m_uiMaxVertexCount, m_afColorData);
+            glBufferSubData(GL_ARRAY_BUFFER_ARB, 0, m_uiColorComponents * sizeof(float) * uiVertexCount, m_afColorData);
             glColorPointer(m_uiColorComponents, GL_FLOAT, 0, 0);
             glBindBuffer(GL_ARRAY_BUFFER_ARB, 0);
         }    
@@ -110,6 +110,18 @@ public:
     void setNoiseAmplitude(float fV)       { m_fNoiseAmplitude = fV; }
     void setBladeLengthRange(float2 fV)    { m_kBladeLengthRange = fV; }    
     void setBladeThicknessRange(float2 fV) { m_kBladeThicknessRange = fV; }
+
+    // blades outside the view cone or cull distance are skipped before the per-blade 
+    // kernel runs, and only visible blades are written out (compacted to the front of 
+    // the vertex buffer).  The margin widens both tests, e.g. to cover instanced copies 
+    // of the field that are drawn at an offset.  Beyond the LOD distance the blade 
+    // density falls off with distance down to the given minimum.
+    void setCulling(bool bV)               { m_bCulling = bV; }
+    void setCullMargin(float fV)           { m_fCullMargin = fV; }
+    void setCullDistance(float fV)         { m_fCullDistance = fV; }
+    void setLodDistance(float fV, float fMinDensity) 
+                                           { m_fLodDistance = fV; 
+                                             m_fLodMinDensity = fMinDensity; }
     
     void setVertexBufferAttachment(uint uiId, bool bCopy) { m_uiVertexBufferId = uiId; m_bCopyVertexData = bCopy; }
     void setColorBufferAttachment(uint uiId, bool bCopy)  { m_uiColorBufferId = uiId; m_bCopyColorData = bCopy; }
@@ -164,6 +176,9 @@ public:
     uint getMaxSegmentCount()              { return m_uiMaxSegmentCount; }
     uint getMaxElementCount()              { return m_uiMaxElementCount; }
     uint getMaxVertexCount()               { return m_uiMaxVertexCount;  }
+    uint getBladeCount()                   { return m_uiBladeCount; }
+    uint getVisibleBladeCount()            { return m_uiVisibleBladeCount; }
+    uint getVisibleVertexCount()           { return m_uiVisibleBladeCount * m_uiMaxElementCount * m_uiMaxSegmentCount; }
     
     uint getRequiredVertexBufferSize(uint uiBladeCount);
     uint getRequiredColorBufferSize(uint uiBladeCount);
@@ -178,9 +193,33 @@ protected:
     void clearMemory(ComputeEngine &rkCompute);
     void updateOutputs(ComputeEngine &rkCompute);
     
+protected:
+
+    bool cullBlades(ComputeEngine &rkCompute);
+
 protected:
 
     bool m_bInitialized;
+    ComputeEngine::KernelHandle m_kKernel;
+    ComputeEngine::KernelHandle m_kCullKernel;
+    ComputeEngine::KernelHandle m_kScanKernel;
+    ComputeEngine::KernelHandle m_kScanTotalsKernel;
+    ComputeEngine::KernelHandle m_kCompactKernel;
+    ComputeEngine::MemObjectHandle m_kVertices;
+    ComputeEngine::MemObjectHandle m_kColors;
+    ComputeEngine::MemObjectHandle m_kVisibleFlags;
+    ComputeEngine::MemObjectHandle m_kVisibleOffsets;
+    ComputeEngine::MemObjectHandle m_kGroupTotals;
+    ComputeEngine::MemObjectHandle m_kVisibleBlades;
+    ComputeEngine::MemObjectHandle m_kVisibleCount;
+    uint m_uiScanGroupSize;
+    uint m_uiScanGroupCount;
+    uint m_uiVisibleBladeCount;
+    bool m_bCulling;
+    float m_fCullMargin;
+    float m_fCullDistance;
+    float m_fLodDistance;
+    float m_fLodMinDensity;
 	uint m_uiKernelArgCount;
 	uint m_auiLocalDim[2];
 	uint m_auiGlobalDim[2];
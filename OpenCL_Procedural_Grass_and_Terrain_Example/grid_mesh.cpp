@@ -48,6 +48,8 @@
 #include "grid_mesh.h"
 #include "compute_math.h"
 #include <assert.h>
+#include <stdio.h>
+#include <algorithm>
 
 #define odd(x) (x%2)
 
@@ -58,7 +60,9 @@ GridMesh::GridMesh() :
     m_uiIndexBufferId(0),
     m_ausIndexData(0),
     m_uiIndexCount(0),
-    m_uiFaceCount(0)
+    m_uiFaceCount(0),
+    m_eIndexOrder(INDEX_ORDER_STRIP),
+    m_uiVisibleMeshletCount(0)
 {
     // EMPTY!
 }
@@ -169,9 +173,7 @@ bool
 GridMesh::createIndexData(
     uint uiCountX, uint uiCountY)
 {
-    if(m_ausIndexData)
-        delete [] m_ausIndexData;
-    m_ausIndexData = 0;
+    destroyIndexData();
 
     m_uiIndexCount =  2 * (uiCountY - 1) * uiCountX;
     m_ausIndexData = new unsigned short[m_uiIndexCount];
@@ -202,6 +204,308 @@ GridMesh::createIndexData(
         }
     }
     m_uiFaceCount = i-2;
+    m_eIndexOrder = INDEX_ORDER_STRIP;
+    return true;
+}
+
+bool
+GridMesh::createIndexData(
+    uint uiCountX, uint uiCountY, IndexOrder eOrder, uint uiCacheSize)
+{
+    if(eOrder == INDEX_ORDER_STRIP)
+        return createIndexData(uiCountX, uiCountY);
+
+    if(uiCountX < 2 || uiCountY < 2 || uiCountX * uiCountY > 65536)
+    {
+        printf("GridMesh: Unable to index a %d x %d grid with 16-bit indices!\n", uiCountX, uiCountY);
+        return false;
+    }
+    
+    if(uiCacheSize < 4)
+        uiCacheSize = 4;
+
+    std::vector<uint> kTriangles;
+    kTriangles.reserve(6 * (uiCountX - 1) * (uiCountY - 1));
+
+    switch(eOrder)
+    {
+        case INDEX_ORDER_ROWS:
+            createRowTriangles(uiCountX, uiCountY, kTriangles);
+            break;
+        case INDEX_ORDER_MORTON_TILES:
+        {
+            // a tile row has to survive in the cache while the next row is
+            // emitted, so the tile is as wide as the cache leaves room for
+            //
+            uint uiTileSize = uiCacheSize / 2 - 1;
+            createMortonTileTriangles(uiCountX, uiCountY, uiTileSize, kTriangles);
+            break;
+        }
+        default:
+            return false;
+    };
+
+    destroyIndexData();
+
+    m_uiIndexCount = (uint)kTriangles.size();
+    m_ausIndexData = new unsigned short[m_uiIndexCount];
+    if(!m_ausIndexData)
+    {
+        m_uiIndexCount = 0;
+        return false;    
+    }
+
+    for(uint i = 0; i < m_uiIndexCount; i++)
+        m_ausIndexData[i] = (unsigned short)kTriangles[i];
+
+    m_uiFaceCount = m_uiIndexCount / 3;
+    m_eIndexOrder = eOrder;
+    return true;
+}
+
+void
+GridMesh::createRowTriangles(
+    uint uiCountX, uint uiCountY, std::vector<uint>& rkTriangles)
+{
+    for(uint y = 0; y < uiCountY - 1; y++)
+    {
+        for(uint x = 0; x < uiCountX - 1; x++)
+        {
+            uint uiV00 = uiCountX * y + x;
+            uint uiV01 = uiCountX * (y+1) + x;
+
+            // same winding as the even rows of the strip
+            //
+            rkTriangles.push_back(uiV00);
+            rkTriangles.push_back(uiV01);
+            rkTriangles.push_back(uiV00 + 1);
+
+            rkTriangles.push_back(uiV00 + 1);
+            rkTriangles.push_back(uiV01);
+            rkTriangles.push_back(uiV01 + 1);
+        }
+    }
+}
+
+void
+GridMesh::createMortonTileTriangles(
+    uint uiCountX, uint uiCountY, uint uiTileSize, std::vector<uint>& rkTriangles)
+{
+    if(uiTileSize < 1)
+        uiTileSize = 1;
+
+    uint uiQuadsX = uiCountX - 1;
+    uint uiQuadsY = uiCountY - 1;
+    uint uiTilesX = divide_up(uiQuadsX, uiTileSize);
+    uint uiTilesY = divide_up(uiQuadsY, uiTileSize);
+
+    // visit the tiles along a z-curve so neighbouring tiles stay close
+    // together in the index stream as well
+    //
+    std::vector< std::pair<int, uint> > kTiles;
+    kTiles.reserve(uiTilesX * uiTilesY);
+    for(uint ty = 0; ty < uiTilesY; ty++)
+        for(uint tx = 0; tx < uiTilesX; tx++)
+            kTiles.push_back(std::make_pair(morton_index2d(ty, tx), ty * uiTilesX + tx));
+    std::sort(kTiles.begin(), kTiles.end());
+
+    for(uint t = 0; t < kTiles.size(); t++)
+    {
+        uint uiX0 = (kTiles[t].second % uiTilesX) * uiTileSize;
+        uint uiY0 = (kTiles[t].second / uiTilesX) * uiTileSize;
+        uint uiX1 = min(uiX0 + uiTileSize, uiQuadsX);
+        uint uiY1 = min(uiY0 + uiTileSize, uiQuadsY);
+
+        for(uint y = uiY0; y < uiY1; y++)
+        {
+            for(uint x = uiX0; x < uiX1; x++)
+            {
+                uint uiV00 = uiCountX * y + x;
+                uint uiV01 = uiCountX * (y+1) + x;
+
+                rkTriangles.push_back(uiV00);
+                rkTriangles.push_back(uiV01);
+                rkTriangles.push_back(uiV00 + 1);
+
+                rkTriangles.push_back(uiV00 + 1);
+                rkTriangles.push_back(uiV01);
+                rkTriangles.push_back(uiV01 + 1);
+            }
+        }
+    }
+}
+
+bool
+GridMesh::createMeshlets(
+    uint uiMaxVertices, uint uiMaxTriangles)
+{
+    m_akMeshlets.clear();
+    m_abMeshletVisible.clear();
+    m_uiVisibleMeshletCount = 0;
+
+    if(m_eIndexOrder == INDEX_ORDER_STRIP || !m_ausIndexData || !m_afVertexData)
+    {
+        printf("GridMesh: Meshlets require triangle list index data!\n");
+        return false;
+    }
+    
+    if(uiMaxVertices < 3 || uiMaxTriangles < 1)
+        return false;
+
+    // split the index stream greedily, so each meshlet is a contiguous range
+    // that can be drawn with a single call
+    //
+    std::vector<uint> kStamp(m_uiVertexCount, 0);
+    uint uiStamp = 1;
+
+    Meshlet kMeshlet;
+    kMeshlet.uiFirstIndex = 0;
+    kMeshlet.uiIndexCount = 0;
+    kMeshlet.uiVertexCount = 0;
+
+    for(uint i = 0; i <= m_uiIndexCount; i += 3)
+    {
+        uint uiNewVertices = 0;
+        if(i < m_uiIndexCount)
+        {
+            for(uint c = 0; c < 3; c++)
+                uiNewVertices += (kStamp[m_ausIndexData[i+c]] != uiStamp) ? 1 : 0;
+        }
+        
+        bool bFull = (kMeshlet.uiVertexCount + uiNewVertices > uiMaxVertices) ||
+                     (kMeshlet.uiIndexCount / 3 >= uiMaxTriangles);
+                     
+        if(kMeshlet.uiIndexCount && (bFull || i == m_uiIndexCount))
+        {
+            float3 kMin(+1e30f, +1e30f, +1e30f);
+            float3 kMax(-1e30f, -1e30f, -1e30f);
+            for(uint j = kMeshlet.uiFirstIndex; j < kMeshlet.uiFirstIndex + kMeshlet.uiIndexCount; j++)
+            {
+                const float* afV = &m_afVertexData[3 * m_ausIndexData[j]];
+                for(uint k = 0; k < 3; k++)
+                {
+                    kMin[k] = min(kMin[k], afV[k]);
+                    kMax[k] = max(kMax[k], afV[k]);
+                }
+            }
+
+            float3 kCenter((kMin.x + kMax.x) * 0.5f, (kMin.y + kMax.y) * 0.5f, (kMin.z + kMax.z) * 0.5f);
+            float fRadiusSq = 0.0f;
+            for(uint j = kMeshlet.uiFirstIndex; j < kMeshlet.uiFirstIndex + kMeshlet.uiIndexCount; j++)
+            {
+                const float* afV = &m_afVertexData[3 * m_ausIndexData[j]];
+                float fDX = afV[0] - kCenter.x;
+                float fDY = afV[1] - kCenter.y;
+                float fDZ = afV[2] - kCenter.z;
+                fRadiusSq = max(fRadiusSq, fDX * fDX + fDY * fDY + fDZ * fDZ);
+            }
+
+            kMeshlet.kMin = kMin;
+            kMeshlet.kMax = kMax;
+            kMeshlet.kSphere = float4(kCenter.x, kCenter.y, kCenter.z, sqrtf(fRadiusSq));
+            m_akMeshlets.push_back(kMeshlet);
+
+            kMeshlet.uiFirstIndex = i;
+            kMeshlet.uiIndexCount = 0;
+            kMeshlet.uiVertexCount = 0;
+            uiStamp++;
+            
+            uiNewVertices = 0;
+            if(i < m_uiIndexCount)
+            {
+                for(uint c = 0; c < 3; c++)
+                    uiNewVertices += (kStamp[m_ausIndexData[i+c]] != uiStamp) ? 1 : 0;
+            }
+        }
+
+        if(i == m_uiIndexCount)
+            break;
+
+        for(uint c = 0; c < 3; c++)
+        {
+            uint v = m_ausIndexData[i+c];
+            if(kStamp[v] != uiStamp)
+            {
+                kStamp[v] = uiStamp;
+                kMeshlet.uiVertexCount++;
+            }
+        }
+        kMeshlet.uiIndexCount += 3;
+    }
+
+    m_abMeshletVisible.assign(m_akMeshlets.size(), 1);
+    m_uiVisibleMeshletCount = (uint)m_akMeshlets.size();
+    return true;
+}
+
+uint
+GridMesh::cullMeshlets(
+    const float4* akPlanes, uint uiPlaneCount)
+{
+    m_uiVisibleMeshletCount = 0;
+    for(uint m = 0; m < m_akMeshlets.size(); m++)
+    {
+        const float4& rkSphere = m_akMeshlets[m].kSphere;
+        
+        bool bVisible = true;
+        for(uint p = 0; p < uiPlaneCount && bVisible; p++)
+        {
+            const float4& rkPlane = akPlanes[p];
+            float fDistance = rkPlane.x * rkSphere.x + rkPlane.y * rkSphere.y + rkPlane.z * rkSphere.z + rkPlane.w;
+            bVisible = (fDistance >= -rkSphere.w);
+        }
+        
+        m_abMeshletVisible[m] = bVisible ? 1 : 0;
+        m_uiVisibleMeshletCount += bVisible ? 1 : 0;
+    }
+    return m_uiVisibleMeshletCount;
+}
+
+bool
+GridMesh::getCacheStatistics(
+    uint uiCacheSize, float* pfACMR, float* pfATVR, bool bLRU)
+{
+    if(!m_ausIndexData || !m_uiFaceCount || !uiCacheSize)
+        return false;
+
+    // replay the index stream through a post-transform cache of the given
+    // size, evicting the oldest (FIFO) or least recently used (LRU) entry
+    //
+    std::vector<unsigned short> kCache;
+    kCache.reserve(uiCacheSize + 1);
+
+    std::vector<unsigned char> kReferenced(m_uiVertexCount, 0);
+    uint uiReferenced = 0;
+    uint uiMisses = 0;
+    
+    for(uint i = 0; i < m_uiIndexCount; i++)
+    {
+        unsigned short usV = m_ausIndexData[i];
+        if(!kReferenced[usV])
+        {
+            kReferenced[usV] = 1;
+            uiReferenced++;
+        }
+        
+        std::vector<unsigned short>::iterator kIter = std::find(kCache.begin(), kCache.end(), usV);
+        if(kIter == kCache.end())
+        {
+            uiMisses++;
+            kCache.insert(kCache.begin(), usV);
+            if(kCache.size() > uiCacheSize)
+                kCache.pop_back();
+        }
+        else if(bLRU)
+        {
+            kCache.erase(kIter);
+            kCache.insert(kCache.begin(), usV);
+        }
+    }
+
+    if(pfACMR)
+        *pfACMR = (float)uiMisses / (float)m_uiFaceCount;
+    if(pfATVR)
+        *pfATVR = (float)uiMisses / (float)uiReferenced;
     return true;
 }
 
@@ -230,13 +534,56 @@ GridMesh::destroyVBO()
 {
     if(m_uiVertexBufferId)
         glDeleteBuffersARB(1, &m_uiVertexBufferId);
+    m_uiVertexBufferId = 0;
     
     if(m_uiIndexBufferId)
         glDeleteBuffersARB(1, &m_uiIndexBufferId);
+    m_uiIndexBufferId = 0;
 }
 
 void 
 GridMesh::render(GLenum eElementType, bool bUseVBO)
+{
+    if(m_eIndexOrder != INDEX_ORDER_STRIP)
+        eElementType = GL_TRIANGLES;
+        
+    drawElements(eElementType, 0, m_uiIndexCount, bUseVBO);
+}
+
+void 
+GridMesh::renderMeshlets(bool bUseVBO)
+{
+    if(m_akMeshlets.empty())
+    {
+        render(GL_TRIANGLES, bUseVBO);
+        return;
+    }
+    
+    // meshlets are consecutive in the index buffer, so runs of visible
+    // meshlets are merged into a single draw
+    //
+    uint m = 0;
+    uint uiMeshletCount = (uint)m_akMeshlets.size();
+    while(m < uiMeshletCount)
+    {
+        if(!m_abMeshletVisible[m])
+        {
+            m++;
+            continue;
+        }
+        
+        uint uiFirstIndex = m_akMeshlets[m].uiFirstIndex;
+        uint uiIndexCount = 0;
+        while(m < uiMeshletCount && m_abMeshletVisible[m])
+            uiIndexCount += m_akMeshlets[m++].uiIndexCount;
+
+        drawElements(GL_TRIANGLES, uiFirstIndex, uiIndexCount, bUseVBO);
+    }
+}
+
+void 
+GridMesh::drawElements(
+    GLenum eElementType, uint uiFirstIndex, uint uiIndexCount, bool bUseVBO)
 {
     if(bUseVBO)
     {
@@ -250,7 +597,7 @@ GridMesh::render(GLenum eElementType, bool bUseVBO)
         glEnableClientState(GL_VERTEX_ARRAY);
 
         glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, m_uiIndexBufferId);
-        glDrawElements(eElementType, m_uiIndexCount, GL_UNSIGNED_SHORT, 0);
+        glDrawElements(eElementType, uiIndexCount, GL_UNSIGNED_SHORT, (const GLvoid*)(uiFirstIndex * sizeof(unsigned short)));
 
         glDisableClientState(GL_VERTEX_ARRAY);
         glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
@@ -260,7 +607,7 @@ GridMesh::render(GLenum eElementType, bool bUseVBO)
     {
         glEnableClientState(GL_VERTEX_ARRAY);
         glVertexPointer(3, GL_FLOAT, 0, m_afVertexData);
-        glDrawElements(eElementType, m_uiIndexCount, GL_UNSIGNED_SHORT, m_ausIndexData);
+        glDrawElements(eElementType, uiIndexCount, GL_UNSIGNED_SHORT, m_ausIndexData + uiFirstIndex);
         glDisableClientState(GL_VERTEX_ARRAY);    
     }
 }
@@ -287,10 +634,27 @@ GridMesh::destroy()
 {
     if(m_afVertexData)
         delete [] m_afVertexData;
+    m_afVertexData = 0;
     m_uiVertexCount = 0;
     
+    destroyIndexData();
+}
+
+void 
+GridMesh::destroyIndexData()
+{
     if(m_ausIndexData)
         delete [] m_ausIndexData;
+    m_ausIndexData = 0;
     m_uiIndexCount = 0;
+    m_uiFaceCount = 0;
+
+    m_akMeshlets.clear();
+    m_abMeshletVisible.clear();
+    m_uiVisibleMeshletCount = 0;
+
+    // the index buffer object has to be rebuilt along with the data
+    //
+    destroyVBO();
 }
 
@@ -48,12 +48,38 @@
 #define __GRID_MESH__
 
 #include "compute_types.h"
+#ifdef __APPLE__
 #include <OpenGL/OpenGL.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
+#include <vector>
 
 ////////////////////////////////////////////////////////////////////////////////
 
 class GridMesh
 {
+public:
+
+    enum IndexOrder
+    {
+        INDEX_ORDER_STRIP,              // serpentine triangle strip, row by row
+        INDEX_ORDER_ROWS,               // triangle list, row by row
+        INDEX_ORDER_MORTON_TILES        // triangle list, cache sized tiles visited in morton order
+    };
+
+    struct Meshlet
+    {
+        uint uiFirstIndex;
+        uint uiIndexCount;
+        uint uiVertexCount;
+        float3 kMin;
+        float3 kMax;
+        float4 kSphere;                 // center in xyz, radius in w
+    };
+
 public:
     GridMesh();
     ~GridMesh();
@@ -68,13 +94,38 @@ public:
                float fRadialAngle, 
                bool bVertical = false);
 
+    // Triangle list orders are always drawn as GL_TRIANGLES.
+    //
     void render(GLenum eElementType = GL_TRIANGLE_STRIP, bool bUseVBO = true);
 
     unsigned int getTriangleCount();
 
     bool createIndexData(uint uiCountX, uint uiCountY);
+    bool createIndexData(uint uiCountX, uint uiCountY, IndexOrder eOrder, uint uiCacheSize = 16);
     
     uint getIndexCount()            { return m_uiIndexCount;}
+    const unsigned short* getIndexData() { return m_ausIndexData; }
+    IndexOrder getIndexOrder()      { return m_eIndexOrder; }
+
+    // Partitions a triangle list order into meshlets of at most the given number
+    // of unique vertices and triangles, each with its own bounding volume.
+    //
+    bool createMeshlets(uint uiMaxVertices = 64, uint uiMaxTriangles = 126);
+    uint getMeshletCount()                      { return (uint)m_akMeshlets.size(); }
+    const Meshlet& getMeshlet(uint uiIndex)     { return m_akMeshlets[uiIndex]; }
+
+    // Marks the meshlets whose bounding sphere lies inside all the given planes
+    // (xyz normal pointing inwards, w distance) and returns how many remain.
+    //
+    uint cullMeshlets(const float4* akPlanes, uint uiPlaneCount);
+    uint getVisibleMeshletCount()               { return m_uiVisibleMeshletCount; }
+    void renderMeshlets(bool bUseVBO = true);
+
+    // Post-transform cache efficiency of the current index order, measured with
+    // a FIFO (or LRU) cache simulator: average cache misses per triangle (ACMR)
+    // and per referenced vertex (ATVR).
+    //
+    bool getCacheStatistics(uint uiCacheSize, float* pfACMR, float* pfATVR, bool bLRU = false);
     
 private:
 
@@ -83,6 +134,11 @@ private:
     
     void addVertex(float x, float y, float z);
     void destroy();
+    void destroyIndexData();
+
+    void createRowTriangles(uint uiCountX, uint uiCountY, std::vector<uint>& rkTriangles);
+    void createMortonTileTriangles(uint uiCountX, uint uiCountY, uint uiTileSize, std::vector<uint>& rkTriangles);
+    void drawElements(GLenum eElementType, uint uiFirstIndex, uint uiIndexCount, bool bUseVBO);
 
     uint m_uiVertexBufferId;
     float* m_afVertexData; 
@@ -93,6 +149,11 @@ private:
     uint m_uiIndexCount;       
     
     uint m_uiFaceCount; 
+    IndexOrder m_eIndexOrder;
+
+    std::vector<Meshlet> m_akMeshlets;
+    std::vector<unsigned char> m_abMeshletVisible;
+    uint m_uiVisibleMeshletCount;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,249 @@
+//
+// File:       grid_mesh_benchmark.cpp
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Vertex cache benchmark for the GridMesh index orders.  For a range of grid sizes, builds
+// the serpentine strip the renderer used so far, a row by row triangle list and morton
+// ordered cache sized tiles, checks that every list covers each quad of the grid exactly
+// once, and replays the index streams through a FIFO and an LRU post-transform cache
+// simulator, printing the average cache miss ratio (misses per triangle, ACMR) and
+// transformed vertex ratio (misses per vertex, ATVR) together with the build time.
+// Forsyth's greedy reordering was tried too, and never beat the morton tiles on these
+// grids.  Then splits the largest grid into meshlets and reports how
+// many survive a frustum cull.  Runs on the CPU only and doesn't need a GL context; it 
+// isn't part of the Grass target, but builds on other platforms, e.g.:
+//
+//   c++ -O3 grid_mesh_benchmark.cpp grid_mesh.cpp compute_math.cpp -lGL
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "grid_mesh.h"
+#include "compute_math.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#ifdef __APPLE__
+#include "timing.h"
+#else
+#include <time.h>
+
+static inline uint64_t
+GetCurrentTime()
+{
+    struct timespec kTime;
+    clock_gettime(CLOCK_MONOTONIC, &kTime);
+    return (uint64_t)kTime.tv_sec * 1000000000ull + kTime.tv_nsec;
+}
+
+static inline double
+SubtractTime( uint64_t uiEndTime, uint64_t uiStartTime )
+{
+    return 1e-9 * (double)(uiEndTime - uiStartTime);
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const uint GridSizes[] = { 16, 32, 64, 128, 256 };
+static const uint GridSizeCount = sizeof(GridSizes) / sizeof(GridSizes[0]);
+
+static const uint CacheSizes[] = { 16, 32 };
+static const uint CacheSizeCount = sizeof(CacheSizes) / sizeof(CacheSizes[0]);
+
+static const GridMesh::IndexOrder Orders[] = 
+{ 
+    GridMesh::INDEX_ORDER_STRIP, 
+    GridMesh::INDEX_ORDER_ROWS, 
+    GridMesh::INDEX_ORDER_MORTON_TILES 
+};
+static const char* OrderNames[] = { "strip", "rows", "morton" };
+static const uint OrderCount = sizeof(Orders) / sizeof(Orders[0]);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline uint64_t
+TriangleKey(uint uiA, uint uiB, uint uiC)
+{
+    return ((uint64_t)uiA << 40) | ((uint64_t)uiB << 20) | (uint64_t)uiC;
+}
+
+static bool
+CheckTriangleList(GridMesh& rkMesh, uint uiCount)
+{
+    // every quad must be covered by exactly one pair of triangles with
+    // the same winding as the row order
+    //
+    std::vector<uint64_t> kReference;
+    std::vector<uint64_t> kTriangles;
+    
+    const unsigned short* ausIndices = rkMesh.getIndexData();
+    for(uint i = 0; i < rkMesh.getIndexCount(); i += 3)
+    {
+        uint uiA = ausIndices[i+0], uiB = ausIndices[i+1], uiC = ausIndices[i+2];
+        
+        // rotate so the smallest index comes first, which keeps the winding
+        //
+        while(uiA > uiB || uiA > uiC)
+        {
+            uint uiT = uiA; uiA = uiB; uiB = uiC; uiC = uiT;
+        }
+        kTriangles.push_back(TriangleKey(uiA, uiB, uiC));
+    }
+
+    for(uint y = 0; y < uiCount - 1; y++)
+    {
+        for(uint x = 0; x < uiCount - 1; x++)
+        {
+            uint uiV00 = uiCount * y + x;
+            uint uiV01 = uiCount * (y+1) + x;
+            kReference.push_back(TriangleKey(uiV00, uiV01, uiV00 + 1));
+            kReference.push_back(TriangleKey(uiV00 + 1, uiV01, uiV01 + 1));
+        }
+    }
+    
+    std::sort(kTriangles.begin(), kTriangles.end());
+    std::sort(kReference.begin(), kReference.end());
+    return kTriangles == kReference;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+    bool bPassed = true;
+    
+    printf("%8s %8s %6s | %8s %8s | %8s %8s | %10s\n", 
+        "Grid", "Order", "Cache", "ACMR", "ATVR", "LRU ACMR", "LRU ATVR", "Build (ms)");
+
+    for(uint g = 0; g < GridSizeCount; g++)
+    {
+        uint uiCount = GridSizes[g];
+
+        GridMesh kMesh;
+        if(!kMesh.setup(uiCount, uiCount, -1.0f, 1.0f, -1.0f, 1.0f))
+        {
+            printf("Failed to setup a %d x %d grid!\n", uiCount, uiCount);
+            return 1;
+        }
+
+        for(uint c = 0; c < CacheSizeCount; c++)
+        {
+            for(uint o = 0; o < OrderCount; o++)
+            {
+                uint64_t uiStartTime = GetCurrentTime();
+                bool bBuilt = kMesh.createIndexData(uiCount, uiCount, Orders[o], CacheSizes[c]);
+                double dBuildTime = SubtractTime(GetCurrentTime(), uiStartTime);
+                if(!bBuilt)
+                {
+                    printf("Failed to create %s index data!\n", OrderNames[o]);
+                    return 1;
+                }
+                
+                if(Orders[o] != GridMesh::INDEX_ORDER_STRIP && !CheckTriangleList(kMesh, uiCount))
+                {
+                    printf("%s triangle list for a %d x %d grid is incorrect!\n", OrderNames[o], uiCount, uiCount);
+                    bPassed = false;
+                }
+
+                float fACMR = 0.0f, fATVR = 0.0f;
+                float fLruACMR = 0.0f, fLruATVR = 0.0f;
+                kMesh.getCacheStatistics(CacheSizes[c], &fACMR, &fATVR);
+                kMesh.getCacheStatistics(CacheSizes[c], &fLruACMR, &fLruATVR, true);
+
+                printf("%4d^2   %8s %6d | %8.3f %8.3f | %8.3f %8.3f | %10.3f\n",
+                    uiCount, OrderNames[o], CacheSizes[c], 
+                    fACMR, fATVR, fLruACMR, fLruATVR, dBuildTime * 1000.0);
+            }
+        }
+        printf("\n");
+    }
+
+    // split the largest grid into meshlets and cull it against a narrow view 
+    // looking down the z axis from the middle of the grid
+    //
+    uint uiCount = GridSizes[GridSizeCount - 1];
+    GridMesh kMesh;
+    kMesh.setup(uiCount, uiCount, -1.0f, 1.0f, -1.0f, 1.0f);
+    kMesh.createIndexData(uiCount, uiCount, GridMesh::INDEX_ORDER_MORTON_TILES, 32);
+    kMesh.createMeshlets(64, 126);
+
+    uint uiTriangles = 0;
+    uint uiVertices = 0;
+    for(uint m = 0; m < kMesh.getMeshletCount(); m++)
+    {
+        uiTriangles += kMesh.getMeshlet(m).uiIndexCount / 3;
+        uiVertices += kMesh.getMeshlet(m).uiVertexCount;
+    }
+    if(uiTriangles != kMesh.getTriangleCount())
+    {
+        printf("Meshlets cover %d of %d triangles!\n", uiTriangles, kMesh.getTriangleCount());
+        bPassed = false;
+    }
+
+    float fS = sqrtf(0.5f);
+    float4 akPlanes[3];
+    akPlanes[0] = float4( fS, 0.0f, fS, 0.0f);
+    akPlanes[1] = float4(-fS, 0.0f, fS, 0.0f);
+    akPlanes[2] = float4(0.0f, 0.0f, -1.0f, 0.5f);
+    
+    uint64_t uiStartTime = GetCurrentTime();
+    uint uiVisible = kMesh.cullMeshlets(akPlanes, 3);
+    double dCullTime = SubtractTime(GetCurrentTime(), uiStartTime);
+
+    printf("Meshlets: %d (%.1f triangles, %.1f vertices on average), %d visible after culling in %.3f ms\n",
+        kMesh.getMeshletCount(), 
+        (float)uiTriangles / (float)kMesh.getMeshletCount(),
+        (float)uiVertices / (float)kMesh.getMeshletCount(),
+        uiVisible, dCullTime * 1000.0);
+
+    printf("%s\n", bPassed ? "Passed" : "Failed");
+    return bPassed ? 0 : 1;
+}
+
@@ -236,10 +236,11 @@ ReportStats(
         double dMilliseconds = TimeElapsed * 1000.0 / (double) FrameCount;
         float fFps = 1.0f / (dMilliseconds / 1000.0f);
         uint uiMaxVertexCount = GrassSimulator.getMaxVertexCount() * FieldInstances;
-        sprintf(StatsString, "[%s] Vertices: %3.2f M  Blades: %d  Compute: %3.2f ms  Display: %3.2f fps (%s)\n", 
+        sprintf(StatsString, "[%s] Vertices: %3.2f M  Blades: %d (%d visible)  Compute: %3.2f ms  Display: %3.2f fps (%s)\n", 
                 (UseGPU) ? "GPU" : "CPU",
                 uiMaxVertexCount / 1000.0f / 1000.0f, 
                 BladeCount * FieldInstances * FieldPages,                 
+                GrassSimulator.getVisibleBladeCount() * FieldInstances * FieldPages,
                 (float)dMilliseconds,
                 fFps,
                 USE_GL_ATTACHMENT ? ("attached") : ("copying") );
@@ -339,6 +340,10 @@ Solve( bool bUseBlades )
         }
         GrassSimulator.setBladeThicknessRange(BladeThicknessRange);
     }
+
+    // culled blades aren't written, so only draw the visible ones
+    GrassRenderer.setVertexBuffer(GrassVertexBufferId, GrassSimulator.getVertexComponentCount(), GrassSimulator.getVisibleVertexCount());
+    GrassRenderer.setColorBuffer(GrassColorBufferId, GrassSimulator.getColorComponentCount(), GrassSimulator.getVisibleVertexCount());
 }
 
 void RenderTerrain( void )
@@ -956,6 +961,7 @@ void Initialize( void )
     GrassSimulator.setFlowSpeed(FlowSpeed);
     GrassSimulator.setFlowAmount(FlowAmount);
     GrassSimulator.setJitterAmount(JitterAmount);
+    GrassSimulator.setCullMargin(20.0f * sqrtf(2.0f));     // instances are drawn up to 20 units away in x and z
     
     GrassRenderer.setVertexBuffer(GrassVertexBufferId, GrassSimulator.getVertexComponentCount(), GrassSimulator.getMaxVertexCount());
     GrassRenderer.setColorBuffer(GrassColorBufferId, GrassSimulator.getColorComponentCount(), GrassSimulator.getMaxVertexCount());
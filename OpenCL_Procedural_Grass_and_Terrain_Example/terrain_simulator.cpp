@@ -247,6 +247,10 @@ TerrainSimulator::reset(
         return false;
     }
 
+    m_kVertices = rkCompute.getMemObjectHandle("terrain_vertices");
+    m_kNormals = rkCompute.getMemObjectHandle("terrain_normals");
+    m_kTexCoords = rkCompute.getMemObjectHandle("terrain_texcoords");
+
     m_bInitialized = true;
     return true;
 }
@@ -273,6 +277,7 @@ TerrainSimulator::setup(
         printf("Terrain Simulator: Failed to create device kernel!\n");
         return false;
     }
+    m_kKernel = rkCompute.getKernelHandle("ComputeTerrainKernel");
     
     return reset(rkCompute);
 }
@@ -297,8 +302,8 @@ TerrainSimulator::compute(
      if(rkCompute.isConnected() == false || !m_bInitialized)
         return false;
     
-    const char *acKernelName = "ComputeTerrainKernel";
-    uint uiWorkItems = rkCompute.getEstimatedWorkGroupSize(acKernelName);
+    ComputeEngine::KernelHandle kKernel = m_kKernel;
+    uint uiWorkItems = rkCompute.getEstimatedWorkGroupSize(kKernel);
     
     uiWorkItems = round(m_uiSizeX * m_uiSizeY * uiWorkItems) / uiWorkItems;
     uiWorkItems = 1;
@@ -316,36 +321,39 @@ TerrainSimulator::compute(
     float fOctaves = 1.0f;
     float fRoughness = 1.00f;
 */    
-    cl_mem kVertices = rkCompute.getMemObject("terrain_vertices");
-    cl_mem kNormals = rkCompute.getMemObject("terrain_normals");
-    cl_mem kTexCoords = rkCompute.getMemObject("terrain_texcoords");
+    cl_mem kVertices = rkCompute.getMemObject(m_kVertices);
+    cl_mem kNormals = rkCompute.getMemObject(m_kNormals);
+    cl_mem kTexCoords = rkCompute.getMemObject(m_kTexCoords);
     
     attachMemory(rkCompute);
 
     uint uiArgIndex = 0;
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, aiGridResolution,    sizeof(int) * 2);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_kCameraPosition,  sizeof(float) * 4);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_kCameraRotation,  sizeof(float) * 4);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_kCameraView,      sizeof(float) * 4);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_kCameraLeft,      sizeof(float) * 4);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_fCameraFov,       sizeof(float) * 1);
-//    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &fFrequency,         sizeof(float) * 1);
-//    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &fAmplitude,         sizeof(float) * 1);
-//    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &fPhase,             sizeof(float) * 1);
-//    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &fLacunarity,        sizeof(float) * 1);
-//    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &fIncrement,         sizeof(float) * 1);
-//    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &fOctaves,           sizeof(float) * 1);
-//    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &fRoughness,         sizeof(float) * 1);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &m_uiVertexCount,    sizeof(uint)  * 1);
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &kVertices,          sizeof(cl_mem));
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &kNormals,           sizeof(cl_mem));
-    rkCompute.setKernelArg(acKernelName, uiArgIndex++, &kTexCoords,         sizeof(cl_mem));
-
-    assert(uiArgIndex == rkCompute.getKernelArgCount(acKernelName));
-
-    bool bSuccess = rkCompute.executeKernel(acKernelName, 0, auiGlobalDim, auiLocalDim, 1);
-
-    updateOutputs(rkCompute);
+    rkCompute.setKernelArg(kKernel, uiArgIndex++, aiGridResolution,    sizeof(int) * 2);
+    rkCompute.setKernelArg(kKernel, uiArgIndex++, &m_kCameraPosition,  sizeof(float) * 4);
+    rkCompute.setKernelArg(kKernel, uiArgIndex++, &m_kCameraRotation,  sizeof(float) * 4);
+    rkCompute.setKernelArg(kKernel, uiArgIndex++, &m_kCameraView,      sizeof(float) * 4);
+    rkCompute.setKernelArg(kKernel, uiArgIndex++, &m_kCameraLeft,      sizeof(float) * 4);
+    rkCompute.setKernelArg(kKernel, uiArgIndex++, &m_fCameraFov,       sizeof(float) * 1);
+//    rkCompute.setKernelArg(kKernel, uiArgIndex++, &fFrequency,         sizeof(float) * 1);
+//    rkCompute.setKernelArg(kKernel, uiArgIndex++, &fAmplitude,         sizeof(float) * 1);
+//    rkCompute.setKernelArg(kKernel, uiArgIndex++, &fPhase,             sizeof(float) * 1);
+//    rkCompute.setKernelArg(kKernel, uiArgIndex++, &fLacunarity,        sizeof(float) * 1);
+//    rkCompute.setKernelArg(kKernel, uiArgIndex++, &fIncrement,         sizeof(float) * 1);
+//    rkCompute.setKernelArg(kKernel, uiArgIndex++, &fOctaves,           sizeof(float) * 1);
+//    rkCompute.setKernelArg(kKernel, uiArgIndex++, &fRoughness,         sizeof(float) * 1);
+    rkCompute.setKernelArg(kKernel, uiArgIndex++, &m_uiVertexCount,    sizeof(uint)  * 1);
+    rkCompute.setKernelArg(kKernel, uiArgIndex++, &kVertices,          sizeof(cl_mem));
+    rkCompute.setKernelArg(kKernel, uiArgIndex++, &kNormals,           sizeof(cl_mem));
+    rkCompute.setKernelArg(kKernel, uiArgIndex++, &kTexCoords,         sizeof(cl_mem));
+
+    assert(uiArgIndex == rkCompute.getKernelArgCount(kKernel));
+
+    // the copies back to the host wait on the kernel's event rather than the whole queue
+    rkCompute.beginTasks();
+    ComputeEngine::TaskId uiKernelTask = rkCompute.enqueueKernel(kKernel, 0, auiGlobalDim, auiLocalDim, 1);
+    bool bSuccess = (uiKernelTask != ComputeEngine::INVALID_TASK);
+
+    updateOutputs(rkCompute, uiKernelTask);
     detachMemory(rkCompute);
     
     if(!bSuccess)
@@ -387,12 +395,26 @@ TerrainSimulator::detachMemory(
 
 void
 TerrainSimulator::updateOutputs(
-    ComputeEngine &rkCompute)
+    ComputeEngine &rkCompute,
+    ComputeEngine::TaskId uiKernelTask)
 {
-    if(m_afVertexData && m_bCopyVertexData)
+    bool bCopyVertices = m_afVertexData && m_bCopyVertexData;
+    bool bCopyNormals = m_afNormalData && m_bCopyNormalData;
+    bool bCopyTexCoords = m_afTexCoordData && m_bCopyTexCoordData;
+    if(!bCopyVertices && !bCopyNormals && !bCopyTexCoords)
+        return;
+
+    // all three reads are in flight together on the transfer queue
+    if(bCopyVertices)
+        rkCompute.enqueueReadBuffer(m_kVertices, 0, 0, m_uiVertexComponents * sizeof(float) * m_uiVertexCount, m_afVertexData, 1, &uiKernelTask);
+    if(bCopyNormals)
+        rkCompute.enqueueReadBuffer(m_kNormals, 0, 0, m_uiNormalComponents * sizeof(float) * m_uiNormalCount, m_afNormalData, 1, &uiKernelTask);
+    if(bCopyTexCoords)
+        rkCompute.enqueueReadBuffer(m_kTexCoords, 0, 0, m_uiTexCoordComponents * sizeof(float) * m_uiTexCoordCount, m_afTexCoordData, 1, &uiKernelTask);
+    rkCompute.finishTasks();
+
+    if(bCopyVertices)
     {
-        rkCompute.readBuffer("terrain_vertices", 0, 0, m_uiVertexComponents * sizeof(float) * m_uiVertexCount, m_afVertexData);
-        
         if(m_uiVertexBufferId)
         {
             glBindBuffer(GL_ARRAY_BUFFER_ARB, m_uiVertexBufferId);
@@ -402,10 +424,8 @@ TerrainSimulator::updateOutputs(
         }    
     }
     
-    if(m_afNormalData && m_bCopyNormalData)
+    if(bCopyNormals)
     {
-        rkCompute.readBuffer("terrain_normals", 0, 0, m_uiNormalComponents * sizeof(float) * m_uiNormalCount, m_afNormalData);
-
         if(m_uiNormalBufferId)
         {
             glBindBuffer(GL_ARRAY_BUFFER_ARB, m_uiNormalBufferId);
@@ -415,10 +435,8 @@ TerrainSimulator::updateOutputs(
         }    
     }
     
-    if(m_afTexCoordData && m_bCopyTexCoordData)
+    if(bCopyTexCoords)
     {
-        rkCompute.readBuffer("terrain_texcoords", 0, 0, m_uiTexCoordComponents * sizeof(float) * m_uiTexCoordCount, m_afTexCoordData);
-
         if(m_uiTexCoordBufferId)
         {
             glBindBuffer(GL_ARRAY_BUFFER_ARB, m_uiTexCoordBufferId);
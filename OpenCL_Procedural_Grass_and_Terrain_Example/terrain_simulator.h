@@ -142,11 +142,15 @@ protected:
     void attachMemory(ComputeEngine &rkCompute);
     void detachMemory(ComputeEngine &rkCompute);
     void clearMemory(ComputeEngine &rkCompute);
-    void updateOutputs(ComputeEngine &rkCompute);
+    void updateOutputs(ComputeEngine &rkCompute, ComputeEngine::TaskId uiKernelTask);
     
 protected:
 
     bool m_bInitialized;
+    ComputeEngine::KernelHandle m_kKernel;
+    ComputeEngine::MemObjectHandle m_kVertices;
+    ComputeEngine::MemObjectHandle m_kNormals;
+    ComputeEngine::MemObjectHandle m_kTexCoords;
 	uint m_uiKernelArgCount;
 	uint m_auiLocalDim[2];
 	uint m_auiGlobalDim[2];
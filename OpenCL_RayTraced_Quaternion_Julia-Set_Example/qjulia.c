@@ -72,6 +72,8 @@
 
 #include <mach/mach_time.h>
 
+#include "qjulia_cpu.h"
+
 ////////////////////////////////////////////////////////////////////////////////
 
 #define USE_GL_ATTACHMENTS              (1)  // enable OpenGL attachments for Compute results
@@ -98,6 +100,13 @@ static int                              WorkGroupItems = 32;
 
 ////////////////////////////////////////////////////////////////////////////////
 
+static int UseHost                      = 0;
+static qjulia_cpu_progressive* HostRenderer = 0;
+static int HostBlockSize                = 1;
+static double HostFrameBudget           = 1.0 / 30.0;
+
+////////////////////////////////////////////////////////////////////////////////
+
 static int Width                        = WIDTH;
 static int Height                       = HEIGHT;
 
@@ -419,9 +428,42 @@ UpdateColor( float t[4], float a[4], float b[4] )
     }
 }
 
+static int
+RecomputeOnHost(void)
+{
+    if(!HostRenderer || !HostImageBuffer)
+        return CL_SUCCESS;
+
+    if(Animated || Update)
+    {
+        qjulia_cpu_scene scene;
+
+        Update = 0;
+        memcpy(scene.mu, MuC, sizeof(scene.mu));
+        memcpy(scene.diffuse, ColorC, sizeof(scene.diffuse));
+        scene.epsilon = Epsilon;
+        scene.shadows = 0;
+        qjulia_cpu_progressive_restart(HostRenderer, &scene);
+    }
+
+    // Render as much as fits in the frame budget; a new view starts at a
+    // coarser resolution and is refined over the following frames.
+    HostBlockSize = qjulia_cpu_progressive_render(HostRenderer, HostImageBuffer, HostFrameBudget);
+    if(HostBlockSize < 0)
+    {
+        printf("Failed to render on the host!\n");
+        return -1;
+    }
+
+    return CL_SUCCESS;
+}
+
 static int
 Recompute(void)
 {
+    if(UseHost)
+        return RecomputeOnHost();
+
     if(!ComputeKernel || !ComputeResult)
         return CL_SUCCESS;
         
@@ -569,6 +611,34 @@ CreateComputeResult(void)
     return CL_SUCCESS;
 }
 
+static int 
+SetupHostRenderer(void)
+{
+    if(HostImageBuffer)
+        free(HostImageBuffer);
+
+    printf(SEPARATOR);
+    printf("Rendering on the host...\n");
+    HostImageBuffer = calloc(TextureWidth * TextureHeight * TextureTypeSize * 4, 1);
+    if(!HostImageBuffer)
+    {
+        printf("Failed to create host image buffer!\n");
+        return -1;
+    }
+
+    if(HostRenderer)
+        qjulia_cpu_progressive_destroy(HostRenderer);
+    HostRenderer = qjulia_cpu_progressive_create(TextureWidth, TextureHeight, 0, 0);
+    if(!HostRenderer)
+    {
+        printf("Failed to create host renderer!\n");
+        return -1;
+    }
+
+    Update = 1;
+    return CL_SUCCESS;
+}
+
 static int 
 SetupComputeDevices(int gpu)
 {
@@ -773,6 +843,15 @@ SetupComputeKernel(void)
 static void
 Cleanup(void)
 {
+    if(UseHost)
+    {
+        qjulia_cpu_progressive_destroy(HostRenderer);
+        free(HostImageBuffer);
+        HostRenderer = 0;
+        HostImageBuffer = 0;
+        return;
+    }
+
     clFinish(ComputeCommands);
     clReleaseKernel(ComputeKernel);
     clReleaseProgram(ComputeProgram);
@@ -843,11 +922,29 @@ Initialize(int gpu)
         exit (err);
     }
 
-    err = SetupComputeDevices(gpu);
-    if(err != CL_SUCCESS)
+    if(!UseHost)
     {
-        printf ("Failed to connect to compute device! Error %d\n", err);
-        exit (err);
+        err = SetupComputeDevices(gpu);
+        if(err != CL_SUCCESS)
+        {
+            printf ("Warning: Failed to connect to compute device!  Rendering on the host instead.\n");
+            UseHost = 1;
+        }
+    }
+
+    if(UseHost)
+    {
+        err = SetupHostRenderer();
+        if(err != CL_SUCCESS)
+        {
+            printf ("Failed to setup host renderer! Error %d\n", err);
+            exit (err);
+        }
+
+        RandomColor(ColorA);
+        RandomColor(ColorB);
+        RandomColor(ColorC);
+        return CL_SUCCESS;
     }
 
     cl_bool image_support;
@@ -921,9 +1018,13 @@ ReportStats(
         double fMs = (TimeElapsed * 1000.0 / (double) FrameCount);
         double fFps = 1.0 / (fMs / 1000.0);
         
-        sprintf(StatsString, "[%s] Compute: %3.2f ms  Display: %3.2f fps (%s)\n", 
-                (ComputeDeviceType == CL_DEVICE_TYPE_GPU) ? "GPU" : "CPU", 
-                fMs, fFps, USE_GL_ATTACHMENTS ? "attached" : "copying");
+        if(UseHost)
+            sprintf(StatsString, "[HOST] Compute: %3.2f ms  Display: %3.2f fps (%dx%d blocks)\n", 
+                    fMs, fFps, HostBlockSize, HostBlockSize);
+        else
+            sprintf(StatsString, "[%s] Compute: %3.2f ms  Display: %3.2f fps (%s)\n", 
+                    (ComputeDeviceType == CL_DEVICE_TYPE_GPU) ? "GPU" : "CPU", 
+                    fMs, fFps, USE_GL_ATTACHMENTS ? "attached" : "copying");
 		
 		glutSetWindowTitle(StatsString);
 
@@ -1088,7 +1189,10 @@ int main(int argc, char** argv)
         if(!argv[i])
             continue;
             
-        if(strstr(argv[i], "cpu"))
+        if(i > 0 && strstr(argv[i], "host"))
+            UseHost = 1;
+
+        else if(strstr(argv[i], "cpu"))
             use_gpu = 0;        
 
         else if(strstr(argv[i], "gpu"))
@@ -0,0 +1,1097 @@
+//
+// File:       qjulia_cpu.c
+//
+// Abstract:   A multi-threaded CPU ray marcher for the quaternion Julia set which traces packets
+//             of rays with SSE or NEON.  See qjulia_cpu.h.
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "qjulia_cpu.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+// The constants of qjulia_kernel.cl.
+#define SQR(x)                  ((x)*(x))
+#define BOUNDING_RADIUS         (2.0f)
+#define BOUNDING_RADIUS_SQR     (SQR(BOUNDING_RADIUS))
+#define ESCAPE_THRESHOLD        (BOUNDING_RADIUS * 1.5f)
+#define DELTA                   (1e-5f)
+#define ITERATIONS              (10)
+#define SPECULAR_EXPONENT       (10)
+#define SPECULARITY             (0.45f)
+#define BACKGROUND              (0.15f)
+#define SHADOW                  (0.4f)
+
+static const float Eye[3]       = { 0.0f, 0.0f, 4.0f };
+static const float Light[3]     = { 1.5f, 0.5f, 4.0f };
+
+// Tiles handed to threads, in pixels.  A multiple of the largest block size,
+// so that every tile starts on the grid of every pass.
+#define TILE_SIZE               (64)
+#define MAX_BLOCK_SIZE          (16)
+
+#define MAX_PACKET              (16)
+#define MAX_THREADS             (64)
+
+#define ALWAYS_INLINE           static inline __attribute__((always_inline))
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Everything a thread needs to trace rays for one image.
+typedef struct
+{
+    int width;
+    int height;
+    float scale;
+    float mu[4];
+    float diffuse[3];
+    float epsilon;
+    int shadows;
+} frame;
+
+static void
+setup_frame(frame *f, int width, int height, const qjulia_cpu_scene *scene)
+{
+    f->width = width;
+    f->height = height;
+    f->scale = (float) (width > height ? width : height);
+    memcpy(f->mu, scene->mu, sizeof(f->mu));
+    memcpy(f->diffuse, scene->diffuse, sizeof(f->diffuse));
+    f->epsilon = scene->epsilon;
+    f->shadows = scene->shadows;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Single rays, using the standard C math library.  This follows the kernel
+// line for line and is the reference for the packet tracer below.
+
+static float dot3(const float a[3], const float b[3]) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+static float dot4(const float a[4], const float b[4]) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3]; }
+
+static void
+normalize3(float a[3])
+{
+    float s = 1.0f / sqrtf(dot3(a, a));
+    a[0] *= s;
+    a[1] *= s;
+    a[2] *= s;
+}
+
+static void
+qmult(float r[4], const float q1[4], const float q2[4])
+{
+    float t[4];
+    t[0] = q1[0] * q2[0] - (q1[1] * q2[1] + q1[2] * q2[2] + q1[3] * q2[3]);
+    t[1] = q2[1] * q1[0] + q1[1] * q2[0] + (q1[2] * q2[3] - q1[3] * q2[2]);
+    t[2] = q2[2] * q1[0] + q1[2] * q2[0] + (q1[3] * q2[1] - q1[1] * q2[3]);
+    t[3] = q2[3] * q1[0] + q1[3] * q2[0] + (q1[1] * q2[2] - q1[2] * q2[1]);
+    memcpy(r, t, sizeof(t));
+}
+
+static void
+qsqr_add(float q[4], const float c[4])
+{
+    float x2 = 2.0f * q[0];
+    q[0] = q[0] * q[0] - (q[1] * q[1] + q[2] * q[2] + q[3] * q[3]) + c[0];
+    q[1] = x2 * q[1] + c[1];
+    q[2] = x2 * q[2] + c[2];
+    q[3] = x2 * q[3] + c[3];
+}
+
+static float
+escape_length(float q[4], const float c[4])
+{
+    int i;
+    for (i = 0; i < ITERATIONS; i++)
+        qsqr_add(q, c);
+    return sqrtf(dot4(q, q));
+}
+
+static void
+estimate_normal(float n[3], const float p[3], const float c[4])
+{
+    int axis;
+    for (axis = 0; axis < 3; axis++)
+    {
+        float g1[4] = { p[0], p[1], p[2], 0.0f };
+        float g2[4] = { p[0], p[1], p[2], 0.0f };
+        g1[axis] -= DELTA;
+        g2[axis] += DELTA;
+        n[axis] = escape_length(g2, c) - escape_length(g1, c);
+    }
+    normalize3(n);
+}
+
+// March from p along d until the distance estimate drops below epsilon or
+// the ray leaves the escape radius; p is left at the last point reached.
+static float
+intersect(float p[3], const float d[3], const float c[4], float epsilon)
+{
+    float dist = epsilon, rd = 0.0f;
+
+    while (dist >= epsilon && rd < ESCAPE_THRESHOLD)
+    {
+        float z[4] = { p[0], p[1], p[2], 0.0f };
+        float zp[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+        float zd = 0.0f, norm_z;
+        int count = 0;
+
+        while (zd < ESCAPE_THRESHOLD && count < ITERATIONS)
+        {
+            qmult(zp, z, zp);
+            zp[0] *= 2.0f;
+            zp[1] *= 2.0f;
+            zp[2] *= 2.0f;
+            zp[3] *= 2.0f;
+            qsqr_add(z, c);
+            zd = dot4(z, z);
+            count++;
+        }
+
+        norm_z = sqrtf(dot4(z, z));
+        dist = 0.5f * norm_z * logf(norm_z) / sqrtf(dot4(zp, zp));
+        p[0] += d[0] * dist;
+        p[1] += d[1] * dist;
+        p[2] += d[2] * dist;
+        rd = dot3(p, p);
+    }
+    return dist;
+}
+
+static unsigned char
+to_byte(float v)
+{
+    v *= 255.0f;
+    if (!(v > 0.0f))
+        return 0;
+    if (v >= 255.0f)
+        return 255;
+    return (unsigned char) lrintf(v);
+}
+
+static uint32_t
+pack_pixel(const float color[4])
+{
+    unsigned char rgba[4] = { to_byte(color[0]), to_byte(color[1]), to_byte(color[2]), to_byte(color[3]) };
+    uint32_t pixel;
+    memcpy(&pixel, rgba, sizeof(pixel));
+    return pixel;
+}
+
+static uint32_t
+trace_ray(const frame *f, int x, int y)
+{
+    float color[4] = { BACKGROUND, BACKGROUND, BACKGROUND, 0.0f };
+    float p[3], d[3], n[3], light_dir[3], eye_dir[3];
+    float b, t, dist, n_dot_l, reflect, specular;
+    int i;
+
+    d[0] = (x - 0.5f * f->width) / f->scale * BOUNDING_RADIUS_SQR - Eye[0];
+    d[1] = (y - 0.5f * f->height) / f->scale * BOUNDING_RADIUS_SQR - Eye[1];
+    d[2] = -Eye[2];
+    normalize3(d);
+
+    // Nearest intersection with the bounding sphere.
+    b = 2.0f * dot3(Eye, d);
+    t = b * b - 4.0f * (dot3(Eye, Eye) - BOUNDING_RADIUS_SQR);
+    if (t <= 0.0f)
+        return pack_pixel(color);
+    t = (-b - sqrtf(t)) * 0.5f;
+    if (t <= 0.0f)
+        return pack_pixel(color);
+
+    for (i = 0; i < 3; i++)
+        p[i] = Eye[i] + d[i] * t;
+    dist = intersect(p, d, f->mu, f->epsilon);
+    if (dist >= f->epsilon)
+        return pack_pixel(color);
+
+    estimate_normal(n, p, f->mu);
+
+    // Phong shading.  As in the kernel, the ray direction is passed as the
+    // eye position.
+    for (i = 0; i < 3; i++)
+    {
+        light_dir[i] = Light[i] - p[i];
+        eye_dir[i] = d[i] - p[i];
+    }
+    normalize3(light_dir);
+    normalize3(eye_dir);
+    n_dot_l = dot3(n, light_dir);
+    reflect = 0.0f;
+    for (i = 0; i < 3; i++)
+        reflect += eye_dir[i] * (light_dir[i] - 2.0f * n_dot_l * n[i]);
+    specular = SPECULARITY * powf(fmaxf(reflect, 0.0f), SPECULAR_EXPONENT);
+    for (i = 0; i < 3; i++)
+        color[i] = (f->diffuse[i] + fabsf(n[i]) * 0.5f) * fmaxf(n_dot_l, 0.0f) + specular;
+    color[3] = 1.0f;
+
+    if (f->shadows)
+    {
+        for (i = 0; i < 3; i++)
+            p[i] += n[i] * f->epsilon * 2.0f;
+        if (intersect(p, light_dir, f->mu, f->epsilon) < f->epsilon)
+            for (i = 0; i < 3; i++)
+                color[i] *= SHADOW;
+    }
+
+    return pack_pixel(color);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Four float lanes, one ray per lane, and four lanes of comparison results
+// (all ones or all zeros).
+
+#if defined(__SSE2__)
+
+typedef __m128 vec4;
+typedef __m128 mask4;
+
+ALWAYS_INLINE vec4 v_set(float a)                   { return _mm_set1_ps(a); }
+ALWAYS_INLINE vec4 v_load(const float *p)           { return _mm_loadu_ps(p); }
+ALWAYS_INLINE vec4 v_add(vec4 a, vec4 b)            { return _mm_add_ps(a, b); }
+ALWAYS_INLINE vec4 v_sub(vec4 a, vec4 b)            { return _mm_sub_ps(a, b); }
+ALWAYS_INLINE vec4 v_mul(vec4 a, vec4 b)            { return _mm_mul_ps(a, b); }
+ALWAYS_INLINE vec4 v_div(vec4 a, vec4 b)            { return _mm_div_ps(a, b); }
+ALWAYS_INLINE vec4 v_min(vec4 a, vec4 b)            { return _mm_min_ps(a, b); }
+ALWAYS_INLINE vec4 v_sqrt(vec4 a)                   { return _mm_sqrt_ps(a); }
+ALWAYS_INLINE vec4 v_abs(vec4 a)                    { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+ALWAYS_INLINE mask4 v_lt(vec4 a, vec4 b)            { return _mm_cmplt_ps(a, b); }
+ALWAYS_INLINE mask4 v_ge(vec4 a, vec4 b)            { return _mm_cmpge_ps(a, b); }
+ALWAYS_INLINE mask4 v_gt(vec4 a, vec4 b)            { return _mm_cmpgt_ps(a, b); }
+ALWAYS_INLINE mask4 m_and(mask4 a, mask4 b)         { return _mm_and_ps(a, b); }
+ALWAYS_INLINE mask4 m_andnot(mask4 a, mask4 b)      { return _mm_andnot_ps(a, b); }
+ALWAYS_INLINE int m_any(mask4 a)                    { return _mm_movemask_ps(a) != 0; }
+
+// Lanes of a where m is set, and of b elsewhere.
+ALWAYS_INLINE vec4
+v_select(mask4 m, vec4 a, vec4 b)
+{
+    return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+
+// Split positive a into a mantissa in [1, 2) and an exponent.
+ALWAYS_INLINE vec4
+v_frexp(vec4 a, vec4 *exponent)
+{
+    __m128i i = _mm_castps_si128(a);
+    *exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(i, 23), _mm_set1_epi32(127)));
+    return _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(i, _mm_set1_epi32(0x007FFFFF)),
+                                         _mm_set1_epi32(0x3F800000)));
+}
+
+// Pack four colours in [0, 255] into RGBA pixels, rounding to nearest even.
+ALWAYS_INLINE void
+v_store_pixels(uint32_t *p, vec4 r, vec4 g, vec4 b, vec4 a)
+{
+    __m128i rg = _mm_packs_epi32(_mm_cvtps_epi32(r), _mm_cvtps_epi32(g));
+    __m128i ba = _mm_packs_epi32(_mm_cvtps_epi32(b), _mm_cvtps_epi32(a));
+    __m128i rgba = _mm_packus_epi16(rg, ba);                    // r0-r3 g0-g3 b0-b3 a0-a3
+    __m128i lo = _mm_unpacklo_epi8(rgba, _mm_srli_si128(rgba, 8));  // r0 b0 r1 b1 ... g0 a0 ...
+    rgba = _mm_unpacklo_epi8(lo, _mm_srli_si128(lo, 8));        // r0 g0 b0 a0 r1 ...
+    _mm_storeu_si128((__m128i *) p, rgba);
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+typedef float32x4_t vec4;
+typedef uint32x4_t mask4;
+
+ALWAYS_INLINE vec4 v_set(float a)                   { return vdupq_n_f32(a); }
+ALWAYS_INLINE vec4 v_load(const float *p)           { return vld1q_f32(p); }
+ALWAYS_INLINE vec4 v_add(vec4 a, vec4 b)            { return vaddq_f32(a, b); }
+ALWAYS_INLINE vec4 v_sub(vec4 a, vec4 b)            { return vsubq_f32(a, b); }
+ALWAYS_INLINE vec4 v_mul(vec4 a, vec4 b)            { return vmulq_f32(a, b); }
+ALWAYS_INLINE vec4 v_div(vec4 a, vec4 b)            { return vdivq_f32(a, b); }
+ALWAYS_INLINE vec4 v_min(vec4 a, vec4 b)            { return vminq_f32(a, b); }
+ALWAYS_INLINE vec4 v_sqrt(vec4 a)                   { return vsqrtq_f32(a); }
+ALWAYS_INLINE vec4 v_abs(vec4 a)                    { return vabsq_f32(a); }
+
+ALWAYS_INLINE mask4 v_lt(vec4 a, vec4 b)            { return vcltq_f32(a, b); }
+ALWAYS_INLINE mask4 v_ge(vec4 a, vec4 b)            { return vcgeq_f32(a, b); }
+ALWAYS_INLINE mask4 v_gt(vec4 a, vec4 b)            { return vcgtq_f32(a, b); }
+ALWAYS_INLINE mask4 m_and(mask4 a, mask4 b)         { return vandq_u32(a, b); }
+ALWAYS_INLINE mask4 m_andnot(mask4 a, mask4 b)      { return vbicq_u32(b, a); }
+ALWAYS_INLINE int m_any(mask4 a)                    { return vmaxvq_u32(a) != 0; }
+ALWAYS_INLINE vec4 v_select(mask4 m, vec4 a, vec4 b) { return vbslq_f32(m, a, b); }
+
+ALWAYS_INLINE vec4
+v_frexp(vec4 a, vec4 *exponent)
+{
+    uint32x4_t i = vreinterpretq_u32_f32(a);
+    *exponent = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(i, 23)), vdupq_n_s32(127)));
+    return vreinterpretq_f32_u32(vorrq_u32(vandq_u32(i, vdupq_n_u32(0x007FFFFF)), vdupq_n_u32(0x3F800000)));
+}
+
+ALWAYS_INLINE void
+v_store_pixels(uint32_t *p, vec4 r, vec4 g, vec4 b, vec4 a)
+{
+    uint16x8_t rg = vcombine_u16(vqmovun_s32(vcvtnq_s32_f32(r)), vqmovun_s32(vcvtnq_s32_f32(g)));
+    uint16x8_t ba = vcombine_u16(vqmovun_s32(vcvtnq_s32_f32(b)), vqmovun_s32(vcvtnq_s32_f32(a)));
+    uint8x8x4_t rgba;
+    uint8x8_t rgb8 = vqmovn_u16(rg), ba8 = vqmovn_u16(ba);
+    rgba.val[0] = rgb8;
+    rgba.val[1] = vext_u8(rgb8, rgb8, 4);
+    rgba.val[2] = ba8;
+    rgba.val[3] = vext_u8(ba8, ba8, 4);
+    {
+        // vst4 interleaves eight pixels; only the first four are ours.
+        uint8_t bytes[32];
+        vst4_u8(bytes, rgba);
+        memcpy(p, bytes, 16);
+    }
+}
+
+#else
+
+typedef struct { float f[4]; } vec4;
+typedef struct { uint32_t u[4]; } mask4;
+
+#define MAP1(expr)              { vec4 r; int i; for (i = 0; i < 4; i++) r.f[i] = (expr); return r; }
+#define MAP_MASK(expr)          { mask4 r; int i; for (i = 0; i < 4; i++) r.u[i] = (expr) ? 0xFFFFFFFFu : 0u; return r; }
+
+ALWAYS_INLINE vec4 v_set(float a)                   MAP1(a)
+ALWAYS_INLINE vec4 v_load(const float *p)           MAP1(p[i])
+ALWAYS_INLINE vec4 v_add(vec4 a, vec4 b)            MAP1(a.f[i] + b.f[i])
+ALWAYS_INLINE vec4 v_sub(vec4 a, vec4 b)            MAP1(a.f[i] - b.f[i])
+ALWAYS_INLINE vec4 v_mul(vec4 a, vec4 b)            MAP1(a.f[i] * b.f[i])
+ALWAYS_INLINE vec4 v_div(vec4 a, vec4 b)            MAP1(a.f[i] / b.f[i])
+ALWAYS_INLINE vec4 v_min(vec4 a, vec4 b)            MAP1(a.f[i] < b.f[i] ? a.f[i] : b.f[i])
+ALWAYS_INLINE vec4 v_sqrt(vec4 a)                   MAP1(sqrtf(a.f[i]))
+ALWAYS_INLINE vec4 v_abs(vec4 a)                    MAP1(fabsf(a.f[i]))
+
+ALWAYS_INLINE mask4 v_lt(vec4 a, vec4 b)            MAP_MASK(a.f[i] < b.f[i])
+ALWAYS_INLINE mask4 v_ge(vec4 a, vec4 b)            MAP_MASK(a.f[i] >= b.f[i])
+ALWAYS_INLINE mask4 v_gt(vec4 a, vec4 b)            MAP_MASK(a.f[i] > b.f[i])
+ALWAYS_INLINE mask4 m_and(mask4 a, mask4 b)         MAP_MASK(a.u[i] & b.u[i])
+ALWAYS_INLINE mask4 m_andnot(mask4 a, mask4 b)      MAP_MASK(~a.u[i] & b.u[i])
+ALWAYS_INLINE int m_any(mask4 a)                    { return (a.u[0] | a.u[1] | a.u[2] | a.u[3]) != 0; }
+ALWAYS_INLINE vec4 v_select(mask4 m, vec4 a, vec4 b) MAP1(m.u[i] ? a.f[i] : b.f[i])
+
+ALWAYS_INLINE vec4
+v_frexp(vec4 a, vec4 *exponent)
+{
+    int i;
+    for (i = 0; i < 4; i++)
+    {
+        uint32_t bits;
+        memcpy(&bits, &a.f[i], sizeof(bits));
+        exponent->f[i] = (float) ((int) (bits >> 23) - 127);
+        bits = (bits & 0x007FFFFFu) | 0x3F800000u;
+        memcpy(&a.f[i], &bits, sizeof(bits));
+    }
+    return a;
+}
+
+ALWAYS_INLINE void
+v_store_pixels(uint32_t *p, vec4 r, vec4 g, vec4 b, vec4 a)
+{
+    int i;
+    for (i = 0; i < 4; i++)
+    {
+        unsigned char rgba[4] =
+        {
+            (unsigned char) lrintf(r.f[i]), (unsigned char) lrintf(g.f[i]),
+            (unsigned char) lrintf(b.f[i]), (unsigned char) lrintf(a.f[i])
+        };
+        memcpy(&p[i], rgba, sizeof(p[i]));
+    }
+}
+
+#undef MAP1
+#undef MAP_MASK
+
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+ALWAYS_INLINE vec4 v_max0(vec4 a)                   { return v_select(v_gt(a, v_set(0.0f)), a, v_set(0.0f)); }
+
+ALWAYS_INLINE vec4
+v_dot3(vec4 ax, vec4 ay, vec4 az, vec4 bx, vec4 by, vec4 bz)
+{
+    return v_add(v_add(v_mul(ax, bx), v_mul(ay, by)), v_mul(az, bz));
+}
+
+ALWAYS_INLINE vec4
+v_dot4(const vec4 a[4])
+{
+    return v_add(v_add(v_mul(a[0], a[0]), v_mul(a[1], a[1])), v_add(v_mul(a[2], a[2]), v_mul(a[3], a[3])));
+}
+
+ALWAYS_INLINE void
+v_normalize3(vec4 *x, vec4 *y, vec4 *z)
+{
+    vec4 s = v_div(v_set(1.0f), v_sqrt(v_dot3(*x, *y, *z, *x, *y, *z)));
+    *x = v_mul(*x, s);
+    *y = v_mul(*y, s);
+    *z = v_mul(*z, s);
+}
+
+// Natural logarithm of positive a, to within a few units in the last place:
+// log(m * 2^e) = e log(2) + log(m), with m brought into [sqrt(1/2), sqrt(2))
+// and log(m) = 2 atanh(t), t = (m - 1) / (m + 1), from its series.
+ALWAYS_INLINE vec4
+v_log(vec4 a)
+{
+    vec4 e, m = v_frexp(a, &e), t, t2, s;
+    mask4 big = v_gt(m, v_set(1.41421356f));
+
+    m = v_select(big, v_mul(m, v_set(0.5f)), m);
+    e = v_select(big, v_add(e, v_set(1.0f)), e);
+    t = v_div(v_sub(m, v_set(1.0f)), v_add(m, v_set(1.0f)));
+    t2 = v_mul(t, t);
+    s = v_add(v_set(1.0f / 7.0f), v_mul(t2, v_set(1.0f / 9.0f)));
+    s = v_add(v_set(1.0f / 5.0f), v_mul(t2, s));
+    s = v_add(v_set(1.0f / 3.0f), v_mul(t2, s));
+    s = v_add(v_set(1.0f), v_mul(t2, s));
+    return v_add(v_mul(e, v_set(0.693147181f)), v_mul(v_mul(v_set(2.0f), t), s));
+}
+
+// z = z^2 + c for the quaternions in the lanes of z.
+ALWAYS_INLINE void
+v_qsqr_add(vec4 z[4], const vec4 c[4])
+{
+    vec4 x2 = v_add(z[0], z[0]);
+    vec4 w = v_add(v_add(v_mul(z[1], z[1]), v_mul(z[2], z[2])), v_mul(z[3], z[3]));
+    z[0] = v_add(v_sub(v_mul(z[0], z[0]), w), c[0]);
+    z[1] = v_add(v_mul(x2, z[1]), c[1]);
+    z[2] = v_add(v_mul(x2, z[2]), c[2]);
+    z[3] = v_add(v_mul(x2, z[3]), c[3]);
+}
+
+// zp = 2 z zp, the derivative of the iteration.
+ALWAYS_INLINE void
+v_qderiv(vec4 zp[4], const vec4 z[4])
+{
+    vec4 two = v_set(2.0f), r[4];
+    r[0] = v_sub(v_mul(z[0], zp[0]), v_dot3(z[1], z[2], z[3], zp[1], zp[2], zp[3]));
+    r[1] = v_add(v_add(v_mul(zp[1], z[0]), v_mul(z[1], zp[0])), v_sub(v_mul(z[2], zp[3]), v_mul(z[3], zp[2])));
+    r[2] = v_add(v_add(v_mul(zp[2], z[0]), v_mul(z[2], zp[0])), v_sub(v_mul(z[3], zp[1]), v_mul(z[1], zp[3])));
+    r[3] = v_add(v_add(v_mul(zp[3], z[0]), v_mul(z[3], zp[0])), v_sub(v_mul(z[1], zp[2]), v_mul(z[2], zp[1])));
+    zp[0] = v_mul(two, r[0]);
+    zp[1] = v_mul(two, r[1]);
+    zp[2] = v_mul(two, r[2]);
+    zp[3] = v_mul(two, r[3]);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// A packet of n vectors of four rays.  The loops over the vectors of a packet
+// are innermost, so the n independent iteration chains overlap in the
+// processor's pipelines, and a vector whose rays have all finished is
+// skipped.
+typedef struct
+{
+    vec4 px[MAX_PACKET / 4], py[MAX_PACKET / 4], pz[MAX_PACKET / 4];
+    vec4 dx[MAX_PACKET / 4], dy[MAX_PACKET / 4], dz[MAX_PACKET / 4];
+    vec4 dist[MAX_PACKET / 4];
+} packet;
+
+// Distance-estimation march of the rays in mask active, as intersect().  The
+// end points and distances of the other rays are left alone.
+ALWAYS_INLINE void
+march_packet(packet *r, const mask4 *start, const vec4 c[4], vec4 epsilon, const int n)
+{
+    const vec4 escape = v_set(ESCAPE_THRESHOLD);
+    mask4 active[MAX_PACKET / 4];
+    int k, any;
+
+    for (k = 0; k < n; k++)
+        active[k] = start[k];
+
+    do
+    {
+        vec4 z[MAX_PACKET / 4][4], zp[MAX_PACKET / 4][4];
+        mask4 live[MAX_PACKET / 4];
+        int i;
+
+        for (k = 0; k < n; k++)
+        {
+            z[k][0] = r->px[k];
+            z[k][1] = r->py[k];
+            z[k][2] = r->pz[k];
+            z[k][3] = v_set(0.0f);
+            zp[k][0] = v_set(1.0f);
+            zp[k][1] = zp[k][2] = zp[k][3] = v_set(0.0f);
+            live[k] = active[k];
+        }
+
+        // Iterate until every ray has escaped, freezing each ray as it does.
+        for (i = 0; i < ITERATIONS; i++)
+        {
+            any = 0;
+            for (k = 0; k < n; k++)
+            {
+                vec4 nz[4], nzp[4];
+                int j;
+
+                if (!m_any(live[k]))
+                    continue;
+                memcpy(nz, z[k], sizeof(nz));
+                memcpy(nzp, zp[k], sizeof(nzp));
+                v_qderiv(nzp, nz);
+                v_qsqr_add(nz, c);
+                for (j = 0; j < 4; j++)
+                {
+                    z[k][j] = v_select(live[k], nz[j], z[k][j]);
+                    zp[k][j] = v_select(live[k], nzp[j], zp[k][j]);
+                }
+                live[k] = m_and(live[k], v_lt(v_dot4(z[k]), escape));
+                any |= m_any(live[k]);
+            }
+            if (!any)
+                break;
+        }
+
+        // Step each ray by its distance estimate and retire those that hit
+        // the surface or left the escape radius.
+        any = 0;
+        for (k = 0; k < n; k++)
+        {
+            vec4 norm_z, dist;
+
+            if (!m_any(active[k]))
+                continue;
+            norm_z = v_sqrt(v_dot4(z[k]));
+            dist = v_div(v_mul(v_mul(v_set(0.5f), norm_z), v_log(norm_z)), v_sqrt(v_dot4(zp[k])));
+            r->dist[k] = v_select(active[k], dist, r->dist[k]);
+            dist = v_select(active[k], dist, v_set(0.0f));
+            r->px[k] = v_add(r->px[k], v_mul(r->dx[k], dist));
+            r->py[k] = v_add(r->py[k], v_mul(r->dy[k], dist));
+            r->pz[k] = v_add(r->pz[k], v_mul(r->dz[k], dist));
+            active[k] = m_and(m_and(active[k], v_ge(dist, epsilon)),
+                              v_lt(v_dot3(r->px[k], r->py[k], r->pz[k], r->px[k], r->py[k], r->pz[k]), escape));
+            any |= m_any(active[k]);
+        }
+    } while (any);
+}
+
+ALWAYS_INLINE vec4
+v_escape_length(vec4 q[4], const vec4 c[4])
+{
+    int i;
+    for (i = 0; i < ITERATIONS; i++)
+        v_qsqr_add(q, c);
+    return v_sqrt(v_dot4(q));
+}
+
+ALWAYS_INLINE void
+v_estimate_normal(vec4 n[3], vec4 px, vec4 py, vec4 pz, const vec4 c[4])
+{
+    const vec4 delta = v_set(DELTA);
+    int axis;
+
+    for (axis = 0; axis < 3; axis++)
+    {
+        vec4 g1[4] = { px, py, pz, v_set(0.0f) };
+        vec4 g2[4] = { px, py, pz, v_set(0.0f) };
+        g1[axis] = v_sub(g1[axis], delta);
+        g2[axis] = v_add(g2[axis], delta);
+        n[axis] = v_sub(v_escape_length(g2, c), v_escape_length(g1, c));
+    }
+    v_normalize3(&n[0], &n[1], &n[2]);
+}
+
+// Trace 4n rays from the pixels at x[i], y[i] and store their colours.
+ALWAYS_INLINE void
+trace_packet(const frame *f, const int *x, const int *y, uint32_t *pixels, const int n)
+{
+    const vec4 background = v_set(BACKGROUND), epsilon = v_set(f->epsilon);
+    vec4 c[4], color[MAX_PACKET / 4][3], alpha[MAX_PACKET / 4];
+    vec4 lx[MAX_PACKET / 4], ly[MAX_PACKET / 4], lz[MAX_PACKET / 4];
+    vec4 nx[MAX_PACKET / 4], ny[MAX_PACKET / 4], nz[MAX_PACKET / 4];
+    mask4 hit[MAX_PACKET / 4];
+    packet r;
+    int k, any = 0;
+
+    for (k = 0; k < 4; k++)
+        c[k] = v_set(f->mu[k]);
+
+    // Camera rays and their entry points into the bounding sphere.
+    for (k = 0; k < n; k++)
+    {
+        float fx[4], fy[4];
+        vec4 b, t;
+        int i;
+
+        for (i = 0; i < 4; i++)
+        {
+            fx[i] = (float) x[4 * k + i];
+            fy[i] = (float) y[4 * k + i];
+        }
+        r.dx[k] = v_sub(v_mul(v_div(v_sub(v_load(fx), v_set(0.5f * f->width)), v_set(f->scale)),
+                              v_set(BOUNDING_RADIUS_SQR)), v_set(Eye[0]));
+        r.dy[k] = v_sub(v_mul(v_div(v_sub(v_load(fy), v_set(0.5f * f->height)), v_set(f->scale)),
+                              v_set(BOUNDING_RADIUS_SQR)), v_set(Eye[1]));
+        r.dz[k] = v_set(-Eye[2]);
+        v_normalize3(&r.dx[k], &r.dy[k], &r.dz[k]);
+
+        b = v_mul(v_set(2.0f), v_dot3(v_set(Eye[0]), v_set(Eye[1]), v_set(Eye[2]), r.dx[k], r.dy[k], r.dz[k]));
+        t = v_sub(v_mul(b, b), v_set(4.0f * (Eye[0] * Eye[0] + Eye[1] * Eye[1] + Eye[2] * Eye[2] -
+                                             BOUNDING_RADIUS_SQR)));
+        hit[k] = v_gt(t, v_set(0.0f));
+        t = v_mul(v_sub(v_sub(v_set(0.0f), b), v_sqrt(v_max0(t))), v_set(0.5f));
+        hit[k] = m_and(hit[k], v_gt(t, v_set(0.0f)));
+
+        r.px[k] = v_add(v_set(Eye[0]), v_mul(r.dx[k], t));
+        r.py[k] = v_add(v_set(Eye[1]), v_mul(r.dy[k], t));
+        r.pz[k] = v_add(v_set(Eye[2]), v_mul(r.dz[k], t));
+        r.dist[k] = epsilon;
+        any |= m_any(hit[k]);
+    }
+
+    if (any)
+        march_packet(&r, hit, c, epsilon, n);
+
+    for (k = 0; k < n; k++)
+    {
+        vec4 ex, ey, ez, n_dot_l, reflect, specular, s2, s4;
+        int i;
+
+        // As in the kernel, a ray hits when its distance is not at least
+        // epsilon, which includes a distance that is not a number.
+        hit[k] = m_andnot(v_ge(r.dist[k], epsilon), hit[k]);
+        color[k][0] = color[k][1] = color[k][2] = background;
+        alpha[k] = v_set(0.0f);
+        if (!m_any(hit[k]))
+            continue;
+
+        {
+            vec4 normal[3];
+            v_estimate_normal(normal, r.px[k], r.py[k], r.pz[k], c);
+            nx[k] = normal[0];
+            ny[k] = normal[1];
+            nz[k] = normal[2];
+        }
+
+        // Phong shading, with the ray direction as the eye position as in
+        // the kernel.
+        lx[k] = v_sub(v_set(Light[0]), r.px[k]);
+        ly[k] = v_sub(v_set(Light[1]), r.py[k]);
+        lz[k] = v_sub(v_set(Light[2]), r.pz[k]);
+        v_normalize3(&lx[k], &ly[k], &lz[k]);
+        ex = v_sub(r.dx[k], r.px[k]);
+        ey = v_sub(r.dy[k], r.py[k]);
+        ez = v_sub(r.dz[k], r.pz[k]);
+        v_normalize3(&ex, &ey, &ez);
+
+        n_dot_l = v_dot3(nx[k], ny[k], nz[k], lx[k], ly[k], lz[k]);
+        s2 = v_mul(v_set(2.0f), n_dot_l);
+        reflect = v_dot3(ex, ey, ez, v_sub(lx[k], v_mul(s2, nx[k])), v_sub(ly[k], v_mul(s2, ny[k])),
+                         v_sub(lz[k], v_mul(s2, nz[k])));
+        reflect = v_max0(reflect);
+        s2 = v_mul(reflect, reflect);
+        s4 = v_mul(s2, s2);
+        specular = v_mul(v_set(SPECULARITY), v_mul(v_mul(s4, s4), s2));
+        n_dot_l = v_max0(n_dot_l);
+
+        {
+            vec4 normal[3] = { nx[k], ny[k], nz[k] };
+            for (i = 0; i < 3; i++)
+            {
+                vec4 base = v_add(v_set(f->diffuse[i]), v_mul(v_abs(normal[i]), v_set(0.5f)));
+                color[k][i] = v_select(hit[k], v_add(v_mul(base, n_dot_l), specular), background);
+            }
+        }
+        alpha[k] = v_select(hit[k], v_set(1.0f), alpha[k]);
+    }
+
+    if (f->shadows)
+    {
+        any = 0;
+        for (k = 0; k < n; k++)
+        {
+            vec4 offset = v_set(f->epsilon * 2.0f);
+            if (!m_any(hit[k]))
+                continue;
+            r.px[k] = v_add(r.px[k], v_mul(nx[k], offset));
+            r.py[k] = v_add(r.py[k], v_mul(ny[k], offset));
+            r.pz[k] = v_add(r.pz[k], v_mul(nz[k], offset));
+            r.dx[k] = lx[k];
+            r.dy[k] = ly[k];
+            r.dz[k] = lz[k];
+            r.dist[k] = epsilon;
+            any = 1;
+        }
+        if (any)
+        {
+            // Vectors without hits are not marched, as their masks are empty.
+            march_packet(&r, hit, c, epsilon, n);
+            for (k = 0; k < n; k++)
+            {
+                mask4 shadowed;
+                int i;
+                if (!m_any(hit[k]))
+                    continue;
+                shadowed = m_and(hit[k], v_lt(r.dist[k], epsilon));
+                for (i = 0; i < 3; i++)
+                    color[k][i] = v_select(shadowed, v_mul(color[k][i], v_set(SHADOW)), color[k][i]);
+            }
+        }
+    }
+
+    for (k = 0; k < n; k++)
+    {
+        const vec4 scale = v_set(255.0f);
+        vec4 out[4];
+        int i;
+
+        // Saturate as convert_uchar4_sat_rte() does, sending negative and
+        // not-a-number values to zero.
+        for (i = 0; i < 4; i++)
+            out[i] = v_min(v_max0(v_mul(i < 3 ? color[k][i] : alpha[k], scale)), scale);
+        v_store_pixels(pixels + 4 * k, out[0], out[1], out[2], out[3]);
+    }
+}
+
+static void trace_packet4(const frame *f, const int *x, const int *y, uint32_t *p)  { trace_packet(f, x, y, p, 1); }
+static void trace_packet8(const frame *f, const int *x, const int *y, uint32_t *p)  { trace_packet(f, x, y, p, 2); }
+static void trace_packet16(const frame *f, const int *x, const int *y, uint32_t *p) { trace_packet(f, x, y, p, 4); }
+
+static void
+trace_single(const frame *f, const int *x, const int *y, uint32_t *pixels)
+{
+    pixels[0] = trace_ray(f, x[0], y[0]);
+}
+
+typedef void (*trace_function)(const frame *f, const int *x, const int *y, uint32_t *pixels);
+
+static trace_function
+select_tracer(int packet)
+{
+    switch (packet)
+    {
+        case 1:     return trace_single;
+        case 4:     return trace_packet4;
+        case 8:     return trace_packet8;
+        case 16:    return trace_packet16;
+        default:    return NULL;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// One pass over the image:  trace every pixel on the grid of the given
+// block size, skipping those on the grid of the previous pass when refining,
+// and fill each traced pixel's block.
+typedef struct
+{
+    const frame *frame;
+    unsigned char *rgba;
+    trace_function trace;
+    int packet;
+    int block;
+    int refine;
+    int tiles_x;
+    long tile_count;
+    volatile long next_tile;
+} render_job;
+
+static void
+fill_block(const render_job *job, int x, int y, uint32_t pixel)
+{
+    int width = job->frame->width, height = job->frame->height;
+    int x1 = x + job->block < width ? x + job->block : width;
+    int y1 = y + job->block < height ? y + job->block : height;
+    int i, j;
+
+    for (j = y; j < y1; j++)
+    {
+        uint32_t *row = (uint32_t *) job->rgba + (size_t) j * width;
+        for (i = x; i < x1; i++)
+            row[i] = pixel;
+    }
+}
+
+static void
+render_tile(render_job *job, long tile)
+{
+    int xs[TILE_SIZE * TILE_SIZE + MAX_PACKET], ys[TILE_SIZE * TILE_SIZE + MAX_PACKET];
+    uint32_t pixels[MAX_PACKET];
+    int x0 = (int) (tile % job->tiles_x) * TILE_SIZE, y0 = (int) (tile / job->tiles_x) * TILE_SIZE;
+    int x1 = x0 + TILE_SIZE < job->frame->width ? x0 + TILE_SIZE : job->frame->width;
+    int y1 = y0 + TILE_SIZE < job->frame->height ? y0 + TILE_SIZE : job->frame->height;
+    int s = job->block, count = 0, i, j, x, y;
+
+    // Gather the pixels of this pass, row by row so neighbouring rays share
+    // packets.  Pixels on the grid of twice the block size were traced by the
+    // previous pass.
+    for (y = y0; y < y1; y += s)
+    {
+        for (x = x0; x < x1; x += s)
+        {
+            if (job->refine && ((x | y) & s) == 0)
+                continue;
+            xs[count] = x;
+            ys[count] = y;
+            count++;
+        }
+    }
+
+    // Pad the last packet with copies of the last ray.
+    for (i = count; i % job->packet; i++)
+    {
+        xs[i] = xs[count - 1];
+        ys[i] = ys[count - 1];
+    }
+
+    for (i = 0; i < count; i += job->packet)
+    {
+        job->trace(job->frame, xs + i, ys + i, pixels);
+        for (j = 0; j < job->packet && i + j < count; j++)
+        {
+            if (s == 1)
+                ((uint32_t *) job->rgba)[(size_t) ys[i + j] * job->frame->width + xs[i + j]] = pixels[j];
+            else
+                fill_block(job, xs[i + j], ys[i + j], pixels[j]);
+        }
+    }
+}
+
+static void *
+render_worker(void *arg)
+{
+    render_job *job = arg;
+    long tile;
+
+    while ((tile = __sync_fetch_and_add(&job->next_tile, 1)) < job->tile_count)
+        render_tile(job, tile);
+    return NULL;
+}
+
+static int
+processor_count(void)
+{
+    static int count = 0;
+    if (!count)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        count = n > 0 ? (int) n : 1;
+    }
+    return count;
+}
+
+static void
+render_pass(const frame *f, unsigned char *rgba, int packet, int threads, int block, int refine)
+{
+    pthread_t workers[MAX_THREADS];
+    render_job job;
+    int i, started = 0;
+
+    memset(&job, 0, sizeof(job));
+    job.frame = f;
+    job.rgba = rgba;
+    job.trace = select_tracer(packet);
+    job.packet = packet;
+    job.block = block;
+    job.refine = refine;
+    job.tiles_x = (f->width + TILE_SIZE - 1) / TILE_SIZE;
+    job.tile_count = (long) job.tiles_x * ((f->height + TILE_SIZE - 1) / TILE_SIZE);
+
+    if (threads <= 0)
+        threads = processor_count();
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if (threads > job.tile_count)
+        threads = (int) job.tile_count;
+
+    for (i = 1; i < threads; i++)
+        if (pthread_create(&workers[started], NULL, render_worker, &job) == 0)
+            started++;
+    render_worker(&job);
+    for (i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+}
+
+static int
+valid_arguments(int width, int height, int *packet)
+{
+    if (*packet == 0)
+        *packet = QJULIA_CPU_DEFAULT_PACKET;
+    return width > 0 && height > 0 && select_tracer(*packet) != NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int
+qjulia_cpu_render(
+    unsigned char *rgba, int width, int height,
+    const qjulia_cpu_scene *scene, int packet, int threads)
+{
+    frame f;
+
+    if (!rgba || !scene || !valid_arguments(width, height, &packet))
+        return -1;
+
+    setup_frame(&f, width, height, scene);
+    render_pass(&f, rgba, packet, threads, 1, 0);
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+struct qjulia_cpu_progressive
+{
+    frame frame;
+    int packet;
+    int threads;
+    int block;              // block size of the image so far, 0 before the first pass
+    int has_scene;
+    double rays_per_second; // measured, for choosing the first block size
+};
+
+static double
+seconds_now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+// Rays traced by a pass with the given block size.
+static double
+pass_rays(const frame *f, int block, int refine)
+{
+    double columns = (f->width + block - 1) / block, rows = (f->height + block - 1) / block;
+    double coarse = refine ? (double) ((f->width + 2 * block - 1) / (2 * block)) *
+                             ((f->height + 2 * block - 1) / (2 * block)) : 0.0;
+    return columns * rows - coarse;
+}
+
+qjulia_cpu_progressive *
+qjulia_cpu_progressive_create(int width, int height, int packet, int threads)
+{
+    qjulia_cpu_progressive *p;
+
+    if (!valid_arguments(width, height, &packet))
+        return NULL;
+    p = calloc(1, sizeof(*p));
+    if (!p)
+        return NULL;
+
+    p->frame.width = width;
+    p->frame.height = height;
+    p->packet = packet;
+    p->threads = threads;
+
+    // A guess, corrected by the first pass.
+    p->rays_per_second = 1e6;
+    return p;
+}
+
+void
+qjulia_cpu_progressive_destroy(qjulia_cpu_progressive *p)
+{
+    free(p);
+}
+
+void
+qjulia_cpu_progressive_restart(qjulia_cpu_progressive *p, const qjulia_cpu_scene *scene)
+{
+    setup_frame(&p->frame, p->frame.width, p->frame.height, scene);
+    p->block = 0;
+    p->has_scene = 1;
+}
+
+int
+qjulia_cpu_progressive_render(qjulia_cpu_progressive *p, unsigned char *rgba, double seconds)
+{
+    double start = seconds_now(), elapsed = 0.0;
+
+    if (!p->has_scene || !rgba)
+        return -1;
+
+    while (p->block != 1)
+    {
+        int refine = p->block != 0, block;
+        double rays, pass_start, now;
+
+        // Refine by halving the block size, or start with the smallest
+        // block size whose pass is expected to fit the budget.
+        if (refine)
+        {
+            block = p->block / 2;
+        }
+        else
+        {
+            block = 1;
+            while (block < MAX_BLOCK_SIZE && pass_rays(&p->frame, block, 0) > seconds * p->rays_per_second)
+                block *= 2;
+        }
+        rays = pass_rays(&p->frame, block, refine);
+
+        // Run at least one pass, and then only passes that are expected to
+        // finish in time.
+        if (elapsed > 0.0 && elapsed + rays / p->rays_per_second > seconds)
+            break;
+
+        pass_start = seconds_now();
+        render_pass(&p->frame, rgba, p->packet, p->threads, block, refine);
+        p->block = block;
+
+        now = seconds_now();
+        elapsed = now - start;
+        if (rays >= 1024.0 && now > pass_start)
+            p->rays_per_second = rays / (now - pass_start);
+    }
+    return p->block;
+}
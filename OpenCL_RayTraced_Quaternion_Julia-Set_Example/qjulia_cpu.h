@@ -0,0 +1,137 @@
+//
+// File:       qjulia_cpu.h
+//
+// Abstract:   Declares a multi-threaded CPU ray marcher for the quaternion Julia set, producing
+//             the same images as QJuliaKernel in qjulia_kernel.cl.
+//
+//             Rays are traced in packets of 4, 8 or 16 with SSE or NEON.  Each packet keeps a
+//             mask of the rays still marching, so rays that hit the surface or leave the bounding
+//             sphere stop costing time as soon as the rest of their vector is done.  The image
+//             is divided into tiles which threads render independently.  A progressive renderer
+//             starts each new view at a resolution that fits a time budget and refines it on
+//             later calls, for interactive frame rates.
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __QJULIA_CPU_H__
+#define __QJULIA_CPU_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+// The packet size that a packet of 0 picks.
+//
+#define QJULIA_CPU_DEFAULT_PACKET   (8)
+
+// The parameters of QJuliaKernel.  Shadows are off in the kernel (SHADOWS is
+// 0); setting shadows traces a second ray from each hit towards the light, as
+// the kernel does when SHADOWS is 1.
+//
+typedef struct
+{
+    float mu[4];
+    float diffuse[4];
+    float epsilon;
+    int shadows;
+} qjulia_cpu_scene;
+
+// Render a width x height image into rgba, four bytes per pixel, with the
+// first row at the lowest address, as QJuliaKernel does.
+//
+// packet is the number of rays traced together: 4, 8 or 16, or 1 to trace
+// single rays with the standard C math library, as a reference; 0 picks the
+// fastest.  threads is the most threads to use, counting the calling thread;
+// 0 uses one per online processor.
+//
+// Returns 0 on success, or -1 if an argument is invalid.
+//
+int qjulia_cpu_render(
+    unsigned char *rgba, int width, int height,
+    const qjulia_cpu_scene *scene, int packet, int threads);
+
+/////////////////////////////////////////////////////////////////////////////
+
+// A progressive renderer first traces one ray for each block of up to 16 x
+// 16 pixels and fills the block with its colour, and then halves the block
+// size on each pass until every pixel has been traced.  Each pass traces only
+// the pixels that earlier passes did not, so the finished image is exactly
+// the one qjulia_cpu_render() produces.
+//
+typedef struct qjulia_cpu_progressive qjulia_cpu_progressive;
+
+// Returns NULL if an argument is invalid or memory is short.
+//
+qjulia_cpu_progressive *qjulia_cpu_progressive_create(
+    int width, int height, int packet, int threads);
+
+void qjulia_cpu_progressive_destroy(qjulia_cpu_progressive *progressive);
+
+// Start again with a new view.  The image is not touched until the next call
+// to qjulia_cpu_progressive_render().
+//
+void qjulia_cpu_progressive_restart(
+    qjulia_cpu_progressive *progressive, const qjulia_cpu_scene *scene);
+
+// Run as many passes as fit in about the given number of seconds, and at
+// least one, into rgba, which must hold the image from the previous call
+// unless the view was restarted in between.  After a restart the first pass
+// uses the smallest block size that the measured ray rate says will fit.
+//
+// Returns the block size of the image now in rgba, so 1 once the image is
+// complete, when further calls return 1 without doing anything, or -1 if no
+// view has been set.
+//
+int qjulia_cpu_progressive_render(
+    qjulia_cpu_progressive *progressive, unsigned char *rgba, double seconds);
+
+/////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __QJULIA_CPU_H__
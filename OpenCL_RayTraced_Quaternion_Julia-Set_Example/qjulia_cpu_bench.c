@@ -0,0 +1,447 @@
+//
+// File:       qjulia_cpu_bench.c
+//
+// Abstract:   Renders the quaternion Julia set headless with the CPU ray marcher in qjulia_cpu.c,
+//             writes the image to qjulia_cpu.ppm, and checks it against the single-ray reference
+//             path, against itself for every packet size and thread count, and against the
+//             progressive renderer.  It then reports the rendering rate in rays per second.
+//
+//             When built with QJULIA_OPENCL defined (the default on Mac OS X) it also renders the
+//             image with QJuliaKernel from qjulia_kernel.cl on the OpenCL CPU device, writes it to
+//             qjulia_cl.ppm, and compares the two.  The kernel uses the fast and half-precision
+//             OpenCL math functions, so the images match to within a few levels in most pixels
+//             rather than exactly; the surface normals come from finite differences and amplify
+//             small differences in where a ray stops.
+//
+//             Without OpenCL this program uses only standard C and POSIX threads and builds on
+//             any platform, for example:
+//
+//                 cc -O3 -march=native -std=gnu99 -o qjulia_cpu_bench qjulia_cpu_bench.c
+//             qjulia_cpu.c -lpthread -lm
+//
+//             and on Mac OS X, run from the directory holding qjulia_kernel.cl:
+//
+//                 cc -O3 -std=gnu99 -o qjulia_cpu_bench qjulia_cpu_bench.c qjulia_cpu.c
+//             -framework OpenCL
+//
+//             Usage:  qjulia_cpu_bench [width height [threads]]
+//
+// Version:    <1.0>
+//
+// Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple Inc. ("Apple")
+//             in consideration of your agreement to the following terms, and your use,
+//             installation, modification or redistribution of this Apple software
+//             constitutes acceptance of these terms.  If you do not agree with these
+//             terms, please do not use, install, modify or redistribute this Apple
+//             software.
+//
+//             In consideration of your agreement to abide by the following terms, and
+//             subject to these terms, Apple grants you a personal, non - exclusive
+//             license, under Apple's copyrights in this original Apple software ( the
+//             "Apple Software" ), to use, reproduce, modify and redistribute the Apple
+//             Software, with or without modifications, in source and / or binary forms;
+//             provided that if you redistribute the Apple Software in its entirety and
+//             without modifications, you must retain this notice and the following text
+//             and disclaimers in all such redistributions of the Apple Software. Neither
+//             the name, trademarks, service marks or logos of Apple Inc. may be used to
+//             endorse or promote products derived from the Apple Software without specific
+//             prior written permission from Apple.  Except as expressly stated in this
+//             notice, no other rights or licenses, express or implied, are granted by
+//             Apple herein, including but not limited to any patent rights that may be
+//             infringed by your derivative works or by other works in which the Apple
+//             Software may be incorporated.
+//
+//             The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+//             WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+//             WARRANTIES OF NON - INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A
+//             PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION
+//             ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+//
+//             IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+//             CONSEQUENTIAL DAMAGES ( INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+//             SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//             INTERRUPTION ) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION
+//             AND / OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER
+//             UNDER THEORY OF CONTRACT, TORT ( INCLUDING NEGLIGENCE ), STRICT LIABILITY OR
+//             OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Copyright ( C ) 2008 Apple Inc. All Rights Reserved.
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "qjulia_cpu.h"
+
+#if defined(__APPLE__) && !defined(QJULIA_OPENCL)
+#define QJULIA_OPENCL           (1)
+#endif
+
+#if QJULIA_OPENCL
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Minimum time to spend timing each case, in seconds.
+static const double min_seconds = 0.5;
+
+// Differences of up to this many levels in a channel are rounding.
+#define TOLERANCE               (2)
+
+// Share of pixels allowed to differ by more than TOLERANCE from the reference.
+#define MAX_DIFFERING           (0.01)
+
+/////////////////////////////////////////////////////////////////////////////
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static int
+write_ppm(const char *name, const unsigned char *rgba, int width, int height)
+{
+    FILE *file = fopen(name, "wb");
+    size_t i;
+
+    if (!file)
+    {
+        printf("Error: Failed to open %s!\n", name);
+        return 0;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    for (i = 0; i < (size_t) width * height; i++)
+        fwrite(rgba + 4 * i, 1, 3, file);
+    fclose(file);
+    printf("    wrote %s\n", name);
+    return 1;
+}
+
+// Count the pixels that differ by more than TOLERANCE in any channel, and
+// report them as a share of the image.
+static int
+compare(const char *name, const unsigned char *a, const unsigned char *b, int width, int height,
+        double allowed)
+{
+    size_t i, pixels = (size_t) width * height, differing = 0, coverage = 0;
+    int worst = 0, c;
+
+    for (i = 0; i < pixels; i++)
+    {
+        int bad = 0;
+        for (c = 0; c < 4; c++)
+        {
+            int d = abs(a[4 * i + c] - b[4 * i + c]);
+            worst = d > worst ? d : worst;
+            bad |= d > TOLERANCE;
+        }
+        differing += bad;
+        coverage += a[4 * i + 3] != b[4 * i + 3];
+    }
+
+    printf("    %-34s %7.3f%% of pixels differ, %5.3f%% in coverage, by up to %d\n",
+           name, 100.0 * differing / pixels, 100.0 * coverage / pixels, worst);
+    if (differing > allowed * pixels)
+    {
+        printf("    FAILED: %s\n", name);
+        return 0;
+    }
+    return 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+#if QJULIA_OPENCL
+
+static char *
+load_kernel(int width, int height)
+{
+    FILE *file = fopen("qjulia_kernel.cl", "rb");
+    char *source;
+    long length;
+    int header;
+
+    if (!file)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    // The image size is compiled in, as in qjulia.c.
+    source = malloc(length + 256);
+    header = sprintf(source, "\n#define WIDTH (%d)\n#define HEIGHT (%d)\n", width, height);
+    if (fread(source + header, 1, length, file) != (size_t) length)
+    {
+        free(source);
+        source = NULL;
+    }
+    else
+    {
+        source[header + length] = '\0';
+    }
+    fclose(file);
+    return source;
+}
+
+// Render with QJuliaKernel on the OpenCL CPU device.  Returns 0 if there is
+// no such device or the kernel cannot be run.
+static int
+render_opencl(unsigned char *rgba, int width, int height, const qjulia_cpu_scene *scene)
+{
+    cl_device_id device;
+    cl_context context = NULL;
+    cl_command_queue queue = NULL;
+    cl_program program = NULL;
+    cl_kernel kernel = NULL;
+    cl_mem result = NULL;
+    size_t global[2] = { (size_t) width, (size_t) height };
+    char *source = NULL;
+    int err, ok = 0;
+
+    if (clGetDeviceIDs(NULL, CL_DEVICE_TYPE_CPU, 1, &device, NULL) != CL_SUCCESS)
+    {
+        printf("    no OpenCL CPU device, skipped\n");
+        return 0;
+    }
+
+    source = load_kernel(width, height);
+    if (!source)
+    {
+        printf("    qjulia_kernel.cl not found, skipped\n");
+        return 0;
+    }
+
+    context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+    if (context)
+        queue = clCreateCommandQueue(context, device, 0, &err);
+    if (queue)
+        program = clCreateProgramWithSource(context, 1, (const char **) &source, NULL, &err);
+    if (program && clBuildProgram(program, 0, NULL, NULL, NULL, NULL) == CL_SUCCESS)
+        kernel = clCreateKernel(program, "QJuliaKernel", &err);
+    if (kernel)
+        result = clCreateBuffer(context, CL_MEM_WRITE_ONLY, (size_t) width * height * 4, NULL, &err);
+
+    if (result)
+    {
+        err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &result);
+        err |= clSetKernelArg(kernel, 1, 4 * sizeof(float), scene->mu);
+        err |= clSetKernelArg(kernel, 2, 4 * sizeof(float), scene->diffuse);
+        err |= clSetKernelArg(kernel, 3, sizeof(float), &scene->epsilon);
+        if (err == CL_SUCCESS)
+            err = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, global, NULL, 0, NULL, NULL);
+        if (err == CL_SUCCESS)
+            err = clEnqueueReadBuffer(queue, result, CL_TRUE, 0, (size_t) width * height * 4, rgba,
+                                      0, NULL, NULL);
+        ok = err == CL_SUCCESS;
+    }
+    if (!ok)
+        printf("    failed to run QJuliaKernel on the OpenCL CPU device, skipped\n");
+
+    if (result)
+        clReleaseMemObject(result);
+    if (kernel)
+        clReleaseKernel(kernel);
+    if (program)
+        clReleaseProgram(program);
+    if (queue)
+        clReleaseCommandQueue(queue);
+    if (context)
+        clReleaseContext(context);
+    free(source);
+    return ok;
+}
+
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+static int
+validate(int width, int height, qjulia_cpu_scene *scene)
+{
+    static const int packets[] = { 4, 8, 16 };
+    static const int thread_counts[] = { 1, 4, 0 };
+    size_t bytes = (size_t) width * height * 4;
+    unsigned char *reference = malloc(bytes), *simd = malloc(bytes), *image = malloc(bytes);
+    qjulia_cpu_progressive *progressive;
+    char name[64];
+    int ok = 1, i, j, block, last;
+
+    // The packet tracer against the single-ray reference, which differs in
+    // its square roots and logarithms.
+    qjulia_cpu_render(reference, width, height, scene, 1, 0);
+    qjulia_cpu_render(simd, width, height, scene, 4, 1);
+    ok &= compare("packets of 4 against single rays", simd, reference, width, height, MAX_DIFFERING);
+
+    // Every packet size and thread count must give the same image.
+    for (i = 0; i < 3; i++)
+    {
+        for (j = 0; j < 3; j++)
+        {
+            memset(image, 0xCD, bytes);
+            qjulia_cpu_render(image, width, height, scene, packets[i], thread_counts[j]);
+            snprintf(name, sizeof name, "packets of %d, %d threads", packets[i], thread_counts[j]);
+            ok &= compare(name, image, simd, width, height, 0.0);
+            if (memcmp(image, simd, bytes) != 0)
+            {
+                printf("    FAILED: %s is not identical\n", name);
+                ok = 0;
+            }
+        }
+    }
+
+    // The progressive renderer must end with the same image, with the block
+    // size halving on every pass after the first.
+    progressive = qjulia_cpu_progressive_create(width, height, 0, 0);
+    qjulia_cpu_progressive_restart(progressive, scene);
+    memset(image, 0xCD, bytes);
+    last = 0;
+    do
+    {
+        block = qjulia_cpu_progressive_render(progressive, image, 1e-6);
+        if (last ? block != last / 2 : (block < 1 || block > 16 || (block & (block - 1))))
+        {
+            printf("    FAILED: progressive pass went from block size %d to %d\n", last, block);
+            ok = 0;
+            break;
+        }
+        last = block;
+    } while (block > 1);
+    qjulia_cpu_progressive_destroy(progressive);
+    if (memcmp(image, simd, bytes) != 0)
+    {
+        printf("    FAILED: progressive rendering is not identical\n");
+        ok = 0;
+    }
+
+    // Shadows exercise the masks of a second march that starts at the hits.
+    scene->shadows = 1;
+    qjulia_cpu_render(reference, width, height, scene, 1, 0);
+    qjulia_cpu_render(image, width, height, scene, 16, 0);
+    ok &= compare("shadows against single rays", image, reference, width, height, MAX_DIFFERING);
+    scene->shadows = 0;
+
+    write_ppm("qjulia_cpu.ppm", simd, width, height);
+
+#if QJULIA_OPENCL
+    memset(image, 0, bytes);
+    if (render_opencl(image, width, height, scene))
+    {
+        write_ppm("qjulia_cl.ppm", image, width, height);
+        ok &= compare("packets of 4 against QJuliaKernel", simd, image, width, height, MAX_DIFFERING);
+    }
+#endif
+
+    free(reference);
+    free(simd);
+    free(image);
+    return ok;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+static void
+bench(int width, int height, const qjulia_cpu_scene *scene, int packet, int threads)
+{
+    unsigned char *image = malloc((size_t) width * height * 4);
+    double t0 = now(), t, rays;
+    int frames = 0, rays_per_packet = packet ? packet : QJULIA_CPU_DEFAULT_PACKET;
+    char name[64];
+
+    do
+    {
+        qjulia_cpu_render(image, width, height, scene, packet, threads);
+        frames++;
+    } while ((t = now() - t0) < min_seconds);
+
+    rays = (double) width * height * frames / t;
+    snprintf(name, sizeof name, rays_per_packet == 1 ? "single rays" : "packets of %d", rays_per_packet);
+    printf("    %-20s %8.3f Mrays/sec %8.2f ms/frame\n", name, 1e-6 * rays, 1e3 * t / frames);
+    free(image);
+}
+
+static void
+bench_progressive(int width, int height, const qjulia_cpu_scene *scene, int threads)
+{
+    unsigned char *image = malloc((size_t) width * height * 4);
+    qjulia_cpu_progressive *progressive = qjulia_cpu_progressive_create(width, height, 0, threads);
+    double budget = 1.0 / 30.0, t0, first = 0.0;
+    int frames = 0, block = 0, first_block = 0, views;
+
+    // Restart a few times so the ray rate has been measured, as it would have
+    // been when animating.
+    for (views = 0; views < 4; views++)
+    {
+        qjulia_cpu_progressive_restart(progressive, scene);
+        t0 = now();
+        first_block = qjulia_cpu_progressive_render(progressive, image, budget);
+        first = now() - t0;
+        for (frames = 1, block = first_block; block > 1; frames++)
+            block = qjulia_cpu_progressive_render(progressive, image, budget);
+    }
+
+    printf("    progressive, %.0f ms budget: first frame %.2f ms at %dx%d blocks, "
+           "complete after %d frames\n", 1e3 * budget, 1e3 * first, first_block, first_block, frames);
+    qjulia_cpu_progressive_destroy(progressive);
+    free(image);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+    qjulia_cpu_scene scene =
+    {
+        { -.278f, -.479f, -.231f, .235f },
+        { 0.25f, 0.45f, 1.0f, 1.0f },
+        0.003f,
+        0
+    };
+    int width = 512, height = 512, threads = 0, ok;
+
+    if (argc > 2)
+    {
+        width = atoi(argv[1]);
+        height = atoi(argv[2]);
+    }
+    if (argc > 3)
+        threads = atoi(argv[3]);
+    if (width <= 0 || height <= 0)
+    {
+        printf("Usage:  %s [width height [threads]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("Validating %d x %d...\n", width, height);
+    ok = validate(width, height, &scene);
+
+    printf("Timing %d x %d with 1 thread:\n", width, height);
+    bench(width, height, &scene, 1, 1);
+    bench(width, height, &scene, 4, 1);
+    bench(width, height, &scene, 8, 1);
+    bench(width, height, &scene, 16, 1);
+
+    printf("Timing %d x %d with %d threads (0 is one per processor):\n", width, height, threads);
+    bench(width, height, &scene, 0, threads);
+    bench_progressive(width, height, &scene, threads);
+
+    if (!ok)
+    {
+        printf("Error:  Incorrect results obtained!\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("Results Validated!\n");
+    return 0;
+}
@@ -7,6 +7,12 @@ Abstract:
     to understand the lessons of the WWDC session.  Additional information is
     in ClockServices.h.
 
+    On Mac OS X, time is read with mach_absolute_time.  On Linux, it is read
+    from a cycle counter opened with perf_event_open, the time-stamp counter,
+    ARM's virtual counter, or clock_gettime, whichever is available, and the
+    timing thread is bound to one processor and given real-time priority where
+    the system allows it.
+
 Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
 Apple Inc. ("Apple") in consideration of your agreement to the
 following terms, and your use, installation, modification or
@@ -50,15 +56,25 @@ Copyright (C) 2008 Apple Inc. All Rights Reserved.
 */
 
 
+#if defined __linux__
+    // Declare sched_setaffinity, sched_getcpu, and RUSAGE_THREAD.
+    #define _GNU_SOURCE
+#endif
+
 #include <errno.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ClockServices.h"
 
-#define IntelProcessor  (defined __i386__ || defined __x86_64__)
+#if defined __i386__ || defined __x86_64__
+    #define IntelProcessor  1
+#else
+    #define IntelProcessor  0
+#endif
 
 
 // Select the timing method to be used.
@@ -70,9 +86,12 @@ Copyright (C) 2008 Apple Inc. All Rights Reserved.
     #define TM_UT   3   // Carbon's UpTime.
     #define TM_TOD  4   // Open Unix's gettimeofday.
     #define TM_MACH 5   // mach_absolute_time.
+    #define TM_LINUX 6  // One of several Linux clocks, chosen when run.
 
     // Set the method in TimingMethod.
-    #if defined __ppc__ || defined __ppc64__
+    #if defined __linux__
+        #define TimingMethod    TM_LINUX    // Method to use on Linux.
+    #elif defined __ppc__ || defined __ppc64__
         #define TimingMethod    TM_MACH // Method to use on PowerPC.
     #elif defined __i386__
         #define TimingMethod    TM_MACH // Method to use on IA-32.
@@ -107,6 +126,17 @@ Copyright (C) 2008 Apple Inc. All Rights Reserved.
 
     #include <mach/mach_time.h>     // For mach_absolute_time.
 
+#elif TimingMethod == TM_LINUX
+
+    #include <sched.h>              // For sched_setaffinity and SCHED_FIFO.
+    #include <time.h>               // For clock_gettime.
+    #include <unistd.h>             // For read and syscall.
+    #include <sys/syscall.h>        // For SYS_perf_event_open.
+    #include <linux/perf_event.h>   // For struct perf_event_attr.
+    #if IntelProcessor
+        #include <cpuid.h>          // For __get_cpuid.
+    #endif
+
 #endif
 
 
@@ -134,7 +164,7 @@ Copyright (C) 2008 Apple Inc. All Rights Reserved.
     #define upper       tv_sec
     #define lower       tv_usec
 
-#elif TimingMethod == TM_MACH
+#elif TimingMethod == TM_MACH || TimingMethod == TM_LINUX
 
     typedef uint64_t ClockValue;
     #define ClockMax    UINT64_MAX
@@ -147,6 +177,101 @@ Copyright (C) 2008 Apple Inc. All Rights Reserved.
 #endif  // TimingMethod.
 
 
+#if TimingMethod == TM_LINUX
+
+    /*  Which clocks work on Linux depends on the processor, the kernel, and
+        the permissions of the process, so the clock is chosen when the program
+        runs, by ChooseClockSource below.  The choice may be overridden by
+        setting the environment variable CLOCK_SERVICES_SOURCE to one of the
+        names in ClockSourceName.
+    */
+    typedef enum
+    {
+        CS_PERF,        // perf_event_open counting this thread's CPU cycles.
+        CS_TSC,         // IA-32's time-stamp counter.
+        CS_CNTVCT,      // ARM's virtual count register.
+        CS_MONOTONIC,   // clock_gettime with CLOCK_MONOTONIC_RAW.
+        CS_Count
+    } ClockSourceType;
+
+    static const char * const ClockSourceName[CS_Count] =
+        { "perf", "tsc", "cntvct", "monotonic" };
+
+    static ClockSourceType ClockSource = CS_MONOTONIC;
+
+    // File descriptor of the perf event, when ClockSource is CS_PERF.
+    static int PerfDescriptor = -1;
+
+    // Whether the processor has the rdtscp instruction.
+    static bool HaveRDTSCP = false;
+
+
+    // Return the current value of the Linux clock in ClockSource.
+    static inline uint64_t ReadLinuxClock(void)
+    {
+        switch (ClockSource)
+        {
+            case CS_PERF:
+            {
+                /*  read is a system call and costs far more than reading a
+                    register, but it costs the same in both measurements
+                    MeasureNetTime makes, so it cancels out, and the event
+                    excludes cycles spent in the kernel.
+                */
+                uint64_t count = 0;
+                if (sizeof count != read(PerfDescriptor, &count, sizeof count))
+                    return 0;
+                return count;
+            }
+
+        #if IntelProcessor
+            case CS_TSC:
+            {
+                /*  rdtscp waits for earlier instructions to complete before
+                    reading the counter, and lfence keeps later instructions
+                    from starting before it is read.  Without rdtscp, rdtsc is
+                    fenced on both sides.
+                */
+                uint32_t upper, lower, aux;
+                if (HaveRDTSCP)
+                    __asm__ volatile("rdtscp; lfence"
+                        : "=d" (upper), "=a" (lower), "=c" (aux)
+                        :
+                        : "memory");
+                else
+                    __asm__ volatile("lfence; rdtsc; lfence"
+                        : "=d" (upper), "=a" (lower)
+                        :
+                        : "memory");
+                return (uint64_t) upper << 32 | lower;
+            }
+        #endif
+
+        #if defined __aarch64__
+            case CS_CNTVCT:
+            {
+                // isb keeps the counter from being read early.
+                uint64_t count;
+                __asm__ volatile("isb; mrs %[count], cntvct_el0"
+                    : [count] "=r" (count)
+                    :
+                    : "memory");
+                return count;
+            }
+        #endif
+
+            default:
+            {
+                struct timespec t;
+                clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+                return (uint64_t) t.tv_sec * 1000000000u + t.tv_nsec;
+            }
+        }
+    }
+
+#endif  // TimingMethod == TM_LINUX
+
+
 // Return the current value of the clock.
 static inline ClockValue ReadClock(void)
 {
@@ -173,6 +298,10 @@ static inline ClockValue ReadClock(void)
 
         return mach_absolute_time();
 
+    #elif TimingMethod == TM_LINUX
+
+        return ReadLinuxClock();
+
     #else   // TimingMethod.
 
         /*  In these cases, we must read the time as two values from some
@@ -269,7 +398,7 @@ static inline ClockValue ReadClock(void)
 */
 static ClockValue SubtractClock(const ClockValue t1, const ClockValue t0)
 {
-#if TimingMethod == TM_MACH
+#if TimingMethod == TM_MACH || TimingMethod == TM_LINUX
 
     return t1 - t0;
 
@@ -300,7 +429,7 @@ static ClockValue SubtractClock(const ClockValue t1, const ClockValue t0)
 */
 static bool ClockLessThan(const ClockValue t0, const ClockValue t1)
 {
-#if TimingMethod == TM_MACH
+#if TimingMethod == TM_MACH || TimingMethod == TM_LINUX
 
     return t0 < t1;
 
@@ -322,7 +451,7 @@ static double ClockToDouble(const ClockValue t)
 {
 #if TimingMethod == TM_TOD
     return t.upper * 1e6 + t.lower;
-#elif TimingMethod == TM_MACH
+#elif TimingMethod == TM_MACH || TimingMethod == TM_LINUX
     return t;
 #else
     return t.upper * 4294967296. + t.lower;
@@ -331,11 +460,14 @@ static double ClockToDouble(const ClockValue t)
 
 
 #include <math.h>
-#include <sys/sysctl.h> // Declare things needed for sysctlbyname.
-#include <mach/mach.h>  // Define constants for CPU types.
+#if defined __APPLE__
+    #include <sys/sysctl.h> // Declare things needed for sysctlbyname.
+    #include <mach/mach.h>  // Define constants for CPU types.
+#endif
 
 
-#if defined __i386__    // Conditionalize on architecture.
+#if defined __i386__ && TimingMethod != TM_LINUX
+                        // Conditionalize on architecture.
 
 
     // Describe the layout of the EFLAGS register.
@@ -503,13 +635,35 @@ static double ClockToDouble(const ClockValue t)
 #endif  // defined __i386__ // Conditionalize on architecture.
 
 
+/*  On Linux, where any processor model may be found, ConsumeCPUCycles
+    executes a chain of ChainLength dependent additions instead of a table of
+    known loops.  Each addition must wait for the result of the one before it,
+    and an integer addition takes one cycle on every current IA-32 and ARM
+    core, so an iteration takes ChainLength cycles however many instructions
+    the processor can issue at once.  The loop's own decrement and branch
+    proceed alongside the chain.  The addend is a register, not an immediate
+    value, because some recent IA-32 cores fold chains of immediate additions
+    together when renaming registers, completing several in one cycle.
+*/
+#if TimingMethod == TM_LINUX && (IntelProcessor || defined __aarch64__)
+    #define ChainLength 64
+#else
+    #define ChainLength 0
+#endif
+
+
 /*  Return the number of CPU cycles per iteration that the following
     routine, ConsumeCPUCycles, consumes.  Zero is returned if the
     information is not known.
 */
 static unsigned int GetCPUCyclesCycles(void)
 {
-    #if defined __i386__    // Conditionalize on architecture.
+    #if TimingMethod == TM_LINUX
+        if (ChainLength == 0)
+            fprintf(stderr,
+"Warning, no chain of known duration is defined for this architecture.\n");
+        return ChainLength;
+    #elif defined __i386__  // Conditionalize on architecture.
         unsigned int family, model;
         if (GetCPUFamilyAndModel(&family, &model))
         {
@@ -629,7 +783,44 @@ static unsigned int GetCPUCyclesCycles(void)
 */
 static void ConsumeCPUCycles(unsigned int iterations, void *UnusedPointer)
 {
-    #if defined __ppc__ || defined __ppc64__    // Architecture.
+    #if TimingMethod == TM_LINUX && IntelProcessor  // Architecture.
+        unsigned long chain = 0, one = 1;
+        __asm__ volatile("                  \n\
+                .p2align 5                  \n\
+            0:                              \n\
+                .rept   %c[length]          \n\
+                add     %[one], %[chain]    \n\
+                .endr                       \n\
+                dec     %[iterations]       \n\
+                jne     0b                  "
+            :   [chain] "+r" (chain),
+                [iterations] "+r" (iterations)
+                    // chain and iterations are altered inputs.
+            :   [length] "i" (ChainLength),
+                [one] "r" (one)
+            :   "cc"
+        );
+    #elif TimingMethod == TM_LINUX && defined __aarch64__   // Architecture.
+        unsigned long chain = 0, one = 1;
+        __asm__ volatile("                          \n\
+                .p2align 5                          \n\
+            0:                                      \n\
+                .rept   %c[length]                  \n\
+                add     %[chain], %[chain], %[one]  \n\
+                .endr                               \n\
+                subs    %w[iterations], %w[iterations], #1  \n\
+                b.ne    0b                          "
+            :   [chain] "+r" (chain),
+                [iterations] "+r" (iterations)
+                    // chain and iterations are altered inputs.
+            :   [length] "i" (ChainLength),
+                [one] "r" (one)
+            :   "cc"
+        );
+    #elif TimingMethod == TM_LINUX                  // Architecture.
+        // No chain is defined; GetCPUCyclesCycles reports 0 cycles.
+        (void) iterations;
+    #elif defined __ppc__ || defined __ppc64__      // Architecture.
         /*  Instructions are executed in a loop.  These instructions are
             expected to take a known amount of CPU cycles on specific
             processors, but this should be checked with some other source,
@@ -795,6 +986,9 @@ static void ConsumeCPUCycles(unsigned int iterations, void *UnusedPointer)
 #endif  // defined NeedCHUD
 
 
+#if defined __APPLE__
+
+
 // Include things needed by set_time_constraint_policy routine below.
 #include <mach/mach.h>
 #include <mach/host_info.h>
@@ -825,6 +1019,182 @@ static kern_return_t set_time_constraint_policy()
 }
 
 
+#endif  // defined __APPLE__
+
+
+// Describe the environment timing was done in, for reports.
+static struct
+{
+    const char *Source;     // Name of the clock used.
+    int CPU;                // Processor the thread is bound to, or -1.
+    bool RealTime;          // Whether the thread has real-time priority.
+    char Governor[32];      // Linux's CPU frequency governor, or empty.
+} Environment = { "mach", -1, false, "" };
+
+
+#if TimingMethod == TM_LINUX
+
+
+    /*  Bind this thread to the processor it is running on, so that the
+        clock it reads and the caches it warms stay the same from sample to
+        sample, and set it to SCHED_FIFO at the lowest real-time priority,
+        which still keeps time-sharing threads from interrupting it.  Each
+        step needs permissions the process might not have; the timing
+        proceeds without whichever step fails.
+    */
+    static void SetRealTimePolicy(void)
+    {
+        int cpu = sched_getcpu();
+        if (0 <= cpu)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            if (0 == sched_setaffinity(0, sizeof set, &set))
+                Environment.CPU = cpu;
+            else
+                fprintf(stderr,
+                    "Warning, unable to bind thread to processor %d.\n", cpu);
+        }
+
+        struct sched_param parameter = { 0 };
+        parameter.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        if (0 == sched_setscheduler(0, SCHED_FIFO, &parameter))
+            Environment.RealTime = true;
+        else
+            fprintf(stderr,
+                "Warning, unable to set thread to real-time scheduling.\n");
+    }
+
+
+    /*  Open a perf event counting the CPU cycles this thread executes in user
+        mode, and check that it counts.  Return true for success.  Kernels
+        with perf_event_paranoid above 2, virtual machines without a
+        performance monitoring unit, and containers that filter the system
+        call all make this fail.
+    */
+    static bool OpenPerfCounter(void)
+    {
+        struct perf_event_attr attributes;
+        memset(&attributes, 0, sizeof attributes);
+        attributes.size             = sizeof attributes;
+        attributes.type             = PERF_TYPE_HARDWARE;
+        attributes.config           = PERF_COUNT_HW_CPU_CYCLES;
+        attributes.exclude_kernel   = 1;
+        attributes.exclude_hv       = 1;
+
+        int descriptor = syscall(SYS_perf_event_open, &attributes, 0, -1, -1,
+            0);
+        if (descriptor < 0)
+            return false;
+
+        uint64_t c0 = 0, c1 = 0;
+        bool counts =
+               sizeof c0 == read(descriptor, &c0, sizeof c0)
+            && (ConsumeCPUCycles(1000, NULL), true)
+            && sizeof c1 == read(descriptor, &c1, sizeof c1)
+            && c0 < c1;
+        if (!counts)
+        {
+            close(descriptor);
+            return false;
+        }
+
+        PerfDescriptor = descriptor;
+        return true;
+    }
+
+
+    /*  Choose the clock ReadClock uses.  CPU cycles counted by the processor
+        are preferred, since they are what we report and are unaffected by
+        changes in clock frequency.  Failing that, a counter register is
+        preferred to clock_gettime, because it is cheaper to read.
+    */
+    static void ChooseClockSource(void)
+    {
+        #if IntelProcessor
+            unsigned int eax, ebx, ecx, edx;
+            HaveRDTSCP = __get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx)
+                && (edx >> 27 & 1);
+        #endif
+
+        // Use the clock requested in the environment, if it is available.
+        const char *requested = getenv("CLOCK_SERVICES_SOURCE");
+        if (requested)
+        {
+            int source = 0;
+            while (source < CS_Count
+                    && 0 != strcmp(requested, ClockSourceName[source]))
+                ++source;
+
+            bool available;
+            switch (source)
+            {
+                case CS_PERF:       available = OpenPerfCounter();  break;
+                case CS_TSC:        available = IntelProcessor;     break;
+            #if defined __aarch64__
+                case CS_CNTVCT:     available = true;               break;
+            #endif
+                case CS_MONOTONIC:  available = true;               break;
+                default:            available = false;              break;
+            }
+
+            if (available)
+            {
+                ClockSource = source;
+                Environment.Source = ClockSourceName[ClockSource];
+                return;
+            }
+
+            fprintf(stderr,
+"Warning, clock source \"%s\" is not available, choosing another.\n",
+                requested);
+        }
+
+        if (OpenPerfCounter())
+            ClockSource = CS_PERF;
+        else if (IntelProcessor)
+            ClockSource = CS_TSC;
+        #if defined __aarch64__
+        else
+            ClockSource = CS_CNTVCT;
+        #endif
+
+        Environment.Source = ClockSourceName[ClockSource];
+    }
+
+
+    // Return the processor this thread runs on, or 0 if it is unknown.
+    static int CurrentCPU(void)
+    {
+        int cpu = 0 <= Environment.CPU ? Environment.CPU : sched_getcpu();
+        return cpu < 0 ? 0 : cpu;
+    }
+
+
+    /*  Record the CPU frequency governor of this thread's processor.  Any
+        governor but "performance" may change the frequency while timing.
+        Virtual machines often have no governor at all.
+    */
+    static void ReadGovernor(void)
+    {
+        char name[128];
+        snprintf(name, sizeof name,
+            "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor",
+            CurrentCPU());
+
+        FILE *file = fopen(name, "r");
+        if (!file)
+            return;
+        if (1 != fscanf(file, "%31s", Environment.Governor))
+            Environment.Governor[0] = 0;
+        fclose(file);
+    }
+
+
+#endif  // TimingMethod == TM_LINUX
+
+
 /*  StartClockServices.
 
     Initialize the environment for timing routines.  If resources are acquired
@@ -840,11 +1210,25 @@ static void StartClockServices(void)
         return;
     started = true;
 
+#if TimingMethod == TM_LINUX
+
+    // Bind this thread to a processor, set it to real-time scheduling, and
+    // choose a clock.
+    SetRealTimePolicy();
+    ChooseClockSource();
+    ReadGovernor();
+
+#else   // TimingMethod
+
     // Set this thread to real-time scheduling.
-    if (KERN_SUCCESS != set_time_constraint_policy())
+    if (KERN_SUCCESS == set_time_constraint_policy())
+        Environment.RealTime = true;
+    else
         fprintf(stderr,
             "Warning, unable to set thread to real-time scheduling.\n");
 
+#endif  // TimingMethod
+
 #if defined NeedCHUD
 
         // Initialize CHUD facilities.
@@ -1143,6 +1527,152 @@ static double CPUCyclesPerTickViaHardware(void)
 }
 
 
+#if TimingMethod == TM_LINUX
+
+
+    /*  Return the frequency, in Hertz, that the system reports for this
+        thread's processor, from cpufreq if it is present and otherwise from
+        /proc/cpuinfo.  Return 0 if neither reports it.
+    */
+    static double SystemCPUFrequency(void)
+    {
+        int cpu = CurrentCPU();
+
+        char name[128];
+        snprintf(name, sizeof name,
+            "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", cpu);
+
+        FILE *file = fopen(name, "r");
+        if (file)
+        {
+            double kHz;
+            int found = fscanf(file, "%lf", &kHz);
+            fclose(file);
+            if (found == 1 && 0 < kHz)
+                return kHz * 1e3;
+        }
+
+        file = fopen("/proc/cpuinfo", "r");
+        if (file)
+        {
+            char line[256];
+            int processor = -1;
+            double MHz = 0;
+            while (MHz == 0 && fgets(line, sizeof line, file))
+                if (1 != sscanf(line, "processor : %d", &processor)
+                        && processor == cpu)
+                    sscanf(line, "cpu MHz : %lf", &MHz);
+            fclose(file);
+            if (0 < MHz)
+                return MHz * 1e6;
+        }
+
+        fprintf(stderr,
+"Warning, the system does not report the frequency of processor %d.\n",
+            cpu);
+        return 0;
+    }
+
+
+    // Return the number of ticks per second of the clock ReadClock reads.
+    static double ClockFrequency(void)
+    {
+        switch (ClockSource)
+        {
+        #if defined __aarch64__
+            case CS_CNTVCT:
+            {
+                uint64_t frequency;
+                __asm__ volatile("mrs %[frequency], cntfrq_el0"
+                    : [frequency] "=r" (frequency));
+                return frequency;
+            }
+        #endif
+
+            case CS_TSC:
+            {
+                /*  The time-stamp counter's frequency is not reported, so
+                    count its ticks during 20 milliseconds of
+                    CLOCK_MONOTONIC_RAW.
+                */
+                struct timespec t0, t1;
+                clock_gettime(CLOCK_MONOTONIC_RAW, &t0);
+                ClockValue c0 = ReadClock(), c1;
+                double seconds;
+                do
+                {
+                    clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+                    c1 = ReadClock();
+                    seconds = (t1.tv_sec - t0.tv_sec)
+                        + 1e-9 * (t1.tv_nsec - t0.tv_nsec);
+                } while (seconds < .02);
+                return ClockToDouble(SubtractClock(c1, c0)) / seconds;
+            }
+
+            default:
+                return 1e9;
+        }
+    }
+
+
+#endif  // TimingMethod == TM_LINUX
+
+
+#if TimingMethod != TM_MACH
+    #include <time.h>
+#endif
+
+
+// Return a time in seconds, from a clock independent of CPU frequency.
+static double Seconds(void)
+{
+    #if TimingMethod == TM_MACH
+        static mach_timebase_info_data_t data;
+        if (data.denom == 0)
+            mach_timebase_info(&data);
+        return mach_absolute_time() * 1e-9 * data.numer / data.denom;
+    #else
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return t.tv_sec + 1e-9 * t.tv_nsec;
+    #endif
+}
+
+
+/*  Return the frequency the CPU is running at now, in cycles per second,
+    found by timing ConsumeCPUCycles with Seconds.  Comparing this before and
+    after a measurement shows whether the frequency changed during it.  Zero
+    is returned if the number of cycles ConsumeCPUCycles takes is not known.
+*/
+static double MeasureCPUFrequency(void)
+{
+    // Ask for the cycles per iteration once, since it may print a warning.
+    static int Cycles = -1;
+    if (Cycles < 0)
+        Cycles = GetCPUCyclesCycles();
+    if (Cycles == 0)
+        return 0;
+
+    /*  4096 iterations take a few hundred thousand cycles, which is long
+        enough that the time to read the clock does not matter and short
+        enough to be uninterrupted.  Take the fastest of a few tries.
+    */
+    static const unsigned int Iterations = 4096;
+    double Fastest = INFINITY;
+    ConsumeCPUCycles(1, NULL);
+    for (int i = 0; i < 5; ++i)
+    {
+        double t0 = Seconds();
+        ConsumeCPUCycles(Iterations, NULL);
+        double t = Seconds() - t0;
+        if (t < Fastest)
+            Fastest = t;
+    }
+
+    return Cycles * Iterations / Fastest;
+}
+
+
 /*  Return the number of CPU cycles in one clock tick determined by asking
     the operating system.
 */
@@ -1222,6 +1752,21 @@ static double CPUCyclesPerTickViaSystem(void)
         */
         return CPUFrequency / (1e9 * data.denom / data.numer);
 
+    #elif TimingMethod == TM_LINUX
+
+        // perf counts CPU cycles, one per tick.
+        if (ClockSource == CS_PERF)
+            return 1;
+
+        /*  Otherwise, the CPU cycles per tick are the frequency the system
+            reports for the processor divided by the frequency of the clock.
+        */
+        double CPUFrequency = SystemCPUFrequency();
+        if (CPUFrequency == 0)
+            return 0;
+
+        return CPUFrequency / ClockFrequency();
+
     #else   // TimingMethod.
 
         #error "Code is not defined for selected timing method."
@@ -1250,6 +1795,13 @@ static double CPUCyclesPerTickViaSystem(void)
 }
 
 
+/*  The CPU frequency measured when CPUCyclesPerTick computed its value, or
+    zero if it could not be measured.  If the frequency changes afterward, the
+    cycles per tick of clocks that do not count cycles change with it.
+*/
+static double CalibrationFrequency = 0;
+
+
 // Return the number of CPU cycles in one clock tick.
 static double CPUCyclesPerTick(void)
 {
@@ -1261,9 +1813,23 @@ static double CPUCyclesPerTick(void)
     if (CachedCPUCyclesPerTick != 0)
         return CachedCPUCyclesPerTick;
 
+    CalibrationFrequency = MeasureCPUFrequency();
+
     double CyclesPerTickViaHardware = CPUCyclesPerTickViaHardware();
     double CyclesPerTickViaSystem   = CPUCyclesPerTickViaSystem  ();
 
+    /*  Mac OS X reports the frequency the CPU runs at.  Linux reports one the
+        CPU ran at recently, or, in a virtual machine, often the nominal
+        frequency of the host, so there the hardware value, which is measured
+        at the frequency the CPU runs at now, is preferred, except for perf,
+        whose ticks are CPU cycles.
+    */
+    #if TimingMethod == TM_LINUX
+        bool PreferHardware = ClockSource != CS_PERF;
+    #else
+        bool PreferHardware = false;
+    #endif
+
     if (CyclesPerTickViaHardware == 0)
     {
         // This must be a CPU model we are unfamiliar with.
@@ -1291,11 +1857,14 @@ static double CPUCyclesPerTick(void)
 "cycles per clock tick.\n"
 "\tHardware indicates %g cycles per tick.\n"
 "\tSystem indicates %g cycles per tick.\n"
-"\tUsing system value.\n",
+"\tUsing %s value.\n",
                 CyclesPerTickViaHardware,
-                CyclesPerTickViaSystem);
+                CyclesPerTickViaSystem,
+                PreferHardware ? "hardware" : "system");
 
-            CachedCPUCyclesPerTick = CyclesPerTickViaSystem;
+            CachedCPUCyclesPerTick = PreferHardware
+                ? CyclesPerTickViaHardware
+                : CyclesPerTickViaSystem;
         }
 
     return CachedCPUCyclesPerTick;
@@ -1326,3 +1895,277 @@ double MeasureNetTimeInCPUCycles(
     return ClockToCPUCycles(MeasureNetTime(routine, iterations, data, samples))
         / iterations;
 }
+
+
+#include <sys/resource.h>   // For getrusage.
+
+
+// Select getrusage's report for this thread where there is one.
+#if defined RUSAGE_THREAD
+    #define RUsageWho   RUSAGE_THREAD
+#else
+    #define RUsageWho   RUSAGE_SELF
+#endif
+
+
+/*  Return the number of context switches this thread has undergone.  A
+    sample during which this changes was interrupted, so it is taken again.
+    This serves the purpose on all systems that LoadAndReserve and
+    StoreConditional serve on PowerPC.
+*/
+static long ContextSwitches(void)
+{
+    struct rusage usage;
+    if (0 != getrusage(RUsageWho, &usage))
+        return 0;
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+
+/*  Measure the gross time to execute iterations iterations of routine, as
+    MeasureGrossTime does, repeating the measurement up to MaximumRetries times
+    while it is interrupted by a context switch.  *retries is incremented for
+    each repetition.
+*/
+static ClockValue MeasureUninterruptedTime(
+        RoutineToBeTimedType routine,
+        unsigned int iterations,
+        void *data,
+        unsigned int *retries
+    )
+{
+    static const unsigned int MaximumRetries = 10;
+
+    for (unsigned int attempt = 0; ; ++attempt)
+    {
+        long switches = ContextSwitches();
+        ClockValue d = MeasureGrossTime(routine, iterations, data);
+        if (switches == ContextSwitches() || attempt == MaximumRetries)
+            return d;
+        ++*retries;
+    }
+}
+
+
+// Compare two doubles for qsort.
+static int CompareDoubles(const void *a, const void *b)
+{
+    double x = * (const double *) a, y = * (const double *) b;
+    return (y < x) - (x < y);
+}
+
+
+/*  Return the half-sample mode of the n sorted values in x.
+
+    Timing samples cluster at the routine's usual time, with a long tail of
+    interrupted samples above it.  The half-sample mode finds the cluster:  It
+    repeatedly keeps the half of the values that lie in the narrowest interval
+    until three or fewer are left.  It needs no bin width, unlike a histogram,
+    so it gives the same answer for the same samples.
+*/
+static double HalfSampleMode(const double *x, size_t n)
+{
+    while (3 < n)
+    {
+        size_t half = (n + 1) / 2;
+        size_t start = 0;
+        for (size_t i = 1; i + half <= n; ++i)
+            if (x[i + half - 1] - x[i] < x[start + half - 1] - x[start])
+                start = i;
+        x += start;
+        n = half;
+    }
+
+    if (n == 3)
+    {
+        double lower = x[1] - x[0], upper = x[2] - x[1];
+        return lower < upper ? (x[0] + x[1]) / 2
+            :  upper < lower ? (x[1] + x[2]) / 2
+            :  x[1];
+    }
+
+    return n == 2 ? (x[0] + x[1]) / 2 : x[0];
+}
+
+
+// Return the median of the n sorted values in x.
+static double Median(const double *x, size_t n)
+{
+    return n % 2 ? x[n/2] : (x[n/2 - 1] + x[n/2]) / 2;
+}
+
+
+// See header file for description of this routine.
+int MeasureNetTimeStatistics(
+        RoutineToBeTimedType routine,
+        unsigned int iterations,
+        void *data,
+        unsigned int samples,
+        ClockServicesStatistics *statistics
+    )
+{
+    // Relative change in CPU frequency above which we report scaling.
+    static const double FrequencyTolerance = .01;
+
+    if (iterations == 0 || samples == 0)
+        return 1;
+
+    double *control = malloc(samples * sizeof *control);
+    double *gross   = malloc(samples * sizeof *gross);
+    if (!control || !gross)
+    {
+        free(gross);
+        free(control);
+        return 1;
+    }
+
+    StartClockServices();
+    double CyclesPerTick = CPUCyclesPerTick();
+
+    // Estimate the cost of reading the clock.
+    ClockValue ClockOverhead = ClockMax;
+    for (int i = 0; i < 100; ++i)
+    {
+        ClockValue t0 = ReadClock();
+        ClockValue t1 = ReadClock();
+        ClockValue d = SubtractClock(t1, t0);
+        if (ClockLessThan(d, ClockOverhead))
+            ClockOverhead = d;
+    }
+
+    double FrequencyBefore = MeasureCPUFrequency();
+
+    // Load cache with a single iteration of the routine.
+    MeasureGrossTime(routine, 1, data);
+
+    /*  Take the samples of 2 and of 2+<iterations> iterations in alternation,
+        rather than all of one and then all of the other as MeasureNetTime
+        does, so that a slow drift affects both alike.
+    */
+    unsigned int retries = 0;
+    for (unsigned int i = 0; i < samples; ++i)
+    {
+        control[i] = ClockToDouble(
+            MeasureUninterruptedTime(routine, 2, data, &retries));
+        gross[i] = ClockToDouble(
+            MeasureUninterruptedTime(routine, 2+iterations, data, &retries));
+    }
+
+    double FrequencyAfter = MeasureCPUFrequency();
+
+    qsort(control, samples, sizeof *control, CompareDoubles);
+    qsort(gross,   samples, sizeof *gross,   CompareDoubles);
+
+    /*  The overhead is the usual time of 2 iterations.  Subtracting it from
+        each sample of 2+<iterations> iterations gives a sample of the net time
+        of <iterations> iterations.  Since the overhead is a constant, the net
+        samples remain sorted.
+    */
+    double overhead = HalfSampleMode(control, samples);
+    double *net = gross;
+    for (unsigned int i = 0; i < samples; ++i)
+        net[i] -= overhead;
+
+    /*  Find the ranks that bound a 95% confidence interval for the median:
+        The number of samples below the true median is binomially distributed
+        with probability one half, and we approximate that distribution with a
+        normal one.  The interval depends only on the ordering of the samples,
+        not on any assumption about their distribution.
+    */
+    double spread = 1.96 * sqrt(samples) / 2;
+    long lower = floor(samples / 2. - spread) - 1;
+    long upper = ceil (samples / 2. + spread);
+    if (lower < 0)
+        lower = 0;
+    if (samples <= upper)
+        upper = samples - 1;
+
+    double scale = CyclesPerTick / iterations;
+
+    statistics->Iterations      = iterations;
+    statistics->Samples         = samples;
+    statistics->Retries         = retries;
+    statistics->Minimum         = (net[0] + overhead - control[0]) * scale;
+    statistics->Median          = Median(net, samples) * scale;
+    statistics->Mode            = HalfSampleMode(net, samples) * scale;
+    statistics->Lower           = net[lower] * scale;
+    statistics->Upper           = net[upper] * scale;
+    statistics->ControlCycles   = overhead * CyclesPerTick;
+    statistics->ClockOverhead   = ClockToDouble(ClockOverhead) * CyclesPerTick;
+    statistics->CyclesPerTick   = CyclesPerTick;
+    statistics->Frequency       = FrequencyAfter;
+
+    /*  Compare the frequencies before and after the samples with each other
+        and with the frequency at which the cycles per tick were computed.
+    */
+    double change = 0;
+    if (FrequencyBefore != 0 && FrequencyAfter != 0)
+    {
+        change = fabs(FrequencyAfter / FrequencyBefore - 1);
+        if (CalibrationFrequency != 0)
+            change = fmax(change, fmax(
+                fabs(FrequencyBefore / CalibrationFrequency - 1),
+                fabs(FrequencyAfter  / CalibrationFrequency - 1)));
+    }
+    statistics->FrequencyChange  = change;
+    statistics->FrequencyScaling = FrequencyTolerance < change;
+
+    free(gross);
+    free(control);
+
+    return 0;
+}
+
+
+// Write s to file as a JSON string.
+static void WriteJSONString(FILE *file, const char *s)
+{
+    putc('"', file);
+    for (; *s; ++s)
+        if (*s == '"' || *s == '\\')
+            fprintf(file, "\\%c", *s);
+        else if ((unsigned char) *s < 0x20)
+            fprintf(file, "\\u%04x", (unsigned char) *s);
+        else
+            putc(*s, file);
+    putc('"', file);
+}
+
+
+// See header file for description of this routine.
+void WriteClockServicesStatistics(
+        FILE *file,
+        const char *name,
+        double elements,
+        const ClockServicesStatistics *statistics
+    )
+{
+    const ClockServicesStatistics *s = statistics;
+    double e = 0 < elements ? elements : 1;
+
+    fprintf(file, "{\"name\": ");
+    WriteJSONString(file, name ? name : "");
+    fprintf(file, ", \"source\": ");
+    WriteJSONString(file, Environment.Source);
+    fprintf(file, ", \"cpu\": %d, \"real_time\": %s, \"governor\": ",
+        Environment.CPU, Environment.RealTime ? "true" : "false");
+    if (Environment.Governor[0])
+        WriteJSONString(file, Environment.Governor);
+    else
+        fprintf(file, "null");
+    fprintf(file,
+        ", \"iterations\": %u, \"samples\": %u, \"retries\": %u"
+        ", \"elements\": %.17g"
+        ", \"cycles_per_tick\": %.9g, \"frequency_hz\": %.6g"
+        ", \"frequency_change\": %.4g, \"frequency_scaling\": %s"
+        ", \"clock_overhead_cycles\": %.6g, \"control_cycles\": %.6g"
+        ", \"cycles_per_element\": {\"minimum\": %.6g, \"median\": %.6g"
+        ", \"mode\": %.6g, \"lower_95\": %.6g, \"upper_95\": %.6g}}\n",
+        s->Iterations, s->Samples, s->Retries,
+        e,
+        s->CyclesPerTick, s->Frequency,
+        s->FrequencyChange, s->FrequencyScaling ? "true" : "false",
+        s->ClockOverhead, s->ControlCycles,
+        s->Minimum / e, s->Median / e,
+        s->Mode / e, s->Lower / e, s->Upper / e);
+}
@@ -7,6 +7,11 @@ Abstract:
     that must be passed to MeasureNetTimeInCPUCyles and the other parameters
     to MeasureNetTimeInCPUCycles.
 
+    It also declares MeasureNetTimeStatistics, which measures a routine the
+    same way and describes the distribution of its samples, and
+    WriteClockServicesStatistics, which writes that description in a form
+    other programs can read.
+
 Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
 Apple Inc. ("Apple") in consideration of your agreement to the
 following terms, and your use, installation, modification or
@@ -54,6 +59,9 @@ Copyright (C) 2008 Apple Inc. All Rights Reserved.
 #define apple_com_Accelerate_ClockServices_h
 
 
+#include <stdio.h>  // Declare FILE.
+
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -142,6 +150,113 @@ double MeasureNetTimeInCPUCycles(
     );
 
 
+/*  Describe the distribution of the samples taken by MeasureNetTimeStatistics.
+    Times are in CPU cycles per iteration unless noted otherwise.
+*/
+typedef struct
+{
+    unsigned int Iterations;    // Iterations per sample.
+    unsigned int Samples;       // Samples taken.
+    unsigned int Retries;       // Samples taken again after context switches.
+
+    double Minimum;         // The value MeasureNetTimeInCPUCycles returns.
+    double Median;          // Median of the samples.
+    double Mode;            // Half-sample mode, the most typical sample.
+    double Lower, Upper;    // 95% confidence interval for the median.
+
+    double ControlCycles;   // Usual CPU cycles for 2 iterations, the overhead.
+    double ClockOverhead;   // CPU cycles to read the clock.
+    double CyclesPerTick;   // CPU cycles per tick of the clock.
+
+    double Frequency;       // CPU frequency in Hertz after sampling, or zero.
+    double FrequencyChange; // Largest relative change in CPU frequency seen.
+    int FrequencyScaling;   // Non-zero if the frequency changed more than 1%.
+} ClockServicesStatistics;
+
+
+/*  MeasureNetTimeStatistics.
+
+    This routine measures the net amount of time it takes to execute an
+    arbitrary routine, as MeasureNetTimeInCPUCycles does, and describes the
+    distribution of the samples rather than returning only their minimum.
+
+    The minimum is the best estimate of the time a routine takes when nothing
+    interferes, but it is the least reproducible statistic, since a single
+    lucky sample decides it.  The median and mode are reproducible from run to
+    run, and the confidence interval for the median shows how far to trust
+    them.  Samples interrupted by a context switch are taken again.
+
+    The CPU frequency is measured before and after sampling.  If it changes, as
+    it may when the system saves power or when one processor runs faster while
+    others are idle, FrequencyScaling is set, because times converted to CPU
+    cycles from a clock that does not count cycles are then wrong.
+
+    On Linux, the clock is chosen the first time a measurement is made:  CPU
+    cycles counted with perf_event_open if the system permits, else the
+    time-stamp counter on IA-32 or the virtual counter on ARM, else
+    clock_gettime.  Setting the environment variable CLOCK_SERVICES_SOURCE to
+    "perf", "tsc", "cntvct", or "monotonic" selects one.  The thread is bound
+    to the processor it is running on and given SCHED_FIFO priority, if the
+    system permits; run as root or with CAP_SYS_NICE for the least noise.
+
+    Input:
+
+        RoutineToBeTimedType routine.
+        unsigned int iterations.
+        void *data.
+        unsigned int samples.
+            As for MeasureNetTimeInCPUCycles.  At least 30 samples are
+            recommended for a meaningful confidence interval.
+
+        ClockServicesStatistics *statistics.
+            Address of an object to hold the results.
+
+    Output:
+
+        Return value.
+            Zero for success, non-zero if iterations or samples is zero or
+            memory could not be allocated.
+*/
+int MeasureNetTimeStatistics(
+        RoutineToBeTimedType routine,
+        unsigned int iterations,
+        void *data,
+        unsigned int samples,
+        ClockServicesStatistics *statistics
+    );
+
+
+/*  WriteClockServicesStatistics.
+
+    Write statistics to file as one line holding a JSON object, so a sequence
+    of calls writes a file of JSON lines.  The object also records the clock,
+    the processor the thread was bound to, whether it had real-time priority,
+    and the CPU frequency governor, so each line stands on its own.
+
+    Input:
+
+        FILE *file.
+            Stream to write to.
+
+        const char *name.
+            Name to identify the measurement.
+
+        double elements.
+            Number of elements the routine processes in one iteration.  Times
+            are divided by this and reported as CPU cycles per element.  Pass 1
+            for cycles per iteration.
+
+        const ClockServicesStatistics *statistics.
+            Results from MeasureNetTimeStatistics.
+*/
+void WriteClockServicesStatistics(
+        FILE *file,
+        const char *name,
+        double elements,
+        const ClockServicesStatistics *statistics
+    );
+
+
 #if defined(__cplusplus)
 }   // extern "C"
 #endif
@@ -6,6 +6,9 @@ Abstract:
     execution speed of the sample routine but is not otherwise needed to
     understand the lessons of the session.
 
+    Given the argument "-json", it writes one JSON object per case instead of
+    a table, for other programs to read.
+
 Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
 Apple Inc. ("Apple") in consideration of your agreement to the
 following terms, and your use, installation, modification or
@@ -49,8 +52,10 @@ Copyright (C) 2008 Apple Inc. All Rights Reserved.
 */
 
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ClockServices.h"
 #include "vAdd.h"
@@ -80,8 +85,11 @@ void Driver(unsigned int iterations, void *data)
 }
 
 
-int main(void)
+int main(int argc, char *argv[])
 {
+    // Write JSON objects instead of a table if requested.
+    bool JSON = 1 < argc && 0 == strcmp(argv[1], "-json");
+
     // Define test data.
     static const int N = 1024;
     int AllocationLength = N + ElementsPerVector - 1;
@@ -109,8 +117,13 @@ int main(void)
     }
 
     // Print table header.
-    printf("Offset in Bytes\n");
-    printf("   A    B    C    CPU Cycles Per Element\n");
+    if (!JSON)
+    {
+        printf("Offset in Bytes    CPU Cycles Per Element\n");
+        printf("   A    B    C     Minimum  Median  [95%% Bounds]     Mode\n");
+    }
+
+    bool FrequencyScaling = false;
 
     for (long AOffset = 0; AOffset < ElementsPerVector; ++AOffset)
     for (long BOffset = 0; BOffset < ElementsPerVector; ++BOffset)
@@ -120,13 +133,33 @@ int main(void)
         Parameters parameters = { A + AOffset, B + BOffset, C + COffset, N };
 
         // Measure the execution time of the subject routine.
-        double t = MeasureNetTimeInCPUCycles(Driver, 100, &parameters, 100);
-
-        printf("%4zd %4zd %4zd    %.3g\n",
-            AOffset * sizeof *A, BOffset * sizeof *B, COffset * sizeof *C,
-            t / N);
+        ClockServicesStatistics t;
+        if (MeasureNetTimeStatistics(Driver, 100, &parameters, 100, &t))
+        {
+            fprintf(stderr, "Error, failed to measure execution time.\n");
+            return EXIT_FAILURE;
+        }
+
+        if (JSON)
+        {
+            char name[64];
+            snprintf(name, sizeof name, "vAdd A+%zd B+%zd C+%zd",
+                AOffset * sizeof *A, BOffset * sizeof *B, COffset * sizeof *C);
+            WriteClockServicesStatistics(stdout, name, N, &t);
+        }
+        else
+            printf("%4zd %4zd %4zd    %7.3g %7.3g [%6.3g, %6.3g] %7.3g%s\n",
+                AOffset * sizeof *A, BOffset * sizeof *B, COffset * sizeof *C,
+                t.Minimum / N, t.Median / N, t.Lower / N, t.Upper / N,
+                t.Mode / N, t.FrequencyScaling ? " *" : "");
+
+        FrequencyScaling |= t.FrequencyScaling;
     }
 
+    if (!JSON && FrequencyScaling)
+        printf(
+"* The CPU frequency changed during this measurement, so it may be wrong.\n");
+
     free(C);
     free(B);
     free(A);
@@ -88,9 +88,10 @@ Copyright (C) 2008 Apple Inc. All Rights Reserved.
     instruction is a handy way to do some of the manipulations we need.
     <emmintrin.h> defines an intrinsic named _mm_shuffle_pd for the shufpd
     instruction.  However, its return type is __m128d (a vector containing two
-    doubles), so we must cast it to the vector type we are using.  Since we are
-    only moving data around and not interpreting the bits with arithmetic, this
-    is okay.
+    doubles), so we must cast it to the vector type we are using, and we cast
+    the parameters to __m128d, because newer versions of GCC no longer convert
+    them implicitly.  Since we are only moving data around and not interpreting
+    the bits with arithmetic, this is okay.
 
     The selector passed to shufpd is a two-bit field.  The first bit selects
     which eight bytes in the first parameter are taken (0 for the first eight
@@ -103,17 +104,18 @@ Copyright (C) 2008 Apple Inc. All Rights Reserved.
         #define shufpd(v0, v1, selector)    ((vFloat) \
             __builtin_ia32_shufpd((__m128d) (v0), (__m128d) (v1), (selector)))
 */
-#define shufpd(v0, v1, selector)    \
-    ((vFloat) _mm_shuffle_pd((v0), (v1), (selector)))
+#define shufpd(v0, v1, selector)    ((vFloat) \
+    _mm_shuffle_pd((__m128d) (v0), (__m128d) (v1), (selector)))
 
 
 /*  We need to move parts of vector registers around, and the pshufd
     instruction is a handy way to do some of the manipulations we need.
     <emmintrin.h> defines an intrinsic named _mm_shuffle_epi32 for the pshufd
     instruction.  However, its return type is __m128i (a vector containing
-    integers), so we must cast it to the vector type we are using.  Since we
-    are only moving data around and not interpreting the bits with arithmetic,
-    this is okay.
+    integers), so we must cast it to the vector type we are using, and we cast
+    the parameter to __m128i for the same reason as in shufpd.  Since we are
+    only moving data around and not interpreting the bits with arithmetic, this
+    is okay.
 
     The selector passed to pshufd is an eight-bit field.  Each pair selects
     four bytes from the first parameter (0 for the first four bytes, 1 for the
@@ -126,7 +128,8 @@ Copyright (C) 2008 Apple Inc. All Rights Reserved.
         #define pshufd(v0, selector)    ((vFloat) \
             __builtin_ia32_pshufd((__m128i) (v0), (selector)))
 */
-#define pshufd(v0, selector)    ((vFloat) _mm_shuffle_epi32((v0), (selector)))
+#define pshufd(v0, selector)    \
+    ((vFloat) _mm_shuffle_epi32((__m128i) (v0), (selector)))
 
 
 /*  vAddB00 implements vAdd given that each of A, B, and C is 0 modulo 16 and N
@@ -0,0 +1,390 @@
+ /*
+ 
+ File: ZipArchiveIndex.cpp
+ 
+ Abstract: ZipArchiveIndex is a portable C++ core for reading zip archives. It
+ memory-maps the archive, parses the central directory (including ZIP64
+ records) into a compact index sorted by path with a hash table for
+ constant-time lookup, and extracts entries on several threads.
+ 
+ Version: 1.1
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+ Apple Inc. ("Apple") in consideration of your agreement to the
+ following terms, and your use, installation, modification or
+ redistribution of this Apple software constitutes acceptance of these
+ terms.  If you do not agree with these terms, please do not use,
+ install, modify or redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. 
+ may be used to endorse or promote products derived from the Apple
+ Software without specific prior written permission from Apple.  Except
+ as expressly stated in this notice, no other rights or licenses, express
+ or implied, are granted by Apple herein, including but not limited to
+ any patent rights that may be infringed by your derivative works or by
+ other works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2008-2009 Apple Inc. All Rights Reserved.
+ 
+ */ 
+
+#include "ZipArchiveIndex.h"
+#include "ZipCRC32.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <new>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define DIRECTORY_END_LENGTH            22
+#define MAX_DIRECTORY_END_OFFSET        (DIRECTORY_END_LENGTH + 0xFFFF)
+#define ZIP64_DIRECTORY_LOCATOR_LENGTH  20
+#define ZIP64_DIRECTORY_END_LENGTH      56
+#define FILE_HEADER_LENGTH              30
+#define DIRECTORY_ENTRY_LENGTH          46
+
+#define DIRECTORY_END_TAG               0x06054b50
+#define ZIP64_DIRECTORY_END_TAG         0x06064b50
+#define ZIP64_DIRECTORY_LOCATOR_TAG     0x07064b50
+#define DIRECTORY_ENTRY_TAG             0x02014b50
+#define FILE_ENTRY_TAG                  0x04034b50
+#define ZIP64_EXTRA_FIELD_TAG           0x0001
+
+#define MAX_EXTRACT_THREADS             64
+#define MAX_DEFLATE_RATIO               1032    // deflate can't expand a byte into more than about this many
+
+namespace {
+
+// Archives are little endian whatever the host is; these compile to plain loads on little endian machines.
+inline uint16_t littleShort(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+inline uint32_t littleInt(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline uint64_t littleLong(const uint8_t *p) {
+    return (uint64_t)littleInt(p) | ((uint64_t)littleInt(p + 4) << 32);
+}
+
+// FNV-1a; paths are short, so a byte loop is as fast as anything fancier.
+inline uint32_t hashName(const uint8_t *name, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) hash = (hash ^ name[i]) * 16777619u;
+    return hash;
+}
+
+struct NameOrder {
+    const uint8_t *base;
+    bool operator()(const ZipArchiveIndex::Entry &a, const ZipArchiveIndex::Entry &b) const {
+        int result = memcmp(base + a.nameOffset, base + b.nameOffset, std::min(a.nameLength, b.nameLength));
+        return result < 0 || (result == 0 && a.nameLength < b.nameLength);
+    }
+};
+
+}
+
+ZipArchiveIndex::ZipArchiveIndex() : mFile(-1), mBase(NULL), mLength(0) {
+}
+
+ZipArchiveIndex::~ZipArchiveIndex() {
+    close();
+}
+
+void ZipArchiveIndex::close() {
+    if (mBase) munmap((void *)mBase, (size_t)mLength);
+    if (mFile >= 0) ::close(mFile);
+    mFile = -1;
+    mBase = NULL;
+    mLength = 0;
+    mEntries.clear();
+    mSlots.clear();
+}
+
+bool ZipArchiveIndex::fail(const char *message) {
+    mError = message;
+    close();
+    return false;
+}
+
+bool ZipArchiveIndex::open(const char *path) {
+    struct stat info;
+    uint64_t directoryStart, directorySize, count;
+
+    close();
+    mError.clear();
+    mFile = ::open(path, O_RDONLY);
+    if (mFile < 0) return fail("cannot open file");
+    if (fstat(mFile, &info) != 0 || info.st_size < DIRECTORY_END_LENGTH) return fail("file is too short to be a zip archive");
+    mLength = (uint64_t)info.st_size;
+    void *mapping = mmap(NULL, (size_t)mLength, PROT_READ, MAP_PRIVATE, mFile, 0);
+    if (mapping == MAP_FAILED) {
+        mLength = 0;
+        return fail("cannot map file");
+    }
+    mBase = (const uint8_t *)mapping;
+
+    if (!locateDirectory(&directoryStart, &directorySize, &count)) return false;
+    // The directory is read once from front to back
+    (void)madvise((void *)(mBase + (directoryStart & ~(uint64_t)4095)), (size_t)(directorySize + (directoryStart & 4095)), MADV_SEQUENTIAL);
+    if (!readDirectory(directoryStart, directorySize, count)) return false;
+
+    std::sort(mEntries.begin(), mEntries.end(), NameOrder { mBase });
+    buildHashTable();
+    return true;
+}
+
+bool ZipArchiveIndex::locateDirectory(uint64_t *directoryStart, uint64_t *directorySize, uint64_t *entryCount) {
+    // The end of directory record sits at the very end, possibly followed by a comment of up to 64K
+    uint64_t end = 0, i;
+    for (i = DIRECTORY_END_LENGTH; i <= MAX_DIRECTORY_END_OFFSET && i <= mLength; i++) {
+        const uint8_t *p = mBase + mLength - i;
+        if (littleInt(p) == DIRECTORY_END_TAG && littleShort(p + 20) <= i - DIRECTORY_END_LENGTH) {
+            end = mLength - i;
+            break;
+        }
+    }
+    if (i > MAX_DIRECTORY_END_OFFSET || i > mLength) return fail("no zip directory found");
+
+    const uint8_t *p = mBase + end;
+    *entryCount = littleShort(p + 10);
+    *directorySize = littleInt(p + 12);
+    *directoryStart = littleInt(p + 16);
+
+    // Saturated fields mean the real values are in the ZIP64 end of directory record, found through its locator
+    if (*entryCount == 0xFFFF || *directorySize == 0xFFFFFFFF || *directoryStart == 0xFFFFFFFF) {
+        if (end < ZIP64_DIRECTORY_LOCATOR_LENGTH || littleInt(mBase + end - ZIP64_DIRECTORY_LOCATOR_LENGTH) != ZIP64_DIRECTORY_LOCATOR_TAG) {
+            if (*directoryStart == 0xFFFFFFFF) return fail("missing ZIP64 directory locator");
+        } else {
+            uint64_t record = littleLong(mBase + end - ZIP64_DIRECTORY_LOCATOR_LENGTH + 8);
+            if (record > mLength - ZIP64_DIRECTORY_END_LENGTH || littleInt(mBase + record) != ZIP64_DIRECTORY_END_TAG) return fail("invalid ZIP64 directory record");
+            *entryCount = littleLong(mBase + record + 32);
+            *directorySize = littleLong(mBase + record + 40);
+            *directoryStart = littleLong(mBase + record + 48);
+        }
+    }
+    if (*directoryStart >= mLength || *directorySize > mLength - *directoryStart) return fail("zip directory lies outside the file");
+    if (*entryCount > *directorySize / DIRECTORY_ENTRY_LENGTH) return fail("zip directory is truncated");
+    return true;
+}
+
+bool ZipArchiveIndex::readDirectory(uint64_t directoryStart, uint64_t directorySize, uint64_t entryCount) {
+    const uint8_t *p = mBase + directoryStart, *directoryEnd = p + directorySize;
+
+    mEntries.reserve((size_t)entryCount);
+    for (uint64_t i = 0; i < entryCount; i++) {
+        if (directoryEnd - p < DIRECTORY_ENTRY_LENGTH || littleInt(p) != DIRECTORY_ENTRY_TAG) return fail("corrupt zip directory entry");
+        uint16_t namelen = littleShort(p + 28), extralen = littleShort(p + 30), commentlen = littleShort(p + 32);
+        const uint8_t *name = p + DIRECTORY_ENTRY_LENGTH, *extra = name + namelen, *next = extra + extralen + commentlen;
+        if (next > directoryEnd) return fail("corrupt zip directory entry");
+
+        Entry entry;
+        entry.flags = littleShort(p + 8);
+        entry.compressionType = littleShort(p + 10);
+        entry.CRC = littleInt(p + 16);
+        entry.compressedSize = littleInt(p + 20);
+        entry.uncompressedSize = littleInt(p + 24);
+        entry.headerOffset = littleInt(p + 42);
+        entry.nameOffset = (uint64_t)(name - mBase);
+        entry.nameLength = namelen;
+        entry.nameHash = hashName(name, namelen);
+
+        // The ZIP64 extra field holds, in this order, whichever of the sizes and offset were saturated
+        if (entry.uncompressedSize == 0xFFFFFFFF || entry.compressedSize == 0xFFFFFFFF || entry.headerOffset == 0xFFFFFFFF) {
+            for (const uint8_t *field = extra; field + 4 <= extra + extralen; ) {
+                uint16_t tag = littleShort(field), size = littleShort(field + 2);
+                const uint8_t *value = field + 4, *valueEnd = value + size;
+                if (valueEnd > extra + extralen) break;
+                if (tag == ZIP64_EXTRA_FIELD_TAG) {
+                    if (entry.uncompressedSize == 0xFFFFFFFF && value + 8 <= valueEnd) { entry.uncompressedSize = littleLong(value); value += 8; }
+                    if (entry.compressedSize == 0xFFFFFFFF && value + 8 <= valueEnd) { entry.compressedSize = littleLong(value); value += 8; }
+                    if (entry.headerOffset == 0xFFFFFFFF && value + 8 <= valueEnd) { entry.headerOffset = littleLong(value); value += 8; }
+                    break;
+                }
+                field = valueEnd;
+            }
+        }
+
+        // Sizes that couldn't come from this file would have extraction allocate whatever the archive claims
+        bool plausible = entry.compressedSize <= mLength && entry.uncompressedSize / MAX_DEFLATE_RATIO <= entry.compressedSize;
+
+        // Like the browser, skip nameless entries and ones whose header would lie inside the directory
+        if (namelen > 0 && entry.headerOffset < directoryStart && plausible) mEntries.push_back(entry);
+        p = next;
+    }
+    return true;
+}
+
+void ZipArchiveIndex::buildHashTable() {
+    size_t slotCount = 16;
+    while (slotCount < mEntries.size() * 2) slotCount <<= 1;
+    mSlots.assign(slotCount, 0);
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        size_t slot = mEntries[i].nameHash & (slotCount - 1);
+        while (mSlots[slot]) slot = (slot + 1) & (slotCount - 1);
+        mSlots[slot] = (uint32_t)(i + 1);
+    }
+}
+
+long ZipArchiveIndex::findEntry(const char *path, size_t length) const {
+    if (mSlots.empty()) return -1;
+    const size_t mask = mSlots.size() - 1;
+    const uint32_t hash = hashName((const uint8_t *)path, length);
+    for (size_t slot = hash & mask; mSlots[slot]; slot = (slot + 1) & mask) {
+        const Entry &entry = mEntries[mSlots[slot] - 1];
+        if (entry.nameHash == hash && entry.nameLength == length && memcmp(mBase + entry.nameOffset, path, length) == 0) return (long)(mSlots[slot] - 1);
+    }
+    return -1;
+}
+
+long ZipArchiveIndex::findEntry(const char *path) const {
+    return findEntry(path, strlen(path));
+}
+
+const uint8_t *ZipArchiveIndex::entryData(const Entry &entry) const {
+    // Same checks as the browser applies to the local file header before trusting it
+    uint64_t headeridx = entry.headerOffset;
+    if (headeridx >= mLength || mLength - headeridx < FILE_HEADER_LENGTH) return NULL;
+    const uint8_t *header = mBase + headeridx;
+    if (littleInt(header) != FILE_ENTRY_TAG || littleShort(header + 8) != entry.compressionType) return NULL;
+    uint64_t dataidx = headeridx + FILE_HEADER_LENGTH + littleShort(header + 26) + littleShort(header + 28);
+    if (dataidx > mLength || entry.compressedSize > mLength - dataidx) return NULL;
+    return mBase + dataidx;
+}
+
+bool ZipArchiveIndex::extractEntry(const Entry &entry, uint8_t *buffer) const {
+    const uint8_t *data = entryData(entry);
+    if (!data) return false;
+
+    if (entry.compressionType == 0) {
+        if (entry.compressedSize != entry.uncompressedSize) return false;
+        memcpy(buffer, data, (size_t)entry.uncompressedSize);
+    } else if (entry.compressionType == 8) {
+        // Inflate in pieces so that entries larger than zlib's 32 bit counters work too
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        if (inflateInit2(&stream, -15) != Z_OK) return false;
+        uint64_t inputLeft = entry.compressedSize, outputLeft = entry.uncompressedSize;
+        stream.next_in = (Bytef *)data;
+        stream.next_out = (Bytef *)buffer;
+        int result = Z_OK;
+        while (result == Z_OK) {
+            if (stream.avail_in == 0) {
+                stream.avail_in = (uInt)std::min<uint64_t>(inputLeft, 1u << 30);
+                inputLeft -= stream.avail_in;
+            }
+            if (stream.avail_out == 0) {
+                stream.avail_out = (uInt)std::min<uint64_t>(outputLeft, 1u << 30);
+                outputLeft -= stream.avail_out;
+            }
+            result = inflate(&stream, Z_NO_FLUSH);
+            if (result == Z_BUF_ERROR && stream.avail_in == 0 && inputLeft == 0) break;
+        }
+        bool complete = (result == Z_STREAM_END && stream.avail_out == 0 && outputLeft == 0);
+        inflateEnd(&stream);
+        if (!complete) return false;
+    } else {
+        return false;
+    }
+    return ZipCRC32(0, buffer, (size_t)entry.uncompressedSize) == entry.CRC;
+}
+
+namespace {
+
+struct ExtractJob {
+    const ZipArchiveIndex *archive;
+    const size_t *indices;
+    size_t count;
+    ZipArchiveIndex::ExtractHandler handler;
+    void *context;
+    volatile size_t next;
+    volatile size_t succeeded;
+};
+
+}
+
+void *ZipArchiveIndex::extractWorker(void *arg) {
+    ExtractJob *job = (ExtractJob *)arg;
+    const ZipArchiveIndex *archive = job->archive;
+    std::vector<uint8_t> buffer;
+    size_t item, succeeded = 0;
+
+    while ((item = __sync_fetch_and_add(&job->next, 1)) < job->count) {
+        size_t index = job->indices ? job->indices[item] : item;
+        const Entry &entry = archive->mEntries[index];
+        const uint8_t *result = NULL;
+
+        if (entry.compressionType == 0) {
+            // Stored entries need no copy; check them in place
+            const uint8_t *data = archive->entryData(entry);
+            if (data && entry.compressedSize == entry.uncompressedSize && ZipCRC32(0, data, (size_t)entry.uncompressedSize) == entry.CRC) result = data;
+        } else if (entry.compressionType == 8 && entry.uncompressedSize < SIZE_MAX) {
+            // One spare byte so that empty entries still have a buffer to point at
+            try {
+                if (buffer.size() < entry.uncompressedSize + 1) buffer.resize((size_t)entry.uncompressedSize + 1);
+                if (archive->extractEntry(entry, &buffer[0])) result = &buffer[0];
+            } catch (const std::bad_alloc &) {
+                std::vector<uint8_t>().swap(buffer);
+            }
+        }
+        if (result) succeeded++;
+        if (job->handler) job->handler(job->context, index, entry, result);
+    }
+    __sync_fetch_and_add(&job->succeeded, succeeded);
+    return NULL;
+}
+
+size_t ZipArchiveIndex::extractEntries(const size_t *indices, size_t count, unsigned threadCount, ExtractHandler handler, void *context) const {
+    ExtractJob job = { this, indices, indices ? count : mEntries.size(), handler, context, 0, 0 };
+    pthread_t threads[MAX_EXTRACT_THREADS];
+    unsigned started = 0;
+
+    if (indices) {
+        for (size_t i = 0; i < count; i++) if (indices[i] >= mEntries.size()) return 0;
+    }
+
+    if (threadCount == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cpus > 0 ? (unsigned)cpus : 1;
+    }
+    if (threadCount > MAX_EXTRACT_THREADS) threadCount = MAX_EXTRACT_THREADS;
+    if (threadCount > job.count) threadCount = (unsigned)std::max<size_t>(job.count, 1);
+
+    // The calling thread takes part in the extraction
+    for (unsigned i = 1; i < threadCount; i++) {
+        if (pthread_create(&threads[started], NULL, extractWorker, &job) == 0) started++;
+    }
+    extractWorker(&job);
+    for (unsigned i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    return job.succeeded;
+}
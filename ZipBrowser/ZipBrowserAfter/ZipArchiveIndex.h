@@ -0,0 +1,130 @@
+ /*
+ 
+ File: ZipArchiveIndex.h
+ 
+ Abstract: ZipArchiveIndex is a portable C++ core for reading zip archives. It
+ memory-maps the archive, parses the central directory (including ZIP64
+ records) into a compact index sorted by path with a hash table for
+ constant-time lookup, and extracts entries on several threads.
+ 
+ Version: 1.1
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+ Apple Inc. ("Apple") in consideration of your agreement to the
+ following terms, and your use, installation, modification or
+ redistribution of this Apple software constitutes acceptance of these
+ terms.  If you do not agree with these terms, please do not use,
+ install, modify or redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. 
+ may be used to endorse or promote products derived from the Apple
+ Software without specific prior written permission from Apple.  Except
+ as expressly stated in this notice, no other rights or licenses, express
+ or implied, are granted by Apple herein, including but not limited to
+ any patent rights that may be infringed by your derivative works or by
+ other works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2008-2009 Apple Inc. All Rights Reserved.
+ 
+ */ 
+
+#ifndef ZIPARCHIVEINDEX_H
+#define ZIPARCHIVEINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class ZipArchiveIndex {
+public:
+    // One central directory entry. Names are not copied; nameOffset points into the mapped archive.
+    struct Entry {
+        uint64_t headerOffset;
+        uint64_t compressedSize;
+        uint64_t uncompressedSize;
+        uint64_t nameOffset;
+        uint32_t CRC;
+        uint32_t nameHash;
+        uint16_t nameLength;
+        uint16_t compressionType;
+        uint16_t flags;
+    };
+
+    // Receives each extracted entry. data holds uncompressedSize bytes and is only valid during the call;
+    // it is NULL when the entry could not be extracted or failed its CRC check. Called concurrently.
+    typedef void (*ExtractHandler)(void *context, size_t index, const Entry &entry, const uint8_t *data);
+
+    ZipArchiveIndex();
+    ~ZipArchiveIndex();
+
+    // Maps the archive and builds the index. On failure returns false and errorString() says why. Entries whose
+    // sizes the file can't account for (more compressed data than the file holds, or more than deflate's
+    // maximum expansion of it) are left out.
+    bool open(const char *path);
+    void close();
+    const std::string &errorString() const { return mError; }
+
+    uint64_t fileLength() const { return mLength; }
+    size_t entryCount() const { return mEntries.size(); }
+
+    // Entries are sorted by path (bytewise).
+    const Entry &entryAtIndex(size_t index) const { return mEntries[index]; }
+    const char *nameOfEntry(const Entry &entry) const { return (const char *)mBase + entry.nameOffset; }
+
+    // Returns the index of the entry with exactly this path, or -1.
+    long findEntry(const char *path, size_t length) const;
+    long findEntry(const char *path) const;
+
+    // Decompresses an entry into buffer, which must hold entry.uncompressedSize bytes, and verifies its CRC.
+    bool extractEntry(const Entry &entry, uint8_t *buffer) const;
+
+    // Extracts the given entries (all of them if indices is NULL) on threadCount threads (0 uses every online CPU).
+    // Stored entries are handed to the handler straight from the mapping. Returns the number extracted successfully,
+    // or 0 without extracting anything if an index is out of range.
+    size_t extractEntries(const size_t *indices, size_t count, unsigned threadCount, ExtractHandler handler, void *context) const;
+
+private:
+    ZipArchiveIndex(const ZipArchiveIndex &);
+    ZipArchiveIndex &operator=(const ZipArchiveIndex &);
+
+    bool fail(const char *message);
+    bool locateDirectory(uint64_t *directoryStart, uint64_t *directorySize, uint64_t *entryCount);
+    bool readDirectory(uint64_t directoryStart, uint64_t directorySize, uint64_t entryCount);
+    void buildHashTable();
+    const uint8_t *entryData(const Entry &entry) const;
+
+    static void *extractWorker(void *arg);
+
+    int mFile;
+    const uint8_t *mBase;
+    uint64_t mLength;
+    std::vector<Entry> mEntries;
+    std::vector<uint32_t> mSlots;   // entry index + 1, 0 for empty; open addressing on nameHash
+    std::string mError;
+};
+
+#endif
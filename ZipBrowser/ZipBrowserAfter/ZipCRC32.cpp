@@ -0,0 +1,214 @@
+ /*
+ 
+ File: ZipCRC32.cpp
+ 
+ Abstract: ZipCRC32 computes the CRC-32 used by zip archives (the same polynomial
+ and conventions as zlib's crc32) with slicing-by-8 tables, PCLMULQDQ
+ folding on x86, or the CRC32 instructions on ARMv8 processors.
+ 
+ Version: 1.1
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+ Apple Inc. ("Apple") in consideration of your agreement to the
+ following terms, and your use, installation, modification or
+ redistribution of this Apple software constitutes acceptance of these
+ terms.  If you do not agree with these terms, please do not use,
+ install, modify or redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. 
+ may be used to endorse or promote products derived from the Apple
+ Software without specific prior written permission from Apple.  Except
+ as expressly stated in this notice, no other rights or licenses, express
+ or implied, are granted by Apple herein, including but not limited to
+ any patent rights that may be infringed by your derivative works or by
+ other works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2008-2009 Apple Inc. All Rights Reserved.
+ 
+ */ 
+
+#include "ZipCRC32.h"
+
+#include <string.h>
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#elif (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define ZIP_CRC32_PCLMUL 1
+#endif
+
+#define ZIP_CRC32_POLYNOMIAL 0xEDB88320u
+
+namespace {
+
+// table[0] is the classic byte-at-a-time table; table[k][b] is the CRC of byte b followed by k zero bytes,
+// which lets the main loop fold eight input bytes with eight independent lookups.
+struct Slicing8Tables {
+    uint32_t table[8][256];
+
+    Slicing8Tables() {
+        for (uint32_t b = 0; b < 256; b++) {
+            uint32_t crc = b;
+            for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (ZIP_CRC32_POLYNOMIAL & (0u - (crc & 1)));
+            table[0][b] = crc;
+        }
+        for (uint32_t b = 0; b < 256; b++) {
+            for (int k = 1; k < 8; k++) table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xFF];
+        }
+    }
+};
+
+const Slicing8Tables &tables() {
+    static const Slicing8Tables sTables;
+    return sTables;
+}
+
+inline uint32_t loadLittle32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+}
+
+uint32_t ZipCRC32Slicing8(uint32_t crc, const void *data, size_t length) {
+    const uint32_t (*t)[256] = tables().table;
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+    while (length > 0 && ((uintptr_t)p & 7) != 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+        length--;
+    }
+    while (length >= 8) {
+        uint32_t lo = loadLittle32(p) ^ crc, hi = loadLittle32(p + 4);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        p += 8;
+        length -= 8;
+    }
+    while (length-- > 0) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    return ~crc;
+}
+
+#if ZIP_CRC32_PCLMUL
+
+// Carry-less multiplication folding ("Fast CRC Computation for Generic Polynomials Using PCLMULQDQ", Intel 2009)
+// with the bit-reflected constants for the zip polynomial. Folds four 128 bit lanes across 64 byte blocks, then
+// reduces to 32 bits with a Barrett step. Takes and returns the inverted CRC register; length is a multiple of 16, at least 64.
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t foldPCLMUL(uint32_t crc, const uint8_t *buf, size_t length) {
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+    const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+    const __m128i low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(buf + 0x00)), _mm_cvtsi32_si128((int)crc));
+    x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+    buf += 64;
+    length -= 64;
+
+    x0 = k1k2;
+    while (length >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), x5), _mm_loadu_si128((const __m128i *)(buf + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x2, x0, 0x11), x6), _mm_loadu_si128((const __m128i *)(buf + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x3, x0, 0x11), x7), _mm_loadu_si128((const __m128i *)(buf + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x4, x0, 0x11), x8), _mm_loadu_si128((const __m128i *)(buf + 0x30)));
+        buf += 64;
+        length -= 64;
+    }
+
+    // Fold the four lanes into one, then any remaining 16 byte blocks
+    x0 = k3k4;
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), x4), x5);
+    while (length >= 16) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), _mm_loadu_si128((const __m128i *)buf)), x5);
+        buf += 16;
+        length -= 16;
+    }
+
+    // 128 -> 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, low32), k5k0, 0x00), x2);
+
+    // Barrett reduction to 32 bits
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, low32), poly, 0x10);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, low32), poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static bool hasPCLMUL() {
+    static const bool sHasPCLMUL = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+    return sHasPCLMUL;
+}
+
+#endif
+
+uint32_t ZipCRC32(uint32_t crc, const void *data, size_t length) {
+#if defined(__ARM_FEATURE_CRC32)
+    // ARMv8 CRC32X/W/H/B implement exactly the zip polynomial (the CRC32C variants are a different one)
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+    while (length > 0 && ((uintptr_t)p & 7) != 0) {
+        crc = __crc32b(crc, *p++);
+        length--;
+    }
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc = __crc32d(crc, word);
+        p += 8;
+        length -= 8;
+    }
+    while (length-- > 0) crc = __crc32b(crc, *p++);
+    return ~crc;
+#else
+#if ZIP_CRC32_PCLMUL
+    // Folding has a fixed setup cost, so short buffers stay with the tables
+    if (length >= 256 && hasPCLMUL()) {
+        size_t folded = length & ~(size_t)15;
+        crc = ~foldPCLMUL(~crc, (const uint8_t *)data, folded);
+        return ZipCRC32Slicing8(crc, (const uint8_t *)data + folded, length - folded);
+    }
+#endif
+    return ZipCRC32Slicing8(crc, data, length);
+#endif
+}
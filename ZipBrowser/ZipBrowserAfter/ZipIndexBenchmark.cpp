@@ -0,0 +1,249 @@
+ /*
+ 
+ File: ZipIndexBenchmark.cpp
+ 
+ Abstract: Command line benchmark for ZipArchiveIndex: measures the time to open
+ and index an archive, path lookups, parallel extraction throughput and
+ the CRC-32 kernels.
+ 
+ Version: 1.1
+ 
+ Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+ Apple Inc. ("Apple") in consideration of your agreement to the
+ following terms, and your use, installation, modification or
+ redistribution of this Apple software constitutes acceptance of these
+ terms.  If you do not agree with these terms, please do not use,
+ install, modify or redistribute this Apple software.
+ 
+ In consideration of your agreement to abide by the following terms, and
+ subject to these terms, Apple grants you a personal, non-exclusive
+ license, under Apple's copyrights in this original Apple software (the
+ "Apple Software"), to use, reproduce, modify and redistribute the Apple
+ Software, with or without modifications, in source and/or binary forms;
+ provided that if you redistribute the Apple Software in its entirety and
+ without modifications, you must retain this notice and the following
+ text and disclaimers in all such redistributions of the Apple Software. 
+ Neither the name, trademarks, service marks or logos of Apple Inc. 
+ may be used to endorse or promote products derived from the Apple
+ Software without specific prior written permission from Apple.  Except
+ as expressly stated in this notice, no other rights or licenses, express
+ or implied, are granted by Apple herein, including but not limited to
+ any patent rights that may be infringed by your derivative works or by
+ other works in which the Apple Software may be incorporated.
+ 
+ The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+ MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+ THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+ OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+ 
+ IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+ OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+ MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+ AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+ STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ 
+ Copyright (C) 2008-2009 Apple Inc. All Rights Reserved.
+ 
+ */ 
+
+// Build and run on any POSIX system with zlib:
+//
+//  c++ -O3 -std=c++11 ZipCRC32.cpp ZipArchiveIndex.cpp ZipIndexBenchmark.cpp -lz -lpthread -o ZipIndexBenchmark
+//  ./ZipIndexBenchmark [-n entries] [-s entryBytes] [-o scratch.zip] [archive.zip]
+//
+// Without an archive argument a synthetic one is written first (half stored, half deflated, with ZIP64
+// end records once there are more than 65535 entries) so that the directory parser is exercised at scale.
+
+#include "ZipArchiveIndex.h"
+#include "ZipCRC32.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <string>
+#include <vector>
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void putShort(std::vector<uint8_t> &out, uint16_t v) {
+    out.push_back(v & 0xFF); out.push_back(v >> 8);
+}
+
+static void putInt(std::vector<uint8_t> &out, uint32_t v) {
+    putShort(out, v & 0xFFFF); putShort(out, v >> 16);
+}
+
+static void putLong(std::vector<uint8_t> &out, uint64_t v) {
+    putInt(out, (uint32_t)v); putInt(out, (uint32_t)(v >> 32));
+}
+
+static std::string entryName(size_t i) {
+    char name[64];
+    snprintf(name, sizeof(name), "dir%04zu/sub%02zu/file%08zu.txt", i / 1000, i % 37, i);
+    return name;
+}
+
+static bool writeSyntheticArchive(const char *path, size_t entryCount, size_t entryBytes) {
+    FILE *file = fopen(path, "wb");
+    if (!file) return false;
+    std::vector<uint8_t> directory, header, content(entryBytes), packed(compressBound((uLong)entryBytes) + 64);
+    uint64_t offset = 0;
+    uint32_t seed = 12345;
+
+    for (size_t i = 0; i < entryCount; i++) {
+        std::string name = entryName(i);
+        // Text-like content: compressible but not trivially so
+        for (size_t j = 0; j < entryBytes; j++) {
+            seed = seed * 1103515245u + 12345u;
+            content[j] = "etaoin shrdlu\n"[(seed >> 16) % 14];
+        }
+        uint32_t crc = (uint32_t)crc32(0, &content[0], (uInt)entryBytes);
+        uint16_t method = (i & 1) ? 8 : 0;
+        const uint8_t *data = &content[0];
+        size_t dataLength = entryBytes;
+        if (method == 8) {
+            z_stream stream;
+            memset(&stream, 0, sizeof(stream));
+            deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+            stream.next_in = &content[0];
+            stream.avail_in = (uInt)entryBytes;
+            stream.next_out = &packed[0];
+            stream.avail_out = (uInt)packed.size();
+            deflate(&stream, Z_FINISH);
+            dataLength = stream.total_out;
+            deflateEnd(&stream);
+            data = &packed[0];
+        }
+
+        header.clear();
+        putInt(header, 0x04034b50); putShort(header, 20); putShort(header, 0); putShort(header, method);
+        putShort(header, 0); putShort(header, 0); putInt(header, crc);
+        putInt(header, (uint32_t)dataLength); putInt(header, (uint32_t)entryBytes);
+        putShort(header, (uint16_t)name.size()); putShort(header, 0);
+        header.insert(header.end(), name.begin(), name.end());
+        fwrite(&header[0], 1, header.size(), file);
+        fwrite(data, 1, dataLength, file);
+
+        bool bigOffset = offset >= 0xFFFFFFFFu;
+        putInt(directory, 0x02014b50); putShort(directory, 45); putShort(directory, 45); putShort(directory, 0);
+        putShort(directory, method); putShort(directory, 0); putShort(directory, 0); putInt(directory, crc);
+        putInt(directory, (uint32_t)dataLength); putInt(directory, (uint32_t)entryBytes);
+        putShort(directory, (uint16_t)name.size()); putShort(directory, bigOffset ? 12 : 0); putShort(directory, 0);
+        putShort(directory, 0); putShort(directory, 0); putInt(directory, 0);
+        putInt(directory, bigOffset ? 0xFFFFFFFFu : (uint32_t)offset);
+        directory.insert(directory.end(), name.begin(), name.end());
+        if (bigOffset) {
+            putShort(directory, 0x0001); putShort(directory, 8); putLong(directory, offset);
+        }
+        offset += header.size() + dataLength;
+    }
+
+    std::vector<uint8_t> end;
+    bool zip64 = entryCount > 0xFFFF || offset > 0xFFFFFFFFu || directory.size() > 0xFFFFFFFFu;
+    if (zip64) {
+        uint64_t record = offset + directory.size();
+        putInt(end, 0x06064b50); putLong(end, 44); putShort(end, 45); putShort(end, 45); putInt(end, 0); putInt(end, 0);
+        putLong(end, entryCount); putLong(end, entryCount); putLong(end, directory.size()); putLong(end, offset);
+        putInt(end, 0x07064b50); putInt(end, 0); putLong(end, record); putInt(end, 1);
+    }
+    putInt(end, 0x06054b50); putShort(end, 0); putShort(end, 0);
+    putShort(end, zip64 ? 0xFFFF : (uint16_t)entryCount); putShort(end, zip64 ? 0xFFFF : (uint16_t)entryCount);
+    putInt(end, zip64 ? 0xFFFFFFFFu : (uint32_t)directory.size()); putInt(end, zip64 ? 0xFFFFFFFFu : (uint32_t)offset);
+    putShort(end, 0);
+    fwrite(&directory[0], 1, directory.size(), file);
+    fwrite(&end[0], 1, end.size(), file);
+    return fclose(file) == 0;
+}
+
+struct ExtractTotals {
+    volatile uint64_t bytes;
+};
+
+static void countExtracted(void *context, size_t, const ZipArchiveIndex::Entry &entry, const uint8_t *data) {
+    if (data) __sync_fetch_and_add(&((ExtractTotals *)context)->bytes, entry.uncompressedSize);
+}
+
+int main(int argc, char *argv[]) {
+    size_t entryCount = 200000, entryBytes = 1024;
+    const char *scratch = "/tmp/ZipIndexBenchmark.zip", *archivePath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) entryCount = strtoull(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc) entryBytes = strtoull(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc) scratch = argv[++i];
+        else archivePath = argv[i];
+    }
+
+    if (!archivePath) {
+        double start = now();
+        if (!writeSyntheticArchive(scratch, entryCount, entryBytes)) {
+            fprintf(stderr, "cannot write %s\n", scratch);
+            return 1;
+        }
+        printf("wrote %zu entries of %zu bytes to %s in %.2f s\n", entryCount, entryBytes, scratch, now() - start);
+        archivePath = scratch;
+    }
+
+    ZipArchiveIndex archive;
+    double start = now();
+    if (!archive.open(archivePath)) {
+        fprintf(stderr, "%s: %s\n", archivePath, archive.errorString().c_str());
+        return 1;
+    }
+    double elapsed = now() - start;
+    printf("open: %zu entries, %.1f MB, indexed in %.1f ms (%.2f M entries/s)\n", archive.entryCount(), archive.fileLength() / 1e6, elapsed * 1e3, archive.entryCount() / elapsed / 1e6);
+
+    // Lookups of existing paths in random order
+    const size_t lookups = 1000000;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < 4096 && archive.entryCount() > 0; i++) {
+        const ZipArchiveIndex::Entry &entry = archive.entryAtIndex((i * 2654435761u) % archive.entryCount());
+        names.push_back(std::string(archive.nameOfEntry(entry), entry.nameLength));
+    }
+    size_t found = 0;
+    start = now();
+    for (size_t i = 0; i < lookups && !names.empty(); i++) {
+        const std::string &name = names[i % names.size()];
+        found += archive.findEntry(name.data(), name.size()) >= 0;
+    }
+    elapsed = now() - start;
+    printf("lookup: %zu of %zu found, %.1f ns per lookup\n", found, lookups, elapsed * 1e9 / lookups);
+
+    // Extraction of every entry with increasing thread counts
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (unsigned threads = 1; threads <= (unsigned)(cpus > 0 ? cpus : 1); threads *= 2) {
+        ExtractTotals totals = { 0 };
+        start = now();
+        size_t succeeded = archive.extractEntries(NULL, 0, threads, countExtracted, &totals);
+        elapsed = now() - start;
+        printf("extract: %u thread%s, %zu/%zu entries, %.1f MB/s, %.0f entries/s\n", threads, threads == 1 ? "" : "s", succeeded, archive.entryCount(), totals.bytes / 1e6 / elapsed, succeeded / elapsed);
+    }
+
+    // CRC kernels on a 64 MB buffer
+    std::vector<uint8_t> buffer(64 << 20);
+    for (size_t i = 0; i < buffer.size(); i++) buffer[i] = (uint8_t)(i * 131 + (i >> 9));
+    start = now();
+    uint32_t reference = (uint32_t)crc32(0, &buffer[0], (uInt)buffer.size());
+    double zlibTime = now() - start;
+    start = now();
+    uint32_t slicing = ZipCRC32Slicing8(0, &buffer[0], buffer.size());
+    double slicingTime = now() - start;
+    start = now();
+    uint32_t best = ZipCRC32(0, &buffer[0], buffer.size());
+    double bestTime = now() - start;
+    printf("crc32: zlib %.2f GB/s, slicing-by-8 %.2f GB/s, ZipCRC32 %.2f GB/s, %s\n", buffer.size() / zlibTime / 1e9, buffer.size() / slicingTime / 1e9, buffer.size() / bestTime / 1e9,
+           (reference == slicing && reference == best) ? "results match" : "RESULTS DIFFER");
+
+    if (archivePath == scratch) unlink(scratch);
+    return (reference == slicing && reference == best) ? 0 : 1;
+}
@@ -101,9 +101,7 @@ void draw_angle_style_front_cap (int ncp,	/* number of contour points */
    N3F(bi);
 
    tobj = gluNewTess ();
-   gluTessCallback (tobj, GLU_BEGIN, glBegin);
-   gluTessCallback (tobj, GLU_VERTEX, glVertex3dv);
-   gluTessCallback (tobj, GLU_END, glEnd);
+   TESS_CALLBACKS (tobj);
    gluBeginPolygon (tobj);
 
    for (j=0; j<ncp; j++) {
@@ -146,9 +144,7 @@ void draw_angle_style_back_cap (int ncp,	/* number of contour points */
    N3F (bi);
 
    tobj = gluNewTess ();
-   gluTessCallback (tobj, GLU_BEGIN, glBegin);
-   gluTessCallback (tobj, GLU_VERTEX, glVertex3dv);
-   gluTessCallback (tobj, GLU_END, glEnd);
+   TESS_CALLBACKS (tobj);
    gluBeginPolygon (tobj);
 
    for (j=ncp-1; j>=0; j--) {
@@ -391,17 +387,18 @@ void extrusion_angle_join (int ncp,		/* number of contour points */
       /* v^v^v^v^v^v^v^v^v  BEGIN END CAPS v^v^v^v^v^v^v^v^v^v^v^v */
 
       /* if end caps are required, draw them. But don't draw any 
-       * but the very first and last caps */
-      if (__TUBE_DRAW_CAP) {
-         if (first_time) {
+       * but the very first and last caps (a piece of a split path
+       * may have neither) */
+      if (first_time) {
+         first_time = FALSE;
+         if (__TUBE_DRAW_FRONT_CAP) {
             if (color_array != NULL) C3F (color_array[inext-1]);
-            first_time = FALSE;
             draw_angle_style_front_cap (ncp, bisector_0, (gleVector *) front_loop);
          }
-         if (inext == npoints-2) {
-            if (color_array != NULL) C3F (color_array[inext]);
-            draw_angle_style_back_cap (ncp, bisector_1, (gleVector *) back_loop);
-         }
+      }
+      if ((inext == npoints-2) && __TUBE_DRAW_BACK_CAP) {
+         if (color_array != NULL) C3F (color_array[inext]);
+         draw_angle_style_back_cap (ncp, bisector_1, (gleVector *) back_loop);
       }
       /* v^v^v^v^v^v^v^v^v  END END CAPS v^v^v^v^v^v^v^v^v^v^v^v */
 
@@ -110,9 +110,7 @@ static void draw_cut_style_cap_callback (int iloop,
 #ifdef OPENGL_10
    GLUtriangulatorObj *tobj;
    tobj = gluNewTess ();
-   gluTessCallback (tobj, GLU_BEGIN, glBegin);
-   gluTessCallback (tobj, GLU_VERTEX, glVertex3dv);
-   gluTessCallback (tobj, GLU_END, glEnd);
+   TESS_CALLBACKS (tobj);
 #endif /* OPENGL_10 */
 
    if (face_color != NULL) C3F (face_color);
@@ -52,6 +52,10 @@ void up_sanity_check (gleDouble up[3],	/* up vector for contour */
    double len;
    double diff[3];
 
+   /* a piece of a split path is handed the up vector that the whole
+    * path would have at that point; leave it exactly as it is */
+   if (_gle_gc -> split_piece) return;
+
    /* now, right off the bat, we should make sure that the up vector 
     * is in fact perpendicular to the polyline direction */
    VEC_DIFF (diff, point_array[1], point_array[0]);
@@ -137,9 +141,7 @@ void draw_raw_style_end_cap (int ncp,		/* number of contour points */
    /* malloc the @#$%^&* array that OpenGL wants ! */
    pts = (double *) malloc (3*ncp*sizeof(double));
    tobj = gluNewTess ();
-   gluTessCallback (tobj, GLU_BEGIN, glBegin);
-   gluTessCallback (tobj, GLU_VERTEX, glVertex3dv);
-   gluTessCallback (tobj, GLU_END, glEnd);
+   TESS_CALLBACKS (tobj);
    gluBeginPolygon (tobj);
 
       /* draw the loop counter clockwise for the front cap */
@@ -195,9 +197,7 @@ void draw_front_contour_cap (int ncp,	/* number of contour points */
 
 #ifdef OPENGL_10
    tobj = gluNewTess ();
-   gluTessCallback (tobj, GLU_BEGIN, glBegin);
-   gluTessCallback (tobj, GLU_VERTEX, glVertex3dv);
-   gluTessCallback (tobj, GLU_END, glEnd);
+   TESS_CALLBACKS (tobj);
    gluBeginPolygon (tobj);
 
    for (j=0; j<ncp; j++) {
@@ -239,9 +239,7 @@ void draw_back_contour_cap (int ncp,	/* number of contour points */
 
 #ifdef OPENGL_10
    tobj = gluNewTess ();
-   gluTessCallback (tobj, GLU_BEGIN, glBegin);
-   gluTessCallback (tobj, GLU_VERTEX, glVertex3dv);
-   gluTessCallback (tobj, GLU_END, glEnd);
+   TESS_CALLBACKS (tobj);
    gluBeginPolygon (tobj);
 
    /* draw the end cap */
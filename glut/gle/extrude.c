@@ -55,8 +55,15 @@ void gleSuperExtrusion (int ncp,               /* number of contour points */
                 gleDouble point_array[][3],        /* polyline */
                 float color_array[][3],        /* color of polyline */
                 gleDouble xform_array[][2][3])   /* 2D contour xforms */
-{   
+{
    INIT_GC();
+
+   /* when building a mesh, long paths are done in pieces, in parallel */
+   if (_gle_gc -> mesh &&
+       _gle_mesh_split_extrusion (ncp, contour, cont_normal, up,
+                                  npoints, point_array, color_array,
+                                  xform_array)) return;
+
    _gle_gc -> ncp = ncp;
    _gle_gc -> contour = contour;
    _gle_gc -> cont_normal = cont_normal;
@@ -0,0 +1,780 @@
+/*
+ * MODULE: mesh.c
+ *
+ * FUNCTION:
+ * Retained mode for the extrusion library.  Between gleBeginMesh() and
+ * gleEndMesh() the drawing macros of port.h land here instead of in
+ * OpenGL.  The matrix stack, current normal, texture coordinate and
+ * color are emulated, triangle strips, fans and polygons are broken
+ * into triangles, and identical vertices are merged, so that rings
+ * shared by neighbouring segments are stored once.  The result is an
+ * indexed triangle list that can be drawn from a buffer any number of
+ * times without redoing the joins.
+ *
+ * Long raw or angle style extrusions are cut into pieces which are
+ * generated by separate threads, each with its own copy of the
+ * context, and merged in order afterwards.
+ *
+ * HISTORY:
+ * Added retained mode meshes, October 2026
+ */
+#ifdef __APPLE__
+#include "gle_osx.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <tube.h>
+#include "port.h"
+#include "vvector.h"
+#include "tube_gc.h"
+#include "extrude.h"
+#include "intersect.h"
+
+/* ============================================================ */
+
+#define MESH_STACK_DEPTH	8
+#define MESH_MAX_THREADS	64
+#define MESH_MIN_SEGMENTS	8	/* fewest segments worth a thread */
+
+struct _gleMeshBuilder {
+
+   /* vertex layout: position, then the optional attributes */
+   int stride;
+   int normal_offset;		/* -1 if not stored */
+   int texcoord_offset;
+   int color_offset;
+
+   /* merged vertices and the triangle list */
+   float *verts;
+   int num_verts;
+   int max_verts;
+   unsigned int *indices;
+   int num_indices;
+   int max_indices;
+   int out_of_memory;
+
+   /* open addressing hash of the vertices, for merging */
+   int *hash;
+   int hash_size;
+
+   /* emulated OpenGL state */
+   double stack[MESH_STACK_DEPTH][4][4];
+   int depth;
+   double nmat[3][3];		/* inverse transpose of the top */
+   double normal[3];
+   double texcoord[2];
+   float color[3];
+
+   /* primitive assembly */
+   GLenum mode;
+   int count;
+   unsigned int first;
+   unsigned int prev[2];
+
+   /* pieces of a split extrusion are never split again */
+   int nested;
+};
+
+static int __gleThreads = 0;
+
+/* ============================================================ */
+
+int gleGetNumThreads (void)
+{
+   return __gleThreads;
+}
+
+void gleSetNumThreads (int threads)
+{
+   if (threads < 0) threads = 0;
+   __gleThreads = threads;
+}
+
+static int num_threads (void)
+{
+   long n = __gleThreads;
+   if (n <= 0) n = sysconf (_SC_NPROCESSORS_ONLN);
+   if (n < 1) n = 1;
+   if (n > MESH_MAX_THREADS) n = MESH_MAX_THREADS;
+   return (int) n;
+}
+
+/* ============================================================ */
+
+static void update_normal_matrix (gleMeshBuilder *b)
+{
+   double (*m)[4] = b->stack[b->depth];
+   double a0[3], a1[3], a2[3];
+   double det;
+   int i;
+
+   /* the inverse transpose of the upper 3x3 has the cross products
+    * of its columns as columns */
+   for (i=0; i<3; i++) {
+      a0[i] = m[0][i];
+      a1[i] = m[1][i];
+      a2[i] = m[2][i];
+   }
+   VEC_CROSS_PRODUCT (b->nmat[0], a1, a2);
+   VEC_CROSS_PRODUCT (b->nmat[1], a2, a0);
+   VEC_CROSS_PRODUCT (b->nmat[2], a0, a1);
+   VEC_DOT_PRODUCT (det, a0, b->nmat[0]);
+
+   if (det == 0.0) return;
+   det = 1.0 / det;
+   for (i=0; i<3; i++) {
+      VEC_SCALE (b->nmat[i], det, b->nmat[i]);
+   }
+}
+
+static gleMeshBuilder * builder_create (int normals, int texcoords, int colors)
+{
+   gleMeshBuilder *b = (gleMeshBuilder *) calloc (1, sizeof (gleMeshBuilder));
+   if (b == NULL) return NULL;
+
+   b->stride = 3;
+   b->normal_offset = b->texcoord_offset = b->color_offset = -1;
+   if (normals) { b->normal_offset = b->stride; b->stride += 3; }
+   if (texcoords) { b->texcoord_offset = b->stride; b->stride += 2; }
+   if (colors) { b->color_offset = b->stride; b->stride += 3; }
+
+   b->stack[0][0][0] = b->stack[0][1][1] = 1.0;
+   b->stack[0][2][2] = b->stack[0][3][3] = 1.0;
+   update_normal_matrix (b);
+
+   b->normal[2] = 1.0;
+   b->color[0] = b->color[1] = b->color[2] = 1.0f;
+   return b;
+}
+
+static void builder_free (gleMeshBuilder *b)
+{
+   if (b == NULL) return;
+   free (b->verts);
+   free (b->indices);
+   free (b->hash);
+   free (b);
+}
+
+static int builder_reserve (void **data, int *max, int need, size_t size)
+{
+   int n;
+   void *p;
+
+   if (need <= *max) return TRUE;
+   n = (*max < 256) ? 256 : *max;
+   while (n < need) n *= 2;
+   p = realloc (*data, n * size);
+   if (p == NULL) return FALSE;
+   *data = p;
+   *max = n;
+   return TRUE;
+}
+
+/* ============================================================ */
+
+static unsigned int hash_vertex (const float *v, int n)
+{
+   unsigned int h = 2166136261u;
+   unsigned int w;
+   int i;
+
+   for (i=0; i<n; i++) {
+      memcpy (&w, &v[i], sizeof (w));
+      h = (h ^ w) * 16777619u;
+   }
+   return h;
+}
+
+static int rehash (gleMeshBuilder *b, int size)
+{
+   int *hash = (int *) malloc (size * sizeof (int));
+   int i, k;
+
+   if (hash == NULL) return FALSE;
+   for (i=0; i<size; i++) hash[i] = -1;
+
+   for (i=0; i<b->num_verts; i++) {
+      k = hash_vertex (&b->verts[i*b->stride], b->stride) & (size-1);
+      while (hash[k] >= 0) k = (k+1) & (size-1);
+      hash[k] = i;
+   }
+
+   free (b->hash);
+   b->hash = hash;
+   b->hash_size = size;
+   return TRUE;
+}
+
+/* returns the index of the vertex, adding it if it is new */
+static int add_vertex (gleMeshBuilder *b, const float *v)
+{
+   int k, n;
+
+   if (2 * (b->num_verts+1) > b->hash_size) {
+      if (!rehash (b, b->hash_size ? 2 * b->hash_size : 1024)) {
+         b->out_of_memory = TRUE;
+         return -1;
+      }
+   }
+
+   k = hash_vertex (v, b->stride) & (b->hash_size-1);
+   while ((n = b->hash[k]) >= 0) {
+      if (!memcmp (&b->verts[n*b->stride], v, b->stride * sizeof (float))) {
+         return n;
+      }
+      k = (k+1) & (b->hash_size-1);
+   }
+
+   if (!builder_reserve ((void **) &b->verts, &b->max_verts,
+                         (b->num_verts+1) * b->stride, sizeof (float))) {
+      b->out_of_memory = TRUE;
+      return -1;
+   }
+   n = b->num_verts++;
+   memcpy (&b->verts[n*b->stride], v, b->stride * sizeof (float));
+   b->hash[k] = n;
+   return n;
+}
+
+static void add_triangle (gleMeshBuilder *b,
+                          unsigned int i0, unsigned int i1, unsigned int i2)
+{
+   /* zero area, nothing would be drawn */
+   if ((i0 == i1) || (i1 == i2) || (i2 == i0)) return;
+
+   if (!builder_reserve ((void **) &b->indices, &b->max_indices,
+                         b->num_indices + 3, sizeof (unsigned int))) {
+      b->out_of_memory = TRUE;
+      return;
+   }
+   b->indices[b->num_indices++] = i0;
+   b->indices[b->num_indices++] = i1;
+   b->indices[b->num_indices++] = i2;
+}
+
+/* ============================================================ */
+/* the drawing macros only get here when the context has a mesh */
+
+void _gle_mesh_begin (GLenum mode)
+{
+   gleMeshBuilder *b = _gle_gc -> mesh;
+   b->mode = mode;
+   b->count = 0;
+}
+
+void _gle_mesh_end (void)
+{
+   gleMeshBuilder *b = _gle_gc -> mesh;
+   b->count = 0;
+}
+
+void _gle_mesh_vertex3dv (const GLdouble *p)
+{
+   gleMeshBuilder *b = _gle_gc -> mesh;
+   double (*m)[4] = b->stack[b->depth];
+   float v[3+3+2+3];
+   int i, n;
+
+   /* +0.0f so that -0.0 and 0.0 merge */
+   for (i=0; i<3; i++) {
+      v[i] = (float) (m[0][i]*p[0] + m[1][i]*p[1] + m[2][i]*p[2] + m[3][i]) + 0.0f;
+   }
+   if (b->normal_offset >= 0) {
+      for (i=0; i<3; i++) {
+         v[b->normal_offset+i] = (float) (b->nmat[0][i]*b->normal[0] +
+                                          b->nmat[1][i]*b->normal[1] +
+                                          b->nmat[2][i]*b->normal[2]) + 0.0f;
+      }
+   }
+   if (b->texcoord_offset >= 0) {
+      v[b->texcoord_offset] = (float) b->texcoord[0] + 0.0f;
+      v[b->texcoord_offset+1] = (float) b->texcoord[1] + 0.0f;
+   }
+   if (b->color_offset >= 0) {
+      for (i=0; i<3; i++) v[b->color_offset+i] = b->color[i];
+   }
+
+   n = add_vertex (b, v);
+   if (n < 0) return;
+
+   switch (b->mode) {
+      case GL_TRIANGLE_STRIP:
+         /* every other triangle of a strip is wound the other way */
+         if (b->count >= 2) {
+            if (b->count & 1) {
+               add_triangle (b, b->prev[1], b->prev[0], n);
+            } else {
+               add_triangle (b, b->prev[0], b->prev[1], n);
+            }
+         }
+         b->prev[0] = b->prev[1];
+         b->prev[1] = n;
+         break;
+
+      case GL_TRIANGLE_FAN:
+      case GL_POLYGON:
+         if (b->count == 0) {
+            b->first = n;
+         } else if (b->count >= 2) {
+            add_triangle (b, b->first, b->prev[1], n);
+         }
+         b->prev[1] = n;
+         break;
+
+      case GL_TRIANGLES:
+         if ((b->count % 3) == 2) {
+            add_triangle (b, b->prev[0], b->prev[1], n);
+         }
+         b->prev[0] = b->prev[1];
+         b->prev[1] = n;
+         break;
+
+      default:
+         break;
+   }
+   b->count ++;
+}
+
+void _gle_mesh_vertex3fv (const GLfloat *p)
+{
+   GLdouble d[3];
+   d[0] = p[0]; d[1] = p[1]; d[2] = p[2];
+   _gle_mesh_vertex3dv (d);
+}
+
+void _gle_mesh_normal3dv (const GLdouble *n)
+{
+   gleMeshBuilder *b = _gle_gc -> mesh;
+   VEC_COPY (b->normal, n);
+}
+
+void _gle_mesh_normal3fv (const GLfloat *n)
+{
+   gleMeshBuilder *b = _gle_gc -> mesh;
+   VEC_COPY (b->normal, n);
+}
+
+void _gle_mesh_texcoord2d (GLdouble s, GLdouble t)
+{
+   gleMeshBuilder *b = _gle_gc -> mesh;
+   b->texcoord[0] = s;
+   b->texcoord[1] = t;
+}
+
+void _gle_mesh_color3fv (const GLfloat *c)
+{
+   gleMeshBuilder *b = _gle_gc -> mesh;
+   VEC_COPY (b->color, c);
+}
+
+int _gle_mesh_wants_normals (void)
+{
+   return (_gle_gc -> mesh -> normal_offset >= 0);
+}
+
+/* ============================================================ */
+/* these are called from code that may run before there's a context */
+
+static gleMeshBuilder * current_mesh (void)
+{
+   gleGC *gc = _gle_gc;
+   return (gc ? gc->mesh : NULL);
+}
+
+void _gle_push_matrix (void)
+{
+   gleMeshBuilder *b = current_mesh ();
+
+   if (b == NULL) {
+      glPushMatrix ();
+      return;
+   }
+   if (b->depth < MESH_STACK_DEPTH-1) {
+      memcpy (b->stack[b->depth+1], b->stack[b->depth], sizeof (b->stack[0]));
+      b->depth ++;
+   }
+}
+
+void _gle_pop_matrix (void)
+{
+   gleMeshBuilder *b = current_mesh ();
+
+   if (b == NULL) {
+      glPopMatrix ();
+      return;
+   }
+   if (b->depth > 0) {
+      b->depth --;
+      update_normal_matrix (b);
+   }
+}
+
+void _gle_mult_matrix_d (const GLdouble *m)
+{
+   gleMeshBuilder *b = current_mesh ();
+   double (*top)[4];
+   double r[4][4];
+   int i, j;
+
+   if (b == NULL) {
+      glMultMatrixd (m);
+      return;
+   }
+
+   /* column major, as OpenGL has it: top = top * m */
+   top = b->stack[b->depth];
+   for (i=0; i<4; i++) {
+      for (j=0; j<4; j++) {
+         r[i][j] = top[0][j] * m[4*i] + top[1][j] * m[4*i+1] +
+                   top[2][j] * m[4*i+2] + top[3][j] * m[4*i+3];
+      }
+   }
+   memcpy (top, r, sizeof (r));
+   update_normal_matrix (b);
+}
+
+void _gle_mult_matrix_f (const GLfloat *m)
+{
+   GLdouble d[16];
+   int i;
+
+   if (current_mesh () == NULL) {
+      glMultMatrixf (m);
+      return;
+   }
+   for (i=0; i<16; i++) d[i] = m[i];
+   _gle_mult_matrix_d (d);
+}
+
+void _gle_load_matrix_d (const GLdouble *m)
+{
+   gleMeshBuilder *b = current_mesh ();
+
+   if (b == NULL) {
+      glLoadMatrixd (m);
+      return;
+   }
+   memcpy (b->stack[b->depth], m, sizeof (b->stack[0]));
+   update_normal_matrix (b);
+}
+
+void _gle_load_matrix_f (const GLfloat *m)
+{
+   GLdouble d[16];
+   int i;
+
+   if (current_mesh () == NULL) {
+      glLoadMatrixf (m);
+      return;
+   }
+   for (i=0; i<16; i++) d[i] = m[i];
+   _gle_load_matrix_d (d);
+}
+
+/* ============================================================ */
+
+void gleBeginMesh (gleMesh *mesh)
+{
+   INIT_GC();
+
+   builder_free (_gle_gc -> mesh);
+   builder_free (_gle_gc -> mesh_done);
+   _gle_gc -> mesh_done = NULL;
+   _gle_gc -> mesh_target = mesh;
+   _gle_gc -> mesh = builder_create (mesh->normals != NULL,
+                                     mesh->texcoords != NULL,
+                                     mesh->colors != NULL);
+}
+
+int gleEndMesh (void)
+{
+   gleMeshBuilder *b;
+   gleMesh *mesh;
+   int i;
+
+   INIT_GC();
+
+   /* stop capturing; what was captured stays until it is copied out */
+   if (_gle_gc -> mesh) {
+      _gle_gc -> mesh_done = _gle_gc -> mesh;
+      _gle_gc -> mesh = NULL;
+   }
+   b = _gle_gc -> mesh_done;
+   mesh = _gle_gc -> mesh_target;
+   if ((b == NULL) || (mesh == NULL)) return -1;
+
+   if (b->out_of_memory) {
+      mesh->num_vertices = 0;
+      mesh->num_indices = 0;
+      builder_free (b);
+      _gle_gc -> mesh_done = NULL;
+      return -1;
+   }
+
+   mesh->num_vertices = b->num_verts;
+   mesh->num_indices = b->num_indices;
+   if ((mesh->max_vertices < b->num_verts) ||
+       (mesh->max_indices < b->num_indices) ||
+       (mesh->vertices == NULL) || (mesh->indices == NULL)) {
+      return -1;
+   }
+
+   for (i=0; i<b->num_verts; i++) {
+      const float *v = &b->verts[i*b->stride];
+      VEC_COPY (mesh->vertices[i], v);
+      if (mesh->normals && (b->normal_offset >= 0)) {
+         VEC_COPY (mesh->normals[i], (v + b->normal_offset));
+      }
+      if (mesh->texcoords && (b->texcoord_offset >= 0)) {
+         mesh->texcoords[i][0] = v[b->texcoord_offset];
+         mesh->texcoords[i][1] = v[b->texcoord_offset+1];
+      }
+      if (mesh->colors && (b->color_offset >= 0)) {
+         VEC_COPY (mesh->colors[i], (v + b->color_offset));
+      }
+   }
+   memcpy (mesh->indices, b->indices, b->num_indices * sizeof (unsigned int));
+
+   builder_free (b);
+   _gle_gc -> mesh_done = NULL;
+   return mesh->num_indices / 3;
+}
+
+void gleDrawMesh (gleMesh *mesh)
+{
+   if ((mesh == NULL) || (mesh->num_indices <= 0)) return;
+
+   glEnableClientState (GL_VERTEX_ARRAY);
+   glVertexPointer (3, GL_FLOAT, 0, mesh->vertices);
+   if (mesh->normals) {
+      glEnableClientState (GL_NORMAL_ARRAY);
+      glNormalPointer (GL_FLOAT, 0, mesh->normals);
+   }
+   if (mesh->texcoords) {
+      glEnableClientState (GL_TEXTURE_COORD_ARRAY);
+      glTexCoordPointer (2, GL_FLOAT, 0, mesh->texcoords);
+   }
+   if (mesh->colors) {
+      glEnableClientState (GL_COLOR_ARRAY);
+      glColorPointer (3, GL_FLOAT, 0, mesh->colors);
+   }
+
+   glDrawElements (GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, mesh->indices);
+
+   glDisableClientState (GL_VERTEX_ARRAY);
+   if (mesh->normals) glDisableClientState (GL_NORMAL_ARRAY);
+   if (mesh->texcoords) glDisableClientState (GL_TEXTURE_COORD_ARRAY);
+   if (mesh->colors) glDisableClientState (GL_COLOR_ARRAY);
+}
+
+/* ============================================================ */
+
+typedef struct {
+   gleGC gc;		/* private context, with its own mesh */
+   int ncp;
+   gleDouble (*contour)[2];
+   gleDouble (*cont_normal)[2];
+   gleDouble up[3];
+   int npoints;
+   gleDouble (*point_array)[3];
+   float (*color_array)[3];
+   gleAffine *xform_array;
+} gleMeshPiece;
+
+static void * build_piece (void *arg)
+{
+   gleMeshPiece *piece = (gleMeshPiece *) arg;
+   gleGC *saved = _gle_gc_local;
+
+   _gle_gc_local = &piece->gc;
+   gleSuperExtrusion (piece->ncp, piece->contour, piece->cont_normal,
+                      piece->up, piece->npoints, piece->point_array,
+                      piece->color_array, piece->xform_array);
+   _gle_gc_local = saved;
+   return NULL;
+}
+
+static void merge_piece (gleMeshBuilder *b, gleMeshBuilder *piece)
+{
+   int *remap;
+   int i, n;
+
+   if (piece->out_of_memory) {
+      b->out_of_memory = TRUE;
+      return;
+   }
+
+   remap = (int *) malloc ((piece->num_verts+1) * sizeof (int));
+   if (remap == NULL) {
+      b->out_of_memory = TRUE;
+      return;
+   }
+
+   /* the rings where two pieces meet get merged here */
+   for (i=0; i<piece->num_verts; i++) {
+      remap[i] = add_vertex (b, &piece->verts[i*piece->stride]);
+      if (remap[i] < 0) break;
+   }
+
+   if (!b->out_of_memory &&
+       builder_reserve ((void **) &b->indices, &b->max_indices,
+                        b->num_indices + piece->num_indices, sizeof (unsigned int))) {
+      n = b->num_indices;
+      for (i=0; i<piece->num_indices; i++) {
+         b->indices[n+i] = remap[piece->indices[i]];
+      }
+      b->num_indices += piece->num_indices;
+   } else {
+      b->out_of_memory = TRUE;
+   }
+
+   free (remap);
+}
+
+int _gle_mesh_split_extrusion (int ncp,
+                gleDouble contour[][2],
+                gleDouble cont_normal[][2],
+                gleDouble up[3],
+                int npoints,
+                gleDouble point_array[][3],
+                float color_array[][3],
+                gleDouble xform_array[][2][3])
+{
+   gleGC *gc = _gle_gc;
+   gleMeshBuilder *b = gc->mesh;
+   gleMeshPiece *pieces;
+   pthread_t threads[MESH_MAX_THREADS];
+   int started[MESH_MAX_THREADS];
+   gleDouble yup[3], bi[3];
+   gleDouble diff[3], summa[3];
+   double len, slen;
+   int npieces, nsegs;
+   int i, k, p, first, last;
+
+   if ((b == NULL) || b->nested) return FALSE;
+
+   /* Round and cut joins draw fillets and caps at the start of each
+    * run of segments, so a piece would not look like part of the whole */
+   if ((__TUBE_STYLE != TUBE_JN_RAW) && (__TUBE_STYLE != TUBE_JN_ANGLE)) {
+      return FALSE;
+   }
+
+   /* path edge normals of the angle join are carried over from one
+    * segment to the next */
+   if ((__TUBE_STYLE == TUBE_JN_ANGLE) && __TUBE_DRAW_PATH_EDGE_NORMALS) {
+      return FALSE;
+   }
+
+   /* texture coordinates accumulate along the path */
+   if (gc->bgn_gen_texture || gc->v3f_gen_texture || gc->v3d_gen_texture ||
+       gc->n3f_gen_texture || gc->n3d_gen_texture || gc->end_gen_texture) {
+      return FALSE;
+   }
+
+   /* segments 1 .. npoints-3 are drawn, the end points only give
+    * the direction of the first and last joins */
+   nsegs = npoints - 3;
+   npieces = num_threads ();
+   if (npieces > nsegs / MESH_MIN_SEGMENTS) npieces = nsegs / MESH_MIN_SEGMENTS;
+   if (npieces < 2) return FALSE;
+
+   /* the join code skips degenerate segments, which would move the
+    * places the pieces start at; keep those paths in one piece */
+   for (i=0; i<npoints-1; i++) {
+      VEC_DIFF (diff, point_array[i+1], point_array[i]);
+      VEC_LENGTH (len, diff);
+      VEC_SUM (summa, point_array[i+1], point_array[i]);
+      VEC_LENGTH (slen, summa);
+      if (len <= slen * DEGENERATE_TOLERANCE) return FALSE;
+   }
+
+   pieces = (gleMeshPiece *) malloc (npieces * sizeof (gleMeshPiece));
+   if (pieces == NULL) return FALSE;
+
+   /* The up vector is carried along the path by reflecting it in the
+    * bisecting plane of every join, so each piece starts with it
+    * already reflected in the joins before its first segment. */
+   if (up == NULL) {
+      yup[0] = 0.0;
+      yup[1] = 1.0;
+      yup[2] = 0.0;
+   } else {
+      VEC_COPY (yup, up);
+   }
+   (void) up_sanity_check (yup, npoints, point_array);
+
+   k = 1;
+   for (p=0; p<npieces; p++) {
+      gleMeshPiece *piece = &pieces[p];
+
+      /* this piece draws the segments starting at points first..last-1 */
+      first = 1 + (nsegs * p) / npieces;
+      last = 1 + (nsegs * (p+1)) / npieces;
+
+      for (; k<first; k++) {
+         bisecting_plane (bi, point_array[k-1], point_array[k], point_array[k+1]);
+         VEC_REFLECT (yup, yup, bi);
+      }
+
+      piece->gc = *gc;
+      piece->gc.mesh = builder_create (b->normal_offset >= 0,
+                                       b->texcoord_offset >= 0,
+                                       b->color_offset >= 0);
+      piece->gc.mesh_done = NULL;
+      piece->gc.mesh_target = NULL;
+      piece->gc.hide_caps = ((p > 0) ? FRONT : 0) | ((p < npieces-1) ? BACK : 0);
+      piece->gc.split_piece = TRUE;
+      if (piece->gc.mesh) {
+         gleMeshBuilder *pb = piece->gc.mesh;
+         memcpy (pb->stack[0], b->stack[b->depth], sizeof (pb->stack[0]));
+         update_normal_matrix (pb);
+         VEC_COPY (pb->normal, b->normal);
+         pb->texcoord[0] = b->texcoord[0];
+         pb->texcoord[1] = b->texcoord[1];
+         VEC_COPY (pb->color, b->color);
+         pb->nested = TRUE;
+      }
+
+      piece->ncp = ncp;
+      piece->contour = contour;
+      piece->cont_normal = cont_normal;
+      VEC_COPY (piece->up, yup);
+      piece->npoints = last - first + 3;
+      piece->point_array = &point_array[first-1];
+      piece->color_array = color_array ? &color_array[first-1] : NULL;
+      piece->xform_array = xform_array ? &xform_array[first-1] : NULL;
+   }
+
+   /* the calling thread builds the first piece itself */
+   for (p=1; p<npieces; p++) {
+      started[p] = (pieces[p].gc.mesh != NULL) &&
+                   !pthread_create (&threads[p], NULL, build_piece, &pieces[p]);
+   }
+   if (pieces[0].gc.mesh) build_piece (&pieces[0]);
+   for (p=1; p<npieces; p++) {
+      if (started[p]) {
+         pthread_join (threads[p], NULL);
+      } else if (pieces[p].gc.mesh) {
+         build_piece (&pieces[p]);
+      }
+   }
+
+   for (p=0; p<npieces; p++) {
+      if (pieces[p].gc.mesh == NULL) {
+         b->out_of_memory = TRUE;
+         continue;
+      }
+      merge_piece (b, pieces[p].gc.mesh);
+      builder_free (pieces[p].gc.mesh);
+   }
+   free (pieces);
+
+   return TRUE;
+}
+
+/* ================== END OF FILE ======================= */
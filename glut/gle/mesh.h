@@ -0,0 +1,49 @@
+/*
+ * mesh.h
+ *
+ * FUNCTION:
+ * Internal interface of the retained mode (mesh) backend.  While a
+ * mesh is being built the drawing macros in port.h call these in
+ * place of the OpenGL entry points they emulate.
+ *
+ * HISTORY:
+ * Added retained mode meshes, October 2026
+ */
+
+#ifndef __GLE_MESH_H__
+#define __GLE_MESH_H__
+
+typedef struct _gleMeshBuilder gleMeshBuilder;
+
+/* immediate mode entry points */
+extern void _gle_mesh_begin (GLenum mode);
+extern void _gle_mesh_end (void);
+extern void _gle_mesh_vertex3dv (const GLdouble *v);
+extern void _gle_mesh_vertex3fv (const GLfloat *v);
+extern void _gle_mesh_normal3dv (const GLdouble *n);
+extern void _gle_mesh_normal3fv (const GLfloat *n);
+extern void _gle_mesh_texcoord2d (GLdouble s, GLdouble t);
+extern void _gle_mesh_color3fv (const GLfloat *c);
+extern int _gle_mesh_wants_normals (void);
+
+/* matrix stack, either the mesh's or OpenGL's */
+extern void _gle_push_matrix (void);
+extern void _gle_pop_matrix (void);
+extern void _gle_mult_matrix_d (const GLdouble *m);
+extern void _gle_mult_matrix_f (const GLfloat *m);
+extern void _gle_load_matrix_d (const GLdouble *m);
+extern void _gle_load_matrix_f (const GLfloat *m);
+
+/* Builds a long extrusion as several pieces in parallel.  Returns
+ * FALSE, having done nothing, if the extrusion can't be split. */
+extern int _gle_mesh_split_extrusion (int ncp,
+                gleDouble contour[][2],
+                gleDouble cont_normal[][2],
+                gleDouble up[3],
+                int npoints,
+                gleDouble point_array[][3],
+                float color_array[][3],
+                gleDouble xform_array[][2][3]);
+
+#endif /* __GLE_MESH_H__ */
+/* ================== END OF FILE ======================= */
@@ -0,0 +1,527 @@
+/*
+ * MODULE: mesh_benchmark.c
+ *
+ * FUNCTION:
+ * Checks that a mesh built with gleBeginMesh()/gleEndMesh() holds the
+ * same triangles that immediate mode sends to OpenGL, and times both.
+ * The OpenGL immediate mode entry points are replaced by a recorder
+ * that does its own matrix stack and primitive assembly, so no window
+ * or driver is needed.  The recorder does not touch the GLE context.
+ *
+ * Build it next to the library sources, with the defines that
+ * gle_osx.h supplies on the Mac, e.g.
+ *
+ *    cc -O2 -I. -DOPENGL_10 -DAUTO_TEXTURE -D__GUTIL_DOUBLE \
+ *       -o mesh_benchmark mesh_benchmark.c ex_angle.c \
+ *       ex_cut_round.c ex_raw.c extrude.c intersect.c mesh.c \
+ *       rot_prince.c rotate.c round_cap.c segment.c texgen.c \
+ *       urotate.c view.c -lGLU -lGL -lpthread -lm
+ *
+ * HISTORY:
+ * Added retained mode meshes, October 2026
+ */
+#ifdef __APPLE__
+#include "gle_osx.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+#include <tube.h>
+#include "port.h"
+
+/* ============================================================ */
+/* the immediate mode recorder */
+
+typedef struct {
+   float pos[3];
+   float norm[3];
+   float color[3];
+} Vertex;
+
+typedef struct {
+   Vertex v[3];
+} Triangle;
+
+static struct {
+   double stack[32][16];
+   int depth;
+   double normal[3];
+   float color[3];
+   GLenum mode;
+   int count;
+   Vertex first;
+   Vertex prev[2];
+
+   Triangle *tris;
+   int num_tris;
+   int max_tris;
+   long num_calls;
+} rec;
+
+static void rec_reset (void)
+{
+   int i;
+
+   memset (rec.stack[0], 0, sizeof (rec.stack[0]));
+   for (i=0; i<4; i++) rec.stack[0][5*i] = 1.0;
+   rec.depth = 0;
+   rec.normal[0] = rec.normal[1] = 0.0;
+   rec.normal[2] = 1.0;
+   rec.color[0] = rec.color[1] = rec.color[2] = 1.0f;
+   rec.num_tris = 0;
+   rec.num_calls = 0;
+}
+
+static void rec_triangle (const Vertex *a, const Vertex *b, const Vertex *c)
+{
+   if (!memcmp (a, b, sizeof (Vertex)) || !memcmp (b, c, sizeof (Vertex)) ||
+       !memcmp (c, a, sizeof (Vertex))) return;
+
+   if (rec.num_tris == rec.max_tris) {
+      rec.max_tris = rec.max_tris ? 2*rec.max_tris : 4096;
+      rec.tris = (Triangle *) realloc (rec.tris, rec.max_tris * sizeof (Triangle));
+   }
+   rec.tris[rec.num_tris].v[0] = *a;
+   rec.tris[rec.num_tris].v[1] = *b;
+   rec.tris[rec.num_tris].v[2] = *c;
+   rec.num_tris ++;
+}
+
+void glBegin (GLenum mode)
+{
+   rec.mode = mode;
+   rec.count = 0;
+   rec.num_calls ++;
+}
+
+void glEnd (void)
+{
+   rec.num_calls ++;
+}
+
+void glVertex3dv (const GLdouble *p)
+{
+   const double *m = rec.stack[rec.depth];
+   double a0[3], a1[3], a2[3], n[3][3], det;
+   Vertex v;
+   int i;
+
+   rec.num_calls ++;
+   for (i=0; i<3; i++) {
+      v.pos[i] = (float) (m[i]*p[0] + m[4+i]*p[1] + m[8+i]*p[2] + m[12+i]) + 0.0f;
+      a0[i] = m[i]; a1[i] = m[4+i]; a2[i] = m[8+i];
+   }
+
+   /* inverse transpose, by cofactors */
+   n[0][0] = a1[1]*a2[2] - a1[2]*a2[1];
+   n[0][1] = a1[2]*a2[0] - a1[0]*a2[2];
+   n[0][2] = a1[0]*a2[1] - a1[1]*a2[0];
+   n[1][0] = a2[1]*a0[2] - a2[2]*a0[1];
+   n[1][1] = a2[2]*a0[0] - a2[0]*a0[2];
+   n[1][2] = a2[0]*a0[1] - a2[1]*a0[0];
+   n[2][0] = a0[1]*a1[2] - a0[2]*a1[1];
+   n[2][1] = a0[2]*a1[0] - a0[0]*a1[2];
+   n[2][2] = a0[0]*a1[1] - a0[1]*a1[0];
+   det = a0[0]*n[0][0] + a0[1]*n[0][1] + a0[2]*n[0][2];
+   for (i=0; i<3; i++) {
+      v.norm[i] = (float) ((n[0][i]*rec.normal[0] + n[1][i]*rec.normal[1] +
+                            n[2][i]*rec.normal[2]) / det) + 0.0f;
+   }
+   memcpy (v.color, rec.color, sizeof (v.color));
+
+   switch (rec.mode) {
+      case GL_TRIANGLE_STRIP:
+         if (rec.count >= 2) {
+            if (rec.count & 1) rec_triangle (&rec.prev[1], &rec.prev[0], &v);
+            else rec_triangle (&rec.prev[0], &rec.prev[1], &v);
+         }
+         rec.prev[0] = rec.prev[1];
+         rec.prev[1] = v;
+         break;
+      case GL_TRIANGLE_FAN:
+      case GL_POLYGON:
+         if (rec.count == 0) rec.first = v;
+         else if (rec.count >= 2) rec_triangle (&rec.first, &rec.prev[1], &v);
+         rec.prev[1] = v;
+         break;
+      case GL_TRIANGLES:
+         if ((rec.count % 3) == 2) rec_triangle (&rec.prev[0], &rec.prev[1], &v);
+         rec.prev[0] = rec.prev[1];
+         rec.prev[1] = v;
+         break;
+   }
+   rec.count ++;
+}
+
+void glVertex3fv (const GLfloat *p)
+{
+   GLdouble d[3];
+   d[0] = p[0]; d[1] = p[1]; d[2] = p[2];
+   glVertex3dv (d);
+}
+
+void glNormal3dv (const GLdouble *n)
+{
+   rec.num_calls ++;
+   rec.normal[0] = n[0]; rec.normal[1] = n[1]; rec.normal[2] = n[2];
+}
+
+void glNormal3fv (const GLfloat *n)
+{
+   rec.num_calls ++;
+   rec.normal[0] = n[0]; rec.normal[1] = n[1]; rec.normal[2] = n[2];
+}
+
+void glColor3fv (const GLfloat *c)
+{
+   rec.num_calls ++;
+   memcpy (rec.color, c, sizeof (rec.color));
+}
+
+void glTexCoord2d (GLdouble s, GLdouble t) { rec.num_calls ++; }
+void glTexCoord2f (GLfloat s, GLfloat t) { rec.num_calls ++; }
+
+void glPushMatrix (void)
+{
+   memcpy (rec.stack[rec.depth+1], rec.stack[rec.depth], sizeof (rec.stack[0]));
+   rec.depth ++;
+}
+
+void glPopMatrix (void)
+{
+   rec.depth --;
+}
+
+void glMultMatrixd (const GLdouble *m)
+{
+   double *top = rec.stack[rec.depth];
+   double r[16];
+   int i, j;
+
+   for (i=0; i<4; i++) {
+      for (j=0; j<4; j++) {
+         r[4*i+j] = top[j] * m[4*i] + top[4+j] * m[4*i+1] +
+                    top[8+j] * m[4*i+2] + top[12+j] * m[4*i+3];
+      }
+   }
+   memcpy (top, r, sizeof (r));
+}
+
+void glMultMatrixf (const GLfloat *m)
+{
+   GLdouble d[16];
+   int i;
+   for (i=0; i<16; i++) d[i] = m[i];
+   glMultMatrixd (d);
+}
+
+void glLoadMatrixd (const GLdouble *m)
+{
+   memcpy (rec.stack[rec.depth], m, sizeof (rec.stack[0]));
+}
+
+void glLoadMatrixf (const GLfloat *m)
+{
+   int i;
+   for (i=0; i<16; i++) rec.stack[rec.depth][i] = m[i];
+}
+
+GLboolean glIsEnabled (GLenum cap)
+{
+   return GL_TRUE;
+}
+
+/* ============================================================ */
+
+static double now (void)
+{
+   struct timeval tv;
+   gettimeofday (&tv, NULL);
+   return tv.tv_sec + 1.0e-6 * tv.tv_usec;
+}
+
+static int compare_floats (const float *a, const float *b, int n)
+{
+   int i;
+   for (i=0; i<n; i++) {
+      if (a[i] < b[i]) return -1;
+      if (a[i] > b[i]) return 1;
+   }
+   return 0;
+}
+
+/* positions come out bit for bit the same both ways, normals only
+ * nearly, so triangles are ordered by their positions alone */
+static int compare_triangles (const void *a, const void *b)
+{
+   const Triangle *ta = (const Triangle *) a;
+   const Triangle *tb = (const Triangle *) b;
+   int k, c;
+
+   for (k=0; k<3; k++) {
+      c = compare_floats (ta->v[k].pos, tb->v[k].pos, 3);
+      if (c) return c;
+   }
+   return 0;
+}
+
+/* start each triangle at its smallest vertex, keeping the winding */
+static void canonical_order (Triangle *t, int n)
+{
+   Triangle r;
+   int i, k, s;
+
+   for (i=0; i<n; i++) {
+      s = 0;
+      for (k=1; k<3; k++) {
+         if (compare_floats (t[i].v[k].pos, t[i].v[s].pos, 3) < 0) s = k;
+      }
+      for (k=0; k<3; k++) r.v[k] = t[i].v[(s+k) % 3];
+      t[i] = r;
+   }
+   qsort (t, n, sizeof (Triangle), compare_triangles);
+}
+
+static int same_triangles (Triangle *a, Triangle *b, int n)
+{
+   const float *fa, *fb;
+   int i, k, bad = 0;
+
+   canonical_order (a, n);
+   canonical_order (b, n);
+   for (i=0; i<n; i++) {
+      fa = (const float *) &a[i];
+      fb = (const float *) &b[i];
+      for (k=0; k<(int)(sizeof (Triangle) / sizeof (float)); k++) {
+         if (fabsf (fa[k] - fb[k]) > 1.0e-4f * (1.0f + fabsf (fa[k]))) {
+            bad ++;
+            break;
+         }
+      }
+   }
+   return bad;
+}
+
+/* ============================================================ */
+/* the shapes */
+
+#define NCP 24
+static gleDouble contour[NCP][2];
+static gleDouble cont_normal[NCP][2];
+static gleDouble up[3] = {0.0, 0.0, 1.0};
+
+static int npath;
+static gleDouble (*path)[3];
+static float (*colors)[3];
+static gleAffine *xforms;
+
+static void init_shapes (int n)
+{
+   int i;
+   double t;
+
+   for (i=0; i<NCP; i++) {
+      t = 2.0 * M_PI * i / NCP;
+      contour[i][0] = 0.3 * cos (t) * (1.0 + 0.2 * cos (3.0 * t));
+      contour[i][1] = 0.3 * sin (t);
+      cont_normal[i][0] = cos (t);
+      cont_normal[i][1] = sin (t);
+   }
+
+   /* a knot-like path that bends at every point */
+   npath = n;
+   path = malloc (n * sizeof (path[0]));
+   colors = malloc (n * sizeof (colors[0]));
+   xforms = malloc (n * sizeof (xforms[0]));
+   for (i=0; i<n; i++) {
+      t = 12.0 * M_PI * i / n;
+      path[i][0] = (2.0 + cos (1.5 * t)) * cos (t);
+      path[i][1] = (2.0 + cos (1.5 * t)) * sin (t);
+      path[i][2] = sin (1.5 * t);
+      colors[i][0] = 0.5f + 0.5f * (float) cos (t);
+      colors[i][1] = 0.5f + 0.5f * (float) sin (t);
+      colors[i][2] = (float) i / n;
+      xforms[i][0][0] = 1.0 + 0.3 * sin (2.0 * t);
+      xforms[i][0][1] = 0.1 * cos (t);
+      xforms[i][0][2] = 0.0;
+      xforms[i][1][0] = 0.0;
+      xforms[i][1][1] = 1.0 + 0.3 * sin (2.0 * t);
+      xforms[i][1][2] = 0.05 * sin (t);
+   }
+}
+
+static void draw_super (void)
+{
+   gleSuperExtrusion (NCP, contour, cont_normal, up, npath, path, colors, xforms);
+}
+
+static void draw_cylinder (void)
+{
+   glePolyCylinder (npath, path, NULL, 0.2);
+}
+
+static void draw_spiral (void)
+{
+   gleSpiral (NCP, contour, cont_normal, up, 1.5, 0.2, 0.0, 0.5,
+              NULL, NULL, 0.0, 1800.0);
+}
+
+static void draw_lathe (void)
+{
+   gleLathe (NCP, contour, cont_normal, up, 1.5, 0.2, 0.0, 0.5,
+             NULL, NULL, 0.0, 1800.0);
+}
+
+static void draw_helicoid (void)
+{
+   gleHelicoid (0.3, 1.5, 0.2, 0.0, 0.5, NULL, NULL, 0.0, 1800.0);
+}
+
+static void draw_screw (void)
+{
+   gleDouble xup[3] = {1.0, 0.0, 0.0};	/* the screw runs along z */
+   gleScrew (NCP, contour, cont_normal, xup, 0.0, 8.0, 1800.0);
+}
+
+static struct {
+   const char *name;
+   void (*draw) (void);
+} shapes[] = {
+   { "super extrusion", draw_super },
+   { "poly cylinder", draw_cylinder },
+   { "spiral", draw_spiral },
+   { "lathe", draw_lathe },
+   { "helicoid", draw_helicoid },
+   { "screw", draw_screw },
+};
+
+static struct {
+   const char *name;
+   int style;
+} styles[] = {
+   { "raw", TUBE_JN_RAW | TUBE_JN_CAP | TUBE_NORM_FACET },
+   { "angle", TUBE_JN_ANGLE | TUBE_JN_CAP | TUBE_NORM_EDGE },
+   { "cut", TUBE_JN_CUT | TUBE_JN_CAP | TUBE_NORM_FACET },
+   { "round", TUBE_JN_ROUND | TUBE_JN_CAP | TUBE_NORM_EDGE },
+};
+
+/* ============================================================ */
+
+static gleMesh mesh;
+
+static void alloc_mesh (int nv, int ni)
+{
+   mesh.max_vertices = nv;
+   mesh.max_indices = ni;
+   mesh.vertices = realloc (mesh.vertices, nv * sizeof (mesh.vertices[0]));
+   mesh.normals = realloc (mesh.normals, nv * sizeof (mesh.normals[0]));
+   mesh.colors = realloc (mesh.colors, nv * sizeof (mesh.colors[0]));
+   mesh.texcoords = NULL;
+   mesh.indices = realloc (mesh.indices, ni * sizeof (mesh.indices[0]));
+}
+
+static int build_mesh (void (*draw) (void))
+{
+   int ntris;
+
+   gleBeginMesh (&mesh);
+   draw ();
+   ntris = gleEndMesh ();
+   if (ntris < 0 && mesh.num_indices > 0) {
+      alloc_mesh (mesh.num_vertices, mesh.num_indices);
+      ntris = gleEndMesh ();
+   }
+   return ntris;
+}
+
+static Triangle * expand_mesh (void)
+{
+   Triangle *t = malloc ((mesh.num_indices/3 + 1) * sizeof (Triangle));
+   int i, k;
+   unsigned int n;
+
+   for (i=0; i<mesh.num_indices/3; i++) {
+      for (k=0; k<3; k++) {
+         n = mesh.indices[3*i+k];
+         memcpy (t[i].v[k].pos, mesh.vertices[n], sizeof (float[3]));
+         memcpy (t[i].v[k].norm, mesh.normals[n], sizeof (float[3]));
+         memcpy (t[i].v[k].color, mesh.colors[n], sizeof (float[3]));
+      }
+   }
+   return t;
+}
+
+int main (int argc, char *argv[])
+{
+   static const int threads[] = { 1, 2, 4, 8 };
+   int nthreads = sizeof (threads) / sizeof (threads[0]);
+   int i, j, t, r, reps, ntris, bad, failures = 0;
+   Triangle *expected, *got;
+   double t0, t_imm, t_mesh;
+
+   init_shapes ((argc > 1) ? atoi (argv[1]) : 2000);
+   reps = (argc > 2) ? atoi (argv[2]) : 5;
+   gleSetNumSlices (60);
+   alloc_mesh (1024, 1024);
+
+   printf ("%-16s %-6s %9s %9s %12s", "shape", "join", "tris", "verts", "imm Mv/s");
+   for (t=0; t<nthreads; t++) printf ("   mesh x%d", threads[t]);
+   printf ("\n");
+
+   for (i=0; i<(int)(sizeof (shapes) / sizeof (shapes[0])); i++) {
+      for (j=0; j<(int)(sizeof (styles) / sizeof (styles[0])); j++) {
+         gleSetJoinStyle (styles[j].style);
+
+         rec_reset ();
+         shapes[i].draw ();
+         expected = malloc ((rec.num_tris + 1) * sizeof (Triangle));
+         memcpy (expected, rec.tris, rec.num_tris * sizeof (Triangle));
+
+         t0 = now ();
+         for (r=0; r<reps; r++) {
+            rec_reset ();
+            shapes[i].draw ();
+         }
+         t_imm = (now () - t0) / reps;
+
+         printf ("%-16s %-6s %9d", shapes[i].name, styles[j].name, rec.num_tris);
+
+         for (t=0; t<nthreads; t++) {
+            gleSetNumThreads (threads[t]);
+            ntris = build_mesh (shapes[i].draw);
+
+            got = expand_mesh ();
+            bad = (ntris != rec.num_tris) ? -1 :
+                  same_triangles (expected, got, ntris);
+            free (got);
+            if (bad) {
+               printf ("\n   MISMATCH at %d threads: %d triangles, expected %d, %d differ\n",
+                       threads[t], ntris, rec.num_tris, bad);
+               failures ++;
+               continue;
+            }
+
+            t0 = now ();
+            for (r=0; r<reps; r++) build_mesh (shapes[i].draw);
+            t_mesh = (now () - t0) / reps;
+
+            if (t == 0) {
+               printf (" %9d %12.2f", mesh.num_vertices,
+                       3.0e-6 * rec.num_tris / t_imm);
+            }
+            printf (" %10.2f", 3.0e-6 * ntris / t_mesh);
+         }
+         printf ("\n");
+         free (expected);
+      }
+   }
+
+   printf ("%s\n", failures ? "FAILED" : "all meshes match immediate mode");
+   return failures ? 1 : 0;
+}
+
+/* ================== END OF FILE ======================= */
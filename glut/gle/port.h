@@ -195,8 +195,14 @@ typedef double glePoint[2];
 #include <windows.h>
 #pragma warning (disable:4244)          /* disable bogus conversion warnings */
 #endif
+#ifdef __APPLE__
 #include <OpenGL/gl.h>
 #include <OpenGL/glu.h>
+#else
+#include <GL/gl.h>
+#include <GL/glu.h>
+#endif
+#include "mesh.h"
 
 /*
 #define	N3F_F(x) {					\
@@ -215,77 +221,146 @@ typedef double glePoint[2];
 }
 */
 
-#define	C3F(x)		glColor3fv(x)
-#define	T2F_F(x,y)	glTexCoord2f(x,y)
-#define	T2F_D(x,y)	glTexCoord2d(x,y)
+/* 
+ * Between gleBeginMesh() and gleEndMesh() the context carries a mesh
+ * builder, and everything below is captured into it instead of being
+ * sent to OpenGL.  The matrix calls are also made from files that 
+ * don't know about the context, so they go through mesh.c.
+ */
 
-#define	POPMATRIX()	glPopMatrix()
-#define	PUSHMATRIX()	glPushMatrix()
+#define	C3F(x) {					\
+	if(_gle_gc -> mesh) _gle_mesh_color3fv(x);	\
+	else glColor3fv(x);				\
+}
 
-#define	MULTMATRIX_F(x)	glMultMatrixf ((const GLfloat *)x)
-#define	LOADMATRIX_F(x)	glLoadMatrixf ((const GLfloat *)x)
+#define	T2F_F(x,y) {					\
+	if(_gle_gc -> mesh) _gle_mesh_texcoord2d(x,y);	\
+	else glTexCoord2f(x,y);				\
+}
 
-#define	MULTMATRIX_D(x)	glMultMatrixd ((const GLdouble *)x)
-#define	LOADMATRIX_D(x)	glLoadMatrixd ((const GLdouble *)x)
+#define	T2F_D(x,y) {					\
+	if(_gle_gc -> mesh) _gle_mesh_texcoord2d(x,y);	\
+	else glTexCoord2d(x,y);				\
+}
 
-#define __IS_LIGHTING_ON  (glIsEnabled(GL_LIGHTING))
+#define	POPMATRIX()	_gle_pop_matrix()
+#define	PUSHMATRIX()	_gle_push_matrix()
+
+#define	MULTMATRIX_F(x)	_gle_mult_matrix_f ((const GLfloat *)x)
+#define	LOADMATRIX_F(x)	_gle_load_matrix_f ((const GLfloat *)x)
+
+#define	MULTMATRIX_D(x)	_gle_mult_matrix_d ((const GLdouble *)x)
+#define	LOADMATRIX_D(x)	_gle_load_matrix_d ((const GLdouble *)x)
+
+/* a mesh gets normals exactly when the caller asked for them */
+#define __IS_LIGHTING_ON  ((_gle_gc -> mesh) ? _gle_mesh_wants_normals() : glIsEnabled(GL_LIGHTING))
+
+/* the GLU tesselator draws the end caps */
+#define TESS_CALLBACKS(tobj) {						\
+	if(_gle_gc -> mesh) {						\
+	   gluTessCallback (tobj, GLU_BEGIN, _gle_mesh_begin);		\
+	   gluTessCallback (tobj, GLU_VERTEX, _gle_mesh_vertex3dv);	\
+	   gluTessCallback (tobj, GLU_END, _gle_mesh_end);		\
+	} else {							\
+	   gluTessCallback (tobj, GLU_BEGIN, glBegin);			\
+	   gluTessCallback (tobj, GLU_VERTEX, glVertex3dv);		\
+	   gluTessCallback (tobj, GLU_END, glEnd);			\
+	}								\
+}
 
 /* ====================================================== */
 #ifdef AUTO_TEXTURE
 
 #define BGNTMESH(i,len) { 					\
 	if(_gle_gc -> bgn_gen_texture) (*(_gle_gc -> bgn_gen_texture))(i,len);\
-	glBegin (GL_TRIANGLE_STRIP); 			\
+	if(_gle_gc -> mesh) _gle_mesh_begin (GL_TRIANGLE_STRIP);	\
+	else glBegin (GL_TRIANGLE_STRIP); 			\
 }
 
 #define BGNPOLYGON() { 					\
 	if(_gle_gc -> bgn_gen_texture) (*(_gle_gc -> bgn_gen_texture))();\
-	glBegin (GL_POLYGON);				\
+	if(_gle_gc -> mesh) _gle_mesh_begin (GL_POLYGON);	\
+	else glBegin (GL_POLYGON);				\
 }
 
 #define N3F_F(x) { 					\
 	if(_gle_gc -> n3f_gen_texture) (*(_gle_gc -> n3f_gen_texture))(x); \
-	glNormal3fv(x); 				\
+	if(_gle_gc -> mesh) _gle_mesh_normal3fv(x);	\
+	else glNormal3fv(x); 				\
 }
 
 #define N3F_D(x) { 					\
 	if(_gle_gc -> n3d_gen_texture) (*(_gle_gc -> n3d_gen_texture))(x); \
-	glNormal3dv(x); 				\
+	if(_gle_gc -> mesh) _gle_mesh_normal3dv(x);	\
+	else glNormal3dv(x); 				\
 }
 
 #define V3F_F(x,j,id) { 					\
 	if(_gle_gc -> v3f_gen_texture) (*(_gle_gc -> v3f_gen_texture))(x,j,id);\
-	glVertex3fv(x); 				\
+	if(_gle_gc -> mesh) _gle_mesh_vertex3fv(x);	\
+	else glVertex3fv(x); 				\
 }
 
 #define V3F_D(x,j,id) { 					\
 	if(_gle_gc -> v3d_gen_texture) (*(_gle_gc -> v3d_gen_texture))(x,j,id); \
-	glVertex3dv(x); 				\
+	if(_gle_gc -> mesh) _gle_mesh_vertex3dv(x);	\
+	else glVertex3dv(x); 				\
 }
 
 #define ENDTMESH() {					\
 	if(_gle_gc -> end_gen_texture) (*(_gle_gc -> end_gen_texture))(); \
-	glEnd ();					\
+	if(_gle_gc -> mesh) _gle_mesh_end ();		\
+	else glEnd ();					\
 }
 
 #define ENDPOLYGON() {					\
 	if(_gle_gc -> end_gen_texture) (*(_gle_gc -> end_gen_texture))(); \
-	glEnd ();					\
+	if(_gle_gc -> mesh) _gle_mesh_end ();		\
+	else glEnd ();					\
 }
 
 /* ====================================================== */
 #else /* AUTO_TEXTURE */
 
-#define BGNTMESH(i,len)	glBegin (GL_TRIANGLE_STRIP);
-#define BGNPOLYGON() 	glBegin (GL_POLYGON);
+#define BGNTMESH(i,len) { 					\
+	if(_gle_gc -> mesh) _gle_mesh_begin (GL_TRIANGLE_STRIP);	\
+	else glBegin (GL_TRIANGLE_STRIP); 			\
+}
+
+#define BGNPOLYGON() { 					\
+	if(_gle_gc -> mesh) _gle_mesh_begin (GL_POLYGON);	\
+	else glBegin (GL_POLYGON);				\
+}
 
-#define	N3F_F(x)	glNormal3fv(x)
-#define	N3F_D(x)	glNormal3dv(x)
-#define V3F_F(x,j,id)	glVertex3fv(x);
-#define V3F_D(x,j,id)	glVertex3dv(x);
+#define	N3F_F(x) { 					\
+	if(_gle_gc -> mesh) _gle_mesh_normal3fv(x);	\
+	else glNormal3fv(x); 				\
+}
 
-#define ENDTMESH()	glEnd ()
-#define ENDPOLYGON()	glEnd()
+#define	N3F_D(x) { 					\
+	if(_gle_gc -> mesh) _gle_mesh_normal3dv(x);	\
+	else glNormal3dv(x); 				\
+}
+
+#define V3F_F(x,j,id) { 					\
+	if(_gle_gc -> mesh) _gle_mesh_vertex3fv(x);	\
+	else glVertex3fv(x); 				\
+}
+
+#define V3F_D(x,j,id) { 					\
+	if(_gle_gc -> mesh) _gle_mesh_vertex3dv(x);	\
+	else glVertex3dv(x); 				\
+}
+
+#define ENDTMESH() {					\
+	if(_gle_gc -> mesh) _gle_mesh_end ();		\
+	else glEnd ();					\
+}
+
+#define ENDPOLYGON() {					\
+	if(_gle_gc -> mesh) _gle_mesh_end ();		\
+	else glEnd ();					\
+}
 
 #endif /* AUTO_TEXTURE */
 
@@ -21,7 +21,8 @@
 
 /* ======================================================= */
 
-gleGC *_gle_gc = 0x0;
+gleGC *_gle_gc_shared = 0x0;
+GLE_THREAD_LOCAL gleGC *_gle_gc_local = 0x0;
 
 gleGC * gleCreateGC (void) {
    gleGC * retval = (gleGC *) malloc (sizeof (gleGC));
@@ -51,6 +52,12 @@ gleGC * gleCreateGC (void) {
    retval -> prev_x = 0.0;
    retval -> prev_y = 0.0;
 
+   retval -> mesh = 0x0;
+   retval -> mesh_done = 0x0;
+   retval -> mesh_target = 0x0;
+   retval -> hide_caps = 0;
+   retval -> split_piece = 0;
+
    return retval;
 }
 
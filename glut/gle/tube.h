@@ -24,9 +24,10 @@ extern "C" {
  changes, semantic changes, deletions, or additions).
  
  GLE_API_VERSION=228  GLUT 3.7 release of GLE.
+ GLE_API_VERSION=229  Retained mode meshes (gleBeginMesh, gleEndMesh).
 **/
 #ifndef GLE_API_VERSION  /* allow this to be overriden */
-#define GLE_API_VERSION                228
+#define GLE_API_VERSION                229
 #endif
 
 /* some types */
@@ -195,6 +196,44 @@ extern void gleScrew (int ncp,          /* number of contour points */
 
 extern void gleTextureMode (int mode);
 
+/* ====================================================== */
+
+/* 
+ * Retained mode.  Extrusions drawn between gleBeginMesh() and
+ * gleEndMesh() are not sent to OpenGL; their triangles are collected,
+ * with vertices shared between segments, and copied into the arrays
+ * of the mesh.  The normal, texture coordinate and color arrays are
+ * optional; leave them NULL if not wanted.  Long paths are generated 
+ * by several threads (see gleSetNumThreads).
+ *
+ * gleEndMesh() returns the number of triangles.  If the arrays are 
+ * too small it returns -1 with num_vertices and num_indices set to 
+ * the sizes needed; grow the arrays and call gleEndMesh() again.
+ */
+
+typedef struct {
+   /* caller supplied arrays */
+   int max_vertices;
+   int max_indices;
+   float (*vertices)[3];
+   float (*normals)[3];
+   float (*texcoords)[2];
+   float (*colors)[3];
+   unsigned int *indices;		/* triangle list */
+
+   /* filled in by gleEndMesh() */
+   int num_vertices;
+   int num_indices;
+} gleMesh;
+
+extern void gleBeginMesh (gleMesh *mesh);
+extern int gleEndMesh (void);
+extern void gleDrawMesh (gleMesh *mesh);
+
+/* 0 means one thread per processor */
+extern int gleGetNumThreads (void);
+extern void gleSetNumThreads (int threads);
+
 #ifdef __cplusplus
 }
 
@@ -56,16 +56,35 @@ typedef struct {
    void (*save_v3d_gen_texture) (double *, int, int);
    void (*save_end_gen_texture) (void);
 
+   /* private members, used by the retained mesh code */
+   struct _gleMeshBuilder *mesh;       /* when set, geometry goes here */
+   struct _gleMeshBuilder *mesh_done;  /* finished, waiting for a copy */
+   gleMesh *mesh_target;
+   int hide_caps;        /* FRONT and/or BACK, for pieces of a split path */
+   int split_piece;      /* drawing one piece of a split path */
+
 } gleGC;
 
-extern gleGC *_gle_gc;
+/* Mesh worker threads run the extrusion code on a private copy of the
+ * context, everyone else shares one. */
+#if defined(_WIN32)
+#define GLE_THREAD_LOCAL __declspec(thread)
+#else
+#define GLE_THREAD_LOCAL __thread
+#endif
+
+extern gleGC *_gle_gc_shared;
+extern GLE_THREAD_LOCAL gleGC *_gle_gc_local;
 extern gleGC * gleCreateGC (void);
 
-#define INIT_GC() {if (!_gle_gc) _gle_gc = gleCreateGC(); }
+#define _gle_gc (_gle_gc_local ? _gle_gc_local : _gle_gc_shared)
+#define INIT_GC() {if (!_gle_gc_shared) _gle_gc_shared = gleCreateGC(); }
 #define extrusion_join_style (_gle_gc->join_style)
 
 #define __TUBE_CLOSE_CONTOUR (extrusion_join_style & TUBE_CONTOUR_CLOSED)
 #define __TUBE_DRAW_CAP (extrusion_join_style & TUBE_JN_CAP)
+#define __TUBE_DRAW_FRONT_CAP (__TUBE_DRAW_CAP && !(_gle_gc->hide_caps & FRONT))
+#define __TUBE_DRAW_BACK_CAP (__TUBE_DRAW_CAP && !(_gle_gc->hide_caps & BACK))
 #define __TUBE_DRAW_FACET_NORMALS (extrusion_join_style & TUBE_NORM_FACET)
 #define __TUBE_DRAW_PATH_EDGE_NORMALS (extrusion_join_style & TUBE_NORM_PATH_EDGE)
 
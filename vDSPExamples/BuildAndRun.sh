@@ -17,3 +17,15 @@ echo "Running DTMF.DFT."
 echo ""
 echo "Running DTMF.FFT."
 ./build/Default/DTMF.FFT "159#"
+
+echo ""
+echo "Building and running ConvolutionBenchmark."
+cc -O3 -std=gnu99 -o build/ConvolutionBenchmark ConvolutionBenchmark.c \
+    PartitionedConvolution.c PortableFFT.c -lm
+./build/ConvolutionBenchmark
+
+echo ""
+echo "Building and running FFT2DBenchmark."
+cc -O3 -std=gnu99 -o build/FFT2DBenchmark FFT2DBenchmark.c \
+    PortableFFT2D.c PortableFFT.c -lm -lpthread
+./build/FFT2DBenchmark
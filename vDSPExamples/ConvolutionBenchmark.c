@@ -0,0 +1,283 @@
+/*
+	    File: ConvolutionBenchmark.c
+	Abstract: Crossover benchmark of partitioned FFT convolution against direct convolution.
+	 Version: 1.2
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+	Inc. ("Apple") in consideration of your agreement to the following
+	terms, and your use, installation, modification or redistribution of
+	this Apple software constitutes acceptance of these terms.  If you do
+	not agree with these terms, please do not use, install, modify or
+	redistribute this Apple software.
+	
+	In consideration of your agreement to abide by the following terms, and
+	subject to these terms, Apple grants you a personal, non-exclusive
+	license, under Apple's copyrights in this original Apple software (the
+	"Apple Software"), to use, reproduce, modify and redistribute the Apple
+	Software, with or without modifications, in source and/or binary forms;
+	provided that if you redistribute the Apple Software in its entirety and
+	without modifications, you must retain this notice and the following
+	text and disclaimers in all such redistributions of the Apple Software.
+	Neither the name, trademarks, service marks or logos of Apple Inc. may
+	be used to endorse or promote products derived from the Apple Software
+	without specific prior written permission from Apple.  Except as
+	expressly stated in this notice, no other rights or licenses, express or
+	implied, are granted by Apple herein, including but not limited to any
+	patent rights that may be infringed by your derivative works or by other
+	works in which the Apple Software may be incorporated.
+	
+	The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+	MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+	THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+	FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+	OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+	
+	IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+	OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+	MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+	AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+	STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+	
+	Copyright (C) 2012 Apple Inc. All Rights Reserved.
+	
+
+	This program checks PartitionedConvolution against a direct
+	convolution and then times both over a range of filter lengths,
+	reporting nanoseconds per output sample so the crossover point is
+	visible.  It uses only standard C and PortableFFT, so it builds and
+	runs on Linux as well as OS X:
+
+		cc -O3 -std=gnu99 -o ConvolutionBenchmark ConvolutionBenchmark.c \
+			PartitionedConvolution.c PortableFFT.c -lm
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "PartitionedConvolution.h"
+
+
+// Block size (latency) used for both partitionings.
+#define BlockSize	64
+
+// Largest partition used by the non-uniform partitioning.
+#define MaxBlockSize	8192
+
+// Samples to process for each timing; direct convolution uses fewer when slow.
+#define TimedSamples	(1ul << 20)
+
+
+static double Now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+
+static void Randomize(float *Buffer, unsigned long Length)
+{
+	unsigned long i;
+	for (i = 0; i < Length; ++i)
+		Buffer[i] = (float) rand() / RAND_MAX - .5f;
+}
+
+
+/*	Direct convolution, Output[n] = sum of Filter[k] * Signal[n-k], where
+	Signal points past FilterLength-1 samples of history.  The loops are
+	ordered so the inner loop runs over outputs, which vectorizes without
+	reassociating sums, and blocked so the outputs stay in cache.
+*/
+static void DirectConvolution(const float *Signal, const float *Filter,
+	float *Output, unsigned long FilterLength, unsigned long Length)
+{
+	enum { Chunk = 1024 };
+	unsigned long n0, k, n;
+
+	for (n0 = 0; n0 < Length; n0 += Chunk)
+	{
+		const unsigned long N = Length - n0 < Chunk ? Length - n0 : Chunk;
+		float *restrict y = Output + n0;
+
+		memset(y, 0, N * sizeof *y);
+		for (k = 0; k < FilterLength; ++k)
+		{
+			const float h = Filter[k];
+			const float *restrict x = Signal + n0 - k;
+			for (n = 0; n < N; ++n)
+				y[n] += h * x[n];
+		}
+	}
+}
+
+
+/*	Stream a signal through the engine in irregular pieces and compare
+	with direct convolution.  Return the largest error relative to the
+	largest output magnitude.
+*/
+static double Verify(unsigned long FilterLength, unsigned long MaxBlock)
+{
+	const unsigned long Length = 3 * FilterLength + 5 * MaxBlock;
+	float *Filter = malloc(FilterLength * sizeof *Filter);
+	float *Signal = calloc(FilterLength + Length, sizeof *Signal);
+	float *Expected = malloc(Length * sizeof *Expected);
+	float *Actual = malloc(Length * sizeof *Actual);
+	const unsigned long Latency = BlockSize;
+	double Error = 0, Peak = 0;
+	unsigned long i, Done;
+
+	PartitionedConvolution Engine;
+
+	Randomize(Filter, FilterLength);
+	Randomize(Signal + FilterLength, Length - Latency);
+	DirectConvolution(Signal + FilterLength, Filter, Expected,
+		FilterLength, Length);
+
+	Engine = PartitionedConvolutionCreate(Filter, FilterLength,
+		BlockSize, MaxBlock);
+	if (Engine == NULL)
+	{
+		fprintf(stderr, "Error, failed to create convolution engine.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// Use ragged piece sizes to exercise the buffering.
+	for (Done = 0; Done < Length; )
+	{
+		unsigned long n = 1 + rand() % (3 * BlockSize);
+		if (n > Length - Done)
+			n = Length - Done;
+		PartitionedConvolutionProcess(Engine, Signal + FilterLength + Done,
+			Actual + Done, n);
+		Done += n;
+	}
+
+	for (i = 0; i + Latency < Length; ++i)
+	{
+		const double d = fabs(Actual[i + Latency] - Expected[i]);
+		if (Error < d)
+			Error = d;
+		if (Peak < fabs(Expected[i]))
+			Peak = fabs(Expected[i]);
+	}
+
+	PartitionedConvolutionDestroy(Engine);
+	free(Filter);
+	free(Signal);
+	free(Expected);
+	free(Actual);
+
+	return Error / Peak;
+}
+
+
+// Return nanoseconds per sample for the partitioned engine.
+static double TimePartitioned(const float *Filter, unsigned long FilterLength,
+	unsigned long MaxBlock, const float *Signal)
+{
+	float Output[BlockSize];
+	double t0, t1;
+	unsigned long i;
+
+	PartitionedConvolution Engine = PartitionedConvolutionCreate(
+		Filter, FilterLength, BlockSize, MaxBlock);
+	if (Engine == NULL)
+	{
+		fprintf(stderr, "Error, failed to create convolution engine.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// Warm up through the filter's full length so every stage is running.
+	for (i = 0; i < FilterLength + MaxBlock; i += BlockSize)
+		PartitionedConvolutionProcessBlock(Engine, Signal, Output);
+
+	t0 = Now();
+	for (i = 0; i < TimedSamples; i += BlockSize)
+		PartitionedConvolutionProcessBlock(Engine, Signal + i, Output);
+	t1 = Now();
+
+	PartitionedConvolutionDestroy(Engine);
+
+	return (t1 - t0) / TimedSamples * 1e9;
+}
+
+
+// Return nanoseconds per sample for direct convolution.
+static double TimeDirect(const float *Filter, unsigned long FilterLength,
+	const float *Signal, float *Output)
+{
+	// Keep each timing to roughly 2**30 multiply-adds.
+	unsigned long Length = (1ul << 30) / FilterLength;
+	double t0, t1;
+
+	if (Length > TimedSamples)
+		Length = TimedSamples;
+	if (Length < 1024)
+		Length = 1024;
+
+	t0 = Now();
+	DirectConvolution(Signal + FilterLength, Filter, Output, FilterLength, Length);
+	t1 = Now();
+
+	return (t1 - t0) / Length * 1e9;
+}
+
+
+int main(void)
+{
+	static const unsigned long FilterLengths[] =
+	{
+		16, 32, 64, 128, 256, 512, 1024, 2048, 4096,
+		8192, 16384, 32768, 65536, 131072
+	};
+	const unsigned long LongestFilter = 131072;
+
+	float *Filter = malloc(LongestFilter * sizeof *Filter);
+	float *Signal = malloc((LongestFilter + TimedSamples) * sizeof *Signal);
+	float *Output = malloc(TimedSamples * sizeof *Output);
+	unsigned long f;
+
+	if (Filter == NULL || Signal == NULL || Output == NULL)
+	{
+		fprintf(stderr, "Error, failed to allocate memory.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	Randomize(Filter, LongestFilter);
+	Randomize(Signal, LongestFilter + TimedSamples);
+
+	printf("Verifying against direct convolution (relative error):\n");
+	printf("\t%8s %12s %12s\n", "taps", "uniform", "non-uniform");
+	{
+		static const unsigned long Lengths[] = { 1, 63, 64, 1000, 20000 };
+		for (f = 0; f < sizeof Lengths / sizeof *Lengths; ++f)
+			printf("\t%8lu %12.3g %12.3g\n", Lengths[f],
+				Verify(Lengths[f], BlockSize), Verify(Lengths[f], 1024));
+	}
+
+	printf("\nNanoseconds per sample with %d-sample blocks:\n", BlockSize);
+	printf("\t%8s %12s %12s %12s\n", "taps", "direct", "uniform", "non-uniform");
+	for (f = 0; f < sizeof FilterLengths / sizeof *FilterLengths; ++f)
+	{
+		const unsigned long L = FilterLengths[f];
+		const double Direct = TimeDirect(Filter, L, Signal, Output);
+		const double Uniform = TimePartitioned(Filter, L, BlockSize, Signal);
+		const double NonUniform = TimePartitioned(Filter, L, MaxBlockSize, Signal);
+		const double Best = Uniform < NonUniform ? Uniform : NonUniform;
+
+		printf("\t%8lu %12.2f %12.2f %12.2f %s\n", L, Direct, Uniform,
+			NonUniform, Best < Direct ? "(FFT faster)" : "");
+	}
+
+	free(Filter);
+	free(Signal);
+	free(Output);
+
+	return 0;
+}
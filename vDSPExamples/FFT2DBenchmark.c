@@ -0,0 +1,722 @@
+/*
+	    File: FFT2DBenchmark.c
+	Abstract: Verifies and times the portable two-dimensional FFT.
+	 Version: 1.2
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+	Inc. ("Apple") in consideration of your agreement to the following
+	terms, and your use, installation, modification or redistribution of
+	this Apple software constitutes acceptance of these terms.  If you do
+	not agree with these terms, please do not use, install, modify or
+	redistribute this Apple software.
+	
+	In consideration of your agreement to abide by the following terms, and
+	subject to these terms, Apple grants you a personal, non-exclusive
+	license, under Apple's copyrights in this original Apple software (the
+	"Apple Software"), to use, reproduce, modify and redistribute the Apple
+	Software, with or without modifications, in source and/or binary forms;
+	provided that if you redistribute the Apple Software in its entirety and
+	without modifications, you must retain this notice and the following
+	text and disclaimers in all such redistributions of the Apple Software.
+	Neither the name, trademarks, service marks or logos of Apple Inc. may
+	be used to endorse or promote products derived from the Apple Software
+	without specific prior written permission from Apple.  Except as
+	expressly stated in this notice, no other rights or licenses, express or
+	implied, are granted by Apple herein, including but not limited to any
+	patent rights that may be infringed by your derivative works or by other
+	works in which the Apple Software may be incorporated.
+	
+	The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+	MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+	THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+	FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+	OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+	
+	IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+	OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+	MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+	AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+	STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+	
+	Copyright (C) 2012 Apple Inc. All Rights Reserved.
+	
+
+	This program checks PortableFFT2D against a direct double-precision
+	DFT, using the relative error measure of CompareComplexVectors in
+	DemonstrateFFT2D.c, and checks that threads, batches, and strides do
+	not change a single bit of the results.  Then it times square real
+	transforms from 64*64 up to 8192*8192 (or 2**MaxLog2 on a side),
+	reporting the bandwidth the transform would need if each pass read and
+	wrote the data once, beside memcpy's, and times batches of small
+	images.  It uses only standard C, pthreads, and PortableFFT, so it
+	builds and runs on Linux as well as OS X:
+
+		cc -O3 -std=gnu99 -o FFT2DBenchmark FFT2DBenchmark.c \
+			PortableFFT2D.c PortableFFT.c -lm -lpthread
+
+		./FFT2DBenchmark [MaxLog2]
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "PortableFFT2D.h"
+
+
+#define TwoPi	6.283185307179586476925286766559
+
+// Largest base-two logarithm of either dimension used.
+#define MaxLog2N	13
+
+// Relative errors above this are reported as failures.
+#define Tolerance	1e-5
+
+// Threads used for the checks, enough to exercise the threaded paths on any machine.
+#define CheckThreads	4
+
+// Complex elements to transform for each timing.
+#define TimedElements	(1ul << 26)
+
+
+static int Failures = 0;
+
+
+static double Now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+
+static void Randomize(float *Buffer, unsigned long Length)
+{
+	unsigned long i;
+	for (i = 0; i < Length; ++i)
+		Buffer[i] = (float) rand() / RAND_MAX - .5f;
+}
+
+
+static void *Allocate(unsigned long Bytes)
+{
+	void *p = malloc(Bytes);
+	if (p == NULL)
+	{
+		fprintf(stderr, "Error, failed to allocate memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+
+static PortableFFT2DSetup CreateSetup(unsigned int Threads)
+{
+	PortableFFT2DSetup Setup = PortableFFT2DCreateSetup(MaxLog2N, Threads);
+	if (Setup == NULL)
+	{
+		fprintf(stderr, "Error, failed to create FFT setup.\n");
+		exit(EXIT_FAILURE);
+	}
+	return Setup;
+}
+
+
+/*	Return the relative error of Observed, as CompareComplexVectors in
+	DemonstrateFFT2D.c prints it, and count a failure if it is too big.
+*/
+static double CompareComplexVectors(const double *ExpectedRe,
+	const double *ExpectedIm, PortableSplitComplex Observed,
+	unsigned long Length)
+{
+	double Error = 0, Magnitude = 0, Relative;
+	unsigned long i;
+
+	for (i = 0; i < Length; ++i)
+	{
+		double re, im;
+
+		re = ExpectedRe[i];
+		im = ExpectedIm[i];
+		Magnitude += re*re + im*im;
+
+		re = ExpectedRe[i] - Observed.realp[i];
+		im = ExpectedIm[i] - Observed.imagp[i];
+		Error += re*re + im*im;
+	}
+
+	Relative = sqrt(Error / Magnitude);
+	if (!(Relative < Tolerance))
+		++Failures;
+	return Relative;
+}
+
+
+// Count a failure unless two split-complex vectors are identical.
+static const char *CompareBits(PortableSplitComplex a, PortableSplitComplex b,
+	unsigned long Length)
+{
+	if (memcmp(a.realp, b.realp, Length * sizeof *a.realp) == 0
+			&& memcmp(a.imagp, b.imagp, Length * sizeof *a.imagp) == 0)
+		return "identical";
+	++Failures;
+	return "DIFFERENT (FAILED)";
+}
+
+
+/*	Replace the N elements x[0], x[Stride], ... with their DFT, in double
+	precision.  Work holds 4*N doubles.
+*/
+static void DFT(double *re, double *im, unsigned long N, unsigned long Stride,
+	double *Work)
+{
+	double *c = Work, *s = Work + N, *yr = Work + 2*N, *yi = Work + 3*N;
+	unsigned long j, k;
+
+	for (k = 0; k < N; ++k)
+	{
+		c[k] = cos(TwoPi * k / N);
+		s[k] = sin(TwoPi * k / N);
+	}
+
+	for (k = 0; k < N; ++k)
+	{
+		double sr = 0, si = 0;
+		for (j = 0; j < N; ++j)
+		{
+			const unsigned long m = j * k % N;
+			const double xr = re[j * Stride], xi = im[j * Stride];
+			sr += xr * c[m] + xi * s[m];
+			si += xi * c[m] - xr * s[m];
+		}
+		yr[k] = sr;
+		yi[k] = si;
+	}
+
+	for (k = 0; k < N; ++k)
+	{
+		re[k * Stride] = yr[k];
+		im[k * Stride] = yi[k];
+	}
+}
+
+
+// Replace an R*C row-major matrix with its two-dimensional DFT.
+static void DFT2D(double *re, double *im, unsigned long R, unsigned long C)
+{
+	double *Work = Allocate(4 * (R > C ? R : C) * sizeof *Work);
+	unsigned long i;
+
+	for (i = 0; i < R; ++i)
+		DFT(re + i*C, im + i*C, C, 1, Work);
+	for (i = 0; i < C; ++i)
+		DFT(re + i, im + i, R, C, Work);
+
+	free(Work);
+}
+
+
+/*	Check the real transform of an R*C matrix against the DFT, packed as
+	vDSP_fft2d_zrip packs it, and check that the inverse restores the
+	signal.  Signal holds the real input in row-major order, or is NULL
+	for random input, and the forward result is returned through
+	ForwardError and InverseError.
+*/
+static void VerifyReal(PortableFFT2DSetup Setup, unsigned long Log2C,
+	unsigned long Log2R, const float *Signal, double *ForwardError,
+	double *InverseError)
+{
+	const unsigned long R = 1ul << Log2R, C = 1ul << Log2C, H = C/2, N = R*C;
+	double *Re = Allocate(N * sizeof *Re), *Im = Allocate(N * sizeof *Im);
+	double *ExpectedRe = Allocate(N/2 * sizeof *ExpectedRe);
+	double *ExpectedIm = Allocate(N/2 * sizeof *ExpectedIm);
+	float *Input = Allocate(N * sizeof *Input);
+	float *Memory = Allocate(N * sizeof *Memory);
+	PortableSplitComplex Observed = { Memory, Memory + N/2 };
+	unsigned long r, c, u;
+
+	if (Signal)
+		memcpy(Input, Signal, N * sizeof *Input);
+	else
+		Randomize(Input, N);
+
+	for (r = 0; r < R; ++r)
+		for (c = 0; c < H; ++c)
+		{
+			Observed.realp[r*H + c] = Input[r*C + 2*c];
+			Observed.imagp[r*H + c] = Input[r*C + 2*c + 1];
+		}
+
+	for (c = 0; c < N; ++c)
+	{
+		Re[c] = Input[c];
+		Im[c] = 0;
+	}
+	DFT2D(Re, Im, R, C);
+
+	// Pack twice the DFT as PortableFFT2D.h describes.
+	for (u = 0; u < R; ++u)
+		for (c = 1; c < H; ++c)
+		{
+			ExpectedRe[u*H + c] = 2 * Re[u*C + c];
+			ExpectedIm[u*H + c] = 2 * Im[u*C + c];
+		}
+	if (R == 1)
+	{
+		ExpectedRe[0] = 2 * Re[0];
+		ExpectedIm[0] = 2 * Re[H];
+	}
+	else
+	{
+		ExpectedRe[0] = 2 * Re[0];
+		ExpectedIm[0] = 2 * Re[H];
+		ExpectedRe[H] = 2 * Re[R/2*C];
+		ExpectedIm[H] = 2 * Re[R/2*C + H];
+		for (u = 1; u < R/2; ++u)
+		{
+			ExpectedRe[2*u*H]     = 2 * Re[u*C];
+			ExpectedRe[(2*u+1)*H] = 2 * Im[u*C];
+			ExpectedIm[2*u*H]     = 2 * Re[u*C + H];
+			ExpectedIm[(2*u+1)*H] = 2 * Im[u*C + H];
+		}
+	}
+
+	if (PortableFFT2D_zrip(Setup, &Observed, 1, 0, Log2C, Log2R,
+			kPortableFFTForward))
+		++Failures;
+	*ForwardError = CompareComplexVectors(ExpectedRe, ExpectedIm, Observed,
+		N/2);
+
+	if (PortableFFT2D_zrip(Setup, &Observed, 1, 0, Log2C, Log2R,
+			kPortableFFTInverse))
+		++Failures;
+	for (r = 0; r < R; ++r)
+		for (c = 0; c < H; ++c)
+		{
+			ExpectedRe[r*H + c] = 2. * N * Input[r*C + 2*c];
+			ExpectedIm[r*H + c] = 2. * N * Input[r*C + 2*c + 1];
+		}
+	*InverseError = CompareComplexVectors(ExpectedRe, ExpectedIm, Observed,
+		N/2);
+
+	free(Re);
+	free(Im);
+	free(ExpectedRe);
+	free(ExpectedIm);
+	free(Input);
+	free(Memory);
+}
+
+
+// Check the complex transform of an R*C matrix and its inverse.
+static void VerifyComplex(PortableFFT2DSetup Setup, unsigned long Log2C,
+	unsigned long Log2R, double *ForwardError, double *InverseError)
+{
+	const unsigned long N = 1ul << (Log2C + Log2R);
+	double *Re = Allocate(N * sizeof *Re), *Im = Allocate(N * sizeof *Im);
+	float *Input = Allocate(2 * N * sizeof *Input);
+	float *Memory = Allocate(2 * N * sizeof *Memory);
+	PortableSplitComplex Observed = { Memory, Memory + N };
+	unsigned long i;
+
+	Randomize(Input, 2 * N);
+	memcpy(Memory, Input, 2 * N * sizeof *Memory);
+	for (i = 0; i < N; ++i)
+	{
+		Re[i] = Input[i];
+		Im[i] = Input[N + i];
+	}
+	DFT2D(Re, Im, 1ul << Log2R, 1ul << Log2C);
+
+	if (PortableFFT2D_zip(Setup, &Observed, 1, 0, Log2C, Log2R,
+			kPortableFFTForward))
+		++Failures;
+	*ForwardError = CompareComplexVectors(Re, Im, Observed, N);
+
+	if (PortableFFT2D_zip(Setup, &Observed, 1, 0, Log2C, Log2R,
+			kPortableFFTInverse))
+		++Failures;
+	for (i = 0; i < N; ++i)
+	{
+		Re[i] = (double) N * Input[i];
+		Im[i] = (double) N * Input[N + i];
+	}
+	*InverseError = CompareComplexVectors(Re, Im, Observed, N);
+
+	free(Re);
+	free(Im);
+	free(Input);
+	free(Memory);
+}
+
+
+/*	Transform the same random data (2**Log2C columns of complex elements,
+	2**Log2R rows, Count matrices) four ways and require identical
+	results:  one matrix at a time on one thread; the same on several
+	threads; as one batch; and from a copy spread out with column, row,
+	and matrix strides.
+*/
+static void VerifyBits(PortableFFT2DSetup One, PortableFFT2DSetup Many,
+	int Real, unsigned long Log2C, unsigned long Log2R, unsigned long Count,
+	int Direction)
+{
+	const unsigned long C = 1ul << (Log2C - (Real ? 1 : 0)), R = 1ul << Log2R;
+	const unsigned long M = R * C, N = Count * M;
+	const long IC = 3, IR = 3 * C + 5, IM = R * IR + 7;
+	float *Memory[4];
+	PortableSplitComplex Data[4];
+	int (*zip)(PortableFFT2DSetup, const PortableSplitComplex *, long, long,
+		unsigned long, unsigned long, int)
+		= Real ? PortableFFT2D_zrip : PortableFFT2D_zip;
+	int (*zipm)(PortableFFT2DSetup, const PortableSplitComplex *, long, long,
+		long, unsigned long, unsigned long, unsigned long, int)
+		= Real ? PortableFFT2D_zripm : PortableFFT2D_zipm;
+	unsigned long i, m, r, c;
+	int Error = 0;
+
+	for (i = 0; i < 4; ++i)
+	{
+		const unsigned long Length = i < 3 ? N : Count * IM;
+		Memory[i] = Allocate(2 * Length * sizeof *Memory[i]);
+		Data[i].realp = Memory[i];
+		Data[i].imagp = Memory[i] + Length;
+	}
+
+	Randomize(Memory[0], 2 * N);
+	memcpy(Memory[1], Memory[0], 2 * N * sizeof *Memory[1]);
+	memcpy(Memory[2], Memory[0], 2 * N * sizeof *Memory[2]);
+	for (m = 0; m < Count; ++m)
+		for (r = 0; r < R; ++r)
+			for (c = 0; c < C; ++c)
+			{
+				const unsigned long j = m*IM + r*IR + c*IC, k = m*M + r*C + c;
+				Data[3].realp[j] = Data[0].realp[k];
+				Data[3].imagp[j] = Data[0].imagp[k];
+			}
+
+	for (m = 0; m < Count; ++m)
+	{
+		const PortableSplitComplex Matrix0 = { Data[0].realp + m*M, Data[0].imagp + m*M };
+		const PortableSplitComplex Matrix1 = { Data[1].realp + m*M, Data[1].imagp + m*M };
+		Error |= zip(One, &Matrix0, 1, 0, Log2C, Log2R, Direction);
+		Error |= zip(Many, &Matrix1, 1, 0, Log2C, Log2R, Direction);
+	}
+	Error |= zipm(Many, &Data[2], 1, 0, 0, Count, Log2C, Log2R, Direction);
+	Error |= zipm(Many, &Data[3], IC, IR, IM, Count, Log2C, Log2R, Direction);
+	if (Error)
+		++Failures;
+
+	// Gather the strided results for comparison.
+	for (m = 0; m < Count; ++m)
+		for (r = 0; r < R; ++r)
+			for (c = 0; c < C; ++c)
+			{
+				const unsigned long j = m*IM + r*IR + c*IC, k = m*M + r*C + c;
+				Data[3].realp[k] = Data[3].realp[j];
+				Data[3].imagp[k] = Data[3].imagp[j];
+			}
+
+	printf("\t%-7s %5lu*%-5lu %3lu %-8s %12s %12s %12s\n",
+		Real ? "zrip" : "zip", R, C << (Real ? 1 : 0), Count,
+		Direction == kPortableFFTForward ? "forward" : "inverse",
+		CompareBits(Data[0], Data[1], N), CompareBits(Data[0], Data[2], N),
+		CompareBits(Data[0], Data[3], N));
+
+	for (i = 0; i < 4; ++i)
+		free(Memory[i]);
+}
+
+
+/*	Check the two-cosine signal of DemonstrateFFT2D.c, whose transform is
+	known analytically.
+*/
+static double VerifyDemonstration(PortableFFT2DSetup Setup)
+{
+	const unsigned long Log2R = 5, Log2C = 6, R = 1ul << Log2R, C = 1ul << Log2C;
+	const unsigned long N = R * C;
+	const double
+		Frequency0R =  9,   Frequency1R =  6,
+		Frequency0C = 13,   Frequency1C = 11,
+		Phase0      =  0,   Phase1      =   .25;
+	float *Signal = Allocate(N * sizeof *Signal);
+	float *Memory = Allocate(N * sizeof *Memory);
+	double *ExpectedRe = calloc(N/2, sizeof *ExpectedRe);
+	double *ExpectedIm = calloc(N/2, sizeof *ExpectedIm);
+	PortableSplitComplex Observed = { Memory, Memory + N/2 };
+	unsigned long r, c;
+	double Error;
+
+	if (ExpectedRe == NULL || ExpectedIm == NULL)
+	{
+		fprintf(stderr, "Error, failed to allocate memory.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (r = 0; r < R; ++r)
+		for (c = 0; c < C; ++c)
+			Signal[r*C + c] =
+  cos((r*Frequency0R/R + c*Frequency0C/C + Phase0) * TwoPi)
++ cos((r*Frequency1R/R + c*Frequency1C/C + Phase1) * TwoPi);
+
+	for (r = 0; r < R; ++r)
+		for (c = 0; c < C/2; ++c)
+		{
+			Observed.realp[r*C/2 + c] = Signal[r*C + 2*c];
+			Observed.imagp[r*C/2 + c] = Signal[r*C + 2*c + 1];
+		}
+
+	if (PortableFFT2D_zrip(Setup, &Observed, 1, 0, Log2C, Log2R,
+			kPortableFFTForward))
+		++Failures;
+
+	r = Frequency0R;
+	c = Frequency0C;
+	ExpectedRe[r*C/2 + c] = N * cos(Phase0 * TwoPi);
+	ExpectedIm[r*C/2 + c] = N * sin(Phase0 * TwoPi);
+
+	r = Frequency1R;
+	c = Frequency1C;
+	ExpectedRe[r*C/2 + c] = N * cos(Phase1 * TwoPi);
+	ExpectedIm[r*C/2 + c] = N * sin(Phase1 * TwoPi);
+
+	Error = CompareComplexVectors(ExpectedRe, ExpectedIm, Observed, N/2);
+
+	free(Signal);
+	free(Memory);
+	free(ExpectedRe);
+	free(ExpectedIm);
+
+	return Error;
+}
+
+
+/*	Return seconds per forward real transform of a 2**Log2N square with
+	Setup, or 0 if memory is short.
+*/
+static double TimeReal(PortableFFT2DSetup Setup, unsigned long Log2N)
+{
+	const unsigned long N = 1ul << (2 * Log2N);
+	const unsigned long Iterations = TimedElements / N ? TimedElements / N : 1;
+	float *Memory = calloc(N, sizeof *Memory);
+	PortableSplitComplex Data = { Memory, Memory + N/2 };
+	double t0, t1;
+	unsigned long i;
+
+	if (Memory == NULL)
+		return 0;
+
+	/*	Transform zeros, as DemonstrateFFT2D.c does, so repeated
+		transforms cannot overflow or produce subnormal numbers.
+	*/
+	PortableFFT2D_zrip(Setup, &Data, 1, 0, Log2N, Log2N, kPortableFFTForward);
+
+	t0 = Now();
+	for (i = 0; i < Iterations; ++i)
+		PortableFFT2D_zrip(Setup, &Data, 1, 0, Log2N, Log2N,
+			kPortableFFTForward);
+	t1 = Now();
+
+	free(Memory);
+	return (t1 - t0) / Iterations;
+}
+
+
+// Return seconds to copy Bytes with memcpy, or 0 if memory is short.
+static double TimeCopy(unsigned long Bytes)
+{
+	const unsigned long Iterations = 4 * TimedElements * sizeof(float) / Bytes
+		? 4 * TimedElements * sizeof(float) / Bytes : 1;
+	char *a = malloc(Bytes), *b = malloc(Bytes);
+	double t0, t1;
+	unsigned long i;
+
+	if (a == NULL || b == NULL)
+	{
+		free(a);
+		free(b);
+		return 0;
+	}
+
+	memset(a, 0, Bytes);
+	memcpy(b, a, Bytes);
+
+	t0 = Now();
+	for (i = 0; i < Iterations; ++i)
+		memcpy(i & 1 ? a : b, i & 1 ? b : a, Bytes);
+	t1 = Now();
+
+	free(a);
+	free(b);
+	return (t1 - t0) / Iterations;
+}
+
+
+/*	Time Count 2**Log2N square real images transformed one call at a
+	time and in one batch, returning seconds per image for each.  The
+	two alternate and each keeps its best run, so both see the same
+	interference from the rest of the machine.
+*/
+static void TimeBatch(PortableFFT2DSetup Setup, unsigned long Log2N,
+	unsigned long Count, double *Loop, double *Batch)
+{
+	const unsigned long M = 1ul << (2 * Log2N), N = Count * M;
+	float *Memory = calloc(N, sizeof *Memory);
+	PortableSplitComplex Data = { Memory, Memory + N/2 };
+	unsigned long i, m;
+
+	if (Memory == NULL)
+	{
+		fprintf(stderr, "Error, failed to allocate memory.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// The first round warms up the caches and is not counted.
+	*Loop = *Batch = 0;
+	for (i = 0; i < 16; ++i)
+	{
+		double t0, t1, t2;
+
+		t0 = Now();
+		for (m = 0; m < Count; ++m)
+		{
+			const PortableSplitComplex Image =
+				{ Data.realp + m*M/2, Data.imagp + m*M/2 };
+			PortableFFT2D_zrip(Setup, &Image, 1, 0, Log2N, Log2N,
+				kPortableFFTForward);
+		}
+		t1 = Now();
+		PortableFFT2D_zripm(Setup, &Data, 1, 0, M/2, Count, Log2N, Log2N,
+			kPortableFFTForward);
+		t2 = Now();
+
+		if (i == 1 || (i > 1 && t1 - t0 < *Loop))
+			*Loop = t1 - t0;
+		if (i == 1 || (i > 1 && t2 - t1 < *Batch))
+			*Batch = t2 - t1;
+	}
+
+	*Loop /= Count;
+	*Batch /= Count;
+	free(Memory);
+}
+
+
+int main(int argc, char *argv[])
+{
+	static const unsigned long Sizes[][2] =
+	{
+		{ 1, 0 }, { 1, 1 }, { 2, 0 }, { 1, 4 }, { 4, 1 }, { 3, 3 },
+		{ 6, 5 }, { 5, 8 }, { 8, 6 }, { 9, 7 },
+	};
+	const unsigned long MaxLog2 = argc > 1 ? strtoul(argv[1], NULL, 0) : MaxLog2N;
+	PortableFFT2DSetup One = CreateSetup(1), Many = CreateSetup(CheckThreads);
+	PortableFFT2DSetup All = CreateSetup(0);
+	double Forward, Inverse;
+	unsigned int Threads;
+	unsigned long i;
+
+	if (MaxLog2 < 6 || MaxLog2 > MaxLog2N)
+	{
+		fprintf(stderr, "Usage: %s [MaxLog2], with MaxLog2 from 6 to %d.\n",
+			argv[0], MaxLog2N);
+		exit(EXIT_FAILURE);
+	}
+
+	printf("Verifying against a double-precision DFT (relative error):\n");
+	printf("\t%-7s %11s %12s %12s\n", "", "rows*cols", "forward", "inverse");
+	for (i = 0; i < sizeof Sizes / sizeof *Sizes; ++i)
+	{
+		VerifyReal(Many, Sizes[i][0], Sizes[i][1], NULL, &Forward, &Inverse);
+		printf("\t%-7s %5lu*%-5lu %12.3g %12.3g\n", "zrip",
+			1ul << Sizes[i][1], 1ul << Sizes[i][0], Forward, Inverse);
+	}
+	for (i = 0; i < sizeof Sizes / sizeof *Sizes; ++i)
+	{
+		VerifyComplex(Many, Sizes[i][0] - 1, Sizes[i][1], &Forward, &Inverse);
+		printf("\t%-7s %5lu*%-5lu %12.3g %12.3g\n", "zip",
+			1ul << Sizes[i][1], 1ul << (Sizes[i][0] - 1), Forward, Inverse);
+	}
+	printf("\tDemonstrateFFT2D.c's signal: %.3g\n", VerifyDemonstration(Many));
+
+	printf("\nComparing one thread with %d threads, batches, and strides:\n",
+		CheckThreads);
+	printf("\t%-7s %11s %3s %-8s %12s %12s %12s\n", "", "rows*cols",
+		"#", "", "threads", "batched", "strided");
+	VerifyBits(One, Many, 1, 10, 9, 1, kPortableFFTForward);
+	VerifyBits(One, Many, 1, 10, 9, 1, kPortableFFTInverse);
+	VerifyBits(One, Many, 0, 7, 10, 1, kPortableFFTForward);
+	VerifyBits(One, Many, 1, 8, 7, 3, kPortableFFTForward);
+	VerifyBits(One, Many, 0, 6, 6, 9, kPortableFFTInverse);
+	VerifyBits(One, Many, 1, 1, 3, 5, kPortableFFTForward);
+
+	Threads = PortableFFT2DThreads(All);
+	if (Threads == 1)
+		printf("\nForward real transforms of N*N elements on the one processor available:\n");
+	else
+		printf("\nForward real transforms of N*N elements, on one thread and on %u:\n",
+			Threads);
+	printf("\t%6s %10s %10s %10s", "N", "ms", "ns/elem", "GB/s");
+	if (Threads > 1)
+		printf(" %10s %10s %10s", "ms", "ns/elem", "GB/s");
+	printf("\n");
+	for (i = 6; i <= MaxLog2; ++i)
+	{
+		const unsigned long N = 1ul << (2 * i);
+		const double Single = TimeReal(One, i);
+		const double Threaded = Threads > 1 ? TimeReal(All, i) : Single;
+
+		if (Single == 0 || Threaded == 0)
+		{
+			printf("\t%6lu (not enough memory)\n", 1ul << i);
+			continue;
+		}
+
+		/*	Each pass reads and writes each real element, so 16 bytes
+			move per element if the data do not stay in cache.
+		*/
+		printf("\t%6lu %10.3f %10.3f %10.2f", 1ul << i,
+			Single * 1e3, Single / N * 1e9, 16e-9 * N / Single);
+		if (Threads > 1)
+			printf(" %10.3f %10.3f %10.2f",
+				Threaded * 1e3, Threaded / N * 1e9, 16e-9 * N / Threaded);
+		printf("\n");
+	}
+	{
+		const unsigned long Bytes = sizeof(float) << (2 * MaxLog2);
+		const double Copy = TimeCopy(Bytes);
+		if (Copy != 0)
+			printf("\tmemcpy of %lu MiB: %.2f GB/s (read plus write).\n",
+				Bytes >> 20, 2e-9 * Bytes / Copy);
+	}
+
+	/*	Compare a batch with the same transforms called one at a time.
+		This is only reported; timings are too noisy to fail on, so the
+		identity and accuracy checks above are the only gate.
+	*/
+	printf("\nMicroseconds per 64*64 real transform in a batch of 1024:\n");
+	printf("\t%12s %12s %12s\n", "one by one", "batched", "speedup");
+	{
+		double Loop, Batch;
+
+		TimeBatch(All, 6, 1024, &Loop, &Batch);
+		printf("\t%12.3f %12.3f %12.2f\n", Loop * 1e6, Batch * 1e6,
+			Batch != 0 ? Loop / Batch : 0.);
+	}
+
+	PortableFFT2DDestroySetup(One);
+	PortableFFT2DDestroySetup(Many);
+	PortableFFT2DDestroySetup(All);
+
+	if (Failures)
+	{
+		printf("\n%d checks FAILED.\n", Failures);
+		return EXIT_FAILURE;
+	}
+	printf("\nAll checks passed.\n");
+	return 0;
+}
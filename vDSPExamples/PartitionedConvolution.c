@@ -0,0 +1,484 @@
+/*
+	    File: PartitionedConvolution.c
+	Abstract: Streaming FFT convolution with uniformly or non-uniformly partitioned filters.
+	 Version: 1.2
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+	Inc. ("Apple") in consideration of your agreement to the following
+	terms, and your use, installation, modification or redistribution of
+	this Apple software constitutes acceptance of these terms.  If you do
+	not agree with these terms, please do not use, install, modify or
+	redistribute this Apple software.
+	
+	In consideration of your agreement to abide by the following terms, and
+	subject to these terms, Apple grants you a personal, non-exclusive
+	license, under Apple's copyrights in this original Apple software (the
+	"Apple Software"), to use, reproduce, modify and redistribute the Apple
+	Software, with or without modifications, in source and/or binary forms;
+	provided that if you redistribute the Apple Software in its entirety and
+	without modifications, you must retain this notice and the following
+	text and disclaimers in all such redistributions of the Apple Software.
+	Neither the name, trademarks, service marks or logos of Apple Inc. may
+	be used to endorse or promote products derived from the Apple Software
+	without specific prior written permission from Apple.  Except as
+	expressly stated in this notice, no other rights or licenses, express or
+	implied, are granted by Apple herein, including but not limited to any
+	patent rights that may be infringed by your derivative works or by other
+	works in which the Apple Software may be incorporated.
+	
+	The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+	MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+	THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+	FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+	OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+	
+	IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+	OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+	MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+	AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+	STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+	
+	Copyright (C) 2012 Apple Inc. All Rights Reserved.
+	
+
+	Each stage of the engine holds the precomputed spectra of its filter
+	partitions and a ring of the spectra of its most recent input
+	blocks.  When a stage's input block completes, the stage transforms
+	the last two blocks of input (overlap-save), multiplies and
+	accumulates across the delay line in the frequency domain,
+	transforms back, and adds the valid half of the result into an
+	output ring indexed by absolute sample time, at the position given
+	by the stage's offset into the filter.
+
+	The transforms use PortableFFT, whose real-transform packing matches
+	vDSP_fft_zrip, so the same code would work with vDSP_fft_zript
+	substituted.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "PartitionedConvolution.h"
+#include "PortableFFT.h"
+
+#if defined(__SSE__)
+	#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+#endif
+
+
+// Enough stages for block sizes doubling from 4 to 2**31.
+#define MaxStages	32
+
+
+typedef struct
+{
+	unsigned long BlockSize;	// Samples per partition; the FFT has twice this.
+	unsigned long Log2FFTLength;
+	unsigned long Offset;		// Index of the first filter tap in this stage.
+	unsigned long Partitions;
+
+	/*	Each spectrum is BlockSize packed complex elements, the real parts
+		followed by the imaginary parts, so partition p occupies elements
+		[2*BlockSize*p, 2*BlockSize*(p+1)).
+	*/
+	float *FilterSpectra;
+	float *InputSpectra;		// Ring of the last Partitions input spectra.
+	unsigned long Newest;		// Ring index of the newest input spectrum.
+} Stage;
+
+
+struct PartitionedConvolutionStruct
+{
+	unsigned long BlockSize;
+	unsigned long StageCount;
+	Stage Stages[MaxStages];
+
+	PortableFFTSetup Setup;
+
+	// Time-domain input history, long enough for the largest stage.
+	float *InputRing;
+	unsigned long InputMask;
+
+	/*	Output accumulator.  Slot t & OutputMask holds the partial sum for
+		output sample t, for every t from the start of the current block
+		to the farthest point any stage writes ahead.
+	*/
+	float *OutputRing;
+	unsigned long OutputMask;
+
+	// Scratch for one transform of the largest stage.
+	float *Accumulator, *Temp;
+
+	// Number of samples consumed by PartitionedConvolutionProcessBlock.
+	unsigned long long Time;
+
+	// Buffers for PartitionedConvolutionProcess.
+	float *FifoInput, *FifoOutput;
+	unsigned long FifoFill;
+};
+
+
+static int IsPowerOfTwo(unsigned long x)
+{
+	return x != 0 && (x & (x - 1)) == 0;
+}
+
+
+static unsigned long Log2(unsigned long x)
+{
+	unsigned long l = 0;
+	while ((1ul << l) < x)
+		++l;
+	return l;
+}
+
+
+/*	Copy 2*n consecutive real samples into split-complex form, even
+	elements to realp and odd ones to imagp, as vDSP_ctoz does.
+*/
+static void Deinterleave(const float *restrict Source,
+	float *restrict realp, float *restrict imagp, unsigned long n)
+{
+	unsigned long j;
+	for (j = 0; j < n; ++j)
+	{
+		realp[j] = Source[2*j+0];
+		imagp[j] = Source[2*j+1];
+	}
+}
+
+
+/*	Accumulate, for k < n, Sum[k] += X[k] * H[k] over packed spectra
+	(real parts in the first n elements, imaginary parts in the next n).
+
+	Element 0 is not a complex number:  it packs the real DC and Nyquist
+	terms, which multiply separately.  The vector loop treats it like the
+	others and the caller's result is fixed up afterward, so the loop
+	needs no special case.  n must be a multiple of four.
+*/
+static void MultiplyAccumulate(float *restrict Sum,
+	const float *restrict X, const float *restrict H, unsigned long n)
+{
+	float *restrict sr = Sum, *restrict si = Sum + n;
+	const float *restrict xr = X, *restrict xi = X + n;
+	const float *restrict hr = H, *restrict hi = H + n;
+	const float DC = sr[0] + xr[0] * hr[0], Nyquist = si[0] + xi[0] * hi[0];
+	unsigned long k;
+
+#if defined(__SSE__)
+	for (k = 0; k < n; k += 4)
+	{
+		const __m128 ar = _mm_loadu_ps(xr + k), ai = _mm_loadu_ps(xi + k);
+		const __m128 br = _mm_loadu_ps(hr + k), bi = _mm_loadu_ps(hi + k);
+		_mm_storeu_ps(sr + k, _mm_add_ps(_mm_loadu_ps(sr + k),
+			_mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi))));
+		_mm_storeu_ps(si + k, _mm_add_ps(_mm_loadu_ps(si + k),
+			_mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br))));
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	for (k = 0; k < n; k += 4)
+	{
+		const float32x4_t ar = vld1q_f32(xr + k), ai = vld1q_f32(xi + k);
+		const float32x4_t br = vld1q_f32(hr + k), bi = vld1q_f32(hi + k);
+		vst1q_f32(sr + k, vmlsq_f32(vmlaq_f32(vld1q_f32(sr + k), ar, br), ai, bi));
+		vst1q_f32(si + k, vmlaq_f32(vmlaq_f32(vld1q_f32(si + k), ar, bi), ai, br));
+	}
+#else
+	for (k = 0; k < n; ++k)
+	{
+		sr[k] += xr[k] * hr[k] - xi[k] * hi[k];
+		si[k] += xr[k] * hi[k] + xi[k] * hr[k];
+	}
+#endif
+
+	sr[0] = DC;
+	si[0] = Nyquist;
+}
+
+
+// Transform the input or filter block in Spectrum, of 2*BlockSize samples.
+static void Forward(PartitionedConvolution Engine, const Stage *S,
+	float *Spectrum)
+{
+	const PortableSplitComplex Data = { Spectrum, Spectrum + S->BlockSize };
+	const PortableSplitComplex Temp = { Engine->Temp, Engine->Temp + S->BlockSize };
+	PortableFFT_zript(Engine->Setup, &Data, &Temp, S->Log2FFTLength,
+		kPortableFFTForward);
+}
+
+
+// Run a stage whose input block has just completed.
+static void RunStage(PartitionedConvolution Engine, Stage *S)
+{
+	const unsigned long B = S->BlockSize, Half = B / 2;
+	const unsigned long long Start = Engine->Time - 2 * B;
+	float *Spectrum, *Sum = Engine->Accumulator;
+	unsigned long p, j, Slot;
+
+	// Advance the delay line, overwriting the oldest spectrum.
+	S->Newest = S->Newest + 1 == S->Partitions ? 0 : S->Newest + 1;
+	Spectrum = S->InputSpectra + 2 * B * S->Newest;
+
+	/*	Gather the last 2*B input samples.  Each half is contiguous in the
+		ring because the ring length and Start are multiples of B.
+	*/
+	Deinterleave(Engine->InputRing + (Start & Engine->InputMask),
+		Spectrum, Spectrum + B, Half);
+	Deinterleave(Engine->InputRing + ((Start + B) & Engine->InputMask),
+		Spectrum + Half, Spectrum + B + Half, Half);
+	Forward(Engine, S, Spectrum);
+
+	// Sum the products of each partition with the input it applies to.
+	memset(Sum, 0, 2 * B * sizeof *Sum);
+	for (p = 0, Slot = S->Newest; p < S->Partitions; ++p)
+	{
+		MultiplyAccumulate(Sum, S->InputSpectra + 2 * B * Slot,
+			S->FilterSpectra + 2 * B * p, B);
+		Slot = Slot == 0 ? S->Partitions - 1 : Slot - 1;
+	}
+
+	// Back to the time domain.  The filter spectra include the scaling.
+	{
+		const PortableSplitComplex Data = { Sum, Sum + B };
+		const PortableSplitComplex Temp = { Engine->Temp, Engine->Temp + B };
+		PortableFFT_zript(Engine->Setup, &Data, &Temp, S->Log2FFTLength,
+			kPortableFFTInverse);
+	}
+
+	/*	The second half of the circular convolution is the linear
+		convolution of the newest block with this stage's taps.  Those
+		outputs belong at Time - B + Offset, which is never before the
+		start of the current block.
+	*/
+	{
+		const unsigned long long Base = Engine->Time - B + S->Offset;
+		const unsigned long Mask = Engine->OutputMask;
+		float *restrict Output = Engine->OutputRing;
+		for (j = 0; j < Half; ++j)
+		{
+			Output[(Base + 2*j+0) & Mask] += Sum[Half + j];
+			Output[(Base + 2*j+1) & Mask] += Sum[B + Half + j];
+		}
+	}
+}
+
+
+PartitionedConvolution PartitionedConvolutionCreate(
+	const float *Filter, unsigned long FilterLength,
+	unsigned long BlockSize, unsigned long MaxBlockSize)
+{
+	PartitionedConvolution Engine;
+	unsigned long Offset, B, s, p, Reach, LargestBlock;
+
+	if (Filter == NULL || FilterLength == 0
+		|| !IsPowerOfTwo(BlockSize) || BlockSize < 4
+		|| !IsPowerOfTwo(MaxBlockSize) || MaxBlockSize < BlockSize)
+		return NULL;
+
+	Engine = calloc(1, sizeof *Engine);
+	if (Engine == NULL)
+		return NULL;
+	Engine->BlockSize = BlockSize;
+
+	/*	Lay out the stages:  two partitions of each block size below
+		MaxBlockSize, then as many of MaxBlockSize as the rest of the
+		filter needs.  With this doubling, stage s starts 2*(B(s) - B(0))
+		taps in, which satisfies the requirement Offset >= B(s) - B(0).
+	*/
+	for (Offset = 0, B = BlockSize, Reach = BlockSize, LargestBlock = 0;
+		Offset < FilterLength; B *= 2)
+	{
+		Stage *S = &Engine->Stages[Engine->StageCount++];
+		const unsigned long Needed = (FilterLength - Offset + B - 1) / B;
+
+		S->BlockSize = B;
+		S->Log2FFTLength = Log2(2 * B);
+		S->Offset = Offset;
+		S->Partitions = B < MaxBlockSize && Needed > 2 ? 2 : Needed;
+		S->Newest = S->Partitions - 1;
+
+		Offset += S->Partitions * B;
+		LargestBlock = B;
+		if (Reach < S->Offset + B)
+			Reach = S->Offset + B;
+	}
+
+	Engine->Setup = PortableFFTCreateSetup(Log2(2 * LargestBlock));
+
+	Engine->InputMask = 2 * LargestBlock - 1;
+	Engine->OutputMask = (1ul << Log2(Reach)) - 1;
+
+	Engine->InputRing   = calloc(Engine->InputMask + 1, sizeof *Engine->InputRing);
+	Engine->OutputRing  = calloc(Engine->OutputMask + 1, sizeof *Engine->OutputRing);
+	Engine->Accumulator = malloc(2 * LargestBlock * sizeof *Engine->Accumulator);
+	Engine->Temp        = malloc(2 * LargestBlock * sizeof *Engine->Temp);
+	Engine->FifoInput   = calloc(BlockSize, sizeof *Engine->FifoInput);
+	Engine->FifoOutput  = calloc(BlockSize, sizeof *Engine->FifoOutput);
+
+	if (Engine->Setup == NULL || Engine->InputRing == NULL
+		|| Engine->OutputRing == NULL || Engine->Accumulator == NULL
+		|| Engine->Temp == NULL
+		|| Engine->FifoInput == NULL || Engine->FifoOutput == NULL)
+	{
+		PartitionedConvolutionDestroy(Engine);
+		return NULL;
+	}
+
+	// Precompute the filter spectra.
+	for (s = 0; s < Engine->StageCount; ++s)
+	{
+		Stage *S = &Engine->Stages[s];
+		const unsigned long B = S->BlockSize;
+
+		/*	A forward and inverse real FFT of length 2*B scale by 4*B, and
+			the forward transforms of both the signal and the filter are
+			doubled, so fold 1 / (8*B) into the filter.
+		*/
+		const float Scale = 1.f / (8 * B);
+
+		S->FilterSpectra = calloc(2 * B * S->Partitions, sizeof *S->FilterSpectra);
+		S->InputSpectra  = calloc(2 * B * S->Partitions, sizeof *S->InputSpectra);
+		if (S->FilterSpectra == NULL || S->InputSpectra == NULL)
+		{
+			PartitionedConvolutionDestroy(Engine);
+			return NULL;
+		}
+
+		for (p = 0; p < S->Partitions; ++p)
+		{
+			float *Spectrum = S->FilterSpectra + 2 * B * p;
+			const unsigned long First = S->Offset + p * B;
+			const unsigned long Count =
+				FilterLength - First < B ? FilterLength - First : B;
+			unsigned long k;
+
+			/*	Taps go in the first half of the FFT block and zeros in
+				the second; use the scratch buffer to pad and interleave.
+			*/
+			memset(Engine->Accumulator, 0, 2 * B * sizeof *Engine->Accumulator);
+			memcpy(Engine->Accumulator, Filter + First, Count * sizeof *Filter);
+			Deinterleave(Engine->Accumulator, Spectrum, Spectrum + B, B);
+			Forward(Engine, S, Spectrum);
+
+			for (k = 0; k < 2 * B; ++k)
+				Spectrum[k] *= Scale;
+		}
+	}
+
+	return Engine;
+}
+
+
+void PartitionedConvolutionDestroy(PartitionedConvolution Engine)
+{
+	unsigned long s;
+
+	if (Engine == NULL)
+		return;
+
+	for (s = 0; s < Engine->StageCount; ++s)
+	{
+		free(Engine->Stages[s].FilterSpectra);
+		free(Engine->Stages[s].InputSpectra);
+	}
+	PortableFFTDestroySetup(Engine->Setup);
+	free(Engine->InputRing);
+	free(Engine->OutputRing);
+	free(Engine->Accumulator);
+	free(Engine->Temp);
+	free(Engine->FifoInput);
+	free(Engine->FifoOutput);
+	free(Engine);
+}
+
+
+void PartitionedConvolutionProcessBlock(PartitionedConvolution Engine,
+	const float *Input, float *Output)
+{
+	const unsigned long B = Engine->BlockSize;
+	float *Slot;
+	unsigned long s;
+
+	memcpy(Engine->InputRing + (Engine->Time & Engine->InputMask), Input,
+		B * sizeof *Input);
+	Engine->Time += B;
+
+	// Stage block sizes are multiples of one another, so test in order.
+	for (s = 0; s < Engine->StageCount; ++s)
+	{
+		Stage *S = &Engine->Stages[s];
+		if (Engine->Time % S->BlockSize != 0)
+			break;
+		RunStage(Engine, S);
+	}
+
+	// Every stage has now contributed to this block; hand it out and clear it.
+	Slot = Engine->OutputRing + ((Engine->Time - B) & Engine->OutputMask);
+	memcpy(Output, Slot, B * sizeof *Output);
+	memset(Slot, 0, B * sizeof *Slot);
+}
+
+
+void PartitionedConvolutionProcess(PartitionedConvolution Engine,
+	const float *Input, float *Output, unsigned long Length)
+{
+	const unsigned long B = Engine->BlockSize;
+
+	while (Length)
+	{
+		unsigned long n = B - Engine->FifoFill;
+		if (Length < n)
+			n = Length;
+
+		/*	Exchange input for output from the previous block.  Copy via
+			the end of FifoInput first so Input and Output may alias.
+		*/
+		memcpy(Engine->FifoInput + Engine->FifoFill, Input, n * sizeof *Input);
+		memcpy(Output, Engine->FifoOutput + Engine->FifoFill, n * sizeof *Output);
+
+		Engine->FifoFill += n;
+		Input += n;
+		Output += n;
+		Length -= n;
+
+		if (Engine->FifoFill == B)
+		{
+			PartitionedConvolutionProcessBlock(Engine,
+				Engine->FifoInput, Engine->FifoOutput);
+			Engine->FifoFill = 0;
+		}
+	}
+}
+
+
+unsigned long PartitionedConvolutionLatency(PartitionedConvolution Engine)
+{
+	return Engine->BlockSize;
+}
+
+
+void PartitionedConvolutionReset(PartitionedConvolution Engine)
+{
+	unsigned long s;
+
+	for (s = 0; s < Engine->StageCount; ++s)
+	{
+		Stage *S = &Engine->Stages[s];
+		memset(S->InputSpectra, 0,
+			2 * S->BlockSize * S->Partitions * sizeof *S->InputSpectra);
+		S->Newest = S->Partitions - 1;
+	}
+	memset(Engine->InputRing, 0,
+		(Engine->InputMask + 1) * sizeof *Engine->InputRing);
+	memset(Engine->OutputRing, 0,
+		(Engine->OutputMask + 1) * sizeof *Engine->OutputRing);
+	memset(Engine->FifoInput, 0, Engine->BlockSize * sizeof *Engine->FifoInput);
+	memset(Engine->FifoOutput, 0, Engine->BlockSize * sizeof *Engine->FifoOutput);
+	Engine->FifoFill = 0;
+	Engine->Time = 0;
+}
@@ -0,0 +1,137 @@
+/*
+	    File: PartitionedConvolution.h
+	Abstract: Streaming FFT convolution with uniformly or non-uniformly partitioned filters.
+	 Version: 1.2
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+	Inc. ("Apple") in consideration of your agreement to the following
+	terms, and your use, installation, modification or redistribution of
+	this Apple software constitutes acceptance of these terms.  If you do
+	not agree with these terms, please do not use, install, modify or
+	redistribute this Apple software.
+	
+	In consideration of your agreement to abide by the following terms, and
+	subject to these terms, Apple grants you a personal, non-exclusive
+	license, under Apple's copyrights in this original Apple software (the
+	"Apple Software"), to use, reproduce, modify and redistribute the Apple
+	Software, with or without modifications, in source and/or binary forms;
+	provided that if you redistribute the Apple Software in its entirety and
+	without modifications, you must retain this notice and the following
+	text and disclaimers in all such redistributions of the Apple Software.
+	Neither the name, trademarks, service marks or logos of Apple Inc. may
+	be used to endorse or promote products derived from the Apple Software
+	without specific prior written permission from Apple.  Except as
+	expressly stated in this notice, no other rights or licenses, express or
+	implied, are granted by Apple herein, including but not limited to any
+	patent rights that may be infringed by your derivative works or by other
+	works in which the Apple Software may be incorporated.
+	
+	The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+	MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+	THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+	FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+	OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+	
+	IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+	OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+	MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+	AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+	STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+	
+	Copyright (C) 2012 Apple Inc. All Rights Reserved.
+	
+
+	This module declares a convolution engine for long filters, such as
+	reverberation impulse responses or matched filters of 100,000 taps
+	or more, where the direct form used by vDSP_conv (see
+	DemonstrateConvolution.c) costs one multiply-add per filter tap per
+	output sample.
+*/
+
+#ifndef __PARTITIONED_CONVOLUTION__
+#define __PARTITIONED_CONVOLUTION__
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+
+/*	The filter is split into partitions that are convolved with the
+	signal by overlap-save FFT convolution.  Each partition's spectrum is
+	computed once, when the engine is created, and the spectra of past
+	input blocks are kept in a frequency-domain delay line, so each block
+	of input costs one forward FFT, one complex multiply-accumulate per
+	partition, and one inverse FFT.
+
+	BlockSize sets the latency:  it is the number of samples passed to
+	PartitionedConvolutionProcessBlock.  MaxBlockSize selects the
+	partitioning:
+
+		If MaxBlockSize equals BlockSize, all partitions have BlockSize
+		taps (uniform partitioning).  The cost per sample grows linearly
+		with the filter length, but much more slowly than direct
+		convolution.
+
+		If MaxBlockSize is larger, the head of the filter uses two
+		partitions of BlockSize taps, followed by two partitions of twice
+		that, and so on up to MaxBlockSize, which is then used for the
+		rest of the filter (non-uniform partitioning).  The latency is
+		still BlockSize, but the long tail of the filter is processed
+		with large, efficient FFTs.  Each stage starts at least its block
+		size minus BlockSize taps into the filter, which is what lets its
+		result arrive in time.
+
+	BlockSize and MaxBlockSize must be powers of two, at least four, with
+	BlockSize <= MaxBlockSize.
+
+	Large partitions are computed synchronously in the call in which their
+	input block completes, so those calls take longer than the others.  A
+	real-time audio host that cannot absorb that would move the stages
+	with large blocks to a lower-priority thread; their start offsets
+	already leave them a full block of slack to finish in.
+*/
+typedef struct PartitionedConvolutionStruct *PartitionedConvolution;
+
+// Return NULL if the arguments are invalid or memory is not available.
+PartitionedConvolution PartitionedConvolutionCreate(
+	const float *Filter, unsigned long FilterLength,
+	unsigned long BlockSize, unsigned long MaxBlockSize);
+
+void PartitionedConvolutionDestroy(PartitionedConvolution Engine);
+
+/*	Consume exactly BlockSize input samples and produce BlockSize output
+	samples.  Output sample i is
+
+		sum over k of Filter[k] * Input[i - k],
+
+	including contributions of the input samples in this same block, so
+	the only latency is that of collecting a block.  Input and Output may
+	be the same array.
+*/
+void PartitionedConvolutionProcessBlock(PartitionedConvolution Engine,
+	const float *Input, float *Output);
+
+/*	Consume and produce any number of samples.  Samples are buffered
+	internally until a block is complete, so the output is delayed by
+	BlockSize samples relative to PartitionedConvolutionProcessBlock.
+	Input and Output may be the same array.
+*/
+void PartitionedConvolutionProcess(PartitionedConvolution Engine,
+	const float *Input, float *Output, unsigned long Length);
+
+// Return the latency of PartitionedConvolutionProcess, in samples.
+unsigned long PartitionedConvolutionLatency(PartitionedConvolution Engine);
+
+// Clear the signal history, keeping the filter.
+void PartitionedConvolutionReset(PartitionedConvolution Engine);
+
+
+#ifdef __cplusplus
+	}
+#endif
+
+
+#endif
@@ -0,0 +1,535 @@
+/*
+	    File: PortableFFT.c
+	Abstract: Portable radix-2 FFT with vDSP-compatible split-complex packing.
+	 Version: 1.2
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+	Inc. ("Apple") in consideration of your agreement to the following
+	terms, and your use, installation, modification or redistribution of
+	this Apple software constitutes acceptance of these terms.  If you do
+	not agree with these terms, please do not use, install, modify or
+	redistribute this Apple software.
+	
+	In consideration of your agreement to abide by the following terms, and
+	subject to these terms, Apple grants you a personal, non-exclusive
+	license, under Apple's copyrights in this original Apple software (the
+	"Apple Software"), to use, reproduce, modify and redistribute the Apple
+	Software, with or without modifications, in source and/or binary forms;
+	provided that if you redistribute the Apple Software in its entirety and
+	without modifications, you must retain this notice and the following
+	text and disclaimers in all such redistributions of the Apple Software.
+	Neither the name, trademarks, service marks or logos of Apple Inc. may
+	be used to endorse or promote products derived from the Apple Software
+	without specific prior written permission from Apple.  Except as
+	expressly stated in this notice, no other rights or licenses, express or
+	implied, are granted by Apple herein, including but not limited to any
+	patent rights that may be infringed by your derivative works or by other
+	works in which the Apple Software may be incorporated.
+	
+	The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+	MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+	THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+	FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+	OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+	
+	IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+	OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+	MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+	AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+	STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+	
+	Copyright (C) 2012 Apple Inc. All Rights Reserved.
+	
+
+	The complex transform is a Stockham autosort FFT, in radix-4 passes
+	with one radix-2 pass at the end when the length is an odd power of
+	two.  Each pass reads one buffer and writes the other, so no
+	bit-reversal permutation is needed, and once the butterfly span
+	reaches a few elements the innermost loop runs over consecutive
+	elements of both halves of the split-complex arrays.  That loop is
+	written with SSE or NEON vectors, four butterflies at a time;
+	interleaved transforms (PortableFFT_zipmt and PortableFFT_zripmt)
+	start with a span of the number of transforms, so a group of four
+	or more runs in vectors from the first pass on.
+
+	The real transform packs the signal into a half-length complex
+	vector, transforms that, and separates the even and odd halves with
+	one more pass of twiddle factors, exactly as vDSP_fft_zrip does.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PortableFFT.h"
+
+
+/*	Four-lane vectors where the compiler offers them, otherwise single
+	floats, so the butterflies below are written once.  Multiplies and
+	adds are kept separate (no fused multiply-add) so each lane rounds
+	exactly as the scalar code for leftover elements does.
+*/
+#if defined(__SSE__)
+	#include <xmmintrin.h>
+	typedef __m128 Vector;
+	#define VectorLanes		4
+	#define VectorLoad		_mm_loadu_ps
+	#define VectorStore		_mm_storeu_ps
+	#define VectorSplat		_mm_set1_ps
+	#define VectorAdd		_mm_add_ps
+	#define VectorSub		_mm_sub_ps
+	#define VectorMul		_mm_mul_ps
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	typedef float32x4_t Vector;
+	#define VectorLanes		4
+	#define VectorLoad		vld1q_f32
+	#define VectorStore		vst1q_f32
+	#define VectorSplat		vdupq_n_f32
+	#define VectorAdd		vaddq_f32
+	#define VectorSub		vsubq_f32
+	#define VectorMul		vmulq_f32
+#else
+	typedef float Vector;
+	#define VectorLanes		1
+	#define VectorLoad(p)		(*(p))
+	#define VectorStore(p, v)	(*(p) = (v))
+	#define VectorSplat(x)		(x)
+	#define VectorAdd(a, b)		((a) + (b))
+	#define VectorSub(a, b)		((a) - (b))
+	#define VectorMul(a, b)		((a) * (b))
+#endif
+
+
+struct PortableFFTSetupStruct
+{
+	unsigned long Log2N;
+
+	/*	Cosine[k] + i * Sine[k] = exp(-2 * pi * i * k / 2**Log2N), for
+		0 <= k < 3 * 2**Log2N / 4, the largest power a radix-4 pass
+		needs.  Smaller transforms use every 2**j-th element.
+	*/
+	float *Cosine, *Sine;
+};
+
+
+PortableFFTSetup PortableFFTCreateSetup(unsigned long Log2N)
+{
+	const unsigned long N = 1ul << Log2N, Size = N - N / 4;
+	unsigned long k;
+
+	PortableFFTSetup Setup = malloc(sizeof *Setup);
+	if (Setup == NULL)
+		return NULL;
+
+	Setup->Log2N = Log2N;
+	Setup->Cosine = malloc(Size * sizeof *Setup->Cosine);
+	Setup->Sine   = malloc(Size * sizeof *Setup->Sine);
+	if (Setup->Cosine == NULL || Setup->Sine == NULL)
+	{
+		PortableFFTDestroySetup(Setup);
+		return NULL;
+	}
+
+	// Compute the table in double precision so the float values are correctly rounded.
+	for (k = 0; k < Size; ++k)
+	{
+		const double Angle = -2 * M_PI * (double) k / (double) N;
+		Setup->Cosine[k] = cos(Angle);
+		Setup->Sine[k]   = sin(Angle);
+	}
+
+	return Setup;
+}
+
+
+void PortableFFTDestroySetup(PortableFFTSetup Setup)
+{
+	if (Setup == NULL)
+		return;
+	free(Setup->Cosine);
+	free(Setup->Sine);
+	free(Setup);
+}
+
+
+/*	One radix-2 Stockham pass over n-element sub-transforms at stride s:
+	for 0 <= p < n/2 and 0 <= q < s,
+
+		y[q + s*(2p)]   =  x[q + s*p] + x[q + s*(p + n/2)]
+		y[q + s*(2p+1)] = (x[q + s*p] - x[q + s*(p + n/2)]) * w**p,
+
+	where w = exp(-+ 2 pi i / n).  TwiddleStride converts w**p into an
+	index into the setup's table.
+*/
+static void Radix2Pass(
+	const float *restrict xr, const float *restrict xi,
+	float *restrict yr, float *restrict yi,
+	unsigned long n, unsigned long s,
+	const float *restrict Cosine, const float *restrict Sine,
+	unsigned long TwiddleStride, float SineSign)
+{
+	const unsigned long m = n / 2, Vectors = s - s % VectorLanes;
+	unsigned long p, q;
+
+	for (p = 0; p < m; ++p)
+	{
+		const float wr = Cosine[p * TwiddleStride];
+		const float wi = SineSign * Sine[p * TwiddleStride];
+		const Vector vwr = VectorSplat(wr), vwi = VectorSplat(wi);
+		const float *restrict ar = xr + s*p,     *restrict ai = xi + s*p;
+		const float *restrict br = xr + s*(p+m), *restrict bi = xi + s*(p+m);
+		float *restrict sr = yr + s*(2*p),   *restrict si = yi + s*(2*p);
+		float *restrict dr = yr + s*(2*p+1), *restrict di = yi + s*(2*p+1);
+
+		// Unit-stride loop over q, VectorLanes butterflies at a time.
+		for (q = 0; q < Vectors; q += VectorLanes)
+		{
+			const Vector Ar = VectorLoad(ar + q), Ai = VectorLoad(ai + q);
+			const Vector Br = VectorLoad(br + q), Bi = VectorLoad(bi + q);
+			const Vector tr = VectorSub(Ar, Br), ti = VectorSub(Ai, Bi);
+			VectorStore(sr + q, VectorAdd(Ar, Br));
+			VectorStore(si + q, VectorAdd(Ai, Bi));
+			VectorStore(dr + q, VectorSub(VectorMul(tr, vwr), VectorMul(ti, vwi)));
+			VectorStore(di + q, VectorAdd(VectorMul(tr, vwi), VectorMul(ti, vwr)));
+		}
+
+		for (; q < s; ++q)
+		{
+			const float tr = ar[q] - br[q], ti = ai[q] - bi[q];
+			sr[q] = ar[q] + br[q];
+			si[q] = ai[q] + bi[q];
+			dr[q] = tr * wr - ti * wi;
+			di[q] = tr * wi + ti * wr;
+		}
+	}
+}
+
+
+/*	One radix-4 Stockham pass, the same as two radix-2 passes with half
+	the loads and stores:  for 0 <= p < n/4 and 0 <= q < s, with a, b,
+	c, and d the elements x[q + s*(p + k*n/4)] for k = 0 to 3,
+
+		y[q + s*(4p)]   = ((a + c) +      (b + d))
+		y[q + s*(4p+1)] = ((a - c) -+ i * (b - d)) * w**p
+		y[q + s*(4p+2)] = ((a + c) -      (b + d)) * w**(2p)
+		y[q + s*(4p+3)] = ((a - c) +- i * (b - d)) * w**(3p).
+*/
+static void Radix4Pass(
+	const float *restrict xr, const float *restrict xi,
+	float *restrict yr, float *restrict yi,
+	unsigned long n, unsigned long s,
+	const float *restrict Cosine, const float *restrict Sine,
+	unsigned long TwiddleStride, float SineSign)
+{
+	const unsigned long m = n / 4, Vectors = s - s % VectorLanes;
+	const Vector vSineSign = VectorSplat(SineSign);
+	unsigned long p, q;
+
+	for (p = 0; p < m; ++p)
+	{
+		const float w1r = Cosine[1*p * TwiddleStride];
+		const float w1i = SineSign * Sine[1*p * TwiddleStride];
+		const float w2r = Cosine[2*p * TwiddleStride];
+		const float w2i = SineSign * Sine[2*p * TwiddleStride];
+		const float w3r = Cosine[3*p * TwiddleStride];
+		const float w3i = SineSign * Sine[3*p * TwiddleStride];
+		const Vector vw1r = VectorSplat(w1r), vw1i = VectorSplat(w1i);
+		const Vector vw2r = VectorSplat(w2r), vw2i = VectorSplat(w2i);
+		const Vector vw3r = VectorSplat(w3r), vw3i = VectorSplat(w3i);
+		const float *restrict ar = xr + s*p,       *restrict ai = xi + s*p;
+		const float *restrict br = xr + s*(p+m),   *restrict bi = xi + s*(p+m);
+		const float *restrict cr = xr + s*(p+2*m), *restrict ci = xi + s*(p+2*m);
+		const float *restrict dr = xr + s*(p+3*m), *restrict di = xi + s*(p+3*m);
+		float *restrict y0r = yr + s*(4*p),   *restrict y0i = yi + s*(4*p);
+		float *restrict y1r = yr + s*(4*p+1), *restrict y1i = yi + s*(4*p+1);
+		float *restrict y2r = yr + s*(4*p+2), *restrict y2i = yi + s*(4*p+2);
+		float *restrict y3r = yr + s*(4*p+3), *restrict y3i = yi + s*(4*p+3);
+
+		for (q = 0; q < Vectors; q += VectorLanes)
+		{
+			const Vector Ar = VectorLoad(ar + q), Ai = VectorLoad(ai + q);
+			const Vector Br = VectorLoad(br + q), Bi = VectorLoad(bi + q);
+			const Vector Cr = VectorLoad(cr + q), Ci = VectorLoad(ci + q);
+			const Vector Dr = VectorLoad(dr + q), Di = VectorLoad(di + q);
+			const Vector apcr = VectorAdd(Ar, Cr), apci = VectorAdd(Ai, Ci);
+			const Vector amcr = VectorSub(Ar, Cr), amci = VectorSub(Ai, Ci);
+			const Vector bpdr = VectorAdd(Br, Dr), bpdi = VectorAdd(Bi, Di);
+			const Vector bmdr = VectorSub(Br, Dr), bmdi = VectorSub(Bi, Di);
+
+			// -+ i * (b - d).
+			const Vector jr = VectorMul(vSineSign, bmdi);
+			const Vector ji = VectorSub(VectorSplat(0), VectorMul(vSineSign, bmdr));
+
+			const Vector t1r = VectorAdd(amcr, jr), t1i = VectorAdd(amci, ji);
+			const Vector t2r = VectorSub(apcr, bpdr), t2i = VectorSub(apci, bpdi);
+			const Vector t3r = VectorSub(amcr, jr), t3i = VectorSub(amci, ji);
+
+			VectorStore(y0r + q, VectorAdd(apcr, bpdr));
+			VectorStore(y0i + q, VectorAdd(apci, bpdi));
+			VectorStore(y1r + q, VectorSub(VectorMul(t1r, vw1r), VectorMul(t1i, vw1i)));
+			VectorStore(y1i + q, VectorAdd(VectorMul(t1r, vw1i), VectorMul(t1i, vw1r)));
+			VectorStore(y2r + q, VectorSub(VectorMul(t2r, vw2r), VectorMul(t2i, vw2i)));
+			VectorStore(y2i + q, VectorAdd(VectorMul(t2r, vw2i), VectorMul(t2i, vw2r)));
+			VectorStore(y3r + q, VectorSub(VectorMul(t3r, vw3r), VectorMul(t3i, vw3i)));
+			VectorStore(y3i + q, VectorAdd(VectorMul(t3r, vw3i), VectorMul(t3i, vw3r)));
+		}
+
+		for (; q < s; ++q)
+		{
+			const float apcr = ar[q] + cr[q], apci = ai[q] + ci[q];
+			const float amcr = ar[q] - cr[q], amci = ai[q] - ci[q];
+			const float bpdr = br[q] + dr[q], bpdi = bi[q] + di[q];
+			const float bmdr = br[q] - dr[q], bmdi = bi[q] - di[q];
+			const float jr = SineSign * bmdi, ji = 0 - SineSign * bmdr;
+			const float t1r = amcr + jr, t1i = amci + ji;
+			const float t2r = apcr - bpdr, t2i = apci - bpdi;
+			const float t3r = amcr - jr, t3i = amci - ji;
+
+			y0r[q] = apcr + bpdr;
+			y0i[q] = apci + bpdi;
+			y1r[q] = t1r * w1r - t1i * w1i;
+			y1i[q] = t1r * w1i + t1i * w1r;
+			y2r[q] = t2r * w2r - t2i * w2i;
+			y2i[q] = t2r * w2i + t2i * w2r;
+			y3r[q] = t3r * w3r - t3i * w3i;
+			y3i[q] = t3r * w3i + t3i * w3r;
+		}
+	}
+}
+
+
+/*	Interleaved transforms are the same Stockham passes with every
+	element widened to Count consecutive elements:  the stride s in a
+	pass counts elements of all the transforms, while the twiddle
+	factors depend only on the stride within one transform, s / Count.
+*/
+void PortableFFT_zipmt(PortableFFTSetup Setup, const PortableSplitComplex *Data,
+	const PortableSplitComplex *Temp, unsigned long Log2N, unsigned long Count,
+	int Direction)
+{
+	const unsigned long N = Count << Log2N;
+	const float SineSign = Direction == kPortableFFTInverse ? -1 : +1;
+	float *xr = Data->realp, *xi = Data->imagp;
+	float *yr = Temp->realp, *yi = Temp->imagp;
+	unsigned long n, s;
+
+	for (n = 1ul << Log2N, s = Count; n > 1; )
+	{
+		const unsigned long TwiddleStride = (s / Count) << (Setup->Log2N - Log2N);
+		float *t;
+
+		if (n >= 4)
+		{
+			Radix4Pass(xr, xi, yr, yi, n, s, Setup->Cosine, Setup->Sine,
+				TwiddleStride, SineSign);
+			n /= 4;
+			s *= 4;
+		}
+		else
+		{
+			Radix2Pass(xr, xi, yr, yi, n, s, Setup->Cosine, Setup->Sine,
+				TwiddleStride, SineSign);
+			n /= 2;
+			s *= 2;
+		}
+
+		// Swap the roles of the buffers for the next pass.
+		t = xr; xr = yr; yr = t;
+		t = xi; xi = yi; yi = t;
+	}
+
+	// After an odd number of passes the result is in the temporary buffer.
+	if (xr != Data->realp)
+	{
+		memcpy(Data->realp, xr, N * sizeof *xr);
+		memcpy(Data->imagp, xi, N * sizeof *xi);
+	}
+}
+
+
+void PortableFFT_zipt(PortableFFTSetup Setup, const PortableSplitComplex *Data,
+	const PortableSplitComplex *Temp, unsigned long Log2N, int Direction)
+{
+	PortableFFT_zipmt(Setup, Data, Temp, Log2N, 1, Direction);
+}
+
+
+void PortableFFT_zip(PortableFFTSetup Setup, const PortableSplitComplex *Data,
+	unsigned long Log2N, int Direction)
+{
+	const unsigned long N = 1ul << Log2N;
+	PortableSplitComplex Temp;
+
+	Temp.realp = malloc(2 * N * sizeof *Temp.realp);
+	if (Temp.realp == NULL)
+		return;
+	Temp.imagp = Temp.realp + N;
+	PortableFFT_zipt(Setup, Data, &Temp, Log2N, Direction);
+	free(Temp.realp);
+}
+
+
+/*	Convert between the transform of the packed half-length complex
+	vector, Z, and the packed real spectrum, F (twice the DFT of the real
+	signal).  With M = N/2, W = exp(-2 pi i / N), and Zm = conj(Z[M-k]):
+
+		F[k]   =       E + W**k * O,
+		F[M-k] = conj(E - W**k * O),	where E = Z[k] + Zm and
+						O = -i * (Z[k] - Zm),
+
+	and, going back, the same butterflies with conj(W**k) give 4 * Z[k],
+	which the unnormalized inverse transform turns into 2*N times the
+	signal.  Count transforms are interleaved as for PortableFFT_zipmt,
+	and the loop over them is the vector loop.
+
+	Elements k and M-k are the same element when k = M/2, so the pointers
+	to them may alias and every lane loads both before storing either.
+*/
+static void RealSeparate(PortableFFTSetup Setup, const PortableSplitComplex *Data,
+	unsigned long Log2N, unsigned long Count, int Direction)
+{
+	const unsigned long M = (1ul << Log2N) / 2;
+	const unsigned long TwiddleStride = 1ul << (Setup->Log2N - Log2N);
+	const unsigned long Vectors = Count - Count % VectorLanes;
+	float *re = Data->realp, *im = Data->imagp;
+	unsigned long k, b;
+
+	// DC and Nyquist.
+	for (b = 0; b < Count; ++b)
+	{
+		const float r = re[b], i = im[b];
+		if (Direction == kPortableFFTForward)
+		{
+			re[b] = 2 * (r + i);
+			im[b] = 2 * (r - i);
+		}
+		else
+		{
+			re[b] = r + i;
+			im[b] = r - i;
+		}
+	}
+
+	for (k = 1; k <= M / 2; ++k)
+	{
+		const float wr = Setup->Cosine[k * TwiddleStride];
+		const float wi = Setup->Sine[k * TwiddleStride];
+		const Vector vwr = VectorSplat(wr), vwi = VectorSplat(wi);
+		float *rk = re + k * Count, *ik = im + k * Count;
+		float *rm = re + (M - k) * Count, *imk = im + (M - k) * Count;
+
+		b = 0;
+		if (Direction == kPortableFFTForward)
+		{
+			for (; b < Vectors; b += VectorLanes)
+			{
+				const Vector ar = VectorLoad(rk + b), ai = VectorLoad(ik + b);
+				const Vector br = VectorLoad(rm + b), cm = VectorLoad(imk + b);
+
+				// E, and O = -i * (a - b) multiplied by W**k, with b = conj(Z[M-k]).
+				const Vector er = VectorAdd(ar, br), ei = VectorSub(ai, cm);
+				const Vector tr = VectorAdd(ai, cm), ti = VectorSub(br, ar);
+				const Vector orr = VectorSub(VectorMul(tr, vwr), VectorMul(ti, vwi));
+				const Vector oi  = VectorAdd(VectorMul(tr, vwi), VectorMul(ti, vwr));
+
+				VectorStore(rk + b,  VectorAdd(er, orr));
+				VectorStore(ik + b,  VectorAdd(ei, oi));
+				VectorStore(rm + b,  VectorSub(er, orr));
+				VectorStore(imk + b, VectorSub(oi, ei));
+			}
+			for (; b < Count; ++b)
+			{
+				const float ar = rk[b], ai = ik[b];
+				const float br = rm[b], cm = imk[b];
+				const float er = ar + br, ei = ai - cm;
+				const float tr = ai + cm, ti = br - ar;
+				const float orr = tr * wr - ti * wi;
+				const float oi  = tr * wi + ti * wr;
+
+				rk[b]  = er + orr;
+				ik[b]  = ei + oi;
+				rm[b]  = er - orr;
+				imk[b] = oi - ei;
+			}
+		}
+		else
+		{
+			for (; b < Vectors; b += VectorLanes)
+			{
+				const Vector ar = VectorLoad(rk + b), ai = VectorLoad(ik + b);
+				const Vector br = VectorLoad(rm + b), cm = VectorLoad(imk + b);
+
+				// O = (a - b) * conj(W**k); Z = E + i * O.
+				const Vector er = VectorAdd(ar, br), ei = VectorSub(ai, cm);
+				const Vector tr = VectorSub(ar, br), ti = VectorAdd(ai, cm);
+				const Vector orr = VectorAdd(VectorMul(tr, vwr), VectorMul(ti, vwi));
+				const Vector oi  = VectorSub(VectorMul(ti, vwr), VectorMul(tr, vwi));
+
+				VectorStore(rk + b,  VectorSub(er, oi));
+				VectorStore(ik + b,  VectorAdd(ei, orr));
+				VectorStore(rm + b,  VectorAdd(er, oi));
+				VectorStore(imk + b, VectorSub(orr, ei));
+			}
+			for (; b < Count; ++b)
+			{
+				const float ar = rk[b], ai = ik[b];
+				const float br = rm[b], cm = imk[b];
+				const float er = ar + br, ei = ai - cm;
+				const float tr = ar - br, ti = ai + cm;
+				const float orr = tr * wr + ti * wi;
+				const float oi  = ti * wr - tr * wi;
+
+				rk[b]  = er - oi;
+				ik[b]  = ei + orr;
+				rm[b]  = er + oi;
+				imk[b] = orr - ei;
+			}
+		}
+	}
+}
+
+
+void PortableFFT_zripmt(PortableFFTSetup Setup, const PortableSplitComplex *Data,
+	const PortableSplitComplex *Temp, unsigned long Log2N, unsigned long Count,
+	int Direction)
+{
+	if (Log2N == 0)
+		return;
+
+	if (Direction == kPortableFFTForward)
+	{
+		PortableFFT_zipmt(Setup, Data, Temp, Log2N - 1, Count, kPortableFFTForward);
+		RealSeparate(Setup, Data, Log2N, Count, kPortableFFTForward);
+	}
+	else
+	{
+		RealSeparate(Setup, Data, Log2N, Count, kPortableFFTInverse);
+		PortableFFT_zipmt(Setup, Data, Temp, Log2N - 1, Count, kPortableFFTInverse);
+	}
+}
+
+
+void PortableFFT_zript(PortableFFTSetup Setup, const PortableSplitComplex *Data,
+	const PortableSplitComplex *Temp, unsigned long Log2N, int Direction)
+{
+	PortableFFT_zripmt(Setup, Data, Temp, Log2N, 1, Direction);
+}
+
+
+void PortableFFT_zrip(PortableFFTSetup Setup, const PortableSplitComplex *Data,
+	unsigned long Log2N, int Direction)
+{
+	const unsigned long M = (1ul << Log2N) / 2 ? (1ul << Log2N) / 2 : 1;
+	PortableSplitComplex Temp;
+
+	Temp.realp = malloc(2 * M * sizeof *Temp.realp);
+	if (Temp.realp == NULL)
+		return;
+	Temp.imagp = Temp.realp + M;
+	PortableFFT_zript(Setup, Data, &Temp, Log2N, Direction);
+	free(Temp.realp);
+}
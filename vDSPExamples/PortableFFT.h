@@ -0,0 +1,146 @@
+/*
+	    File: PortableFFT.h
+	Abstract: Portable radix-2 FFT with vDSP-compatible split-complex packing.
+	 Version: 1.2
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+	Inc. ("Apple") in consideration of your agreement to the following
+	terms, and your use, installation, modification or redistribution of
+	this Apple software constitutes acceptance of these terms.  If you do
+	not agree with these terms, please do not use, install, modify or
+	redistribute this Apple software.
+	
+	In consideration of your agreement to abide by the following terms, and
+	subject to these terms, Apple grants you a personal, non-exclusive
+	license, under Apple's copyrights in this original Apple software (the
+	"Apple Software"), to use, reproduce, modify and redistribute the Apple
+	Software, with or without modifications, in source and/or binary forms;
+	provided that if you redistribute the Apple Software in its entirety and
+	without modifications, you must retain this notice and the following
+	text and disclaimers in all such redistributions of the Apple Software.
+	Neither the name, trademarks, service marks or logos of Apple Inc. may
+	be used to endorse or promote products derived from the Apple Software
+	without specific prior written permission from Apple.  Except as
+	expressly stated in this notice, no other rights or licenses, express or
+	implied, are granted by Apple herein, including but not limited to any
+	patent rights that may be infringed by your derivative works or by other
+	works in which the Apple Software may be incorporated.
+	
+	The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+	MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+	THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+	FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+	OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+	
+	IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+	OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+	MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+	AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+	STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+	
+	Copyright (C) 2012 Apple Inc. All Rights Reserved.
+	
+
+	This module declares a small FFT that follows the conventions of the
+	vDSP routines vDSP_fft_zip and vDSP_fft_zrip (split-complex data,
+	the same packing of real transforms and the same scaling) but is
+	written in plain C, so the examples built on it also run where the
+	Accelerate framework is not available, such as Linux.
+*/
+
+#ifndef __PORTABLE_FFT__
+#define __PORTABLE_FFT__
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+
+/*	Split-complex data, laid out like DSPSplitComplex:  element k of a
+	complex vector is realp[k] + i * imagp[k].
+*/
+typedef struct
+{
+	float *realp;
+	float *imagp;
+} PortableSplitComplex;
+
+// Directions, with the same values as FFT_FORWARD and FFT_INVERSE.
+enum
+{
+	kPortableFFTForward = +1,
+	kPortableFFTInverse = -1
+};
+
+/*	A setup holds the twiddle factors for transforms of up to 2**Log2N
+	elements.  Like an FFTSetup, it is read-only once created and may be
+	shared by any number of threads.
+*/
+typedef struct PortableFFTSetupStruct *PortableFFTSetup;
+
+PortableFFTSetup PortableFFTCreateSetup(unsigned long Log2N);
+void PortableFFTDestroySetup(PortableFFTSetup Setup);
+
+/*	Complex transform of 2**Log2N elements in place, like vDSP_fft_zip:
+	unnormalized in both directions, so a forward transform followed by
+	an inverse one scales the data by N.
+
+	The "t" variant takes a temporary buffer of the same length as the
+	data (the algorithm is out-of-place internally); the other variant
+	allocates one for each call.  Use the "t" variants when calling from
+	several threads or on real-time paths.
+*/
+void PortableFFT_zipt(PortableFFTSetup Setup, const PortableSplitComplex *Data,
+	const PortableSplitComplex *Temp, unsigned long Log2N, int Direction);
+void PortableFFT_zip(PortableFFTSetup Setup, const PortableSplitComplex *Data,
+	unsigned long Log2N, int Direction);
+
+/*	Count complex transforms of 2**Log2N elements each, in place and
+	interleaved:  element j of transform b is element j*Count + b of
+	Data.  Every pass then runs over Count or more consecutive elements,
+	so a tile of matrix columns copied row by row into Data is
+	transformed with unit-stride vector code throughout.  Temp must
+	have room for Count * 2**Log2N complex elements.  With a Count of 1
+	this is PortableFFT_zipt.
+*/
+void PortableFFT_zipmt(PortableFFTSetup Setup, const PortableSplitComplex *Data,
+	const PortableSplitComplex *Temp, unsigned long Log2N, unsigned long Count,
+	int Direction);
+
+/*	Real transform of N = 2**Log2N elements in place, like vDSP_fft_zrip.
+
+	The N real elements are stored as N/2 complex elements, even-indexed
+	elements in realp and odd-indexed ones in imagp (what vDSP_ctoz
+	produces).  The forward transform leaves frequency k, 0 < k < N/2, in
+	element k, with the purely real DC and Nyquist terms packed into
+	realp[0] and imagp[0].  As with vDSP, the forward result is twice the
+	mathematical DFT and a forward transform followed by an inverse one
+	scales the data by 2*N.
+
+	Temp, when given, must have room for N/2 complex elements.
+*/
+void PortableFFT_zript(PortableFFTSetup Setup, const PortableSplitComplex *Data,
+	const PortableSplitComplex *Temp, unsigned long Log2N, int Direction);
+void PortableFFT_zrip(PortableFFTSetup Setup, const PortableSplitComplex *Data,
+	unsigned long Log2N, int Direction);
+
+/*	Count real transforms of 2**Log2N elements each, in place and
+	interleaved as for PortableFFT_zipmt:  packed complex element k of
+	transform b is element k*Count + b of Data.  Temp must have room for
+	Count * 2**Log2N / 2 complex elements.  With a Count of 1 this is
+	PortableFFT_zript.
+*/
+void PortableFFT_zripmt(PortableFFTSetup Setup, const PortableSplitComplex *Data,
+	const PortableSplitComplex *Temp, unsigned long Log2N, unsigned long Count,
+	int Direction);
+
+
+#ifdef __cplusplus
+	}
+#endif
+
+
+#endif
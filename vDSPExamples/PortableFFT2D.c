@@ -0,0 +1,572 @@
+/*
+	    File: PortableFFT2D.c
+	Abstract: Multithreaded two-dimensional FFT with vDSP_fft2d_zrip packing.
+	 Version: 1.2
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+	Inc. ("Apple") in consideration of your agreement to the following
+	terms, and your use, installation, modification or redistribution of
+	this Apple software constitutes acceptance of these terms.  If you do
+	not agree with these terms, please do not use, install, modify or
+	redistribute this Apple software.
+	
+	In consideration of your agreement to abide by the following terms, and
+	subject to these terms, Apple grants you a personal, non-exclusive
+	license, under Apple's copyrights in this original Apple software (the
+	"Apple Software"), to use, reproduce, modify and redistribute the Apple
+	Software, with or without modifications, in source and/or binary forms;
+	provided that if you redistribute the Apple Software in its entirety and
+	without modifications, you must retain this notice and the following
+	text and disclaimers in all such redistributions of the Apple Software.
+	Neither the name, trademarks, service marks or logos of Apple Inc. may
+	be used to endorse or promote products derived from the Apple Software
+	without specific prior written permission from Apple.  Except as
+	expressly stated in this notice, no other rights or licenses, express or
+	implied, are granted by Apple herein, including but not limited to any
+	patent rights that may be infringed by your derivative works or by other
+	works in which the Apple Software may be incorporated.
+	
+	The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+	MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+	THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+	FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+	OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+	
+	IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+	OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+	MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+	AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+	STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+	
+	Copyright (C) 2012 Apple Inc. All Rights Reserved.
+	
+
+	Rows are transformed RowGroup at a time:  the rows of a group are
+	interleaved, and PortableFFT_zipmt or PortableFFT_zripmt transforms
+	them together with each vector lane of its radix-4 butterflies
+	carrying one row, so even the first passes, which a single short
+	transform spends in scalar code, run in vectors.  Columns are not
+	read one at a time either, since reading down a column touches one
+	element per cache line.  Instead, a tile of TileColumns adjacent
+	columns is copied row by row into a contiguous buffer, a whole cache
+	line per row in the order memory delivers them, and
+	PortableFFT_zipmt transforms all the columns of the tile together
+	with its inner loops running across the tile.  That gains what a
+	cache-blocked transpose would, unit-stride vector code over data in
+	cache, without reordering the tile or transposing it back.
+
+	Rows, tiles, and the matrices of a batch are handed out to threads
+	from a shared counter.  Each row and column is transformed by the
+	same code whichever thread takes it, so results do not depend on the
+	number of threads.
+*/
+
+#if defined(__linux__)
+	#define _GNU_SOURCE		// For sched_getaffinity.
+	#include <sched.h>
+#endif
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "PortableFFT2D.h"
+
+
+// Columns in a tile of the column pass:  one 64-byte cache line of floats.
+#define TileColumns	16
+
+// Rows transformed together in the row pass, one to each lane of a four-float vector.
+#define RowGroup	4
+
+// Transforms of fewer complex elements than this use only the calling thread.
+#define MinThreadedElements	(1ul << 15)
+
+// Complex elements in the rows handed to a thread at a time.
+#define RowElementsPerItem	(1ul << 14)
+
+#define MaxThreads	64
+
+
+struct PortableFFT2DSetupStruct
+{
+	PortableFFTSetup FFT;
+	unsigned long Log2N;
+	unsigned int Threads;
+};
+
+
+// One matrix and how to transform it.
+typedef struct
+{
+	PortableFFTSetup FFT;
+	PortableSplitComplex Data;
+	long IC, IR;
+
+	// Dimensions of the complex matrix; a real row holds 2 * Columns reals.
+	unsigned long Log2NC, Log2NR, Columns, Rows;
+
+	int Real, Direction;
+} Matrix;
+
+
+// Work shared by the threads of one pass.
+typedef struct Job
+{
+	Matrix M;
+	long IM;
+	unsigned long RowsPerItem, Tiles;
+
+	void (*Item)(const struct Job *Job, unsigned long Index, float *Scratch);
+	unsigned long ItemCount, ScratchFloats;
+	volatile long Next, Done;
+} Job;
+
+
+/*	Processors this process may run on.  On Linux that is the affinity
+	mask, which containers and taskset narrow, rather than every online
+	processor; more threads than processors only take turns, and each
+	turn refills the cache with another thread's matrices.
+*/
+static unsigned int ProcessorCount(void)
+{
+	static unsigned int Count = 0;
+	if (Count == 0)
+	{
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+#if defined(__linux__)
+		cpu_set_t Set;
+		if (sched_getaffinity(0, sizeof Set, &Set) == 0 && CPU_COUNT(&Set) < n)
+			n = CPU_COUNT(&Set);
+#endif
+		Count = n > 0 ? (unsigned int) n : 1;
+	}
+	return Count;
+}
+
+
+PortableFFT2DSetup PortableFFT2DCreateSetup(unsigned long Log2N,
+	unsigned int Threads)
+{
+	PortableFFT2DSetup Setup = malloc(sizeof *Setup);
+	if (Setup == NULL)
+		return NULL;
+
+	Setup->FFT = PortableFFTCreateSetup(Log2N);
+	if (Setup->FFT == NULL)
+	{
+		free(Setup);
+		return NULL;
+	}
+
+	Setup->Log2N = Log2N;
+	Setup->Threads = Threads ? Threads : ProcessorCount();
+	if (Setup->Threads > MaxThreads)
+		Setup->Threads = MaxThreads;
+
+	return Setup;
+}
+
+
+void PortableFFT2DDestroySetup(PortableFFT2DSetup Setup)
+{
+	if (Setup == NULL)
+		return;
+	PortableFFTDestroySetup(Setup->FFT);
+	free(Setup);
+}
+
+
+unsigned int PortableFFT2DThreads(PortableFFT2DSetup Setup)
+{
+	return Setup->Threads;
+}
+
+
+/*	Transform rows Begin to End-1, RowGroup at a time:  the rows of a
+	group are interleaved into Scratch, element c of row b at
+	c*RowGroup + b, so each vector lane of PortableFFT's butterflies
+	carries one row from the first pass on.  A group is padded with zero
+	rows at the bottom of the matrix, so every row takes the same
+	arithmetic whichever thread or batch it falls in.  Scratch holds
+	4 * RowGroup * Columns floats:  the group and the transform's
+	temporary buffer.
+*/
+static void TransformRows(const Matrix *m, unsigned long Begin,
+	unsigned long End, float *Scratch)
+{
+	const unsigned long C = m->Columns, N = RowGroup * C;
+	const long IC = m->IC;
+	const PortableSplitComplex Group = { Scratch, Scratch + N };
+	const PortableSplitComplex Temp = { Scratch + 2*N, Scratch + 3*N };
+	unsigned long r0, b, c;
+
+	for (r0 = Begin; r0 < End; r0 += RowGroup)
+	{
+		const unsigned long Rows = End - r0 < RowGroup ? End - r0 : RowGroup;
+
+		for (b = 0; b < RowGroup; ++b)
+		{
+			float *gr = Group.realp + b, *gi = Group.imagp + b;
+
+			if (b < Rows)
+			{
+				const float *re = m->Data.realp + (long) (r0 + b) * m->IR;
+				const float *im = m->Data.imagp + (long) (r0 + b) * m->IR;
+				for (c = 0; c < C; ++c)
+				{
+					gr[c * RowGroup] = re[(long) c * IC];
+					gi[c * RowGroup] = im[(long) c * IC];
+				}
+			}
+			else
+				for (c = 0; c < C; ++c)
+					gr[c * RowGroup] = gi[c * RowGroup] = 0;
+		}
+
+		if (m->Real)
+			PortableFFT_zripmt(m->FFT, &Group, &Temp, m->Log2NC + 1, RowGroup,
+				m->Direction);
+		else
+			PortableFFT_zipmt(m->FFT, &Group, &Temp, m->Log2NC, RowGroup,
+				m->Direction);
+
+		for (b = 0; b < Rows; ++b)
+		{
+			const float *gr = Group.realp + b, *gi = Group.imagp + b;
+			float *re = m->Data.realp + (long) (r0 + b) * m->IR;
+			float *im = m->Data.imagp + (long) (r0 + b) * m->IR;
+			for (c = 0; c < C; ++c)
+			{
+				re[(long) c * IC] = gr[c * RowGroup];
+				im[(long) c * IC] = gi[c * RowGroup];
+			}
+		}
+	}
+}
+
+
+/*	Transform the columns of tile Tile.  Scratch holds 4 * Rows times the
+	tile's width in floats:  the tile and the transform's temporary
+	buffer.  Column 0 of a real transform holds two real signals rather
+	than a complex one, so it is transformed here along with the others
+	but not stored; TransformRealColumns does it properly.
+*/
+static void TransformTile(const Matrix *m, unsigned long Tile, float *Scratch)
+{
+	const unsigned long First = Tile * TileColumns;
+	const unsigned long W = m->Columns - First < TileColumns
+		? m->Columns - First : TileColumns;
+	const unsigned long R = m->Rows, N = W * R;
+	const unsigned long Skip = m->Real && First == 0;
+	const long IC = m->IC;
+	const PortableSplitComplex Tile_ = { Scratch, Scratch + N };
+	const PortableSplitComplex Temp  = { Scratch + 2*N, Scratch + 3*N };
+	unsigned long r, b;
+
+	for (r = 0; r < R; ++r)
+	{
+		const long Offset = (long) r * m->IR + (long) First * IC;
+		const float *re = m->Data.realp + Offset;
+		const float *im = m->Data.imagp + Offset;
+		float *tr = Tile_.realp + r * W, *ti = Tile_.imagp + r * W;
+
+		if (IC == 1)
+		{
+			memcpy(tr, re, W * sizeof *tr);
+			memcpy(ti, im, W * sizeof *ti);
+		}
+		else
+			for (b = 0; b < W; ++b)
+			{
+				tr[b] = re[(long) b * IC];
+				ti[b] = im[(long) b * IC];
+			}
+	}
+
+	PortableFFT_zipmt(m->FFT, &Tile_, &Temp, m->Log2NR, W, m->Direction);
+
+	for (r = 0; r < R; ++r)
+	{
+		const long Offset = (long) r * m->IR + (long) First * IC;
+		float *re = m->Data.realp + Offset;
+		float *im = m->Data.imagp + Offset;
+		const float *tr = Tile_.realp + r * W, *ti = Tile_.imagp + r * W;
+
+		if (IC == 1)
+		{
+			memcpy(re + Skip, tr + Skip, (W - Skip) * sizeof *tr);
+			memcpy(im + Skip, ti + Skip, (W - Skip) * sizeof *ti);
+		}
+		else
+			for (b = Skip; b < W; ++b)
+			{
+				re[(long) b * IC] = tr[b];
+				im[(long) b * IC] = ti[b];
+			}
+	}
+}
+
+
+/*	After the row pass of a real transform, column 0 of realp holds the
+	rows' DC terms and column 0 of imagp their Nyquist terms, two real
+	signals.  Transform each with PortableFFT_zript, reading even rows as
+	real parts and odd rows as imaginary parts (as vDSP_ctoz would) and
+	writing the packed result back the same way.  The forward result is
+	halved, since the row pass has already doubled it, so the whole
+	spectrum is twice the DFT.  Scratch holds 2 * Rows floats.
+*/
+static void TransformRealColumns(const Matrix *m, float *Scratch)
+{
+	const unsigned long H = m->Rows / 2;
+	const long IR = m->IR;
+	const float Scale = m->Direction == kPortableFFTForward ? .5f : 1;
+	const PortableSplitComplex Packed = { Scratch, Scratch + H };
+	const PortableSplitComplex Temp = { Scratch + 2*H, Scratch + 3*H };
+	float *const Columns[2] = { m->Data.realp, m->Data.imagp };
+	unsigned long i, k;
+
+	// A single row's DC and Nyquist terms are already the spectrum.
+	if (H == 0)
+		return;
+
+	for (i = 0; i < 2; ++i)
+	{
+		float *x = Columns[i];
+
+		for (k = 0; k < H; ++k)
+		{
+			Packed.realp[k] = x[(long) (2*k)   * IR];
+			Packed.imagp[k] = x[(long) (2*k+1) * IR];
+		}
+
+		PortableFFT_zript(m->FFT, &Packed, &Temp, m->Log2NR, m->Direction);
+
+		for (k = 0; k < H; ++k)
+		{
+			x[(long) (2*k)   * IR] = Scale * Packed.realp[k];
+			x[(long) (2*k+1) * IR] = Scale * Packed.imagp[k];
+		}
+	}
+}
+
+
+static void TransformColumns(const Matrix *m, unsigned long Tiles,
+	float *Scratch)
+{
+	unsigned long t;
+
+	for (t = 0; t < Tiles; ++t)
+		TransformTile(m, t, Scratch);
+	if (m->Real)
+		TransformRealColumns(m, Scratch);
+}
+
+
+// Transform a whole matrix on the calling thread.
+static void TransformMatrix(const Matrix *m, unsigned long Tiles,
+	float *Scratch)
+{
+	if (m->Direction == kPortableFFTForward)
+	{
+		TransformRows(m, 0, m->Rows, Scratch);
+		TransformColumns(m, Tiles, Scratch);
+	}
+	else
+	{
+		TransformColumns(m, Tiles, Scratch);
+		TransformRows(m, 0, m->Rows, Scratch);
+	}
+}
+
+
+static void RowItem(const Job *job, unsigned long Index, float *Scratch)
+{
+	const unsigned long Begin = Index * job->RowsPerItem;
+	const unsigned long End = job->M.Rows - Begin < job->RowsPerItem
+		? job->M.Rows : Begin + job->RowsPerItem;
+	TransformRows(&job->M, Begin, End, Scratch);
+}
+
+
+// Items 0 to Tiles-1 are tiles; item Tiles is a real transform's column 0.
+static void ColumnItem(const Job *job, unsigned long Index, float *Scratch)
+{
+	if (Index < job->Tiles)
+		TransformTile(&job->M, Index, Scratch);
+	else
+		TransformRealColumns(&job->M, Scratch);
+}
+
+
+static void MatrixItem(const Job *job, unsigned long Index, float *Scratch)
+{
+	Matrix m = job->M;
+	m.Data.realp += (long) Index * job->IM;
+	m.Data.imagp += (long) Index * job->IM;
+	TransformMatrix(&m, job->Tiles, Scratch);
+}
+
+
+static void *Worker(void *Argument)
+{
+	Job *job = Argument;
+	float *Scratch = malloc(job->ScratchFloats * sizeof *Scratch);
+	long Index;
+
+	// Leave the items to the other threads if there is no memory.
+	if (Scratch == NULL)
+		return NULL;
+
+	while ((Index = __sync_fetch_and_add(&job->Next, 1)) < (long) job->ItemCount)
+	{
+		job->Item(job, (unsigned long) Index, Scratch);
+		__sync_fetch_and_add(&job->Done, 1);
+	}
+
+	free(Scratch);
+	return NULL;
+}
+
+
+/*	Do ItemCount items with up to Threads threads, counting the calling
+	thread.  Returns 0, or -1 if memory was too short for any thread to
+	do some of the items.
+*/
+static int Run(Job *job,
+	void (*Item)(const Job *Job, unsigned long Index, float *Scratch),
+	unsigned long ItemCount, unsigned int Threads)
+{
+	pthread_t Workers[MaxThreads];
+	unsigned int i, Started = 0;
+
+	job->Item = Item;
+	job->ItemCount = ItemCount;
+	job->Next = 0;
+	job->Done = 0;
+
+	if (Threads > ItemCount)
+		Threads = (unsigned int) ItemCount;
+
+	for (i = 1; i < Threads; ++i)
+		if (pthread_create(&Workers[Started], NULL, Worker, job) == 0)
+			++Started;
+	Worker(job);
+	for (i = 0; i < Started; ++i)
+		pthread_join(Workers[i], NULL);
+
+	return job->Done == (long) ItemCount ? 0 : -1;
+}
+
+
+static int Transform(PortableFFT2DSetup Setup,
+	const PortableSplitComplex *Data, long IC, long IR, long IM,
+	unsigned long Count, unsigned long Log2NC, unsigned long Log2NR,
+	int Real, int Direction)
+{
+	Job job;
+	unsigned long C, R, W, m;
+	unsigned int Threads;
+
+	if (Log2NC > Setup->Log2N || Log2NR > Setup->Log2N
+			|| (Real && Log2NC == 0))
+		return -1;
+	if (Count == 0)
+		return 0;
+
+	memset(&job, 0, sizeof job);
+	job.M.FFT = Setup->FFT;
+	job.M.Data = *Data;
+	job.M.IC = IC;
+	job.M.Log2NC = Log2NC - (Real ? 1 : 0);
+	job.M.Log2NR = Log2NR;
+	job.M.Columns = C = 1ul << job.M.Log2NC;
+	job.M.Rows = R = 1ul << Log2NR;
+	job.M.IR = IR ? IR : IC * (long) C;
+	job.M.Real = Real;
+	job.M.Direction = Direction;
+	job.IM = IM ? IM : job.M.IR * (long) R;
+
+	// A real transform with one complex column has only the real columns.
+	job.Tiles = Real && C == 1 ? 0 : (C + TileColumns - 1) / TileColumns;
+	job.RowsPerItem = (RowElementsPerItem / C + RowGroup - 1) / RowGroup * RowGroup;
+	if (job.RowsPerItem == 0)
+		job.RowsPerItem = RowGroup;
+
+	W = C < TileColumns ? C : TileColumns;
+	job.ScratchFloats = 4 * (RowGroup * C > W * R ? RowGroup * C : W * R);
+
+	Threads = Setup->Threads;
+	if (Count * R * C < MinThreadedElements)
+		Threads = 1;
+
+	// Give each thread whole matrices when there are enough of them.
+	if (Count >= Threads)
+		return Run(&job, MatrixItem, Count, Threads);
+
+	for (m = 0; m < Count; ++m)
+	{
+		const unsigned long Rows = (R + job.RowsPerItem - 1) / job.RowsPerItem;
+		const unsigned long Columns = job.Tiles + (Real ? 1 : 0);
+
+		job.M.Data.realp = Data->realp + (long) m * job.IM;
+		job.M.Data.imagp = Data->imagp + (long) m * job.IM;
+
+		if (Direction == kPortableFFTForward)
+		{
+			if (Run(&job, RowItem, Rows, Threads)
+					|| Run(&job, ColumnItem, Columns, Threads))
+				return -1;
+		}
+		else
+		{
+			if (Run(&job, ColumnItem, Columns, Threads)
+					|| Run(&job, RowItem, Rows, Threads))
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+int PortableFFT2D_zip(PortableFFT2DSetup Setup,
+	const PortableSplitComplex *Data, long IC, long IR,
+	unsigned long Log2NC, unsigned long Log2NR, int Direction)
+{
+	return Transform(Setup, Data, IC, IR, 0, 1, Log2NC, Log2NR, 0,
+		Direction);
+}
+
+
+int PortableFFT2D_zrip(PortableFFT2DSetup Setup,
+	const PortableSplitComplex *Data, long IC, long IR,
+	unsigned long Log2NC, unsigned long Log2NR, int Direction)
+{
+	return Transform(Setup, Data, IC, IR, 0, 1, Log2NC, Log2NR, 1,
+		Direction);
+}
+
+
+int PortableFFT2D_zipm(PortableFFT2DSetup Setup,
+	const PortableSplitComplex *Data, long IC, long IR, long IM,
+	unsigned long Count, unsigned long Log2NC, unsigned long Log2NR,
+	int Direction)
+{
+	return Transform(Setup, Data, IC, IR, IM, Count, Log2NC, Log2NR, 0,
+		Direction);
+}
+
+
+int PortableFFT2D_zripm(PortableFFT2DSetup Setup,
+	const PortableSplitComplex *Data, long IC, long IR, long IM,
+	unsigned long Count, unsigned long Log2NC, unsigned long Log2NR,
+	int Direction)
+{
+	return Transform(Setup, Data, IC, IR, IM, Count, Log2NC, Log2NR, 1,
+		Direction);
+}
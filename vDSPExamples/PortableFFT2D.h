@@ -0,0 +1,140 @@
+/*
+	    File: PortableFFT2D.h
+	Abstract: Multithreaded two-dimensional FFT with vDSP_fft2d_zrip packing.
+	 Version: 1.2
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by Apple
+	Inc. ("Apple") in consideration of your agreement to the following
+	terms, and your use, installation, modification or redistribution of
+	this Apple software constitutes acceptance of these terms.  If you do
+	not agree with these terms, please do not use, install, modify or
+	redistribute this Apple software.
+	
+	In consideration of your agreement to abide by the following terms, and
+	subject to these terms, Apple grants you a personal, non-exclusive
+	license, under Apple's copyrights in this original Apple software (the
+	"Apple Software"), to use, reproduce, modify and redistribute the Apple
+	Software, with or without modifications, in source and/or binary forms;
+	provided that if you redistribute the Apple Software in its entirety and
+	without modifications, you must retain this notice and the following
+	text and disclaimers in all such redistributions of the Apple Software.
+	Neither the name, trademarks, service marks or logos of Apple Inc. may
+	be used to endorse or promote products derived from the Apple Software
+	without specific prior written permission from Apple.  Except as
+	expressly stated in this notice, no other rights or licenses, express or
+	implied, are granted by Apple herein, including but not limited to any
+	patent rights that may be infringed by your derivative works or by other
+	works in which the Apple Software may be incorporated.
+	
+	The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+	MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+	THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+	FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+	OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+	
+	IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+	OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+	MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+	AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+	STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+	
+	Copyright (C) 2012 Apple Inc. All Rights Reserved.
+	
+
+	This module declares two-dimensional FFTs that follow the
+	conventions of vDSP_fft2d_zip and vDSP_fft2d_zrip (split-complex
+	data, row and column strides, the packing of real transforms and
+	the same scaling) on top of PortableFFT, so image filtering and
+	correlation written against vDSP also run on Linux.  A transform
+	is divided among threads by rows and then by columns, and batches
+	of small matrices are divided among threads a matrix at a time.
+*/
+
+#ifndef __PORTABLE_FFT_2D__
+#define __PORTABLE_FFT_2D__
+
+#include "PortableFFT.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+
+/*	A setup holds the twiddle factors for transforms with up to 2**Log2N
+	rows and 2**Log2N columns, like an FFTSetup created with the larger
+	of the two logarithms, and the number of threads transforms may
+	use, counting the calling thread; zero means one for each
+	processor the process may run on.  It is read-only once created and may be shared by any
+	number of threads.
+*/
+typedef struct PortableFFT2DSetupStruct *PortableFFT2DSetup;
+
+PortableFFT2DSetup PortableFFT2DCreateSetup(unsigned long Log2N,
+	unsigned int Threads);
+void PortableFFT2DDestroySetup(PortableFFT2DSetup Setup);
+
+// The number of threads a setup's transforms may use, zero resolved.
+unsigned int PortableFFT2DThreads(PortableFFT2DSetup Setup);
+
+/*	Complex transform of a matrix of 2**Log2NR rows and 2**Log2NC
+	columns in place, like vDSP_fft2d_zip.  Element (r, c) is element
+	r*IR + c*IC of Data; an IR of zero means IC times the number of
+	columns.  The transform is unnormalized in both directions, so a
+	forward transform followed by an inverse one scales the data by the
+	number of elements.
+
+	Returns 0, or -1 if a dimension exceeds the setup or memory is
+	short.
+*/
+int PortableFFT2D_zip(PortableFFT2DSetup Setup,
+	const PortableSplitComplex *Data, long IC, long IR,
+	unsigned long Log2NC, unsigned long Log2NR, int Direction);
+
+/*	Real transform of a matrix of 2**Log2NR rows and 2**Log2NC real
+	columns in place, like vDSP_fft2d_zrip.  Each row is packed as for
+	PortableFFT_zrip, so the matrix is 2**Log2NR rows of 2**(Log2NC-1)
+	complex elements, with strides IC and IR counted in complex
+	elements as for PortableFFT2D_zip; Log2NC must be at least 1.
+
+	The forward transform leaves frequency (u, v), 0 < v < NC/2, in
+	complex element (u, v).  The two real-valued columns of the
+	spectrum, v = 0 and v = NC/2, are packed down column 0 of realp and
+	imagp respectively, each as PortableFFT_zrip packs a real signal's
+	spectrum and then interleaved the way vDSP_ztoc would:  row 0 holds
+	u = 0, row 1 holds u = NR/2, and rows 2u and 2u+1 hold the real and
+	imaginary parts of frequency u for 0 < u < NR/2.
+
+	As with vDSP, the forward result is twice the mathematical DFT
+	everywhere, and a forward transform followed by an inverse one
+	scales the data by 2 * NR * NC.
+*/
+int PortableFFT2D_zrip(PortableFFT2DSetup Setup,
+	const PortableSplitComplex *Data, long IC, long IR,
+	unsigned long Log2NC, unsigned long Log2NR, int Direction);
+
+/*	Batched versions of the above:  transform Count matrices, matrix m
+	starting at element m*IM of Data, where an IM of zero means IR times
+	the number of rows.  When there are at least as many matrices as
+	threads, each thread transforms whole matrices, which suits batches
+	of small images; otherwise each matrix in turn is divided among the
+	threads.
+*/
+int PortableFFT2D_zipm(PortableFFT2DSetup Setup,
+	const PortableSplitComplex *Data, long IC, long IR, long IM,
+	unsigned long Count, unsigned long Log2NC, unsigned long Log2NR,
+	int Direction);
+int PortableFFT2D_zripm(PortableFFT2DSetup Setup,
+	const PortableSplitComplex *Data, long IC, long IR, long IM,
+	unsigned long Count, unsigned long Log2NC, unsigned long Log2NR,
+	int Direction);
+
+
+#ifdef __cplusplus
+	}
+#endif
+
+
+#endif